@@ -170,7 +170,7 @@ static VOID PhpPrintObjectInfo(
     else if (ObjectHeader->Flags & PH_OBJECT_FROM_TYPE_FREE_LIST)
         c = 'F';
 
-    wprintf(L"\t%4d %c", ObjectHeader->RefCount - RefToSubtract, c);
+    wprintf(L"\t%4d %c", PhpGetObjectRefCount(ObjectHeader) - RefToSubtract, c);
 
     if (!objectType)
     {
@@ -180,7 +180,7 @@ static VOID PhpPrintObjectInfo(
     {
         wprintf(L"\t%.32s", ((PPH_OBJECT_TYPE)object)->Name);
     }
-    else if (objectType == PhStringType)
+    else if (objectType == PhStringType || objectType == PhInternedStringType)
     {
         wprintf(L"\t%.32s", ((PPH_STRING)object)->Buffer);
     }
@@ -233,7 +233,7 @@ static VOID PhpDumpObjectInfo(
     __try
     {
         wprintf(L"Type: %s\n", objectType->Name);
-        wprintf(L"Reference count: %d\n", ObjectHeader->RefCount);
+        wprintf(L"Reference count: %d\n", PhpGetObjectRefCount(ObjectHeader));
         wprintf(L"Flags: %x\n", ObjectHeader->Flags);
 
         if (objectType == PhObjectTypeObject)
@@ -243,8 +243,10 @@ static VOID PhpDumpObjectInfo(
             wprintf(L"Flags: %u\n", ((PPH_OBJECT_TYPE)object)->Flags);
             wprintf(L"Type index: %u\n", ((PPH_OBJECT_TYPE)object)->TypeIndex);
             wprintf(L"Free list count: %u\n", ((PPH_OBJECT_TYPE)object)->FreeList.Count);
+            wprintf(L"Free list magazine hits: %u\n", ((PPH_OBJECT_TYPE)object)->FreeList.MagazineHits);
+            wprintf(L"Free list magazine misses: %u\n", ((PPH_OBJECT_TYPE)object)->FreeList.MagazineMisses);
         }
-        else if (objectType == PhStringType)
+        else if (objectType == PhStringType || objectType == PhInternedStringType)
         {
             wprintf(L"%s\n", ((PPH_STRING)object)->Buffer);
         }
@@ -279,6 +281,35 @@ static VOID PhpPrintHashtableStatistics(
     wprintf(L"Hash function: %s\n", PhpGetSymbolForAddress(Hashtable->HashFunction));
     wprintf(L"Compare function: %s\n", PhpGetSymbolForAddress(Hashtable->CompareFunction));
 
+    if (Hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+    {
+        ULONG mask = Hashtable->AllocatedEntries - 1;
+        ULONG maximumDisplacement = 0;
+
+        wprintf(L"Open addressing: yes\n");
+
+        // Count how far each entry is from its home slot.
+        for (i = 0; i < Hashtable->AllocatedEntries; i++)
+        {
+            PPH_HASHTABLE_ENTRY entry = PH_HASHTABLE_GET_ENTRY(Hashtable, i);
+            ULONG displacement;
+
+            if (entry->HashCode == -1)
+                continue;
+
+            displacement = (i - entry->HashCode) & mask;
+            expectedLookupMisses += displacement;
+
+            if (maximumDisplacement < displacement)
+                maximumDisplacement = displacement;
+        }
+
+        wprintf(L"Maximum displacement: %lu\n", maximumDisplacement);
+        wprintf(L"\nTotal displacement: %lu\n", expectedLookupMisses);
+
+        return;
+    }
+
     wprintf(L"\nBuckets:\n");
 
     for (i = 0; i < Hashtable->AllocatedBuckets; i++)
@@ -400,6 +431,17 @@ static int __cdecl PhpStringEntryCompareByCount(
     return uintptrcmp(entry2->Count, entry1->Count);
 }
 
+static int __cdecl PhpLockSiteCompareByContention(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PPH_QUEUED_LOCK_SITE_STATISTICS site1 = (PPH_QUEUED_LOCK_SITE_STATISTICS)elem1;
+    PPH_QUEUED_LOCK_SITE_STATISTICS site2 = (PPH_QUEUED_LOCK_SITE_STATISTICS)elem2;
+
+    return uint64cmp(site2->TotalWaitTime, site1->TotalWaitTime);
+}
+
 static NTSTATUS PhpLeakEnumerationRoutine(
     _In_ LONG Reserved,
     _In_ PVOID HeapHandle,
@@ -632,6 +674,320 @@ static VOID PhpTestRwLock(
     wprintf(L"[strs] %s: %ums\n", Context->Name, PhGetMillisecondsStopwatch(&stopwatch));
 }
 
+#define RW_SCALE_MAXIMUM_THREADS 64
+
+static volatile ULONG RwScaleValue;
+
+static NTSTATUS PhpRwLockScaleTestThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+#define RW_SCALE_ITERS 100000
+#define RW_SCALE_WRITE_INTERVAL 1000
+
+    RW_TEST_CONTEXT context = *(PRW_TEST_CONTEXT)Parameter;
+    ULONG i;
+
+    PhWaitForBarrier(&RwStartBarrier, FALSE);
+
+    for (i = 0; i < RW_SCALE_ITERS; i++)
+    {
+        if (i % RW_SCALE_WRITE_INTERVAL == 0)
+        {
+            context.AcquireExclusive(context.Parameter);
+            RwScaleValue++;
+            context.ReleaseExclusive(context.Parameter);
+        }
+        else
+        {
+            context.AcquireShared(context.Parameter);
+            (VOID)RwScaleValue;
+            context.ReleaseShared(context.Parameter);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID PhpTestRwLockScaling(
+    _In_ PRW_TEST_CONTEXT Context
+    )
+{
+    STOPWATCH stopwatch;
+    ULONG numberOfThreads;
+    ULONG i;
+    HANDLE threadHandles[RW_SCALE_MAXIMUM_THREADS];
+
+    // Each thread does the same amount of work, mostly shared acquires with
+    // an occasional exclusive acquire. A lock which scales perfectly takes
+    // the same time for any number of threads up to the number of processors.
+
+    wprintf(L"[scal] %s:", Context->Name);
+
+    for (numberOfThreads = 1; numberOfThreads <= RW_SCALE_MAXIMUM_THREADS; numberOfThreads *= 2)
+    {
+        PhInitializeBarrier(&RwStartBarrier, numberOfThreads + 1);
+
+        for (i = 0; i < numberOfThreads; i++)
+            threadHandles[i] = PhCreateThread(0, PhpRwLockScaleTestThreadStart, Context);
+
+        PhWaitForBarrier(&RwStartBarrier, FALSE);
+        PhStartStopwatch(&stopwatch);
+
+        // NtWaitForMultipleObjects is limited to MAXIMUM_WAIT_OBJECTS handles.
+        for (i = 0; i < numberOfThreads; i++)
+            NtWaitForSingleObject(threadHandles[i], FALSE, NULL);
+
+        PhStopStopwatch(&stopwatch);
+
+        for (i = 0; i < numberOfThreads; i++)
+            NtClose(threadHandles[i]);
+
+        wprintf(L" %u:%ums", numberOfThreads, PhGetMillisecondsStopwatch(&stopwatch));
+    }
+
+    wprintf(L"\n");
+}
+
+#define REF_PROCESSORS 16
+
+static PH_BARRIER RefStartBarrier;
+static volatile BOOLEAN RefStop;
+
+static NTSTATUS PhpRefContentionTestThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PhWaitForBarrier(&RefStartBarrier, FALSE);
+
+    while (!RefStop)
+    {
+        PhReferenceObject(Parameter);
+        PhDereferenceObject(Parameter);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID PhpTestRefContention(
+    _In_ PWSTR Name,
+    _In_ PVOID Object
+    )
+{
+    STOPWATCH stopwatch;
+    ULONG i;
+    HANDLE threadHandles[REF_PROCESSORS - 1];
+
+    // Single thread
+
+    PhStartStopwatch(&stopwatch);
+
+    for (i = 0; i < 10000000; i++)
+    {
+        PhReferenceObject(Object);
+        PhDereferenceObject(Object);
+    }
+
+    PhStopStopwatch(&stopwatch);
+
+    wprintf(L"[null] %s: %ums\n", Name, PhGetMillisecondsStopwatch(&stopwatch));
+
+    // Contention test. The other threads reference the object while this thread is timed.
+
+    PhInitializeBarrier(&RefStartBarrier, REF_PROCESSORS);
+    RefStop = FALSE;
+
+    for (i = 0; i < REF_PROCESSORS - 1; i++)
+    {
+        threadHandles[i] = PhCreateThread(0, PhpRefContentionTestThreadStart, Object);
+    }
+
+    PhWaitForBarrier(&RefStartBarrier, FALSE);
+    PhStartStopwatch(&stopwatch);
+
+    for (i = 0; i < 10000000; i++)
+    {
+        PhReferenceObject(Object);
+        PhDereferenceObject(Object);
+    }
+
+    PhStopStopwatch(&stopwatch);
+    RefStop = TRUE;
+    NtWaitForMultipleObjects(REF_PROCESSORS - 1, threadHandles, WaitAll, FALSE, NULL);
+
+    for (i = 0; i < REF_PROCESSORS - 1; i++)
+        NtClose(threadHandles[i]);
+
+    wprintf(L"[strs] %s: %ums\n", Name, PhGetMillisecondsStopwatch(&stopwatch));
+}
+
+static VOID PhpTestUtfConversion(
+    _In_ PWSTR Name,
+    _In_ PPH_STRINGREF Text
+    )
+{
+#define UTF_ITERS 20
+
+    static PWSTR vectorLevelNames[] = { L"none", L"sse2", L"avx", L"avx2" };
+    STOPWATCH stopwatch;
+    ULONG maximumVectorLevel;
+    ULONG vectorLevel;
+    ULONG i;
+    PPH_BYTES utf8;
+    PPH_STRING utf16;
+    ULONG ms;
+
+    maximumVectorLevel = PhGetBaseVectorLevel();
+
+    for (vectorLevel = PH_VECTOR_LEVEL_NONE; vectorLevel <= maximumVectorLevel; vectorLevel++)
+    {
+        if (vectorLevel == PH_VECTOR_LEVEL_AVX)
+            continue;
+
+        PhSetBaseVectorLevel(vectorLevel);
+
+        // UTF-16 to UTF-8
+
+        PhStartStopwatch(&stopwatch);
+
+        for (i = 0; i < UTF_ITERS; i++)
+        {
+            utf8 = PhConvertUtf16ToUtf8Ex(Text->Buffer, Text->Length);
+            PhDereferenceObject(utf8);
+        }
+
+        PhStopStopwatch(&stopwatch);
+        ms = PhGetMillisecondsStopwatch(&stopwatch);
+        wprintf(L"[%s] %s utf16->utf8: %ums (%I64u MB/s)\n", vectorLevelNames[vectorLevel], Name, ms,
+            (ULONG64)Text->Length * UTF_ITERS / 1000 / max(ms, 1));
+
+        // UTF-8 to UTF-16
+
+        utf8 = PhConvertUtf16ToUtf8Ex(Text->Buffer, Text->Length);
+        PhStartStopwatch(&stopwatch);
+
+        for (i = 0; i < UTF_ITERS; i++)
+        {
+            utf16 = PhConvertUtf8ToUtf16Ex(utf8->Buffer, utf8->Length);
+            PhDereferenceObject(utf16);
+        }
+
+        PhStopStopwatch(&stopwatch);
+        ms = PhGetMillisecondsStopwatch(&stopwatch);
+        wprintf(L"[%s] %s utf8->utf16: %ums (%I64u MB/s)\n", vectorLevelNames[vectorLevel], Name, ms,
+            (ULONG64)utf8->Length * UTF_ITERS / 1000 / max(ms, 1));
+        PhDereferenceObject(utf8);
+    }
+
+    PhSetBaseVectorLevel(maximumVectorLevel);
+}
+
+typedef struct _HASH_TEST_CORPUS_CONTEXT
+{
+    PPH_STRING DirectoryName;
+    PPH_LIST Names;
+    PPH_LIST Paths;
+} HASH_TEST_CORPUS_CONTEXT, *PHASH_TEST_CORPUS_CONTEXT;
+
+static BOOLEAN NTAPI PhpHashTestEnumDirectoryCallback(
+    _In_ PFILE_DIRECTORY_INFORMATION Information,
+    _In_opt_ PVOID Context
+    )
+{
+    static PH_STRINGREF separator = PH_STRINGREF_INIT(L"\\");
+
+    PHASH_TEST_CORPUS_CONTEXT context = Context;
+    PH_STRINGREF fileName;
+
+    fileName.Buffer = Information->FileName;
+    fileName.Length = Information->FileNameLength;
+
+    PhAddItemList(context->Names, PhCreateString2(&fileName));
+    PhAddItemList(context->Paths, PhConcatStringRef3(&context->DirectoryName->sr, &separator, &fileName));
+
+    return TRUE;
+}
+
+static VOID PhpTestHashCorpus(
+    _In_ PWSTR Name,
+    _In_ PPH_LIST Corpus
+    )
+{
+#define HASH_ITERS 200
+
+    static PWSTR algorithmNames[] = { L"fnv1a", L"word" };
+    STOPWATCH stopwatch;
+    ULONG algorithm;
+    ULONG ignoreCase;
+    ULONG i;
+    ULONG j;
+    SIZE_T totalLength;
+    ULONG numberOfBuckets;
+    PULONG buckets;
+    ULONG usedBuckets;
+    ULONG maximumChain;
+    volatile ULONG sink;
+    ULONG ms;
+
+    if (Corpus->Count == 0)
+        return;
+
+    totalLength = 0;
+
+    for (i = 0; i < Corpus->Count; i++)
+        totalLength += ((PPH_STRING)Corpus->Items[i])->Length;
+
+    numberOfBuckets = PhRoundUpToPowerOfTwo(Corpus->Count);
+    buckets = PhAllocate(numberOfBuckets * sizeof(ULONG));
+
+    wprintf(L"%s: %u strings, %Iu bytes, %u buckets\n", Name, Corpus->Count, totalLength, numberOfBuckets);
+
+    for (algorithm = Fnv1aHashAlgorithm; algorithm <= WordHashAlgorithm; algorithm++)
+    {
+        for (ignoreCase = 0; ignoreCase < 2; ignoreCase++)
+        {
+            // Throughput
+
+            sink = 0;
+            PhStartStopwatch(&stopwatch);
+
+            for (j = 0; j < HASH_ITERS; j++)
+            {
+                for (i = 0; i < Corpus->Count; i++)
+                    sink += PhHashStringRefEx(&((PPH_STRING)Corpus->Items[i])->sr, (BOOLEAN)ignoreCase, algorithm);
+            }
+
+            PhStopStopwatch(&stopwatch);
+            ms = PhGetMillisecondsStopwatch(&stopwatch);
+
+            // Bucket distribution (using the low bits, as PH_HASHTABLE does)
+
+            memset(buckets, 0, numberOfBuckets * sizeof(ULONG));
+            usedBuckets = 0;
+            maximumChain = 0;
+
+            for (i = 0; i < Corpus->Count; i++)
+            {
+                ULONG index;
+
+                index = PhHashStringRefEx(&((PPH_STRING)Corpus->Items[i])->sr, (BOOLEAN)ignoreCase, algorithm) & (numberOfBuckets - 1);
+
+                if (buckets[index]++ == 0)
+                    usedBuckets++;
+                if (buckets[index] > maximumChain)
+                    maximumChain = buckets[index];
+            }
+
+            wprintf(L"[%s%s] %ums (%I64u MB/s), used buckets: %u (%.1f%%), max chain: %u\n",
+                algorithmNames[algorithm], ignoreCase ? L", ignore case" : L"", ms,
+                (ULONG64)totalLength * HASH_ITERS / 1000 / max(ms, 1),
+                usedBuckets, (DOUBLE)usedBuckets * 100 / numberOfBuckets, maximumChain);
+        }
+    }
+
+    PhFree(buckets);
+}
+
 VOID FASTCALL PhfAcquireCriticalSection(
     _In_ PRTL_CRITICAL_SECTION CriticalSection
     )
@@ -726,7 +1082,10 @@ NTSTATUS PhpDebugConsoleThreadStart(
                 L"exit\n"
                 L"testperf\n"
                 L"testlocks\n"
+                L"testutf\n"
+                L"testhash\n"
                 L"stats\n"
+                L"lockstats [reset]\n"
                 L"objects [type-name-filter]\n"
                 L"objtrace object-address\n"
                 L"objmksnap\n"
@@ -741,6 +1100,8 @@ NTSTATUS PhpDebugConsoleThreadStart(
                 L"workqueues\n"
                 L"procrecords\n"
                 L"procitem\n"
+                L"procreplay [number-of-processes]\n"
+                L"snapstats\n"
                 L"uniquestr\n"
                 L"enableleakdetect\n"
                 L"leakdetect\n"
@@ -778,6 +1139,29 @@ NTSTATUS PhpDebugConsoleThreadStart(
 
             wprintf(L"Referencing: %ums\n", PhGetMillisecondsStopwatch(&stopwatch));
 
+            // Reference counting under contention
+
+            {
+                static PH_INITONCE initOnce = PH_INITONCE_INIT;
+                static PPH_OBJECT_TYPE biasedObjectType;
+                PVOID biasedObject;
+
+                if (PhBeginInitOnce(&initOnce))
+                {
+                    biasedObjectType = PhCreateObjectType(L"BiasedTest", PH_OBJECT_TYPE_BIASED_REF_COUNT, NULL);
+                    PhEndInitOnce(&initOnce);
+                }
+
+                testString = PhCreateString(L"");
+                PhpTestRefContention(L"Shared", testString);
+                PhDereferenceObject(testString);
+
+                // This thread owns the object.
+                biasedObject = PhCreateObject(sizeof(ULONG), biasedObjectType);
+                PhpTestRefContention(L"Biased", biasedObject);
+                PhDereferenceObject(biasedObject);
+            }
+
             // Critical section
 
             RtlInitializeCriticalSection(&testCriticalSection);
@@ -836,6 +1220,7 @@ NTSTATUS PhpDebugConsoleThreadStart(
             RW_TEST_CONTEXT testContext;
             PH_FAST_LOCK fastLock;
             PH_QUEUED_LOCK queuedLock;
+            PH_READ_MOSTLY_LOCK readMostlyLock;
             RTL_CRITICAL_SECTION criticalSection;
 
             testContext.Name = L"FastLock";
@@ -846,6 +1231,7 @@ NTSTATUS PhpDebugConsoleThreadStart(
             testContext.Parameter = &fastLock;
             PhInitializeFastLock(&fastLock);
             PhpTestRwLock(&testContext);
+            PhpTestRwLockScaling(&testContext);
             PhDeleteFastLock(&fastLock);
 
             testContext.Name = L"QueuedLock";
@@ -856,6 +1242,18 @@ NTSTATUS PhpDebugConsoleThreadStart(
             testContext.Parameter = &queuedLock;
             PhInitializeQueuedLock(&queuedLock);
             PhpTestRwLock(&testContext);
+            PhpTestRwLockScaling(&testContext);
+
+            testContext.Name = L"ReadMostlyLock";
+            testContext.AcquireExclusive = PhfAcquireReadMostlyLockExclusive;
+            testContext.AcquireShared = PhfAcquireReadMostlyLockShared;
+            testContext.ReleaseExclusive = PhfReleaseReadMostlyLockExclusive;
+            testContext.ReleaseShared = PhfReleaseReadMostlyLockShared;
+            testContext.Parameter = &readMostlyLock;
+            PhInitializeReadMostlyLock(&readMostlyLock);
+            PhpTestRwLock(&testContext);
+            PhpTestRwLockScaling(&testContext);
+            PhDeleteReadMostlyLock(&readMostlyLock);
 
             testContext.Name = L"CriticalSection";
             testContext.AcquireExclusive = PhfAcquireCriticalSection;
@@ -876,17 +1274,111 @@ NTSTATUS PhpDebugConsoleThreadStart(
             PhInitializeQueuedLock(&queuedLock);
             PhpTestRwLock(&testContext);
         }
+        else if (PhEqualStringZ(command, L"testutf", TRUE))
+        {
+            static PH_STRINGREF asciiText = PH_STRINGREF_INIT(
+                L"<setting name=\"ProcessTreeListColumns\">0,0,200|1,1,45|2,2,70|3,3,70</setting>\r\n");
+            static PH_STRINGREF mixedText = PH_STRINGREF_INIT(
+                L"<setting name=\"UserNotes\">C:\\Windows\\System32\\svchost.exe \x0414\x0438\x0441\x043f\x0435\x0442\x0447\x0435\x0440 "
+                L"\x8fdb\x7a0b\x7ba1\x7406\x5668 \x03b4\x03b9\x03b5\x03c1\x03b3\x03b1\x03c3\x03af\x03b1 \xd83d\xde00</setting>\r\n");
+            PH_STRING_BUILDER sb;
+            PPH_STRING text;
+            ULONG i;
+
+            // ASCII (settings-like XML)
+
+            PhInitializeStringBuilder(&sb, 4 * 1024 * 1024);
+
+            for (i = 0; i < 32768; i++)
+                PhAppendStringBuilder(&sb, &asciiText);
+
+            text = PhFinalStringBuilderString(&sb);
+            PhpTestUtfConversion(L"ascii", &text->sr);
+            PhDeleteStringBuilder(&sb);
+
+            // Mixed scripts
+
+            PhInitializeStringBuilder(&sb, 4 * 1024 * 1024);
+
+            for (i = 0; i < 32768; i++)
+            {
+                PhAppendStringBuilder(&sb, &asciiText);
+
+                if (i % 4 == 0)
+                    PhAppendStringBuilder(&sb, &mixedText);
+            }
+
+            text = PhFinalStringBuilderString(&sb);
+            PhpTestUtfConversion(L"mixed", &text->sr);
+            PhDeleteStringBuilder(&sb);
+        }
+        else if (PhEqualStringZ(command, L"testhash", TRUE))
+        {
+            HASH_TEST_CORPUS_CONTEXT corpusContext;
+            HANDLE directoryHandle;
+            ULONG i;
+
+            // Use the names and full paths of the files in the system directory as
+            // the corpus.
+
+            corpusContext.DirectoryName = PhGetSystemDirectory();
+            corpusContext.Names = PhCreateList(4096);
+            corpusContext.Paths = PhCreateList(4096);
+
+            if (NT_SUCCESS(PhCreateFileWin32(
+                &directoryHandle,
+                corpusContext.DirectoryName->Buffer,
+                FILE_GENERIC_READ,
+                0,
+                FILE_SHARE_READ | FILE_SHARE_WRITE,
+                FILE_OPEN,
+                FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+                )))
+            {
+                PhEnumDirectoryFile(directoryHandle, NULL, PhpHashTestEnumDirectoryCallback, &corpusContext);
+                NtClose(directoryHandle);
+            }
+
+            PhpTestHashCorpus(L"File names", corpusContext.Names);
+            PhpTestHashCorpus(L"File paths", corpusContext.Paths);
+
+            for (i = 0; i < corpusContext.Names->Count; i++)
+                PhDereferenceObject(corpusContext.Names->Items[i]);
+            for (i = 0; i < corpusContext.Paths->Count; i++)
+                PhDereferenceObject(corpusContext.Paths->Items[i]);
+
+            PhDereferenceObject(corpusContext.Names);
+            PhDereferenceObject(corpusContext.Paths);
+            PhDereferenceObject(corpusContext.DirectoryName);
+        }
         else if (PhEqualStringZ(command, L"stats", TRUE))
         {
+            PH_STRING_POOL_STATISTICS stringPoolStatistics;
+
+            PhGetStringPoolStatistics(PhGetGlobalStringPool(), &stringPoolStatistics);
+            wprintf(L"String pool strings: %u\n", stringPoolStatistics.NumberOfStrings);
+            wprintf(L"String pool bytes used: %Iu\n", stringPoolStatistics.BytesUsed);
+            wprintf(L"String pool lookups: %u\n", stringPoolStatistics.Lookups);
+            wprintf(L"String pool hits: %u\n", stringPoolStatistics.Hits);
+            wprintf(L"String pool bytes saved (total): %Iu\n", stringPoolStatistics.BytesSaved);
+            wprintf(L"String pool bytes saved (current, estimated): %Iu\n", stringPoolStatistics.BytesSavedEstimate);
+
 #ifdef DEBUG
             wprintf(L"Object small free list count: %u\n", PhObjectSmallFreeList.Count);
+            wprintf(L"Object small free list magazine hits: %u\n", PhObjectSmallFreeList.MagazineHits);
+            wprintf(L"Object small free list magazine misses: %u\n", PhObjectSmallFreeList.MagazineMisses);
             wprintf(L"Statistics:\n");
 #define PRINT_STATISTIC(Name) wprintf(L#Name L": %u\n", PhLibStatisticsBlock.Name);
 
+            PRINT_STATISTIC(BaseAllocations);
             PRINT_STATISTIC(BaseThreadsCreated);
             PRINT_STATISTIC(BaseThreadsCreateFailed);
             PRINT_STATISTIC(BaseStringBuildersCreated);
             PRINT_STATISTIC(BaseStringBuildersResized);
+            PRINT_STATISTIC(BaseFreeListMagazineHits);
+            PRINT_STATISTIC(BaseFreeListMagazineMisses);
+            PRINT_STATISTIC(BaseFreeListMagazineRefills);
+            PRINT_STATISTIC(BaseFreeListMagazineFlushes);
             PRINT_STATISTIC(RefObjectsCreated);
             PRINT_STATISTIC(RefObjectsDestroyed);
             PRINT_STATISTIC(RefObjectsAllocated);
@@ -900,18 +1392,85 @@ NTSTATUS PhpDebugConsoleThreadStart(
             PRINT_STATISTIC(RefAutoPoolsDestroyed);
             PRINT_STATISTIC(RefAutoPoolsDynamicAllocated);
             PRINT_STATISTIC(RefAutoPoolsDynamicResized);
+            PRINT_STATISTIC(RefBiasedObjectsCreated);
+            PRINT_STATISTIC(RefBiasedObjectsQueued);
+            PRINT_STATISTIC(RefBiasedObjectsMerged);
             PRINT_STATISTIC(QlBlockSpins);
+            PRINT_STATISTIC(QlBlockSpinsSucceeded);
             PRINT_STATISTIC(QlBlockWaits);
             PRINT_STATISTIC(QlAcquireExclusiveBlocks);
             PRINT_STATISTIC(QlAcquireSharedBlocks);
+            PRINT_STATISTIC(RmAcquireSharedBlocks);
+            PRINT_STATISTIC(RmExclusiveDrainWaits);
             PRINT_STATISTIC(WqWorkQueueThreadsCreated);
             PRINT_STATISTIC(WqWorkQueueThreadsCreateFailed);
             PRINT_STATISTIC(WqWorkItemsQueued);
+            PRINT_STATISTIC(WqWorkItemsStolen);
 
 #else
             wprintf(commandDebugOnly);
 #endif
         }
+        else if (PhEqualStringZ(command, L"lockstats", TRUE))
+        {
+            PWSTR reset = wcstok_s(NULL, delims, &context);
+            PPH_QUEUED_LOCK_SITE_STATISTICS sites;
+            ULONG numberOfSites;
+            ULONG numberOfDroppedAcquires;
+            ULONG i;
+            ULONG j;
+
+            if (reset && PhEqualStringZ(reset, L"reset", TRUE))
+            {
+                PhResetQueuedLockStatistics();
+                continue;
+            }
+
+            numberOfSites = PhQueryQueuedLockStatistics(NULL, 0, NULL);
+
+            if (numberOfSites == 0)
+            {
+                wprintf(L"No lock statistics. Compile with PH_QUEUED_LOCK_INSTRUMENTATION defined.\n");
+                continue;
+            }
+
+            sites = PhAllocate(sizeof(PH_QUEUED_LOCK_SITE_STATISTICS) * numberOfSites);
+            numberOfSites = PhQueryQueuedLockStatistics(sites, numberOfSites, &numberOfDroppedAcquires);
+            qsort(sites, numberOfSites, sizeof(PH_QUEUED_LOCK_SITE_STATISTICS), PhpLockSiteCompareByContention);
+
+            for (i = 0; i < 20 && i < numberOfSites; i++)
+            {
+                PPH_QUEUED_LOCK_SITE_STATISTICS site = &sites[i];
+
+                wprintf(L"Lock %Ix (%s)\n", site->Lock, PhpGetSymbolForAddress(site->Lock));
+                wprintf(L"\tCall site: %s\n", PhpGetSymbolForAddress(site->CallSite));
+                wprintf(L"\tAcquires: %u exclusive, %u shared, %u contended\n",
+                    site->ExclusiveAcquires, site->SharedAcquires, site->ContendedAcquires);
+
+                if (site->ContendedAcquires != 0)
+                {
+                    wprintf(L"\tWait time: %I64u us total, %I64u us average\n",
+                        site->TotalWaitTime, site->TotalWaitTime / site->ContendedAcquires);
+                }
+
+                wprintf(L"\tSpin count: %u\n", site->SpinCount);
+                wprintf(L"\tWait histogram (us):");
+
+                for (j = 0; j < PH_QUEUED_LOCK_WAIT_HISTOGRAM_BUCKETS; j++)
+                {
+                    if (site->WaitHistogram[j] != 0)
+                        wprintf(L" <%u:%u", 1 << j, site->WaitHistogram[j]);
+                }
+
+                wprintf(L"\n");
+            }
+
+            wprintf(L"\nTotal lock sites: %u\n", numberOfSites);
+
+            if (numberOfDroppedAcquires != 0)
+                wprintf(L"Acquires not recorded (too many lock sites): %u\n", numberOfDroppedAcquires);
+            PhFree(sites);
+        }
         else if (PhEqualStringZ(command, L"objects", TRUE))
         {
 #ifdef DEBUG
@@ -1279,12 +1838,34 @@ NTSTATUS PhpDebugConsoleThreadStart(
                     while (providerEntry != &providerThread->ListHead)
                     {
                         PPH_PROVIDER_REGISTRATION registration;
+                        ULONG64 totalRunTime = 0;
+                        ULONG maximumRunTime = 0;
+                        ULONG j;
 
                         registration = CONTAINING_RECORD(providerEntry, PH_PROVIDER_REGISTRATION, ListEntry);
 
                         wprintf(L"\tProvider registration at %Ix\n", registration);
                         wprintf(L"\t\tEnabled: %s\n", registration->Enabled ? L"Yes" : L"No");
                         wprintf(L"\t\tFunction: %s\n", PhpGetSymbolForAddress(registration->Function));
+                        wprintf(L"\t\tInterval: %u ms (idle %u ms, current %u ms)\n",
+                            registration->Interval, registration->IdleInterval, registration->CurrentInterval);
+                        wprintf(L"\t\tConsumers: %d\n", registration->Consumers);
+                        wprintf(L"\t\tBudget: %u ms, %u overruns\n", registration->Budget, registration->Overruns);
+
+                        // We already own the provider thread lock, so read the run times directly.
+                        for (j = 0; j < registration->RunTimesCount; j++)
+                        {
+                            totalRunTime += registration->RunTimes[j];
+
+                            if (maximumRunTime < registration->RunTimes[j])
+                                maximumRunTime = registration->RunTimes[j];
+                        }
+
+                        if (registration->RunTimesCount != 0)
+                        {
+                            wprintf(L"\t\tRun time: %I64u us average, %u us maximum (last %u runs)\n",
+                                totalRunTime / registration->RunTimesCount, maximumRunTime, registration->RunTimesCount);
+                        }
 
                         if (registration->Object)
                         {
@@ -1310,6 +1891,8 @@ NTSTATUS PhpDebugConsoleThreadStart(
         {
 #ifdef DEBUG
             ULONG i;
+            ULONG j;
+            ULONG k;
 
             if (PhDbgWorkQueueList)
             {
@@ -1328,25 +1911,41 @@ NTSTATUS PhpDebugConsoleThreadStart(
                     wprintf(L"Current threads: %u\n", workQueue->CurrentThreads);
                     wprintf(L"Busy count: %u\n", workQueue->BusyCount);
 
-                    PhAcquireQueuedLockExclusive(&workQueue->QueueLock);
-
-                    // List the items backwards.
-                    workQueueItemEntry = workQueue->QueueListHead.Blink;
+                    wprintf(L"Pending count: %u\n", workQueue->PendingCount);
+                    wprintf(L"Idle count: %u\n", workQueue->IdleCount);
+                    wprintf(L"Deques: %u%s\n", workQueue->NumberOfDeques,
+                        (workQueue->Flags & PH_WORK_QUEUE_WORK_STEALING) ? L" (work stealing)" : L"");
 
-                    while (workQueueItemEntry != &workQueue->QueueListHead)
+                    for (j = 0; j < workQueue->NumberOfDeques; j++)
                     {
-                        PPH_WORK_QUEUE_ITEM workQueueItem;
+                        PPH_WORK_QUEUE_DEQUE deque = &workQueue->Deques[j];
 
-                        workQueueItem = CONTAINING_RECORD(workQueueItemEntry, PH_WORK_QUEUE_ITEM, ListEntry);
+                        PhAcquireQueuedLockExclusive(&deque->Lock);
 
-                        wprintf(L"\tWork queue item at %Ix\n", workQueueItem);
-                        wprintf(L"\t\tFunction: %s\n", PhpGetSymbolForAddress(workQueueItem->Function));
-                        wprintf(L"\t\tContext: %Ix\n", workQueueItem->Context);
+                        wprintf(L"Deque %u: %u items\n", j, deque->Count);
 
-                        workQueueItemEntry = workQueueItemEntry->Blink;
-                    }
+                        for (k = 0; k < PH_WORK_QUEUE_PRIORITY_COUNT; k++)
+                        {
+                            // List the items backwards.
+                            workQueueItemEntry = deque->ListHeads[k].Blink;
 
-                    PhReleaseQueuedLockExclusive(&workQueue->QueueLock);
+                            while (workQueueItemEntry != &deque->ListHeads[k])
+                            {
+                                PPH_WORK_QUEUE_ITEM workQueueItem;
+
+                                workQueueItem = CONTAINING_RECORD(workQueueItemEntry, PH_WORK_QUEUE_ITEM, ListEntry);
+
+                                wprintf(L"\tWork queue item at %Ix\n", workQueueItem);
+                                wprintf(L"\t\tFunction: %s\n", PhpGetSymbolForAddress(workQueueItem->Function));
+                                wprintf(L"\t\tContext: %Ix\n", workQueueItem->Context);
+                                wprintf(L"\t\tPriority: %u\n", k);
+
+                                workQueueItemEntry = workQueueItemEntry->Blink;
+                            }
+                        }
+
+                        PhReleaseQueuedLockExclusive(&deque->Lock);
+                    }
 
                     wprintf(L"\n");
                 }
@@ -1364,7 +1963,7 @@ NTSTATUS PhpDebugConsoleThreadStart(
             SYSTEMTIME systemTime;
             PPH_PROCESS_RECORD startRecord;
 
-            PhAcquireQueuedLockShared(&PhProcessRecordListLock);
+            PhAcquireReadMostlyLockShared(&PhProcessRecordListLock);
 
             for (i = 0; i < PhProcessRecordList->Count; i++)
             {
@@ -1389,7 +1988,77 @@ NTSTATUS PhpDebugConsoleThreadStart(
                 } while (record != startRecord);
             }
 
-            PhReleaseQueuedLockShared(&PhProcessRecordListLock);
+            PhReleaseReadMostlyLockShared(&PhProcessRecordListLock);
+        }
+        else if (PhEqualStringZ(command, L"procreplay", TRUE))
+        {
+            static ULONG defaultCounts[] = { 10000, 50000 };
+            PWSTR countString = wcstok_s(NULL, delims, &context);
+            PH_STRINGREF countStringRef;
+            ULONG64 count64;
+            PULONG counts = defaultCounts;
+            ULONG numberOfCounts = sizeof(defaultCounts) / sizeof(ULONG);
+            ULONG count;
+            ULONG i;
+            PH_PROCESS_REPLAY_STATISTICS statistics;
+
+            if (countString)
+            {
+                PhInitializeStringRef(&countStringRef, countString);
+
+                if (!PhStringToInteger64(&countStringRef, 10, &count64) || count64 == 0 || count64 > MAXLONG)
+                {
+                    wprintf(L"Invalid number of processes.\n");
+                    continue;
+                }
+
+                count = (ULONG)count64;
+                counts = &count;
+                numberOfCounts = 1;
+            }
+
+            for (i = 0; i < numberOfCounts; i++)
+            {
+                // 100 ticks, replacing 2% of the processes each tick.
+                PhReplayProcessSnapshots(counts[i], 100, counts[i] / 50, &statistics);
+
+                wprintf(L"%u processes: %u buckets, %u added, %u removed\n",
+                    counts[i], statistics.NumberOfBuckets, statistics.Added, statistics.Removed);
+                wprintf(L"\tFirst tick: %I64u us\n", statistics.FirstTickTime);
+                wprintf(L"\tOther ticks: %I64u us average, %I64u us maximum\n",
+                    statistics.TotalTime / 100, statistics.MaximumTime);
+            }
+        }
+        else if (PhEqualStringZ(command, L"snapstats", TRUE))
+        {
+            static PWSTR kindNames[] = { L"Processes", L"Handles", L"Network", L"Services", L"Modules" };
+            ULONG i;
+            PH_SNAPSHOT_STATISTICS statistics;
+
+            if (PhSnapshotMode == PH_SNAPSHOT_MODE_NONE)
+            {
+                wprintf(L"Snapshot recording and replay are not active.\n");
+                continue;
+            }
+
+            wprintf(L"Mode: %s\n", PhSnapshotMode == PH_SNAPSHOT_MODE_RECORD ? L"record" : L"replay");
+
+            for (i = 0; i < PH_SNAPSHOT_MAXIMUM; i++)
+            {
+                PhQuerySnapshotStatistics(i, &statistics);
+
+                if (statistics.Ticks == 0)
+                {
+                    wprintf(L"%s: no ticks\n", kindNames[i]);
+                    continue;
+                }
+
+                wprintf(L"%s: %u ticks\n", kindNames[i], statistics.Ticks);
+                wprintf(L"\tTime: %I64u us average, %I64u us maximum\n",
+                    statistics.TotalTime / statistics.Ticks, statistics.MaximumTime);
+                wprintf(L"\tAllocations: %I64u average, %u maximum\n",
+                    statistics.TotalAllocations / statistics.Ticks, statistics.MaximumAllocations);
+            }
         }
         else if (PhEqualStringZ(command, L"procitem", TRUE))
         {
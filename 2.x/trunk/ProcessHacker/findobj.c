@@ -24,6 +24,7 @@
 #include <emenu.h>
 #include <kphuser.h>
 #include <procprpp.h>
+#include <settings.h>
 #include <windowsx.h>
 
 #define WM_PH_SEARCH_UPDATE (WM_APP + 801)
@@ -785,11 +786,12 @@ static NTSTATUS PhpFindObjectsThreadStart(
     _In_ PVOID Parameter
     )
 {
-    PSYSTEM_HANDLE_INFORMATION_EX handles;
+    PPH_HANDLE_SNAPSHOT snapshot;
     PPH_HASHTABLE processHandleHashtable;
     PVOID processes;
     PSYSTEM_PROCESS_INFORMATION process;
     ULONG i;
+    ULONG j;
 
     // Refuse to search with no filter.
     if (SearchString->Length == 0)
@@ -800,11 +802,8 @@ static NTSTATUS PhpFindObjectsThreadStart(
 
     PhUpperString(SearchString);
 
-    if (NT_SUCCESS(PhEnumHandlesEx(&handles)))
+    if (NT_SUCCESS(PhReferenceHandleSnapshot(PhCsUpdateInterval, &snapshot)))
     {
-        static PH_INITONCE initOnce = PH_INITONCE_INIT;
-        static ULONG fileObjectTypeIndex = -1;
-
         BOOLEAN useWorkQueue = FALSE;
         PH_WORK_QUEUE workQueue;
         processHandleHashtable = PhCreateSimpleHashtable(8);
@@ -813,75 +812,60 @@ static NTSTATUS PhpFindObjectsThreadStart(
         {
             useWorkQueue = TRUE;
             PhInitializeWorkQueue(&workQueue, 1, 20, 1000);
-
-            if (PhBeginInitOnce(&initOnce))
-            {
-                UNICODE_STRING fileTypeName;
-
-                RtlInitUnicodeString(&fileTypeName, L"File");
-                fileObjectTypeIndex = PhGetObjectTypeNumber(&fileTypeName);
-                PhEndInitOnce(&initOnce);
-            }
         }
 
-        for (i = 0; i < handles->NumberOfHandles; i++)
+        // The snapshot is grouped by process, so each process only needs to be opened once.
+        for (i = 0; i < snapshot->NumberOfProcesses && !SearchStop; i++)
         {
-            PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handleInfo = &handles->Handles[i];
-            PVOID *processHandlePtr;
+            HANDLE processId = snapshot->Processes[i].ProcessId;
+            PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handles;
+            ULONG numberOfHandles;
             HANDLE processHandle;
 
-            if (SearchStop)
-                break;
+            if (!NT_SUCCESS(PhOpenProcess(
+                &processHandle,
+                PROCESS_DUP_HANDLE,
+                processId
+                )))
+                continue;
 
-            // Open a handle to the process if we don't already have one.
-
-            processHandlePtr = PhFindItemSimpleHashtable(
+            PhAddItemSimpleHashtable(
                 processHandleHashtable,
-                (PVOID)handleInfo->UniqueProcessId
+                processId,
+                processHandle
                 );
 
-            if (processHandlePtr)
-            {
-                processHandle = (HANDLE)*processHandlePtr;
-            }
-            else
+            PhGetHandleSnapshotSlice(snapshot, processId, &handles, &numberOfHandles);
+
+            for (j = 0; j < numberOfHandles; j++)
             {
-                if (NT_SUCCESS(PhOpenProcess(
-                    &processHandle,
-                    PROCESS_DUP_HANDLE,
-                    (HANDLE)handleInfo->UniqueProcessId
-                    )))
+                PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handleInfo = &handles[j];
+                PH_OBJECT_TYPE_ENTRY typeEntry;
+
+                if (SearchStop)
+                    break;
+
+                if (useWorkQueue &&
+                    PhGetObjectTypeEntry(handleInfo->ObjectTypeIndex, &typeEntry) &&
+                    (typeEntry.Flags & PH_OBJECT_TYPE_NAME_QUERY_MAY_HANG))
                 {
-                    PhAddItemSimpleHashtable(
-                        processHandleHashtable,
-                        (PVOID)handleInfo->UniqueProcessId,
-                        processHandle
-                        );
+                    PSEARCH_HANDLE_CONTEXT searchHandleContext;
+
+                    searchHandleContext = PhAllocate(sizeof(SEARCH_HANDLE_CONTEXT));
+                    searchHandleContext->NeedToFree = TRUE;
+                    searchHandleContext->HandleInfo = handleInfo;
+                    searchHandleContext->ProcessHandle = processHandle;
+                    PhQueueItemWorkQueue(&workQueue, SearchHandleFunction, searchHandleContext);
                 }
                 else
                 {
-                    continue;
-                }
-            }
+                    SEARCH_HANDLE_CONTEXT searchHandleContext;
 
-            if (useWorkQueue && handleInfo->ObjectTypeIndex == (USHORT)fileObjectTypeIndex)
-            {
-                PSEARCH_HANDLE_CONTEXT searchHandleContext;
-
-                searchHandleContext = PhAllocate(sizeof(SEARCH_HANDLE_CONTEXT));
-                searchHandleContext->NeedToFree = TRUE;
-                searchHandleContext->HandleInfo = handleInfo;
-                searchHandleContext->ProcessHandle = processHandle;
-                PhQueueItemWorkQueue(&workQueue, SearchHandleFunction, searchHandleContext);
-            }
-            else
-            {
-                SEARCH_HANDLE_CONTEXT searchHandleContext;
-
-                searchHandleContext.NeedToFree = FALSE;
-                searchHandleContext.HandleInfo = handleInfo;
-                searchHandleContext.ProcessHandle = processHandle;
-                SearchHandleFunction(&searchHandleContext);
+                    searchHandleContext.NeedToFree = FALSE;
+                    searchHandleContext.HandleInfo = handleInfo;
+                    searchHandleContext.ProcessHandle = processHandle;
+                    SearchHandleFunction(&searchHandleContext);
+                }
             }
         }
 
@@ -901,7 +885,8 @@ static NTSTATUS PhpFindObjectsThreadStart(
         }
 
         PhDereferenceObject(processHandleHashtable);
-        PhFree(handles);
+        PhDereferenceObject(snapshot);
+        PhFlushHandleSnapshot();
     }
 
     if (NT_SUCCESS(PhEnumProcesses(&processes)))
@@ -436,6 +436,84 @@ BEGIN_SORT_FUNCTION(FileShareAccess)
 }
 END_SORT_FUNCTION
 
+static VOID PhpSortHandleNodes(
+    _In_ PPH_HANDLE_LIST_CONTEXT Context,
+    _In_ int (__cdecl *SortFunction)(void *, const void *, const void *)
+    )
+{
+    PPH_SORT_KEY_COMPARE_FUNCTION compareFunction;
+    PPH_SORT_KEY keys;
+    PPH_HANDLE_NODE node;
+    PPH_HANDLE_ITEM handleItem;
+    ULONG count;
+    ULONG i;
+
+    // Extract a key from each node once, instead of dereferencing both nodes in every
+    // comparison. String keys only contain a prefix, so nodes with equal string keys are
+    // still ordered by the sort function.
+
+    switch (Context->TreeNewSortColumn)
+    {
+    case PHHNTLC_TYPE:
+    case PHHNTLC_NAME:
+    case PHHNTLC_ORIGINALNAME:
+        compareFunction = SortFunction;
+        break;
+    default:
+        compareFunction = NULL;
+        break;
+    }
+
+    count = Context->NodeList->Count;
+    keys = PhAllocate(count * sizeof(PH_SORT_KEY));
+
+    for (i = 0; i < count; i++)
+    {
+        node = Context->NodeList->Items[i];
+        handleItem = node->HandleItem;
+
+        switch (Context->TreeNewSortColumn)
+        {
+        case PHHNTLC_TYPE:
+            keys[i].Key = PhGetStringSortKey(handleItem->TypeName, TRUE);
+            break;
+        case PHHNTLC_NAME:
+            keys[i].Key = PhGetStringSortKey(handleItem->BestObjectName, TRUE);
+            break;
+        case PHHNTLC_HANDLE:
+            keys[i].Key = (ULONG_PTR)node->Handle;
+            break;
+        case PHHNTLC_OBJECTADDRESS:
+            keys[i].Key = (ULONG_PTR)handleItem->Object;
+            break;
+        case PHHNTLC_ATTRIBUTES:
+            keys[i].Key = handleItem->Attributes;
+            break;
+        case PHHNTLC_GRANTEDACCESS:
+        case PHHNTLC_GRANTEDACCESSSYMBOLIC:
+            keys[i].Key = handleItem->GrantedAccess;
+            break;
+        case PHHNTLC_ORIGINALNAME:
+            keys[i].Key = PhGetStringSortKey(handleItem->ObjectName, TRUE);
+            break;
+        case PHHNTLC_FILESHAREACCESS:
+            keys[i].Key = ((ULONG64)(handleItem->FileFlags & PH_HANDLE_FILE_SHARED_MASK) << 1) |
+                PhEqualString2(handleItem->TypeName, L"File", TRUE);
+            break;
+        }
+
+        keys[i].TieKey = (ULONG_PTR)node->Handle;
+        keys[i].Item = node;
+    }
+
+    PhSortKeys(keys, count, Context->TreeNewSortOrder, compareFunction, Context);
+
+    for (i = 0; i < count; i++)
+        Context->NodeList->Items[i] = keys[i].Item;
+
+    PhFree(keys);
+}
+
 BOOLEAN NTAPI PhpHandleTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -494,7 +572,7 @@ BOOLEAN NTAPI PhpHandleTreeNewCallback(
 
                 if (sortFunction)
                 {
-                    qsort_s(context->NodeList->Items, context->NodeList->Count, sizeof(PVOID), sortFunction, context);
+                    PhpSortHandleNodes(context, sortFunction);
                 }
 
                 getChildren->Children = (PPH_TREENEW_NODE *)context->NodeList->Items;
@@ -22,14 +22,32 @@
 
 #include <phapp.h>
 #include <kphuser.h>
+#include <settings.h>
 #include <extmgri.h>
 
+#define PH_HANDLE_RESOLVE_MAXIMUM_THREADS 4
+#define PH_HANDLE_NAME_CACHE_MAXIMUM_AGE (30 * 1000) // 30 seconds
+#define PH_HANDLE_NAME_CACHE_PRUNE_INTERVAL (10 * 1000) // 10 seconds
+
 typedef struct _PHP_CREATE_HANDLE_ITEM_CONTEXT
 {
     PPH_HANDLE_PROVIDER Provider;
-    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle;
+    SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle;
 } PHP_CREATE_HANDLE_ITEM_CONTEXT, *PPHP_CREATE_HANDLE_ITEM_CONTEXT;
 
+typedef struct _PHP_HANDLE_NAME_CACHE_ENTRY
+{
+    PVOID Object;
+    ACCESS_MASK GrantedAccess;
+    USHORT ObjectTypeIndex;
+    ULONG64 CreateTime;
+    ULONG64 SnapshotTime;
+
+    PPH_STRING TypeName;
+    PPH_STRING ObjectName;
+    PPH_STRING BestObjectName;
+} PHP_HANDLE_NAME_CACHE_ENTRY, *PPHP_HANDLE_NAME_CACHE_ENTRY;
+
 VOID NTAPI PhpHandleProviderDeleteProcedure(
     _In_ PVOID Object,
     _In_ ULONG Flags
@@ -40,9 +58,27 @@ VOID NTAPI PhpHandleItemDeleteProcedure(
     _In_ ULONG Flags
     );
 
+BOOLEAN NTAPI PhpHandleNameCacheCompareFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    );
+
+ULONG NTAPI PhpHandleNameCacheHashFunction(
+    _In_ PVOID Entry
+    );
+
 PPH_OBJECT_TYPE PhHandleProviderType;
 PPH_OBJECT_TYPE PhHandleItemType;
 
+// New handles which may take a long time to query are resolved by a work queue
+// shared by all handle providers. The names of recently seen objects are cached,
+// so handles which are duplicated or passed between processes are only queried once.
+static PH_WORK_QUEUE PhpHandleResolveQueue;
+static PH_QUEUED_LOCK PhpHandleNameCacheLock = PH_QUEUED_LOCK_INIT;
+static PPH_HASHTABLE PhpHandleNameCache;
+static ULONG64 PhpHandleNameCacheLastPruneTime = 0;
+static ULONG64 PhpHandleNameCacheLastSnapshotTime = 0;
+
 BOOLEAN PhHandleProviderInitialization(
     VOID
     )
@@ -50,6 +86,14 @@ BOOLEAN PhHandleProviderInitialization(
     PhHandleProviderType = PhCreateObjectType(L"HandleProvider", 0, PhpHandleProviderDeleteProcedure);
     PhHandleItemType = PhCreateObjectType(L"HandleItem", 0, PhpHandleItemDeleteProcedure);
 
+    PhInitializeWorkQueueEx(&PhpHandleResolveQueue, 0, PH_HANDLE_RESOLVE_MAXIMUM_THREADS, 1000, PH_WORK_QUEUE_WORK_STEALING);
+    PhpHandleNameCache = PhCreateHashtable(
+        sizeof(PHP_HANDLE_NAME_CACHE_ENTRY),
+        PhpHandleNameCacheCompareFunction,
+        PhpHandleNameCacheHashFunction,
+        64
+        );
+
     return TRUE;
 }
 
@@ -84,6 +128,8 @@ PPH_HANDLE_PROVIDER PhCreateHandleProvider(
         );
 
     handleProvider->TempListHashtable = PhCreateSimpleHashtable(20);
+    handleProvider->PendingHashtable = PhCreateSimpleHashtable(8);
+    handleProvider->Terminating = FALSE;
 
     PhEmCallObjectOperation(EmHandleProviderType, handleProvider, EmObjectCreate);
 
@@ -111,6 +157,10 @@ VOID PhpHandleProviderDeleteProcedure(
     if (handleProvider->ProcessHandle) NtClose(handleProvider->ProcessHandle);
 
     PhDereferenceObject(handleProvider->TempListHashtable);
+    PhDereferenceObject(handleProvider->PendingHashtable);
+
+    // Don't keep the shared handle snapshot alive if this was the last handles tab.
+    PhFlushHandleSnapshot();
 }
 
 PPH_HANDLE_ITEM PhCreateHandleItem(
@@ -241,6 +291,22 @@ VOID PhDereferenceAllHandleItems(
     PhReleaseQueuedLockExclusive(&HandleProvider->HandleHashSetLock);
 }
 
+/**
+ * Stops the resolution of handles which are still waiting to be queried.
+ *
+ * \param HandleProvider A handle provider.
+ *
+ * \remarks Call this function when the handle provider is no longer
+ * being displayed. Handles which are already being queried are not
+ * interrupted.
+ */
+VOID PhSetTerminatingHandleProvider(
+    _Inout_ PPH_HANDLE_PROVIDER HandleProvider
+    )
+{
+    HandleProvider->Terminating = TRUE;
+}
+
 VOID PhpAddHandleItem(
     _In_ PPH_HANDLE_PROVIDER HandleProvider,
     _In_ _Assume_refs_(1) PPH_HANDLE_ITEM HandleItem
@@ -411,43 +477,269 @@ NTSTATUS PhEnumHandlesGeneric(
     return STATUS_SUCCESS;
 }
 
-NTSTATUS PhpCreateHandleItemFunction(
-    _In_ PVOID Parameter
+BOOLEAN NTAPI PhpHandleNameCacheCompareFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
     )
 {
-    PPHP_CREATE_HANDLE_ITEM_CONTEXT context = Parameter;
-    PPH_HANDLE_ITEM handleItem;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry1 = Entry1;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry2 = Entry2;
+
+    return
+        entry1->Object == entry2->Object &&
+        entry1->GrantedAccess == entry2->GrantedAccess &&
+        entry1->ObjectTypeIndex == entry2->ObjectTypeIndex;
+}
 
-    handleItem = PhCreateHandleItem(context->Handle);
+ULONG NTAPI PhpHandleNameCacheHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry = Entry;
+
+    return PhHashIntPtr((ULONG_PTR)entry->Object) ^ PhHashInt32(entry->GrantedAccess) ^ entry->ObjectTypeIndex;
+}
+
+static BOOLEAN PhpLookupHandleNameCache(
+    _In_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle,
+    _Inout_ PPH_HANDLE_ITEM HandleItem
+    )
+{
+    PHP_HANDLE_NAME_CACHE_ENTRY lookupEntry;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry;
+
+    // Object addresses are hidden from unprivileged callers on newer versions of Windows.
+    if (!Handle->Object)
+        return FALSE;
+
+    lookupEntry.Object = Handle->Object;
+    lookupEntry.GrantedAccess = (ACCESS_MASK)Handle->GrantedAccess;
+    lookupEntry.ObjectTypeIndex = Handle->ObjectTypeIndex;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    entry = PhFindEntryHashtable(PhpHandleNameCache, &lookupEntry);
+
+    // Entries are aged from when they were added, not from when they were last used.
+    // Otherwise an entry for a freed object would be kept alive by a new object at the
+    // same address.
+    if (entry && NtGetTickCount64() - entry->CreateTime > PH_HANDLE_NAME_CACHE_MAXIMUM_AGE)
+    {
+        PhDereferenceObject(entry->TypeName);
+        if (entry->ObjectName) PhDereferenceObject(entry->ObjectName);
+        if (entry->BestObjectName) PhDereferenceObject(entry->BestObjectName);
+
+        PhRemoveEntryHashtable(PhpHandleNameCache, entry);
+        entry = NULL;
+    }
+
+    if (entry)
+    {
+        PhReferenceObject(entry->TypeName);
+        HandleItem->TypeName = entry->TypeName;
+
+        if (entry->ObjectName)
+            PhReferenceObject(entry->ObjectName);
+        HandleItem->ObjectName = entry->ObjectName;
+
+        if (entry->BestObjectName)
+            PhReferenceObject(entry->BestObjectName);
+        HandleItem->BestObjectName = entry->BestObjectName;
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    return !!entry;
+}
+
+static VOID PhpAddHandleNameCache(
+    _In_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle,
+    _In_ PPH_HANDLE_ITEM HandleItem
+    )
+{
+    PHP_HANDLE_NAME_CACHE_ENTRY entry;
+    BOOLEAN added;
+
+    if (!Handle->Object)
+        return;
+
+    entry.Object = Handle->Object;
+    entry.GrantedAccess = (ACCESS_MASK)Handle->GrantedAccess;
+    entry.ObjectTypeIndex = Handle->ObjectTypeIndex;
+    entry.CreateTime = NtGetTickCount64();
+    entry.SnapshotTime = 0;
+    entry.TypeName = HandleItem->TypeName;
+    entry.ObjectName = HandleItem->ObjectName;
+    entry.BestObjectName = HandleItem->BestObjectName;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    PhAddEntryHashtableEx(PhpHandleNameCache, &entry, &added);
+
+    if (added)
+    {
+        PhReferenceObject(entry.TypeName);
+        if (entry.ObjectName) PhReferenceObject(entry.ObjectName);
+        if (entry.BestObjectName) PhReferenceObject(entry.BestObjectName);
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+}
+
+static VOID PhpPruneHandleNameCache(
+    VOID
+    )
+{
+    ULONG64 currentTime;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry;
+    ULONG enumerationKey;
+
+    currentTime = NtGetTickCount64();
+
+    if (currentTime - PhpHandleNameCacheLastPruneTime < PH_HANDLE_NAME_CACHE_PRUNE_INTERVAL)
+        return;
+
+    PhpHandleNameCacheLastPruneTime = currentTime;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    // Object addresses are re-used once the objects are freed, so old entries are
+    // removed. Removing entries doesn't move the other entries, so this can be done
+    // while enumerating.
+    enumerationKey = 0;
+
+    while (PhEnumHashtable(PhpHandleNameCache, &entry, &enumerationKey))
+    {
+        if (currentTime - entry->CreateTime > PH_HANDLE_NAME_CACHE_MAXIMUM_AGE)
+        {
+            PhDereferenceObject(entry->TypeName);
+            if (entry->ObjectName) PhDereferenceObject(entry->ObjectName);
+            if (entry->BestObjectName) PhDereferenceObject(entry->BestObjectName);
+
+            PhRemoveEntryHashtable(PhpHandleNameCache, entry);
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+}
+
+static VOID PhpPruneHandleNameCacheSnapshot(
+    _In_ PPH_HANDLE_SNAPSHOT Snapshot
+    )
+{
+    PHP_HANDLE_NAME_CACHE_ENTRY lookupEntry;
+    PPHP_HANDLE_NAME_CACHE_ENTRY entry;
+    ULONG enumerationKey;
+    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handle;
+    ULONG_PTR i;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleNameCacheLock);
+
+    // Each snapshot only needs to be checked once, by whichever handle provider gets
+    // to it first.
+    if (Snapshot->Time == PhpHandleNameCacheLastSnapshotTime || PhpHandleNameCache->Count == 0)
+    {
+        PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+        return;
+    }
+
+    PhpHandleNameCacheLastSnapshotTime = Snapshot->Time;
+
+    // Mark the entries whose objects are still open somewhere in the system, and remove
+    // the rest. This removes an entry once its object is freed, before the address can
+    // be re-used by a new object. Entries added after the snapshot was taken are
+    // checked against the next snapshot.
+    for (i = 0; i < Snapshot->Information->NumberOfHandles; i++)
+    {
+        handle = &Snapshot->Information->Handles[i];
+
+        if (!handle->Object)
+            continue;
+
+        lookupEntry.Object = handle->Object;
+        lookupEntry.GrantedAccess = (ACCESS_MASK)handle->GrantedAccess;
+        lookupEntry.ObjectTypeIndex = handle->ObjectTypeIndex;
+
+        if (entry = PhFindEntryHashtable(PhpHandleNameCache, &lookupEntry))
+            entry->SnapshotTime = Snapshot->Time;
+    }
+
+    enumerationKey = 0;
+
+    while (PhEnumHashtable(PhpHandleNameCache, &entry, &enumerationKey))
+    {
+        if (entry->SnapshotTime != Snapshot->Time && entry->CreateTime <= Snapshot->Time)
+        {
+            PhDereferenceObject(entry->TypeName);
+            if (entry->ObjectName) PhDereferenceObject(entry->ObjectName);
+            if (entry->BestObjectName) PhDereferenceObject(entry->BestObjectName);
+
+            PhRemoveEntryHashtable(PhpHandleNameCache, entry);
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleNameCacheLock);
+}
+
+static VOID PhpQueryHandleItemNames(
+    _In_ PPH_HANDLE_PROVIDER HandleProvider,
+    _In_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handle,
+    _Inout_ PPH_HANDLE_ITEM HandleItem
+    )
+{
+    if (PhpLookupHandleNameCache(Handle, HandleItem))
+        return;
 
     PhGetHandleInformationEx(
-        context->Provider->ProcessHandle,
-        handleItem->Handle,
-        context->Handle->ObjectTypeIndex,
+        HandleProvider->ProcessHandle,
+        HandleItem->Handle,
+        Handle->ObjectTypeIndex,
         0,
         NULL,
         NULL,
-        &handleItem->TypeName,
-        &handleItem->ObjectName,
-        &handleItem->BestObjectName,
+        &HandleItem->TypeName,
+        &HandleItem->ObjectName,
+        &HandleItem->BestObjectName,
         NULL
         );
 
-    if (handleItem->TypeName)
-    {
-        // Add the handle item to the hashtable.
-        PhAcquireQueuedLockExclusive(&context->Provider->HandleHashSetLock);
-        PhpAddHandleItem(context->Provider, handleItem);
-        PhReleaseQueuedLockExclusive(&context->Provider->HandleHashSetLock);
+    if (HandleItem->TypeName)
+        PhpAddHandleNameCache(Handle, HandleItem);
+}
 
-        // Raise the handle added event.
-        PhInvokeCallback(&context->Provider->HandleAddedEvent, handleItem);
-    }
-    else
+NTSTATUS PhpCreateHandleItemFunction(
+    _In_ PVOID Parameter
+    )
+{
+    PPHP_CREATE_HANDLE_ITEM_CONTEXT context = Parameter;
+    PPH_HANDLE_PROVIDER handleProvider = context->Provider;
+    PPH_HANDLE_ITEM handleItem = NULL;
+
+    // Don't bother querying the handle if nobody is going to see it.
+    if (!handleProvider->Terminating)
     {
-        PhDereferenceObject(handleItem);
+        handleItem = PhCreateHandleItem(&context->Handle);
+        PhpQueryHandleItemNames(handleProvider, &context->Handle, handleItem);
+
+        if (!handleItem->TypeName)
+        {
+            PhDereferenceObject(handleItem);
+            handleItem = NULL;
+        }
     }
 
+    // Add the handle item to the hashtable. This must be done together with the
+    // removal from the pending list, otherwise the provider may query the handle again.
+    PhAcquireQueuedLockExclusive(&handleProvider->HandleHashSetLock);
+    PhRemoveItemSimpleHashtable(handleProvider->PendingHashtable, (PVOID)context->Handle.HandleValue);
+    if (handleItem) PhpAddHandleItem(handleProvider, handleItem);
+    PhReleaseQueuedLockExclusive(&handleProvider->HandleHashSetLock);
+
+    // Raise the handle added event.
+    if (handleItem)
+        PhInvokeCallback(&handleProvider->HandleAddedEvent, handleItem);
+
+    PhDereferenceObject(handleProvider);
     PhFree(context);
 
     return STATUS_SUCCESS;
@@ -457,11 +749,9 @@ VOID PhHandleProviderUpdate(
     _In_ PVOID Object
     )
 {
-    static PH_INITONCE initOnce = PH_INITONCE_INIT;
-    static ULONG fileObjectTypeIndex = -1;
-
     PPH_HANDLE_PROVIDER handleProvider = (PPH_HANDLE_PROVIDER)Object;
-    PSYSTEM_HANDLE_INFORMATION_EX handleInfo;
+    PSYSTEM_HANDLE_INFORMATION_EX handleInfo = NULL;
+    PPH_HANDLE_SNAPSHOT snapshot = NULL;
     BOOLEAN filterNeeded;
     PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handles;
     ULONG numberOfHandles;
@@ -469,36 +759,43 @@ VOID PhHandleProviderUpdate(
     PH_HASHTABLE_ENUM_CONTEXT enumContext;
     PPH_KEY_VALUE_PAIR handlePair;
     BOOLEAN useWorkQueue = FALSE;
-    PH_WORK_QUEUE workQueue;
+    PH_SNAPSHOT_TICK snapshotTick;
 
-    if (!handleProvider->ProcessHandle)
+    if (!handleProvider->ProcessHandle && PhSnapshotMode != PH_SNAPSHOT_MODE_REPLAY)
         goto UpdateExit;
 
-    if (!NT_SUCCESS(handleProvider->RunStatus = PhEnumHandlesGeneric(
-        handleProvider->ProcessId,
-        handleProvider->ProcessHandle,
-        &handleInfo,
-        &filterNeeded
-        )))
-        goto UpdateExit;
+    PhBeginSnapshotTick(&snapshotTick);
 
-    if (!KphIsConnected() && WindowsVersion >= WINDOWS_VISTA)
+    if (!KphIsConnected() && WindowsVersion >= WINDOWS_XP && PhSnapshotMode == PH_SNAPSHOT_MODE_NONE)
     {
-        useWorkQueue = TRUE;
-        PhInitializeWorkQueue(&workQueue, 1, 20, 1000);
+        // Share one system handle snapshot with the other handle providers. Each update
+        // period gets a new snapshot.
+        if (!NT_SUCCESS(handleProvider->RunStatus = PhReferenceHandleSnapshot(PhCsUpdateInterval / 2, &snapshot)))
+            goto UpdateExit;
 
-        if (PhBeginInitOnce(&initOnce))
-        {
-            UNICODE_STRING fileTypeName;
+        // Remove cached names of objects which no longer exist before they can be returned
+        // for new handles.
+        PhpPruneHandleNameCacheSnapshot(snapshot);
 
-            RtlInitUnicodeString(&fileTypeName, L"File");
-            fileObjectTypeIndex = PhGetObjectTypeNumber(&fileTypeName);
-            PhEndInitOnce(&initOnce);
-        }
+        PhGetHandleSnapshotSlice(snapshot, handleProvider->ProcessId, &handles, &numberOfHandles);
+        filterNeeded = FALSE;
+    }
+    else
+    {
+        if (!NT_SUCCESS(handleProvider->RunStatus = PhSnapshotEnumHandles(
+            handleProvider->ProcessId,
+            handleProvider->ProcessHandle,
+            &handleInfo,
+            &filterNeeded
+            )))
+            goto UpdateExit;
+
+        handles = handleInfo->Handles;
+        numberOfHandles = (ULONG)handleInfo->NumberOfHandles;
     }
 
-    handles = handleInfo->Handles;
-    numberOfHandles = (ULONG)handleInfo->NumberOfHandles;
+    if (!KphIsConnected() && WindowsVersion >= WINDOWS_VISTA)
+        useWorkQueue = TRUE;
 
     // Make a list of the relevant handles.
     if (filterNeeded)
@@ -538,6 +835,9 @@ VOID PhHandleProviderUpdate(
         PPH_HANDLE_ITEM handleItem;
         PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX *tempHashtableValue;
 
+        // Handles being resolved are added to the hash set by other threads.
+        PhAcquireQueuedLockShared(&handleProvider->HandleHashSetLock);
+
         for (i = 0; i < handleProvider->HandleHashSetSize; i++)
         {
             for (entry = handleProvider->HandleHashSet[i]; entry; entry = entry->Next)
@@ -567,9 +867,6 @@ VOID PhHandleProviderUpdate(
 
                 if (!found)
                 {
-                    // Raise the handle removed event.
-                    PhInvokeCallback(&handleProvider->HandleRemovedEvent, handleItem);
-
                     if (!handlesToRemove)
                         handlesToRemove = PhCreateList(2);
 
@@ -578,8 +875,14 @@ VOID PhHandleProviderUpdate(
             }
         }
 
+        PhReleaseQueuedLockShared(&handleProvider->HandleHashSetLock);
+
         if (handlesToRemove)
         {
+            // Raise the handle removed event.
+            for (i = 0; i < handlesToRemove->Count; i++)
+                PhInvokeCallback(&handleProvider->HandleRemovedEvent, handlesToRemove->Items[i]);
+
             PhAcquireQueuedLockExclusive(&handleProvider->HandleHashSetLock);
 
             for (i = 0; i < handlesToRemove->Count; i++)
@@ -603,38 +906,48 @@ VOID PhHandleProviderUpdate(
     {
         PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handle = handlePair->Value;
         PPH_HANDLE_ITEM handleItem;
+        PH_OBJECT_TYPE_ENTRY typeEntry;
+        BOOLEAN pending;
 
+        PhAcquireQueuedLockShared(&handleProvider->HandleHashSetLock);
         handleItem = PhpLookupHandleItem(handleProvider, (HANDLE)handle->HandleValue);
+        pending = !handleItem && PhFindItemSimpleHashtable(handleProvider->PendingHashtable, (PVOID)handle->HandleValue);
+        PhReleaseQueuedLockShared(&handleProvider->HandleHashSetLock);
+
+        // The handle is still being resolved from a previous update.
+        if (pending)
+            continue;
 
         if (!handleItem)
         {
-            // When we don't have KPH, query handle information in parallel to take full advantage of the
-            // PhCallWithTimeout functionality.
-            if (useWorkQueue && handle->ObjectTypeIndex == fileObjectTypeIndex)
+            handleItem = PhCreateHandleItem(handle);
+
+            // When we don't have KPH, query handle information in the background to take full
+            // advantage of the PhCallWithTimeout functionality.
+            if (useWorkQueue &&
+                PhGetObjectTypeEntry(handle->ObjectTypeIndex, &typeEntry) &&
+                (typeEntry.Flags & PH_OBJECT_TYPE_NAME_QUERY_MAY_HANG) &&
+                !PhpLookupHandleNameCache(handle, handleItem))
             {
                 PPHP_CREATE_HANDLE_ITEM_CONTEXT context;
 
+                PhDereferenceObject(handleItem);
+
+                PhAcquireQueuedLockExclusive(&handleProvider->HandleHashSetLock);
+                PhAddItemSimpleHashtable(handleProvider->PendingHashtable, (PVOID)handle->HandleValue, NULL);
+                PhReleaseQueuedLockExclusive(&handleProvider->HandleHashSetLock);
+
+                // The snapshot is gone by the time the handle is resolved, so copy the entry.
                 context = PhAllocate(sizeof(PHP_CREATE_HANDLE_ITEM_CONTEXT));
+                PhReferenceObject(handleProvider);
                 context->Provider = handleProvider;
-                context->Handle = handle;
-                PhQueueItemWorkQueue(&workQueue, PhpCreateHandleItemFunction, context);
+                context->Handle = *handle;
+                PhQueueItemWorkQueue(&PhpHandleResolveQueue, PhpCreateHandleItemFunction, context);
                 continue;
             }
 
-            handleItem = PhCreateHandleItem(handle);
-
-            PhGetHandleInformationEx(
-                handleProvider->ProcessHandle,
-                handleItem->Handle,
-                handle->ObjectTypeIndex,
-                0,
-                NULL,
-                NULL,
-                &handleItem->TypeName,
-                &handleItem->ObjectName,
-                &handleItem->BestObjectName,
-                NULL
-                );
+            if (!handleItem->TypeName)
+                PhpQueryHandleItemNames(handleProvider, handle, handleItem);
 
             // We need at least a type name to continue.
             if (!handleItem->TypeName)
@@ -691,13 +1004,12 @@ VOID PhHandleProviderUpdate(
         }
     }
 
-    if (useWorkQueue)
-    {
-        PhWaitForWorkQueue(&workQueue);
-        PhDeleteWorkQueue(&workQueue);
-    }
+    PhpPruneHandleNameCache();
 
-    PhFree(handleInfo);
+    if (snapshot)
+        PhDereferenceObject(snapshot);
+    else
+        PhFree(handleInfo);
 
     // Re-create the temporary hashtable if it got too big.
     if (handleProvider->TempListHashtable->AllocatedEntries > 8192)
@@ -710,6 +1022,8 @@ VOID PhHandleProviderUpdate(
         PhClearHashtable(handleProvider->TempListHashtable);
     }
 
+    PhEndSnapshotTick(PH_SNAPSHOT_HANDLES, &snapshotTick);
+
 UpdateExit:
     PhInvokeCallback(&handleProvider->UpdatedEvent, NULL);
 }
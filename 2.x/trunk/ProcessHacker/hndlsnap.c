@@ -0,0 +1,344 @@
+/*
+ * Process Hacker -
+ *   shared system handle snapshots
+ *
+ * Copyright (C) 2016 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Without KProcessHacker, the only way to enumerate the handles of a
+ * process is to get the handle table of the entire system and filter
+ * it. Instead of having every handle provider, the handle statistics
+ * window and the handle search do this on their own, they share a
+ * snapshot which is replaced once it is older than the age the caller
+ * is willing to accept.
+ *
+ * Each snapshot is sorted by process ID in place, so the handles of a
+ * process can be returned as a slice of the snapshot without copying.
+ * The sort is a counting sort. The first pass assigns each process a
+ * bucket and counts the handles in each bucket; the bucket index of
+ * each entry is stored in its Reserved field. The second pass swaps
+ * each entry into its bucket. The system usually returns the handles
+ * grouped by process already, in which case the buckets are assigned
+ * in the same order and the second pass doesn't move anything.
+ */
+
+#include <phapp.h>
+
+PPH_OBJECT_TYPE PhHandleSnapshotType;
+
+static PH_QUEUED_LOCK PhpHandleSnapshotLock = PH_QUEUED_LOCK_INIT;
+static PPH_HANDLE_SNAPSHOT PhpCurrentHandleSnapshot = NULL;
+
+VOID NTAPI PhpHandleSnapshotDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    );
+
+BOOLEAN PhHandleSnapshotInitialization(
+    VOID
+    )
+{
+    PhHandleSnapshotType = PhCreateObjectType(L"HandleSnapshot", 0, PhpHandleSnapshotDeleteProcedure);
+
+    return TRUE;
+}
+
+VOID NTAPI PhpHandleSnapshotDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    )
+{
+    PPH_HANDLE_SNAPSHOT snapshot = (PPH_HANDLE_SNAPSHOT)Object;
+
+    if (snapshot->Processes)
+        PhFree(snapshot->Processes);
+
+    PhFree(snapshot->Information);
+}
+
+static int __cdecl PhpHandleSnapshotProcessCompare(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PPH_HANDLE_SNAPSHOT_PROCESS process1 = (PPH_HANDLE_SNAPSHOT_PROCESS)elem1;
+    PPH_HANDLE_SNAPSHOT_PROCESS process2 = (PPH_HANDLE_SNAPSHOT_PROCESS)elem2;
+
+    return uintptrcmp((ULONG_PTR)process1->ProcessId, (ULONG_PTR)process2->ProcessId);
+}
+
+static VOID PhpSortHandleSnapshot(
+    _Inout_ PPH_HANDLE_SNAPSHOT Snapshot
+    )
+{
+    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handles;
+    ULONG numberOfHandles;
+    PPH_HASHTABLE bucketHashtable;
+    PPH_HANDLE_SNAPSHOT_PROCESS buckets;
+    ULONG numberOfBuckets;
+    ULONG allocatedBuckets;
+    PULONG next;
+    ULONG_PTR lastProcessId;
+    ULONG bucket;
+    ULONG index;
+    ULONG end;
+    ULONG target;
+    SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX temp;
+    ULONG i;
+
+    handles = Snapshot->Information->Handles;
+    numberOfHandles = (ULONG)Snapshot->Information->NumberOfHandles;
+
+    bucketHashtable = PhCreateSimpleHashtable(64);
+    allocatedBuckets = 64;
+    buckets = PhAllocate(sizeof(PH_HANDLE_SNAPSHOT_PROCESS) * allocatedBuckets);
+    numberOfBuckets = 0;
+    lastProcessId = 0;
+    bucket = ULONG_MAX;
+
+    // Count the handles of each process. Consecutive entries almost always belong to the
+    // same process, so the hashtable is only used when the process changes.
+    for (i = 0; i < numberOfHandles; i++)
+    {
+        if (bucket == ULONG_MAX || handles[i].UniqueProcessId != lastProcessId)
+        {
+            PVOID *bucketPtr;
+
+            lastProcessId = handles[i].UniqueProcessId;
+
+            if (bucketPtr = PhFindItemSimpleHashtable(bucketHashtable, (PVOID)lastProcessId))
+            {
+                bucket = PtrToUlong(*bucketPtr);
+            }
+            else
+            {
+                if (numberOfBuckets == allocatedBuckets)
+                {
+                    allocatedBuckets *= 2;
+                    buckets = PhReAllocate(buckets, sizeof(PH_HANDLE_SNAPSHOT_PROCESS) * allocatedBuckets);
+                }
+
+                bucket = numberOfBuckets++;
+                buckets[bucket].ProcessId = (HANDLE)lastProcessId;
+                buckets[bucket].Count = 0;
+                PhAddItemSimpleHashtable(bucketHashtable, (PVOID)lastProcessId, UlongToPtr(bucket));
+            }
+        }
+
+        handles[i].Reserved = bucket;
+        buckets[bucket].Count++;
+    }
+
+    PhDereferenceObject(bucketHashtable);
+
+    next = PhAllocate(sizeof(ULONG) * max(numberOfBuckets, 1));
+    index = 0;
+
+    for (bucket = 0; bucket < numberOfBuckets; bucket++)
+    {
+        buckets[bucket].Index = index;
+        next[bucket] = index;
+        index += buckets[bucket].Count;
+    }
+
+    // Move each entry into its bucket. Every swap puts at least one entry in its final
+    // position, so this takes at most one swap per entry.
+    for (bucket = 0; bucket < numberOfBuckets; bucket++)
+    {
+        end = buckets[bucket].Index + buckets[bucket].Count;
+
+        while (next[bucket] < end)
+        {
+            target = handles[next[bucket]].Reserved;
+
+            if (target == bucket)
+            {
+                next[bucket]++;
+                continue;
+            }
+
+            temp = handles[next[target]];
+            handles[next[target]] = handles[next[bucket]];
+            handles[next[bucket]] = temp;
+            next[target]++;
+        }
+    }
+
+    PhFree(next);
+
+    // Sort the processes so that slices can be found using a binary search.
+    qsort(buckets, numberOfBuckets, sizeof(PH_HANDLE_SNAPSHOT_PROCESS), PhpHandleSnapshotProcessCompare);
+
+    Snapshot->Processes = buckets;
+    Snapshot->NumberOfProcesses = numberOfBuckets;
+}
+
+static NTSTATUS PhpCreateHandleSnapshot(
+    _Out_ PPH_HANDLE_SNAPSHOT *Snapshot
+    )
+{
+    NTSTATUS status;
+    PSYSTEM_HANDLE_INFORMATION_EX information;
+    PPH_HANDLE_SNAPSHOT snapshot;
+
+    if (!NT_SUCCESS(status = PhEnumHandlesEx(&information)))
+        return status;
+
+    snapshot = PhCreateObject(sizeof(PH_HANDLE_SNAPSHOT), PhHandleSnapshotType);
+    snapshot->Information = information;
+    snapshot->Time = NtGetTickCount64();
+    snapshot->Processes = NULL;
+    snapshot->NumberOfProcesses = 0;
+
+    PhpSortHandleSnapshot(snapshot);
+
+    *Snapshot = snapshot;
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Gets a snapshot of all handles in the system.
+ *
+ * \param MaximumAge The maximum age of the snapshot, in milliseconds. If
+ * the current snapshot is older, a new snapshot is taken.
+ * \param Snapshot A variable which receives the snapshot. You must
+ * dereference the snapshot when you no longer need it.
+ *
+ * \remarks The snapshot must not be modified.
+ */
+NTSTATUS PhReferenceHandleSnapshot(
+    _In_ ULONG MaximumAge,
+    _Out_ PPH_HANDLE_SNAPSHOT *Snapshot
+    )
+{
+    NTSTATUS status;
+    PPH_HANDLE_SNAPSHOT snapshot;
+
+    // Other consumers wait for the snapshot being taken instead of taking their own.
+    PhAcquireQueuedLockExclusive(&PhpHandleSnapshotLock);
+
+    snapshot = PhpCurrentHandleSnapshot;
+
+    if (snapshot && NtGetTickCount64() - snapshot->Time <= MaximumAge)
+    {
+        PhReferenceObject(snapshot);
+        status = STATUS_SUCCESS;
+    }
+    else
+    {
+        // Release the old snapshot first; these can be very large.
+        if (PhpCurrentHandleSnapshot)
+        {
+            PhDereferenceObject(PhpCurrentHandleSnapshot);
+            PhpCurrentHandleSnapshot = NULL;
+        }
+
+        if (NT_SUCCESS(status = PhpCreateHandleSnapshot(&snapshot)))
+        {
+            PhReferenceObject(snapshot);
+            PhpCurrentHandleSnapshot = snapshot;
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpHandleSnapshotLock);
+
+    if (NT_SUCCESS(status))
+        *Snapshot = snapshot;
+
+    return status;
+}
+
+/**
+ * Releases the snapshot kept for future calls to
+ * PhReferenceHandleSnapshot().
+ *
+ * \remarks Call this function when a consumer of handle snapshots goes
+ * away, so that the snapshot is freed once no other consumer needs it.
+ */
+VOID PhFlushHandleSnapshot(
+    VOID
+    )
+{
+    PPH_HANDLE_SNAPSHOT snapshot;
+
+    PhAcquireQueuedLockExclusive(&PhpHandleSnapshotLock);
+    snapshot = PhpCurrentHandleSnapshot;
+    PhpCurrentHandleSnapshot = NULL;
+    PhReleaseQueuedLockExclusive(&PhpHandleSnapshotLock);
+
+    if (snapshot)
+        PhDereferenceObject(snapshot);
+}
+
+/**
+ * Gets the handles of a process from a handle snapshot.
+ *
+ * \param Snapshot A handle snapshot.
+ * \param ProcessId The ID of the process.
+ * \param Handles A variable which receives a pointer to the first handle
+ * of the process. The handles are part of the snapshot and remain valid
+ * until the snapshot is dereferenced.
+ * \param NumberOfHandles A variable which receives the number of handles.
+ *
+ * \return TRUE if the process has handles in the snapshot, otherwise
+ * FALSE.
+ */
+BOOLEAN PhGetHandleSnapshotSlice(
+    _In_ PPH_HANDLE_SNAPSHOT Snapshot,
+    _In_ HANDLE ProcessId,
+    _Out_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX *Handles,
+    _Out_ PULONG NumberOfHandles
+    )
+{
+    ULONG low;
+    ULONG high;
+    ULONG middle;
+    PPH_HANDLE_SNAPSHOT_PROCESS process;
+
+    low = 0;
+    high = Snapshot->NumberOfProcesses;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        process = &Snapshot->Processes[middle];
+
+        if ((ULONG_PTR)process->ProcessId < (ULONG_PTR)ProcessId)
+        {
+            low = middle + 1;
+        }
+        else if ((ULONG_PTR)process->ProcessId > (ULONG_PTR)ProcessId)
+        {
+            high = middle;
+        }
+        else
+        {
+            *Handles = &Snapshot->Information->Handles[process->Index];
+            *NumberOfHandles = process->Count;
+
+            return TRUE;
+        }
+    }
+
+    *Handles = NULL;
+    *NumberOfHandles = 0;
+
+    return FALSE;
+}
@@ -21,6 +21,8 @@
  */
 
 #include <phapp.h>
+#include <kphuser.h>
+#include <settings.h>
 
 typedef struct _HANDLE_STATISTICS_ENTRY
 {
@@ -33,7 +35,10 @@ typedef struct _HANDLE_STATISTICS_CONTEXT
     HANDLE ProcessId;
     HANDLE ProcessHandle;
 
-    PSYSTEM_HANDLE_INFORMATION_EX Handles;
+    PSYSTEM_HANDLE_INFORMATION_EX HandleInfo;
+    PPH_HANDLE_SNAPSHOT Snapshot;
+    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handles;
+    ULONG NumberOfHandles;
     HANDLE_STATISTICS_ENTRY Entries[MAX_OBJECT_TYPE_NUMBER];
 } HANDLE_STATISTICS_CONTEXT, *PHANDLE_STATISTICS_CONTEXT;
 
@@ -66,12 +71,30 @@ VOID PhShowHandleStatisticsDialog(
         return;
     }
 
-    status = PhEnumHandlesGeneric(
-        context.ProcessId,
-        context.ProcessHandle,
-        &context.Handles,
-        &filterNeeded
-        );
+    context.HandleInfo = NULL;
+    context.Snapshot = NULL;
+
+    if (!KphIsConnected() && WindowsVersion >= WINDOWS_XP)
+    {
+        // The handles tab has probably just taken a snapshot, so use that one.
+        if (NT_SUCCESS(status = PhReferenceHandleSnapshot(PhCsUpdateInterval, &context.Snapshot)))
+            PhGetHandleSnapshotSlice(context.Snapshot, context.ProcessId, &context.Handles, &context.NumberOfHandles);
+    }
+    else
+    {
+        status = PhEnumHandlesGeneric(
+            context.ProcessId,
+            context.ProcessHandle,
+            &context.HandleInfo,
+            &filterNeeded
+            );
+
+        if (NT_SUCCESS(status))
+        {
+            context.Handles = context.HandleInfo->Handles;
+            context.NumberOfHandles = (ULONG)context.HandleInfo->NumberOfHandles;
+        }
+    }
 
     if (!NT_SUCCESS(status))
     {
@@ -96,7 +119,11 @@ VOID PhShowHandleStatisticsDialog(
             PhDereferenceObject(context.Entries[i].Name);
     }
 
-    PhFree(context.Handles);
+    if (context.Snapshot)
+        PhDereferenceObject(context.Snapshot);
+    else
+        PhFree(context.HandleInfo);
+
     NtClose(context.ProcessHandle);
 }
 
@@ -130,13 +157,14 @@ INT_PTR CALLBACK PhpHandleStatisticsDlgProc(
 
             processId = context->ProcessId;
 
-            for (i = 0; i < context->Handles->NumberOfHandles; i++)
+            for (i = 0; i < context->NumberOfHandles; i++)
             {
                 PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX handleInfo;
                 PHANDLE_STATISTICS_ENTRY entry;
+                PH_OBJECT_TYPE_ENTRY typeEntry;
                 PPH_STRING typeName;
 
-                handleInfo = &context->Handles->Handles[i];
+                handleInfo = &context->Handles[i];
 
                 if (handleInfo->UniqueProcessId != (ULONG_PTR)processId)
                     continue;
@@ -145,7 +173,12 @@ INT_PTR CALLBACK PhpHandleStatisticsDlgProc(
 
                 entry = &context->Entries[handleInfo->ObjectTypeIndex];
 
-                if (!entry->Name)
+                if (!entry->Name && PhGetObjectTypeEntry(handleInfo->ObjectTypeIndex, &typeEntry))
+                {
+                    PhReferenceObject(typeEntry.Name);
+                    entry->Name = typeEntry.Name;
+                }
+                else if (!entry->Name)
                 {
                     typeName = NULL;
                     PhGetHandleInformation(
@@ -5,6 +5,9 @@
 #define PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_2 750
 #define PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM 1000
 
+#define PH_SERVICE_PROVIDER_IDLE_INTERVAL 5000
+#define PH_SLOW_PROVIDER_BUDGET 1000
+
 #define TIMER_FLUSH_PROCESS_QUERY_DATA 1
 
 LRESULT CALLBACK PhMwpWndProc(
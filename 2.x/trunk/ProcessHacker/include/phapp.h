@@ -69,6 +69,10 @@ typedef struct _PH_STARTUP_PARAMETERS
 
     PPH_LIST PluginParameters;
     PPH_STRING SelectTab;
+
+    PPH_STRING RecordFileName;
+    PPH_STRING ReplayFileName;
+    ULONG ReplayScale;
 } PH_STARTUP_PARAMETERS, *PPH_STARTUP_PARAMETERS;
 
 extern PPH_STRING PhApplicationDirectory;
@@ -85,6 +89,7 @@ extern PH_STARTUP_PARAMETERS PhStartupParameters;
 
 extern PH_PROVIDER_THREAD PhPrimaryProviderThread;
 extern PH_PROVIDER_THREAD PhSecondaryProviderThread;
+extern PH_PROVIDER_THREAD PhTertiaryProviderThread;
 
 // begin_phapppub
 PHAPPAPI
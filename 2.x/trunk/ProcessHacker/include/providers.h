@@ -14,7 +14,7 @@ PHAPPAPI extern PH_CALLBACK PhProcessRemovedEvent; // phapppub
 PHAPPAPI extern PH_CALLBACK PhProcessesUpdatedEvent; // phapppub
 
 extern PPH_LIST PhProcessRecordList;
-extern PH_QUEUED_LOCK PhProcessRecordListLock;
+extern PH_READ_MOSTLY_LOCK PhProcessRecordListLock;
 
 extern ULONG PhStatisticsSampleCount;
 extern BOOLEAN PhEnableProcessQueryStage2;
@@ -227,6 +227,8 @@ typedef struct _PH_PROCESS_ITEM
     // New fields
     PH_UINTPTR_DELTA PrivateBytesDelta;
     PPH_STRING PackageFullName;
+
+    ULONG Generation; // update in which the process was last seen
 } PH_PROCESS_ITEM, *PPH_PROCESS_ITEM;
 // end_phapppub
 
@@ -338,6 +340,10 @@ PhGetStatisticsTimeString(
     );
 // end_phapppub
 
+ULONG64 PhGetIoTotalHistoryMaximum(
+    _In_ ULONG Count
+    );
+
 VOID PhFlushProcessQueryData(
     _In_ BOOLEAN SendModifiedEvent
     );
@@ -346,6 +352,23 @@ VOID PhProcessProviderUpdate(
     _In_ PVOID Object
     );
 
+typedef struct _PH_PROCESS_REPLAY_STATISTICS
+{
+    ULONG NumberOfBuckets;
+    ULONG Added;
+    ULONG Removed;
+    ULONG64 FirstTickTime; // in microseconds
+    ULONG64 TotalTime; // in microseconds, excluding the first tick
+    ULONG64 MaximumTime; // in microseconds, excluding the first tick
+} PH_PROCESS_REPLAY_STATISTICS, *PPH_PROCESS_REPLAY_STATISTICS;
+
+VOID PhReplayProcessSnapshots(
+    _In_ ULONG NumberOfProcesses,
+    _In_ ULONG NumberOfTicks,
+    _In_ ULONG Churn,
+    _Out_ PPH_PROCESS_REPLAY_STATISTICS Statistics
+    );
+
 // begin_phapppub
 PHAPPAPI
 VOID
@@ -824,6 +847,9 @@ typedef struct _PH_HANDLE_PROVIDER
 
     PPH_HASHTABLE TempListHashtable;
     NTSTATUS RunStatus;
+
+    PPH_HASHTABLE PendingHashtable; // handles being resolved; protected by HandleHashSetLock
+    BOOLEAN Terminating;
 } PH_HANDLE_PROVIDER, *PPH_HANDLE_PROVIDER;
 // end_phapppub
 
@@ -848,6 +874,10 @@ VOID PhDereferenceAllHandleItems(
     _In_ PPH_HANDLE_PROVIDER HandleProvider
     );
 
+VOID PhSetTerminatingHandleProvider(
+    _Inout_ PPH_HANDLE_PROVIDER HandleProvider
+    );
+
 NTSTATUS PhEnumHandlesGeneric(
     _In_ HANDLE ProcessId,
     _In_ HANDLE ProcessHandle,
@@ -859,6 +889,48 @@ VOID PhHandleProviderUpdate(
     _In_ PVOID Object
     );
 
+// hndlsnap
+
+extern PPH_OBJECT_TYPE PhHandleSnapshotType;
+
+typedef struct _PH_HANDLE_SNAPSHOT_PROCESS
+{
+    HANDLE ProcessId;
+    ULONG Index;
+    ULONG Count;
+} PH_HANDLE_SNAPSHOT_PROCESS, *PPH_HANDLE_SNAPSHOT_PROCESS;
+
+typedef struct _PH_HANDLE_SNAPSHOT
+{
+    /** The handles, sorted by process ID. The Reserved field of each entry is overwritten. */
+    PSYSTEM_HANDLE_INFORMATION_EX Information;
+    ULONG64 Time;
+
+    /** The processes which have handles, sorted by process ID. */
+    PPH_HANDLE_SNAPSHOT_PROCESS Processes;
+    ULONG NumberOfProcesses;
+} PH_HANDLE_SNAPSHOT, *PPH_HANDLE_SNAPSHOT;
+
+BOOLEAN PhHandleSnapshotInitialization(
+    VOID
+    );
+
+NTSTATUS PhReferenceHandleSnapshot(
+    _In_ ULONG MaximumAge,
+    _Out_ PPH_HANDLE_SNAPSHOT *Snapshot
+    );
+
+VOID PhFlushHandleSnapshot(
+    VOID
+    );
+
+BOOLEAN PhGetHandleSnapshotSlice(
+    _In_ PPH_HANDLE_SNAPSHOT Snapshot,
+    _In_ HANDLE ProcessId,
+    _Out_ PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX *Handles,
+    _Out_ PULONG NumberOfHandles
+    );
+
 // memprv
 
 extern PPH_OBJECT_TYPE PhMemoryItemType;
@@ -886,7 +958,6 @@ typedef enum _PH_MEMORY_REGION_TYPE
 typedef struct _PH_MEMORY_ITEM
 {
     LIST_ENTRY ListEntry;
-    PH_AVL_LINKS Links;
 
     union
     {
@@ -949,8 +1020,12 @@ typedef struct _PH_MEMORY_ITEM
 typedef struct _PH_MEMORY_ITEM_LIST
 {
     HANDLE ProcessId;
-    PH_AVL_TREE Set;
     LIST_ENTRY ListHead;
+
+    // Address index, in ascending order of base address
+    ULONG NumberOfItems;
+    PULONG_PTR BaseAddresses;
+    PPH_MEMORY_ITEM *Items;
 } PH_MEMORY_ITEM_LIST, *PPH_MEMORY_ITEM_LIST;
 // end_phapppub
 
@@ -991,6 +1066,16 @@ PhLookupMemoryItemList(
     _In_ PVOID Address
     );
 
+PHAPPAPI
+VOID
+NTAPI
+PhLookupMemoryItemsList(
+    _In_ PPH_MEMORY_ITEM_LIST List,
+    _In_ ULONG NumberOfAddresses,
+    _In_reads_(NumberOfAddresses) PVOID *Addresses,
+    _Out_writes_(NumberOfAddresses) PPH_MEMORY_ITEM *MemoryItems
+    );
+
 #define PH_QUERY_MEMORY_IGNORE_FREE 0x1
 #define PH_QUERY_MEMORY_REGION_TYPE 0x2
 #define PH_QUERY_MEMORY_WS_COUNTERS 0x4
@@ -1005,4 +1090,94 @@ PhQueryMemoryItemList(
     );
 // end_phapppub
 
+// provsnap
+
+#define PH_SNAPSHOT_PROCESSES 0
+#define PH_SNAPSHOT_HANDLES 1
+#define PH_SNAPSHOT_NETWORK 2
+#define PH_SNAPSHOT_SERVICES 3
+#define PH_SNAPSHOT_MODULES 4
+#define PH_SNAPSHOT_MAXIMUM 5
+
+#define PH_SNAPSHOT_MODE_NONE 0
+#define PH_SNAPSHOT_MODE_RECORD 1
+#define PH_SNAPSHOT_MODE_REPLAY 2
+
+extern ULONG PhSnapshotMode;
+
+typedef struct _PH_SNAPSHOT_STATISTICS
+{
+    ULONG Ticks;
+    ULONG64 TotalTime; // in microseconds
+    ULONG64 MaximumTime; // in microseconds
+    ULONG64 TotalAllocations; // heap allocations made by the provider thread
+    ULONG MaximumAllocations;
+} PH_SNAPSHOT_STATISTICS, *PPH_SNAPSHOT_STATISTICS;
+
+typedef struct _PH_SNAPSHOT_TICK
+{
+    LARGE_INTEGER StartCounter;
+    ULONG StartAllocations;
+    BOOLEAN Started;
+} PH_SNAPSHOT_TICK, *PPH_SNAPSHOT_TICK;
+
+NTSTATUS PhStartSnapshotRecording(
+    _In_ PWSTR FileName
+    );
+
+NTSTATUS PhStartSnapshotReplay(
+    _In_ PWSTR FileName,
+    _In_ ULONG Scale
+    );
+
+VOID PhRecordSnapshot(
+    _In_ ULONG Kind,
+    _In_ ULONG64 Context,
+    _In_reads_bytes_(Size) PVOID Buffer,
+    _In_ ULONG Size
+    );
+
+PVOID PhReplaySnapshot(
+    _In_ ULONG Kind,
+    _Out_ PULONG Size
+    );
+
+VOID PhBeginSnapshotTick(
+    _Out_ PPH_SNAPSHOT_TICK Tick
+    );
+
+VOID PhEndSnapshotTick(
+    _In_ ULONG Kind,
+    _In_ PPH_SNAPSHOT_TICK Tick
+    );
+
+VOID PhQuerySnapshotStatistics(
+    _In_ ULONG Kind,
+    _Out_ PPH_SNAPSHOT_STATISTICS Statistics
+    );
+
+NTSTATUS PhSnapshotEnumProcesses(
+    _Out_ PVOID *Processes
+    );
+
+NTSTATUS PhSnapshotEnumHandles(
+    _In_ HANDLE ProcessId,
+    _In_opt_ HANDLE ProcessHandle,
+    _Out_ PSYSTEM_HANDLE_INFORMATION_EX *Handles,
+    _Out_ PBOOLEAN FilterNeeded
+    );
+
+PVOID PhSnapshotEnumServices(
+    _In_ SC_HANDLE ScManagerHandle,
+    _Out_ PULONG Count
+    );
+
+NTSTATUS PhSnapshotEnumGenericModules(
+    _In_ HANDLE ProcessId,
+    _In_opt_ HANDLE ProcessHandle,
+    _In_ ULONG Flags,
+    _In_ PPH_ENUM_GENERIC_MODULES_CALLBACK Callback,
+    _In_opt_ PVOID Context
+    );
+
 #endif
@@ -272,24 +272,24 @@ typedef struct _PH_PROCESS_NODE
 
     // Text buffers
     WCHAR CpuUsageText[PH_INT32_STR_LEN_1];
-    PPH_STRING IoTotalRateText;
-    PPH_STRING PrivateBytesText;
-    PPH_STRING PeakPrivateBytesText;
-    PPH_STRING WorkingSetText;
-    PPH_STRING PeakWorkingSetText;
-    PPH_STRING PrivateWsText;
-    PPH_STRING SharedWsText;
-    PPH_STRING ShareableWsText;
-    PPH_STRING VirtualSizeText;
-    PPH_STRING PeakVirtualSizeText;
-    PPH_STRING PageFaultsText;
+    PH_FORMAT_SLOT IoTotalRateText;
+    PH_FORMAT_SLOT PrivateBytesText;
+    PH_FORMAT_SLOT PeakPrivateBytesText;
+    PH_FORMAT_SLOT WorkingSetText;
+    PH_FORMAT_SLOT PeakWorkingSetText;
+    PH_FORMAT_SLOT PrivateWsText;
+    PH_FORMAT_SLOT SharedWsText;
+    PH_FORMAT_SLOT ShareableWsText;
+    PH_FORMAT_SLOT VirtualSizeText;
+    PH_FORMAT_SLOT PeakVirtualSizeText;
+    PH_FORMAT_SLOT PageFaultsText;
     WCHAR BasePriorityText[PH_INT32_STR_LEN_1];
     WCHAR ThreadsText[PH_INT32_STR_LEN_1 + 3];
     WCHAR HandlesText[PH_INT32_STR_LEN_1 + 3];
     WCHAR GdiHandlesText[PH_INT32_STR_LEN_1 + 3];
     WCHAR UserHandlesText[PH_INT32_STR_LEN_1 + 3];
-    PPH_STRING IoRoRateText;
-    PPH_STRING IoWRateText;
+    PH_FORMAT_SLOT IoRoRateText;
+    PH_FORMAT_SLOT IoWRateText;
     WCHAR PagePriorityText[PH_INT32_STR_LEN_1];
     PPH_STRING StartTimeText;
     WCHAR TotalCpuTimeText[PH_TIMESPAN_STR_LEN_1];
@@ -297,19 +297,19 @@ typedef struct _PH_PROCESS_NODE
     WCHAR UserCpuTimeText[PH_TIMESPAN_STR_LEN_1];
     PPH_STRING RelativeStartTimeText;
     PPH_STRING WindowTitleText;
-    PPH_STRING CyclesText;
-    PPH_STRING CyclesDeltaText;
-    PPH_STRING ContextSwitchesText;
-    PPH_STRING ContextSwitchesDeltaText;
-    PPH_STRING PageFaultsDeltaText;
-    PPH_STRING IoGroupText[PHPRTLC_IOGROUP_COUNT];
-    PPH_STRING PagedPoolText;
-    PPH_STRING PeakPagedPoolText;
-    PPH_STRING NonPagedPoolText;
-    PPH_STRING PeakNonPagedPoolText;
-    PPH_STRING MinimumWorkingSetText;
-    PPH_STRING MaximumWorkingSetText;
-    PPH_STRING PrivateBytesDeltaText;
+    PH_FORMAT_SLOT CyclesText;
+    PH_FORMAT_SLOT CyclesDeltaText;
+    PH_FORMAT_SLOT ContextSwitchesText;
+    PH_FORMAT_SLOT ContextSwitchesDeltaText;
+    PH_FORMAT_SLOT PageFaultsDeltaText;
+    PH_FORMAT_SLOT IoGroupText[PHPRTLC_IOGROUP_COUNT];
+    PH_FORMAT_SLOT PagedPoolText;
+    PH_FORMAT_SLOT PeakPagedPoolText;
+    PH_FORMAT_SLOT NonPagedPoolText;
+    PH_FORMAT_SLOT PeakNonPagedPoolText;
+    PH_FORMAT_SLOT MinimumWorkingSetText;
+    PH_FORMAT_SLOT MaximumWorkingSetText;
+    PH_FORMAT_SLOT PrivateBytesDeltaText;
 
     // Graph buffers
     PH_GRAPH_BUFFERS CpuGraphBuffers;
@@ -736,7 +736,7 @@ typedef struct _PH_THREAD_NODE
     ULONG ValidMask;
 
     WCHAR CpuUsageText[PH_INT32_STR_LEN_1];
-    PPH_STRING CyclesDeltaText; // used for Context Switches Delta as well
+    PH_FORMAT_SLOT CyclesDeltaText; // used for Context Switches Delta as well
     PPH_STRING StartAddressText;
     PPH_STRING PriorityText;
 // begin_phapppub
@@ -1091,16 +1091,16 @@ typedef struct _PH_MEMORY_NODE
 
     WCHAR BaseAddressText[PH_PTR_STR_LEN_1];
     WCHAR TypeText[30];
-    PPH_STRING SizeText;
+    PH_FORMAT_SLOT SizeText;
     WCHAR ProtectionText[17];
     PPH_STRING UseText;
-    PPH_STRING TotalWsText;
-    PPH_STRING PrivateWsText;
-    PPH_STRING ShareableWsText;
-    PPH_STRING SharedWsText;
-    PPH_STRING LockedWsText;
-    PPH_STRING CommittedText;
-    PPH_STRING PrivateText;
+    PH_FORMAT_SLOT TotalWsText;
+    PH_FORMAT_SLOT PrivateWsText;
+    PH_FORMAT_SLOT ShareableWsText;
+    PH_FORMAT_SLOT SharedWsText;
+    PH_FORMAT_SLOT LockedWsText;
+    PH_FORMAT_SLOT CommittedText;
+    PH_FORMAT_SLOT PrivateText;
 // begin_phapppub
 } PH_MEMORY_NODE, *PPH_MEMORY_NODE;
 // end_phapppub
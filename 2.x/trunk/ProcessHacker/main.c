@@ -75,6 +75,7 @@ PH_STARTUP_PARAMETERS PhStartupParameters;
 
 PH_PROVIDER_THREAD PhPrimaryProviderThread;
 PH_PROVIDER_THREAD PhSecondaryProviderThread;
+PH_PROVIDER_THREAD PhTertiaryProviderThread;
 
 static PPH_LIST DialogList = NULL;
 static PPH_LIST FilterList = NULL;
@@ -533,6 +534,8 @@ BOOLEAN PhInitializeAppSystem(
         return FALSE;
     if (!PhHandleProviderInitialization())
         return FALSE;
+    if (!PhHandleSnapshotInitialization())
+        return FALSE;
     if (!PhMemoryProviderInitialization())
         return FALSE;
     if (!PhProcessPropInitialization())
@@ -678,6 +681,9 @@ VOID PhpInitializeSettings(
 #define PH_ARG_PRIORITY 25
 #define PH_ARG_PLUGIN 26
 #define PH_ARG_SELECTTAB 27
+#define PH_ARG_RECORD 28
+#define PH_ARG_REPLAY 29
+#define PH_ARG_REPLAYSCALE 30
 
 BOOLEAN NTAPI PhpCommandLineOptionCallback(
     _In_opt_ PPH_COMMAND_LINE_OPTION Option,
@@ -799,6 +805,16 @@ BOOLEAN NTAPI PhpCommandLineOptionCallback(
         case PH_ARG_SELECTTAB:
             PhSwapReference(&PhStartupParameters.SelectTab, Value);
             break;
+        case PH_ARG_RECORD:
+            PhSwapReference(&PhStartupParameters.RecordFileName, Value);
+            break;
+        case PH_ARG_REPLAY:
+            PhSwapReference(&PhStartupParameters.ReplayFileName, Value);
+            break;
+        case PH_ARG_REPLAYSCALE:
+            if (PhStringToInteger64(&Value->sr, 0, &integer))
+                PhStartupParameters.ReplayScale = (ULONG)integer;
+            break;
         }
     }
     else
@@ -853,7 +869,10 @@ VOID PhpProcessStartupParameters(
         { PH_ARG_SELECTPID, L"selectpid", MandatoryArgumentType },
         { PH_ARG_PRIORITY, L"priority", MandatoryArgumentType },
         { PH_ARG_PLUGIN, L"plugin", MandatoryArgumentType },
-        { PH_ARG_SELECTTAB, L"selecttab", MandatoryArgumentType }
+        { PH_ARG_SELECTTAB, L"selecttab", MandatoryArgumentType },
+        { PH_ARG_RECORD, L"record", MandatoryArgumentType },
+        { PH_ARG_REPLAY, L"replay", MandatoryArgumentType },
+        { PH_ARG_REPLAYSCALE, L"replayscale", MandatoryArgumentType }
     };
     PH_STRINGREF commandLine;
 
@@ -889,6 +908,9 @@ VOID PhpProcessStartupParameters(
             L"-nosettings\n"
             L"-plugin pluginname:value\n"
             L"-priority r|h|n|l\n"
+            L"-record filename\n"
+            L"-replay filename\n"
+            L"-replayscale number-of-copies\n"
             L"-s\n"
             L"-selectpid pid-to-select\n"
             L"-selecttab name-of-tab-to-select\n"
@@ -951,6 +973,28 @@ VOID PhpProcessStartupParameters(
         // The symbol provider won't work if this is chosen.
         PhShowDebugConsole();
     }
+
+    if (PhStartupParameters.ReplayFileName)
+    {
+        NTSTATUS status;
+
+        status = PhStartSnapshotReplay(
+            PhStartupParameters.ReplayFileName->Buffer,
+            PhStartupParameters.ReplayScale != 0 ? PhStartupParameters.ReplayScale : 1
+            );
+
+        if (!NT_SUCCESS(status))
+            PhShowStatus(NULL, L"Unable to replay the snapshot file", status, 0);
+    }
+    else if (PhStartupParameters.RecordFileName)
+    {
+        NTSTATUS status;
+
+        status = PhStartSnapshotRecording(PhStartupParameters.RecordFileName->Buffer);
+
+        if (!NT_SUCCESS(status))
+            PhShowStatus(NULL, L"Unable to record to the snapshot file", status, 0);
+    }
 }
 
 VOID PhpEnablePrivileges(
@@ -102,6 +102,7 @@ static PH_CALLBACK_REGISTRATION ServiceRemovedRegistration;
 static PH_CALLBACK_REGISTRATION ServicesUpdatedRegistration;
 static PPH_POINTER_LIST ServicesPendingList;
 static BOOLEAN ServicesNeedsRedraw = FALSE;
+static BOOLEAN ServicesTabConsumer = FALSE;
 
 static PH_PROVIDER_REGISTRATION NetworkProviderRegistration;
 static PH_CALLBACK_REGISTRATION NetworkItemAddedRegistration;
@@ -230,6 +231,7 @@ BOOLEAN PhMainWndInitialization(
 
     PhStartProviderThread(&PhPrimaryProviderThread);
     PhStartProviderThread(&PhSecondaryProviderThread);
+    PhStartProviderThread(&PhTertiaryProviderThread);
 
     // See PhMwpOnTimer for more details.
     if (PhCsUpdateInterval > PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_1)
@@ -412,12 +414,23 @@ VOID PhMwpInitializeProviders(
 
     PhInitializeProviderThread(&PhPrimaryProviderThread, interval);
     PhInitializeProviderThread(&PhSecondaryProviderThread, interval);
+    PhInitializeProviderThread(&PhTertiaryProviderThread, interval);
 
     PhRegisterProvider(&PhPrimaryProviderThread, PhProcessProviderUpdate, NULL, &ProcessProviderRegistration);
     PhSetEnabledProvider(&ProcessProviderRegistration, TRUE);
-    PhRegisterProvider(&PhPrimaryProviderThread, PhServiceProviderUpdate, NULL, &ServiceProviderRegistration);
+
+    // Services and network connections are enumerated on their own thread so that a hung SCM
+    // or a slow connection table can't delay process updates, or the providers of process
+    // windows on the secondary thread.
+    PhRegisterProvider(&PhTertiaryProviderThread, PhServiceProviderUpdate, NULL, &ServiceProviderRegistration);
     PhSetEnabledProvider(&ServiceProviderRegistration, TRUE);
-    PhRegisterProvider(&PhPrimaryProviderThread, PhNetworkProviderUpdate, NULL, &NetworkProviderRegistration);
+    PhRegisterProvider(&PhTertiaryProviderThread, PhNetworkProviderUpdate, NULL, &NetworkProviderRegistration);
+
+    // The service provider only needs to run every tick while the services tab is visible.
+    // Push both providers back if they start taking too long, so that one of them can't
+    // starve the other.
+    PhSetIntervalProvider(&ServiceProviderRegistration, 0, PH_SERVICE_PROVIDER_IDLE_INTERVAL, PH_SLOW_PROVIDER_BUDGET);
+    PhSetIntervalProvider(&NetworkProviderRegistration, 0, 0, PH_SLOW_PROVIDER_BUDGET);
 }
 
 VOID PhMwpApplyUpdateInterval(
@@ -426,6 +439,7 @@ VOID PhMwpApplyUpdateInterval(
 {
     PhSetIntervalProviderThread(&PhPrimaryProviderThread, Interval);
     PhSetIntervalProviderThread(&PhSecondaryProviderThread, Interval);
+    PhSetIntervalProviderThread(&PhTertiaryProviderThread, Interval);
 
     if (Interval > PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM)
         SetTimer(PhMainWndHandle, TIMER_FLUSH_PROCESS_QUERY_DATA, PH_FLUSH_PROCESS_QUERY_DATA_INTERVAL_LONG_TERM, NULL);
@@ -3409,6 +3423,16 @@ VOID PhMwpSelectionChangedTabControl(
     if (selectedIndex == ServicesTabIndex)
         PhMwpNeedServiceTreeList();
 
+    if ((selectedIndex == ServicesTabIndex) != ServicesTabConsumer)
+    {
+        ServicesTabConsumer = !ServicesTabConsumer;
+
+        if (ServicesTabConsumer)
+            PhAddConsumerProvider(&ServiceProviderRegistration);
+        else
+            PhRemoveConsumerProvider(&ServiceProviderRegistration);
+    }
+
     if (selectedIndex == NetworkTabIndex)
     {
         PhMwpNeedNetworkTreeList();
@@ -202,15 +202,15 @@ VOID PhpDestroyMemoryNode(
 {
     PhEmCallObjectOperation(EmMemoryNodeType, MemoryNode, EmObjectDelete);
 
-    PhClearReference(&MemoryNode->SizeText);
+    PhDeleteFormatSlot(&MemoryNode->SizeText);
     PhClearReference(&MemoryNode->UseText);
-    PhClearReference(&MemoryNode->TotalWsText);
-    PhClearReference(&MemoryNode->PrivateWsText);
-    PhClearReference(&MemoryNode->ShareableWsText);
-    PhClearReference(&MemoryNode->SharedWsText);
-    PhClearReference(&MemoryNode->LockedWsText);
-    PhClearReference(&MemoryNode->CommittedText);
-    PhClearReference(&MemoryNode->PrivateText);
+    PhDeleteFormatSlot(&MemoryNode->TotalWsText);
+    PhDeleteFormatSlot(&MemoryNode->PrivateWsText);
+    PhDeleteFormatSlot(&MemoryNode->ShareableWsText);
+    PhDeleteFormatSlot(&MemoryNode->SharedWsText);
+    PhDeleteFormatSlot(&MemoryNode->LockedWsText);
+    PhDeleteFormatSlot(&MemoryNode->CommittedText);
+    PhDeleteFormatSlot(&MemoryNode->PrivateText);
 
     PhClearReference(&MemoryNode->Children);
     PhDereferenceObject(MemoryNode->MemoryItem);
@@ -433,14 +433,29 @@ VOID PhpUpdateMemoryNodeUseText(
         MemoryNode->UseText = PhpGetMemoryRegionUseText(MemoryNode->MemoryItem);
 }
 
-PPH_STRING PhpFormatSizeIfNonZero(
-    _In_ ULONG64 Size
+VOID PhpFormatSizeToSlot(
+    _In_ ULONG64 Size,
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _Out_ PPH_STRINGREF String
+    )
+{
+    PH_FORMAT format;
+
+    format.Type = SizeFormatType | FormatUseRadix;
+    format.Radix = 1;
+    format.u.Size = Size;
+
+    PhFormatToSlot(Slot, &format, 1, String);
+}
+
+VOID PhpFormatSizeIfNonZero(
+    _In_ ULONG64 Size,
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _Inout_ PPH_STRINGREF String
     )
 {
     if (Size != 0)
-        return PhFormatSize(Size, 1);
-    else
-        return NULL;
+        PhpFormatSizeToSlot(Size, Slot, String);
 }
 
 #define SORT_FUNCTION(Column) PhpMemoryTreeNewCompare##Column
@@ -554,6 +569,96 @@ BEGIN_SORT_FUNCTION(Private)
 }
 END_SORT_FUNCTION
 
+static VOID PhpSortMemoryNodes(
+    _In_ PPH_MEMORY_LIST_CONTEXT Context,
+    _In_ int (__cdecl *SortFunction)(void *, const void *, const void *)
+    )
+{
+    PPH_SORT_KEY_COMPARE_FUNCTION compareFunction;
+    PPH_SORT_KEY keys;
+    PPH_MEMORY_NODE node;
+    PPH_MEMORY_ITEM memoryItem;
+    PH_STRINGREF protectionText;
+    ULONG count;
+    ULONG i;
+
+    // String keys only contain a prefix, so nodes with equal string keys are still
+    // ordered by the sort function.
+
+    switch (Context->TreeNewSortColumn)
+    {
+    case PHMMTLC_PROTECTION:
+    case PHMMTLC_USE:
+        compareFunction = SortFunction;
+        break;
+    default:
+        compareFunction = NULL;
+        break;
+    }
+
+    count = Context->RegionNodeList->Count;
+    keys = PhAllocate(count * sizeof(PH_SORT_KEY));
+
+    for (i = 0; i < count; i++)
+    {
+        node = Context->RegionNodeList->Items[i];
+        memoryItem = node->MemoryItem;
+
+        switch (Context->TreeNewSortColumn)
+        {
+        case PHMMTLC_BASEADDRESS:
+            keys[i].Key = (ULONG_PTR)memoryItem->BaseAddress;
+            break;
+        case PHMMTLC_TYPE:
+            keys[i].Key = ((ULONG64)(memoryItem->Type | memoryItem->State) << 32) |
+                ((ULONG)memoryItem->RegionType ^ 0x80000000);
+            break;
+        case PHMMTLC_SIZE:
+            keys[i].Key = memoryItem->RegionSize;
+            break;
+        case PHMMTLC_PROTECTION:
+            PhInitializeStringRef(&protectionText, node->ProtectionText);
+            keys[i].Key = PhGetStringRefSortKey(&protectionText, FALSE);
+            break;
+        case PHMMTLC_USE:
+            PhpUpdateMemoryNodeUseText(node);
+            keys[i].Key = PhGetStringSortKey(node->UseText, TRUE);
+            break;
+        case PHMMTLC_TOTALWS:
+            keys[i].Key = memoryItem->TotalWorkingSetPages;
+            break;
+        case PHMMTLC_PRIVATEWS:
+            keys[i].Key = memoryItem->PrivateWorkingSetPages;
+            break;
+        case PHMMTLC_SHAREABLEWS:
+            keys[i].Key = memoryItem->ShareableWorkingSetPages;
+            break;
+        case PHMMTLC_SHAREDWS:
+            keys[i].Key = memoryItem->SharedWorkingSetPages;
+            break;
+        case PHMMTLC_LOCKEDWS:
+            keys[i].Key = memoryItem->LockedWorkingSetPages;
+            break;
+        case PHMMTLC_COMMITTED:
+            keys[i].Key = memoryItem->CommittedSize;
+            break;
+        case PHMMTLC_PRIVATE:
+            keys[i].Key = memoryItem->PrivateSize;
+            break;
+        }
+
+        keys[i].TieKey = (ULONG_PTR)memoryItem->BaseAddress;
+        keys[i].Item = node;
+    }
+
+    PhSortKeys(keys, count, Context->TreeNewSortOrder, compareFunction, Context);
+
+    for (i = 0; i < count; i++)
+        Context->RegionNodeList->Items[i] = keys[i].Item;
+
+    PhFree(keys);
+}
+
 BOOLEAN NTAPI PhpMemoryTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -632,7 +737,7 @@ BOOLEAN NTAPI PhpMemoryTreeNewCallback(
 
                     if (sortFunction)
                     {
-                        qsort_s(context->RegionNodeList->Items, context->RegionNodeList->Count, sizeof(PVOID), sortFunction, context);
+                        PhpSortMemoryNodes(context, sortFunction);
                     }
 
                     getChildren->Children = (PPH_TREENEW_NODE *)context->RegionNodeList->Items;
@@ -696,8 +801,7 @@ BOOLEAN NTAPI PhpMemoryTreeNewCallback(
                 }
                 break;
             case PHMMTLC_SIZE:
-                PhMoveReference(&node->SizeText, PhFormatSize(memoryItem->RegionSize, 1));
-                getCellText->Text = PhGetStringRef(node->SizeText);
+                PhpFormatSizeToSlot(memoryItem->RegionSize, &node->SizeText, &getCellText->Text);
                 break;
             case PHMMTLC_PROTECTION:
                 PhInitializeStringRefLongHint(&getCellText->Text, node->ProtectionText);
@@ -707,32 +811,25 @@ BOOLEAN NTAPI PhpMemoryTreeNewCallback(
                 getCellText->Text = PhGetStringRef(node->UseText);
                 break;
             case PHMMTLC_TOTALWS:
-                PhMoveReference(&node->TotalWsText, PhpFormatSizeIfNonZero((ULONG64)memoryItem->TotalWorkingSetPages * PAGE_SIZE));
-                getCellText->Text = PhGetStringRef(node->TotalWsText);
+                PhpFormatSizeIfNonZero((ULONG64)memoryItem->TotalWorkingSetPages * PAGE_SIZE, &node->TotalWsText, &getCellText->Text);
                 break;
             case PHMMTLC_PRIVATEWS:
-                PhMoveReference(&node->PrivateWsText, PhpFormatSizeIfNonZero((ULONG64)memoryItem->PrivateWorkingSetPages * PAGE_SIZE));
-                getCellText->Text = PhGetStringRef(node->PrivateWsText);
+                PhpFormatSizeIfNonZero((ULONG64)memoryItem->PrivateWorkingSetPages * PAGE_SIZE, &node->PrivateWsText, &getCellText->Text);
                 break;
             case PHMMTLC_SHAREABLEWS:
-                PhMoveReference(&node->ShareableWsText, PhpFormatSizeIfNonZero((ULONG64)memoryItem->ShareableWorkingSetPages * PAGE_SIZE));
-                getCellText->Text = PhGetStringRef(node->ShareableWsText);
+                PhpFormatSizeIfNonZero((ULONG64)memoryItem->ShareableWorkingSetPages * PAGE_SIZE, &node->ShareableWsText, &getCellText->Text);
                 break;
             case PHMMTLC_SHAREDWS:
-                PhMoveReference(&node->SharedWsText, PhpFormatSizeIfNonZero((ULONG64)memoryItem->SharedWorkingSetPages * PAGE_SIZE));
-                getCellText->Text = PhGetStringRef(node->SharedWsText);
+                PhpFormatSizeIfNonZero((ULONG64)memoryItem->SharedWorkingSetPages * PAGE_SIZE, &node->SharedWsText, &getCellText->Text);
                 break;
             case PHMMTLC_LOCKEDWS:
-                PhMoveReference(&node->LockedWsText, PhpFormatSizeIfNonZero((ULONG64)memoryItem->LockedWorkingSetPages * PAGE_SIZE));
-                getCellText->Text = PhGetStringRef(node->LockedWsText);
+                PhpFormatSizeIfNonZero((ULONG64)memoryItem->LockedWorkingSetPages * PAGE_SIZE, &node->LockedWsText, &getCellText->Text);
                 break;
             case PHMMTLC_COMMITTED:
-                PhMoveReference(&node->CommittedText, PhpFormatSizeIfNonZero(memoryItem->CommittedSize));
-                getCellText->Text = PhGetStringRef(node->CommittedText);
+                PhpFormatSizeIfNonZero(memoryItem->CommittedSize, &node->CommittedText, &getCellText->Text);
                 break;
             case PHMMTLC_PRIVATE:
-                PhMoveReference(&node->PrivateText, PhpFormatSizeIfNonZero(memoryItem->PrivateSize));
-                getCellText->Text = PhGetStringRef(node->PrivateText);
+                PhpFormatSizeIfNonZero(memoryItem->PrivateSize, &node->PrivateText, &getCellText->Text);
                 break;
             default:
                 return FALSE;
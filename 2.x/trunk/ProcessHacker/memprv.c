@@ -25,6 +25,7 @@
 
 #define MAX_HEAPS 1000
 #define WS_REQUEST_COUNT (PAGE_SIZE / sizeof(MEMORY_WORKING_SET_EX_INFORMATION))
+#define LOOKUP_BATCH_SIZE 8
 
 VOID PhpMemoryItemDeleteProcedure(
     _In_ PVOID Object,
@@ -159,17 +160,6 @@ VOID PhpMemoryItemDeleteProcedure(
     }
 }
 
-static LONG NTAPI PhpMemoryItemCompareFunction(
-    _In_ PPH_AVL_LINKS Links1,
-    _In_ PPH_AVL_LINKS Links2
-    )
-{
-    PPH_MEMORY_ITEM memoryItem1 = CONTAINING_RECORD(Links1, PH_MEMORY_ITEM, Links);
-    PPH_MEMORY_ITEM memoryItem2 = CONTAINING_RECORD(Links2, PH_MEMORY_ITEM, Links);
-
-    return uintptrcmp((ULONG_PTR)memoryItem1->BaseAddress, (ULONG_PTR)memoryItem2->BaseAddress);
-}
-
 VOID PhDeleteMemoryItemList(
     _In_ PPH_MEMORY_ITEM_LIST List
     )
@@ -186,6 +176,77 @@ VOID PhDeleteMemoryItemList(
 
         PhDereferenceObject(memoryItem);
     }
+
+    if (List->BaseAddresses)
+        PhFree(List->BaseAddresses);
+}
+
+/**
+ * Builds the address index of a memory item list.
+ *
+ * \param List The memory item list. The items in the list must be in
+ * ascending order of base address.
+ * \param NumberOfItems The number of items in the list.
+ */
+static VOID PhpBuildMemoryItemListIndex(
+    _Inout_ PPH_MEMORY_ITEM_LIST List,
+    _In_ ULONG NumberOfItems
+    )
+{
+    PLIST_ENTRY listEntry;
+    PPH_MEMORY_ITEM memoryItem;
+    ULONG i;
+
+    List->NumberOfItems = NumberOfItems;
+
+    if (NumberOfItems == 0)
+        return;
+
+    // NtQueryVirtualMemory returns regions in ascending order, so the list is already sorted.
+    // The base addresses are kept in their own array so that a search only touches the
+    // addresses.
+
+    List->BaseAddresses = PhAllocate(NumberOfItems * (sizeof(ULONG_PTR) + sizeof(PPH_MEMORY_ITEM)));
+    List->Items = (PPH_MEMORY_ITEM *)(List->BaseAddresses + NumberOfItems);
+    i = 0;
+
+    for (listEntry = List->ListHead.Flink; listEntry != &List->ListHead; listEntry = listEntry->Flink)
+    {
+        memoryItem = CONTAINING_RECORD(listEntry, PH_MEMORY_ITEM, ListEntry);
+
+        assert(i == 0 || List->BaseAddresses[i - 1] < (ULONG_PTR)memoryItem->BaseAddress);
+        List->BaseAddresses[i] = (ULONG_PTR)memoryItem->BaseAddress;
+        List->Items[i] = memoryItem;
+        i++;
+    }
+
+    assert(i == NumberOfItems);
+}
+
+/**
+ * Gets the memory item which contains an address, given the
+ * result of a search of the address index.
+ */
+FORCEINLINE PPH_MEMORY_ITEM PhpGetMemoryItemFromIndex(
+    _In_ PPH_MEMORY_ITEM_LIST List,
+    _In_ PULONG_PTR Base,
+    _In_ ULONG_PTR Address
+    )
+{
+    PPH_MEMORY_ITEM memoryItem;
+
+    // Base points to the largest base address that is not larger than the given address, or
+    // to the first base address if there is no such address.
+
+    if (*Base > Address)
+        return NULL;
+
+    memoryItem = List->Items[Base - List->BaseAddresses];
+
+    if (Address - *Base < memoryItem->RegionSize)
+        return memoryItem;
+    else
+        return NULL;
 }
 
 PPH_MEMORY_ITEM PhLookupMemoryItemList(
@@ -193,51 +254,109 @@ PPH_MEMORY_ITEM PhLookupMemoryItemList(
     _In_ PVOID Address
     )
 {
-    PH_MEMORY_ITEM lookupMemoryItem;
-    PPH_AVL_LINKS links;
-    PPH_MEMORY_ITEM memoryItem;
-    LONG result;
+    PULONG_PTR base;
+    ULONG count;
+    ULONG half;
+
+    if (List->NumberOfItems == 0)
+        return NULL;
+
+    // Locate the largest base address that is not larger than the given address. The search
+    // has no data-dependent branches; the conditional expression compiles to a conditional
+    // move.
 
-    // Do an approximate search on the set to locate the memory item with the largest
-    // base address that is still smaller than the given address.
-    lookupMemoryItem.BaseAddress = Address;
-    links = PhFindElementAvlTree2(&List->Set, &lookupMemoryItem.Links, &result);
-    memoryItem = NULL;
+    base = List->BaseAddresses;
+    count = List->NumberOfItems;
 
-    if (links)
+    while (count > 1)
     {
-        if (result == 0)
-        {
-            // Exact match.
-        }
-        else if (result < 0)
-        {
-            // The base of the closest known memory region is larger than our address. Assume the
-            // preceding element (which is going to be smaller than our address) is the
-            // one we're looking for.
+        half = count / 2;
+        base = base[half] <= (ULONG_PTR)Address ? base + half : base;
+        count -= half;
+    }
 
-            links = PhPredecessorElementAvlTree(links);
-        }
-        else
-        {
-            // The base of the closest known memory region is smaller than our address. Assume this
-            // is the element we're looking for.
-        }
+    return PhpGetMemoryItemFromIndex(List, base, (ULONG_PTR)Address);
+}
 
-        if (links)
-        {
-            memoryItem = CONTAINING_RECORD(links, PH_MEMORY_ITEM, Links);
-        }
+/**
+ * Looks up multiple addresses in a memory item list.
+ *
+ * \param List The memory item list.
+ * \param NumberOfAddresses The number of addresses.
+ * \param Addresses The addresses to look up.
+ * \param MemoryItems An array which receives the memory item
+ * containing each address, or NULL if an address is not in any
+ * memory item. The memory items are not referenced.
+ *
+ * \remarks This is faster than calling PhLookupMemoryItemList()
+ * for each address because several searches are advanced in
+ * lockstep, so their cache misses overlap.
+ */
+VOID PhLookupMemoryItemsList(
+    _In_ PPH_MEMORY_ITEM_LIST List,
+    _In_ ULONG NumberOfAddresses,
+    _In_reads_(NumberOfAddresses) PVOID *Addresses,
+    _Out_writes_(NumberOfAddresses) PPH_MEMORY_ITEM *MemoryItems
+    )
+{
+    PULONG_PTR bases[LOOKUP_BATCH_SIZE];
+    ULONG count;
+    ULONG half;
+    ULONG batchSize;
+    ULONG i;
+    ULONG j;
+
+    if (List->NumberOfItems == 0)
+    {
+        memset(MemoryItems, 0, NumberOfAddresses * sizeof(PPH_MEMORY_ITEM));
+        return;
     }
-    else
+
+    for (i = 0; i < NumberOfAddresses; i += batchSize)
     {
-        // No modules loaded.
+        batchSize = min(NumberOfAddresses - i, LOOKUP_BATCH_SIZE);
+
+        for (j = 0; j < batchSize; j++)
+            bases[j] = List->BaseAddresses;
+
+        // Every search takes the same number of steps because the step sizes only depend on
+        // the number of items.
+
+        count = List->NumberOfItems;
+
+        while (count > 1)
+        {
+            half = count / 2;
+
+            for (j = 0; j < batchSize; j++)
+                bases[j] = bases[j][half] <= (ULONG_PTR)Addresses[i + j] ? bases[j] + half : bases[j];
+
+            count -= half;
+        }
+
+        for (j = 0; j < batchSize; j++)
+            MemoryItems[i + j] = PhpGetMemoryItemFromIndex(List, bases[j], (ULONG_PTR)Addresses[i + j]);
     }
+}
 
-    if (memoryItem && (ULONG_PTR)Address < (ULONG_PTR)memoryItem->BaseAddress + memoryItem->RegionSize)
-        return memoryItem;
-    else
+static PPH_MEMORY_ITEM PhpSetMemoryItemRegionType(
+    _In_opt_ PPH_MEMORY_ITEM MemoryItem,
+    _In_ BOOLEAN GoToAllocationBase,
+    _In_ PH_MEMORY_REGION_TYPE RegionType
+    )
+{
+    if (!MemoryItem)
+        return NULL;
+
+    if (GoToAllocationBase && MemoryItem->AllocationBaseItem)
+        MemoryItem = MemoryItem->AllocationBaseItem;
+
+    if (MemoryItem->RegionType != UnknownRegion)
         return NULL;
+
+    MemoryItem->RegionType = RegionType;
+
+    return MemoryItem;
 }
 
 PPH_MEMORY_ITEM PhpSetMemoryRegionType(
@@ -247,22 +366,30 @@ PPH_MEMORY_ITEM PhpSetMemoryRegionType(
     _In_ PH_MEMORY_REGION_TYPE RegionType
     )
 {
-    PPH_MEMORY_ITEM memoryItem;
-
-    memoryItem = PhLookupMemoryItemList(List, Address);
-
-    if (!memoryItem)
-        return NULL;
+    return PhpSetMemoryItemRegionType(PhLookupMemoryItemList(List, Address), GoToAllocationBase, RegionType);
+}
 
-    if (GoToAllocationBase && memoryItem->AllocationBaseItem)
-        memoryItem = memoryItem->AllocationBaseItem;
+static VOID PhpSetMemoryHeapRegionTypes(
+    _In_ PPH_MEMORY_ITEM_LIST List,
+    _In_reads_(NumberOfHeaps) PVOID *Heaps,
+    _In_ ULONG NumberOfHeaps,
+    _In_ PH_MEMORY_REGION_TYPE RegionType
+    )
+{
+    PPH_MEMORY_ITEM *heapItems;
+    PPH_MEMORY_ITEM memoryItem;
+    ULONG i;
 
-    if (memoryItem->RegionType != UnknownRegion)
-        return NULL;
+    heapItems = PhAllocate(NumberOfHeaps * sizeof(PPH_MEMORY_ITEM));
+    PhLookupMemoryItemsList(List, NumberOfHeaps, Heaps, heapItems);
 
-    memoryItem->RegionType = RegionType;
+    for (i = 0; i < NumberOfHeaps; i++)
+    {
+        if (memoryItem = PhpSetMemoryItemRegionType(heapItems[i], TRUE, RegionType))
+            memoryItem->u.Heap.Index = i;
+    }
 
-    return memoryItem;
+    PhFree(heapItems);
 }
 
 NTSTATUS PhpUpdateMemoryRegionTypes(
@@ -324,11 +451,7 @@ NTSTATUS PhpUpdateMemoryRegionTypes(
                     processHeapsPtr,
                     processHeaps, numberOfHeaps * sizeof(PVOID), NULL)))
                 {
-                    for (i = 0; i < numberOfHeaps; i++)
-                    {
-                        if (memoryItem = PhpSetMemoryRegionType(List, processHeaps[i], TRUE, HeapRegion))
-                            memoryItem->u.Heap.Index = i;
-                    }
+                    PhpSetMemoryHeapRegionTypes(List, processHeaps, numberOfHeaps, HeapRegion);
                 }
 
                 PhFree(processHeaps);
@@ -354,11 +477,13 @@ NTSTATUS PhpUpdateMemoryRegionTypes(
                     (PVOID)processHeapsPtr32,
                     processHeaps32, numberOfHeaps * sizeof(ULONG), NULL)))
                 {
+                    processHeaps = PhAllocate(numberOfHeaps * sizeof(PVOID));
+
                     for (i = 0; i < numberOfHeaps; i++)
-                    {
-                        if (memoryItem = PhpSetMemoryRegionType(List, (PVOID)processHeaps32[i], TRUE, Heap32Region))
-                            memoryItem->u.Heap.Index = i;
-                    }
+                        processHeaps[i] = (PVOID)processHeaps32[i];
+
+                    PhpSetMemoryHeapRegionTypes(List, processHeaps, numberOfHeaps, Heap32Region);
+                    PhFree(processHeaps);
                 }
 
                 PhFree(processHeaps32);
@@ -368,40 +493,68 @@ NTSTATUS PhpUpdateMemoryRegionTypes(
     }
 
     // TEB, stack
-    for (i = 0; i < process->NumberOfThreads; i++)
+    if (process->NumberOfThreads != 0)
     {
-        PSYSTEM_EXTENDED_THREAD_INFORMATION thread = (PSYSTEM_EXTENDED_THREAD_INFORMATION)process->Threads + i;
+        PVOID *addresses;
+#ifdef _WIN64
+        PVOID *addresses32;
+#endif
+        PPH_MEMORY_ITEM *memoryItems;
+
+        // The regions are looked up in batches. The addresses of all TEBs are collected first,
+        // then the addresses of all stacks, which are read from the TEBs.
 
-        if (WindowsVersion < WINDOWS_VISTA)
+        addresses = PhAllocate(process->NumberOfThreads * sizeof(PVOID));
+#ifdef _WIN64
+        addresses32 = PhAllocate(process->NumberOfThreads * sizeof(PVOID));
+#endif
+        memoryItems = PhAllocate(process->NumberOfThreads * sizeof(PPH_MEMORY_ITEM));
+
+        for (i = 0; i < process->NumberOfThreads; i++)
         {
-            HANDLE threadHandle;
-            THREAD_BASIC_INFORMATION basicInfo;
+            PSYSTEM_EXTENDED_THREAD_INFORMATION thread = (PSYSTEM_EXTENDED_THREAD_INFORMATION)process->Threads + i;
 
-            if (NT_SUCCESS(PhOpenThread(&threadHandle, ThreadQueryAccess, thread->ThreadInfo.ClientId.UniqueThread)))
+            if (WindowsVersion < WINDOWS_VISTA)
             {
-                if (NT_SUCCESS(PhGetThreadBasicInformation(threadHandle, &basicInfo)))
-                    thread->TebBase = basicInfo.TebBaseAddress;
+                HANDLE threadHandle;
+                THREAD_BASIC_INFORMATION basicInfo;
+
+                if (NT_SUCCESS(PhOpenThread(&threadHandle, ThreadQueryAccess, thread->ThreadInfo.ClientId.UniqueThread)))
+                {
+                    if (NT_SUCCESS(PhGetThreadBasicInformation(threadHandle, &basicInfo)))
+                        thread->TebBase = basicInfo.TebBaseAddress;
 
-                NtClose(threadHandle);
+                    NtClose(threadHandle);
+                }
             }
+
+            addresses[i] = thread->TebBase;
         }
 
-        if (thread->TebBase)
+        PhLookupMemoryItemsList(List, process->NumberOfThreads, addresses, memoryItems);
+
+        for (i = 0; i < process->NumberOfThreads; i++)
         {
+            PSYSTEM_EXTENDED_THREAD_INFORMATION thread = (PSYSTEM_EXTENDED_THREAD_INFORMATION)process->Threads + i;
             NT_TIB ntTib;
             SIZE_T bytesRead;
 
-            if (memoryItem = PhpSetMemoryRegionType(List, thread->TebBase, TRUE, TebRegion))
+            addresses[i] = NULL;
+#ifdef _WIN64
+            addresses32[i] = NULL;
+#endif
+
+            if (!thread->TebBase)
+                continue;
+
+            if (memoryItem = PhpSetMemoryItemRegionType(memoryItems[i], TRUE, TebRegion))
                 memoryItem->u.Teb.ThreadId = thread->ThreadInfo.ClientId.UniqueThread;
 
             if (NT_SUCCESS(PhReadVirtualMemory(ProcessHandle, thread->TebBase, &ntTib, sizeof(NT_TIB), &bytesRead)) &&
                 bytesRead == sizeof(NT_TIB))
             {
                 if ((ULONG_PTR)ntTib.StackLimit < (ULONG_PTR)ntTib.StackBase)
-                {
-                    if (memoryItem = PhpSetMemoryRegionType(List, ntTib.StackLimit, TRUE, StackRegion))
-                        memoryItem->u.Stack.ThreadId = thread->ThreadInfo.ClientId.UniqueThread;
-                }
+                    addresses[i] = ntTib.StackLimit;
 #ifdef _WIN64
 
                 if (isWow64 && ntTib.ExceptionList)
@@ -416,15 +569,41 @@ NTSTATUS PhpUpdateMemoryRegionTypes(
                         bytesRead == sizeof(NT_TIB32))
                     {
                         if (ntTib32.StackLimit < ntTib32.StackBase)
-                        {
-                            if (memoryItem = PhpSetMemoryRegionType(List, (PVOID)ntTib32.StackLimit, TRUE, Stack32Region))
-                                memoryItem->u.Stack.ThreadId = thread->ThreadInfo.ClientId.UniqueThread;
-                        }
+                            addresses32[i] = (PVOID)ntTib32.StackLimit;
                     }
                 }
 #endif
             }
         }
+
+        PhLookupMemoryItemsList(List, process->NumberOfThreads, addresses, memoryItems);
+
+        for (i = 0; i < process->NumberOfThreads; i++)
+        {
+            PSYSTEM_EXTENDED_THREAD_INFORMATION thread = (PSYSTEM_EXTENDED_THREAD_INFORMATION)process->Threads + i;
+
+            if (addresses[i] && (memoryItem = PhpSetMemoryItemRegionType(memoryItems[i], TRUE, StackRegion)))
+                memoryItem->u.Stack.ThreadId = thread->ThreadInfo.ClientId.UniqueThread;
+        }
+#ifdef _WIN64
+
+        if (isWow64)
+        {
+            PhLookupMemoryItemsList(List, process->NumberOfThreads, addresses32, memoryItems);
+
+            for (i = 0; i < process->NumberOfThreads; i++)
+            {
+                PSYSTEM_EXTENDED_THREAD_INFORMATION thread = (PSYSTEM_EXTENDED_THREAD_INFORMATION)process->Threads + i;
+
+                if (addresses32[i] && (memoryItem = PhpSetMemoryItemRegionType(memoryItems[i], TRUE, Stack32Region)))
+                    memoryItem->u.Stack.ThreadId = thread->ThreadInfo.ClientId.UniqueThread;
+            }
+        }
+
+        PhFree(addresses32);
+#endif
+        PhFree(memoryItems);
+        PhFree(addresses);
     }
 
     // Mapped file, heap segment, unusable
@@ -647,6 +826,7 @@ NTSTATUS PhQueryMemoryItemList(
     MEMORY_BASIC_INFORMATION basicInfo;
     PPH_MEMORY_ITEM allocationBaseItem = NULL;
     PPH_MEMORY_ITEM previousMemoryItem = NULL;
+    ULONG numberOfItems;
 
     if (!NT_SUCCESS(status = PhOpenProcess(
         &processHandle,
@@ -665,8 +845,11 @@ NTSTATUS PhQueryMemoryItemList(
     }
 
     List->ProcessId = ProcessId;
-    PhInitializeAvlTree(&List->Set, PhpMemoryItemCompareFunction);
     InitializeListHead(&List->ListHead);
+    List->NumberOfItems = 0;
+    List->BaseAddresses = NULL;
+    List->Items = NULL;
+    numberOfItems = 0;
 
     allocationGranularity = PhSystemBasicInformation.AllocationGranularity;
 
@@ -705,8 +888,8 @@ NTSTATUS PhQueryMemoryItemList(
                 memoryItem->PrivateSize = memoryItem->RegionSize;
         }
 
-        PhAddElementAvlTree(&List->Set, &memoryItem->Links);
         InsertTailList(&List->ListHead, &memoryItem->ListEntry);
+        numberOfItems++;
 
         if (basicInfo.State & MEM_FREE)
         {
@@ -739,8 +922,8 @@ NTSTATUS PhQueryMemoryItemList(
                     otherMemoryItem->RegionSize = basicInfo.RegionSize - potentialUnusableSize;
                     otherMemoryItem->AllocationBaseItem = otherMemoryItem;
 
-                    PhAddElementAvlTree(&List->Set, &otherMemoryItem->Links);
                     InsertTailList(&List->ListHead, &otherMemoryItem->ListEntry);
+                    numberOfItems++;
 
                     previousMemoryItem = otherMemoryItem;
                     goto ContinueLoop;
@@ -754,6 +937,8 @@ ContinueLoop:
         baseAddress = PTR_ADD_OFFSET(baseAddress, basicInfo.RegionSize);
     }
 
+    PhpBuildMemoryItemListIndex(List, numberOfItems);
+
     if (Flags & PH_QUERY_MEMORY_REGION_TYPE)
         PhpUpdateMemoryRegionTypes(List, processHandle);
 
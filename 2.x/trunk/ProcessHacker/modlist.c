@@ -479,6 +479,123 @@ BEGIN_SORT_FUNCTION(LoadReason)
 }
 END_SORT_FUNCTION
 
+static VOID PhpSortModuleNodes(
+    _In_ PPH_MODULE_LIST_CONTEXT Context,
+    _In_ int (__cdecl *SortFunction)(void *, const void *, const void *)
+    )
+{
+    PPH_SORT_KEY_COMPARE_FUNCTION compareFunction;
+    PPH_SORT_KEY keys;
+    PPH_MODULE_NODE node;
+    PPH_MODULE_ITEM moduleItem;
+    ULONG count;
+    ULONG i;
+
+    // String keys only contain a prefix, so nodes with equal string keys are still
+    // ordered by the sort function.
+
+    if (Context->TreeNewSortOrder == NoSortOrder)
+    {
+        compareFunction = SortFunction;
+    }
+    else
+    {
+        switch (Context->TreeNewSortColumn)
+        {
+        case PHMOTLC_NAME:
+        case PHMOTLC_DESCRIPTION:
+        case PHMOTLC_COMPANYNAME:
+        case PHMOTLC_VERSION:
+        case PHMOTLC_FILENAME:
+        case PHMOTLC_VERIFIEDSIGNER:
+            compareFunction = SortFunction;
+            break;
+        default:
+            compareFunction = NULL;
+            break;
+        }
+    }
+
+    count = Context->NodeList->Count;
+    keys = PhAllocate(count * sizeof(PH_SORT_KEY));
+
+    for (i = 0; i < count; i++)
+    {
+        node = Context->NodeList->Items[i];
+        moduleItem = node->ModuleItem;
+
+        if (Context->TreeNewSortOrder == NoSortOrder)
+        {
+            // The first module always comes first, and the rest are sorted by name.
+            keys[i].Key = moduleItem->IsFirst ? 0 : PhGetStringSortKey(moduleItem->Name, TRUE);
+        }
+        else
+        {
+            switch (Context->TreeNewSortColumn)
+            {
+            case PHMOTLC_NAME:
+                keys[i].Key = PhGetStringSortKey(moduleItem->Name, TRUE);
+                break;
+            case PHMOTLC_BASEADDRESS:
+                keys[i].Key = (ULONG_PTR)moduleItem->BaseAddress;
+                break;
+            case PHMOTLC_SIZE:
+                keys[i].Key = moduleItem->Size;
+                break;
+            case PHMOTLC_DESCRIPTION:
+                keys[i].Key = PhGetStringSortKey(moduleItem->VersionInfo.FileDescription, TRUE);
+                break;
+            case PHMOTLC_COMPANYNAME:
+                keys[i].Key = PhGetStringSortKey(moduleItem->VersionInfo.CompanyName, TRUE);
+                break;
+            case PHMOTLC_VERSION:
+                keys[i].Key = PhGetStringSortKey(moduleItem->VersionInfo.FileVersion, TRUE);
+                break;
+            case PHMOTLC_FILENAME:
+                keys[i].Key = PhGetStringSortKey(moduleItem->FileName, TRUE);
+                break;
+            case PHMOTLC_TYPE:
+                keys[i].Key = moduleItem->Type;
+                break;
+            case PHMOTLC_LOADCOUNT:
+                keys[i].Key = moduleItem->LoadCount;
+                break;
+            case PHMOTLC_VERIFICATIONSTATUS:
+                keys[i].Key = PhSortKeyFromInt64(moduleItem->VerifyResult);
+                break;
+            case PHMOTLC_VERIFIEDSIGNER:
+                keys[i].Key = PhGetStringSortKey(moduleItem->VerifySignerName, TRUE);
+                break;
+            case PHMOTLC_ASLR:
+                keys[i].Key = moduleItem->ImageDllCharacteristics & IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE;
+                break;
+            case PHMOTLC_TIMESTAMP:
+                keys[i].Key = moduleItem->ImageTimeDateStamp;
+                break;
+            case PHMOTLC_CFGUARD:
+                keys[i].Key = moduleItem->ImageDllCharacteristics & IMAGE_DLLCHARACTERISTICS_GUARD_CF;
+                break;
+            case PHMOTLC_LOADTIME:
+                keys[i].Key = moduleItem->LoadTime.QuadPart;
+                break;
+            case PHMOTLC_LOADREASON:
+                keys[i].Key = moduleItem->LoadReason;
+                break;
+            }
+        }
+
+        keys[i].TieKey = (ULONG_PTR)moduleItem->BaseAddress;
+        keys[i].Item = node;
+    }
+
+    PhSortKeys(keys, count, Context->TreeNewSortOrder, compareFunction, Context);
+
+    for (i = 0; i < count; i++)
+        Context->NodeList->Items[i] = keys[i].Item;
+
+    PhFree(keys);
+}
+
 BOOLEAN NTAPI PhpModuleTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -551,7 +668,7 @@ BOOLEAN NTAPI PhpModuleTreeNewCallback(
 
                 if (sortFunction)
                 {
-                    qsort_s(context->NodeList->Items, context->NodeList->Count, sizeof(PVOID), sortFunction, context);
+                    PhpSortModuleNodes(context, sortFunction);
                 }
 
                 getChildren->Children = (PPH_TREENEW_NODE *)context->NodeList->Items;
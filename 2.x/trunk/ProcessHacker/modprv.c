@@ -78,11 +78,12 @@ PPH_MODULE_PROVIDER PhCreateModuleProvider(
         PhModuleProviderType
         );
 
-    moduleProvider->ModuleHashtable = PhCreateHashtable(
+    moduleProvider->ModuleHashtable = PhCreateHashtableEx(
         sizeof(PPH_MODULE_ITEM),
         PhpModuleHashtableCompareFunction,
         PhpModuleHashtableHashFunction,
-        20
+        20,
+        PH_HASHTABLE_OPEN_ADDRESSING
         );
     PhInitializeFastLock(&moduleProvider->ModuleHashtableLock);
 
@@ -302,22 +303,38 @@ NTSTATUS PhpModuleQueryWorker(
 
 VOID PhpQueueModuleQuery(
     _In_ PPH_MODULE_PROVIDER ModuleProvider,
-    _In_ PPH_MODULE_ITEM ModuleItem
+    _In_ PPH_LIST ModuleItems
     )
 {
+    PPH_WORK_QUEUE_ITEM_DESCRIPTOR items;
     PPH_MODULE_QUERY_DATA data;
+    ULONG i;
 
     if (!PhEnableProcessQueryStage2)
         return;
 
-    data = PhAllocate(sizeof(PH_MODULE_QUERY_DATA));
-    memset(data, 0, sizeof(PH_MODULE_QUERY_DATA));
-    data->ModuleProvider = ModuleProvider;
-    data->ModuleItem = ModuleItem;
+    // All queries of an update are queued together, so the work queue is locked and
+    // signaled once instead of once for each module.
+    items = PhAllocate(sizeof(PH_WORK_QUEUE_ITEM_DESCRIPTOR) * ModuleItems->Count);
 
-    PhReferenceObject(ModuleProvider);
-    PhReferenceObject(ModuleItem);
-    PhQueueItemGlobalWorkQueue(PhpModuleQueryWorker, data);
+    for (i = 0; i < ModuleItems->Count; i++)
+    {
+        data = PhAllocate(sizeof(PH_MODULE_QUERY_DATA));
+        memset(data, 0, sizeof(PH_MODULE_QUERY_DATA));
+        data->ModuleProvider = ModuleProvider;
+        data->ModuleItem = ModuleItems->Items[i];
+
+        PhReferenceObject(ModuleProvider);
+        PhReferenceObject(data->ModuleItem);
+
+        items[i].Function = PhpModuleQueryWorker;
+        items[i].Context = data;
+        items[i].DeleteFunction = NULL;
+        items[i].Priority = PH_WORK_QUEUE_PRIORITY_LOW;
+    }
+
+    PhQueueItemsGlobalWorkQueue(items, ModuleItems->Count);
+    PhFree(items);
 }
 
 static BOOLEAN NTAPI EnumModulesCallback(
@@ -342,17 +359,22 @@ VOID PhModuleProviderUpdate(
 {
     PPH_MODULE_PROVIDER moduleProvider = (PPH_MODULE_PROVIDER)Object;
     PPH_LIST modules;
+    PPH_LIST moduleItemsToQuery = NULL;
     ULONG i;
+    PH_SNAPSHOT_TICK snapshotTick;
 
     // If we didn't get a handle when we created the provider,
     // abort (unless this is the System process - in that case
     // we don't need a handle).
-    if (!moduleProvider->ProcessHandle && moduleProvider->ProcessId != SYSTEM_PROCESS_ID)
+    if (!moduleProvider->ProcessHandle && moduleProvider->ProcessId != SYSTEM_PROCESS_ID &&
+        PhSnapshotMode != PH_SNAPSHOT_MODE_REPLAY)
         goto UpdateExit;
 
+    PhBeginSnapshotTick(&snapshotTick);
+
     modules = PhCreateList(20);
 
-    moduleProvider->RunStatus = PhEnumGenericModules(
+    moduleProvider->RunStatus = PhSnapshotEnumGenericModules(
         moduleProvider->ProcessId,
         moduleProvider->ProcessHandle,
         PH_ENUM_GENERIC_MAPPED_FILES | PH_ENUM_GENERIC_MAPPED_IMAGES,
@@ -453,15 +475,16 @@ VOID PhModuleProviderUpdate(
             moduleItem->LoadCount = module->LoadCount;
             moduleItem->LoadTime = module->LoadTime;
 
-            moduleItem->Name = module->Name;
-            PhReferenceObject(moduleItem->Name);
-            moduleItem->FileName = module->FileName;
-            PhReferenceObject(moduleItem->FileName);
+            // The same DLLs are loaded into most processes, so share the names and version
+            // information between module items.
+            moduleItem->Name = PhInternStringRef(&module->Name->sr);
+            moduleItem->FileName = PhInternStringRef(&module->FileName->sr);
 
             PhInitializeImageVersionInfo(
                 &moduleItem->VersionInfo,
                 PhGetString(moduleItem->FileName)
                 );
+            PhInternImageVersionInfo(&moduleItem->VersionInfo);
 
             moduleItem->IsFirst = i == 0;
 
@@ -521,7 +544,12 @@ VOID PhModuleProviderUpdate(
                 moduleItem->VerifyResult = PhVerifyFileCached(moduleItem->FileName, NULL, &moduleItem->VerifySignerName, TRUE);
 
                 if (moduleItem->VerifyResult == VrUnknown)
-                    PhpQueueModuleQuery(moduleProvider, moduleItem);
+                {
+                    if (!moduleItemsToQuery)
+                        moduleItemsToQuery = PhCreateList(32);
+
+                    PhAddItemList(moduleItemsToQuery, moduleItem);
+                }
             }
 
             // Add the module item to the hashtable.
@@ -548,6 +576,12 @@ VOID PhModuleProviderUpdate(
         }
     }
 
+    if (moduleItemsToQuery)
+    {
+        PhpQueueModuleQuery(moduleProvider, moduleItemsToQuery);
+        PhDereferenceObject(moduleItemsToQuery);
+    }
+
     // Free the modules list.
 
     for (i = 0; i < modules->Count; i++)
@@ -561,6 +595,8 @@ VOID PhModuleProviderUpdate(
 
     PhDereferenceObject(modules);
 
+    PhEndSnapshotTick(PH_SNAPSHOT_MODULES, &snapshotTick);
+
 UpdateExit:
     PhInvokeCallback(&moduleProvider->UpdatedEvent, NULL);
 }
@@ -155,11 +155,12 @@ BOOLEAN PhNetworkProviderInitialization(
     )
 {
     PhNetworkItemType = PhCreateObjectType(L"NetworkItem", 0, PhpNetworkItemDeleteProcedure);
-    PhNetworkHashtable = PhCreateHashtable(
+    PhNetworkHashtable = PhCreateHashtableEx(
         sizeof(PPH_NETWORK_ITEM),
         PhpNetworkHashtableCompareFunction,
         PhpNetworkHashtableHashFunction,
-        40
+        40,
+        PH_HASHTABLE_OPEN_ADDRESSING
         );
 
     RtlInitializeSListHead(&PhNetworkItemQueryListHead);
@@ -505,6 +506,38 @@ VOID PhpUpdateNetworkItemOwner(
     }
 }
 
+static BOOLEAN PhpSnapshotGetNetworkConnections(
+    _Out_ PPH_NETWORK_CONNECTION *Connections,
+    _Out_ PULONG NumberOfConnections
+    )
+{
+    PPH_NETWORK_CONNECTION connections;
+    ULONG numberOfConnections;
+    ULONG size;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_REPLAY)
+    {
+        if (!(connections = PhReplaySnapshot(PH_SNAPSHOT_NETWORK, &size)))
+            return FALSE;
+
+        *Connections = connections;
+        *NumberOfConnections = size / sizeof(PH_NETWORK_CONNECTION);
+
+        return TRUE;
+    }
+
+    if (!PhGetNetworkConnections(&connections, &numberOfConnections))
+        return FALSE;
+
+    // The connection list does not contain any pointers, so it can be recorded as is.
+    PhRecordSnapshot(PH_SNAPSHOT_NETWORK, 0, connections, numberOfConnections * sizeof(PH_NETWORK_CONNECTION));
+
+    *Connections = connections;
+    *NumberOfConnections = numberOfConnections;
+
+    return TRUE;
+}
+
 VOID PhNetworkProviderUpdate(
     _In_ PVOID Object
     )
@@ -512,6 +545,7 @@ VOID PhNetworkProviderUpdate(
     PPH_NETWORK_CONNECTION connections;
     ULONG numberOfConnections;
     ULONG i;
+    PH_SNAPSHOT_TICK snapshotTick;
 
     if (!NetworkImportDone)
     {
@@ -537,7 +571,9 @@ VOID PhNetworkProviderUpdate(
         NetworkImportDone = TRUE;
     }
 
-    if (!PhGetNetworkConnections(&connections, &numberOfConnections))
+    PhBeginSnapshotTick(&snapshotTick);
+
+    if (!PhpSnapshotGetNetworkConnections(&connections, &numberOfConnections))
         return;
 
     {
@@ -783,6 +819,8 @@ VOID PhNetworkProviderUpdate(
 
     PhFree(connections);
 
+    PhEndSnapshotTick(PH_SNAPSHOT_NETWORK, &snapshotTick);
+
     PhInvokeCallback(&PhNetworkItemsUpdatedEvent, NULL);
 }
 
@@ -969,7 +969,6 @@ VOID PhNfpUpdateIconIoHistory(
     lineData2 = _alloca(maxDataCount * sizeof(FLOAT));
 
     lineDataCount = min(maxDataCount, PhIoReadHistory.Count);
-    max = 1024 * 1024; // minimum scaling of 1 MB.
 
     for (i = 0; i < lineDataCount; i++)
     {
@@ -978,11 +977,13 @@ VOID PhNfpUpdateIconIoHistory(
             (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoOtherHistory, i);
         lineData2[i] =
             (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoWriteHistory, i);
-
-        if (max < lineData1[i] + lineData2[i])
-            max = lineData1[i] + lineData2[i];
     }
 
+    max = (FLOAT)PhGetIoTotalHistoryMaximum(lineDataCount);
+
+    if (max < 1024 * 1024)
+        max = 1024 * 1024; // minimum scaling of 1 MB.
+
     PhDivideSinglesBySingle(lineData1, max, lineDataCount);
     PhDivideSinglesBySingle(lineData2, max, lineDataCount);
 
@@ -1057,7 +1058,6 @@ VOID PhNfpUpdateIconCommitHistory(
     ULONG maxDataCount;
     ULONG lineDataCount;
     PFLOAT lineData1;
-    ULONG i;
     HBITMAP bitmap;
     PVOID bits;
     HDC hdc;
@@ -1075,8 +1075,7 @@ VOID PhNfpUpdateIconCommitHistory(
 
     lineDataCount = min(maxDataCount, PhCommitHistory.Count);
 
-    for (i = 0; i < lineDataCount; i++)
-        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhCommitHistory, i);
+    PhCopyCircularBufferAsSingles_ULONG(&PhCommitHistory, 0, lineData1, lineDataCount);
 
     PhDivideSinglesBySingle(lineData1, (FLOAT)PhPerfInformation.CommitLimit, lineDataCount);
 
@@ -1132,7 +1131,6 @@ VOID PhNfpUpdateIconPhysicalHistory(
     ULONG maxDataCount;
     ULONG lineDataCount;
     PFLOAT lineData1;
-    ULONG i;
     HBITMAP bitmap;
     PVOID bits;
     HDC hdc;
@@ -1151,8 +1149,7 @@ VOID PhNfpUpdateIconPhysicalHistory(
 
     lineDataCount = min(maxDataCount, PhCommitHistory.Count);
 
-    for (i = 0; i < lineDataCount; i++)
-        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhPhysicalHistory, i);
+    PhCopyCircularBufferAsSingles_ULONG(&PhPhysicalHistory, 0, lineData1, lineDataCount);
 
     PhDivideSinglesBySingle(lineData1, (FLOAT)PhSystemBasicInformation.NumberOfPhysicalPages, lineDataCount);
 
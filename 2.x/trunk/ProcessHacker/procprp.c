@@ -4970,6 +4970,7 @@ INT_PTR CALLBACK PhpProcessHandlesDlgProc(
                 &handlesContext->UpdatedEventRegistration
                 );
             PhUnregisterProvider(&handlesContext->ProviderRegistration);
+            PhSetTerminatingHandleProvider(handlesContext->Provider);
             PhDereferenceObject(handlesContext->Provider);
 
             if (PhPluginsEnabled)
@@ -62,8 +62,14 @@
 #include <verify.h>
 #include <winsta.h>
 
-#define PROCESS_ID_BUCKETS 64
-#define PROCESS_ID_TO_BUCKET_INDEX(ProcessId) (((ULONG)(ProcessId) / 4) & (PROCESS_ID_BUCKETS - 1))
+#define PROCESS_ITEM_INITIAL_BUCKETS 256
+
+typedef struct _PH_PROCESS_ITEM_SET
+{
+    PPH_HASH_ENTRY *Buckets;
+    ULONG NumberOfBuckets;
+    ULONG Count;
+} PH_PROCESS_ITEM_SET, *PPH_PROCESS_ITEM_SET;
 
 typedef struct _PH_PROCESS_QUERY_DATA
 {
@@ -131,8 +137,12 @@ INT NTAPI PhpVerifyCacheCompareFunction(
     _In_ PPH_AVL_LINKS Links2
     );
 
+VOID PhpInitializeProcessItemSet(
+    _Out_ PPH_PROCESS_ITEM_SET Set
+    );
+
 VOID PhpQueueProcessQueryStage1(
-    _In_ PPH_PROCESS_ITEM ProcessItem
+    _In_ PPH_LIST ProcessItems
     );
 
 VOID PhpQueueProcessQueryStage2(
@@ -153,9 +163,9 @@ VOID PhpRemoveProcessRecord(
 
 PPH_OBJECT_TYPE PhProcessItemType;
 
-PPH_HASH_ENTRY PhProcessHashSet[256] = PH_HASH_SET_INIT;
-ULONG PhProcessHashSetCount = 0;
-PH_QUEUED_LOCK PhProcessHashSetLock = PH_QUEUED_LOCK_INIT;
+PH_PROCESS_ITEM_SET PhProcessItemSet;
+PH_READ_MOSTLY_LOCK PhProcessHashSetLock = PH_READ_MOSTLY_LOCK_INIT;
+static ULONG PhProcessGeneration = 0;
 
 SLIST_HEADER PhProcessQueryDataListHead;
 
@@ -165,7 +175,7 @@ PHAPPAPI PH_CALLBACK_DECLARE(PhProcessRemovedEvent);
 PHAPPAPI PH_CALLBACK_DECLARE(PhProcessesUpdatedEvent);
 
 PPH_LIST PhProcessRecordList;
-PH_QUEUED_LOCK PhProcessRecordListLock = PH_QUEUED_LOCK_INIT;
+PH_READ_MOSTLY_LOCK PhProcessRecordListLock = PH_READ_MOSTLY_LOCK_INIT;
 
 ULONG PhStatisticsSampleCount = 512;
 BOOLEAN PhEnableProcessQueryStage2 = FALSE;
@@ -222,6 +232,8 @@ PPH_CIRCULAR_BUFFER_FLOAT PhCpusUserHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoReadHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoWriteHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoOtherHistory;
+static PH_CIRCULAR_BUFFER_STATISTICS_ULONG64 PhIoTotalStatistics; // maximum of read + write + other
+static PH_QUEUED_LOCK PhIoTotalStatisticsLock = PH_QUEUED_LOCK_INIT;
 
 PH_CIRCULAR_BUFFER_ULONG PhCommitHistory;
 PH_CIRCULAR_BUFFER_ULONG PhPhysicalHistory;
@@ -250,11 +262,12 @@ BOOLEAN PhProcessProviderInitialization(
     PPH_UINT64_DELTA deltaBuffer;
     PPH_CIRCULAR_BUFFER_FLOAT historyBuffer;
 
-    PhProcessItemType = PhCreateObjectType(L"ProcessItem", 0, PhpProcessItemDeleteProcedure);
+    PhProcessItemType = PhCreateObjectType(L"ProcessItem", PH_OBJECT_TYPE_BIASED_REF_COUNT, PhpProcessItemDeleteProcedure);
 
     RtlInitializeSListHead(&PhProcessQueryDataListHead);
 
     PhProcessRecordList = PhCreateList(40);
+    PhpInitializeProcessItemSet(&PhProcessItemSet);
 
     RtlInitUnicodeString(
         &PhDpcsProcessInformation.ImageName,
@@ -513,15 +526,30 @@ FORCEINLINE ULONG PhHashProcessItem(
 }
 
 /**
- * Finds a process item in the hash set.
+ * Initializes a process item set.
+ *
+ * \param Set The process item set.
+ */
+VOID PhpInitializeProcessItemSet(
+    _Out_ PPH_PROCESS_ITEM_SET Set
+    )
+{
+    Set->NumberOfBuckets = PROCESS_ITEM_INITIAL_BUCKETS;
+    Set->Buckets = PhCreateHashSet(Set->NumberOfBuckets);
+    Set->Count = 0;
+}
+
+/**
+ * Finds a process item in a process item set.
  *
+ * \param Set The process item set.
  * \param ProcessId The process ID of the process item.
  *
- * \remarks The hash set must be locked before calling this
- * function. The reference count of the found process item is
+ * \remarks The reference count of the found process item is
  * not incremented.
  */
-PPH_PROCESS_ITEM PhpLookupProcessItem(
+PPH_PROCESS_ITEM PhpFindProcessItemSet(
+    _In_ PPH_PROCESS_ITEM_SET Set,
     _In_ HANDLE ProcessId
     )
 {
@@ -531,8 +559,8 @@ PPH_PROCESS_ITEM PhpLookupProcessItem(
 
     lookupProcessItem.ProcessId = ProcessId;
     entry = PhFindEntryHashSet(
-        PhProcessHashSet,
-        PH_HASH_SET_SIZE(PhProcessHashSet),
+        Set->Buckets,
+        Set->NumberOfBuckets,
         PhHashProcessItem(&lookupProcessItem)
         );
 
@@ -547,6 +575,138 @@ PPH_PROCESS_ITEM PhpLookupProcessItem(
     return NULL;
 }
 
+/**
+ * Adds a process item to a process item set.
+ *
+ * \param Set The process item set.
+ * \param ProcessItem The process item. The item must not already
+ * be in a set.
+ */
+VOID PhpAddProcessItemSet(
+    _Inout_ PPH_PROCESS_ITEM_SET Set,
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    // Keep the chains short on hosts with thousands of processes. Process IDs are
+    // allocated densely, so doubling the bucket count spreads them evenly.
+    if (Set->Count >= Set->NumberOfBuckets)
+        PhResizeHashSet(&Set->Buckets, &Set->NumberOfBuckets, Set->NumberOfBuckets * 2);
+
+    PhAddEntryHashSet(
+        Set->Buckets,
+        Set->NumberOfBuckets,
+        &ProcessItem->HashEntry,
+        PhHashProcessItem(ProcessItem)
+        );
+    Set->Count++;
+}
+
+/**
+ * Removes a process item from a process item set.
+ *
+ * \param Set The process item set.
+ * \param ProcessItem A process item in \a Set.
+ */
+VOID PhpRemoveProcessItemSet(
+    _Inout_ PPH_PROCESS_ITEM_SET Set,
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PhRemoveEntryHashSet(Set->Buckets, Set->NumberOfBuckets, &ProcessItem->HashEntry);
+    Set->Count--;
+}
+
+/**
+ * Marks the process item that corresponds to an entry in a process
+ * snapshot as present in the current update.
+ *
+ * \param Set The process item set.
+ * \param Process A process information entry.
+ * \param Generation The generation of the current update.
+ *
+ * \return The process item for the entry, or NULL if the process is
+ * new. The result is also stored in the UniqueProcessKey field of the
+ * entry.
+ *
+ * \remarks Items whose create time differs from the entry belong to a
+ * process whose ID has been reused. They are not marked, so they will be
+ * treated as terminated.
+ */
+FORCEINLINE PPH_PROCESS_ITEM PhpMarkProcessItem(
+    _In_ PPH_PROCESS_ITEM_SET Set,
+    _Inout_ PSYSTEM_PROCESS_INFORMATION Process,
+    _In_ ULONG Generation
+    )
+{
+    PPH_PROCESS_ITEM processItem;
+
+    processItem = PhpFindProcessItemSet(Set, Process->UniqueProcessId);
+
+    if (processItem && processItem->CreateTime.QuadPart == Process->CreateTime.QuadPart)
+        processItem->Generation = Generation;
+    else
+        processItem = NULL;
+
+    Process->UniqueProcessKey = (ULONG_PTR)processItem;
+
+    return processItem;
+}
+
+/**
+ * Finds process items which were not marked in the current update.
+ *
+ * \param Set The process item set.
+ * \param Generation The generation of the current update.
+ *
+ * \return A list of terminated process items, or NULL if there are
+ * none. You must free the list with PhDereferenceObject() when you
+ * no longer need it.
+ */
+PPH_LIST PhpFindDeadProcessItems(
+    _In_ PPH_PROCESS_ITEM_SET Set,
+    _In_ ULONG Generation
+    )
+{
+    PPH_LIST processItems = NULL;
+    ULONG i;
+    PPH_HASH_ENTRY entry;
+    PPH_PROCESS_ITEM processItem;
+
+    for (i = 0; i < Set->NumberOfBuckets; i++)
+    {
+        for (entry = Set->Buckets[i]; entry; entry = entry->Next)
+        {
+            processItem = CONTAINING_RECORD(entry, PH_PROCESS_ITEM, HashEntry);
+
+            if (processItem->Generation != Generation)
+            {
+                if (!processItems)
+                    processItems = PhCreateList(2);
+
+                PhAddItemList(processItems, processItem);
+            }
+        }
+    }
+
+    return processItems;
+}
+
+/**
+ * Finds a process item in the hash set.
+ *
+ * \param ProcessId The process ID of the process item.
+ *
+ * \remarks The hash set must be locked before calling this
+ * function. The reference count of the found process item is
+ * not incremented.
+ */
+PPH_PROCESS_ITEM PhpLookupProcessItem(
+    _In_ HANDLE ProcessId
+    )
+{
+    return PhpFindProcessItemSet(&PhProcessItemSet, ProcessId);
+}
+
 /**
  * Finds and references a process item.
  *
@@ -560,14 +720,14 @@ PPH_PROCESS_ITEM PhReferenceProcessItem(
 {
     PPH_PROCESS_ITEM processItem;
 
-    PhAcquireQueuedLockShared(&PhProcessHashSetLock);
+    PhAcquireReadMostlyLockShared(&PhProcessHashSetLock);
 
     processItem = PhpLookupProcessItem(ProcessId);
 
     if (processItem)
         PhReferenceObject(processItem);
 
-    PhReleaseQueuedLockShared(&PhProcessHashSetLock);
+    PhReleaseReadMostlyLockShared(&PhProcessHashSetLock);
 
     return processItem;
 }
@@ -595,18 +755,18 @@ VOID PhEnumProcessItems(
 
     if (!ProcessItems)
     {
-        *NumberOfProcessItems = PhProcessHashSetCount;
+        *NumberOfProcessItems = PhProcessItemSet.Count;
         return;
     }
 
-    PhAcquireQueuedLockShared(&PhProcessHashSetLock);
+    PhAcquireReadMostlyLockShared(&PhProcessHashSetLock);
 
-    numberOfProcessItems = PhProcessHashSetCount;
+    numberOfProcessItems = PhProcessItemSet.Count;
     processItems = PhAllocate(sizeof(PPH_PROCESS_ITEM) * numberOfProcessItems);
 
-    for (i = 0; i < PH_HASH_SET_SIZE(PhProcessHashSet); i++)
+    for (i = 0; i < PhProcessItemSet.NumberOfBuckets; i++)
     {
-        for (entry = PhProcessHashSet[i]; entry; entry = entry->Next)
+        for (entry = PhProcessItemSet.Buckets[i]; entry; entry = entry->Next)
         {
             processItem = CONTAINING_RECORD(entry, PH_PROCESS_ITEM, HashEntry);
             PhReferenceObject(processItem);
@@ -614,7 +774,7 @@ VOID PhEnumProcessItems(
         }
     }
 
-    PhReleaseQueuedLockShared(&PhProcessHashSetLock);
+    PhReleaseReadMostlyLockShared(&PhProcessHashSetLock);
 
     *ProcessItems = processItems;
     *NumberOfProcessItems = numberOfProcessItems;
@@ -624,21 +784,14 @@ VOID PhpAddProcessItem(
     _In_ _Assume_refs_(1) PPH_PROCESS_ITEM ProcessItem
     )
 {
-    PhAddEntryHashSet(
-        PhProcessHashSet,
-        PH_HASH_SET_SIZE(PhProcessHashSet),
-        &ProcessItem->HashEntry,
-        PhHashProcessItem(ProcessItem)
-        );
-    PhProcessHashSetCount++;
+    PhpAddProcessItemSet(&PhProcessItemSet, ProcessItem);
 }
 
 VOID PhpRemoveProcessItem(
     _In_ PPH_PROCESS_ITEM ProcessItem
     )
 {
-    PhRemoveEntryHashSet(PhProcessHashSet, PH_HASH_SET_SIZE(PhProcessHashSet), &ProcessItem->HashEntry);
-    PhProcessHashSetCount--;
+    PhpRemoveProcessItemSet(&PhProcessItemSet, ProcessItem);
     PhDereferenceObject(ProcessItem);
 }
 
@@ -872,6 +1025,7 @@ VOID PhpProcessQueryStage1(
 
         // Version info.
         PhInitializeImageVersionInfo(&Data->VersionInfo, processItem->FileName->Buffer);
+        PhInternImageVersionInfo(&Data->VersionInfo);
     }
 
     // Use the default EXE icon if we didn't get the file's icon.
@@ -1174,13 +1328,29 @@ NTSTATUS PhpProcessQueryStage2Worker(
 }
 
 VOID PhpQueueProcessQueryStage1(
-    _In_ PPH_PROCESS_ITEM ProcessItem
+    _In_ PPH_LIST ProcessItems
     )
 {
-    // Ref: dereferenced when the provider update function removes the item from
-    // the queue.
-    PhReferenceObject(ProcessItem);
-    PhQueueItemGlobalWorkQueue(PhpProcessQueryStage1Worker, ProcessItem);
+    PPH_WORK_QUEUE_ITEM_DESCRIPTOR items;
+    ULONG i;
+
+    // All stage 1 queries of an update are queued together, so the work queue is
+    // locked and signaled once instead of once for each process.
+    items = PhAllocate(sizeof(PH_WORK_QUEUE_ITEM_DESCRIPTOR) * ProcessItems->Count);
+
+    for (i = 0; i < ProcessItems->Count; i++)
+    {
+        // Ref: dereferenced when the provider update function removes the item from
+        // the queue.
+        PhReferenceObject(ProcessItems->Items[i]);
+        items[i].Function = PhpProcessQueryStage1Worker;
+        items[i].Context = ProcessItems->Items[i];
+        items[i].DeleteFunction = NULL;
+        items[i].Priority = PH_WORK_QUEUE_PRIORITY_NORMAL;
+    }
+
+    PhQueueItemsGlobalWorkQueue(items, ProcessItems->Count);
+    PhFree(items);
 }
 
 VOID PhpQueueProcessQueryStage2(
@@ -1190,7 +1360,9 @@ VOID PhpQueueProcessQueryStage2(
     if (PhEnableProcessQueryStage2)
     {
         PhReferenceObject(ProcessItem);
-        PhQueueItemGlobalWorkQueue(PhpProcessQueryStage2Worker, ProcessItem);
+        // Stage 2 (signature verification, packing) is slow and not needed to display
+        // the process, so let other work run ahead of it.
+        PhQueueItemGlobalWorkQueueEx(PhpProcessQueryStage2Worker, ProcessItem, PH_WORK_QUEUE_PRIORITY_LOW);
     }
 }
 
@@ -1301,6 +1473,9 @@ VOID PhpFillProcessItem(
                 PhDereferenceObject(fileName);
             }
         }
+
+        // Many processes share the same image, so keep a single copy of each file name.
+        ProcessItem->FileName = PhInternString(ProcessItem->FileName);
     }
 
     // Token-related information
@@ -1371,6 +1546,8 @@ VOID PhpFillProcessItem(
         }
     }
 
+    ProcessItem->UserName = PhInternString(ProcessItem->UserName);
+
     NtClose(processHandle);
 }
 
@@ -1639,6 +1816,7 @@ VOID PhpInitializeProcessStatistics(
     PhInitializeCircularBuffer_ULONG64(&PhIoReadHistory, PhStatisticsSampleCount);
     PhInitializeCircularBuffer_ULONG64(&PhIoWriteHistory, PhStatisticsSampleCount);
     PhInitializeCircularBuffer_ULONG64(&PhIoOtherHistory, PhStatisticsSampleCount);
+    PhInitializeCircularBufferStatistics_ULONG64(&PhIoTotalStatistics, PhIoReadHistory.Size, PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM);
     PhInitializeCircularBuffer_ULONG(&PhCommitHistory, PhStatisticsSampleCount);
     PhInitializeCircularBuffer_ULONG(&PhPhysicalHistory, PhStatisticsSampleCount);
     PhInitializeCircularBuffer_ULONG(&PhMaxCpuHistory, PhStatisticsSampleCount);
@@ -1679,6 +1857,11 @@ VOID PhpUpdateSystemHistory(
     PhAddItemCircularBuffer_ULONG64(&PhIoReadHistory, PhIoReadDelta.Delta);
     PhAddItemCircularBuffer_ULONG64(&PhIoWriteHistory, PhIoWriteDelta.Delta);
     PhAddItemCircularBuffer_ULONG64(&PhIoOtherHistory, PhIoOtherDelta.Delta);
+    PhAcquireQueuedLockExclusive(&PhIoTotalStatisticsLock);
+    PhUpdateCircularBufferStatistics_ULONG64(&PhIoTotalStatistics,
+        PhIoReadDelta.Delta + PhIoWriteDelta.Delta + PhIoOtherDelta.Delta
+        );
+    PhReleaseQueuedLockExclusive(&PhIoTotalStatisticsLock);
 
     // Memory
     PhAddItemCircularBuffer_ULONG(&PhCommitHistory, PhPerfInformation.CommittedPages);
@@ -1740,6 +1923,27 @@ BOOLEAN PhGetStatisticsTime(
     return TRUE;
 }
 
+/**
+ * Gets the maximum total (read + write + other) I/O delta recorded by the
+ * statistics system.
+ *
+ * \param Count The number of recent history items to consider.
+ */
+ULONG64 PhGetIoTotalHistoryMaximum(
+    _In_ ULONG Count
+    )
+{
+    ULONG64 maximum;
+
+    // The statistics are updated by the provider thread, and the queues are not consistent
+    // while an item is being added.
+    PhAcquireQueuedLockShared(&PhIoTotalStatisticsLock);
+    maximum = PhGetMaximumCircularBufferStatistics_ULONG64(&PhIoTotalStatistics, Count);
+    PhReleaseQueuedLockShared(&PhIoTotalStatisticsLock);
+
+    return maximum;
+}
+
 PPH_STRING PhGetStatisticsTimeString(
     _In_opt_ PPH_PROCESS_ITEM ProcessItem,
     _In_ ULONG Index
@@ -1849,7 +2053,6 @@ VOID PhProcessProviderUpdate(
     )
 {
     static ULONG runCount = 0;
-    static PSYSTEM_PROCESS_INFORMATION pidBuckets[PROCESS_ID_BUCKETS];
 
     // Note about locking:
     // Since this is the only function that is allowed to
@@ -1859,7 +2062,7 @@ VOID PhProcessProviderUpdate(
 
     PVOID processes;
     PSYSTEM_PROCESS_INFORMATION process;
-    ULONG bucketIndex;
+    ULONG generation;
 
     BOOLEAN isCycleCpuUsageEnabled = FALSE;
 
@@ -1870,6 +2073,8 @@ VOID PhProcessProviderUpdate(
     PPH_PROCESS_ITEM maxCpuProcessItem = NULL;
     ULONG64 maxIoValue = 0;
     PPH_PROCESS_ITEM maxIoProcessItem = NULL;
+    PPH_LIST stage1ProcessItems = NULL;
+    PH_SNAPSHOT_TICK snapshotTick;
 
     // Pre-update tasks
 
@@ -1915,7 +2120,9 @@ VOID PhProcessProviderUpdate(
     PhTotalThreads = 0;
     PhTotalHandles = 0;
 
-    if (!NT_SUCCESS(PhEnumProcesses(&processes)))
+    PhBeginSnapshotTick(&snapshotTick);
+
+    if (!NT_SUCCESS(PhSnapshotEnumProcesses(&processes)))
         return;
 
     // Notes on cycle-based CPU usage:
@@ -1939,17 +2146,19 @@ VOID PhProcessProviderUpdate(
     // The second method is used here, but the adjustments must be done before the main new/modified
     // pass. We need take into account new, existing and terminated processes.
 
-    // Create the PID hash set. This contains the process information structures returned by
-    // PhEnumProcesses, distinct from the process item hash set.
-    // Note that we use the UniqueProcessKey field as the next node pointer to avoid having to
-    // allocate extra memory.
+    // Match the snapshot against the process items. Each item that is still present is stamped
+    // with the generation of this update, and every item that is left unstamped afterwards has
+    // terminated. The item for each entry (or NULL for a new process) is stored in the
+    // UniqueProcessKey field so that the main pass below does not need to look it up again.
 
-    memset(pidBuckets, 0, sizeof(pidBuckets));
+    generation = ++PhProcessGeneration;
 
     process = PH_FIRST_PROCESS(processes);
 
     do
     {
+        PPH_PROCESS_ITEM processItem;
+
         PhTotalProcesses++;
         PhTotalThreads += process->NumberOfThreads;
         PhTotalHandles += process->HandleCount;
@@ -1960,15 +2169,11 @@ VOID PhProcessProviderUpdate(
             process->KernelTime = PhCpuTotals.IdleTime;
         }
 
-        bucketIndex = PROCESS_ID_TO_BUCKET_INDEX(process->UniqueProcessId);
-        process->UniqueProcessKey = (ULONG_PTR)pidBuckets[bucketIndex];
-        pidBuckets[bucketIndex] = process;
+        processItem = PhpMarkProcessItem(&PhProcessItemSet, process, generation);
 
         if (isCycleCpuUsageEnabled)
         {
-            PPH_PROCESS_ITEM processItem;
-
-            if ((processItem = PhpLookupProcessItem(process->UniqueProcessId)) && processItem->CreateTime.QuadPart == process->CreateTime.QuadPart)
+            if (processItem)
                 sysTotalCycleTime += process->CycleTime - processItem->CycleTimeDelta.Value; // existing process
             else
                 sysTotalCycleTime += process->CycleTime; // new process
@@ -1991,101 +2196,72 @@ VOID PhProcessProviderUpdate(
         PhInterruptsProcessInformation.KernelTime = PhCpuTotals.InterruptTime;
     }
 
+    // The fake processes are never removed, even if they are not shown in this mode.
+    PhpMarkProcessItem(&PhProcessItemSet, &PhDpcsProcessInformation, generation);
+    PhpMarkProcessItem(&PhProcessItemSet, &PhInterruptsProcessInformation, generation);
+
     // Look for dead processes.
     {
-        PPH_LIST processesToRemove = NULL;
+        PPH_LIST processesToRemove;
         ULONG i;
-        PPH_HASH_ENTRY entry;
         PPH_PROCESS_ITEM processItem;
-        PSYSTEM_PROCESS_INFORMATION processEntry;
+        LARGE_INTEGER exitTime;
+
+        processesToRemove = PhpFindDeadProcessItems(&PhProcessItemSet, generation);
 
-        for (i = 0; i < PH_HASH_SET_SIZE(PhProcessHashSet); i++)
+        if (processesToRemove)
         {
-            for (entry = PhProcessHashSet[i]; entry; entry = entry->Next)
+            for (i = 0; i < processesToRemove->Count; i++)
             {
-                processItem = CONTAINING_RECORD(entry, PH_PROCESS_ITEM, HashEntry);
-
-                // Check if the process still exists. Note that we take into account PID re-use by
-                // checking CreateTime as well.
-
-                if (processItem->ProcessId == DPCS_PROCESS_ID)
-                {
-                    processEntry = &PhDpcsProcessInformation;
-                }
-                else if (processItem->ProcessId == INTERRUPTS_PROCESS_ID)
-                {
-                    processEntry = &PhInterruptsProcessInformation;
-                }
-                else
-                {
-                    processEntry = pidBuckets[PROCESS_ID_TO_BUCKET_INDEX(processItem->ProcessId)];
-
-                    while (processEntry && processEntry->UniqueProcessId != processItem->ProcessId)
-                        processEntry = (PSYSTEM_PROCESS_INFORMATION)processEntry->UniqueProcessKey;
-                }
+                processItem = processesToRemove->Items[i];
+                processItem->State |= PH_PROCESS_ITEM_REMOVED;
+                exitTime.QuadPart = 0;
 
-                if (!processEntry || processEntry->CreateTime.QuadPart != processItem->CreateTime.QuadPart)
+                if (processItem->QueryHandle)
                 {
-                    LARGE_INTEGER exitTime;
+                    KERNEL_USER_TIMES times;
+                    ULONG64 finalCycleTime;
 
-                    processItem->State |= PH_PROCESS_ITEM_REMOVED;
-                    exitTime.QuadPart = 0;
-
-                    if (processItem->QueryHandle)
+                    if (NT_SUCCESS(PhGetProcessTimes(processItem->QueryHandle, &times)))
                     {
-                        KERNEL_USER_TIMES times;
-                        ULONG64 finalCycleTime;
-
-                        if (NT_SUCCESS(PhGetProcessTimes(processItem->QueryHandle, &times)))
-                        {
-                            exitTime = times.ExitTime;
-                        }
+                        exitTime = times.ExitTime;
+                    }
 
-                        if (isCycleCpuUsageEnabled)
+                    if (isCycleCpuUsageEnabled)
+                    {
+                        if (NT_SUCCESS(PhGetProcessCycleTime(processItem->QueryHandle, &finalCycleTime)))
                         {
-                            if (NT_SUCCESS(PhGetProcessCycleTime(processItem->QueryHandle, &finalCycleTime)))
-                            {
-                                // Adjust deltas for the terminated process because this doesn't get
-                                // picked up anywhere else.
-                                //
-                                // Note that if we don't have sufficient access to the process, the worst
-                                // that will happen is that the CPU usages of other processes will get
-                                // inflated. (See above; if we were using the first technique, we could
-                                // get negative deltas, which is much worse.)
-                                sysTotalCycleTime += finalCycleTime - processItem->CycleTimeDelta.Value;
-                            }
+                            // Adjust deltas for the terminated process because this doesn't get
+                            // picked up anywhere else.
+                            //
+                            // Note that if we don't have sufficient access to the process, the worst
+                            // that will happen is that the CPU usages of other processes will get
+                            // inflated. (See above; if we were using the first technique, we could
+                            // get negative deltas, which is much worse.)
+                            sysTotalCycleTime += finalCycleTime - processItem->CycleTimeDelta.Value;
                         }
                     }
+                }
 
-                    // If we don't have a valid exit time, use the current time.
-                    if (exitTime.QuadPart == 0)
-                        PhQuerySystemTime(&exitTime);
-
-                    processItem->Record->Flags |= PH_PROCESS_RECORD_DEAD;
-                    processItem->Record->ExitTime = exitTime;
-
-                    // Raise the process removed event.
-                    PhInvokeCallback(&PhProcessRemovedEvent, processItem);
+                // If we don't have a valid exit time, use the current time.
+                if (exitTime.QuadPart == 0)
+                    PhQuerySystemTime(&exitTime);
 
-                    if (!processesToRemove)
-                        processesToRemove = PhCreateList(2);
+                processItem->Record->Flags |= PH_PROCESS_RECORD_DEAD;
+                processItem->Record->ExitTime = exitTime;
 
-                    PhAddItemList(processesToRemove, processItem);
-                }
+                // Raise the process removed event.
+                PhInvokeCallback(&PhProcessRemovedEvent, processItem);
             }
-        }
 
-        // Lock only if we have something to do.
-        if (processesToRemove)
-        {
-            PhAcquireQueuedLockExclusive(&PhProcessHashSetLock);
+            PhAcquireReadMostlyLockExclusive(&PhProcessHashSetLock);
 
             for (i = 0; i < processesToRemove->Count; i++)
             {
                 PhpRemoveProcessItem((PPH_PROCESS_ITEM)processesToRemove->Items[i]);
             }
 
-            PhReleaseQueuedLockExclusive(&PhProcessHashSetLock);
+            PhReleaseReadMostlyLockExclusive(&PhProcessHashSetLock);
             PhDereferenceObject(processesToRemove);
         }
     }
@@ -2107,7 +2283,8 @@ VOID PhProcessProviderUpdate(
     {
         PPH_PROCESS_ITEM processItem;
 
-        processItem = PhpLookupProcessItem(process->UniqueProcessId);
+        processItem = (PPH_PROCESS_ITEM)process->UniqueProcessKey;
+        process->UniqueProcessKey = 0;
 
         if (!processItem)
         {
@@ -2120,6 +2297,7 @@ VOID PhProcessProviderUpdate(
             processItem = PhCreateProcessItem(process->UniqueProcessId);
             PhpFillProcessItem(processItem, process);
             processItem->SequenceNumber = PhTimeSequenceNumber;
+            processItem->Generation = generation;
 
             processRecord = PhpCreateProcessRecord(processItem);
             PhpAddProcessRecord(processRecord);
@@ -2172,16 +2350,19 @@ VOID PhProcessProviderUpdate(
             }
             else
             {
-                PhpQueueProcessQueryStage1(processItem);
+                if (!stage1ProcessItems)
+                    stage1ProcessItems = PhCreateList(128);
+
+                PhAddItemList(stage1ProcessItems, processItem);
             }
 
             // Add pending service items to the process item.
             PhUpdateProcessItemServices(processItem);
 
             // Add the process item to the hashtable.
-            PhAcquireQueuedLockExclusive(&PhProcessHashSetLock);
+            PhAcquireReadMostlyLockExclusive(&PhProcessHashSetLock);
             PhpAddProcessItem(processItem);
-            PhReleaseQueuedLockExclusive(&PhProcessHashSetLock);
+            PhReleaseReadMostlyLockExclusive(&PhProcessHashSetLock);
 
             // Raise the process added event.
             PhInvokeCallback(&PhProcessAddedEvent, processItem);
@@ -2350,7 +2531,7 @@ VOID PhProcessProviderUpdate(
                 PhInvokeCallback(&PhProcessModifiedEvent, processItem);
             }
 
-            // No reference added by PhpLookupProcessItem.
+            // No reference added by PhpMarkProcessItem.
         }
 
         // Trick ourselves into thinking that the fake processes
@@ -2377,6 +2558,12 @@ VOID PhProcessProviderUpdate(
         }
     }
 
+    if (stage1ProcessItems)
+    {
+        PhpQueueProcessQueryStage1(stage1ProcessItems);
+        PhDereferenceObject(stage1ProcessItems);
+    }
+
     if (PhProcessInformation)
         PhFree(PhProcessInformation);
 
@@ -2447,6 +2634,8 @@ VOID PhProcessProviderUpdate(
         }
     }
 
+    PhEndSnapshotTick(PH_SNAPSHOT_PROCESSES, &snapshotTick);
+
     PhInvokeCallback(&PhProcessesUpdatedEvent, NULL);
     runCount++;
 }
@@ -2548,7 +2737,7 @@ VOID PhpAddProcessRecord(
     PPH_PROCESS_RECORD processRecord;
     ULONG insertIndex;
 
-    PhAcquireQueuedLockExclusive(&PhProcessRecordListLock);
+    PhAcquireReadMostlyLockExclusive(&PhProcessRecordListLock);
 
     processRecord = PhpSearchProcessRecordList(&ProcessRecord->CreateTime, NULL, &insertIndex);
 
@@ -2563,7 +2752,7 @@ VOID PhpAddProcessRecord(
         InsertTailList(&processRecord->ListEntry, &ProcessRecord->ListEntry);
     }
 
-    PhReleaseQueuedLockExclusive(&PhProcessRecordListLock);
+    PhReleaseReadMostlyLockExclusive(&PhProcessRecordListLock);
 }
 
 VOID PhpRemoveProcessRecord(
@@ -2573,7 +2762,7 @@ VOID PhpRemoveProcessRecord(
     ULONG i;
     PPH_PROCESS_RECORD headProcessRecord;
 
-    PhAcquireQueuedLockExclusive(&PhProcessRecordListLock);
+    PhAcquireReadMostlyLockExclusive(&PhProcessRecordListLock);
 
     headProcessRecord = PhpSearchProcessRecordList(&ProcessRecord->CreateTime, &i, NULL);
     assert(headProcessRecord);
@@ -2590,7 +2779,7 @@ VOID PhpRemoveProcessRecord(
             PhProcessRecordList->Items[i] = CONTAINING_RECORD(headProcessRecord->ListEntry.Flink, PH_PROCESS_RECORD, ListEntry);
     }
 
-    PhReleaseQueuedLockExclusive(&PhProcessRecordListLock);
+    PhReleaseReadMostlyLockExclusive(&PhProcessRecordListLock);
 }
 
 VOID PhReferenceProcessRecord(
@@ -2677,7 +2866,7 @@ PPH_PROCESS_RECORD PhFindProcessRecord(
     if (PhProcessRecordList->Count == 0)
         return NULL;
 
-    PhAcquireQueuedLockShared(&PhProcessRecordListLock);
+    PhAcquireReadMostlyLockShared(&PhProcessRecordListLock);
 
     processRecord = PhpSearchProcessRecordList(Time, &i, NULL);
 
@@ -2741,7 +2930,7 @@ PPH_PROCESS_RECORD PhFindProcessRecord(
             found = FALSE;
     }
 
-    PhReleaseQueuedLockShared(&PhProcessRecordListLock);
+    PhReleaseReadMostlyLockShared(&PhProcessRecordListLock);
 
     if (found)
         return processRecord;
@@ -2768,7 +2957,7 @@ VOID PhPurgeProcessRecords(
     // Get the oldest statistics time.
     PhGetStatisticsTime(NULL, PhTimeHistory.Count - 1, &threshold);
 
-    PhAcquireQueuedLockShared(&PhProcessRecordListLock);
+    PhAcquireReadMostlyLockShared(&PhProcessRecordListLock);
 
     for (i = 0; i < PhProcessRecordList->Count; i++)
     {
@@ -2803,7 +2992,7 @@ VOID PhPurgeProcessRecords(
         } while (processRecord != startProcessRecord);
     }
 
-    PhReleaseQueuedLockShared(&PhProcessRecordListLock);
+    PhReleaseReadMostlyLockShared(&PhProcessRecordListLock);
 
     if (derefList)
     {
@@ -2827,7 +3016,7 @@ PPH_PROCESS_ITEM PhReferenceProcessItemForParent(
     if (ParentProcessId == ProcessId) // for cases where the parent PID = PID (e.g. System Idle Process)
         return NULL;
 
-    PhAcquireQueuedLockShared(&PhProcessHashSetLock);
+    PhAcquireReadMostlyLockShared(&PhProcessHashSetLock);
 
     processItem = PhpLookupProcessItem(ParentProcessId);
 
@@ -2839,7 +3028,7 @@ PPH_PROCESS_ITEM PhReferenceProcessItemForParent(
     else
         processItem = NULL;
 
-    PhReleaseQueuedLockShared(&PhProcessHashSetLock);
+    PhReleaseReadMostlyLockShared(&PhProcessHashSetLock);
 
     return processItem;
 }
@@ -2850,7 +3039,7 @@ PPH_PROCESS_ITEM PhReferenceProcessItemForRecord(
 {
     PPH_PROCESS_ITEM processItem;
 
-    PhAcquireQueuedLockShared(&PhProcessHashSetLock);
+    PhAcquireReadMostlyLockShared(&PhProcessHashSetLock);
 
     processItem = PhpLookupProcessItem(Record->ProcessId);
 
@@ -2859,7 +3048,176 @@ PPH_PROCESS_ITEM PhReferenceProcessItemForRecord(
     else
         processItem = NULL;
 
-    PhReleaseQueuedLockShared(&PhProcessHashSetLock);
+    PhReleaseReadMostlyLockShared(&PhProcessHashSetLock);
 
     return processItem;
 }
+
+/**
+ * Replays a sequence of process snapshots through the process item
+ * set, using the same matching as the process provider.
+ *
+ * \param NumberOfProcesses The number of processes in each snapshot.
+ * \param NumberOfTicks The number of snapshots after the first one.
+ * \param Churn The number of processes which are replaced by new
+ * processes between snapshots.
+ * \param Statistics A variable which receives timing information.
+ *
+ * \remarks The snapshots are generated from a fixed seed, so every
+ * call with the same parameters replays exactly the same sequence of
+ * additions, removals and process ID reuses. Only the matching is
+ * timed; building each snapshot buffer is not.
+ */
+VOID PhReplayProcessSnapshots(
+    _In_ ULONG NumberOfProcesses,
+    _In_ ULONG NumberOfTicks,
+    _In_ ULONG Churn,
+    _Out_ PPH_PROCESS_REPLAY_STATISTICS Statistics
+    )
+{
+    PH_PROCESS_ITEM_SET set;
+    PSYSTEM_PROCESS_INFORMATION snapshot;
+    PSYSTEM_PROCESS_INFORMATION process;
+    PHANDLE processIds;
+    PLARGE_INTEGER createTimes;
+    PPH_LIST deadItems;
+    PPH_PROCESS_ITEM processItem;
+    PPH_HASH_ENTRY entry;
+    PPH_HASH_ENTRY nextEntry;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+    ULONG64 time;
+    ULONG seed = 1;
+    ULONG nextProcessId = 4;
+    LONG64 clock = 0;
+    ULONG generation = 0;
+    ULONG tick;
+    ULONG i;
+
+    memset(Statistics, 0, sizeof(PH_PROCESS_REPLAY_STATISTICS));
+
+    if (NumberOfProcesses == 0)
+        return;
+
+    snapshot = PhAllocate(sizeof(SYSTEM_PROCESS_INFORMATION) * NumberOfProcesses);
+    processIds = PhAllocate(sizeof(HANDLE) * NumberOfProcesses);
+    createTimes = PhAllocate(sizeof(LARGE_INTEGER) * NumberOfProcesses);
+
+    for (i = 0; i < NumberOfProcesses; i++)
+    {
+        nextProcessId += 4 * (1 + RtlRandomEx(&seed) % 8);
+        processIds[i] = UlongToHandle(nextProcessId);
+        createTimes[i].QuadPart = ++clock;
+    }
+
+    PhpInitializeProcessItemSet(&set);
+    NtQueryPerformanceCounter(&startCounter, &frequency);
+
+    for (tick = 0; tick <= NumberOfTicks; tick++)
+    {
+        // Replace some processes. Every 16th replacement reuses the ID of the process that
+        // exited, which must be detected using the create time.
+        if (tick != 0)
+        {
+            for (i = 0; i < Churn; i++)
+            {
+                ULONG index = RtlRandomEx(&seed) % NumberOfProcesses;
+
+                if (i % 16 != 0)
+                {
+                    nextProcessId += 4 * (1 + RtlRandomEx(&seed) % 8);
+                    processIds[index] = UlongToHandle(nextProcessId);
+                }
+
+                createTimes[index].QuadPart = ++clock;
+            }
+        }
+
+        for (i = 0; i < NumberOfProcesses; i++)
+        {
+            memset(&snapshot[i], 0, sizeof(SYSTEM_PROCESS_INFORMATION));
+
+            if (i + 1 < NumberOfProcesses)
+                snapshot[i].NextEntryOffset = sizeof(SYSTEM_PROCESS_INFORMATION);
+
+            snapshot[i].UniqueProcessId = processIds[i];
+            snapshot[i].CreateTime = createTimes[i];
+        }
+
+        generation++;
+        NtQueryPerformanceCounter(&startCounter, NULL);
+
+        process = PH_FIRST_PROCESS(snapshot);
+
+        do
+        {
+            PhpMarkProcessItem(&set, process, generation);
+        } while (process = PH_NEXT_PROCESS(process));
+
+        deadItems = PhpFindDeadProcessItems(&set, generation);
+
+        if (deadItems)
+        {
+            for (i = 0; i < deadItems->Count; i++)
+            {
+                processItem = deadItems->Items[i];
+                PhpRemoveProcessItemSet(&set, processItem);
+                PhFree(processItem);
+            }
+
+            Statistics->Removed += deadItems->Count;
+            PhDereferenceObject(deadItems);
+        }
+
+        process = PH_FIRST_PROCESS(snapshot);
+
+        do
+        {
+            if (!process->UniqueProcessKey)
+            {
+                // Only the fields used for matching are needed.
+                processItem = PhAllocate(sizeof(PH_PROCESS_ITEM));
+                processItem->ProcessId = process->UniqueProcessId;
+                processItem->CreateTime = process->CreateTime;
+                processItem->Generation = generation;
+                PhpAddProcessItemSet(&set, processItem);
+                Statistics->Added++;
+            }
+
+            process->UniqueProcessKey = 0;
+        } while (process = PH_NEXT_PROCESS(process));
+
+        NtQueryPerformanceCounter(&endCounter, NULL);
+
+        time = (ULONG64)(endCounter.QuadPart - startCounter.QuadPart) * 1000000 / frequency.QuadPart;
+
+        if (tick == 0)
+        {
+            Statistics->FirstTickTime = time;
+        }
+        else
+        {
+            Statistics->TotalTime += time;
+
+            if (Statistics->MaximumTime < time)
+                Statistics->MaximumTime = time;
+        }
+    }
+
+    Statistics->NumberOfBuckets = set.NumberOfBuckets;
+
+    for (i = 0; i < set.NumberOfBuckets; i++)
+    {
+        for (entry = set.Buckets[i]; entry; entry = nextEntry)
+        {
+            nextEntry = entry->Next;
+            PhFree(CONTAINING_RECORD(entry, PH_PROCESS_ITEM, HashEntry));
+        }
+    }
+
+    PhFree(set.Buckets);
+    PhFree(createTimes);
+    PhFree(processIds);
+    PhFree(snapshot);
+}
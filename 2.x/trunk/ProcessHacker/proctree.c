@@ -70,6 +70,8 @@ static PH_CM_MANAGER ProcessTreeListCm;
 
 static PPH_HASH_ENTRY ProcessNodeHashSet[256] = PH_HASH_SET_INIT; // hashtable of all nodes
 static PPH_LIST ProcessNodeList; // list of all nodes, used when sorting is enabled
+static ULONG ProcessNodeListSortColumn; // the column ProcessNodeList was last sorted by
+static PH_SORT_ORDER ProcessNodeListSortOrder = NoSortOrder; // NoSortOrder if ProcessNodeList isn't sorted
 static PPH_LIST ProcessNodeRootList; // list of root nodes
 
 BOOLEAN PhProcessTreeListStateHighlighting = TRUE;
@@ -511,38 +513,38 @@ VOID PhpRemoveProcessNode(
 
     if (ProcessNode->TooltipText) PhDereferenceObject(ProcessNode->TooltipText);
 
-    if (ProcessNode->IoTotalRateText) PhDereferenceObject(ProcessNode->IoTotalRateText);
-    if (ProcessNode->PrivateBytesText) PhDereferenceObject(ProcessNode->PrivateBytesText);
-    if (ProcessNode->PeakPrivateBytesText) PhDereferenceObject(ProcessNode->PeakPrivateBytesText);
-    if (ProcessNode->WorkingSetText) PhDereferenceObject(ProcessNode->WorkingSetText);
-    if (ProcessNode->PeakWorkingSetText) PhDereferenceObject(ProcessNode->PeakWorkingSetText);
-    if (ProcessNode->PrivateWsText) PhDereferenceObject(ProcessNode->PrivateWsText);
-    if (ProcessNode->SharedWsText) PhDereferenceObject(ProcessNode->SharedWsText);
-    if (ProcessNode->ShareableWsText) PhDereferenceObject(ProcessNode->ShareableWsText);
-    if (ProcessNode->VirtualSizeText) PhDereferenceObject(ProcessNode->VirtualSizeText);
-    if (ProcessNode->PeakVirtualSizeText) PhDereferenceObject(ProcessNode->PeakVirtualSizeText);
-    if (ProcessNode->PageFaultsText) PhDereferenceObject(ProcessNode->PageFaultsText);
-    if (ProcessNode->IoRoRateText) PhDereferenceObject(ProcessNode->IoRoRateText);
-    if (ProcessNode->IoWRateText) PhDereferenceObject(ProcessNode->IoWRateText);
+    PhDeleteFormatSlot(&ProcessNode->IoTotalRateText);
+    PhDeleteFormatSlot(&ProcessNode->PrivateBytesText);
+    PhDeleteFormatSlot(&ProcessNode->PeakPrivateBytesText);
+    PhDeleteFormatSlot(&ProcessNode->WorkingSetText);
+    PhDeleteFormatSlot(&ProcessNode->PeakWorkingSetText);
+    PhDeleteFormatSlot(&ProcessNode->PrivateWsText);
+    PhDeleteFormatSlot(&ProcessNode->SharedWsText);
+    PhDeleteFormatSlot(&ProcessNode->ShareableWsText);
+    PhDeleteFormatSlot(&ProcessNode->VirtualSizeText);
+    PhDeleteFormatSlot(&ProcessNode->PeakVirtualSizeText);
+    PhDeleteFormatSlot(&ProcessNode->PageFaultsText);
+    PhDeleteFormatSlot(&ProcessNode->IoRoRateText);
+    PhDeleteFormatSlot(&ProcessNode->IoWRateText);
     if (ProcessNode->StartTimeText) PhDereferenceObject(ProcessNode->StartTimeText);
     if (ProcessNode->RelativeStartTimeText) PhDereferenceObject(ProcessNode->RelativeStartTimeText);
     if (ProcessNode->WindowTitleText) PhDereferenceObject(ProcessNode->WindowTitleText);
-    if (ProcessNode->CyclesText) PhDereferenceObject(ProcessNode->CyclesText);
-    if (ProcessNode->CyclesDeltaText) PhDereferenceObject(ProcessNode->CyclesDeltaText);
-    if (ProcessNode->ContextSwitchesText) PhDereferenceObject(ProcessNode->ContextSwitchesText);
-    if (ProcessNode->ContextSwitchesDeltaText) PhDereferenceObject(ProcessNode->ContextSwitchesDeltaText);
-    if (ProcessNode->PageFaultsDeltaText) PhDereferenceObject(ProcessNode->PageFaultsDeltaText);
+    PhDeleteFormatSlot(&ProcessNode->CyclesText);
+    PhDeleteFormatSlot(&ProcessNode->CyclesDeltaText);
+    PhDeleteFormatSlot(&ProcessNode->ContextSwitchesText);
+    PhDeleteFormatSlot(&ProcessNode->ContextSwitchesDeltaText);
+    PhDeleteFormatSlot(&ProcessNode->PageFaultsDeltaText);
 
     for (i = 0; i < PHPRTLC_IOGROUP_COUNT; i++)
-        if (ProcessNode->IoGroupText[i]) PhDereferenceObject(ProcessNode->IoGroupText[i]);
+        PhDeleteFormatSlot(&ProcessNode->IoGroupText[i]);
 
-    if (ProcessNode->PagedPoolText) PhDereferenceObject(ProcessNode->PagedPoolText);
-    if (ProcessNode->PeakPagedPoolText) PhDereferenceObject(ProcessNode->PeakPagedPoolText);
-    if (ProcessNode->NonPagedPoolText) PhDereferenceObject(ProcessNode->NonPagedPoolText);
-    if (ProcessNode->PeakNonPagedPoolText) PhDereferenceObject(ProcessNode->PeakNonPagedPoolText);
-    if (ProcessNode->MinimumWorkingSetText) PhDereferenceObject(ProcessNode->MinimumWorkingSetText);
-    if (ProcessNode->MaximumWorkingSetText) PhDereferenceObject(ProcessNode->MaximumWorkingSetText);
-    if (ProcessNode->PrivateBytesDeltaText) PhDereferenceObject(ProcessNode->PrivateBytesDeltaText);
+    PhDeleteFormatSlot(&ProcessNode->PagedPoolText);
+    PhDeleteFormatSlot(&ProcessNode->PeakPagedPoolText);
+    PhDeleteFormatSlot(&ProcessNode->NonPagedPoolText);
+    PhDeleteFormatSlot(&ProcessNode->PeakNonPagedPoolText);
+    PhDeleteFormatSlot(&ProcessNode->MinimumWorkingSetText);
+    PhDeleteFormatSlot(&ProcessNode->MaximumWorkingSetText);
+    PhDeleteFormatSlot(&ProcessNode->PrivateBytesDeltaText);
 
     PhDeleteGraphBuffers(&ProcessNode->CpuGraphBuffers);
     PhDeleteGraphBuffers(&ProcessNode->PrivateGraphBuffers);
@@ -604,7 +606,8 @@ VOID PhTickProcessNodes(
 
     if (ProcessTreeListSortOrder != NoSortOrder)
     {
-        // Force a rebuild to sort the items.
+        // Force a rebuild to sort the items. Only the nodes which moved are re-sorted (see
+        // PhpRepairProcessNodeListOrder).
         TreeNew_NodesStructured(ProcessTreeListHandle);
         fullyInvalidated = TRUE;
     }
@@ -663,6 +666,35 @@ static VOID PhpNeedGraphContext(
     GraphOldBitmap = SelectObject(GraphContext, GraphBitmap);
 }
 
+static VOID PhpFormatSizeToSlot(
+    _In_ ULONG64 Size,
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _Out_ PPH_STRINGREF String
+    )
+{
+    PH_FORMAT format;
+
+    format.Type = SizeFormatType | FormatUseRadix;
+    format.Radix = (UCHAR)PhMaxSizeUnit;
+    format.u.Size = Size;
+
+    PhFormatToSlot(Slot, &format, 1, String);
+}
+
+static VOID PhpFormatUInt64ToSlot(
+    _In_ ULONG64 Value,
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _Out_ PPH_STRINGREF String
+    )
+{
+    PH_FORMAT format;
+
+    PhInitFormatI64U(&format, Value);
+    format.Type |= FormatGroupDigits;
+
+    PhFormatToSlot(Slot, &format, 1, String);
+}
+
 static BOOLEAN PhpFormatInt32GroupDigits(
     _In_ ULONG Value,
     _Out_writes_bytes_(BufferLength) PWCHAR Buffer,
@@ -1142,16 +1174,6 @@ static VOID PhpUpdateProcessNodeCycles(
             PhUpdateDelta(&ProcessNode->CyclesDelta, cycleTime);
         }
     }
-
-    if (ProcessNode->CyclesDelta.Value != 0)
-        PhMoveReference(&ProcessNode->CyclesText, PhFormatUInt64(ProcessNode->CyclesDelta.Value, TRUE));
-    else
-        PhClearReference(&ProcessNode->CyclesText);
-
-    if (ProcessNode->CyclesDelta.Delta != 0)
-        PhMoveReference(&ProcessNode->CyclesDeltaText, PhFormatUInt64(ProcessNode->CyclesDelta.Delta, TRUE));
-    else
-        PhClearReference(&ProcessNode->CyclesDeltaText);
 }
 
 #define SORT_FUNCTION(Column) PhpProcessTreeNewCompare##Column
@@ -1754,6 +1776,107 @@ BEGIN_SORT_FUNCTION(CfGuard)
 }
 END_SORT_FUNCTION
 
+#define PROCESS_NODE_REPAIR_MINIMUM 64
+#define PROCESS_NODE_REPAIR_DIVISOR 8
+
+/**
+ * Restores the order of the process node list after an update.
+ *
+ * \param SortFunction The function the list was previously sorted with.
+ *
+ * \return TRUE if the list is sorted, or FALSE if too many nodes are out of
+ * order. In that case the list must be sorted from scratch.
+ *
+ * \remarks Between updates, usually only a few processes change their position,
+ * e.g. when sorting by CPU usage. The nodes which are out of order are
+ * removed from the list in one pass, sorted, and then inserted back into the
+ * rest of the list using binary searches.
+ */
+static BOOLEAN PhpRepairProcessNodeListOrder(
+    _In_ int (__cdecl *SortFunction)(const void *, const void *)
+    )
+{
+    PPH_PROCESS_NODE *items;
+    PPH_PROCESS_NODE *moved;
+    PPH_PROCESS_NODE node;
+    ULONG count;
+    ULONG maximumMoved;
+    ULONG numberOfKept;
+    ULONG numberOfMoved;
+    ULONG low;
+    ULONG high;
+    ULONG middle;
+    ULONG i;
+
+    items = (PPH_PROCESS_NODE *)ProcessNodeList->Items;
+    count = ProcessNodeList->Count;
+    maximumMoved = max(PROCESS_NODE_REPAIR_MINIMUM, count / PROCESS_NODE_REPAIR_DIVISOR);
+    moved = PhAllocate(maximumMoved * sizeof(PPH_PROCESS_NODE));
+    numberOfKept = 0;
+    numberOfMoved = 0;
+
+    // Keep the nodes which are in order. When a node sorts before the last kept node,
+    // we don't know which of the two has changed, so both are moved. At least one node
+    // of each pair really is out of place, so this moves at most twice as many nodes as
+    // necessary. New nodes are appended to the list, so they are moved as well.
+
+    for (i = 0; i < count; i++)
+    {
+        if (numberOfKept == 0 || SortFunction(&items[numberOfKept - 1], &items[i]) <= 0)
+        {
+            items[numberOfKept++] = items[i];
+            continue;
+        }
+
+        if (numberOfMoved + 2 > maximumMoved)
+        {
+            // Put the moved nodes back into the gap so that the list is complete.
+            memcpy(&items[numberOfKept], moved, numberOfMoved * sizeof(PPH_PROCESS_NODE));
+            PhFree(moved);
+            return FALSE;
+        }
+
+        moved[numberOfMoved++] = items[--numberOfKept];
+        moved[numberOfMoved++] = items[i];
+    }
+
+    if (numberOfMoved != 0)
+    {
+        qsort(moved, numberOfMoved, sizeof(PPH_PROCESS_NODE), SortFunction);
+
+        // Insert the moved nodes starting with the last one, so that each block of kept
+        // nodes is shifted into its final position exactly once.
+
+        i = count;
+
+        while (numberOfMoved != 0)
+        {
+            node = moved[--numberOfMoved];
+            low = 0;
+            high = numberOfKept;
+
+            while (low < high)
+            {
+                middle = low + (high - low) / 2;
+
+                if (SortFunction(&items[middle], &node) > 0)
+                    high = middle;
+                else
+                    low = middle + 1;
+            }
+
+            i -= numberOfKept - low;
+            memmove(&items[i], &items[low], (numberOfKept - low) * sizeof(PPH_PROCESS_NODE));
+            items[--i] = node;
+            numberOfKept = low;
+        }
+    }
+
+    PhFree(moved);
+
+    return TRUE;
+}
+
 BOOLEAN NTAPI PhpProcessTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -1901,9 +2024,26 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
 
                         if (sortFunction)
                         {
-                            qsort(ProcessNodeList->Items, ProcessNodeList->Count, sizeof(PVOID), sortFunction);
+                            // If the list is still sorted by the same column from the last
+                            // update, only the nodes which moved need to be sorted.
+                            if (ProcessNodeListSortColumn != ProcessTreeListSortColumn ||
+                                ProcessNodeListSortOrder != ProcessTreeListSortOrder ||
+                                !PhpRepairProcessNodeListOrder(sortFunction))
+                            {
+                                qsort(ProcessNodeList->Items, ProcessNodeList->Count, sizeof(PVOID), sortFunction);
+                                ProcessNodeListSortColumn = ProcessTreeListSortColumn;
+                                ProcessNodeListSortOrder = ProcessTreeListSortOrder;
+                            }
+                        }
+                        else
+                        {
+                            ProcessNodeListSortOrder = NoSortOrder;
                         }
                     }
+                    else
+                    {
+                        ProcessNodeListSortOrder = NoSortOrder;
+                    }
 
                     getChildren->Children = (PPH_TREENEW_NODE *)ProcessNodeList->Items;
                     getChildren->NumberOfChildren = ProcessNodeList->Count;
@@ -2002,14 +2142,12 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
 
                         PhInitFormatSize(&format[0], number);
                         PhInitFormatS(&format[1], L"/s");
-                        PhMoveReference(&node->IoTotalRateText, PhFormat(format, 2, 0));
-                        getCellText->Text = node->IoTotalRateText->sr;
+                        PhFormatToSlot(&node->IoTotalRateText, format, 2, &getCellText->Text);
                     }
                 }
                 break;
             case PHPRTLC_PRIVATEBYTES:
-                PhMoveReference(&node->PrivateBytesText, PhFormatSize(processItem->VmCounters.PagefileUsage, -1));
-                getCellText->Text = node->PrivateBytesText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.PagefileUsage, &node->PrivateBytesText, &getCellText->Text);
                 break;
             case PHPRTLC_USERNAME:
                 getCellText->Text = PhGetStringRef(processItem->UserName);
@@ -2033,50 +2171,41 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                 getCellText->Text = PhGetStringRef(processItem->CommandLine);
                 break;
             case PHPRTLC_PEAKPRIVATEBYTES:
-                PhMoveReference(&node->PeakPrivateBytesText, PhFormatSize(processItem->VmCounters.PeakPagefileUsage, -1));
-                getCellText->Text = node->PeakPrivateBytesText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.PeakPagefileUsage, &node->PeakPrivateBytesText, &getCellText->Text);
                 break;
             case PHPRTLC_WORKINGSET:
-                PhMoveReference(&node->WorkingSetText, PhFormatSize(processItem->VmCounters.WorkingSetSize, -1));
-                getCellText->Text = node->WorkingSetText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.WorkingSetSize, &node->WorkingSetText, &getCellText->Text);
                 break;
             case PHPRTLC_PEAKWORKINGSET:
-                PhMoveReference(&node->PeakWorkingSetText, PhFormatSize(processItem->VmCounters.PeakWorkingSetSize, -1));
-                getCellText->Text = node->PeakWorkingSetText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.PeakWorkingSetSize, &node->PeakWorkingSetText, &getCellText->Text);
                 break;
             case PHPRTLC_PRIVATEWS:
                 if (WindowsVersion >= WINDOWS_7)
                 {
-                    PhMoveReference(&node->PrivateWsText, PhFormatSize(processItem->WorkingSetPrivateSize, -1));
+                    PhpFormatSizeToSlot(processItem->WorkingSetPrivateSize, &node->PrivateWsText, &getCellText->Text);
                 }
                 else
                 {
                     PhpUpdateProcessNodeWsCounters(node);
-                    PhMoveReference(&node->PrivateWsText, PhFormatSize((ULONG64)node->WsCounters.NumberOfPrivatePages * PAGE_SIZE, -1));
+                    PhpFormatSizeToSlot((ULONG64)node->WsCounters.NumberOfPrivatePages * PAGE_SIZE, &node->PrivateWsText, &getCellText->Text);
                 }
-                getCellText->Text = node->PrivateWsText->sr;
                 break;
             case PHPRTLC_SHAREDWS:
                 PhpUpdateProcessNodeWsCounters(node);
-                PhMoveReference(&node->SharedWsText, PhFormatSize((ULONG64)node->WsCounters.NumberOfSharedPages * PAGE_SIZE, -1));
-                getCellText->Text = node->SharedWsText->sr;
+                PhpFormatSizeToSlot((ULONG64)node->WsCounters.NumberOfSharedPages * PAGE_SIZE, &node->SharedWsText, &getCellText->Text);
                 break;
             case PHPRTLC_SHAREABLEWS:
                 PhpUpdateProcessNodeWsCounters(node);
-                PhMoveReference(&node->ShareableWsText, PhFormatSize((ULONG64)node->WsCounters.NumberOfShareablePages * PAGE_SIZE, -1));
-                getCellText->Text = node->ShareableWsText->sr;
+                PhpFormatSizeToSlot((ULONG64)node->WsCounters.NumberOfShareablePages * PAGE_SIZE, &node->ShareableWsText, &getCellText->Text);
                 break;
             case PHPRTLC_VIRTUALSIZE:
-                PhMoveReference(&node->VirtualSizeText, PhFormatSize(processItem->VmCounters.VirtualSize, -1));
-                getCellText->Text = node->VirtualSizeText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.VirtualSize, &node->VirtualSizeText, &getCellText->Text);
                 break;
             case PHPRTLC_PEAKVIRTUALSIZE:
-                PhMoveReference(&node->PeakVirtualSizeText, PhFormatSize(processItem->VmCounters.PeakVirtualSize, -1));
-                getCellText->Text = node->PeakVirtualSizeText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.PeakVirtualSize, &node->PeakVirtualSizeText, &getCellText->Text);
                 break;
             case PHPRTLC_PAGEFAULTS:
-                PhMoveReference(&node->PageFaultsText, PhFormatUInt64(processItem->VmCounters.PageFaultCount, TRUE));
-                getCellText->Text = node->PageFaultsText->sr;
+                PhpFormatUInt64ToSlot(processItem->VmCounters.PageFaultCount, &node->PageFaultsText, &getCellText->Text);
                 break;
             case PHPRTLC_SESSIONID:
                 PhInitializeStringRefLongHint(&getCellText->Text, processItem->SessionIdString);
@@ -2123,8 +2252,7 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
 
                         PhInitFormatSize(&format[0], number);
                         PhInitFormatS(&format[1], L"/s");
-                        PhMoveReference(&node->IoRoRateText, PhFormat(format, 2, 0));
-                        getCellText->Text = node->IoRoRateText->sr;
+                        PhFormatToSlot(&node->IoRoRateText, format, 2, &getCellText->Text);
                     }
                 }
                 break;
@@ -2149,8 +2277,7 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
 
                         PhInitFormatSize(&format[0], number);
                         PhInitFormatS(&format[1], L"/s");
-                        PhMoveReference(&node->IoWRateText, PhFormat(format, 2, 0));
-                        getCellText->Text = node->IoWRateText->sr;
+                        PhFormatToSlot(&node->IoWRateText, format, 2, &getCellText->Text);
                     }
                 }
                 break;
@@ -2294,13 +2421,13 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                 {
                     if (processItem->CycleTimeDelta.Value != 0)
                     {
-                        PhMoveReference(&node->CyclesText, PhFormatUInt64(processItem->CycleTimeDelta.Value, TRUE));
-                        getCellText->Text = node->CyclesText->sr;
+                        PhpFormatUInt64ToSlot(processItem->CycleTimeDelta.Value, &node->CyclesText, &getCellText->Text);
                     }
                 }
                 else
                 {
-                    getCellText->Text = PhGetStringRef(node->CyclesText);
+                    if (node->CyclesDelta.Value != 0)
+                        PhpFormatUInt64ToSlot(node->CyclesDelta.Value, &node->CyclesText, &getCellText->Text);
                 }
                 break;
             case PHPRTLC_CYCLESDELTA:
@@ -2308,13 +2435,13 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                 {
                     if (processItem->CycleTimeDelta.Delta != 0)
                     {
-                        PhMoveReference(&node->CyclesDeltaText, PhFormatUInt64(processItem->CycleTimeDelta.Delta, TRUE));
-                        getCellText->Text = node->CyclesDeltaText->sr;
+                        PhpFormatUInt64ToSlot(processItem->CycleTimeDelta.Delta, &node->CyclesDeltaText, &getCellText->Text);
                     }
                 }
                 else
                 {
-                    getCellText->Text = PhGetStringRef(node->CyclesDeltaText);
+                    if (node->CyclesDelta.Delta != 0)
+                        PhpFormatUInt64ToSlot(node->CyclesDelta.Delta, &node->CyclesDeltaText, &getCellText->Text);
                 }
                 break;
             case PHPRTLC_DEPSTATUS:
@@ -2339,85 +2466,73 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
             case PHPRTLC_CONTEXTSWITCHES:
                 if (processItem->ContextSwitchesDelta.Value != 0)
                 {
-                    PhMoveReference(&node->ContextSwitchesText, PhFormatUInt64(processItem->ContextSwitchesDelta.Value, TRUE));
-                    getCellText->Text = node->ContextSwitchesText->sr;
+                    PhpFormatUInt64ToSlot(processItem->ContextSwitchesDelta.Value, &node->ContextSwitchesText, &getCellText->Text);
                 }
                 break;
             case PHPRTLC_CONTEXTSWITCHESDELTA:
                 if ((LONG)processItem->ContextSwitchesDelta.Delta > 0) // the delta may be negative if a thread exits - just don't show anything
                 {
-                    PhMoveReference(&node->ContextSwitchesDeltaText, PhFormatUInt64(processItem->ContextSwitchesDelta.Delta, TRUE));
-                    getCellText->Text = node->ContextSwitchesDeltaText->sr;
+                    PhpFormatUInt64ToSlot(processItem->ContextSwitchesDelta.Delta, &node->ContextSwitchesDeltaText, &getCellText->Text);
                 }
                 break;
             case PHPRTLC_PAGEFAULTSDELTA:
                 if (processItem->PageFaultsDelta.Delta != 0)
                 {
-                    PhMoveReference(&node->PageFaultsDeltaText, PhFormatUInt64(processItem->PageFaultsDelta.Delta, TRUE));
-                    getCellText->Text = node->PageFaultsDeltaText->sr;
+                    PhpFormatUInt64ToSlot(processItem->PageFaultsDelta.Delta, &node->PageFaultsDeltaText, &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOREADS:
                 if (processItem->IoReadCountDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[0], PhFormatUInt64(processItem->IoReadCountDelta.Value, TRUE));
-                    getCellText->Text = node->IoGroupText[0]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoReadCountDelta.Value, &node->IoGroupText[0], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOWRITES:
                 if (processItem->IoWriteCountDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[1], PhFormatUInt64(processItem->IoWriteCountDelta.Value, TRUE));
-                    getCellText->Text = node->IoGroupText[1]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoWriteCountDelta.Value, &node->IoGroupText[1], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOOTHER:
                 if (processItem->IoOtherCountDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[2], PhFormatUInt64(processItem->IoOtherCountDelta.Value, TRUE));
-                    getCellText->Text = node->IoGroupText[2]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoOtherCountDelta.Value, &node->IoGroupText[2], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOREADBYTES:
                 if (processItem->IoReadDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[3], PhFormatSize(processItem->IoReadDelta.Value, -1));
-                    getCellText->Text = node->IoGroupText[3]->sr;
+                    PhpFormatSizeToSlot(processItem->IoReadDelta.Value, &node->IoGroupText[3], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOWRITEBYTES:
                 if (processItem->IoWriteDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[4], PhFormatSize(processItem->IoWriteDelta.Value, -1));
-                    getCellText->Text = node->IoGroupText[4]->sr;
+                    PhpFormatSizeToSlot(processItem->IoWriteDelta.Value, &node->IoGroupText[4], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOOTHERBYTES:
                 if (processItem->IoOtherDelta.Value != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[5], PhFormatSize(processItem->IoOtherDelta.Value, -1));
-                    getCellText->Text = node->IoGroupText[5]->sr;
+                    PhpFormatSizeToSlot(processItem->IoOtherDelta.Value, &node->IoGroupText[5], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOREADSDELTA:
                 if (processItem->IoReadCountDelta.Delta != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[6], PhFormatUInt64(processItem->IoReadCountDelta.Delta, TRUE));
-                    getCellText->Text = node->IoGroupText[6]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoReadCountDelta.Delta, &node->IoGroupText[6], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOWRITESDELTA:
                 if (processItem->IoWriteCountDelta.Delta != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[7], PhFormatUInt64(processItem->IoWriteCountDelta.Delta, TRUE));
-                    getCellText->Text = node->IoGroupText[7]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoWriteCountDelta.Delta, &node->IoGroupText[7], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_IOOTHERDELTA:
                 if (processItem->IoOtherCountDelta.Delta != 0)
                 {
-                    PhMoveReference(&node->IoGroupText[8], PhFormatUInt64(processItem->IoOtherCountDelta.Delta, TRUE));
-                    getCellText->Text = node->IoGroupText[8]->sr;
+                    PhpFormatUInt64ToSlot(processItem->IoOtherCountDelta.Delta, &node->IoGroupText[8], &getCellText->Text);
                 }
                 break;
             case PHPRTLC_OSCONTEXT:
@@ -2450,30 +2565,24 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                 }
                 break;
             case PHPRTLC_PAGEDPOOL:
-                PhMoveReference(&node->PagedPoolText, PhFormatSize(processItem->VmCounters.QuotaPagedPoolUsage, -1));
-                getCellText->Text = node->PagedPoolText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.QuotaPagedPoolUsage, &node->PagedPoolText, &getCellText->Text);
                 break;
             case PHPRTLC_PEAKPAGEDPOOL:
-                PhMoveReference(&node->PeakPagedPoolText, PhFormatSize(processItem->VmCounters.QuotaPeakPagedPoolUsage, -1));
-                getCellText->Text = node->PeakPagedPoolText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.QuotaPeakPagedPoolUsage, &node->PeakPagedPoolText, &getCellText->Text);
                 break;
             case PHPRTLC_NONPAGEDPOOL:
-                PhMoveReference(&node->NonPagedPoolText, PhFormatSize(processItem->VmCounters.QuotaNonPagedPoolUsage, -1));
-                getCellText->Text = node->NonPagedPoolText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.QuotaNonPagedPoolUsage, &node->NonPagedPoolText, &getCellText->Text);
                 break;
             case PHPRTLC_PEAKNONPAGEDPOOL:
-                PhMoveReference(&node->PeakNonPagedPoolText, PhFormatSize(processItem->VmCounters.QuotaPeakNonPagedPoolUsage, -1));
-                getCellText->Text = node->PeakNonPagedPoolText->sr;
+                PhpFormatSizeToSlot(processItem->VmCounters.QuotaPeakNonPagedPoolUsage, &node->PeakNonPagedPoolText, &getCellText->Text);
                 break;
             case PHPRTLC_MINIMUMWORKINGSET:
                 PhpUpdateProcessNodeQuotaLimits(node);
-                PhMoveReference(&node->MinimumWorkingSetText, PhFormatSize(node->MinimumWorkingSetSize, -1));
-                getCellText->Text = node->MinimumWorkingSetText->sr;
+                PhpFormatSizeToSlot(node->MinimumWorkingSetSize, &node->MinimumWorkingSetText, &getCellText->Text);
                 break;
             case PHPRTLC_MAXIMUMWORKINGSET:
                 PhpUpdateProcessNodeQuotaLimits(node);
-                PhMoveReference(&node->MaximumWorkingSetText, PhFormatSize(node->MaximumWorkingSetSize, -1));
-                getCellText->Text = node->MaximumWorkingSetText->sr;
+                PhpFormatSizeToSlot(node->MaximumWorkingSetSize, &node->MaximumWorkingSetText, &getCellText->Text);
                 break;
             case PHPRTLC_PRIVATEBYTESDELTA:
                 {
@@ -2499,8 +2608,7 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
                         format[1].Radix = (UCHAR)PhMaxSizeUnit;
                         format[1].u.Size = delta;
 
-                        PhMoveReference(&node->PrivateBytesDeltaText, PhFormat(format, 2, 0));
-                        getCellText->Text = node->PrivateBytesDeltaText->sr;
+                        PhFormatToSlot(&node->PrivateBytesDeltaText, format, 2, &getCellText->Text);
                     }
                 }
                 break;
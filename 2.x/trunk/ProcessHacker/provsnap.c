@@ -0,0 +1,899 @@
+/*
+ * Process Hacker -
+ *   provider snapshot recording and replay
+ *
+ * Copyright (C) 2016 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The providers get their data from a small number of enumeration
+ * functions. In record mode, every buffer returned by these functions
+ * is appended to a snapshot file. In replay mode, the providers receive
+ * copies of the recorded buffers instead, in the order they were
+ * recorded, and the sequence starts again from the beginning once it
+ * has been exhausted. The code which compares the buffers against the
+ * existing items is the same in all modes.
+ *
+ * Some buffers contain pointers into themselves (image names in process
+ * buffers, service names in service buffers). The address of the buffer
+ * at recording time is saved so that these pointers can be relocated.
+ * Module lists are not buffers at all, so they are serialized into
+ * PH_SNAPSHOT_MODULE entries.
+ *
+ * Process and handle snapshots can be scaled up during replay. Each
+ * copy of the recorded entries gets its own range of process IDs or
+ * handle values, which makes it possible to test with many more
+ * processes or handles than the recording system had.
+ */
+
+#include <phapp.h>
+#include <phintrnl.h>
+
+#define PH_SNAPSHOT_FILE_MAGIC ('NSHP')
+#define PH_SNAPSHOT_FILE_VERSION 1
+
+#define PH_SNAPSHOT_PROCESS_ID_STRIDE 0x1000000
+#define PH_SNAPSHOT_HANDLE_VALUE_STRIDE 0x4000000
+#define PH_SNAPSHOT_MAXIMUM_SCALE 64
+
+#define PH_SNAPSHOT_RECORD_FILTER_NEEDED 0x1
+
+typedef struct _PH_SNAPSHOT_FILE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG PointerSize;
+    ULONG Reserved;
+} PH_SNAPSHOT_FILE_HEADER, *PPH_SNAPSHOT_FILE_HEADER;
+
+typedef struct _PH_SNAPSHOT_RECORD
+{
+    ULONG Kind;
+    ULONG Tick;
+    ULONG Size; // size of the data following this header
+    ULONG Flags;
+    ULONG64 Context; // process ID for per-process snapshots
+    ULONG64 OriginalBase; // address of the data when it was recorded
+} PH_SNAPSHOT_RECORD, *PPH_SNAPSHOT_RECORD;
+
+typedef struct _PH_SNAPSHOT_MODULE
+{
+    ULONG Type;
+    ULONG Size;
+    ULONG64 BaseAddress;
+    ULONG64 EntryPoint;
+    ULONG Flags;
+    USHORT LoadOrderIndex;
+    USHORT LoadCount;
+    USHORT LoadReason;
+    USHORT NameLength; // in bytes
+    USHORT FileNameLength; // in bytes
+    USHORT Reserved;
+    LARGE_INTEGER LoadTime;
+    // WCHAR Name[];
+    // WCHAR FileName[];
+} PH_SNAPSHOT_MODULE, *PPH_SNAPSHOT_MODULE;
+
+typedef struct _PH_SNAPSHOT_MODULES_CONTEXT
+{
+    PH_BYTES_BUILDER BytesBuilder;
+    PPH_ENUM_GENERIC_MODULES_CALLBACK Callback;
+    PVOID Context;
+} PH_SNAPSHOT_MODULES_CONTEXT, *PPH_SNAPSHOT_MODULES_CONTEXT;
+
+ULONG PhSnapshotMode = PH_SNAPSHOT_MODE_NONE;
+
+static ULONG PhpSnapshotScale = 1;
+static PPH_FILE_STREAM PhpSnapshotFileStream = NULL;
+static PH_QUEUED_LOCK PhpSnapshotFileLock = PH_QUEUED_LOCK_INIT;
+static ULONG PhpSnapshotRecordTicks[PH_SNAPSHOT_MAXIMUM];
+static PPH_LIST PhpSnapshotRecords[PH_SNAPSHOT_MAXIMUM];
+static LONG PhpSnapshotReplayPositions[PH_SNAPSHOT_MAXIMUM];
+
+static LARGE_INTEGER PhpSnapshotFrequency;
+static PH_SNAPSHOT_STATISTICS PhpSnapshotStatistics[PH_SNAPSHOT_MAXIMUM];
+static PH_QUEUED_LOCK PhpSnapshotStatisticsLock = PH_QUEUED_LOCK_INIT;
+
+static VOID PhpFreeSnapshotRecords(
+    VOID
+    )
+{
+    ULONG i;
+    ULONG j;
+
+    for (i = 0; i < PH_SNAPSHOT_MAXIMUM; i++)
+    {
+        if (!PhpSnapshotRecords[i])
+            continue;
+
+        for (j = 0; j < PhpSnapshotRecords[i]->Count; j++)
+            PhFree(PhpSnapshotRecords[i]->Items[j]);
+
+        PhDereferenceObject(PhpSnapshotRecords[i]);
+        PhpSnapshotRecords[i] = NULL;
+    }
+}
+
+/**
+ * Starts recording provider snapshots.
+ *
+ * \param FileName The file name of the recording. The file is overwritten
+ * if it already exists.
+ */
+NTSTATUS PhStartSnapshotRecording(
+    _In_ PWSTR FileName
+    )
+{
+    NTSTATUS status;
+    PH_SNAPSHOT_FILE_HEADER header;
+    LARGE_INTEGER counter;
+
+    if (PhSnapshotMode != PH_SNAPSHOT_MODE_NONE)
+        return STATUS_INVALID_DEVICE_STATE;
+
+    if (!NT_SUCCESS(status = PhCreateFileStream(
+        &PhpSnapshotFileStream,
+        FileName,
+        FILE_GENERIC_WRITE,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        0
+        )))
+        return status;
+
+    header.Magic = PH_SNAPSHOT_FILE_MAGIC;
+    header.Version = PH_SNAPSHOT_FILE_VERSION;
+    header.PointerSize = sizeof(PVOID);
+    header.Reserved = 0;
+
+    if (!NT_SUCCESS(status = PhWriteFileStream(PhpSnapshotFileStream, &header, sizeof(PH_SNAPSHOT_FILE_HEADER))))
+    {
+        PhDereferenceObject(PhpSnapshotFileStream);
+        PhpSnapshotFileStream = NULL;
+        return status;
+    }
+
+    NtQueryPerformanceCounter(&counter, &PhpSnapshotFrequency);
+    PhEnableThreadAllocationCounts();
+    PhSnapshotMode = PH_SNAPSHOT_MODE_RECORD;
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Starts replaying provider snapshots.
+ *
+ * \param FileName The file name of a recording created by
+ * PhStartSnapshotRecording().
+ * \param Scale The number of copies of each process and handle snapshot
+ * to replay at once.
+ */
+NTSTATUS PhStartSnapshotReplay(
+    _In_ PWSTR FileName,
+    _In_ ULONG Scale
+    )
+{
+    NTSTATUS status;
+    PPH_FILE_STREAM fileStream;
+    PH_SNAPSHOT_FILE_HEADER header;
+    PH_SNAPSHOT_RECORD recordHeader;
+    PPH_SNAPSHOT_RECORD record;
+    ULONG readLength;
+    LARGE_INTEGER counter;
+    ULONG i;
+
+    if (PhSnapshotMode != PH_SNAPSHOT_MODE_NONE)
+        return STATUS_INVALID_DEVICE_STATE;
+    if (Scale == 0 || Scale > PH_SNAPSHOT_MAXIMUM_SCALE)
+        return STATUS_INVALID_PARAMETER_2;
+
+    if (!NT_SUCCESS(status = PhCreateFileStream(
+        &fileStream,
+        FileName,
+        FILE_GENERIC_READ,
+        FILE_SHARE_READ,
+        FILE_OPEN,
+        0
+        )))
+        return status;
+
+    status = PhReadFileStream(fileStream, &header, sizeof(PH_SNAPSHOT_FILE_HEADER), &readLength);
+
+    if (NT_SUCCESS(status) && (
+        readLength != sizeof(PH_SNAPSHOT_FILE_HEADER) ||
+        header.Magic != PH_SNAPSHOT_FILE_MAGIC ||
+        header.Version != PH_SNAPSHOT_FILE_VERSION ||
+        header.PointerSize != sizeof(PVOID)
+        ))
+    {
+        status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    for (i = 0; i < PH_SNAPSHOT_MAXIMUM; i++)
+        PhpSnapshotRecords[i] = PhCreateList(64);
+
+    while (NT_SUCCESS(status))
+    {
+        status = PhReadFileStream(fileStream, &recordHeader, sizeof(PH_SNAPSHOT_RECORD), &readLength);
+
+        if (status == STATUS_END_OF_FILE || (NT_SUCCESS(status) && readLength == 0))
+        {
+            status = STATUS_SUCCESS;
+            break;
+        }
+
+        if (!NT_SUCCESS(status))
+            break;
+
+        if (readLength != sizeof(PH_SNAPSHOT_RECORD) || recordHeader.Kind >= PH_SNAPSHOT_MAXIMUM)
+        {
+            status = STATUS_FILE_CORRUPT_ERROR;
+            break;
+        }
+
+        record = PhAllocate(sizeof(PH_SNAPSHOT_RECORD) + recordHeader.Size);
+        *record = recordHeader;
+
+        if (recordHeader.Size != 0)
+        {
+            status = PhReadFileStream(fileStream, record + 1, recordHeader.Size, &readLength);
+
+            if (NT_SUCCESS(status) && readLength != recordHeader.Size)
+                status = STATUS_FILE_CORRUPT_ERROR;
+
+            if (!NT_SUCCESS(status))
+            {
+                PhFree(record);
+                break;
+            }
+        }
+
+        PhAddItemList(PhpSnapshotRecords[recordHeader.Kind], record);
+    }
+
+    PhDereferenceObject(fileStream);
+
+    if (!NT_SUCCESS(status))
+    {
+        PhpFreeSnapshotRecords();
+        return status;
+    }
+
+    PhpSnapshotScale = Scale;
+    NtQueryPerformanceCounter(&counter, &PhpSnapshotFrequency);
+    PhEnableThreadAllocationCounts();
+    PhSnapshotMode = PH_SNAPSHOT_MODE_REPLAY;
+
+    return STATUS_SUCCESS;
+}
+
+static VOID PhpWriteSnapshotRecord(
+    _In_ ULONG Kind,
+    _In_ ULONG Flags,
+    _In_ ULONG64 Context,
+    _In_reads_bytes_(Size) PVOID Buffer,
+    _In_ ULONG Size
+    )
+{
+    PH_SNAPSHOT_RECORD record;
+
+    record.Kind = Kind;
+    record.Size = Size;
+    record.Flags = Flags;
+    record.Context = Context;
+    record.OriginalBase = (ULONG64)Buffer;
+
+    PhAcquireQueuedLockExclusive(&PhpSnapshotFileLock);
+
+    record.Tick = PhpSnapshotRecordTicks[Kind]++;
+
+    // Flush after every record so that the recording is usable even if we crash.
+    if (NT_SUCCESS(PhWriteFileStream(PhpSnapshotFileStream, &record, sizeof(PH_SNAPSHOT_RECORD))))
+    {
+        if (Size != 0)
+            PhWriteFileStream(PhpSnapshotFileStream, Buffer, Size);
+
+        PhFlushFileStream(PhpSnapshotFileStream, FALSE);
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpSnapshotFileLock);
+}
+
+static PPH_SNAPSHOT_RECORD PhpNextSnapshotRecord(
+    _In_ ULONG Kind
+    )
+{
+    PPH_LIST records;
+    ULONG index;
+
+    records = PhpSnapshotRecords[Kind];
+
+    if (records->Count == 0)
+        return NULL;
+
+    // Start again from the first record once the recording has been exhausted.
+    index = (ULONG)_InterlockedIncrement(&PhpSnapshotReplayPositions[Kind]) - 1;
+
+    return records->Items[index % records->Count];
+}
+
+/**
+ * Records a provider snapshot.
+ *
+ * \param Kind The type of snapshot.
+ * \param Context A value saved with the snapshot.
+ * \param Buffer The snapshot data. The buffer must not contain
+ * pointers.
+ * \param Size The size of \a Buffer, in bytes.
+ *
+ * \remarks This function does nothing if recording is not active.
+ */
+VOID PhRecordSnapshot(
+    _In_ ULONG Kind,
+    _In_ ULONG64 Context,
+    _In_reads_bytes_(Size) PVOID Buffer,
+    _In_ ULONG Size
+    )
+{
+    if (PhSnapshotMode != PH_SNAPSHOT_MODE_RECORD)
+        return;
+
+    PhpWriteSnapshotRecord(Kind, 0, Context, Buffer, Size);
+}
+
+/**
+ * Gets the next recorded provider snapshot.
+ *
+ * \param Kind The type of snapshot.
+ * \param Size A variable which receives the size of the snapshot data,
+ * in bytes.
+ *
+ * \return A copy of the snapshot data, or NULL if there are no snapshots
+ * of the specified type. You must free the buffer with PhFree() when you
+ * no longer need it.
+ */
+PVOID PhReplaySnapshot(
+    _In_ ULONG Kind,
+    _Out_ PULONG Size
+    )
+{
+    PPH_SNAPSHOT_RECORD record;
+
+    if (!(record = PhpNextSnapshotRecord(Kind)) || record->Size == 0)
+        return NULL;
+
+    *Size = record->Size;
+
+    return PhAllocateCopy(record + 1, record->Size);
+}
+
+/**
+ * Starts timing a provider update.
+ *
+ * \param Tick A variable which receives the state of the update. It must be
+ * passed to PhEndSnapshotTick() on the same thread.
+ *
+ * \remarks Allocations are counted for the current thread only, so other
+ * threads (including other providers) do not affect the statistics.
+ */
+VOID PhBeginSnapshotTick(
+    _Out_ PPH_SNAPSHOT_TICK Tick
+    )
+{
+    Tick->Started = FALSE;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_NONE)
+        return;
+
+    Tick->StartAllocations = PhGetThreadAllocationCount();
+    NtQueryPerformanceCounter(&Tick->StartCounter, NULL);
+    Tick->Started = TRUE;
+}
+
+/**
+ * Finishes timing a provider update.
+ *
+ * \param Kind The type of snapshot used by the provider.
+ * \param Tick The state of the update, from PhBeginSnapshotTick().
+ */
+VOID PhEndSnapshotTick(
+    _In_ ULONG Kind,
+    _In_ PPH_SNAPSHOT_TICK Tick
+    )
+{
+    PPH_SNAPSHOT_STATISTICS statistics;
+    LARGE_INTEGER endCounter;
+    ULONG64 time;
+    ULONG allocations;
+
+    if (!Tick->Started)
+        return;
+
+    NtQueryPerformanceCounter(&endCounter, NULL);
+    time = (ULONG64)(endCounter.QuadPart - Tick->StartCounter.QuadPart) * 1000000 / PhpSnapshotFrequency.QuadPart;
+    allocations = PhGetThreadAllocationCount() - Tick->StartAllocations;
+    Tick->Started = FALSE;
+
+    statistics = &PhpSnapshotStatistics[Kind];
+
+    PhAcquireQueuedLockExclusive(&PhpSnapshotStatisticsLock);
+
+    statistics->Ticks++;
+    statistics->TotalTime += time;
+    statistics->TotalAllocations += allocations;
+
+    if (statistics->MaximumTime < time)
+        statistics->MaximumTime = time;
+    if (statistics->MaximumAllocations < allocations)
+        statistics->MaximumAllocations = allocations;
+
+    PhReleaseQueuedLockExclusive(&PhpSnapshotStatisticsLock);
+}
+
+/**
+ * Gets timing information for provider updates.
+ *
+ * \param Kind The type of snapshot used by the provider.
+ * \param Statistics A variable which receives the statistics.
+ */
+VOID PhQuerySnapshotStatistics(
+    _In_ ULONG Kind,
+    _Out_ PPH_SNAPSHOT_STATISTICS Statistics
+    )
+{
+    PhAcquireQueuedLockShared(&PhpSnapshotStatisticsLock);
+    *Statistics = PhpSnapshotStatistics[Kind];
+    PhReleaseQueuedLockShared(&PhpSnapshotStatisticsLock);
+}
+
+static ULONG PhpGetProcessSnapshotSize(
+    _In_ PVOID Processes
+    )
+{
+    PSYSTEM_PROCESS_INFORMATION process;
+    ULONG_PTR end = 0;
+    ULONG_PTR entryEnd;
+
+    process = PH_FIRST_PROCESS(Processes);
+
+    do
+    {
+        entryEnd = (ULONG_PTR)&process->Threads[process->NumberOfThreads];
+
+        if (end < entryEnd)
+            end = entryEnd;
+
+        if (process->ImageName.Buffer)
+        {
+            entryEnd = (ULONG_PTR)process->ImageName.Buffer + process->ImageName.MaximumLength;
+
+            if (end < entryEnd)
+                end = entryEnd;
+        }
+    } while (process = PH_NEXT_PROCESS(process));
+
+    return (ULONG)(end - (ULONG_PTR)Processes);
+}
+
+static PVOID PhpReplayProcessSnapshot(
+    _In_ PPH_SNAPSHOT_RECORD Record
+    )
+{
+    PUCHAR buffer;
+    PUCHAR copy;
+    PSYSTEM_PROCESS_INFORMATION process;
+    ULONG_PTR idOffset;
+    ULONG size;
+    ULONG i;
+    ULONG j;
+
+    size = (ULONG)ALIGN_UP(Record->Size, ULONG64);
+    buffer = PhAllocate(size * PhpSnapshotScale);
+
+    for (i = 0; i < PhpSnapshotScale; i++)
+    {
+        copy = buffer + size * i;
+        memcpy(copy, Record + 1, Record->Size);
+        idOffset = (ULONG_PTR)i * PH_SNAPSHOT_PROCESS_ID_STRIDE;
+        process = PH_FIRST_PROCESS(copy);
+
+        while (TRUE)
+        {
+            if (process->ImageName.Buffer)
+                process->ImageName.Buffer = (PWSTR)((ULONG_PTR)process->ImageName.Buffer - (ULONG_PTR)Record->OriginalBase + (ULONG_PTR)copy);
+
+            if (idOffset != 0)
+            {
+                process->UniqueProcessId = (HANDLE)((ULONG_PTR)process->UniqueProcessId + idOffset);
+
+                if (process->InheritedFromUniqueProcessId)
+                    process->InheritedFromUniqueProcessId = (HANDLE)((ULONG_PTR)process->InheritedFromUniqueProcessId + idOffset);
+
+                for (j = 0; j < process->NumberOfThreads; j++)
+                {
+                    process->Threads[j].ClientId.UniqueProcess = process->UniqueProcessId;
+                    process->Threads[j].ClientId.UniqueThread = (HANDLE)((ULONG_PTR)process->Threads[j].ClientId.UniqueThread + idOffset);
+                }
+            }
+
+            if (!process->NextEntryOffset)
+            {
+                // Link the last entry to the next copy.
+                if (i + 1 < PhpSnapshotScale)
+                    process->NextEntryOffset = (ULONG)(copy + size - (PUCHAR)process);
+
+                break;
+            }
+
+            process = PH_NEXT_PROCESS(process);
+        }
+    }
+
+    return buffer;
+}
+
+/**
+ * Enumerates the running processes for a provider.
+ *
+ * \param Processes A variable which receives a pointer to a buffer
+ * containing process information. You must free the buffer using PhFree()
+ * when you no longer need it.
+ *
+ * \remarks This function behaves like PhEnumProcesses(), except that it
+ * records or replays the process list if recording or replay is active.
+ */
+NTSTATUS PhSnapshotEnumProcesses(
+    _Out_ PVOID *Processes
+    )
+{
+    NTSTATUS status;
+    PVOID processes;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_REPLAY)
+    {
+        PPH_SNAPSHOT_RECORD record;
+
+        if (!(record = PhpNextSnapshotRecord(PH_SNAPSHOT_PROCESSES)) || record->Size < sizeof(SYSTEM_PROCESS_INFORMATION))
+            return STATUS_NO_MORE_ENTRIES;
+
+        *Processes = PhpReplayProcessSnapshot(record);
+
+        return STATUS_SUCCESS;
+    }
+
+    if (!NT_SUCCESS(status = PhEnumProcesses(&processes)))
+        return status;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_RECORD)
+        PhpWriteSnapshotRecord(PH_SNAPSHOT_PROCESSES, 0, 0, processes, PhpGetProcessSnapshotSize(processes));
+
+    *Processes = processes;
+
+    return status;
+}
+
+/**
+ * Enumerates the handles of a process for a provider.
+ *
+ * \remarks This function behaves like PhEnumHandlesGeneric(), except
+ * that it records or replays the handle list if recording or replay is
+ * active. Replayed handles are assigned to \a ProcessId regardless of
+ * the process they were recorded for.
+ */
+NTSTATUS PhSnapshotEnumHandles(
+    _In_ HANDLE ProcessId,
+    _In_opt_ HANDLE ProcessHandle,
+    _Out_ PSYSTEM_HANDLE_INFORMATION_EX *Handles,
+    _Out_ PBOOLEAN FilterNeeded
+    )
+{
+    NTSTATUS status;
+    PSYSTEM_HANDLE_INFORMATION_EX handles;
+    BOOLEAN filterNeeded;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_REPLAY)
+    {
+        PPH_SNAPSHOT_RECORD record;
+        PSYSTEM_HANDLE_INFORMATION_EX source;
+        PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX entries;
+        ULONG count;
+        ULONG i;
+        ULONG j;
+
+        if (!(record = PhpNextSnapshotRecord(PH_SNAPSHOT_HANDLES)) || record->Size < FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles))
+            return STATUS_NO_MORE_ENTRIES;
+
+        source = (PSYSTEM_HANDLE_INFORMATION_EX)(record + 1);
+        count = (record->Size - FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles)) / sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX);
+
+        if (count > source->NumberOfHandles)
+            count = (ULONG)source->NumberOfHandles;
+
+        filterNeeded = !!(record->Flags & PH_SNAPSHOT_RECORD_FILTER_NEEDED);
+        handles = PhAllocate(
+            FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles) +
+            sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) * count * PhpSnapshotScale
+            );
+        handles->NumberOfHandles = count * PhpSnapshotScale;
+        handles->Reserved = 0;
+
+        for (i = 0; i < PhpSnapshotScale; i++)
+        {
+            entries = &handles->Handles[count * i];
+            memcpy(entries, source->Handles, sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) * count);
+
+            for (j = 0; j < count; j++)
+            {
+                if (!filterNeeded || entries[j].UniqueProcessId == (ULONG_PTR)record->Context)
+                    entries[j].UniqueProcessId = (ULONG_PTR)ProcessId;
+
+                entries[j].HandleValue += (ULONG_PTR)i * PH_SNAPSHOT_HANDLE_VALUE_STRIDE;
+            }
+        }
+
+        *Handles = handles;
+        *FilterNeeded = filterNeeded;
+
+        return STATUS_SUCCESS;
+    }
+
+    if (!NT_SUCCESS(status = PhEnumHandlesGeneric(ProcessId, ProcessHandle, &handles, &filterNeeded)))
+        return status;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_RECORD)
+    {
+        PhpWriteSnapshotRecord(
+            PH_SNAPSHOT_HANDLES,
+            filterNeeded ? PH_SNAPSHOT_RECORD_FILTER_NEEDED : 0,
+            (ULONG_PTR)ProcessId,
+            handles,
+            (ULONG)(FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles) + sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) * handles->NumberOfHandles)
+            );
+    }
+
+    *Handles = handles;
+    *FilterNeeded = filterNeeded;
+
+    return status;
+}
+
+/**
+ * Enumerates services for a provider.
+ *
+ * \param ScManagerHandle A handle to the service control manager.
+ * \param Count A variable which receives the number of services.
+ *
+ * \return A buffer of ENUM_SERVICE_STATUS_PROCESS structures, or NULL if
+ * the function failed. You must free the buffer using PhFree() when you
+ * no longer need it.
+ *
+ * \remarks This function behaves like PhEnumServices() with the default
+ * type and state, except that it records or replays the service list if
+ * recording or replay is active.
+ */
+PVOID PhSnapshotEnumServices(
+    _In_ SC_HANDLE ScManagerHandle,
+    _Out_ PULONG Count
+    )
+{
+    LPENUM_SERVICE_STATUS_PROCESS services;
+    ULONG numberOfServices;
+    ULONG_PTR end;
+    ULONG_PTR stringEnd;
+    ULONG i;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_REPLAY)
+    {
+        PPH_SNAPSHOT_RECORD record;
+        ULONG_PTR delta;
+
+        if (!(record = PhpNextSnapshotRecord(PH_SNAPSHOT_SERVICES)))
+            return NULL;
+
+        numberOfServices = (ULONG)record->Context;
+
+        if (record->Size < sizeof(ENUM_SERVICE_STATUS_PROCESS) * numberOfServices)
+            return NULL;
+
+        services = PhAllocateCopy(record + 1, max(record->Size, 1));
+        delta = (ULONG_PTR)services - (ULONG_PTR)record->OriginalBase;
+
+        for (i = 0; i < numberOfServices; i++)
+        {
+            if (services[i].lpServiceName)
+                services[i].lpServiceName = (PWSTR)((ULONG_PTR)services[i].lpServiceName + delta);
+            if (services[i].lpDisplayName)
+                services[i].lpDisplayName = (PWSTR)((ULONG_PTR)services[i].lpDisplayName + delta);
+        }
+
+        *Count = numberOfServices;
+
+        return services;
+    }
+
+    if (!(services = PhEnumServices(ScManagerHandle, 0, 0, &numberOfServices)))
+        return NULL;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_RECORD)
+    {
+        end = (ULONG_PTR)&services[numberOfServices];
+
+        for (i = 0; i < numberOfServices; i++)
+        {
+            if (services[i].lpServiceName)
+            {
+                stringEnd = (ULONG_PTR)services[i].lpServiceName + (wcslen(services[i].lpServiceName) + 1) * sizeof(WCHAR);
+
+                if (end < stringEnd)
+                    end = stringEnd;
+            }
+
+            if (services[i].lpDisplayName)
+            {
+                stringEnd = (ULONG_PTR)services[i].lpDisplayName + (wcslen(services[i].lpDisplayName) + 1) * sizeof(WCHAR);
+
+                if (end < stringEnd)
+                    end = stringEnd;
+            }
+        }
+
+        PhpWriteSnapshotRecord(PH_SNAPSHOT_SERVICES, 0, numberOfServices, services, (ULONG)(end - (ULONG_PTR)services));
+    }
+
+    *Count = numberOfServices;
+
+    return services;
+}
+
+static BOOLEAN NTAPI PhpRecordModuleCallback(
+    _In_ PPH_MODULE_INFO Module,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_SNAPSHOT_MODULES_CONTEXT context = Context;
+    PH_SNAPSHOT_MODULE entry;
+
+    entry.Type = Module->Type;
+    entry.Size = Module->Size;
+    entry.BaseAddress = (ULONG64)Module->BaseAddress;
+    entry.EntryPoint = (ULONG64)Module->EntryPoint;
+    entry.Flags = Module->Flags;
+    entry.LoadOrderIndex = Module->LoadOrderIndex;
+    entry.LoadCount = Module->LoadCount;
+    entry.LoadReason = Module->LoadReason;
+    entry.NameLength = Module->Name ? (USHORT)Module->Name->Length : 0;
+    entry.FileNameLength = Module->FileName ? (USHORT)Module->FileName->Length : 0;
+    entry.Reserved = 0;
+    entry.LoadTime = Module->LoadTime;
+
+    PhAppendBytesBuilderEx(&context->BytesBuilder, &entry, sizeof(PH_SNAPSHOT_MODULE), sizeof(ULONG64), NULL);
+
+    if (entry.NameLength != 0)
+        PhAppendBytesBuilderEx(&context->BytesBuilder, Module->Name->Buffer, entry.NameLength, 0, NULL);
+    if (entry.FileNameLength != 0)
+        PhAppendBytesBuilderEx(&context->BytesBuilder, Module->FileName->Buffer, entry.FileNameLength, 0, NULL);
+
+    return context->Callback(Module, context->Context);
+}
+
+static NTSTATUS PhpReplayModuleSnapshot(
+    _In_ PPH_SNAPSHOT_RECORD Record,
+    _In_ PPH_ENUM_GENERIC_MODULES_CALLBACK Callback,
+    _In_opt_ PVOID Context
+    )
+{
+    PUCHAR buffer;
+    SIZE_T offset;
+    PPH_SNAPSHOT_MODULE entry;
+    PH_MODULE_INFO module;
+    BOOLEAN cont;
+
+    buffer = (PUCHAR)(Record + 1);
+    offset = 0;
+
+    while (TRUE)
+    {
+        offset = ALIGN_UP(offset, ULONG64);
+
+        if (offset + sizeof(PH_SNAPSHOT_MODULE) > Record->Size)
+            break;
+
+        entry = (PPH_SNAPSHOT_MODULE)(buffer + offset);
+        offset += sizeof(PH_SNAPSHOT_MODULE);
+
+        if (offset + entry->NameLength + entry->FileNameLength > Record->Size)
+            return STATUS_FILE_CORRUPT_ERROR;
+
+        module.Type = entry->Type;
+        module.BaseAddress = (PVOID)entry->BaseAddress;
+        module.Size = entry->Size;
+        module.EntryPoint = (PVOID)entry->EntryPoint;
+        module.Flags = entry->Flags;
+        module.Name = PhCreateStringEx((PWCHAR)(buffer + offset), entry->NameLength);
+        module.FileName = PhCreateStringEx((PWCHAR)(buffer + offset + entry->NameLength), entry->FileNameLength);
+        module.LoadOrderIndex = entry->LoadOrderIndex;
+        module.LoadCount = entry->LoadCount;
+        module.LoadReason = entry->LoadReason;
+        module.Reserved = 0;
+        module.LoadTime = entry->LoadTime;
+
+        offset += entry->NameLength + entry->FileNameLength;
+
+        cont = Callback(&module, Context);
+
+        PhDereferenceObject(module.Name);
+        PhDereferenceObject(module.FileName);
+
+        if (!cont)
+            break;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Enumerates the modules of a process for a provider.
+ *
+ * \remarks This function behaves like PhEnumGenericModules(), except that
+ * it records or replays the module list if recording or replay is active.
+ */
+NTSTATUS PhSnapshotEnumGenericModules(
+    _In_ HANDLE ProcessId,
+    _In_opt_ HANDLE ProcessHandle,
+    _In_ ULONG Flags,
+    _In_ PPH_ENUM_GENERIC_MODULES_CALLBACK Callback,
+    _In_opt_ PVOID Context
+    )
+{
+    NTSTATUS status;
+    PH_SNAPSHOT_MODULES_CONTEXT context;
+
+    if (PhSnapshotMode == PH_SNAPSHOT_MODE_REPLAY)
+    {
+        PPH_SNAPSHOT_RECORD record;
+
+        if (!(record = PhpNextSnapshotRecord(PH_SNAPSHOT_MODULES)))
+            return STATUS_NO_MORE_ENTRIES;
+
+        return PhpReplayModuleSnapshot(record, Callback, Context);
+    }
+
+    if (PhSnapshotMode != PH_SNAPSHOT_MODE_RECORD)
+        return PhEnumGenericModules(ProcessId, ProcessHandle, Flags, Callback, Context);
+
+    PhInitializeBytesBuilder(&context.BytesBuilder, 0x1000);
+    context.Callback = Callback;
+    context.Context = Context;
+
+    status = PhEnumGenericModules(ProcessId, ProcessHandle, Flags, PhpRecordModuleCallback, &context);
+
+    if (NT_SUCCESS(status))
+    {
+        PhpWriteSnapshotRecord(
+            PH_SNAPSHOT_MODULES,
+            0,
+            (ULONG_PTR)ProcessId,
+            context.BytesBuilder.Bytes->Buffer,
+            (ULONG)context.BytesBuilder.Bytes->Length
+            );
+    }
+
+    PhDeleteBytesBuilder(&context.BytesBuilder);
+
+    return status;
+}
@@ -302,7 +302,7 @@ ULONG NTAPI PhpSettingsHashtableHashFunction(
 {
     PPH_SETTING setting = (PPH_SETTING)Entry;
 
-    return PhHashBytes((PUCHAR)setting->Name.Buffer, setting->Name.Length);
+    return PhHashStringRefEx(&setting->Name, FALSE, WordHashAlgorithm);
 }
 
 static VOID PhpAddSetting(
@@ -133,9 +133,9 @@ PPH_SERVICE_ITEM PhCreateServiceItem(
 
     if (Information)
     {
-        serviceItem->Name = PhCreateString(Information->lpServiceName);
+        serviceItem->Name = PhInternString(PhCreateString(Information->lpServiceName));
         serviceItem->Key = serviceItem->Name->sr;
-        serviceItem->DisplayName = PhCreateString(Information->lpDisplayName);
+        serviceItem->DisplayName = PhInternString(PhCreateString(Information->lpDisplayName));
         serviceItem->Type = Information->ServiceStatusProcess.dwServiceType;
         serviceItem->State = Information->ServiceStatusProcess.dwCurrentState;
         serviceItem->ControlsAccepted = Information->ServiceStatusProcess.dwControlsAccepted;
@@ -181,7 +181,7 @@ ULONG PhpServiceHashtableHashFunction(
 {
     PPH_SERVICE_ITEM serviceItem = *(PPH_SERVICE_ITEM *)Entry;
 
-    return PhHashStringRef(&serviceItem->Key, TRUE);
+    return PhHashStringRefEx(&serviceItem->Key, TRUE, WordHashAlgorithm);
 }
 
 PPH_SERVICE_ITEM PhpLookupServiceItem(
@@ -430,7 +430,7 @@ static ULONG PhpHashServiceNameEntry(
     _In_ PPHP_SERVICE_NAME_ENTRY Value
     )
 {
-    return PhHashStringRef(&Value->Name, TRUE);
+    return PhHashStringRefEx(&Value->Name, TRUE, WordHashAlgorithm);
 }
 
 VOID PhServiceProviderUpdate(
@@ -449,6 +449,7 @@ VOID PhServiceProviderUpdate(
     ULONG numberOfServices;
     ULONG i;
     PPH_HASH_ENTRY hashEntry;
+    PH_SNAPSHOT_TICK snapshotTick;
 
     // We always execute the first run, and we only initialize non-polling after the first run.
     if (PhEnableServiceNonPoll && runCount != 0)
@@ -481,7 +482,9 @@ VOID PhServiceProviderUpdate(
             return;
     }
 
-    services = PhEnumServices(scManagerHandle, 0, 0, &numberOfServices);
+    PhBeginSnapshotTick(&snapshotTick);
+
+    services = PhSnapshotEnumServices(scManagerHandle, &numberOfServices);
 
     if (!services)
         return;
@@ -758,6 +761,8 @@ VOID PhServiceProviderUpdate(
 
     PhFree(services);
 
+    PhEndSnapshotTick(PH_SNAPSHOT_SERVICES, &snapshotTick);
+
 UpdateEnd:
     PhInvokeCallback(&PhServicesUpdatedEvent, NULL);
     runCount++;
@@ -2905,7 +2905,6 @@ BOOLEAN PhSipMemorySectionCallback(
     case SysInfoGraphGetDrawInfo:
         {
             PPH_GRAPH_DRAW_INFO drawInfo = Parameter1;
-            ULONG i;
 
             if (PhGetIntegerSetting(L"ShowCommitInSummary"))
             {
@@ -2915,10 +2914,7 @@ BOOLEAN PhSipMemorySectionCallback(
 
                 if (!Section->GraphState.Valid)
                 {
-                    for (i = 0; i < drawInfo->LineDataCount; i++)
-                    {
-                        Section->GraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhCommitHistory, i);
-                    }
+                    PhCopyCircularBufferAsSingles_ULONG(&PhCommitHistory, 0, Section->GraphState.Data1, drawInfo->LineDataCount);
 
                     if (PhPerfInformation.CommitLimit != 0)
                     {
@@ -2941,10 +2937,7 @@ BOOLEAN PhSipMemorySectionCallback(
 
                 if (!Section->GraphState.Valid)
                 {
-                    for (i = 0; i < drawInfo->LineDataCount; i++)
-                    {
-                        Section->GraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhPhysicalHistory, i);
-                    }
+                    PhCopyCircularBufferAsSingles_ULONG(&PhPhysicalHistory, 0, Section->GraphState.Data1, drawInfo->LineDataCount);
 
                     if (PhSystemBasicInformation.NumberOfPhysicalPages != 0)
                     {
@@ -3307,7 +3300,6 @@ VOID PhSipNotifyCommitGraph(
         {
             PPH_GRAPH_GETDRAWINFO getDrawInfo = (PPH_GRAPH_GETDRAWINFO)Header;
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
-            ULONG i;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID;
             PhSiSetColorsGraphDrawInfo(drawInfo, PhCsColorPrivate, 0);
@@ -3320,10 +3312,7 @@ VOID PhSipNotifyCommitGraph(
 
             if (!CommitGraphState.Valid)
             {
-                for (i = 0; i < drawInfo->LineDataCount; i++)
-                {
-                    CommitGraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhCommitHistory, i);
-                }
+                PhCopyCircularBufferAsSingles_ULONG(&PhCommitHistory, 0, CommitGraphState.Data1, drawInfo->LineDataCount);
 
                 if (PhPerfInformation.CommitLimit != 0)
                 {
@@ -3375,7 +3364,6 @@ VOID PhSipNotifyPhysicalGraph(
         {
             PPH_GRAPH_GETDRAWINFO getDrawInfo = (PPH_GRAPH_GETDRAWINFO)Header;
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
-            ULONG i;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID;
             PhSiSetColorsGraphDrawInfo(drawInfo, PhCsColorPhysical, 0);
@@ -3388,10 +3376,7 @@ VOID PhSipNotifyPhysicalGraph(
 
             if (!PhysicalGraphState.Valid)
             {
-                for (i = 0; i < drawInfo->LineDataCount; i++)
-                {
-                    PhysicalGraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&PhPhysicalHistory, i);
-                }
+                PhCopyCircularBufferAsSingles_ULONG(&PhPhysicalHistory, 0, PhysicalGraphState.Data1, drawInfo->LineDataCount);
 
                 if (PhSystemBasicInformation.NumberOfPhysicalPages != 0)
                 {
@@ -3762,23 +3747,17 @@ BOOLEAN PhSipIoSectionCallback(
 
             if (!Section->GraphState.Valid)
             {
-                max = 0;
-
                 for (i = 0; i < drawInfo->LineDataCount; i++)
                 {
-                    FLOAT data1;
-                    FLOAT data2;
-
-                    Section->GraphState.Data1[i] = data1 =
+                    Section->GraphState.Data1[i] =
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoReadHistory, i) +
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoOtherHistory, i);
-                    Section->GraphState.Data2[i] = data2 =
+                    Section->GraphState.Data2[i] =
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoWriteHistory, i);
-
-                    if (max < data1 + data2)
-                        max = data1 + data2;
                 }
 
+                max = (FLOAT)PhGetIoTotalHistoryMaximum(drawInfo->LineDataCount);
+
                 // Minimum scaling of 1 MB.
                 if (max < 1024 * 1024)
                     max = 1024 * 1024;
@@ -3991,23 +3970,19 @@ VOID PhSipNotifyIoGraph(
 
             if (!IoGraphState.Valid)
             {
-                FLOAT max = 0;
+                FLOAT max;
 
                 for (i = 0; i < drawInfo->LineDataCount; i++)
                 {
-                    FLOAT data1;
-                    FLOAT data2;
-
-                    IoGraphState.Data1[i] = data1 =
+                    IoGraphState.Data1[i] =
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoReadHistory, i) +
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoOtherHistory, i);
-                    IoGraphState.Data2[i] = data2 =
+                    IoGraphState.Data2[i] =
                         (FLOAT)PhGetItemCircularBuffer_ULONG64(&PhIoWriteHistory, i);
-
-                    if (max < data1 + data2)
-                        max = data1 + data2;
                 }
 
+                max = (FLOAT)PhGetIoTotalHistoryMaximum(drawInfo->LineDataCount);
+
                 // Minimum scaling of 1 MB.
                 if (max < 1024 * 1024)
                     max = 1024 * 1024;
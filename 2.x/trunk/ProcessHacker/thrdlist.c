@@ -284,7 +284,7 @@ VOID PhpDestroyThreadNode(
 {
     PhEmCallObjectOperation(EmThreadNodeType, ThreadNode, EmObjectDelete);
 
-    if (ThreadNode->CyclesDeltaText) PhDereferenceObject(ThreadNode->CyclesDeltaText);
+    PhDeleteFormatSlot(&ThreadNode->CyclesDeltaText);
     if (ThreadNode->StartAddressText) PhDereferenceObject(ThreadNode->StartAddressText);
     if (ThreadNode->PriorityText) PhDereferenceObject(ThreadNode->PriorityText);
 
@@ -411,6 +411,78 @@ BEGIN_SORT_FUNCTION(Service)
 }
 END_SORT_FUNCTION
 
+static VOID PhpSortThreadNodes(
+    _In_ PPH_THREAD_LIST_CONTEXT Context,
+    _In_ int (__cdecl *SortFunction)(void *, const void *, const void *)
+    )
+{
+    PPH_SORT_KEY_COMPARE_FUNCTION compareFunction;
+    PPH_SORT_KEY keys;
+    PPH_THREAD_NODE node;
+    PPH_THREAD_ITEM threadItem;
+    ULONG count;
+    ULONG i;
+
+    // Nodes with equal CPU usage are ordered by cycles, and string keys only contain a
+    // prefix, so these columns still use the sort function for nodes with equal keys.
+
+    switch (Context->TreeNewSortColumn)
+    {
+    case PHTHTLC_CPU:
+    case PHTHTLC_STARTADDRESS:
+    case PHTHTLC_SERVICE:
+        compareFunction = SortFunction;
+        break;
+    default:
+        compareFunction = NULL;
+        break;
+    }
+
+    count = Context->NodeList->Count;
+    keys = PhAllocate(count * sizeof(PH_SORT_KEY));
+
+    for (i = 0; i < count; i++)
+    {
+        node = Context->NodeList->Items[i];
+        threadItem = node->ThreadItem;
+
+        switch (Context->TreeNewSortColumn)
+        {
+        case PHTHTLC_TID:
+            keys[i].Key = (ULONG_PTR)node->ThreadId;
+            break;
+        case PHTHTLC_CPU:
+            keys[i].Key = PhSortKeyFromDouble(threadItem->CpuUsage);
+            break;
+        case PHTHTLC_CYCLESDELTA:
+            if (Context->UseCycleTime)
+                keys[i].Key = threadItem->CyclesDelta.Delta;
+            else
+                keys[i].Key = threadItem->ContextSwitchesDelta.Delta;
+            break;
+        case PHTHTLC_STARTADDRESS:
+            keys[i].Key = PhGetStringSortKey(threadItem->StartAddressString, TRUE);
+            break;
+        case PHTHTLC_PRIORITY:
+            keys[i].Key = PhSortKeyFromInt64(threadItem->PriorityWin32);
+            break;
+        case PHTHTLC_SERVICE:
+            keys[i].Key = PhGetStringSortKey(threadItem->ServiceName, TRUE);
+            break;
+        }
+
+        keys[i].TieKey = (ULONG_PTR)node->ThreadId;
+        keys[i].Item = node;
+    }
+
+    PhSortKeys(keys, count, Context->TreeNewSortOrder, compareFunction, Context);
+
+    for (i = 0; i < count; i++)
+        Context->NodeList->Items[i] = keys[i].Item;
+
+    PhFree(keys);
+}
+
 BOOLEAN NTAPI PhpThreadTreeNewCallback(
     _In_ HWND hwnd,
     _In_ PH_TREENEW_MESSAGE Message,
@@ -466,7 +538,7 @@ BOOLEAN NTAPI PhpThreadTreeNewCallback(
 
                 if (sortFunction)
                 {
-                    qsort_s(context->NodeList->Items, context->NodeList->Count, sizeof(PVOID), sortFunction, context);
+                    PhpSortThreadNodes(context, sortFunction);
                 }
 
                 getChildren->Children = (PPH_TREENEW_NODE *)context->NodeList->Items;
@@ -534,16 +606,22 @@ BOOLEAN NTAPI PhpThreadTreeNewCallback(
                 {
                     if (threadItem->CyclesDelta.Delta != threadItem->CyclesDelta.Value && threadItem->CyclesDelta.Delta != 0)
                     {
-                        PhMoveReference(&node->CyclesDeltaText, PhFormatUInt64(threadItem->CyclesDelta.Delta, TRUE));
-                        getCellText->Text = node->CyclesDeltaText->sr;
+                        PH_FORMAT format;
+
+                        PhInitFormatI64U(&format, threadItem->CyclesDelta.Delta);
+                        format.Type |= FormatGroupDigits;
+                        PhFormatToSlot(&node->CyclesDeltaText, &format, 1, &getCellText->Text);
                     }
                 }
                 else
                 {
                     if (threadItem->ContextSwitchesDelta.Delta != threadItem->ContextSwitchesDelta.Value && threadItem->ContextSwitchesDelta.Delta != 0)
                     {
-                        PhMoveReference(&node->CyclesDeltaText, PhFormatUInt64(threadItem->ContextSwitchesDelta.Delta, TRUE));
-                        getCellText->Text = node->CyclesDeltaText->sr;
+                        PH_FORMAT format;
+
+                        PhInitFormatI64U(&format, threadItem->ContextSwitchesDelta.Delta);
+                        format.Type |= FormatGroupDigits;
+                        PhFormatToSlot(&node->CyclesDeltaText, &format, 1, &getCellText->Text);
                     }
                 }
                 break;
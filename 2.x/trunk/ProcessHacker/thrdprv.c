@@ -124,11 +124,12 @@ PPH_THREAD_PROVIDER PhCreateThreadProvider(
         );
     memset(threadProvider, 0, sizeof(PH_THREAD_PROVIDER));
 
-    threadProvider->ThreadHashtable = PhCreateHashtable(
+    threadProvider->ThreadHashtable = PhCreateHashtableEx(
         sizeof(PPH_THREAD_ITEM),
         PhpThreadHashtableCompareFunction,
         PhpThreadHashtableHashFunction,
-        20
+        20,
+        PH_HASHTABLE_OPEN_ADDRESSING
         );
     PhInitializeFastLock(&threadProvider->ThreadHashtableLock);
 
@@ -52,11 +52,17 @@
  * Hashtable. A hashtable with power-of-two bucket sizes and with all entries stored in a
  * single array. This improves locality but may be inefficient when resizing the hashtable. It
  * is a good idea to store pointers to objects as entries, as opposed to the objects themselves.
+ * Hashtables created with PH_HASHTABLE_OPEN_ADDRESSING instead store entries directly in a
+ * power-of-two slot array with linear probing. A parallel array of control bytes holds a 7-bit
+ * tag for each slot, and probes compare 16 tags at a time using SSE2. Removal shifts later
+ * entries of the probe sequence back, so no tombstones are needed.
  *
  * Simple hashtable. A wrapper around the normal hashtable, with PVOID keys and PVOID values.
  *
  * Free list. A thread-safe memory allocation method where freed blocks are stored in a S-list,
- * and allocations are made from this list whenever possible.
+ * and allocations are made from this list whenever possible. Free lists created with
+ * PH_FREE_LIST_USE_MAGAZINES additionally keep a small chain of blocks (a magazine) per thread,
+ * and move blocks between the magazines and the free list in fixed-size batches.
  *
  * Callback. A thread-safe notification mechanism where clients can register callback functions
  * which are then invoked by other code.
@@ -66,9 +72,6 @@
 #include <phintrnl.h>
 #include <math.h>
 
-#define PH_VECTOR_LEVEL_NONE 0
-#define PH_VECTOR_LEVEL_SSE2 1
-#define PH_VECTOR_LEVEL_AVX 2
 
 typedef struct _PHP_BASE_THREAD_CONTEXT
 {
@@ -76,6 +79,20 @@ typedef struct _PHP_BASE_THREAD_CONTEXT
     PVOID Parameter;
 } PHP_BASE_THREAD_CONTEXT, *PPHP_BASE_THREAD_CONTEXT;
 
+typedef struct _PHP_FREE_LIST_MAGAZINE
+{
+    /** A chain of free blocks linked through their list entries. */
+    PPH_FREE_LIST_ENTRY Head;
+    ULONG Count;
+    ULONG Hits;
+    ULONG Misses;
+} PHP_FREE_LIST_MAGAZINE, *PPHP_FREE_LIST_MAGAZINE;
+
+typedef struct _PHP_FREE_LIST_THREAD_CACHE
+{
+    PHP_FREE_LIST_MAGAZINE Magazines[PH_FREE_LIST_MAXIMUM_MAGAZINES];
+} PHP_FREE_LIST_THREAD_CACHE, *PPHP_FREE_LIST_THREAD_CACHE;
+
 VOID NTAPI PhpListDeleteProcedure(
     _In_ PVOID Object,
     _In_ ULONG Flags
@@ -107,11 +124,27 @@ PPH_OBJECT_TYPE PhHashtableType;
 // Misc.
 
 static BOOLEAN PhpVectorLevel = PH_VECTOR_LEVEL_NONE;
+static BOOLEAN PhpMaximumVectorLevel = PH_VECTOR_LEVEL_NONE;
+static PH_INITONCE PhpUpcaseTableInitOnce = PH_INITONCE_INIT;
+static PSHORT PhpUpcaseTable[256];
 static PPH_STRING PhSharedEmptyString = NULL;
 
+// Allocation counts
+
+static PH_INITONCE PhpAllocationCountInitOnce = PH_INITONCE_INIT;
+static ULONG PhpAllocationCountTlsIndex = TLS_OUT_OF_INDEXES;
+static BOOLEAN PhpCountThreadAllocations = FALSE;
+
 // Threads
 
 static PH_FREE_LIST PhpBaseThreadContextFreeList;
+
+// Free lists
+
+static PH_INITONCE PhpFreeListInitOnce = PH_INITONCE_INIT;
+static ULONG PhpFreeListTlsIndex = TLS_OUT_OF_INDEXES;
+static ULONG PhpFreeListMagazineCount = 0;
+static PPH_FREE_LIST PhpFreeListMagazineTable[PH_FREE_LIST_MAXIMUM_MAGAZINES];
 #ifdef DEBUG
 ULONG PhDbgThreadDbgTlsIndex;
 LIST_ENTRY PhDbgThreadListHead;
@@ -132,6 +165,66 @@ static ULONG PhpPrimeNumbers[] =
     0x3f928f, 0x4c4987, 0x5b8b6f, 0x6dda89
 };
 
+/**
+ * Determines whether AVX2 instructions can be used.
+ */
+BOOLEAN PhpIsAvx2Supported(
+    VOID
+    )
+{
+    INT info[4];
+
+    __cpuid(info, 0);
+
+    if (info[0] < 7)
+        return FALSE;
+
+    // Check for OSXSAVE and AVX, and that the OS saves the YMM state.
+    __cpuid(info, 1);
+
+    if ((info[2] & (1 << 27 | 1 << 28)) != (1 << 27 | 1 << 28))
+        return FALSE;
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return FALSE;
+
+    __cpuidex(info, 7, 0);
+
+    return !!(info[1] & (1 << 5));
+}
+
+/**
+ * Gets the instruction set level used by vectorized functions.
+ */
+ULONG PhGetBaseVectorLevel(
+    VOID
+    )
+{
+    return PhpVectorLevel;
+}
+
+/**
+ * Sets the instruction set level used by vectorized functions. This is
+ * intended for testing, and the level cannot be raised above what the
+ * processor supports.
+ *
+ * \param VectorLevel The new vector level.
+ *
+ * \return The previous vector level.
+ */
+ULONG PhSetBaseVectorLevel(
+    _In_ ULONG VectorLevel
+    )
+{
+    ULONG oldVectorLevel;
+
+    oldVectorLevel = PhpVectorLevel;
+
+    if (VectorLevel < oldVectorLevel || VectorLevel <= PhpMaximumVectorLevel)
+        PhpVectorLevel = (BOOLEAN)VectorLevel;
+
+    return oldVectorLevel;
+}
+
 /**
  * Initializes the base support module.
  */
@@ -148,6 +241,11 @@ BOOLEAN PhInitializeBase(
     else*/ if (USER_SHARED_DATA->ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE])
         PhpVectorLevel = PH_VECTOR_LEVEL_SSE2;
 
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2 && PhpIsAvx2Supported())
+        PhpVectorLevel = PH_VECTOR_LEVEL_AVX2;
+
+    PhpMaximumVectorLevel = PhpVectorLevel;
+
     PhStringType = PhCreateObjectType(L"String", 0, NULL);
     PhBytesType = PhCreateObjectType(L"Bytes", 0, NULL);
 
@@ -164,6 +262,9 @@ BOOLEAN PhInitializeBase(
 
     PhInitializeFreeList(&PhpBaseThreadContextFreeList, sizeof(PHP_BASE_THREAD_CONTEXT), 16);
 
+    // The thread initializing phlib is usually the main (GUI) thread.
+    PhInitializeFreeListThreadCache();
+
 #ifdef DEBUG
     PhDbgThreadDbgTlsIndex = TlsAlloc();
     InitializeListHead(&PhDbgThreadListHead);
@@ -208,12 +309,17 @@ NTSTATUS PhpBaseThreadStart(
     // Initialization code
 
     result = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
+    PhInitializeFreeListThreadCache();
 
     // Call the user-supplied function.
     status = context.StartAddress(context.Parameter);
 
     // De-initialization code
 
+    // The thread may still own biased objects if it exited with an auto-dereference pool.
+    PhRetireCurrentObjectBiasOwner();
+    PhDeleteFreeListThreadCache();
+
     if (result == S_OK || result == S_FALSE)
         CoUninitialize();
 
@@ -249,7 +355,7 @@ HANDLE PhCreateThread(
     threadHandle = CreateThread(
         NULL,
         StackSize,
-        PhpBaseThreadStart,
+        (LPTHREAD_START_ROUTINE)PhpBaseThreadStart,
         context,
         0,
         NULL
@@ -341,6 +447,24 @@ VOID PhLocalTimeToSystemTime(
     SystemTime->QuadPart = LocalTime->QuadPart + timeZoneBias.QuadPart;
 }
 
+/**
+ * Counts an allocation made by the current thread, if enabled by
+ * PhEnableThreadAllocationCounts().
+ */
+FORCEINLINE VOID PhpCountThreadAllocation(
+    VOID
+    )
+{
+    // The count is stored in the TLS slot itself.
+    if (PhpCountThreadAllocations)
+    {
+        TlsSetValue(
+            PhpAllocationCountTlsIndex,
+            (PVOID)((ULONG_PTR)PhpGetTlsValue(PhpAllocationCountTlsIndex) + 1)
+            );
+    }
+}
+
 /**
  * Allocates a block of memory.
  *
@@ -362,6 +486,9 @@ PVOID PhAllocate(
     _In_ SIZE_T Size
     )
 {
+    PHLIB_INC_STATISTIC(BaseAllocations);
+    PhpCountThreadAllocation();
+
     return RtlAllocateHeap(PhHeapHandle, HEAP_GENERATE_EXCEPTIONS, Size);
 }
 
@@ -377,6 +504,9 @@ PVOID PhAllocateSafe(
     _In_ SIZE_T Size
     )
 {
+    PHLIB_INC_STATISTIC(BaseAllocations);
+    PhpCountThreadAllocation();
+
     return RtlAllocateHeap(PhHeapHandle, 0, Size);
 }
 
@@ -394,6 +524,9 @@ PVOID PhAllocateExSafe(
     _In_ ULONG Flags
     )
 {
+    PHLIB_INC_STATISTIC(BaseAllocations);
+    PhpCountThreadAllocation();
+
     return RtlAllocateHeap(PhHeapHandle, Flags, Size);
 }
 
@@ -456,6 +589,49 @@ PVOID PhReAllocateSafe(
     return RtlReAllocateHeap(PhHeapHandle, 0, Memory, Size);
 }
 
+/**
+ * Starts counting the heap allocations made by each thread. Counting
+ * is disabled by default, and cannot be disabled once enabled.
+ *
+ * \return TRUE if counting is enabled, otherwise FALSE.
+ *
+ * \remarks This is intended for measuring code which runs on a
+ * single thread. Use PhGetThreadAllocationCount() before and after
+ * the code and take the difference.
+ */
+BOOLEAN PhEnableThreadAllocationCounts(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhpAllocationCountInitOnce))
+    {
+        PhpAllocationCountTlsIndex = TlsAlloc();
+
+        // The TLS index must be visible before other threads start counting.
+        MemoryBarrier();
+        PhpCountThreadAllocations = PhpAllocationCountTlsIndex != TLS_OUT_OF_INDEXES;
+
+        PhEndInitOnce(&PhpAllocationCountInitOnce);
+    }
+
+    return PhpCountThreadAllocations;
+}
+
+/**
+ * Gets the number of heap allocations made by the current thread since
+ * PhEnableThreadAllocationCounts() was called. The count wraps around
+ * on overflow.
+ */
+ULONG PhGetThreadAllocationCount(
+    VOID
+    )
+{
+    if (!PhpCountThreadAllocations)
+        return 0;
+
+    return (ULONG)(ULONG_PTR)PhpGetTlsValue(PhpAllocationCountTlsIndex);
+}
+
 /**
  * Allocates pages of memory.
  *
@@ -538,7 +714,7 @@ SIZE_T PhCountStringZ(
         ULONG index;
 
         p = (PWSTR)((ULONG_PTR)String & ~0xe); // String should be 2 byte aligned
-        unaligned = (ULONG)String & 0xf;
+        unaligned = (ULONG)((ULONG_PTR)String & 0xf);
         z = _mm_setzero_si128();
 
         if (unaligned != 0)
@@ -1134,6 +1310,123 @@ LONG PhCompareStringZNatural(
         return PhpCompareStringZNatural(A, B, TRUE);
 }
 
+/**
+ * Builds the upcase table.
+ *
+ * \remarks The table stores, for every BMP character, the difference between
+ * RtlUpcaseUnicodeChar() of the character and the character itself. Pages of 256
+ * characters without any case mappings share a single page of zeros.
+ */
+VOID PhpInitializeUpcaseTable(
+    VOID
+    )
+{
+    static SHORT zeroPage[256];
+    SHORT page[256];
+    ULONG i;
+    ULONG j;
+
+    for (i = 0; i < 256; i++)
+    {
+        BOOLEAN identity = TRUE;
+
+        for (j = 0; j < 256; j++)
+        {
+            WCHAR c = (WCHAR)((i << 8) | j);
+
+            page[j] = (SHORT)(RtlUpcaseUnicodeChar(c) - c);
+
+            if (page[j] != 0)
+                identity = FALSE;
+        }
+
+        if (identity)
+            PhpUpcaseTable[i] = zeroPage;
+        else
+            PhpUpcaseTable[i] = PhAllocateCopy(page, sizeof(page));
+    }
+}
+
+/**
+ * Converts a character to uppercase. The result is identical to that of
+ * RtlUpcaseUnicodeChar().
+ */
+FORCEINLINE WCHAR PhpUpcaseChar(
+    _In_ WCHAR Character
+    )
+{
+    return (WCHAR)(Character + PhpUpcaseTable[Character >> 8][Character & 0xff]);
+}
+
+FORCEINLINE VOID PhpEnsureUpcaseTable(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhpUpcaseTableInitOnce))
+    {
+        PhpInitializeUpcaseTable();
+        PhEndInitOnce(&PhpUpcaseTableInitOnce);
+    }
+}
+
+/**
+ * Converts the ASCII characters in a block to uppercase. Other characters
+ * are not modified.
+ */
+FORCEINLINE __m128i PhpUpcaseAsciiSse2(
+    _In_ __m128i Block
+    )
+{
+    __m128i mask;
+
+    // Characters 0x8000 and above are negative, so they are never in range.
+    mask = _mm_and_si128(
+        _mm_cmpgt_epi16(Block, _mm_set1_epi16('a' - 1)),
+        _mm_cmplt_epi16(Block, _mm_set1_epi16('z' + 1))
+        );
+
+    return _mm_sub_epi16(Block, _mm_and_si128(mask, _mm_set1_epi16('a' - 'A')));
+}
+
+/**
+ * Gets a byte mask of the non-ASCII characters in a block.
+ */
+FORCEINLINE ULONG PhpNonAsciiMaskSse2(
+    _In_ __m128i Block
+    )
+{
+    __m128i ascii;
+
+    ascii = _mm_cmpeq_epi16(_mm_and_si128(Block, _mm_set1_epi16((SHORT)0xff80)), _mm_setzero_si128());
+
+    return ~_mm_movemask_epi8(ascii) & 0xffff;
+}
+
+FORCEINLINE __m256i PhpUpcaseAsciiAvx2(
+    _In_ __m256i Block
+    )
+{
+    __m256i mask;
+
+    mask = _mm256_and_si256(
+        _mm256_cmpgt_epi16(Block, _mm256_set1_epi16('a' - 1)),
+        _mm256_cmpgt_epi16(_mm256_set1_epi16('z' + 1), Block)
+        );
+
+    return _mm256_sub_epi16(Block, _mm256_and_si256(mask, _mm256_set1_epi16('a' - 'A')));
+}
+
+FORCEINLINE ULONG PhpNonAsciiMaskAvx2(
+    _In_ __m256i Block
+    )
+{
+    __m256i ascii;
+
+    ascii = _mm256_cmpeq_epi16(_mm256_and_si256(Block, _mm256_set1_epi16((SHORT)0xff80)), _mm256_setzero_si256());
+
+    return ~(ULONG)_mm256_movemask_epi8(ascii);
+}
+
 /**
  * Compares two strings.
  *
@@ -1168,6 +1461,65 @@ LONG PhCompareStringRef(
 
     end = (PWCHAR)((PCHAR)s1 + (l1 <= l2 ? l1 : l2));
 
+    if (IgnoreCase)
+        PhpEnsureUpcaseTable();
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        SIZE_T length16;
+        __m128i b1;
+        __m128i b2;
+        ULONG mask;
+        ULONG index;
+
+        length16 = (end - s1) / (16 / sizeof(WCHAR));
+
+        while (length16 != 0)
+        {
+            b1 = _mm_loadu_si128((__m128i *)s1);
+            b2 = _mm_loadu_si128((__m128i *)s2);
+            mask = _mm_movemask_epi8(_mm_cmpeq_epi16(b1, b2)) ^ 0xffff;
+
+            if (mask != 0)
+            {
+                if (!IgnoreCase)
+                {
+                    _BitScanForward(&index, mask);
+                    index /= sizeof(WCHAR);
+
+                    return (LONG)s1[index] - (LONG)s2[index];
+                }
+
+                if (PhpNonAsciiMaskSse2(_mm_or_si128(b1, b2)) == 0)
+                {
+                    mask = _mm_movemask_epi8(_mm_cmpeq_epi16(PhpUpcaseAsciiSse2(b1), PhpUpcaseAsciiSse2(b2))) ^ 0xffff;
+
+                    if (_BitScanForward(&index, mask))
+                    {
+                        index /= sizeof(WCHAR);
+
+                        return (LONG)PhpUpcaseChar(s1[index]) - (LONG)PhpUpcaseChar(s2[index]);
+                    }
+                }
+                else
+                {
+                    for (index = 0; index < 16 / sizeof(WCHAR); index++)
+                    {
+                        c1 = PhpUpcaseChar(s1[index]);
+                        c2 = PhpUpcaseChar(s2[index]);
+
+                        if (c1 != c2)
+                            return (LONG)c1 - (LONG)c2;
+                    }
+                }
+            }
+
+            s1 += 16 / sizeof(WCHAR);
+            s2 += 16 / sizeof(WCHAR);
+            length16--;
+        }
+    }
+
     if (!IgnoreCase)
     {
         while (s1 != end)
@@ -1191,8 +1543,8 @@ LONG PhCompareStringRef(
 
             if (c1 != c2)
             {
-                c1 = RtlUpcaseUnicodeChar(c1);
-                c2 = RtlUpcaseUnicodeChar(c2);
+                c1 = PhpUpcaseChar(c1);
+                c2 = PhpUpcaseChar(c2);
 
                 if (c1 != c2)
                     return (LONG)c1 - (LONG)c2;
@@ -1206,6 +1558,85 @@ LONG PhCompareStringRef(
     return (LONG)(l1 - l2);
 }
 
+/**
+ * Creates a sort key from a string for use with PhSortKeys().
+ *
+ * \param String A string.
+ * \param IgnoreCase TRUE to create a key for case-insensitive comparisons,
+ * otherwise FALSE.
+ *
+ * \return A key which contains the first four characters of the string. If
+ * the key of one string is less than the key of another string, then
+ * PhCompareStringRef() also finds the first string to be less than the
+ * other. Strings with equal keys must be compared in full.
+ */
+ULONG64 PhGetStringRefSortKey(
+    _In_ PPH_STRINGREF String,
+    _In_ BOOLEAN IgnoreCase
+    )
+{
+    ULONG64 key;
+    SIZE_T length;
+    SIZE_T i;
+    WCHAR c;
+
+    key = 0;
+    length = String->Length / sizeof(WCHAR);
+
+    if (length > sizeof(ULONG64) / sizeof(WCHAR))
+        length = sizeof(ULONG64) / sizeof(WCHAR);
+
+    if (IgnoreCase)
+        PhpEnsureUpcaseTable();
+
+    // Missing characters are zero, so a string sorts before any longer string with the
+    // same prefix.
+    for (i = 0; i < sizeof(ULONG64) / sizeof(WCHAR); i++)
+    {
+        key <<= 16;
+
+        if (i < length)
+        {
+            c = String->Buffer[i];
+
+            if (IgnoreCase)
+                c = PhpUpcaseChar(c);
+
+            key |= c;
+        }
+    }
+
+    return key;
+}
+
+/**
+ * Compares blocks of characters for equality, ignoring case.
+ *
+ * \return TRUE if the blocks are equal, otherwise FALSE.
+ */
+FORCEINLINE BOOLEAN PhpEqualBlockIgnoreCaseSse2(
+    _In_ __m128i Block1,
+    _In_ __m128i Block2,
+    _In_reads_(8) PWCHAR String1,
+    _In_reads_(8) PWCHAR String2
+    )
+{
+    ULONG i;
+
+    if (PhpNonAsciiMaskSse2(_mm_or_si128(Block1, Block2)) == 0)
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi16(PhpUpcaseAsciiSse2(Block1), PhpUpcaseAsciiSse2(Block2))) == 0xffff;
+    }
+
+    for (i = 0; i < 16 / sizeof(WCHAR); i++)
+    {
+        if (String1[i] != String2[i] && PhpUpcaseChar(String1[i]) != PhpUpcaseChar(String2[i]))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * Determines if two strings are equal.
  *
@@ -1239,6 +1670,39 @@ BOOLEAN PhEqualStringRef(
     s1 = String1->Buffer;
     s2 = String2->Buffer;
 
+    if (IgnoreCase)
+        PhpEnsureUpcaseTable();
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_AVX2 && !IgnoreCase)
+    {
+        length = l1 / 32;
+
+        if (length != 0)
+        {
+            __m256i b1;
+            __m256i b2;
+
+            do
+            {
+                b1 = _mm256_loadu_si256((__m256i *)s1);
+                b2 = _mm256_loadu_si256((__m256i *)s2);
+
+                if ((ULONG)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b1, b2)) != 0xffffffff)
+                {
+                    _mm256_zeroupper();
+                    return FALSE;
+                }
+
+                s1 += 32 / sizeof(WCHAR);
+                s2 += 32 / sizeof(WCHAR);
+            } while (--length != 0);
+
+            _mm256_zeroupper();
+        }
+
+        l1 &= 31;
+    }
+
     if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
     {
         length = l1 / 16;
@@ -1252,21 +1716,13 @@ BOOLEAN PhEqualStringRef(
             {
                 b1 = _mm_loadu_si128((__m128i *)s1);
                 b2 = _mm_loadu_si128((__m128i *)s2);
-                b1 = _mm_cmpeq_epi32(b1, b2);
 
-                if (_mm_movemask_epi8(b1) != 0xffff)
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(b1, b2)) != 0xffff)
                 {
                     if (!IgnoreCase)
-                    {
                         return FALSE;
-                    }
-                    else
-                    {
-                        // Compare character-by-character to ignore case.
-                        l1 = length * 16 + (l1 & 15);
-                        l1 /= sizeof(WCHAR);
-                        goto CompareCharacters;
-                    }
+                    if (!PhpEqualBlockIgnoreCaseSse2(b1, b2, s1, s2))
+                        return FALSE;
                 }
 
                 s1 += 16 / sizeof(WCHAR);
@@ -1337,8 +1793,8 @@ CompareCharacters:
 
                 if (c1 != c2)
                 {
-                    c1 = RtlUpcaseUnicodeChar(c1);
-                    c2 = RtlUpcaseUnicodeChar(c2);
+                    c1 = PhpUpcaseChar(c1);
+                    c2 = PhpUpcaseChar(c2);
 
                     if (c1 != c2)
                         return FALSE;
@@ -1371,25 +1827,56 @@ ULONG_PTR PhFindCharInStringRef(
 {
     PWSTR buffer;
     SIZE_T length;
+    ULONG mask;
+    ULONG index;
 
     buffer = String->Buffer;
     length = String->Length / sizeof(WCHAR);
 
     if (!IgnoreCase)
     {
-        if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+        if (PhpVectorLevel >= PH_VECTOR_LEVEL_AVX2)
         {
-            SIZE_T length16;
+            SIZE_T length32;
 
-            length16 = String->Length / 16;
-            length &= 7;
+            length32 = String->Length / 32;
+            length &= 15;
 
-            if (length16 != 0)
+            if (length32 != 0)
             {
-                __m128i pattern;
+                __m256i pattern;
+                __m256i block;
+
+                pattern = _mm256_set1_epi16(Character);
+
+                do
+                {
+                    block = _mm256_loadu_si256((__m256i *)buffer);
+                    mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(block, pattern));
+
+                    if (_BitScanForward(&index, mask))
+                    {
+                        _mm256_zeroupper();
+                        return buffer - String->Buffer + index / 2;
+                    }
+
+                    buffer += 32 / sizeof(WCHAR);
+                } while (--length32 != 0);
+
+                _mm256_zeroupper();
+            }
+        }
+        else if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+        {
+            SIZE_T length16;
+
+            length16 = String->Length / 16;
+            length &= 7;
+
+            if (length16 != 0)
+            {
+                __m128i pattern;
                 __m128i block;
-                ULONG mask;
-                ULONG index;
 
                 pattern = _mm_set1_epi16(Character);
 
@@ -1420,16 +1907,54 @@ ULONG_PTR PhFindCharInStringRef(
     }
     else
     {
-        if (length != 0)
+        WCHAR c;
+
+        PhpEnsureUpcaseTable();
+        c = PhpUpcaseChar(Character);
+
+        if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
         {
-            WCHAR c;
+            SIZE_T length16;
+
+            length16 = String->Length / 16;
+            length &= 7;
 
-            c = RtlUpcaseUnicodeChar(Character);
+            if (length16 != 0)
+            {
+                __m128i pattern;
+                __m128i block;
+
+                pattern = _mm_set1_epi16(c);
+
+                do
+                {
+                    // Non-ASCII characters are always candidates, and are checked using the
+                    // upcase table.
+                    block = _mm_loadu_si128((__m128i *)buffer);
+                    mask = _mm_movemask_epi8(_mm_cmpeq_epi16(PhpUpcaseAsciiSse2(block), pattern));
+                    mask |= PhpNonAsciiMaskSse2(block);
+
+                    while (_BitScanForward(&index, mask))
+                    {
+                        index /= sizeof(WCHAR);
+
+                        if (PhpUpcaseChar(buffer[index]) == c)
+                            return buffer - String->Buffer + index;
+
+                        mask &= ~(3U << (index * 2));
+                    }
+
+                    buffer += 16 / sizeof(WCHAR);
+                } while (--length16 != 0);
+            }
+        }
 
+        if (length != 0)
+        {
             do
             {
-                if (RtlUpcaseUnicodeChar(*buffer) == c)
-                    return String->Length / sizeof(WCHAR) - length;
+                if (PhpUpcaseChar(*buffer) == c)
+                    return buffer - String->Buffer;
 
                 buffer++;
             } while (--length != 0);
@@ -1515,12 +2040,13 @@ ULONG_PTR PhFindLastCharInStringRef(
         {
             WCHAR c;
 
-            c = RtlUpcaseUnicodeChar(Character);
+            PhpEnsureUpcaseTable();
+            c = PhpUpcaseChar(Character);
             buffer--;
 
             do
             {
-                if (RtlUpcaseUnicodeChar(*buffer) == c)
+                if (PhpUpcaseChar(*buffer) == c)
                     return length - 1;
 
                 buffer--;
@@ -1541,6 +2067,10 @@ ULONG_PTR PhFindLastCharInStringRef(
  *
  * \return The index, in characters, of the first occurrence of
  * \a SubString in \a String. If \a SubString was not found, -1 is returned.
+ *
+ * \remarks The vectorized search compares the first and last characters of
+ * \a SubString against many positions at once, and only compares the
+ * whole substring at positions where both match.
  */
 ULONG_PTR PhFindStringInStringRef(
     _In_ PPH_STRINGREF String,
@@ -1550,10 +2080,13 @@ ULONG_PTR PhFindStringInStringRef(
 {
     SIZE_T length1;
     SIZE_T length2;
-    PH_STRINGREF sr1;
-    PH_STRINGREF sr2;
-    WCHAR c;
-    SIZE_T i;
+    SIZE_T positions;
+    PWCHAR buffer;
+    PH_STRINGREF sr;
+    WCHAR first;
+    WCHAR last;
+    ULONG mask;
+    ULONG index;
 
     length1 = String->Length / sizeof(WCHAR);
     length2 = SubString->Length / sizeof(WCHAR);
@@ -1565,39 +2098,132 @@ ULONG_PTR PhFindStringInStringRef(
     if (length2 == 0)
         return 0;
 
-    sr1.Buffer = String->Buffer;
-    sr1.Length = SubString->Length - sizeof(WCHAR);
-    sr2.Buffer = SubString->Buffer;
-    sr2.Length = SubString->Length - sizeof(WCHAR);
+    if (IgnoreCase)
+    {
+        PhpEnsureUpcaseTable();
+        first = PhpUpcaseChar(SubString->Buffer[0]);
+        last = PhpUpcaseChar(SubString->Buffer[length2 - 1]);
+    }
+    else
+    {
+        first = SubString->Buffer[0];
+        last = SubString->Buffer[length2 - 1];
+    }
+
+    buffer = String->Buffer;
+    positions = length1 - length2 + 1;
+    sr.Length = SubString->Length;
 
-    if (!IgnoreCase)
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_AVX2 && positions >= 32 / sizeof(WCHAR))
     {
-        c = *sr2.Buffer++;
+        __m256i firstPattern;
+        __m256i lastPattern;
+        __m256i firstBlock;
+        __m256i lastBlock;
+
+        firstPattern = _mm256_set1_epi16(first);
+        lastPattern = _mm256_set1_epi16(last);
 
-        for (i = length1 - length2 + 1; i != 0; i--)
+        do
         {
-            if (*sr1.Buffer++ == c && PhEqualStringRef(&sr1, &sr2, FALSE))
+            firstBlock = _mm256_loadu_si256((__m256i *)buffer);
+            lastBlock = _mm256_loadu_si256((__m256i *)(buffer + length2 - 1));
+
+            if (!IgnoreCase)
             {
-                goto FoundUString;
+                mask = _mm256_movemask_epi8(_mm256_and_si256(
+                    _mm256_cmpeq_epi16(firstBlock, firstPattern),
+                    _mm256_cmpeq_epi16(lastBlock, lastPattern)
+                    ));
             }
-        }
+            else
+            {
+                mask = (_mm256_movemask_epi8(_mm256_cmpeq_epi16(PhpUpcaseAsciiAvx2(firstBlock), firstPattern)) |
+                    PhpNonAsciiMaskAvx2(firstBlock)) &
+                    (_mm256_movemask_epi8(_mm256_cmpeq_epi16(PhpUpcaseAsciiAvx2(lastBlock), lastPattern)) |
+                    PhpNonAsciiMaskAvx2(lastBlock));
+            }
+
+            while (_BitScanForward(&index, mask))
+            {
+                index /= sizeof(WCHAR);
+                sr.Buffer = buffer + index;
+
+                if (PhEqualStringRef(&sr, SubString, IgnoreCase))
+                {
+                    _mm256_zeroupper();
+                    return sr.Buffer - String->Buffer;
+                }
+
+                mask &= ~(3U << (index * 2));
+            }
+
+            buffer += 32 / sizeof(WCHAR);
+            positions -= 32 / sizeof(WCHAR);
+        } while (positions >= 32 / sizeof(WCHAR));
+
+        _mm256_zeroupper();
     }
-    else
+    else if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2 && positions >= 16 / sizeof(WCHAR))
     {
-        c = RtlUpcaseUnicodeChar(*sr2.Buffer++);
+        __m128i firstPattern;
+        __m128i lastPattern;
+        __m128i firstBlock;
+        __m128i lastBlock;
 
-        for (i = length1 - length2 + 1; i != 0; i--)
+        firstPattern = _mm_set1_epi16(first);
+        lastPattern = _mm_set1_epi16(last);
+
+        do
         {
-            if (RtlUpcaseUnicodeChar(*sr1.Buffer++) == c && PhEqualStringRef(&sr1, &sr2, TRUE))
+            firstBlock = _mm_loadu_si128((__m128i *)buffer);
+            lastBlock = _mm_loadu_si128((__m128i *)(buffer + length2 - 1));
+
+            if (!IgnoreCase)
+            {
+                mask = _mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi16(firstBlock, firstPattern),
+                    _mm_cmpeq_epi16(lastBlock, lastPattern)
+                    ));
+            }
+            else
+            {
+                mask = (_mm_movemask_epi8(_mm_cmpeq_epi16(PhpUpcaseAsciiSse2(firstBlock), firstPattern)) |
+                    PhpNonAsciiMaskSse2(firstBlock)) &
+                    (_mm_movemask_epi8(_mm_cmpeq_epi16(PhpUpcaseAsciiSse2(lastBlock), lastPattern)) |
+                    PhpNonAsciiMaskSse2(lastBlock));
+            }
+
+            while (_BitScanForward(&index, mask))
             {
-                goto FoundUString;
+                index /= sizeof(WCHAR);
+                sr.Buffer = buffer + index;
+
+                if (PhEqualStringRef(&sr, SubString, IgnoreCase))
+                    return sr.Buffer - String->Buffer;
+
+                mask &= ~(3U << (index * 2));
             }
+
+            buffer += 16 / sizeof(WCHAR);
+            positions -= 16 / sizeof(WCHAR);
+        } while (positions >= 16 / sizeof(WCHAR));
+    }
+
+    for (; positions != 0; positions--)
+    {
+        if ((IgnoreCase ? PhpUpcaseChar(*buffer) : *buffer) == first)
+        {
+            sr.Buffer = buffer;
+
+            if (PhEqualStringRef(&sr, SubString, IgnoreCase))
+                return buffer - String->Buffer;
         }
+
+        buffer++;
     }
 
     return -1;
-FoundUString:
-    return (ULONG_PTR)(sr1.Buffer - String->Buffer - 1);
 }
 
 /**
@@ -2206,7 +2832,7 @@ PPH_STRING PhReferenceEmptyString(
         newString = PhCreateStringEx(NULL, 0);
 
         string = _InterlockedCompareExchangePointer(
-            &PhSharedEmptyString,
+            (PVOID *)&PhSharedEmptyString,
             newString,
             NULL
             );
@@ -2262,7 +2888,7 @@ PPH_STRING PhConcatStrings_V(
 
     // Compute the total length, in bytes, of the strings.
 
-    argptr = ArgPtr;
+    va_copy(argptr, ArgPtr);
 
     for (i = 0; i < Count; i++)
     {
@@ -2274,6 +2900,8 @@ PPH_STRING PhConcatStrings_V(
             cachedLengths[i] = stringLength;
     }
 
+    va_end(argptr);
+
     // Create the string.
 
     string = PhCreateStringEx(NULL, totalLength);
@@ -2281,7 +2909,7 @@ PPH_STRING PhConcatStrings_V(
 
     // Append the strings one by one.
 
-    argptr = ArgPtr;
+    va_copy(argptr, ArgPtr);
 
     for (i = 0; i < Count; i++)
     {
@@ -2300,6 +2928,8 @@ PPH_STRING PhConcatStrings_V(
         totalLength += stringLength;
     }
 
+    va_end(argptr);
+
     return string;
 }
 
@@ -3104,6 +3734,186 @@ PPH_BYTES PhConvertUtf16ToMultiByteEx(
     return bytes;
 }
 
+/**
+ * Converts a run of ASCII characters from UTF-8 to UTF-16.
+ *
+ * \param Output A buffer which receives the UTF-16 characters, or NULL to
+ * only count the characters.
+ * \param Input The UTF-8 input.
+ * \param Count The maximum number of characters to convert.
+ *
+ * \return The number of characters converted. Conversion stops at the first
+ * non-ASCII character.
+ */
+SIZE_T PhpConvertAsciiUtf8ToUtf16(
+    _Out_writes_opt_(Count) PWCH Output,
+    _In_reads_(Count) PCH Input,
+    _In_ SIZE_T Count
+    )
+{
+    PCH in;
+    PWCH out;
+    SIZE_T remaining;
+
+    in = Input;
+    out = Output;
+    remaining = Count;
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_AVX2 && remaining >= 32)
+    {
+        __m256i block;
+
+        do
+        {
+            block = _mm256_loadu_si256((__m256i *)in);
+
+            if (_mm256_movemask_epi8(block) != 0)
+                break;
+
+            if (out)
+            {
+                _mm256_storeu_si256((__m256i *)out, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(block)));
+                _mm256_storeu_si256((__m256i *)(out + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(block, 1)));
+                out += 32;
+            }
+
+            in += 32;
+            remaining -= 32;
+        } while (remaining >= 32);
+
+        _mm256_zeroupper();
+    }
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i block;
+
+        while (remaining >= 16)
+        {
+            block = _mm_loadu_si128((__m128i *)in);
+
+            if (_mm_movemask_epi8(block) != 0)
+                break;
+
+            if (out)
+            {
+                _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(block, _mm_setzero_si128()));
+                _mm_storeu_si128((__m128i *)(out + 8), _mm_unpackhi_epi8(block, _mm_setzero_si128()));
+                out += 16;
+            }
+
+            in += 16;
+            remaining -= 16;
+        }
+    }
+
+    while (remaining != 0 && (UCHAR)*in < 0x80)
+    {
+        if (out)
+            *out++ = *in;
+
+        in++;
+        remaining--;
+    }
+
+    return in - Input;
+}
+
+/**
+ * Converts a run of ASCII characters from UTF-16 to UTF-8.
+ *
+ * \param Output A buffer which receives the UTF-8 characters, or NULL to
+ * only count the characters.
+ * \param Input The UTF-16 input.
+ * \param Count The maximum number of characters to convert.
+ *
+ * \return The number of characters converted. Conversion stops at the first
+ * non-ASCII character.
+ */
+SIZE_T PhpConvertAsciiUtf16ToUtf8(
+    _Out_writes_opt_(Count) PCH Output,
+    _In_reads_(Count) PWCH Input,
+    _In_ SIZE_T Count
+    )
+{
+    PWCH in;
+    PCH out;
+    SIZE_T remaining;
+
+    in = Input;
+    out = Output;
+    remaining = Count;
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_AVX2 && remaining >= 32)
+    {
+        __m256i block1;
+        __m256i block2;
+        __m256i mask;
+
+        mask = _mm256_set1_epi16((SHORT)0xff80);
+
+        do
+        {
+            block1 = _mm256_loadu_si256((__m256i *)in);
+            block2 = _mm256_loadu_si256((__m256i *)(in + 16));
+
+            if (!_mm256_testz_si256(_mm256_or_si256(block1, block2), mask))
+                break;
+
+            if (out)
+            {
+                // The pack instruction works within each 128-bit lane, so the
+                // 64-bit elements need to be put back in order.
+                _mm256_storeu_si256((__m256i *)out, _mm256_permute4x64_epi64(_mm256_packus_epi16(block1, block2), 0xd8));
+                out += 32;
+            }
+
+            in += 32;
+            remaining -= 32;
+        } while (remaining >= 32);
+
+        _mm256_zeroupper();
+    }
+
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i block1;
+        __m128i block2;
+        __m128i mask;
+
+        mask = _mm_set1_epi16((SHORT)0xff80);
+
+        while (remaining >= 16)
+        {
+            block1 = _mm_loadu_si128((__m128i *)in);
+            block2 = _mm_loadu_si128((__m128i *)(in + 8));
+
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(block1, block2), mask), _mm_setzero_si128())) != 0xffff)
+                break;
+
+            if (out)
+            {
+                _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(block1, block2));
+                out += 16;
+            }
+
+            in += 16;
+            remaining -= 16;
+        }
+    }
+
+    while (remaining != 0 && *in < 0x80)
+    {
+        if (out)
+            *out++ = (CHAR)*in;
+
+        in++;
+        remaining--;
+    }
+
+    return in - Input;
+}
+
 BOOLEAN PhConvertUtf8ToUtf16Size(
     _Out_ PSIZE_T BytesInUtf16String,
     _In_reads_bytes_(BytesInUtf8String) PCH Utf8String,
@@ -3126,6 +3936,20 @@ BOOLEAN PhConvertUtf8ToUtf16Size(
 
     while (inRemaining != 0)
     {
+        // Skip the decoder for runs of ASCII characters.
+        if (decoder.State == 0 && (UCHAR)*in < 0x80)
+        {
+            SIZE_T count;
+
+            count = PhpConvertAsciiUtf8ToUtf16(NULL, in, inRemaining);
+            bytesInUtf16String += count * sizeof(WCHAR);
+            in += count;
+            inRemaining -= count;
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (UCHAR)*in);
         in++;
         inRemaining--;
@@ -3173,6 +3997,26 @@ BOOLEAN PhConvertUtf8ToUtf16Buffer(
 
     while (inRemaining != 0)
     {
+        // Convert runs of ASCII characters directly. If the output buffer is
+        // too small, the decoder handles the remaining input so that the
+        // required size is still calculated.
+        if (decoder.State == 0 && (UCHAR)*in < 0x80)
+        {
+            SIZE_T count;
+
+            count = PhpConvertAsciiUtf8ToUtf16(out, in, min(inRemaining, outRemaining));
+
+            if (count != 0)
+            {
+                bytesInUtf16String += count * sizeof(WCHAR);
+                in += count;
+                inRemaining -= count;
+                out += count;
+                outRemaining -= count;
+                continue;
+            }
+        }
+
         PhWriteUnicodeDecoder(&decoder, (UCHAR)*in);
         in++;
         inRemaining--;
@@ -3276,6 +4120,20 @@ BOOLEAN PhConvertUtf16ToUtf8Size(
 
     while (inRemaining != 0)
     {
+        // Skip the decoder for runs of ASCII characters.
+        if (decoder.State == 0 && *in < 0x80)
+        {
+            SIZE_T count;
+
+            count = PhpConvertAsciiUtf16ToUtf8(NULL, in, inRemaining);
+            bytesInUtf8String += count;
+            in += count;
+            inRemaining -= count;
+
+            if (inRemaining == 0)
+                break;
+        }
+
         PhWriteUnicodeDecoder(&decoder, (USHORT)*in);
         in++;
         inRemaining--;
@@ -3323,6 +4181,26 @@ BOOLEAN PhConvertUtf16ToUtf8Buffer(
 
     while (inRemaining != 0)
     {
+        // Convert runs of ASCII characters directly. If the output buffer is
+        // too small, the decoder handles the remaining input so that the
+        // required size is still calculated.
+        if (decoder.State == 0 && *in < 0x80)
+        {
+            SIZE_T count;
+
+            count = PhpConvertAsciiUtf16ToUtf8(out, in, min(inRemaining, outRemaining));
+
+            if (count != 0)
+            {
+                bytesInUtf8String += count;
+                in += count;
+                inRemaining -= count;
+                out += count;
+                outRemaining -= count;
+                continue;
+            }
+        }
+
         PhWriteUnicodeDecoder(&decoder, (USHORT)*in);
         in++;
         inRemaining--;
@@ -3501,7 +4379,7 @@ VOID PhpResizeStringBuilder(
     newString->Length = StringBuilder->String->Length;
 
     // Dereference the old string and replace it with the new string.
-    PhMoveReference(&StringBuilder->String, newString);
+    PhMoveReference((PVOID *)&StringBuilder->String, newString);
 
     PHLIB_INC_STATISTIC(BaseStringBuildersResized);
 }
@@ -3886,7 +4764,7 @@ VOID PhpResizeBytesBuilder(
     newBytes->Length = BytesBuilder->Bytes->Length;
 
     // Dereference the old byte string and replace it with the new byte string.
-    PhMoveReference(&BytesBuilder->Bytes, newBytes);
+    PhMoveReference((PVOID *)&BytesBuilder->Bytes, newBytes);
 }
 
 FORCEINLINE VOID PhpWriteNullTerminatorBytesBuilder(
@@ -4299,14 +5177,14 @@ FORCEINLINE HANDLE PhpPointerListIndexToHandle(
 {
     // Add one to allow NULL handles to indicate
     // failure/an invalid index.
-    return (HANDLE)(Index + 1);
+    return (HANDLE)(ULONG_PTR)(Index + 1);
 }
 
 FORCEINLINE ULONG PhpPointerListHandleToIndex(
     _In_ HANDLE Handle
     )
 {
-    return (ULONG)Handle - 1;
+    return (ULONG)(ULONG_PTR)Handle - 1;
 }
 
 /**
@@ -4480,42 +5358,414 @@ FORCEINLINE ULONG PhpGetNumberOfBuckets(
 #endif
 }
 
-/**
- * Creates a hashtable object.
- *
- * \param EntrySize The size of each hashtable entry,
- * in bytes.
- * \param CompareFunction A comparison function that
- * is executed to compare two hashtable entries.
- * \param HashFunction A hash function that is executed
- * to generate a hash code for a hashtable entry.
- * \param InitialCapacity The number of entries to
- * allocate storage for initially.
- */
-PPH_HASHTABLE PhCreateHashtable(
-    _In_ ULONG EntrySize,
-    _In_ PPH_HASHTABLE_COMPARE_FUNCTION CompareFunction,
-    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
-    _In_ ULONG InitialCapacity
+FORCEINLINE ULONG PhpGetNumberOfSlots(
+    _In_ ULONG Capacity
     )
 {
-    PPH_HASHTABLE hashtable;
+    ULONG numberOfSlots;
 
-    hashtable = PhCreateObject(sizeof(PH_HASHTABLE), PhHashtableType);
+    // Keep the load factor at or below 3/4 so that probe sequences stay short.
+    numberOfSlots = PhRoundUpToPowerOfTwo(Capacity + Capacity / 3 + 1);
 
-    // Initial capacity of 0 is not allowed.
-    if (InitialCapacity == 0)
-        InitialCapacity = 1;
+    if (numberOfSlots < PH_HASHTABLE_GROUP_SIZE)
+        numberOfSlots = PH_HASHTABLE_GROUP_SIZE;
 
-    hashtable->EntrySize = EntrySize;
-    hashtable->CompareFunction = CompareFunction;
-    hashtable->HashFunction = HashFunction;
+    return numberOfSlots;
+}
 
-    // Allocate the buckets.
-    hashtable->AllocatedBuckets = PhpGetNumberOfBuckets(InitialCapacity);
-    hashtable->Buckets = PhAllocate(sizeof(ULONG) * hashtable->AllocatedBuckets);
-    // Set all bucket values to -1.
-    memset(hashtable->Buckets, 0xff, sizeof(ULONG) * hashtable->AllocatedBuckets);
+FORCEINLINE UCHAR PhpTagFromHash(
+    _In_ ULONG Hash
+    )
+{
+    // The low bits of the hash select the home slot, so take the tag from the
+    // high bits of a multiplicative mix which depend on every bit of the hash.
+    return (UCHAR)((Hash * 0x9e3779b1) >> 25);
+}
+
+/**
+ * Compares a group of control bytes against a tag.
+ *
+ * \param Control A pointer to the first control byte in the group.
+ * \param Tag The tag to search for.
+ * \param MatchMask A variable which receives a bit mask of slots in the group
+ * whose tag is equal to \a Tag.
+ * \param EmptyMask A variable which receives a bit mask of unused slots in the
+ * group.
+ */
+FORCEINLINE VOID PhpMatchGroupHashtable(
+    _In_reads_(PH_HASHTABLE_GROUP_SIZE) PUCHAR Control,
+    _In_ UCHAR Tag,
+    _Out_ PULONG MatchMask,
+    _Out_ PULONG EmptyMask
+    )
+{
+    if (PhpVectorLevel >= PH_VECTOR_LEVEL_SSE2)
+    {
+        __m128i group;
+
+        group = _mm_loadu_si128((__m128i *)Control);
+        *MatchMask = _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(Tag)));
+        // Tags never have their high bit set, so this only picks up empty slots.
+        *EmptyMask = _mm_movemask_epi8(group);
+    }
+    else
+    {
+        ULONG matchMask = 0;
+        ULONG emptyMask = 0;
+        ULONG i;
+
+        for (i = 0; i < PH_HASHTABLE_GROUP_SIZE; i++)
+        {
+            if (Control[i] == Tag)
+                matchMask |= 1 << i;
+            if (Control[i] == PH_HASHTABLE_CONTROL_EMPTY)
+                emptyMask |= 1 << i;
+        }
+
+        *MatchMask = matchMask;
+        *EmptyMask = emptyMask;
+    }
+}
+
+FORCEINLINE VOID PhpSetControlHashtable(
+    _Inout_ PPH_HASHTABLE Hashtable,
+    _In_ ULONG Index,
+    _In_ UCHAR Value
+    )
+{
+    Hashtable->Control[Index] = Value;
+
+    // Keep the mirrored bytes after the last slot up to date.
+    if (Index < PH_HASHTABLE_GROUP_SIZE)
+        Hashtable->Control[Hashtable->AllocatedEntries + Index] = Value;
+}
+
+VOID PhpAllocateSlotsHashtable(
+    _Inout_ PPH_HASHTABLE Hashtable,
+    _In_ ULONG NumberOfSlots
+    )
+{
+    PPH_HASHTABLE_ENTRY entry;
+    ULONG entrySize;
+    ULONG i;
+
+    entrySize = PH_HASHTABLE_ENTRY_SIZE(Hashtable->EntrySize);
+
+    Hashtable->AllocatedBuckets = NumberOfSlots;
+    Hashtable->AllocatedEntries = NumberOfSlots;
+    Hashtable->NextEntry = NumberOfSlots;
+    Hashtable->Control = PhAllocate(NumberOfSlots + PH_HASHTABLE_GROUP_SIZE);
+    memset(Hashtable->Control, PH_HASHTABLE_CONTROL_EMPTY, NumberOfSlots + PH_HASHTABLE_GROUP_SIZE);
+    Hashtable->Entries = PhAllocate(entrySize * NumberOfSlots);
+
+    // Unused slots are marked with a hash code of -1 so that the normal enumeration
+    // functions skip them.
+    entry = Hashtable->Entries;
+
+    for (i = 0; i < NumberOfSlots; i++)
+    {
+        entry->HashCode = -1;
+        entry = PTR_ADD_OFFSET(entry, entrySize);
+    }
+}
+
+/**
+ * Finds the first unused slot in the probe sequence of a hash code.
+ */
+FORCEINLINE ULONG PhpFindEmptySlotHashtable(
+    _In_ PPH_HASHTABLE Hashtable,
+    _In_ ULONG HashCode
+    )
+{
+    ULONG mask;
+    ULONG position;
+    ULONG matchMask;
+    ULONG emptyMask;
+    ULONG bit;
+
+    mask = Hashtable->AllocatedEntries - 1;
+    position = HashCode & mask;
+
+    while (TRUE)
+    {
+        PhpMatchGroupHashtable(&Hashtable->Control[position], PH_HASHTABLE_CONTROL_EMPTY, &matchMask, &emptyMask);
+
+        if (_BitScanForward(&bit, emptyMask))
+            return (position + bit) & mask;
+
+        position = (position + PH_HASHTABLE_GROUP_SIZE) & mask;
+    }
+}
+
+/**
+ * Finds the slot containing an entry in an open addressing hashtable.
+ *
+ * \return The index of the slot, or -1 if the entry could not be found.
+ */
+FORCEINLINE ULONG PhpFindSlotHashtable(
+    _In_ PPH_HASHTABLE Hashtable,
+    _In_ PVOID Entry,
+    _In_ ULONG HashCode
+    )
+{
+    ULONG mask;
+    ULONG entrySize;
+    ULONG position;
+    UCHAR tag;
+    ULONG matchMask;
+    ULONG emptyMask;
+    ULONG bit;
+    ULONG index;
+    PPH_HASHTABLE_ENTRY entry;
+
+    mask = Hashtable->AllocatedEntries - 1;
+    entrySize = PH_HASHTABLE_ENTRY_SIZE(Hashtable->EntrySize);
+    position = HashCode & mask;
+    tag = PhpTagFromHash(HashCode);
+
+    while (TRUE)
+    {
+        PhpMatchGroupHashtable(&Hashtable->Control[position], tag, &matchMask, &emptyMask);
+
+        // The probe sequence ends at the first unused slot, so ignore any matches after it.
+        if (emptyMask)
+            matchMask &= (emptyMask & (0 - emptyMask)) - 1;
+
+        while (_BitScanForward(&bit, matchMask))
+        {
+            index = (position + bit) & mask;
+            entry = PTR_ADD_OFFSET(Hashtable->Entries, entrySize * index);
+
+            if (entry->HashCode == HashCode && Hashtable->CompareFunction(&entry->Body, Entry))
+                return index;
+
+            matchMask &= matchMask - 1;
+        }
+
+        if (emptyMask)
+            return -1;
+
+        position = (position + PH_HASHTABLE_GROUP_SIZE) & mask;
+    }
+}
+
+VOID PhpResizeOpenHashtable(
+    _Inout_ PPH_HASHTABLE Hashtable,
+    _In_ ULONG NumberOfSlots
+    )
+{
+    PUCHAR oldControl;
+    PVOID oldEntries;
+    ULONG oldNumberOfSlots;
+    ULONG entrySize;
+    PPH_HASHTABLE_ENTRY entry;
+    ULONG index;
+    ULONG i;
+
+    oldControl = Hashtable->Control;
+    oldEntries = Hashtable->Entries;
+    oldNumberOfSlots = Hashtable->AllocatedEntries;
+    entrySize = PH_HASHTABLE_ENTRY_SIZE(Hashtable->EntrySize);
+
+    PhpAllocateSlotsHashtable(Hashtable, NumberOfSlots);
+
+    // Re-insert the entries. The stored hash codes are re-used, so the hash
+    // function is not called again.
+
+    entry = oldEntries;
+
+    for (i = 0; i < oldNumberOfSlots; i++)
+    {
+        if (oldControl[i] != PH_HASHTABLE_CONTROL_EMPTY)
+        {
+            index = PhpFindEmptySlotHashtable(Hashtable, entry->HashCode);
+            PhpSetControlHashtable(Hashtable, index, oldControl[i]);
+            memcpy(PTR_ADD_OFFSET(Hashtable->Entries, entrySize * index), entry, entrySize);
+        }
+
+        entry = PTR_ADD_OFFSET(entry, entrySize);
+    }
+
+    PhFree(oldControl);
+    PhFree(oldEntries);
+}
+
+PVOID PhpAddEntryOpenHashtable(
+    _Inout_ PPH_HASHTABLE Hashtable,
+    _In_ PVOID Entry,
+    _In_ BOOLEAN CheckForDuplicate,
+    _Out_opt_ PBOOLEAN Added
+    )
+{
+    ULONG hashCode;
+    ULONG index;
+    PPH_HASHTABLE_ENTRY entry;
+
+    hashCode = PhpValidateHash(Hashtable->HashFunction(Entry));
+
+    if (CheckForDuplicate)
+    {
+        index = PhpFindSlotHashtable(Hashtable, Entry, hashCode);
+
+        if (index != -1)
+        {
+            if (Added)
+                *Added = FALSE;
+
+            return &PH_HASHTABLE_GET_ENTRY(Hashtable, index)->Body;
+        }
+    }
+
+    if (Hashtable->Count + 1 > Hashtable->AllocatedEntries - Hashtable->AllocatedEntries / 4)
+    {
+        // Resize the hashtable.
+        PhpResizeOpenHashtable(Hashtable, Hashtable->AllocatedEntries * 2);
+    }
+
+    index = PhpFindEmptySlotHashtable(Hashtable, hashCode);
+    PhpSetControlHashtable(Hashtable, index, PhpTagFromHash(hashCode));
+
+    // Initialize the entry.
+    entry = PH_HASHTABLE_GET_ENTRY(Hashtable, index);
+    entry->HashCode = hashCode;
+    entry->Next = -1;
+    // Copy the user-supplied data to the entry.
+    memcpy(&entry->Body, Entry, Hashtable->EntrySize);
+
+    Hashtable->Count++;
+
+    if (Added)
+        *Added = TRUE;
+
+    return &entry->Body;
+}
+
+BOOLEAN PhpRemoveEntryOpenHashtable(
+    _Inout_ PPH_HASHTABLE Hashtable,
+    _In_ PVOID Entry
+    )
+{
+    ULONG mask;
+    ULONG entrySize;
+    ULONG hole;
+    ULONG index;
+    ULONG home;
+    PPH_HASHTABLE_ENTRY entry;
+
+    hole = PhpFindSlotHashtable(Hashtable, Entry, PhpValidateHash(Hashtable->HashFunction(Entry)));
+
+    if (hole == -1)
+        return FALSE;
+
+    mask = Hashtable->AllocatedEntries - 1;
+    entrySize = PH_HASHTABLE_ENTRY_SIZE(Hashtable->EntrySize);
+    index = hole;
+
+    // Shift back any following entries in the probe sequence which can be moved into
+    // the hole without moving them before their home slot.
+    while (TRUE)
+    {
+        index = (index + 1) & mask;
+
+        if (Hashtable->Control[index] == PH_HASHTABLE_CONTROL_EMPTY)
+            break;
+
+        entry = PTR_ADD_OFFSET(Hashtable->Entries, entrySize * index);
+        home = entry->HashCode & mask;
+
+        if (((index - home) & mask) >= ((index - hole) & mask))
+        {
+            memcpy(PTR_ADD_OFFSET(Hashtable->Entries, entrySize * hole), entry, entrySize);
+            PhpSetControlHashtable(Hashtable, hole, Hashtable->Control[index]);
+            hole = index;
+        }
+    }
+
+    PhpSetControlHashtable(Hashtable, hole, PH_HASHTABLE_CONTROL_EMPTY);
+    PH_HASHTABLE_GET_ENTRY(Hashtable, hole)->HashCode = -1; // indicates the entry is not being used
+
+    Hashtable->Count--;
+
+    return TRUE;
+}
+
+/**
+ * Creates a hashtable object.
+ *
+ * \param EntrySize The size of each hashtable entry,
+ * in bytes.
+ * \param CompareFunction A comparison function that
+ * is executed to compare two hashtable entries.
+ * \param HashFunction A hash function that is executed
+ * to generate a hash code for a hashtable entry.
+ * \param InitialCapacity The number of entries to
+ * allocate storage for initially.
+ */
+PPH_HASHTABLE PhCreateHashtable(
+    _In_ ULONG EntrySize,
+    _In_ PPH_HASHTABLE_COMPARE_FUNCTION CompareFunction,
+    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    _In_ ULONG InitialCapacity
+    )
+{
+    return PhCreateHashtableEx(EntrySize, CompareFunction, HashFunction, InitialCapacity, 0);
+}
+
+/**
+ * Creates a hashtable object.
+ *
+ * \param EntrySize The size of each hashtable entry,
+ * in bytes.
+ * \param CompareFunction A comparison function that
+ * is executed to compare two hashtable entries.
+ * \param HashFunction A hash function that is executed
+ * to generate a hash code for a hashtable entry.
+ * \param InitialCapacity The number of entries to
+ * allocate storage for initially.
+ * \param Flags A combination of flags.
+ * \li \c PH_HASHTABLE_OPEN_ADDRESSING Store entries inline
+ * in a slot array probed with hash tags instead of chaining
+ * them through buckets.
+ */
+PPH_HASHTABLE PhCreateHashtableEx(
+    _In_ ULONG EntrySize,
+    _In_ PPH_HASHTABLE_COMPARE_FUNCTION CompareFunction,
+    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    _In_ ULONG InitialCapacity,
+    _In_ ULONG Flags
+    )
+{
+    PPH_HASHTABLE hashtable;
+
+    hashtable = PhCreateObject(sizeof(PH_HASHTABLE), PhHashtableType);
+
+    // Initial capacity of 0 is not allowed.
+    if (InitialCapacity == 0)
+        InitialCapacity = 1;
+
+    hashtable->EntrySize = EntrySize;
+    hashtable->Flags = Flags;
+    hashtable->CompareFunction = CompareFunction;
+    hashtable->HashFunction = HashFunction;
+
+    if (Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+    {
+        hashtable->Buckets = NULL;
+        PhpAllocateSlotsHashtable(hashtable, PhpGetNumberOfSlots(InitialCapacity));
+
+        hashtable->Count = 0;
+        hashtable->FreeEntry = -1;
+
+        return hashtable;
+    }
+
+    hashtable->Control = NULL;
+
+    // Allocate the buckets.
+    hashtable->AllocatedBuckets = PhpGetNumberOfBuckets(InitialCapacity);
+    hashtable->Buckets = PhAllocate(sizeof(ULONG) * hashtable->AllocatedBuckets);
+    // Set all bucket values to -1.
+    memset(hashtable->Buckets, 0xff, sizeof(ULONG) * hashtable->AllocatedBuckets);
 
     // Allocate the entries.
     hashtable->AllocatedEntries = hashtable->AllocatedBuckets;
@@ -4535,7 +5785,11 @@ VOID PhpHashtableDeleteProcedure(
 {
     PPH_HASHTABLE hashtable = (PPH_HASHTABLE)Object;
 
-    PhFree(hashtable->Buckets);
+    if (hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+        PhFree(hashtable->Control);
+    else
+        PhFree(hashtable->Buckets);
+
     PhFree(hashtable->Entries);
 }
 
@@ -4593,6 +5847,9 @@ FORCEINLINE PVOID PhpAddEntryHashtable(
     ULONG freeEntry; // index of new entry in entry array
     PPH_HASHTABLE_ENTRY entry; // pointer to new entry in entry array
 
+    if (Hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+        return PhpAddEntryOpenHashtable(Hashtable, Entry, CheckForDuplicate, Added);
+
     hashCode = PhpValidateHash(Hashtable->HashFunction(Entry));
     index = PhpIndexFromHash(Hashtable, hashCode);
 
@@ -4720,6 +5977,27 @@ VOID PhClearHashtable(
 {
     if (Hashtable->Count > 0)
     {
+        if (Hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+        {
+            PPH_HASHTABLE_ENTRY entry;
+            ULONG entrySize;
+            ULONG i;
+
+            entrySize = PH_HASHTABLE_ENTRY_SIZE(Hashtable->EntrySize);
+            entry = Hashtable->Entries;
+
+            for (i = 0; i < Hashtable->AllocatedEntries; i++)
+            {
+                entry->HashCode = -1;
+                entry = PTR_ADD_OFFSET(entry, entrySize);
+            }
+
+            memset(Hashtable->Control, PH_HASHTABLE_CONTROL_EMPTY, Hashtable->AllocatedEntries + PH_HASHTABLE_GROUP_SIZE);
+            Hashtable->Count = 0;
+
+            return;
+        }
+
         memset(Hashtable->Buckets, 0xff, sizeof(ULONG) * Hashtable->AllocatedBuckets);
         Hashtable->Count = 0;
         Hashtable->FreeEntry = -1;
@@ -4798,6 +6076,17 @@ PVOID PhFindEntryHashtable(
     PPH_HASHTABLE_ENTRY entry;
 
     hashCode = PhpValidateHash(Hashtable->HashFunction(Entry));
+
+    if (Hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+    {
+        i = PhpFindSlotHashtable(Hashtable, Entry, hashCode);
+
+        if (i != -1)
+            return &PH_HASHTABLE_GET_ENTRY(Hashtable, i)->Body;
+        else
+            return NULL;
+    }
+
     index = PhpIndexFromHash(Hashtable, hashCode);
 
     for (i = Hashtable->Buckets[index]; i != -1; i = entry->Next)
@@ -4838,6 +6127,9 @@ BOOLEAN PhRemoveEntryHashtable(
     ULONG previousIndex;
     PPH_HASHTABLE_ENTRY entry;
 
+    if (Hashtable->Flags & PH_HASHTABLE_OPEN_ADDRESSING)
+        return PhpRemoveEntryOpenHashtable(Hashtable, Entry);
+
     hashCode = PhpValidateHash(Hashtable->HashFunction(Entry));
     index = PhpIndexFromHash(Hashtable, hashCode);
     previousIndex = -1;
@@ -4937,6 +6229,210 @@ ULONG PhHashStringRef(
     return hash;
 }
 
+#define PH_HASH_SECRET0 0xa0761d6478bd642f
+#define PH_HASH_SECRET1 0xe7037ed1a0b428db
+#define PH_HASH_SECRET2 0x8ebc6af09c88c6e3
+
+/**
+ * Multiplies two 64-bit integers and folds the 128-bit result.
+ */
+FORCEINLINE ULONG64 PhpHashMultiply(
+    _In_ ULONG64 A,
+    _In_ ULONG64 B
+    )
+{
+#ifdef _WIN64
+    ULONG64 low;
+    ULONG64 high;
+
+    low = _umul128(A, B, &high);
+
+    return low ^ high;
+#else
+    ULONG64 ll;
+    ULONG64 lh;
+    ULONG64 hl;
+    ULONG64 hh;
+    ULONG64 middle;
+
+    ll = __emulu((ULONG)A, (ULONG)B);
+    lh = __emulu((ULONG)A, (ULONG)(B >> 32));
+    hl = __emulu((ULONG)(A >> 32), (ULONG)B);
+    hh = __emulu((ULONG)(A >> 32), (ULONG)(B >> 32));
+    middle = (ll >> 32) + (ULONG)lh + (ULONG)hl;
+
+    return (((ULONG)ll) | (middle << 32)) ^ (hh + (lh >> 32) + (hl >> 32) + (middle >> 32));
+#endif
+}
+
+FORCEINLINE ULONG64 PhpHashWordBlock(
+    _In_ ULONG64 Seed,
+    _In_ ULONG64 Word1,
+    _In_ ULONG64 Word2
+    )
+{
+    return PhpHashMultiply(Word1 ^ PH_HASH_SECRET1, Word2 ^ Seed);
+}
+
+/**
+ * Hashes the last 1 to 16 bytes of the input and finalizes the hash.
+ */
+FORCEINLINE ULONG PhpHashWordFinal(
+    _In_ ULONG64 Seed,
+    _In_reads_(Remaining) PUCHAR Bytes,
+    _In_ SIZE_T Remaining,
+    _In_ SIZE_T Length
+    )
+{
+    ULONG64 a;
+    ULONG64 b;
+
+    if (Remaining >= 8)
+    {
+        a = *(PULONG64)Bytes;
+        b = *(PULONG64)(Bytes + Remaining - 8);
+    }
+    else if (Remaining >= 4)
+    {
+        a = *(PULONG)Bytes;
+        b = *(PULONG)(Bytes + Remaining - 4);
+    }
+    else
+    {
+        a = ((ULONG64)Bytes[0] << 16) | ((ULONG64)Bytes[Remaining >> 1] << 8) | Bytes[Remaining - 1];
+        b = 0;
+    }
+
+    Seed = PhpHashMultiply(a ^ PH_HASH_SECRET1, b ^ Seed);
+
+    return (ULONG)PhpHashMultiply(Seed ^ PH_HASH_SECRET2, Length ^ PH_HASH_SECRET1);
+}
+
+/**
+ * Converts the ASCII characters in a block of 4 characters to uppercase. The
+ * block must not contain any non-ASCII characters.
+ */
+FORCEINLINE ULONG64 PhpUpcaseAsciiWord(
+    _In_ ULONG64 Word
+    )
+{
+    ULONG64 aboveA;
+    ULONG64 aboveZ;
+
+    // Since each character is less than 0x80, adding to it cannot carry into
+    // the next character. Bit 7 of each result is set if the character is at
+    // least 'a' or greater than 'z' respectively.
+    aboveA = Word + 0x0080008000800080 - 0x0061006100610061;
+    aboveZ = Word + 0x0080008000800080 - 0x007b007b007b007b;
+
+    return Word - (((aboveA & ~aboveZ) & 0x0080008000800080) >> 2);
+}
+
+/**
+ * Generates a hash code for a sequence of bytes.
+ *
+ * \param Bytes The bytes to hash.
+ * \param Length The number of bytes.
+ * \param Algorithm The hash function to use.
+ *
+ * \remarks \ref Fnv1aHashAlgorithm produces the same results as
+ * PhHashBytes(). \ref WordHashAlgorithm processes 16 bytes per step and
+ * should be used by new tables.
+ */
+ULONG PhHashBytesEx(
+    _In_reads_(Length) PUCHAR Bytes,
+    _In_ SIZE_T Length,
+    _In_ PH_HASH_ALGORITHM Algorithm
+    )
+{
+    ULONG64 seed;
+    SIZE_T remaining;
+
+    if (Algorithm == Fnv1aHashAlgorithm)
+        return PhHashBytes(Bytes, Length);
+
+    if (Length == 0)
+        return 0;
+
+    seed = PH_HASH_SECRET0;
+    remaining = Length;
+
+    while (remaining > 16)
+    {
+        seed = PhpHashWordBlock(seed, *(PULONG64)Bytes, *(PULONG64)(Bytes + 8));
+        Bytes += 16;
+        remaining -= 16;
+    }
+
+    return PhpHashWordFinal(seed, Bytes, remaining, Length);
+}
+
+/**
+ * Generates a hash code for a string.
+ *
+ * \param String The string to hash.
+ * \param IgnoreCase TRUE for a case-insensitive hash function, otherwise FALSE.
+ * \param Algorithm The hash function to use.
+ *
+ * \remarks With \ref WordHashAlgorithm, a case-insensitive hash of a string
+ * is the same as a case-sensitive hash of the uppercase version of the string.
+ */
+ULONG PhHashStringRefEx(
+    _In_ PPH_STRINGREF String,
+    _In_ BOOLEAN IgnoreCase,
+    _In_ PH_HASH_ALGORITHM Algorithm
+    )
+{
+    ULONG64 seed;
+    PWCHAR buffer;
+    SIZE_T remaining;
+    ULONG64 words[2];
+    WCHAR tail[8];
+    ULONG i;
+
+    if (!IgnoreCase)
+        return PhHashBytesEx((PUCHAR)String->Buffer, String->Length, Algorithm);
+    if (Algorithm == Fnv1aHashAlgorithm)
+        return PhHashStringRef(String, TRUE);
+
+    if (String->Length == 0)
+        return 0;
+
+    PhpEnsureUpcaseTable();
+
+    seed = PH_HASH_SECRET0;
+    buffer = String->Buffer;
+    remaining = String->Length / sizeof(WCHAR);
+
+    // Fold 8 characters per step. ASCII-only blocks are folded using integer
+    // arithmetic, and other blocks are folded using the upcase table.
+    while (remaining > 8)
+    {
+        words[0] = *(PULONG64)buffer;
+        words[1] = *(PULONG64)(buffer + 4);
+
+        if (((words[0] | words[1]) & 0xff80ff80ff80ff80) == 0)
+        {
+            words[0] = PhpUpcaseAsciiWord(words[0]);
+            words[1] = PhpUpcaseAsciiWord(words[1]);
+        }
+        else
+        {
+            for (i = 0; i < 8; i++)
+                ((PWCHAR)words)[i] = PhpUpcaseChar(buffer[i]);
+        }
+
+        seed = PhpHashWordBlock(seed, words[0], words[1]);
+        buffer += 8;
+        remaining -= 8;
+    }
+
+    for (i = 0; i < remaining; i++)
+        tail[i] = PhpUpcaseChar(buffer[i]);
+
+    return PhpHashWordFinal(seed, (PUCHAR)tail, remaining * sizeof(WCHAR), String->Length);
+}
+
 BOOLEAN NTAPI PhpSimpleHashtableCompareFunction(
     _In_ PVOID Entry1,
     _In_ PVOID Entry2
@@ -5028,11 +6524,64 @@ VOID PhInitializeFreeList(
     _In_ SIZE_T Size,
     _In_ ULONG MaximumCount
     )
+{
+    PhInitializeFreeListEx(FreeList, Size, MaximumCount, 0);
+}
+
+/**
+ * Initializes a free list object.
+ *
+ * \param FreeList A pointer to the free list object.
+ * \param Size The number of bytes in each allocation.
+ * \param MaximumCount The number of unused allocations
+ * to store.
+ * \param Flags A combination of flags.
+ * \li \c PH_FREE_LIST_USE_MAGAZINES Cache blocks in
+ * per-thread magazines. If all magazines are in use, the free
+ * list works as if this flag was not specified.
+ */
+VOID PhInitializeFreeListEx(
+    _Out_ PPH_FREE_LIST FreeList,
+    _In_ SIZE_T Size,
+    _In_ ULONG MaximumCount,
+    _In_ ULONG Flags
+    )
 {
     RtlInitializeSListHead(&FreeList->ListHead);
     FreeList->Count = 0;
     FreeList->MaximumCount = MaximumCount;
     FreeList->Size = Size;
+    FreeList->Flags = 0;
+    FreeList->MagazineIndex = -1;
+    RtlInitializeSListHead(&FreeList->MagazineListHead);
+    FreeList->MagazineHits = 0;
+    FreeList->MagazineMisses = 0;
+
+    if (Flags & PH_FREE_LIST_USE_MAGAZINES)
+    {
+        ULONG magazineIndex;
+
+        // Batches store a pointer to the rest of the batch in the first block.
+        assert(Size >= sizeof(PVOID));
+
+        if (PhBeginInitOnce(&PhpFreeListInitOnce))
+        {
+            PhpFreeListTlsIndex = TlsAlloc();
+            PhEndInitOnce(&PhpFreeListInitOnce);
+        }
+
+        if (PhpFreeListTlsIndex == TLS_OUT_OF_INDEXES)
+            return;
+
+        magazineIndex = _InterlockedIncrement((PLONG)&PhpFreeListMagazineCount) - 1;
+
+        if (magazineIndex < PH_FREE_LIST_MAXIMUM_MAGAZINES)
+        {
+            PhpFreeListMagazineTable[magazineIndex] = FreeList;
+            FreeList->Flags = PH_FREE_LIST_USE_MAGAZINES;
+            FreeList->MagazineIndex = magazineIndex;
+        }
+    }
 }
 
 /**
@@ -5047,6 +6596,8 @@ VOID PhDeleteFreeList(
     PPH_FREE_LIST_ENTRY entry;
     PSLIST_ENTRY listEntry;
 
+    assert(!(FreeList->Flags & PH_FREE_LIST_USE_MAGAZINES));
+
     listEntry = RtlInterlockedFlushSList(&FreeList->ListHead);
 
     while (listEntry)
@@ -5057,6 +6608,167 @@ VOID PhDeleteFreeList(
     }
 }
 
+/**
+ * Creates the free list thread cache for the current thread. Allocations
+ * from free lists using magazines will be cached in this thread until
+ * PhDeleteFreeListThreadCache() is called.
+ *
+ * \remarks Threads created by PhCreateThread() already have a thread cache.
+ */
+VOID PhInitializeFreeListThreadCache(
+    VOID
+    )
+{
+    PPHP_FREE_LIST_THREAD_CACHE threadCache;
+
+    if (PhpFreeListTlsIndex == TLS_OUT_OF_INDEXES)
+        return;
+    if (PhpGetTlsValue(PhpFreeListTlsIndex))
+        return;
+
+    threadCache = PhAllocate(sizeof(PHP_FREE_LIST_THREAD_CACHE));
+    memset(threadCache, 0, sizeof(PHP_FREE_LIST_THREAD_CACHE));
+    TlsSetValue(PhpFreeListTlsIndex, threadCache);
+}
+
+/**
+ * Returns all cached blocks in the current thread to their free lists
+ * and deletes the free list thread cache.
+ */
+VOID PhDeleteFreeListThreadCache(
+    VOID
+    )
+{
+    PPHP_FREE_LIST_THREAD_CACHE threadCache;
+    PPHP_FREE_LIST_MAGAZINE magazine;
+    PPH_FREE_LIST freeList;
+    PPH_FREE_LIST_ENTRY entry;
+    ULONG i;
+
+    if (PhpFreeListTlsIndex == TLS_OUT_OF_INDEXES)
+        return;
+
+    threadCache = PhpGetTlsValue(PhpFreeListTlsIndex);
+
+    if (!threadCache)
+        return;
+
+    TlsSetValue(PhpFreeListTlsIndex, NULL);
+
+    for (i = 0; i < PH_FREE_LIST_MAXIMUM_MAGAZINES; i++)
+    {
+        magazine = &threadCache->Magazines[i];
+        freeList = PhpFreeListMagazineTable[i];
+
+        if (!freeList)
+            continue;
+
+        _InterlockedExchangeAdd((PLONG)&freeList->MagazineHits, magazine->Hits);
+        _InterlockedExchangeAdd((PLONG)&freeList->MagazineMisses, magazine->Misses);
+
+        while (entry = magazine->Head)
+        {
+            magazine->Head = (PPH_FREE_LIST_ENTRY)entry->ListEntry.Next;
+            PhFreeToFreeList(freeList, &entry->Body);
+        }
+    }
+
+    PhFree(threadCache);
+}
+
+FORCEINLINE PPHP_FREE_LIST_MAGAZINE PhpGetFreeListMagazine(
+    _In_ PPH_FREE_LIST FreeList
+    )
+{
+    PPHP_FREE_LIST_THREAD_CACHE threadCache;
+
+    threadCache = PhpGetTlsValue(PhpFreeListTlsIndex);
+
+    if (threadCache)
+        return &threadCache->Magazines[FreeList->MagazineIndex];
+    else
+        return NULL;
+}
+
+/**
+ * Refills an empty magazine with a batch of blocks from a free list.
+ *
+ * \return The first block of the batch, or NULL if the free list has no
+ * batches.
+ */
+PPH_FREE_LIST_ENTRY PhpRefillFreeListMagazine(
+    _Inout_ PPH_FREE_LIST FreeList,
+    _Inout_ PPHP_FREE_LIST_MAGAZINE Magazine
+    )
+{
+    PSLIST_ENTRY listEntry;
+    PPH_FREE_LIST_ENTRY entry;
+
+    Magazine->Misses++;
+    PHLIB_INC_STATISTIC(BaseFreeListMagazineMisses);
+
+    listEntry = RtlInterlockedPopEntrySList(&FreeList->MagazineListHead);
+
+    if (!listEntry)
+        return NULL;
+
+    _InterlockedExchangeAdd((PLONG)&FreeList->Count, -PH_FREE_LIST_MAGAZINE_SIZE);
+    PHLIB_INC_STATISTIC(BaseFreeListMagazineRefills);
+
+    // The rest of the batch hangs off the body of the first block.
+    entry = CONTAINING_RECORD(listEntry, PH_FREE_LIST_ENTRY, ListEntry);
+    Magazine->Head = *(PPH_FREE_LIST_ENTRY *)&entry->Body;
+    Magazine->Count = PH_FREE_LIST_MAGAZINE_SIZE - 1;
+
+    // Publish the counters while we're already paying for an interlocked operation.
+    _InterlockedExchangeAdd((PLONG)&FreeList->MagazineHits, Magazine->Hits);
+    _InterlockedExchangeAdd((PLONG)&FreeList->MagazineMisses, Magazine->Misses);
+    Magazine->Hits = 0;
+    Magazine->Misses = 0;
+
+    return entry;
+}
+
+/**
+ * Moves a batch of blocks from a full magazine to a free list.
+ */
+VOID PhpFlushFreeListMagazine(
+    _Inout_ PPH_FREE_LIST FreeList,
+    _Inout_ PPHP_FREE_LIST_MAGAZINE Magazine
+    )
+{
+    PPH_FREE_LIST_ENTRY first;
+    PPH_FREE_LIST_ENTRY last;
+    ULONG i;
+
+    first = Magazine->Head;
+    last = first;
+
+    for (i = 1; i < PH_FREE_LIST_MAGAZINE_SIZE; i++)
+        last = (PPH_FREE_LIST_ENTRY)last->ListEntry.Next;
+
+    Magazine->Head = (PPH_FREE_LIST_ENTRY)last->ListEntry.Next;
+    Magazine->Count -= PH_FREE_LIST_MAGAZINE_SIZE;
+    last->ListEntry.Next = NULL;
+
+    if (FreeList->Count + PH_FREE_LIST_MAGAZINE_SIZE <= FreeList->MaximumCount)
+    {
+        *(PPH_FREE_LIST_ENTRY *)&first->Body = (PPH_FREE_LIST_ENTRY)first->ListEntry.Next;
+        RtlInterlockedPushEntrySList(&FreeList->MagazineListHead, &first->ListEntry);
+        _InterlockedExchangeAdd((PLONG)&FreeList->Count, PH_FREE_LIST_MAGAZINE_SIZE);
+        PHLIB_INC_STATISTIC(BaseFreeListMagazineFlushes);
+    }
+    else
+    {
+        while (first)
+        {
+            last = (PPH_FREE_LIST_ENTRY)first->ListEntry.Next;
+            PhFree(first);
+            first = last;
+        }
+    }
+}
+
 /**
  * Allocates a block of memory from a free list.
  *
@@ -5074,6 +6786,28 @@ PVOID PhAllocateFromFreeList(
     PPH_FREE_LIST_ENTRY entry;
     PSLIST_ENTRY listEntry;
 
+    if (FreeList->Flags & PH_FREE_LIST_USE_MAGAZINES)
+    {
+        PPHP_FREE_LIST_MAGAZINE magazine;
+
+        if (magazine = PhpGetFreeListMagazine(FreeList))
+        {
+            if (magazine->Count != 0)
+            {
+                entry = magazine->Head;
+                magazine->Head = (PPH_FREE_LIST_ENTRY)entry->ListEntry.Next;
+                magazine->Count--;
+                magazine->Hits++;
+                PHLIB_INC_STATISTIC(BaseFreeListMagazineHits);
+
+                return &entry->Body;
+            }
+
+            if (entry = PhpRefillFreeListMagazine(FreeList, magazine))
+                return &entry->Body;
+        }
+    }
+
     listEntry = RtlInterlockedPopEntrySList(&FreeList->ListHead);
 
     if (listEntry)
@@ -5104,6 +6838,25 @@ VOID PhFreeToFreeList(
 
     entry = CONTAINING_RECORD(Memory, PH_FREE_LIST_ENTRY, Body);
 
+    if (FreeList->Flags & PH_FREE_LIST_USE_MAGAZINES)
+    {
+        PPHP_FREE_LIST_MAGAZINE magazine;
+
+        if (magazine = PhpGetFreeListMagazine(FreeList))
+        {
+            entry->ListEntry.Next = (PSLIST_ENTRY)magazine->Head;
+            magazine->Head = entry;
+            magazine->Count++;
+
+            // Keep up to two batches so that alternating allocations and
+            // frees don't flush and refill the same batch repeatedly.
+            if (magazine->Count == PH_FREE_LIST_MAGAZINE_SIZE * 2)
+                PhpFlushFreeListMagazine(FreeList, magazine);
+
+            return;
+        }
+    }
+
     // We don't enforce Count <= MaximumCount (that would require locking),
     // but we do check it.
     if (FreeList->Count < FreeList->MaximumCount)
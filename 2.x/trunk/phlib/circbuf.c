@@ -2,21 +2,30 @@
 #include <circbuf.h>
 
 #undef T
+#undef T_SUM
 #define T ULONG
+#define T_SUM ULONG64
 #include "circbuf_i.h"
 
 #undef T
+#undef T_SUM
 #define T ULONG64
+#define T_SUM ULONG64
 #include "circbuf_i.h"
 
 #undef T
+#undef T_SUM
 #define T PVOID
 #include "circbuf_i.h"
 
 #undef T
+#undef T_SUM
 #define T SIZE_T
+#define T_SUM ULONG64
 #include "circbuf_i.h"
 
 #undef T
+#undef T_SUM
 #define T FLOAT
+#define T_SUM DOUBLE
 #include "circbuf_i.h"
@@ -97,10 +97,8 @@ VOID T___(PhCopyCircularBuffer, T)(
     )
 {
     ULONG tailSize;
-    ULONG headSize;
 
     tailSize = (ULONG)(Buffer->Size - Buffer->Index);
-    headSize = Buffer->Count - tailSize;
 
     if (Count > Buffer->Count)
         Count = Buffer->Count;
@@ -118,4 +116,370 @@ VOID T___(PhCopyCircularBuffer, T)(
     }
 }
 
+/**
+ * Copies a range of items from a circular buffer.
+ *
+ * \param Buffer A circular buffer.
+ * \param Index The index of the first item to copy, where 0 is the
+ * most recently added item.
+ * \param Destination A buffer which receives the items, in the same
+ * order as they would be returned by PhGetItemCircularBuffer.
+ * \param Count The maximum number of items to copy.
+ *
+ * \return The number of items copied.
+ */
+ULONG T___(PhCopyCircularBufferEx, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _In_ ULONG Index,
+    _Out_writes_to_(Count, return) T *Destination,
+    _In_ ULONG Count
+    )
+{
+    ULONG start;
+    ULONG tailSize;
+
+    if (Index >= Buffer->Count)
+        return 0;
+    if (Count > Buffer->Count - Index)
+        Count = Buffer->Count - Index;
+
+#ifdef PH_CIRCULAR_BUFFER_POWER_OF_TWO_SIZE
+    start = (Buffer->Index + Index) & Buffer->SizeMinusOne;
+#else
+    start = (Buffer->Index + Index) % Buffer->Size;
+#endif
+    tailSize = Buffer->Size - start;
+
+    if (tailSize >= Count)
+    {
+        memcpy(Destination, &Buffer->Data[start], sizeof(T) * Count);
+    }
+    else
+    {
+        // The range wraps around, so copy the tail and then part of the head.
+        memcpy(Destination, &Buffer->Data[start], sizeof(T) * tailSize);
+        memcpy(&Destination[tailSize], Buffer->Data, sizeof(T) * (Count - tailSize));
+    }
+
+    return Count;
+}
+
+#ifdef T_SUM
+
+/**
+ * Copies a range of items from a circular buffer and converts them
+ * to floating-point values for drawing.
+ *
+ * \param Buffer A circular buffer.
+ * \param Index The index of the first item to copy, where 0 is the
+ * most recently added item.
+ * \param Destination A buffer which receives the values.
+ * \param Count The maximum number of items to copy.
+ *
+ * \return The number of items copied.
+ */
+ULONG T___(PhCopyCircularBufferAsSingles, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _In_ ULONG Index,
+    _Out_writes_to_(Count, return) FLOAT *Destination,
+    _In_ ULONG Count
+    )
+{
+    ULONG start;
+    ULONG tailSize;
+    T *data;
+    ULONG i;
+
+    if (Index >= Buffer->Count)
+        return 0;
+    if (Count > Buffer->Count - Index)
+        Count = Buffer->Count - Index;
+
+#ifdef PH_CIRCULAR_BUFFER_POWER_OF_TWO_SIZE
+    start = (Buffer->Index + Index) & Buffer->SizeMinusOne;
+#else
+    start = (Buffer->Index + Index) % Buffer->Size;
+#endif
+    tailSize = Buffer->Size - start;
+
+    if (tailSize > Count)
+        tailSize = Count;
+
+    data = &Buffer->Data[start];
+
+    for (i = 0; i < tailSize; i++)
+        Destination[i] = (FLOAT)data[i];
+
+    // Continue from the start of the buffer if the range wraps around.
+    data = Buffer->Data;
+    Destination += tailSize;
+    Count -= tailSize;
+
+    for (i = 0; i < Count; i++)
+        Destination[i] = (FLOAT)data[i];
+
+    return tailSize + Count;
+}
+
+/**
+ * Initializes running statistics for a circular buffer.
+ *
+ * \param Statistics The statistics structure.
+ * \param WindowSize The number of recent items to consider. When the
+ * statistics are updated using PhAddItemCircularBufferEx, this must not
+ * be larger than the size of the circular buffer.
+ * \param Flags A combination of flags.
+ * \li \c PH_CIRCULAR_BUFFER_STATISTICS_SUM Keep track of the sum and
+ * mean of the items.
+ * \li \c PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM Keep track of the
+ * minimum item.
+ * \li \c PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM Keep track of the
+ * maximum item.
+ */
+VOID T___(PhInitializeCircularBufferStatistics, T)(
+    _Out_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG WindowSize,
+    _In_ ULONG Flags
+    )
+{
+    ULONG queueSize;
+
+    if (WindowSize == 0)
+        WindowSize = 1;
+
+    // At most WindowSize items can be in a queue at once.
+    queueSize = PhRoundUpToPowerOfTwo(WindowSize);
+
+    Statistics->Flags = Flags;
+    Statistics->WindowSize = WindowSize;
+    Statistics->Count = 0;
+    Statistics->Sequence = 0;
+    Statistics->Sum = 0;
+    Statistics->QueueSizeMinusOne = queueSize - 1;
+
+    memset(&Statistics->MinimumQueue, 0, sizeof(Statistics->MinimumQueue));
+    memset(&Statistics->MaximumQueue, 0, sizeof(Statistics->MaximumQueue));
+
+    if (Flags & PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM)
+        Statistics->MinimumQueue.Entries = PhAllocate(sizeof(T___(PH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T)) * queueSize);
+    if (Flags & PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM)
+        Statistics->MaximumQueue.Entries = PhAllocate(sizeof(T___(PH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T)) * queueSize);
+}
+
+VOID T___(PhDeleteCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    )
+{
+    if (Statistics->MinimumQueue.Entries)
+        PhFree(Statistics->MinimumQueue.Entries);
+    if (Statistics->MaximumQueue.Entries)
+        PhFree(Statistics->MaximumQueue.Entries);
+}
+
+/**
+ * Resets running statistics. This must be called whenever the
+ * associated circular buffer is cleared.
+ *
+ * \param Statistics The statistics structure.
+ */
+VOID T___(PhClearCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    )
+{
+    Statistics->Count = 0;
+    Statistics->Sum = 0;
+    Statistics->MinimumQueue.Head = 0;
+    Statistics->MinimumQueue.Count = 0;
+    Statistics->MaximumQueue.Head = 0;
+    Statistics->MaximumQueue.Count = 0;
+}
+
+static VOID T___(PhpPushCircularBufferStatisticsQueue, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T) Queue,
+    _In_ T Value,
+    _In_ BOOLEAN Maximum
+    )
+{
+    ULONG sizeMinusOne;
+    ULONG sequence;
+    T___(PPH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T) entry;
+
+    sizeMinusOne = Statistics->QueueSizeMinusOne;
+    sequence = Statistics->Sequence;
+
+    // Remove entries which have left the window.
+    while (Queue->Count != 0)
+    {
+        entry = &Queue->Entries[Queue->Head];
+
+        if (sequence - entry->Sequence < Statistics->WindowSize)
+            break;
+
+        Queue->Head = (Queue->Head + 1) & sizeMinusOne;
+        Queue->Count--;
+    }
+
+    // Remove entries which can never be the result again because the new item is newer
+    // and at least as small (or large). The values in the queue are therefore strictly
+    // increasing (or decreasing) from the newest entry to the oldest.
+    while (Queue->Count != 0)
+    {
+        entry = &Queue->Entries[(Queue->Head + Queue->Count - 1) & sizeMinusOne];
+
+        if (Maximum ? entry->Value > Value : entry->Value < Value)
+            break;
+
+        Queue->Count--;
+    }
+
+    entry = &Queue->Entries[(Queue->Head + Queue->Count) & sizeMinusOne];
+    entry->Sequence = sequence;
+    entry->Value = Value;
+    Queue->Count++;
+}
+
+/**
+ * Updates the minimum and maximum of running statistics with a new
+ * item, for values which are not stored in a circular buffer.
+ *
+ * \param Statistics The statistics structure.
+ * \param Value The new item.
+ *
+ * \remarks The sum is not updated because the item which leaves the
+ * window is unknown. Use PhAddItemCircularBufferEx to keep track of
+ * the sum.
+ */
+VOID T___(PhUpdateCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ T Value
+    )
+{
+    if (Statistics->MinimumQueue.Entries)
+        T___(PhpPushCircularBufferStatisticsQueue, T)(Statistics, &Statistics->MinimumQueue, Value, FALSE);
+    if (Statistics->MaximumQueue.Entries)
+        T___(PhpPushCircularBufferStatisticsQueue, T)(Statistics, &Statistics->MaximumQueue, Value, TRUE);
+
+    Statistics->Sequence++;
+
+    if (Statistics->Count < Statistics->WindowSize)
+        Statistics->Count++;
+}
+
+/**
+ * Adds an item to a circular buffer and updates running statistics.
+ *
+ * \param Buffer A circular buffer.
+ * \param Statistics The statistics structure for \a Buffer.
+ * \param Value The new item.
+ */
+VOID T___(PhAddItemCircularBufferEx, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ T Value
+    )
+{
+    ULONG i;
+
+    if (Statistics->Flags & PH_CIRCULAR_BUFFER_STATISTICS_SUM)
+    {
+        if (Statistics->Count == Statistics->WindowSize)
+            Statistics->Sum -= T___(PhGetItemCircularBuffer, T)(Buffer, Statistics->WindowSize - 1);
+
+        Statistics->Sum += Value;
+    }
+
+    T___(PhAddItemCircularBuffer, T)(Buffer, Value);
+    T___(PhUpdateCircularBufferStatistics, T)(Statistics, Value);
+
+    // Floating-point sums accumulate rounding errors, so recalculate the sum once
+    // every window. This keeps the cost amortized constant.
+    if ((T)0.5 != 0 && (Statistics->Flags & PH_CIRCULAR_BUFFER_STATISTICS_SUM) &&
+        Statistics->Sequence % Statistics->WindowSize == 0)
+    {
+        Statistics->Sum = 0;
+
+        for (i = 0; i < Statistics->Count; i++)
+            Statistics->Sum += T___(PhGetItemCircularBuffer, T)(Buffer, i);
+    }
+}
+
+static T T___(PhpQueryCircularBufferStatisticsQueue, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T) Queue,
+    _In_ ULONG Count
+    )
+{
+    ULONG sizeMinusOne;
+    ULONG newest;
+    ULONG low;
+    ULONG high;
+    ULONG middle;
+
+    if (Queue->Count == 0 || Count == 0)
+        return 0;
+
+    sizeMinusOne = Statistics->QueueSizeMinusOne;
+
+    // The queue is ordered from the oldest entry to the newest, so the result is the
+    // first entry which is inside the requested window. The newest entry is always the
+    // most recent item, so such an entry exists.
+    if (Count >= Statistics->WindowSize)
+        return Queue->Entries[Queue->Head].Value;
+
+    newest = Statistics->Sequence - 1;
+    low = 0;
+    high = Queue->Count - 1;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+
+        if (newest - Queue->Entries[(Queue->Head + middle) & sizeMinusOne].Sequence < Count)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    return Queue->Entries[(Queue->Head + low) & sizeMinusOne].Value;
+}
+
+/**
+ * Gets the minimum of the most recent items.
+ *
+ * \param Statistics The statistics structure. The structure must have
+ * been initialized with PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM.
+ * \param Count The number of recent items to consider. If this is
+ * larger than the window size, the whole window is considered.
+ *
+ * \return The minimum, or 0 if there are no items.
+ */
+T T___(PhGetMinimumCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG Count
+    )
+{
+    return T___(PhpQueryCircularBufferStatisticsQueue, T)(Statistics, &Statistics->MinimumQueue, Count);
+}
+
+/**
+ * Gets the maximum of the most recent items.
+ *
+ * \param Statistics The statistics structure. The structure must have
+ * been initialized with PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM.
+ * \param Count The number of recent items to consider. If this is
+ * larger than the window size, the whole window is considered.
+ *
+ * \return The maximum, or 0 if there are no items.
+ */
+T T___(PhGetMaximumCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG Count
+    )
+{
+    return T___(PhpQueryCircularBufferStatisticsQueue, T)(Statistics, &Statistics->MaximumQueue, Count);
+}
+
+#endif
+
 #endif
@@ -963,3 +963,1094 @@ VOID PhEnumAvlTree(
         break;
     }
 }
+
+typedef struct _PH_BTREE_NODE
+{
+    ULONG Count;
+    // There is one extra slot so that a node can overflow by one key
+    // before it is split.
+    ULONG64 Keys[PH_BTREE_MAXIMUM_KEYS + 1];
+    union
+    {
+        struct
+        {
+            PPH_BTREE_NODE Previous;
+            PPH_BTREE_NODE Next;
+            PVOID Values[PH_BTREE_MAXIMUM_KEYS + 1];
+        } Leaf;
+        PPH_BTREE_NODE Children[PH_BTREE_MAXIMUM_KEYS + 2];
+    } u;
+} PH_BTREE_NODE;
+
+/**
+ * Initializes a B-tree.
+ *
+ * \param Tree The tree.
+ */
+VOID PhInitializeBTree(
+    _Out_ PPH_BTREE Tree
+    )
+{
+    Tree->Root = NULL;
+    Tree->Count = 0;
+    Tree->Height = 0;
+}
+
+static PPH_BTREE_NODE PhpCreateBTreeNode(
+    VOID
+    )
+{
+    PPH_BTREE_NODE node;
+
+    node = PhAllocate(sizeof(PH_BTREE_NODE));
+    node->Count = 0;
+
+    return node;
+}
+
+static VOID PhpFreeBTreeNode(
+    _In_ PPH_BTREE_NODE Node,
+    _In_ ULONG Level
+    )
+{
+    ULONG i;
+
+    if (Level != 0)
+    {
+        for (i = 0; i <= Node->Count; i++)
+            PhpFreeBTreeNode(Node->u.Children[i], Level - 1);
+    }
+
+    PhFree(Node);
+}
+
+/**
+ * Frees resources used by a B-tree.
+ *
+ * \param Tree The tree. The tree is empty and can be used again
+ * after this function returns.
+ */
+VOID PhDeleteBTree(
+    _Inout_ PPH_BTREE Tree
+    )
+{
+    if (Tree->Root)
+        PhpFreeBTreeNode(Tree->Root, Tree->Height - 1);
+
+    PhInitializeBTree(Tree);
+}
+
+/**
+ * Locates a key in a B-tree node.
+ *
+ * \param Node The node.
+ * \param Key The key to locate.
+ * \param Inclusive TRUE to count keys which are equal to \a Key,
+ * otherwise FALSE.
+ *
+ * \return The number of keys in the node which are less than
+ * \a Key, or less than or equal to \a Key if \a Inclusive is TRUE.
+ */
+FORCEINLINE ULONG PhpSearchBTreeNode(
+    _In_ PPH_BTREE_NODE Node,
+    _In_ ULONG64 Key,
+    _In_ BOOLEAN Inclusive
+    )
+{
+    ULONG count;
+    ULONG i;
+
+    // Count the matching keys instead of doing a binary search. The loads do not depend on
+    // each other, so the cache lines of the key array are fetched in parallel and there are
+    // no branches to mispredict. This is faster than a binary search for nodes of this size.
+
+    count = 0;
+
+    if (Inclusive)
+    {
+        for (i = 0; i < Node->Count; i++)
+            count += Node->Keys[i] <= Key;
+    }
+    else
+    {
+        for (i = 0; i < Node->Count; i++)
+            count += Node->Keys[i] < Key;
+    }
+
+    return count;
+}
+
+/**
+ * Locates the leaf of a B-tree which would contain a key.
+ *
+ * \param Tree The tree. The tree must not be empty.
+ * \param Key The key to locate.
+ */
+FORCEINLINE PPH_BTREE_NODE PhpFindLeafBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key
+    )
+{
+    PPH_BTREE_NODE node;
+    ULONG level;
+
+    node = Tree->Root;
+
+    for (level = Tree->Height - 1; level != 0; level--)
+        node = node->u.Children[PhpSearchBTreeNode(node, Key, TRUE)];
+
+    return node;
+}
+
+static BOOLEAN PhpInsertBTreeNode(
+    _Inout_ PPH_BTREE_NODE Node,
+    _In_ ULONG Level,
+    _In_ ULONG64 Key,
+    _In_opt_ PVOID Value,
+    _Out_opt_ PVOID *ExistingValue,
+    _Out_ PPH_BTREE_NODE *SplitNode,
+    _Out_ PULONG64 SplitKey
+    )
+{
+    PPH_BTREE_NODE right;
+    PPH_BTREE_NODE childSplitNode;
+    ULONG64 childSplitKey;
+    ULONG index;
+    ULONG middle;
+
+    *SplitNode = NULL;
+
+    if (Level == 0)
+    {
+        index = PhpSearchBTreeNode(Node, Key, FALSE);
+
+        if (index < Node->Count && Node->Keys[index] == Key)
+        {
+            if (ExistingValue)
+                *ExistingValue = Node->u.Leaf.Values[index];
+
+            return FALSE;
+        }
+
+        memmove(&Node->Keys[index + 1], &Node->Keys[index], (Node->Count - index) * sizeof(ULONG64));
+        memmove(&Node->u.Leaf.Values[index + 1], &Node->u.Leaf.Values[index], (Node->Count - index) * sizeof(PVOID));
+        Node->Keys[index] = Key;
+        Node->u.Leaf.Values[index] = Value;
+        Node->Count++;
+
+        if (Node->Count > PH_BTREE_MAXIMUM_KEYS)
+        {
+            // Move the upper half of the keys into a new leaf.
+
+            middle = Node->Count / 2;
+            right = PhpCreateBTreeNode();
+            right->Count = Node->Count - middle;
+            memcpy(right->Keys, &Node->Keys[middle], right->Count * sizeof(ULONG64));
+            memcpy(right->u.Leaf.Values, &Node->u.Leaf.Values[middle], right->Count * sizeof(PVOID));
+            Node->Count = middle;
+
+            right->u.Leaf.Previous = Node;
+            right->u.Leaf.Next = Node->u.Leaf.Next;
+
+            if (Node->u.Leaf.Next)
+                Node->u.Leaf.Next->u.Leaf.Previous = right;
+
+            Node->u.Leaf.Next = right;
+
+            *SplitNode = right;
+            *SplitKey = right->Keys[0];
+        }
+
+        return TRUE;
+    }
+
+    index = PhpSearchBTreeNode(Node, Key, TRUE);
+
+    if (!PhpInsertBTreeNode(Node->u.Children[index], Level - 1, Key, Value, ExistingValue, &childSplitNode, &childSplitKey))
+        return FALSE;
+
+    if (childSplitNode)
+    {
+        memmove(&Node->Keys[index + 1], &Node->Keys[index], (Node->Count - index) * sizeof(ULONG64));
+        memmove(&Node->u.Children[index + 2], &Node->u.Children[index + 1], (Node->Count - index) * sizeof(PPH_BTREE_NODE));
+        Node->Keys[index] = childSplitKey;
+        Node->u.Children[index + 1] = childSplitNode;
+        Node->Count++;
+
+        if (Node->Count > PH_BTREE_MAXIMUM_KEYS)
+        {
+            // The middle key moves up to the parent, and the keys and children after it move
+            // into a new node.
+
+            middle = Node->Count / 2;
+            right = PhpCreateBTreeNode();
+            right->Count = Node->Count - middle - 1;
+            memcpy(right->Keys, &Node->Keys[middle + 1], right->Count * sizeof(ULONG64));
+            memcpy(right->u.Children, &Node->u.Children[middle + 1], (right->Count + 1) * sizeof(PPH_BTREE_NODE));
+            Node->Count = middle;
+
+            *SplitNode = right;
+            *SplitKey = Node->Keys[middle];
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * Adds an element to a B-tree.
+ *
+ * \param Tree The tree.
+ * \param Key The key of the element.
+ * \param Value The value of the element.
+ * \param ExistingValue A variable which receives the value of the
+ * existing element if the key is already present in the tree.
+ *
+ * \return TRUE if the element was added, or FALSE if an element
+ * with the same key already exists.
+ */
+BOOLEAN PhAddElementBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _In_opt_ PVOID Value,
+    _Out_opt_ PVOID *ExistingValue
+    )
+{
+    PPH_BTREE_NODE splitNode;
+    ULONG64 splitKey;
+    PPH_BTREE_NODE root;
+
+    if (!Tree->Root)
+    {
+        Tree->Root = PhpCreateBTreeNode();
+        Tree->Root->u.Leaf.Previous = NULL;
+        Tree->Root->u.Leaf.Next = NULL;
+        Tree->Height = 1;
+    }
+
+    if (!PhpInsertBTreeNode(Tree->Root, Tree->Height - 1, Key, Value, ExistingValue, &splitNode, &splitKey))
+        return FALSE;
+
+    if (splitNode)
+    {
+        // The root was split, so the tree grows by one level.
+
+        root = PhpCreateBTreeNode();
+        root->Count = 1;
+        root->Keys[0] = splitKey;
+        root->u.Children[0] = Tree->Root;
+        root->u.Children[1] = splitNode;
+        Tree->Root = root;
+        Tree->Height++;
+    }
+
+    Tree->Count++;
+
+    return TRUE;
+}
+
+/**
+ * Merges two adjacent children of a B-tree node.
+ *
+ * \param Node The parent node.
+ * \param Level The level of the parent node.
+ * \param Index The index of the left child. The right child is
+ * merged into it and freed.
+ */
+static VOID PhpMergeBTreeNodes(
+    _Inout_ PPH_BTREE_NODE Node,
+    _In_ ULONG Level,
+    _In_ ULONG Index
+    )
+{
+    PPH_BTREE_NODE left;
+    PPH_BTREE_NODE right;
+
+    left = Node->u.Children[Index];
+    right = Node->u.Children[Index + 1];
+
+    if (Level == 1)
+    {
+        memcpy(&left->Keys[left->Count], right->Keys, right->Count * sizeof(ULONG64));
+        memcpy(&left->u.Leaf.Values[left->Count], right->u.Leaf.Values, right->Count * sizeof(PVOID));
+        left->Count += right->Count;
+
+        left->u.Leaf.Next = right->u.Leaf.Next;
+
+        if (right->u.Leaf.Next)
+            right->u.Leaf.Next->u.Leaf.Previous = left;
+    }
+    else
+    {
+        // The separator moves down from the parent.
+        left->Keys[left->Count] = Node->Keys[Index];
+        memcpy(&left->Keys[left->Count + 1], right->Keys, right->Count * sizeof(ULONG64));
+        memcpy(&left->u.Children[left->Count + 1], right->u.Children, (right->Count + 1) * sizeof(PPH_BTREE_NODE));
+        left->Count += right->Count + 1;
+    }
+
+    memmove(&Node->Keys[Index], &Node->Keys[Index + 1], (Node->Count - Index - 1) * sizeof(ULONG64));
+    memmove(&Node->u.Children[Index + 1], &Node->u.Children[Index + 2], (Node->Count - Index - 1) * sizeof(PPH_BTREE_NODE));
+    Node->Count--;
+
+    PhFree(right);
+}
+
+/**
+ * Restores the minimum number of keys in a child of a B-tree node.
+ *
+ * \param Node The parent node.
+ * \param Level The level of the parent node.
+ * \param Index The index of the child which has too few keys.
+ */
+static VOID PhpRebalanceBTreeNode(
+    _Inout_ PPH_BTREE_NODE Node,
+    _In_ ULONG Level,
+    _In_ ULONG Index
+    )
+{
+    PPH_BTREE_NODE child;
+    PPH_BTREE_NODE sibling;
+
+    child = Node->u.Children[Index];
+
+    if (Index != 0 && Node->u.Children[Index - 1]->Count > PH_BTREE_MINIMUM_KEYS)
+    {
+        // Borrow the last key from the left sibling.
+
+        sibling = Node->u.Children[Index - 1];
+        memmove(&child->Keys[1], child->Keys, child->Count * sizeof(ULONG64));
+
+        if (Level == 1)
+        {
+            memmove(&child->u.Leaf.Values[1], child->u.Leaf.Values, child->Count * sizeof(PVOID));
+            child->Keys[0] = sibling->Keys[sibling->Count - 1];
+            child->u.Leaf.Values[0] = sibling->u.Leaf.Values[sibling->Count - 1];
+            Node->Keys[Index - 1] = child->Keys[0];
+        }
+        else
+        {
+            memmove(&child->u.Children[1], child->u.Children, (child->Count + 1) * sizeof(PPH_BTREE_NODE));
+            child->Keys[0] = Node->Keys[Index - 1];
+            child->u.Children[0] = sibling->u.Children[sibling->Count];
+            Node->Keys[Index - 1] = sibling->Keys[sibling->Count - 1];
+        }
+
+        child->Count++;
+        sibling->Count--;
+    }
+    else if (Index != Node->Count && Node->u.Children[Index + 1]->Count > PH_BTREE_MINIMUM_KEYS)
+    {
+        // Borrow the first key from the right sibling.
+
+        sibling = Node->u.Children[Index + 1];
+
+        if (Level == 1)
+        {
+            child->Keys[child->Count] = sibling->Keys[0];
+            child->u.Leaf.Values[child->Count] = sibling->u.Leaf.Values[0];
+            memmove(sibling->u.Leaf.Values, &sibling->u.Leaf.Values[1], (sibling->Count - 1) * sizeof(PVOID));
+            memmove(sibling->Keys, &sibling->Keys[1], (sibling->Count - 1) * sizeof(ULONG64));
+            Node->Keys[Index] = sibling->Keys[0];
+        }
+        else
+        {
+            child->Keys[child->Count] = Node->Keys[Index];
+            child->u.Children[child->Count + 1] = sibling->u.Children[0];
+            Node->Keys[Index] = sibling->Keys[0];
+            memmove(sibling->Keys, &sibling->Keys[1], (sibling->Count - 1) * sizeof(ULONG64));
+            memmove(sibling->u.Children, &sibling->u.Children[1], sibling->Count * sizeof(PPH_BTREE_NODE));
+        }
+
+        child->Count++;
+        sibling->Count--;
+    }
+    else if (Index != 0)
+    {
+        PhpMergeBTreeNodes(Node, Level, Index - 1);
+    }
+    else
+    {
+        PhpMergeBTreeNodes(Node, Level, Index);
+    }
+}
+
+static BOOLEAN PhpRemoveBTreeNode(
+    _Inout_ PPH_BTREE_NODE Node,
+    _In_ ULONG Level,
+    _In_ ULONG64 Key,
+    _Out_opt_ PVOID *Value
+    )
+{
+    ULONG index;
+
+    if (Level == 0)
+    {
+        index = PhpSearchBTreeNode(Node, Key, FALSE);
+
+        if (index == Node->Count || Node->Keys[index] != Key)
+            return FALSE;
+
+        if (Value)
+            *Value = Node->u.Leaf.Values[index];
+
+        memmove(&Node->Keys[index], &Node->Keys[index + 1], (Node->Count - index - 1) * sizeof(ULONG64));
+        memmove(&Node->u.Leaf.Values[index], &Node->u.Leaf.Values[index + 1], (Node->Count - index - 1) * sizeof(PVOID));
+        Node->Count--;
+
+        return TRUE;
+    }
+
+    // Separators are not updated when the first key of a leaf is removed. They remain valid
+    // because a separator only has to be greater than the keys on its left and less than or
+    // equal to the keys on its right.
+
+    index = PhpSearchBTreeNode(Node, Key, TRUE);
+
+    if (!PhpRemoveBTreeNode(Node->u.Children[index], Level - 1, Key, Value))
+        return FALSE;
+
+    if (Node->u.Children[index]->Count < PH_BTREE_MINIMUM_KEYS)
+        PhpRebalanceBTreeNode(Node, Level, index);
+
+    return TRUE;
+}
+
+/**
+ * Removes an element from a B-tree.
+ *
+ * \param Tree The tree.
+ * \param Key The key of the element to remove.
+ * \param Value A variable which receives the value of the removed
+ * element.
+ *
+ * \return TRUE if the element was removed, or FALSE if the key
+ * was not found.
+ */
+BOOLEAN PhRemoveElementBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PVOID *Value
+    )
+{
+    PPH_BTREE_NODE root;
+
+    if (!Tree->Root)
+        return FALSE;
+
+    if (!PhpRemoveBTreeNode(Tree->Root, Tree->Height - 1, Key, Value))
+        return FALSE;
+
+    Tree->Count--;
+
+    root = Tree->Root;
+
+    if (root->Count == 0)
+    {
+        // The tree shrinks by one level, or becomes empty.
+
+        if (Tree->Height > 1)
+            Tree->Root = root->u.Children[0];
+        else
+            Tree->Root = NULL;
+
+        Tree->Height--;
+        PhFree(root);
+    }
+
+    return TRUE;
+}
+
+/**
+ * Finds an element in a B-tree.
+ *
+ * \param Tree The tree.
+ * \param Key The key of the element to find.
+ * \param Value A variable which receives the value of the element.
+ *
+ * \return TRUE if the element was found, otherwise FALSE.
+ */
+BOOLEAN PhFindElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PVOID *Value
+    )
+{
+    PPH_BTREE_NODE leaf;
+    ULONG index;
+
+    if (!Tree->Root)
+        return FALSE;
+
+    leaf = PhpFindLeafBTree(Tree, Key);
+    index = PhpSearchBTreeNode(leaf, Key, FALSE);
+
+    if (index == leaf->Count || leaf->Keys[index] != Key)
+        return FALSE;
+
+    if (Value)
+        *Value = leaf->u.Leaf.Values[index];
+
+    return TRUE;
+}
+
+/**
+ * Finds the element in a B-tree with the largest key that is less
+ * than or equal to a given key.
+ *
+ * \param Tree The tree.
+ * \param Key The key.
+ * \param FoundKey A variable which receives the key of the element.
+ * \param Value A variable which receives the value of the element.
+ *
+ * \return TRUE if an element was found, otherwise FALSE.
+ */
+BOOLEAN PhFloorElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PULONG64 FoundKey,
+    _Out_opt_ PVOID *Value
+    )
+{
+    PPH_BTREE_NODE leaf;
+    ULONG index;
+
+    if (!Tree->Root)
+        return FALSE;
+
+    leaf = PhpFindLeafBTree(Tree, Key);
+    index = PhpSearchBTreeNode(leaf, Key, TRUE);
+
+    if (index == 0)
+    {
+        // Every key in the previous leaf is less than the separator which led us here,
+        // so its last key is the answer.
+
+        leaf = leaf->u.Leaf.Previous;
+
+        if (!leaf)
+            return FALSE;
+
+        index = leaf->Count;
+    }
+
+    if (FoundKey)
+        *FoundKey = leaf->Keys[index - 1];
+    if (Value)
+        *Value = leaf->u.Leaf.Values[index - 1];
+
+    return TRUE;
+}
+
+/**
+ * Finds the element in a B-tree with the smallest key that is
+ * greater than or equal to a given key.
+ *
+ * \param Tree The tree.
+ * \param Key The key.
+ * \param FoundKey A variable which receives the key of the element.
+ * \param Value A variable which receives the value of the element.
+ *
+ * \return TRUE if an element was found, otherwise FALSE.
+ */
+BOOLEAN PhCeilingElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PULONG64 FoundKey,
+    _Out_opt_ PVOID *Value
+    )
+{
+    PPH_BTREE_NODE leaf;
+    ULONG index;
+
+    if (!Tree->Root)
+        return FALSE;
+
+    leaf = PhpFindLeafBTree(Tree, Key);
+    index = PhpSearchBTreeNode(leaf, Key, FALSE);
+
+    if (index == leaf->Count)
+    {
+        leaf = leaf->u.Leaf.Next;
+
+        if (!leaf)
+            return FALSE;
+
+        index = 0;
+    }
+
+    if (FoundKey)
+        *FoundKey = leaf->Keys[index];
+    if (Value)
+        *Value = leaf->u.Leaf.Values[index];
+
+    return TRUE;
+}
+
+/**
+ * Replaces the contents of a B-tree with elements from sorted
+ * arrays.
+ *
+ * \param Tree The tree.
+ * \param Keys An array of keys in strictly ascending order.
+ * \param Values An array of values corresponding to \a Keys. If
+ * NULL, all values are set to NULL.
+ * \param Count The number of elements.
+ *
+ * \return TRUE if the tree was built, or FALSE if the keys are not
+ * in strictly ascending order. In that case the tree is not modified.
+ *
+ * \remarks This is much faster than adding the elements one by one
+ * because no node is ever searched or split. The nodes are filled
+ * completely, which suits trees that are rarely modified after they
+ * are built.
+ */
+BOOLEAN PhBuildBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_reads_(Count) PULONG64 Keys,
+    _In_reads_opt_(Count) PVOID *Values,
+    _In_ ULONG Count
+    )
+{
+    PPH_BTREE_NODE *nodes;
+    PULONG64 lowKeys;
+    PPH_BTREE_NODE node;
+    PPH_BTREE_NODE previousNode;
+    ULONG numberOfNodes;
+    ULONG numberOfParents;
+    ULONG numberOfChildren;
+    ULONG height;
+    ULONG index;
+    ULONG i;
+    ULONG j;
+
+    for (i = 1; i < Count; i++)
+    {
+        if (Keys[i] <= Keys[i - 1])
+            return FALSE;
+    }
+
+    PhDeleteBTree(Tree);
+
+    if (Count == 0)
+        return TRUE;
+
+    // Spread the keys evenly over as few leaves as possible. When there is more than one leaf,
+    // each leaf receives more than PH_BTREE_MAXIMUM_KEYS * (n - 1) / n keys, which is at least
+    // the minimum.
+
+    numberOfNodes = (Count + PH_BTREE_MAXIMUM_KEYS - 1) / PH_BTREE_MAXIMUM_KEYS;
+    nodes = PhAllocate(numberOfNodes * sizeof(PPH_BTREE_NODE));
+    lowKeys = PhAllocate(numberOfNodes * sizeof(ULONG64));
+    previousNode = NULL;
+    index = 0;
+
+    for (i = 0; i < numberOfNodes; i++)
+    {
+        node = PhpCreateBTreeNode();
+        node->Count = Count / numberOfNodes + (i < Count % numberOfNodes);
+        memcpy(node->Keys, &Keys[index], node->Count * sizeof(ULONG64));
+
+        if (Values)
+            memcpy(node->u.Leaf.Values, &Values[index], node->Count * sizeof(PVOID));
+        else
+            memset(node->u.Leaf.Values, 0, node->Count * sizeof(PVOID));
+
+        node->u.Leaf.Previous = previousNode;
+        node->u.Leaf.Next = NULL;
+
+        if (previousNode)
+            previousNode->u.Leaf.Next = node;
+
+        previousNode = node;
+        nodes[i] = node;
+        lowKeys[i] = Keys[index];
+        index += node->Count;
+    }
+
+    height = 1;
+
+    // Build each level of internal nodes from the level below it. The parents are written to
+    // the front of the same arrays, which is safe because each parent consumes at least one
+    // child before it is stored.
+
+    while (numberOfNodes > 1)
+    {
+        numberOfParents = (numberOfNodes + PH_BTREE_MAXIMUM_KEYS) / (PH_BTREE_MAXIMUM_KEYS + 1);
+        index = 0;
+
+        for (i = 0; i < numberOfParents; i++)
+        {
+            numberOfChildren = numberOfNodes / numberOfParents + (i < numberOfNodes % numberOfParents);
+
+            node = PhpCreateBTreeNode();
+            node->Count = numberOfChildren - 1;
+            node->u.Children[0] = nodes[index];
+
+            for (j = 1; j < numberOfChildren; j++)
+            {
+                node->Keys[j - 1] = lowKeys[index + j];
+                node->u.Children[j] = nodes[index + j];
+            }
+
+            lowKeys[i] = lowKeys[index];
+            nodes[i] = node;
+            index += numberOfChildren;
+        }
+
+        numberOfNodes = numberOfParents;
+        height++;
+    }
+
+    Tree->Root = nodes[0];
+    Tree->Count = Count;
+    Tree->Height = height;
+
+    PhFree(lowKeys);
+    PhFree(nodes);
+
+    return TRUE;
+}
+
+/**
+ * Begins enumerating a range of elements in a B-tree.
+ *
+ * \param Tree The tree.
+ * \param LowKey The smallest key to enumerate.
+ * \param HighKey The largest key to enumerate.
+ * \param Context A variable which receives the enumeration state,
+ * for use with PhNextEnumBTree().
+ *
+ * \remarks The tree must not be modified during the enumeration.
+ */
+VOID PhBeginEnumBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 LowKey,
+    _In_ ULONG64 HighKey,
+    _Out_ PPH_BTREE_ENUM_CONTEXT Context
+    )
+{
+    PPH_BTREE_NODE leaf;
+    ULONG index;
+
+    Context->Node = NULL;
+    Context->Index = 0;
+    Context->HighKey = HighKey;
+
+    if (!Tree->Root || LowKey > HighKey)
+        return;
+
+    leaf = PhpFindLeafBTree(Tree, LowKey);
+    index = PhpSearchBTreeNode(leaf, LowKey, FALSE);
+
+    if (index == leaf->Count)
+    {
+        leaf = leaf->u.Leaf.Next;
+        index = 0;
+    }
+
+    Context->Node = leaf;
+    Context->Index = index;
+}
+
+/**
+ * Gets the next element in a B-tree enumeration.
+ *
+ * \param Context The enumeration state.
+ * \param Key A variable which receives the key of the element.
+ * \param Value A variable which receives the value of the element.
+ *
+ * \return TRUE if an element was returned, or FALSE if there are
+ * no more elements in the range.
+ */
+BOOLEAN PhNextEnumBTree(
+    _Inout_ PPH_BTREE_ENUM_CONTEXT Context,
+    _Out_opt_ PULONG64 Key,
+    _Out_opt_ PVOID *Value
+    )
+{
+    PPH_BTREE_NODE leaf;
+    ULONG index;
+
+    leaf = Context->Node;
+
+    if (!leaf)
+        return FALSE;
+
+    index = Context->Index;
+
+    if (leaf->Keys[index] > Context->HighKey)
+    {
+        Context->Node = NULL;
+        return FALSE;
+    }
+
+    if (Key)
+        *Key = leaf->Keys[index];
+    if (Value)
+        *Value = leaf->u.Leaf.Values[index];
+
+    if (++index == leaf->Count)
+    {
+        Context->Node = leaf->u.Leaf.Next;
+        index = 0;
+    }
+
+    Context->Index = index;
+
+    return TRUE;
+}
+
+#define PH_SORT_KEYS_RADIX_THRESHOLD 64
+#define PH_SORT_KEYS_INSERTION_THRESHOLD 16
+
+typedef struct _PH_SORT_KEYS_CONTEXT
+{
+    PPH_SORT_KEY_COMPARE_FUNCTION CompareFunction;
+    PVOID Context;
+    ULONG64 Flip;
+} PH_SORT_KEYS_CONTEXT, *PPH_SORT_KEYS_CONTEXT;
+
+FORCEINLINE LONG PhpCompareSortKeys(
+    _In_ PPH_SORT_KEYS_CONTEXT Context,
+    _In_ PPH_SORT_KEY Key1,
+    _In_ PPH_SORT_KEY Key2
+    )
+{
+    if (Key1->Key != Key2->Key)
+        return (Key1->Key ^ Context->Flip) < (Key2->Key ^ Context->Flip) ? -1 : 1;
+
+    if (Context->CompareFunction)
+        return Context->CompareFunction(Context->Context, &Key1->Item, &Key2->Item);
+
+    return uint64cmp(Key1->TieKey ^ Context->Flip, Key2->TieKey ^ Context->Flip);
+}
+
+static VOID PhpInsertionSortKeys(
+    _In_ PPH_SORT_KEYS_CONTEXT Context,
+    _Inout_updates_(Count) PPH_SORT_KEY Keys,
+    _In_ ULONG Count
+    )
+{
+    PH_SORT_KEY key;
+    ULONG i;
+    ULONG j;
+
+    for (i = 1; i < Count; i++)
+    {
+        key = Keys[i];
+
+        for (j = i; j != 0 && PhpCompareSortKeys(Context, &Keys[j - 1], &key) > 0; j--)
+            Keys[j] = Keys[j - 1];
+
+        Keys[j] = key;
+    }
+}
+
+/**
+ * Sorts keys using a stable merge sort.
+ *
+ * \param Context The sort context.
+ * \param Keys The keys to sort.
+ * \param Buffer A buffer which can hold at least half of the keys.
+ * \param Count The number of keys.
+ */
+static VOID PhpMergeSortKeys(
+    _In_ PPH_SORT_KEYS_CONTEXT Context,
+    _Inout_updates_(Count) PPH_SORT_KEY Keys,
+    _Out_writes_(Count / 2) PPH_SORT_KEY Buffer,
+    _In_ ULONG Count
+    )
+{
+    ULONG half;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+
+    if (Count <= PH_SORT_KEYS_INSERTION_THRESHOLD)
+    {
+        PhpInsertionSortKeys(Context, Keys, Count);
+        return;
+    }
+
+    half = Count / 2;
+    PhpMergeSortKeys(Context, Keys, Buffer, half);
+    PhpMergeSortKeys(Context, Keys + half, Buffer, Count - half);
+
+    // The halves are often already in order, e.g. for runs of equal elements.
+    if (PhpCompareSortKeys(Context, &Keys[half - 1], &Keys[half]) <= 0)
+        return;
+
+    memcpy(Buffer, Keys, half * sizeof(PH_SORT_KEY));
+    i = 0;
+    j = half;
+    k = 0;
+
+    // Take from the left half on ties to keep the sort stable.
+    while (i < half && j < Count)
+    {
+        if (PhpCompareSortKeys(Context, &Keys[j], &Buffer[i]) < 0)
+            Keys[k++] = Keys[j++];
+        else
+            Keys[k++] = Buffer[i++];
+    }
+
+    while (i < half)
+        Keys[k++] = Buffer[i++];
+}
+
+/**
+ * Sorts keys using a least significant digit radix sort.
+ *
+ * \param Keys The keys to sort.
+ * \param Buffer A buffer which can hold all of the keys.
+ * \param Count The number of keys.
+ * \param Flip A mask which is applied to all keys before sorting.
+ * \param ByTieKey TRUE to sort by the tie keys, FALSE to sort by the
+ * primary keys.
+ *
+ * \return Either \a Keys or \a Buffer, whichever contains the sorted
+ * keys.
+ */
+static PPH_SORT_KEY PhpRadixSortKeys(
+    _Inout_updates_(Count) PPH_SORT_KEY Keys,
+    _Out_writes_(Count) PPH_SORT_KEY Buffer,
+    _In_ ULONG Count,
+    _In_ ULONG64 Flip,
+    _In_ BOOLEAN ByTieKey
+    )
+{
+    ULONG counts[8][256];
+    PPH_SORT_KEY source;
+    PPH_SORT_KEY destination;
+    PPH_SORT_KEY temp;
+    ULONG64 value;
+    ULONG offset;
+    ULONG pass;
+    ULONG i;
+    ULONG j;
+
+    // Build the histograms for all digits at once so that the keys are only read one
+    // extra time.
+
+    memset(counts, 0, sizeof(counts));
+
+    for (i = 0; i < Count; i++)
+    {
+        value = (ByTieKey ? Keys[i].TieKey : Keys[i].Key) ^ Flip;
+
+        for (j = 0; j < 8; j++)
+            counts[j][(UCHAR)(value >> (j * 8))]++;
+    }
+
+    source = Keys;
+    destination = Buffer;
+    value = (ByTieKey ? Keys[0].TieKey : Keys[0].Key) ^ Flip;
+
+    for (pass = 0; pass < 8; pass++)
+    {
+        // Skip the pass if every key has the same digit. This is common for the high
+        // bytes of small integers and pointers.
+        if (counts[pass][(UCHAR)(value >> (pass * 8))] == Count)
+            continue;
+
+        offset = 0;
+
+        for (j = 0; j < 256; j++)
+        {
+            i = counts[pass][j];
+            counts[pass][j] = offset;
+            offset += i;
+        }
+
+        for (i = 0; i < Count; i++)
+        {
+            j = (UCHAR)(((ByTieKey ? source[i].TieKey : source[i].Key) ^ Flip) >> (pass * 8));
+            destination[counts[pass][j]++] = source[i];
+        }
+
+        temp = source;
+        source = destination;
+        destination = temp;
+    }
+
+    return source;
+}
+
+/**
+ * Sorts an array of keys.
+ *
+ * \param Keys The keys to sort.
+ * \param Count The number of keys.
+ * \param SortOrder The sort order. Descending order reverses the order
+ * of both primary keys and tie keys.
+ * \param CompareFunction A function which orders elements with equal
+ * primary keys. If NULL, these elements are ordered by their tie keys.
+ * The compare function is responsible for applying the sort order
+ * itself.
+ * \param Context A user-defined value to pass to the compare function.
+ *
+ * \remarks The keys are sorted with a radix sort, so the cost is linear
+ * in the number of keys. Comparisons are only needed for runs of equal
+ * primary keys.
+ */
+VOID PhSortKeys(
+    _Inout_updates_(Count) PPH_SORT_KEY Keys,
+    _In_ ULONG Count,
+    _In_ PH_SORT_ORDER SortOrder,
+    _In_opt_ PPH_SORT_KEY_COMPARE_FUNCTION CompareFunction,
+    _In_opt_ PVOID Context
+    )
+{
+    PH_SORT_KEYS_CONTEXT context;
+    PH_SORT_KEY localBuffer[PH_SORT_KEYS_RADIX_THRESHOLD / 2];
+    PPH_SORT_KEY buffer;
+    PPH_SORT_KEY sorted;
+    ULONG i;
+    ULONG j;
+
+    context.CompareFunction = CompareFunction;
+    context.Context = Context;
+    context.Flip = SortOrder == DescendingSortOrder ? MAXULONG64 : 0;
+
+    if (Count < 2)
+        return;
+
+    if (Count < PH_SORT_KEYS_RADIX_THRESHOLD)
+    {
+        PhpMergeSortKeys(&context, Keys, localBuffer, Count);
+        return;
+    }
+
+    buffer = PhAllocate(Count * sizeof(PH_SORT_KEY));
+    sorted = PhpRadixSortKeys(Keys, buffer, Count, context.Flip, FALSE);
+
+    if (sorted != Keys)
+        memcpy(Keys, sorted, Count * sizeof(PH_SORT_KEY));
+
+    // Order each run of equal primary keys. Sorting the runs separately instead of
+    // sorting everything by the tie keys first avoids extra passes when the primary
+    // keys are mostly unique.
+    for (i = 0; i < Count; i = j)
+    {
+        for (j = i + 1; j < Count && Keys[j].Key == Keys[i].Key; j++)
+            NOTHING;
+
+        if (j - i < 2)
+            continue;
+
+        if (CompareFunction || j - i < PH_SORT_KEYS_RADIX_THRESHOLD)
+        {
+            PhpMergeSortKeys(&context, Keys + i, buffer, j - i);
+        }
+        else
+        {
+            sorted = PhpRadixSortKeys(Keys + i, buffer, j - i, context.Flip, TRUE);
+
+            if (sorted != Keys + i)
+                memcpy(Keys + i, sorted, (j - i) * sizeof(PH_SORT_KEY));
+        }
+    }
+
+    PhFree(buffer);
+}
@@ -30,6 +30,11 @@
  * PhFormat, which returns a string object containing the formatted string,
  * and PhFormatToBuffer, which writes the formatted string to a buffer. The
  * latter is a bit faster due to the lack of resizing logic.
+ *
+ * PhFormatToSlot is built on top of PhFormatToBuffer for text which is
+ * regenerated over and over again, such as tree list cells. It reuses the
+ * same storage every time and only allocates memory when the text no longer
+ * fits.
  */
 
 #include <phbase.h>
@@ -69,6 +74,332 @@ static WCHAR PhpFormatDecimalSeparator = '.';
 static WCHAR PhpFormatThousandSeparator = ',';
 static _locale_t PhpFormatUserLocale = NULL;
 
+// Two characters for each number from 0 to 99, used to convert integers two digits at a time.
+static CHAR PhpFormatDigitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static ULONG64 PhpFormatPowersOf5[] =
+{
+    1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL, 390625ULL,
+    1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL, 1220703125ULL,
+    6103515625ULL, 30517578125ULL, 152587890625ULL, 762939453125ULL,
+    3814697265625ULL, 19073486328125ULL, 95367431640625ULL, 476837158203125ULL,
+    2384185791015625ULL, 11920928955078125ULL, 59604644775390625ULL,
+    298023223876953125ULL, 1490116119384765625ULL, 7450580596923828125ULL
+};
+
+static ULONG64 PhpFormatPowersOf10[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+    10000000000000000ULL, 100000000000000000ULL
+};
+
+/** The number of significant digits the CRT generates before rounding to the precision. */
+#define PHP_FORMAT_DOUBLE_DIGITS 17
+
+FORCEINLINE VOID PhpMultiply64To128(
+    _In_ ULONG64 Multiplier,
+    _In_ ULONG64 Multiplicand,
+    _Out_ PULONG64 High,
+    _Out_ PULONG64 Low
+    )
+{
+#ifdef _WIN64
+    *Low = _umul128(Multiplier, Multiplicand, High);
+#else
+    ULONG64 lowLow;
+    ULONG64 lowHigh;
+    ULONG64 highLow;
+    ULONG64 highHigh;
+    ULONG64 middle;
+
+    lowLow = __emulu((ULONG)Multiplier, (ULONG)Multiplicand);
+    lowHigh = __emulu((ULONG)Multiplier, (ULONG)(Multiplicand >> 32));
+    highLow = __emulu((ULONG)(Multiplier >> 32), (ULONG)Multiplicand);
+    highHigh = __emulu((ULONG)(Multiplier >> 32), (ULONG)(Multiplicand >> 32));
+
+    middle = (lowLow >> 32) + (ULONG)lowHigh + (ULONG)highLow;
+    *Low = (middle << 32) | (ULONG)lowLow;
+    *High = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+#endif
+}
+
+/**
+ * Rounds a double to a number of significant digits.
+ *
+ * \param Mantissa The mantissa of the value, including the implicit bit.
+ * \param Exponent The binary exponent of the value, such that the value is
+ * \a Mantissa * 2^\a Exponent.
+ * \param Scale The power of 10 to multiply the value by, between 0 and 27.
+ * \param Digits A variable which receives the result.
+ *
+ * \return FALSE if the result does not fit in 64 bits, otherwise TRUE.
+ *
+ * \remarks The result is rounded half away from zero using exact integer
+ * arithmetic.
+ */
+static BOOLEAN PhpScaleDouble(
+    _In_ ULONG64 Mantissa,
+    _In_ LONG Exponent,
+    _In_ ULONG Scale,
+    _Out_ PULONG64 Digits
+    )
+{
+    ULONG64 high;
+    ULONG64 low;
+    LONG shift;
+    ULONG64 result;
+    BOOLEAN roundUp;
+
+    // value * 10^Scale = Mantissa * 5^Scale * 2^(Exponent + Scale)
+    PhpMultiply64To128(Mantissa, PhpFormatPowersOf5[Scale], &high, &low);
+    shift = Exponent + (LONG)Scale;
+
+    if (shift >= 0)
+    {
+        if (high != 0 || shift >= 64 || (low >> (63 - shift)) > 1)
+            return FALSE;
+
+        *Digits = low << shift;
+        return TRUE;
+    }
+
+    shift = -shift;
+
+    if (shift >= 128)
+    {
+        *Digits = 0;
+        return TRUE;
+    }
+
+    if (shift >= 64)
+    {
+        result = shift == 64 ? high : high >> (shift - 64);
+
+        if (shift == 64)
+            roundUp = (low >> 63) != 0;
+        else
+            roundUp = ((high >> (shift - 65)) & 1) != 0;
+    }
+    else
+    {
+        if (shift != 0 && (high >> shift) != 0)
+            return FALSE;
+
+        result = (low >> shift) | (shift != 0 ? high << (64 - shift) : 0);
+        roundUp = shift != 0 && ((low >> (shift - 1)) & 1) != 0;
+    }
+
+    // The bit below the result decides the rounding because ties round up.
+    *Digits = result + roundUp;
+
+    return TRUE;
+}
+
+/**
+ * Converts a double to fixed-point notation.
+ *
+ * \param Value The value to convert.
+ * \param Precision The number of digits after the decimal point.
+ * \param DecimalSeparator The decimal separator.
+ * \param CropZeros TRUE to remove trailing zeros after the decimal point,
+ * as well as the decimal point itself if no digits remain.
+ * \param Buffer A buffer which receives the string. The buffer must have
+ * space for at least \a Precision + 21 characters.
+ *
+ * \return The number of characters written, or 0 if the value cannot be
+ * converted by this function and the CRT should be used instead.
+ *
+ * \remarks The result is identical to the CRT's "%.*f" output. Like the
+ * CRT, the value is first rounded to 17 significant digits, and that digit
+ * string is then rounded half up to \a Precision decimal places. Infinity,
+ * NaN, denormals and values outside [1e-11, 1e17) are not handled.
+ */
+static ULONG PhpFormatDoubleFixed(
+    _In_ DOUBLE Value,
+    _In_ ULONG Precision,
+    _In_ CHAR DecimalSeparator,
+    _In_ BOOLEAN CropZeros,
+    _Out_ PSTR Buffer
+    )
+{
+    ULONG64 bits;
+    ULONG64 mantissa;
+    LONG exponent;
+    LONG decimalExponent;
+    ULONG64 digits;
+    LONG decimalPoint;
+    LONG numberOfDigits;
+    PSTR buffer;
+    CHAR digitBuffer[PHP_FORMAT_DOUBLE_DIGITS + 1];
+    ULONG i;
+
+    bits = *(PULONG64)&Value;
+    mantissa = bits & ((1ULL << 52) - 1);
+    exponent = (LONG)((bits >> 52) & 0x7ff);
+    buffer = Buffer;
+
+    if (bits >> 63)
+        *buffer++ = '-';
+
+    if (exponent == 0x7ff)
+        return 0;
+
+    if (exponent == 0)
+    {
+        if (mantissa != 0)
+            return 0;
+
+        digits = 0;
+        decimalPoint = 0;
+    }
+    else
+    {
+        mantissa |= 1ULL << 52;
+        exponent -= 1075;
+
+        // Estimate the decimal exponent from the position of the highest bit. This may be one
+        // less than the real exponent, which we detect below.
+        decimalExponent = ((exponent + 52) * 78913) >> 18;
+
+        if (decimalExponent < -11 || decimalExponent >= PHP_FORMAT_DOUBLE_DIGITS)
+            return 0;
+
+        if (!PhpScaleDouble(mantissa, exponent, PHP_FORMAT_DOUBLE_DIGITS - 1 - decimalExponent, &digits))
+            return 0;
+
+        if (digits >= PhpFormatPowersOf10[PHP_FORMAT_DOUBLE_DIGITS])
+        {
+            // The estimate was too low, or the value was rounded up to the next power of 10.
+            // Only the first case needs the value to be scaled again.
+
+            if (digits != PhpFormatPowersOf10[PHP_FORMAT_DOUBLE_DIGITS])
+            {
+                decimalExponent++;
+
+                if (decimalExponent >= PHP_FORMAT_DOUBLE_DIGITS)
+                    return 0;
+
+                if (!PhpScaleDouble(mantissa, exponent, PHP_FORMAT_DOUBLE_DIGITS - 1 - decimalExponent, &digits))
+                    return 0;
+            }
+
+            if (digits == PhpFormatPowersOf10[PHP_FORMAT_DOUBLE_DIGITS])
+            {
+                digits = PhpFormatPowersOf10[PHP_FORMAT_DOUBLE_DIGITS - 1];
+                decimalExponent++;
+            }
+        }
+
+        decimalPoint = decimalExponent + 1;
+    }
+
+    // Round the significant digits to the requested precision. As in the CRT, nothing
+    // is rounded when the first digit is beyond the precision.
+
+    numberOfDigits = (LONG)Precision + decimalPoint;
+
+    if (numberOfDigits < 0)
+    {
+        digits = 0;
+        numberOfDigits = 0;
+    }
+    else if (numberOfDigits < PHP_FORMAT_DOUBLE_DIGITS && digits != 0)
+    {
+        ULONG64 divisor;
+        ULONG64 remainder;
+
+        divisor = PhpFormatPowersOf10[PHP_FORMAT_DOUBLE_DIGITS - numberOfDigits];
+        remainder = digits % divisor;
+        digits /= divisor;
+
+        if (remainder >= divisor / 2)
+        {
+            digits++;
+
+            if (digits == PhpFormatPowersOf10[numberOfDigits])
+            {
+                // The carry propagated into a new leading digit.
+                decimalPoint++;
+                numberOfDigits++;
+            }
+        }
+    }
+
+    // Convert the digits to characters. Digits past the 17 significant digits are zero.
+
+    if (digits == 0)
+    {
+        memset(digitBuffer, '0', sizeof(digitBuffer));
+    }
+    else
+    {
+        i = numberOfDigits < PHP_FORMAT_DOUBLE_DIGITS ? numberOfDigits : PHP_FORMAT_DOUBLE_DIGITS;
+
+        while (i >= 2)
+        {
+            ULONG r = (ULONG)(digits % 100);
+
+            digits /= 100;
+            i -= 2;
+            digitBuffer[i] = PhpFormatDigitPairs[r * 2];
+            digitBuffer[i + 1] = PhpFormatDigitPairs[r * 2 + 1];
+        }
+
+        if (i != 0)
+            digitBuffer[0] = (CHAR)('0' + digits);
+    }
+
+#define PHP_DIGIT_AT(Index) ((Index) < PHP_FORMAT_DOUBLE_DIGITS ? digitBuffer[Index] : '0')
+
+    i = 0;
+
+    if (decimalPoint <= 0)
+    {
+        *buffer++ = '0';
+    }
+    else
+    {
+        for (; i < (ULONG)decimalPoint; i++)
+            *buffer++ = PHP_DIGIT_AT(i);
+    }
+
+    if (Precision != 0)
+    {
+        PSTR decimal;
+        ULONG count;
+
+        decimal = buffer;
+        *buffer++ = DecimalSeparator;
+        count = Precision;
+
+        for (; decimalPoint < 0 && count != 0; decimalPoint++, count--)
+            *buffer++ = '0';
+
+        for (; count != 0; i++, count--)
+            *buffer++ = PHP_DIGIT_AT(i);
+
+        if (CropZeros)
+        {
+            while (buffer[-1] == '0')
+                buffer--;
+
+            if (buffer - 1 == decimal)
+                buffer--;
+        }
+    }
+
+    *buffer = 0;
+
+    return (ULONG)(buffer - Buffer);
+}
+
 PPH_STRING PhpResizeFormatBuffer(
     _In_ PPH_STRING String,
     _Inout_ PSIZE_T AllocatedLength,
@@ -222,3 +553,76 @@ BOOLEAN PhFormatToBuffer(
 
     return OK_BUFFER;
 }
+
+/**
+ * Frees resources used by a format slot.
+ *
+ * \param Slot A format slot.
+ */
+VOID PhDeleteFormatSlot(
+    _Inout_ PPH_FORMAT_SLOT Slot
+    )
+{
+    if (Slot->Buffer)
+    {
+        PhFree(Slot->Buffer);
+        Slot->Buffer = NULL;
+        Slot->AllocatedLength = 0;
+    }
+}
+
+/**
+ * Writes a formatted string to a format slot.
+ *
+ * \param Slot A format slot.
+ * \param Format An array of format structures.
+ * \param Count The number of structures supplied in \a Format.
+ * \param String A variable which receives the formatted string. The
+ * string is null-terminated and remains valid until the next time
+ * the slot is used or the slot is deleted.
+ */
+VOID PhFormatToSlot(
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _In_reads_(Count) PPH_FORMAT Format,
+    _In_ ULONG Count,
+    _Out_ PPH_STRINGREF String
+    )
+{
+    PWSTR buffer;
+    SIZE_T bufferLength;
+    SIZE_T returnLength;
+
+    if (Slot->Buffer)
+    {
+        buffer = Slot->Buffer;
+        bufferLength = Slot->AllocatedLength;
+    }
+    else
+    {
+        buffer = Slot->InlineBuffer;
+        bufferLength = sizeof(Slot->InlineBuffer);
+    }
+
+    if (!PhFormatToBuffer(Format, Count, buffer, bufferLength, &returnLength))
+    {
+        // The text has outgrown the slot. Double the size so that text which keeps
+        // getting longer doesn't cause a reallocation every time.
+
+        bufferLength *= 2;
+
+        if (bufferLength < returnLength)
+            bufferLength = returnLength;
+
+        if (Slot->Buffer)
+            PhFree(Slot->Buffer);
+
+        buffer = PhAllocate(bufferLength);
+        Slot->Buffer = buffer;
+        Slot->AllocatedLength = bufferLength;
+
+        PhFormatToBuffer(Format, Count, buffer, bufferLength, &returnLength);
+    }
+
+    String->Buffer = buffer;
+    String->Length = returnLength - sizeof(WCHAR); // minus null terminator
+}
@@ -141,6 +141,31 @@
         tempCount++; \
     } while (0)
 
+#define PROCESS_DIGIT_PAIR(Input) \
+    do { \
+        r = (ULONG)(Input % 100); \
+        Input /= 100; \
+        *temp-- = PhpFormatDigitPairs[r * 2 + 1]; \
+        *temp-- = PhpFormatDigitPairs[r * 2]; \
+        tempCount += 2; \
+    } while (0)
+
+#define PROCESS_DECIMAL_REMAINDER(Input) \
+    do { \
+        r = (ULONG)Input; \
+        if (r >= 10) \
+        { \
+            *temp-- = PhpFormatDigitPairs[r * 2 + 1]; \
+            *temp-- = PhpFormatDigitPairs[r * 2]; \
+            tempCount += 2; \
+        } \
+        else \
+        { \
+            *temp-- = (WCHAR)('0' + r); \
+            tempCount++; \
+        } \
+    } while (0)
+
 #define COMMON_INTEGER_FORMAT(Input, Format) \
     do { \
         ULONG radix; \
@@ -149,7 +174,7 @@
         ULONG tempCount; \
         ULONG r; \
         ULONG preCount; \
-        ULONG padCount; \
+        ULONG padCount = 0; \
         \
         radix = 10; \
         if (((Format)->Type & FormatUseRadix) && (Format)->Radix >= 2 && (Format)->Radix <= 69) \
@@ -160,7 +185,46 @@
         temp = tempBuffer + BUFFER_SIZE - 1; \
         tempCount = 0; \
         \
-        if (Input != 0) \
+        if (Input != 0 && radix == 10) \
+        { \
+            /* Decimal numbers are converted two digits at a time, and when grouping, */ \
+            /* one group at a time. */ \
+            \
+            if ((Format)->Type & FormatGroupDigits) \
+            { \
+                while (Input >= 1000) \
+                { \
+                    ULONG group = (ULONG)(Input % 1000); \
+                    \
+                    Input /= 1000; \
+                    r = group % 100; \
+                    *temp-- = PhpFormatDigitPairs[r * 2 + 1]; \
+                    *temp-- = PhpFormatDigitPairs[r * 2]; \
+                    *temp-- = (WCHAR)('0' + group / 100); \
+                    *temp-- = PhpFormatThousandSeparator; \
+                    tempCount += 4; \
+                } \
+                \
+                if (Input >= 100) \
+                { \
+                    PROCESS_DIGIT_PAIR(Input); \
+                    *temp-- = (WCHAR)('0' + (ULONG)Input); \
+                    tempCount++; \
+                } \
+                else \
+                { \
+                    PROCESS_DECIMAL_REMAINDER(Input); \
+                } \
+            } \
+            else \
+            { \
+                while (Input >= 100) \
+                    PROCESS_DIGIT_PAIR(Input); \
+                \
+                PROCESS_DECIMAL_REMAINDER(Input); \
+            } \
+        } \
+        else if (Input != 0) \
         { \
             if ((Format)->Type & FormatGroupDigits) \
             { \
@@ -319,26 +383,45 @@ CommonInt64Format:
         if ((Format)->Type & FormatUpperCase) \
             c -= 32; /* uppercase the format type */ \
         \
-        /* Use MS CRT routines to do the work. */ \
-        \
         value = (Format)->u.Double; \
         temp = (PSTR)tempBuffer + 1; /* leave one character so we can insert a prefix if needed */ \
-        _cfltcvt_l( \
-            &value, \
-            temp, \
-            sizeof(tempBuffer) - 1, \
-            c, \
-            precision, \
-            !!((Format)->Type & FormatUpperCase), \
-            PhpFormatUserLocale \
-            ); \
+        length = 0; \
         \
-        /* if (((Format)->Type & FormatForceDecimalPoint) && precision == 0) */ \
-             /* _forcdecpt_l(tempBufferAnsi, PhpFormatUserLocale); */ \
-        if ((Format)->Type & FormatCropZeros) \
-            _cropzeros_l(temp, PhpFormatUserLocale); \
+        /* Fixed-point notation is converted by us, except for the cases the CRT */ \
+        /* needs to handle. */ \
         \
-        length = (ULONG)strlen(temp); \
+        if ((c | 32) == 'f' && PhpFormatDecimalSeparator < 0x80) \
+        { \
+            length = PhpFormatDoubleFixed( \
+                value, \
+                precision, \
+                (CHAR)PhpFormatDecimalSeparator, \
+                !!((Format)->Type & FormatCropZeros), \
+                temp \
+                ); \
+        } \
+        \
+        if (length == 0) \
+        { \
+            /* Use MS CRT routines to do the work. */ \
+            \
+            _cfltcvt_l( \
+                &value, \
+                temp, \
+                sizeof(tempBuffer) - 1, \
+                c, \
+                precision, \
+                !!((Format)->Type & FormatUpperCase), \
+                PhpFormatUserLocale \
+                ); \
+            \
+            /* if (((Format)->Type & FormatForceDecimalPoint) && precision == 0) */ \
+                 /* _forcdecpt_l(tempBufferAnsi, PhpFormatUserLocale); */ \
+            if ((Format)->Type & FormatCropZeros) \
+                _cropzeros_l(temp, PhpFormatUserLocale); \
+            \
+            length = (ULONG)strlen(temp); \
+        } \
         \
         if (temp[0] == '-') \
         { \
@@ -424,7 +507,7 @@ CommonInt64Format:
         else \
         { \
             SIZE_T preLength; \
-            SIZE_T padLength; \
+            SIZE_T padLength = 0; \
             \
             /* Take care of the sign and zero padding. */ \
             preLength = 0; \
@@ -24,6 +24,14 @@
 #include <kphuser.h>
 
 #define PH_QUERY_HACK_MAX_THREADS 20
+#define PH_OBJECT_TYPE_TABLE_REFRESH_INTERVAL 1000 // 1 second
+
+typedef struct _PHP_KNOWN_OBJECT_TYPE
+{
+    PH_STRINGREF Name;
+    ULONG Class;
+    ULONG Flags;
+} PHP_KNOWN_OBJECT_TYPE, *PPHP_KNOWN_OBJECT_TYPE;
 
 typedef struct _PHP_CALL_WITH_TIMEOUT_THREAD_CONTEXT
 {
@@ -106,7 +114,30 @@ NTSTATUS PhpCallWithTimeoutThreadStart(
     _In_ PVOID Parameter
     );
 
-static PPH_STRING PhObjectTypeNames[MAX_OBJECT_TYPE_NUMBER] = { 0 };
+static PHP_KNOWN_OBJECT_TYPE PhpKnownObjectTypes[] =
+{
+    { PH_STRINGREF_INIT(L"EtwRegistration"), PH_OBJECT_TYPE_CLASS_ETW_REGISTRATION, 0 },
+    { PH_STRINGREF_INIT(L"File"), PH_OBJECT_TYPE_CLASS_FILE, PH_OBJECT_TYPE_NAME_QUERY_MAY_HANG },
+    { PH_STRINGREF_INIT(L"Job"), PH_OBJECT_TYPE_CLASS_JOB, 0 },
+    { PH_STRINGREF_INIT(L"Key"), PH_OBJECT_TYPE_CLASS_KEY, 0 },
+    { PH_STRINGREF_INIT(L"Process"), PH_OBJECT_TYPE_CLASS_PROCESS, 0 },
+    { PH_STRINGREF_INIT(L"Section"), PH_OBJECT_TYPE_CLASS_SECTION, 0 },
+    { PH_STRINGREF_INIT(L"Thread"), PH_OBJECT_TYPE_CLASS_THREAD, 0 },
+    { PH_STRINGREF_INIT(L"TmEn"), PH_OBJECT_TYPE_CLASS_TM_EN, 0 },
+    { PH_STRINGREF_INIT(L"TmRm"), PH_OBJECT_TYPE_CLASS_TM_RM, 0 },
+    { PH_STRINGREF_INIT(L"TmTm"), PH_OBJECT_TYPE_CLASS_TM_TM, 0 },
+    { PH_STRINGREF_INIT(L"TmTx"), PH_OBJECT_TYPE_CLASS_TM_TX, 0 },
+    { PH_STRINGREF_INIT(L"Token"), PH_OBJECT_TYPE_CLASS_TOKEN, 0 }
+};
+
+// The object type table maps type indices to type names. It is filled from
+// ObjectTypesInformation on first use and again whenever an unknown index shows up,
+// so resolving the type of a handle doesn't need a system call. Entries are never
+// removed because type indices are not re-used.
+static PH_OBJECT_TYPE_ENTRY PhpObjectTypeTable[MAX_OBJECT_TYPE_NUMBER];
+static PH_READ_MOSTLY_LOCK PhpObjectTypeTableLock = PH_READ_MOSTLY_LOCK_INIT;
+static BOOLEAN PhpObjectTypeTableLoaded = FALSE;
+static ULONG64 PhpObjectTypeTableRefreshTime;
 static PPH_GET_CLIENT_ID_NAME PhHandleGetClientIdName = PhStdGetClientIdName;
 
 static SLIST_HEADER PhpCallWithTimeoutThreadListHead;
@@ -172,113 +203,247 @@ NTSTATUS PhpGetObjectBasicInformation(
     return status;
 }
 
-NTSTATUS PhpGetObjectTypeName(
-    _In_ HANDLE ProcessHandle,
-    _In_ HANDLE Handle,
-    _In_ ULONG ObjectTypeNumber,
-    _Out_ PPH_STRING *TypeName
+static VOID PhpClassifyObjectType(
+    _In_ PPH_STRINGREF TypeName,
+    _Out_ PULONG Class,
+    _Out_ PULONG Flags
     )
 {
-    NTSTATUS status = STATUS_SUCCESS;
-    PPH_STRING typeName = NULL;
+    ULONG i;
 
-    // If the cache contains the object type name, use it. Otherwise,
-    // query the type name.
+    for (i = 0; i < sizeof(PhpKnownObjectTypes) / sizeof(PHP_KNOWN_OBJECT_TYPE); i++)
+    {
+        if (PhEqualStringRef(&PhpKnownObjectTypes[i].Name, TypeName, TRUE))
+        {
+            *Class = PhpKnownObjectTypes[i].Class;
+            *Flags = PhpKnownObjectTypes[i].Flags;
+            return;
+        }
+    }
 
-    if (ObjectTypeNumber != -1 && ObjectTypeNumber < MAX_OBJECT_TYPE_NUMBER)
-        typeName = PhObjectTypeNames[ObjectTypeNumber];
+    *Class = PH_OBJECT_TYPE_CLASS_OTHER;
+    *Flags = 0;
+}
+
+FORCEINLINE BOOLEAN PhpIsObjectTypeTableFresh(
+    _In_ ULONG64 CurrentTime
+    )
+{
+    return PhpObjectTypeTableLoaded && CurrentTime - PhpObjectTypeTableRefreshTime < PH_OBJECT_TYPE_TABLE_REFRESH_INTERVAL;
+}
 
-    if (typeName)
+static VOID PhpRefreshObjectTypeTable(
+    VOID
+    )
+{
+    ULONG64 currentTime;
+    POBJECT_TYPES_INFORMATION objectTypes;
+    POBJECT_TYPE_INFORMATION objectType;
+    ULONG objectTypeNumber;
+    ULONG i;
+
+    currentTime = NtGetTickCount64();
+
+    // Don't query the types again for every handle with an invalid type index. Check without
+    // the lock first so that rate-limited calls don't drain the readers of the table; a stale
+    // read only means that we check again below.
+    if (PhpIsObjectTypeTableFresh(currentTime))
+        return;
+
+    PhAcquireReadMostlyLockExclusive(&PhpObjectTypeTableLock);
+
+    // Another thread may have refreshed the table while we were waiting for the lock.
+    currentTime = NtGetTickCount64();
+
+    if (PhpIsObjectTypeTableFresh(currentTime))
     {
-        PhReferenceObject(typeName);
+        PhReleaseReadMostlyLockExclusive(&PhpObjectTypeTableLock);
+        return;
     }
-    else
+
+    PhpObjectTypeTableLoaded = TRUE;
+    PhpObjectTypeTableRefreshTime = currentTime;
+
+    if (NT_SUCCESS(PhEnumObjectTypes(&objectTypes)))
     {
-        POBJECT_TYPE_INFORMATION buffer;
-        ULONG returnLength = 0;
-        PPH_STRING oldTypeName;
+        objectType = PH_FIRST_OBJECT_TYPE(objectTypes);
 
-        // Get the needed buffer size.
-        if (KphIsConnected())
-        {
-            status = KphQueryInformationObject(
-                ProcessHandle,
-                Handle,
-                KphObjectTypeInformation,
-                NULL,
-                0,
-                &returnLength
-                );
-        }
-        else
+        for (i = 0; i < objectTypes->NumberOfTypes; i++)
         {
-            status = NtQueryObject(
-                Handle,
-                ObjectTypeInformation,
-                NULL,
-                0,
-                &returnLength
-                );
-        }
+            if (WindowsVersion >= WINDOWS_8_1)
+                objectTypeNumber = objectType->TypeIndex;
+            else if (WindowsVersion >= WINDOWS_7)
+                objectTypeNumber = i + 2;
+            else
+                objectTypeNumber = i + 1;
 
-        if (returnLength == 0)
-            return status;
+            if (objectTypeNumber < MAX_OBJECT_TYPE_NUMBER && !PhpObjectTypeTable[objectTypeNumber].Name)
+            {
+                PPH_OBJECT_TYPE_ENTRY entry = &PhpObjectTypeTable[objectTypeNumber];
+                PH_STRINGREF typeName;
 
-        buffer = PhAllocate(returnLength);
+                PhUnicodeStringToStringRef(&objectType->TypeName, &typeName);
+                entry->Name = PhInternStringRef(&typeName);
+                PhpClassifyObjectType(&typeName, &entry->Class, &entry->Flags);
+            }
 
-        if (KphIsConnected())
-        {
-            status = KphQueryInformationObject(
-                ProcessHandle,
-                Handle,
-                KphObjectTypeInformation,
-                buffer,
-                returnLength,
-                &returnLength
-                );
-        }
-        else
-        {
-            status = NtQueryObject(
-                Handle,
-                ObjectTypeInformation,
-                buffer,
-                returnLength,
-                &returnLength
-                );
+            objectType = PH_NEXT_OBJECT_TYPE(objectType);
         }
 
-        if (!NT_SUCCESS(status))
-        {
-            PhFree(buffer);
-            return status;
-        }
+        PhFree(objectTypes);
+    }
 
-        // Create a copy of the type name.
-        typeName = PhCreateStringFromUnicodeString(&buffer->TypeName);
+    PhReleaseReadMostlyLockExclusive(&PhpObjectTypeTableLock);
+}
 
-        if (ObjectTypeNumber != -1 && ObjectTypeNumber < MAX_OBJECT_TYPE_NUMBER)
-        {
-            // Try to store the type name in the cache.
-            oldTypeName = _InterlockedCompareExchangePointer(
-                &PhObjectTypeNames[ObjectTypeNumber],
-                typeName,
-                NULL
-                );
+static BOOLEAN PhpLookupObjectTypeTable(
+    _In_ ULONG ObjectTypeNumber,
+    _Out_ PPH_OBJECT_TYPE_ENTRY Entry
+    )
+{
+    BOOLEAN found;
 
-            // Add a reference if we stored the type name
-            // successfully.
-            if (!oldTypeName)
-                PhReferenceObject(typeName);
-        }
+    PhAcquireReadMostlyLockShared(&PhpObjectTypeTableLock);
+
+    found = !!PhpObjectTypeTable[ObjectTypeNumber].Name;
+
+    if (found)
+        *Entry = PhpObjectTypeTable[ObjectTypeNumber];
+
+    PhReleaseReadMostlyLockShared(&PhpObjectTypeTableLock);
+
+    return found;
+}
+
+/**
+ * Gets information about an object type.
+ *
+ * \param ObjectTypeNumber The object type number, as specified in
+ * SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX.
+ * \param Entry A variable which receives information about the object type.
+ * The type name is not referenced and remains valid for the lifetime of
+ * the process.
+ *
+ * \return TRUE if the object type is known, otherwise FALSE.
+ */
+BOOLEAN PhGetObjectTypeEntry(
+    _In_ ULONG ObjectTypeNumber,
+    _Out_ PPH_OBJECT_TYPE_ENTRY Entry
+    )
+{
+    if (ObjectTypeNumber >= MAX_OBJECT_TYPE_NUMBER)
+        return FALSE;
+
+    if (PhpLookupObjectTypeTable(ObjectTypeNumber, Entry))
+        return TRUE;
+
+    // The type may have been created after the table was filled.
+    PhpRefreshObjectTypeTable();
+
+    return PhpLookupObjectTypeTable(ObjectTypeNumber, Entry);
+}
+
+NTSTATUS PhpGetObjectTypeName(
+    _In_ HANDLE ProcessHandle,
+    _In_ HANDLE Handle,
+    _In_ ULONG ObjectTypeNumber,
+    _Out_ PPH_STRING *TypeName,
+    _Out_ PULONG TypeClass,
+    _Out_ PULONG TypeFlags
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PH_OBJECT_TYPE_ENTRY entry;
+    POBJECT_TYPE_INFORMATION buffer;
+    ULONG returnLength = 0;
+    PH_STRINGREF typeName;
+
+    // If the type table contains the object type, use it. Otherwise,
+    // query the type name.
+
+    if (PhGetObjectTypeEntry(ObjectTypeNumber, &entry))
+    {
+        PhReferenceObject(entry.Name);
+        *TypeName = entry.Name;
+        *TypeClass = entry.Class;
+        *TypeFlags = entry.Flags;
 
+        return STATUS_SUCCESS;
+    }
+
+    // Get the needed buffer size.
+    if (KphIsConnected())
+    {
+        status = KphQueryInformationObject(
+            ProcessHandle,
+            Handle,
+            KphObjectTypeInformation,
+            NULL,
+            0,
+            &returnLength
+            );
+    }
+    else
+    {
+        status = NtQueryObject(
+            Handle,
+            ObjectTypeInformation,
+            NULL,
+            0,
+            &returnLength
+            );
+    }
+
+    if (returnLength == 0)
+        return status;
+
+    buffer = PhAllocate(returnLength);
+
+    if (KphIsConnected())
+    {
+        status = KphQueryInformationObject(
+            ProcessHandle,
+            Handle,
+            KphObjectTypeInformation,
+            buffer,
+            returnLength,
+            &returnLength
+            );
+    }
+    else
+    {
+        status = NtQueryObject(
+            Handle,
+            ObjectTypeInformation,
+            buffer,
+            returnLength,
+            &returnLength
+            );
+    }
+
+    if (!NT_SUCCESS(status))
+    {
         PhFree(buffer);
+        return status;
     }
 
-    // At this point typeName should contain a type name
-    // with one additional reference.
+    // Windows 8.1 and later return the type index, so callers which don't know it
+    // (e.g. wait analysis) still end up with the table entry.
+    if (WindowsVersion >= WINDOWS_8_1 && PhGetObjectTypeEntry(buffer->TypeIndex, &entry))
+    {
+        PhReferenceObject(entry.Name);
+        *TypeName = entry.Name;
+        *TypeClass = entry.Class;
+        *TypeFlags = entry.Flags;
+    }
+    else
+    {
+        PhUnicodeStringToStringRef(&buffer->TypeName, &typeName);
+        *TypeName = PhInternStringRef(&typeName);
+        PhpClassifyObjectType(&typeName, TypeClass, TypeFlags);
+    }
 
-    *TypeName = typeName;
+    PhFree(buffer);
 
     return status;
 }
@@ -582,7 +747,7 @@ NTSTATUS PhpGetBestObjectName(
     _In_ HANDLE ProcessHandle,
     _In_ HANDLE Handle,
     _In_ PPH_STRING ObjectName,
-    _In_ PPH_STRING TypeName,
+    _In_ ULONG TypeClass,
     _Out_ PPH_STRING *BestObjectName
     )
 {
@@ -590,7 +755,7 @@ NTSTATUS PhpGetBestObjectName(
     PPH_STRING bestObjectName = NULL;
     PPH_GET_CLIENT_ID_NAME handleGetClientIdName = PhHandleGetClientIdName;
 
-    if (PhEqualString2(TypeName, L"EtwRegistration", TRUE))
+    if (TypeClass == PH_OBJECT_TYPE_CLASS_ETW_REGISTRATION)
     {
         if (KphIsConnected())
         {
@@ -653,7 +818,7 @@ NTSTATUS PhpGetBestObjectName(
             }
         }
     }
-    else if (PhEqualString2(TypeName, L"File", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_FILE)
     {
         // Convert the file name to a DOS file name.
         bestObjectName = PhResolveDevicePrefix(ObjectName);
@@ -692,7 +857,7 @@ NTSTATUS PhpGetBestObjectName(
             }
         }
     }
-    else if (PhEqualString2(TypeName, L"Job", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_JOB)
     {
         HANDLE dupHandle;
         PJOBOBJECT_BASIC_PROCESS_ID_LIST processIdList;
@@ -746,11 +911,11 @@ NTSTATUS PhpGetBestObjectName(
 
         NtClose(dupHandle);
     }
-    else if (PhEqualString2(TypeName, L"Key", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_KEY)
     {
         bestObjectName = PhFormatNativeKeyName(ObjectName);
     }
-    else if (PhEqualString2(TypeName, L"Process", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_PROCESS)
     {
         CLIENT_ID clientId;
 
@@ -804,7 +969,7 @@ NTSTATUS PhpGetBestObjectName(
         if (handleGetClientIdName)
             bestObjectName = handleGetClientIdName(&clientId);
     }
-    else if (PhEqualString2(TypeName, L"Section", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_SECTION)
     {
         HANDLE dupHandle;
         PPH_STRING fileName;
@@ -860,7 +1025,7 @@ NTSTATUS PhpGetBestObjectName(
 
         NtClose(dupHandle);
     }
-    else if (PhEqualString2(TypeName, L"Thread", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_THREAD)
     {
         CLIENT_ID clientId;
 
@@ -912,7 +1077,7 @@ NTSTATUS PhpGetBestObjectName(
         if (handleGetClientIdName)
             bestObjectName = handleGetClientIdName(&clientId);
     }
-    else if (PhEqualString2(TypeName, L"TmEn", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_TM_EN)
     {
         HANDLE dupHandle;
         ENLISTMENT_BASIC_INFORMATION basicInfo;
@@ -938,7 +1103,7 @@ NTSTATUS PhpGetBestObjectName(
             bestObjectName = PhFormatGuid(&basicInfo.EnlistmentId);
         }
     }
-    else if (PhEqualString2(TypeName, L"TmRm", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_TM_RM)
     {
         HANDLE dupHandle;
         GUID guid;
@@ -979,7 +1144,7 @@ NTSTATUS PhpGetBestObjectName(
             }
         }
     }
-    else if (PhEqualString2(TypeName, L"TmTm", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_TM_TM)
     {
         HANDLE dupHandle;
         PPH_STRING logFileName = NULL;
@@ -1026,7 +1191,7 @@ NTSTATUS PhpGetBestObjectName(
 
         NtClose(dupHandle);
     }
-    else if (PhEqualString2(TypeName, L"TmTx", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_TM_TX)
     {
         HANDLE dupHandle;
         PPH_STRING description = NULL;
@@ -1074,7 +1239,7 @@ NTSTATUS PhpGetBestObjectName(
 
         NtClose(dupHandle);
     }
-    else if (PhEqualString2(TypeName, L"Token", TRUE))
+    else if (TypeClass == PH_OBJECT_TYPE_CLASS_TOKEN)
     {
         HANDLE dupHandle;
         PTOKEN_USER tokenUser = NULL;
@@ -1246,6 +1411,8 @@ NTSTATUS PhGetHandleInformationEx(
     NTSTATUS subStatus = STATUS_SUCCESS;
     HANDLE dupHandle = NULL;
     PPH_STRING typeName = NULL;
+    ULONG typeClass;
+    ULONG typeFlags;
     PPH_STRING objectName = NULL;
     PPH_STRING bestObjectName = NULL;
 
@@ -1302,7 +1469,9 @@ NTSTATUS PhGetHandleInformationEx(
         ProcessHandle,
         KphIsConnected() ? Handle : dupHandle,
         ObjectTypeNumber,
-        &typeName
+        &typeName,
+        &typeClass,
+        &typeFlags
         );
 
     if (!NT_SUCCESS(status))
@@ -1314,7 +1483,7 @@ NTSTATUS PhGetHandleInformationEx(
 
     // Get the object name.
     // If we're dealing with a file handle we must take special precautions so we don't hang.
-    if (PhEqualString2(typeName, L"File", TRUE) && !KphIsConnected())
+    if ((typeFlags & PH_OBJECT_TYPE_NAME_QUERY_MAY_HANG) && !KphIsConnected())
     {
 #define QUERY_NORMALLY 0
 #define QUERY_WITH_TIMEOUT 1
@@ -1355,7 +1524,7 @@ NTSTATUS PhGetHandleInformationEx(
 
     if (!NT_SUCCESS(status))
     {
-        if (PhEqualString2(typeName, L"File", TRUE) && KphIsConnected())
+        if (typeClass == PH_OBJECT_TYPE_CLASS_FILE && KphIsConnected())
         {
             // PhpGetBestObjectName can provide us with a name.
             objectName = PhReferenceEmptyString();
@@ -1377,7 +1546,7 @@ NTSTATUS PhGetHandleInformationEx(
         ProcessHandle,
         Handle,
         objectName,
-        typeName,
+        typeClass,
         &bestObjectName
         );
 
@@ -1452,37 +1621,50 @@ NTSTATUS PhEnumObjectTypes(
     return status;
 }
 
-ULONG PhGetObjectTypeNumber(
-    _In_ PUNICODE_STRING TypeName
+static ULONG PhpFindObjectTypeTable(
+    _In_ PPH_STRINGREF TypeName
     )
 {
-    POBJECT_TYPES_INFORMATION objectTypes;
-    POBJECT_TYPE_INFORMATION objectType;
+    ULONG objectTypeNumber = -1;
     ULONG i;
 
-    if (NT_SUCCESS(PhEnumObjectTypes(&objectTypes)))
-    {
-        objectType = PH_FIRST_OBJECT_TYPE(objectTypes);
+    PhAcquireReadMostlyLockShared(&PhpObjectTypeTableLock);
 
-        for (i = 0; i < objectTypes->NumberOfTypes; i++)
+    for (i = 0; i < MAX_OBJECT_TYPE_NUMBER; i++)
+    {
+        if (PhpObjectTypeTable[i].Name && PhEqualStringRef(&PhpObjectTypeTable[i].Name->sr, TypeName, TRUE))
         {
-            if (RtlEqualUnicodeString(&objectType->TypeName, TypeName, TRUE))
-            {
-                if (WindowsVersion >= WINDOWS_8_1)
-                    return objectType->TypeIndex;
-                else if (WindowsVersion >= WINDOWS_7)
-                    return i + 2;
-                else
-                    return i + 1;
-            }
-
-            objectType = PH_NEXT_OBJECT_TYPE(objectType);
+            objectTypeNumber = i;
+            break;
         }
+    }
 
-        PhFree(objectTypes);
+    PhReleaseReadMostlyLockShared(&PhpObjectTypeTableLock);
+
+    return objectTypeNumber;
+}
+
+ULONG PhGetObjectTypeNumber(
+    _In_ PUNICODE_STRING TypeName
+    )
+{
+    PH_STRINGREF typeName;
+    ULONG objectTypeNumber;
+
+    PhUnicodeStringToStringRef(TypeName, &typeName);
+
+    if (!PhpObjectTypeTableLoaded)
+        PhpRefreshObjectTypeTable();
+
+    objectTypeNumber = PhpFindObjectTypeTable(&typeName);
+
+    if (objectTypeNumber == -1)
+    {
+        PhpRefreshObjectTypeTable();
+        objectTypeNumber = PhpFindObjectTypeTable(&typeName);
     }
 
-    return -1;
+    return objectTypeNumber;
 }
 
 PPHP_CALL_WITH_TIMEOUT_THREAD_CONTEXT PhpAcquireCallWithTimeoutThread(
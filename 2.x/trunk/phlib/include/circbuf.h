@@ -3,24 +3,43 @@
 
 #define PH_CIRCULAR_BUFFER_POWER_OF_TWO_SIZE
 
+#define PH_CIRCULAR_BUFFER_STATISTICS_SUM 0x1
+#define PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM 0x2
+#define PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM 0x4
+
+// T_SUM is the type used to accumulate sums of T. Statistics are only available
+// for types which define it.
+
 #undef T
+#undef T_SUM
 #define T ULONG
+#define T_SUM ULONG64
 #include "circbuf_h.h"
 
 #undef T
+#undef T_SUM
 #define T ULONG64
+#define T_SUM ULONG64
 #include "circbuf_h.h"
 
 #undef T
+#undef T_SUM
 #define T PVOID
 #include "circbuf_h.h"
 
 #undef T
+#undef T_SUM
 #define T SIZE_T
+#define T_SUM ULONG64
 #include "circbuf_h.h"
 
 #undef T
+#undef T_SUM
 #define T FLOAT
+#define T_SUM DOUBLE
 #include "circbuf_h.h"
 
+#undef T
+#undef T_SUM
+
 #endif
@@ -52,6 +52,16 @@ T___(PhCopyCircularBuffer, T)(
     _In_ ULONG Count
     );
 
+PHLIBAPI
+ULONG
+NTAPI
+T___(PhCopyCircularBufferEx, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _In_ ULONG Index,
+    _Out_writes_to_(Count, return) T *Destination,
+    _In_ ULONG Count
+    );
+
 FORCEINLINE T T___(PhGetItemCircularBuffer, T)(
     _In_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
     _In_ LONG Index
@@ -129,4 +139,128 @@ FORCEINLINE T T___(PhAddItemCircularBuffer2, T)(
     return oldValue;
 }
 
+#ifdef T_SUM
+
+PHLIBAPI
+ULONG
+NTAPI
+T___(PhCopyCircularBufferAsSingles, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _In_ ULONG Index,
+    _Out_writes_to_(Count, return) FLOAT *Destination,
+    _In_ ULONG Count
+    );
+
+typedef struct T___(_PH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T)
+{
+    ULONG Sequence;
+    T Value;
+} T___(PH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T), *T___(PPH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T);
+
+typedef struct T___(_PH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T)
+{
+    ULONG Head;
+    ULONG Count;
+    T___(PPH_CIRCULAR_BUFFER_STATISTICS_ENTRY, T) Entries;
+} T___(PH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T), *T___(PPH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T);
+
+/**
+ * Running statistics over the most recent items of a circular buffer.
+ *
+ * The sum is updated in constant time. The minimum and maximum are
+ * kept in monotonic queues, so adding an item takes amortized constant
+ * time. The minimum or maximum of the whole window is available in
+ * constant time, and that of any shorter window of recent items in
+ * logarithmic time.
+ */
+typedef struct T___(_PH_CIRCULAR_BUFFER_STATISTICS, T)
+{
+    ULONG Flags;
+    /** The number of recent items which are considered. */
+    ULONG WindowSize;
+    /** The number of items currently in the window. */
+    ULONG Count;
+    /** The sequence number of the next item. */
+    ULONG Sequence;
+    T_SUM Sum;
+    ULONG QueueSizeMinusOne;
+    T___(PH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T) MinimumQueue;
+    T___(PH_CIRCULAR_BUFFER_STATISTICS_QUEUE, T) MaximumQueue;
+} T___(PH_CIRCULAR_BUFFER_STATISTICS, T), *T___(PPH_CIRCULAR_BUFFER_STATISTICS, T);
+
+PHLIBAPI
+VOID
+NTAPI
+T___(PhInitializeCircularBufferStatistics, T)(
+    _Out_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG WindowSize,
+    _In_ ULONG Flags
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+T___(PhDeleteCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+T___(PhClearCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+T___(PhAddItemCircularBufferEx, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER, T) Buffer,
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ T Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+T___(PhUpdateCircularBufferStatistics, T)(
+    _Inout_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ T Value
+    );
+
+PHLIBAPI
+T
+NTAPI
+T___(PhGetMinimumCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG Count
+    );
+
+PHLIBAPI
+T
+NTAPI
+T___(PhGetMaximumCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics,
+    _In_ ULONG Count
+    );
+
+FORCEINLINE T_SUM T___(PhGetSumCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    )
+{
+    return Statistics->Sum;
+}
+
+FORCEINLINE T_SUM T___(PhGetMeanCircularBufferStatistics, T)(
+    _In_ T___(PPH_CIRCULAR_BUFFER_STATISTICS, T) Statistics
+    )
+{
+    if (Statistics->Count != 0)
+        return Statistics->Sum / Statistics->Count;
+    else
+        return 0;
+}
+
+#endif
+
 #endif
@@ -1125,6 +1125,37 @@ PhSidToStringSid(
 
 #define MAX_OBJECT_TYPE_NUMBER 257
 
+// Object type classes
+
+/** The object type has no special handling. */
+#define PH_OBJECT_TYPE_CLASS_OTHER 0
+#define PH_OBJECT_TYPE_CLASS_ETW_REGISTRATION 1
+#define PH_OBJECT_TYPE_CLASS_FILE 2
+#define PH_OBJECT_TYPE_CLASS_JOB 3
+#define PH_OBJECT_TYPE_CLASS_KEY 4
+#define PH_OBJECT_TYPE_CLASS_PROCESS 5
+#define PH_OBJECT_TYPE_CLASS_SECTION 6
+#define PH_OBJECT_TYPE_CLASS_THREAD 7
+#define PH_OBJECT_TYPE_CLASS_TM_EN 8
+#define PH_OBJECT_TYPE_CLASS_TM_RM 9
+#define PH_OBJECT_TYPE_CLASS_TM_TM 10
+#define PH_OBJECT_TYPE_CLASS_TM_TX 11
+#define PH_OBJECT_TYPE_CLASS_TOKEN 12
+
+// Object type flags
+
+/** Querying the name of an object of this type may hang unless KProcessHacker is used. */
+#define PH_OBJECT_TYPE_NAME_QUERY_MAY_HANG 0x1
+
+typedef struct _PH_OBJECT_TYPE_ENTRY
+{
+    /** The interned type name. It is valid for the lifetime of the process. */
+    PPH_STRING Name;
+    /** The type class, which selects how names of objects of this type are queried. */
+    ULONG Class;
+    ULONG Flags;
+} PH_OBJECT_TYPE_ENTRY, *PPH_OBJECT_TYPE_ENTRY;
+
 typedef PPH_STRING (NTAPI *PPH_GET_CLIENT_ID_NAME)(
     _In_ PCLIENT_ID ClientId
     );
@@ -1205,6 +1236,14 @@ PhGetObjectTypeNumber(
     _In_ PUNICODE_STRING TypeName
     );
 
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhGetObjectTypeEntry(
+    _In_ ULONG ObjectTypeNumber,
+    _Out_ PPH_OBJECT_TYPE_ENTRY Entry
+    );
+
 NTSTATUS
 NTAPI
 PhCallWithTimeout(
@@ -1947,6 +1986,8 @@ typedef VOID (NTAPI *PPH_PROVIDER_FUNCTION)(
 struct _PH_PROVIDER_THREAD;
 typedef struct _PH_PROVIDER_THREAD *PPH_PROVIDER_THREAD;
 
+#define PH_PROVIDER_RUN_HISTORY_SIZE 32
+
 typedef struct _PH_PROVIDER_REGISTRATION
 {
     LIST_ENTRY ListEntry;
@@ -1957,6 +1998,19 @@ typedef struct _PH_PROVIDER_REGISTRATION
     BOOLEAN Enabled;
     BOOLEAN Unregistering;
     BOOLEAN Boosting;
+    BOOLEAN Spare;
+
+    ULONG Interval; // minimum time between periodic runs, in milliseconds
+    ULONG IdleInterval; // maximum back-off when there are no consumers, in milliseconds
+    ULONG Budget; // maximum expected run time, in milliseconds
+    ULONG CurrentInterval;
+    ULONG64 NextRunTime;
+    volatile LONG Consumers;
+    ULONG Overruns;
+
+    ULONG RunTimes[PH_PROVIDER_RUN_HISTORY_SIZE]; // in microseconds
+    ULONG RunTimesIndex;
+    ULONG RunTimesCount;
 } PH_PROVIDER_REGISTRATION, *PPH_PROVIDER_REGISTRATION;
 
 typedef struct _PH_PROVIDER_THREAD
@@ -1969,6 +2023,9 @@ typedef struct _PH_PROVIDER_THREAD
     PH_QUEUED_LOCK Lock;
     LIST_ENTRY ListHead;
     ULONG BoostCount;
+
+    PPH_PROVIDER_REGISTRATION CurrentRegistration;
+    LARGE_INTEGER Frequency;
 } PH_PROVIDER_THREAD, *PPH_PROVIDER_THREAD;
 
 PHLIBAPI
@@ -2055,6 +2112,39 @@ PhSetEnabledProvider(
     _In_ BOOLEAN Enabled
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhSetIntervalProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG IdleInterval,
+    _In_ ULONG Budget
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddConsumerProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhRemoveConsumerProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetRunTimesProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_writes_to_(Count, return) PULONG RunTimes,
+    _In_ ULONG Count
+    );
+
 // svcsup
 
 extern WCHAR *PhServiceTypeStrings[6];
@@ -2707,6 +2797,13 @@ PhDeleteImageVersionInfo(
     _Inout_ PPH_IMAGE_VERSION_INFO ImageVersionInfo
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhInternImageVersionInfo(
+    _Inout_ PPH_IMAGE_VERSION_INFO ImageVersionInfo
+    );
+
 PHLIBAPI
 PPH_STRING
 NTAPI
@@ -38,6 +38,7 @@
 #include <ref.h>
 #include <fastlock.h>
 #include <queuedlock.h>
+#include <rmlock.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -1531,6 +1532,35 @@ PhCompareStringWithNull(
     }
 }
 
+PHLIBAPI
+ULONG64
+NTAPI
+PhGetStringRefSortKey(
+    _In_ PPH_STRINGREF String,
+    _In_ BOOLEAN IgnoreCase
+    );
+
+/**
+ * Creates a sort key from a string for use with PhSortKeys().
+ *
+ * \param String A string. NULL is treated as an empty string.
+ * \param IgnoreCase Whether to ignore character cases.
+ *
+ * \remarks See PhGetStringRefSortKey() for details.
+ */
+FORCEINLINE
+ULONG64
+PhGetStringSortKey(
+    _In_opt_ PPH_STRING String,
+    _In_ BOOLEAN IgnoreCase
+    )
+{
+    if (String)
+        return PhGetStringRefSortKey(&String->sr, IgnoreCase);
+    else
+        return 0;
+}
+
 /**
  * Determines whether two strings are equal.
  *
@@ -2890,6 +2920,24 @@ typedef ULONG (NTAPI *PPH_HASHTABLE_HASH_FUNCTION)(
 // Enables 2^32-1 possible hash codes instead of only 2^31
 //#define PH_HASHTABLE_FULL_HASH
 
+// Hashtable flags
+
+/**
+ * Stores entries inline in a power-of-two slot array with a parallel control
+ * byte array instead of chaining them through bucket heads. Lookups compare
+ * 7-bit hash tags 16 slots at a time and deletion uses backward shifting, so
+ * no tombstones are left behind.
+ *
+ * \remarks Removing an entry may move other entries to different slots, so
+ * entries must not be removed while the hashtable is being enumerated.
+ */
+#define PH_HASHTABLE_OPEN_ADDRESSING 0x1
+
+/** The number of control bytes compared at once in an open addressing hashtable. */
+#define PH_HASHTABLE_GROUP_SIZE 16
+/** The control byte value for an unused slot in an open addressing hashtable. */
+#define PH_HASHTABLE_CONTROL_EMPTY 0x80
+
 /**
  * A hashtable structure.
  */
@@ -2897,6 +2945,8 @@ typedef struct _PH_HASHTABLE
 {
     /** Size of user data in each entry. */
     ULONG EntrySize;
+    /** A combination of PH_HASHTABLE_* flags. */
+    ULONG Flags;
     /** The comparison function. */
     PPH_HASHTABLE_COMPARE_FUNCTION CompareFunction;
     /** The hash function. */
@@ -2916,9 +2966,17 @@ typedef struct _PH_HASHTABLE
     /** Index into entry array for free list. */
     ULONG FreeEntry;
     /** Index of next usable index into entry array, a.k.a. the
-     * count of entries that were ever allocated.
+     * count of entries that were ever allocated. For open addressing
+     * hashtables this is the number of slots.
      */
     ULONG NextEntry;
+
+    /** The control byte array for open addressing hashtables. Each byte
+     * is either PH_HASHTABLE_CONTROL_EMPTY or a 7-bit hash tag. The first
+     * PH_HASHTABLE_GROUP_SIZE bytes are mirrored after the last slot so that
+     * groups can be loaded without wrapping.
+     */
+    PUCHAR Control;
 } PH_HASHTABLE, *PPH_HASHTABLE;
 
 #define PH_HASHTABLE_ENTRY_SIZE(InnerSize) (FIELD_OFFSET(PH_HASHTABLE_ENTRY, Body) + (InnerSize))
@@ -2939,6 +2997,17 @@ PhCreateHashtable(
     _In_ ULONG InitialCapacity
     );
 
+PHLIBAPI
+PPH_HASHTABLE
+NTAPI
+PhCreateHashtableEx(
+    _In_ ULONG EntrySize,
+    _In_ PPH_HASHTABLE_COMPARE_FUNCTION CompareFunction,
+    _In_ PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    _In_ ULONG InitialCapacity,
+    _In_ ULONG Flags
+    );
+
 PHLIBAPI
 PVOID
 NTAPI
@@ -3045,6 +3114,30 @@ PhHashStringRef(
     _In_ BOOLEAN IgnoreCase
     );
 
+typedef enum _PH_HASH_ALGORITHM
+{
+    Fnv1aHashAlgorithm, // same as PhHashBytes and PhHashStringRef
+    WordHashAlgorithm // word-at-a-time multiply-mix
+} PH_HASH_ALGORITHM;
+
+PHLIBAPI
+ULONG
+NTAPI
+PhHashBytesEx(
+    _In_reads_(Length) PUCHAR Bytes,
+    _In_ SIZE_T Length,
+    _In_ PH_HASH_ALGORITHM Algorithm
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhHashStringRefEx(
+    _In_ PPH_STRINGREF String,
+    _In_ BOOLEAN IgnoreCase,
+    _In_ PH_HASH_ALGORITHM Algorithm
+    );
+
 FORCEINLINE
 ULONG
 PhHashInt32(
@@ -3147,6 +3240,23 @@ PhRemoveItemSimpleHashtable(
 
 // Free list
 
+// Free list flags
+
+/**
+ * Caches free blocks in per-thread magazines. Blocks move between the
+ * magazines and the free list in batches of PH_FREE_LIST_MAGAZINE_SIZE,
+ * so most allocations and frees do not touch any shared cache lines.
+ * Only threads with a free list thread cache use the magazines.
+ *
+ * \remarks Free lists using magazines must not be deleted.
+ */
+#define PH_FREE_LIST_USE_MAGAZINES 0x1
+
+/** The number of blocks moved between a magazine and its free list at once. */
+#define PH_FREE_LIST_MAGAZINE_SIZE 16
+/** The maximum number of free lists which can use magazines. */
+#define PH_FREE_LIST_MAXIMUM_MAGAZINES 32
+
 typedef struct _PH_FREE_LIST
 {
     SLIST_HEADER ListHead;
@@ -3154,6 +3264,19 @@ typedef struct _PH_FREE_LIST
     ULONG Count;
     ULONG MaximumCount;
     SIZE_T Size;
+
+    /** A combination of PH_FREE_LIST_* flags. */
+    ULONG Flags;
+    /** The index of the magazine used by each thread cache, or -1. */
+    ULONG MagazineIndex;
+    /** A list of full batches of blocks flushed from magazines. */
+    SLIST_HEADER MagazineListHead;
+    /** The number of allocations satisfied by magazines. Updated when
+     * batches move between magazines and the free list. */
+    ULONG MagazineHits;
+    /** The number of allocations which had to go to the free list
+     * because a magazine was empty. */
+    ULONG MagazineMisses;
 } PH_FREE_LIST, *PPH_FREE_LIST;
 
 typedef struct _PH_FREE_LIST_ENTRY
@@ -3179,6 +3302,16 @@ PhInitializeFreeList(
     _In_ ULONG MaximumCount
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeFreeListEx(
+    _Out_ PPH_FREE_LIST FreeList,
+    _In_ SIZE_T Size,
+    _In_ ULONG MaximumCount,
+    _In_ ULONG Flags
+    );
+
 PHLIBAPI
 VOID
 NTAPI
@@ -3186,6 +3319,20 @@ PhDeleteFreeList(
     _Inout_ PPH_FREE_LIST FreeList
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeFreeListThreadCache(
+    VOID
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteFreeListThreadCache(
+    VOID
+    );
+
 PHLIBAPI
 PVOID
 NTAPI
@@ -3560,6 +3707,53 @@ PhFormatToBuffer(
     _Out_opt_ PSIZE_T ReturnLength
     );
 
+/** The number of characters stored inside a format slot before it needs a separate buffer. */
+#define PH_FORMAT_SLOT_INLINE_LENGTH 32
+
+/**
+ * A format slot is a reusable destination for formatted text, such as
+ * the text of a single cell in a tree list.
+ *
+ * Text is written to the inline buffer if it fits, otherwise to a
+ * separately allocated buffer which is kept for later calls. A slot
+ * which has been zeroed is initialized.
+ */
+typedef struct _PH_FORMAT_SLOT
+{
+    /** The allocated buffer, or NULL if the inline buffer is in use. */
+    PWSTR Buffer;
+    /** The size of \a Buffer, in bytes. */
+    SIZE_T AllocatedLength;
+    WCHAR InlineBuffer[PH_FORMAT_SLOT_INLINE_LENGTH];
+} PH_FORMAT_SLOT, *PPH_FORMAT_SLOT;
+
+FORCEINLINE
+VOID
+PhInitializeFormatSlot(
+    _Out_ PPH_FORMAT_SLOT Slot
+    )
+{
+    Slot->Buffer = NULL;
+    Slot->AllocatedLength = 0;
+}
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteFormatSlot(
+    _Inout_ PPH_FORMAT_SLOT Slot
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhFormatToSlot(
+    _Inout_ PPH_FORMAT_SLOT Slot,
+    _In_reads_(Count) PPH_FORMAT Format,
+    _In_ ULONG Count,
+    _Out_ PPH_STRINGREF String
+    );
+
 // basesupa
 
 PHLIBAPI
@@ -3781,6 +3975,216 @@ PhEnumAvlTree(
     _In_opt_ PVOID Context
     );
 
+// B-trees
+
+/** The maximum number of keys in a B-tree node. */
+#define PH_BTREE_MAXIMUM_KEYS 30
+/** The minimum number of keys in a B-tree node other than the root. */
+#define PH_BTREE_MINIMUM_KEYS (PH_BTREE_MAXIMUM_KEYS / 2)
+
+struct _PH_BTREE_NODE;
+typedef struct _PH_BTREE_NODE *PPH_BTREE_NODE;
+
+/**
+ * A B-tree is an ordered map from 64-bit integer keys to pointers.
+ *
+ * Unlike an AVL tree, each node stores many keys in a contiguous array,
+ * so a lookup touches a few cache lines per level instead of one node
+ * per key. All elements are stored in the leaves, which are linked so
+ * that ranges can be enumerated without walking back up the tree.
+ */
+typedef struct _PH_BTREE
+{
+    PPH_BTREE_NODE Root;
+    ULONG Count;
+    ULONG Height;
+} PH_BTREE, *PPH_BTREE;
+
+#define PH_BTREE_INIT { NULL, 0, 0 }
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeBTree(
+    _Out_ PPH_BTREE Tree
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteBTree(
+    _Inout_ PPH_BTREE Tree
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhAddElementBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _In_opt_ PVOID Value,
+    _Out_opt_ PVOID *ExistingValue
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhRemoveElementBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PVOID *Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhFindElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PVOID *Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhFloorElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PULONG64 FoundKey,
+    _Out_opt_ PVOID *Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhCeilingElementBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 Key,
+    _Out_opt_ PULONG64 FoundKey,
+    _Out_opt_ PVOID *Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhBuildBTree(
+    _Inout_ PPH_BTREE Tree,
+    _In_reads_(Count) PULONG64 Keys,
+    _In_reads_opt_(Count) PVOID *Values,
+    _In_ ULONG Count
+    );
+
+typedef struct _PH_BTREE_ENUM_CONTEXT
+{
+    PPH_BTREE_NODE Node;
+    ULONG Index;
+    ULONG64 HighKey;
+} PH_BTREE_ENUM_CONTEXT, *PPH_BTREE_ENUM_CONTEXT;
+
+PHLIBAPI
+VOID
+NTAPI
+PhBeginEnumBTree(
+    _In_ PPH_BTREE Tree,
+    _In_ ULONG64 LowKey,
+    _In_ ULONG64 HighKey,
+    _Out_ PPH_BTREE_ENUM_CONTEXT Context
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhNextEnumBTree(
+    _Inout_ PPH_BTREE_ENUM_CONTEXT Context,
+    _Out_opt_ PULONG64 Key,
+    _Out_opt_ PVOID *Value
+    );
+
+// Key sort
+
+/**
+ * A sort key describes one element to be sorted by PhSortKeys().
+ *
+ * Sorting an array of keys which have been extracted once per element
+ * is much faster than comparing the elements themselves, because the
+ * keys can be sorted by radix instead of by comparison, and because
+ * the elements are not dereferenced again during the sort.
+ */
+typedef struct _PH_SORT_KEY
+{
+    /** The primary key. */
+    ULONG64 Key;
+    /** The key used to order elements with equal primary keys when
+     * there is no compare function. */
+    ULONG64 TieKey;
+    /** The element. */
+    PVOID Item;
+} PH_SORT_KEY, *PPH_SORT_KEY;
+
+/**
+ * A function which compares two elements with equal primary keys.
+ *
+ * \param Context The user-defined context passed to PhSortKeys().
+ * \param Item1 A pointer to the Item field of the first sort key.
+ * \param Item2 A pointer to the Item field of the second sort key.
+ *
+ * \return The result of the comparison, including the sort order.
+ * This has the same meaning as for qsort_s(), so existing qsort_s()
+ * compare functions can be used.
+ */
+typedef int (__cdecl *PPH_SORT_KEY_COMPARE_FUNCTION)(
+    _In_ void *Context,
+    _In_ const void *Item1,
+    _In_ const void *Item2
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhSortKeys(
+    _Inout_updates_(Count) PPH_SORT_KEY Keys,
+    _In_ ULONG Count,
+    _In_ PH_SORT_ORDER SortOrder,
+    _In_opt_ PPH_SORT_KEY_COMPARE_FUNCTION CompareFunction,
+    _In_opt_ PVOID Context
+    );
+
+/**
+ * Creates a sort key from a signed integer.
+ */
+FORCEINLINE
+ULONG64
+PhSortKeyFromInt64(
+    _In_ LONG64 Value
+    )
+{
+    return (ULONG64)Value ^ 0x8000000000000000;
+}
+
+/**
+ * Creates a sort key from a floating-point value.
+ */
+FORCEINLINE
+ULONG64
+PhSortKeyFromDouble(
+    _In_ DOUBLE Value
+    )
+{
+    ULONG64 bits;
+
+    // Zero and negative zero compare equal.
+    if (Value == 0)
+        Value = 0;
+
+    bits = *(PULONG64)&Value;
+
+    // Negative values are stored as magnitudes, so their order must be reversed.
+    if (bits & 0x8000000000000000)
+        return ~bits;
+    else
+        return bits | 0x8000000000000000;
+}
+
 // handle
 
 struct _PH_HANDLE_TABLE;
@@ -3940,13 +4344,42 @@ extern PPH_LIST PhDbgWorkQueueList;
 extern PH_QUEUED_LOCK PhDbgWorkQueueListLock;
 #endif
 
+// Work queue flags
+
+/**
+ * Gives each worker thread its own deque. Items queued by a worker thread
+ * go to its own deque, and other items are spread across the deques. Idle
+ * workers steal items from the deques of busy workers, and spin briefly
+ * before blocking.
+ */
+#define PH_WORK_QUEUE_WORK_STEALING 0x1
+
+// Work queue item priorities
+
+#define PH_WORK_QUEUE_PRIORITY_HIGH 0
+#define PH_WORK_QUEUE_PRIORITY_NORMAL 1
+#define PH_WORK_QUEUE_PRIORITY_LOW 2
+#define PH_WORK_QUEUE_PRIORITY_COUNT 3
+
+#define PH_WORK_QUEUE_MAXIMUM_DEQUES 64
+
+typedef struct _PH_WORK_QUEUE_DEQUE
+{
+    PH_QUEUED_LOCK Lock;
+    /** The number of items in all lists. May be read without holding the lock. */
+    ULONG Count;
+    /** A list of items for each priority, in FIFO order. */
+    LIST_ENTRY ListHeads[PH_WORK_QUEUE_PRIORITY_COUNT];
+} PH_WORK_QUEUE_DEQUE, *PPH_WORK_QUEUE_DEQUE;
+
 typedef struct _PH_WORK_QUEUE
 {
     PH_RUNDOWN_PROTECT RundownProtect;
     BOOLEAN Terminating;
 
-    LIST_ENTRY QueueListHead;
-    PH_QUEUED_LOCK QueueLock;
+    /** The shared deque. This is the only deque unless work stealing is enabled,
+     * but its lock always protects QueueEmptyCondition. */
+    PH_WORK_QUEUE_DEQUE Queue;
     PH_QUEUED_LOCK QueueEmptyCondition;
 
     ULONG MaximumThreads;
@@ -3957,6 +4390,19 @@ typedef struct _PH_WORK_QUEUE
     HANDLE SemaphoreHandle;
     ULONG CurrentThreads;
     ULONG BusyCount;
+
+    ULONG Flags;
+    /** The number of queued items in all deques. */
+    ULONG PendingCount;
+    /** The number of queued high priority items in all deques. */
+    ULONG HighPriorityCount;
+    /** The number of worker threads waiting on the semaphore. */
+    ULONG IdleCount;
+
+    ULONG NumberOfDeques;
+    PPH_WORK_QUEUE_DEQUE Deques;
+    ULONG NextDeque;
+    ULONG NextWorker;
 } PH_WORK_QUEUE, *PPH_WORK_QUEUE;
 
 typedef VOID (NTAPI *PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION)(
@@ -3972,6 +4418,17 @@ typedef struct _PH_WORK_QUEUE_ITEM
     PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction;
 } PH_WORK_QUEUE_ITEM, *PPH_WORK_QUEUE_ITEM;
 
+/**
+ * Describes a work item for PhQueueItemsWorkQueue().
+ */
+typedef struct _PH_WORK_QUEUE_ITEM_DESCRIPTOR
+{
+    PUSER_THREAD_START_ROUTINE Function;
+    PVOID Context;
+    PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction;
+    ULONG Priority;
+} PH_WORK_QUEUE_ITEM_DESCRIPTOR, *PPH_WORK_QUEUE_ITEM_DESCRIPTOR;
+
 VOID
 PhWorkQueueInitialization(
     VOID
@@ -3987,6 +4444,17 @@ PhInitializeWorkQueue(
     _In_ ULONG NoWorkTimeout
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeWorkQueueEx(
+    _Out_ PPH_WORK_QUEUE WorkQueue,
+    _In_ ULONG MinimumThreads,
+    _In_ ULONG MaximumThreads,
+    _In_ ULONG NoWorkTimeout,
+    _In_ ULONG Flags
+    );
+
 PHLIBAPI
 VOID
 NTAPI
@@ -4010,12 +4478,24 @@ PhQueueItemWorkQueue(
     _In_opt_ PVOID Context
     );
 
+PHLIBAPI
 VOID
+NTAPI
 PhQueueItemWorkQueueEx(
     _Inout_ PPH_WORK_QUEUE WorkQueue,
     _In_ PUSER_THREAD_START_ROUTINE Function,
     _In_opt_ PVOID Context,
-    _In_opt_ PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction
+    _In_opt_ PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction,
+    _In_ ULONG Priority
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhQueueItemsWorkQueue(
+    _Inout_ PPH_WORK_QUEUE WorkQueue,
+    _In_reads_(Count) PPH_WORK_QUEUE_ITEM_DESCRIPTOR Items,
+    _In_ ULONG Count
     );
 
 PHLIBAPI
@@ -4026,6 +4506,125 @@ PhQueueItemGlobalWorkQueue(
     _In_opt_ PVOID Context
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhQueueItemGlobalWorkQueueEx(
+    _In_ PUSER_THREAD_START_ROUTINE Function,
+    _In_opt_ PVOID Context,
+    _In_ ULONG Priority
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhQueueItemsGlobalWorkQueue(
+    _In_reads_(Count) PPH_WORK_QUEUE_ITEM_DESCRIPTOR Items,
+    _In_ ULONG Count
+    );
+
+// strpool
+
+#define PH_STRING_POOL_SHARD_SHIFT 4
+#define PH_STRING_POOL_SHARD_COUNT (1 << PH_STRING_POOL_SHARD_SHIFT)
+
+extern PPH_OBJECT_TYPE PhInternedStringType;
+
+typedef struct _PH_STRING_POOL_SHARD
+{
+    PH_QUEUED_LOCK Lock;
+    PPH_HASHTABLE Hashtable;
+    ULONG Lookups;
+    ULONG Hits;
+    SIZE_T BytesSaved;
+} PH_STRING_POOL_SHARD, *PPH_STRING_POOL_SHARD;
+
+/**
+ * A string pool stores one copy of each distinct string. Strings in the
+ * pool are not kept alive by the pool.
+ */
+typedef struct _PH_STRING_POOL
+{
+    PH_STRING_POOL_SHARD Shards[PH_STRING_POOL_SHARD_COUNT];
+} PH_STRING_POOL, *PPH_STRING_POOL;
+
+typedef struct _PH_STRING_POOL_STATISTICS
+{
+    /** The number of strings currently in the pool. */
+    ULONG NumberOfStrings;
+    /** The number of intern requests. */
+    ULONG Lookups;
+    /** The number of intern requests that found an existing string. */
+    ULONG Hits;
+    /** The number of bytes used by strings currently in the pool. */
+    SIZE_T BytesUsed;
+    /** The total size of the copies that were avoided by intern requests. */
+    SIZE_T BytesSaved;
+    /** The memory currently saved, assuming each reference to a pooled
+     * string would otherwise have been a separate copy. */
+    SIZE_T BytesSavedEstimate;
+} PH_STRING_POOL_STATISTICS, *PPH_STRING_POOL_STATISTICS;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeStringPool(
+    _Out_ PPH_STRING_POOL Pool,
+    _In_ ULONG InitialCapacity
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteStringPool(
+    _Inout_ PPH_STRING_POOL Pool
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhInternStringPool(
+    _Inout_ PPH_STRING_POOL Pool,
+    _In_opt_ _Assume_refs_(1) PPH_STRING String
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhInternStringRefPool(
+    _Inout_ PPH_STRING_POOL Pool,
+    _In_ PPH_STRINGREF String
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhGetStringPoolStatistics(
+    _In_ PPH_STRING_POOL Pool,
+    _Out_ PPH_STRING_POOL_STATISTICS Statistics
+    );
+
+PHLIBAPI
+PPH_STRING_POOL
+NTAPI
+PhGetGlobalStringPool(
+    VOID
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhInternString(
+    _In_opt_ _Assume_refs_(1) PPH_STRING String
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhInternStringRef(
+    _In_ PPH_STRINGREF String
+    );
+
 // data
 
 // SIDs
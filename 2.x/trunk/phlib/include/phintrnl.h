@@ -4,10 +4,15 @@
 typedef struct _PHLIB_STATISTICS_BLOCK
 {
     // basesup
+    ULONG BaseAllocations;
     ULONG BaseThreadsCreated;
     ULONG BaseThreadsCreateFailed;
     ULONG BaseStringBuildersCreated;
     ULONG BaseStringBuildersResized;
+    ULONG BaseFreeListMagazineHits;
+    ULONG BaseFreeListMagazineMisses;
+    ULONG BaseFreeListMagazineRefills;
+    ULONG BaseFreeListMagazineFlushes;
 
     // ref
     ULONG RefObjectsCreated;
@@ -23,23 +28,81 @@ typedef struct _PHLIB_STATISTICS_BLOCK
     ULONG RefAutoPoolsDestroyed;
     ULONG RefAutoPoolsDynamicAllocated;
     ULONG RefAutoPoolsDynamicResized;
+    ULONG RefBiasedObjectsCreated;
+    ULONG RefBiasedObjectsQueued;
+    ULONG RefBiasedObjectsMerged;
 
     // queuedlock
     ULONG QlBlockSpins;
+    ULONG QlBlockSpinsSucceeded;
     ULONG QlBlockWaits;
     ULONG QlAcquireExclusiveBlocks;
     ULONG QlAcquireSharedBlocks;
 
+    // rmlock
+    ULONG RmAcquireSharedBlocks;
+    ULONG RmExclusiveDrainWaits;
+
     // workqueue
     ULONG WqWorkQueueThreadsCreated;
     ULONG WqWorkQueueThreadsCreateFailed;
     ULONG WqWorkItemsQueued;
+    ULONG WqWorkItemsStolen;
 } PHLIB_STATISTICS_BLOCK;
 
 #ifdef DEBUG
 extern PHLIB_STATISTICS_BLOCK PhLibStatisticsBlock;
 #endif
 
+// basesup
+
+#define PH_VECTOR_LEVEL_NONE 0
+#define PH_VECTOR_LEVEL_SSE2 1
+#define PH_VECTOR_LEVEL_AVX 2
+#define PH_VECTOR_LEVEL_AVX2 3
+
+ULONG PhGetBaseVectorLevel(
+    VOID
+    );
+
+ULONG PhSetBaseVectorLevel(
+    _In_ ULONG VectorLevel
+    );
+
+BOOLEAN PhEnableThreadAllocationCounts(
+    VOID
+    );
+
+ULONG PhGetThreadAllocationCount(
+    VOID
+    );
+
+// ref
+
+VOID PhRetireCurrentObjectBiasOwner(
+    VOID
+    );
+
+/**
+ * Gets the value of a TLS slot. Unlike TlsGetValue, the last error
+ * value of the thread is preserved.
+ *
+ * \param TlsIndex The TLS index.
+ */
+FORCEINLINE PVOID PhpGetTlsValue(
+    _In_ ULONG TlsIndex
+    )
+{
+    ULONG lastError;
+    PVOID value;
+
+    lastError = NtCurrentTeb()->LastErrorValue;
+    value = TlsGetValue(TlsIndex);
+    NtCurrentTeb()->LastErrorValue = lastError;
+
+    return value;
+}
+
 #ifdef DEBUG
 #define PHLIB_INC_STATISTIC(Name) (_InterlockedIncrement(&PhLibStatisticsBlock.Name))
 #else
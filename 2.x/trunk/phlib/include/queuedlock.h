@@ -90,6 +90,20 @@ PhfReleaseQueuedLockShared(
     _Inout_ PPH_QUEUED_LOCK QueuedLock
     );
 
+PHLIBAPI
+VOID
+FASTCALL
+PhfAcquireQueuedLockExclusiveInstrumented(
+    _Inout_ PPH_QUEUED_LOCK QueuedLock
+    );
+
+PHLIBAPI
+VOID
+FASTCALL
+PhfAcquireQueuedLockSharedInstrumented(
+    _Inout_ PPH_QUEUED_LOCK QueuedLock
+    );
+
 PHLIBAPI
 VOID
 FASTCALL
@@ -178,6 +192,51 @@ PhfWaitForWakeEvent(
     _In_opt_ PLARGE_INTEGER Timeout
     );
 
+// Instrumentation
+
+// Define PH_QUEUED_LOCK_INSTRUMENTATION when compiling a project to record
+// statistics for every queued lock acquired by that project's code. Each
+// lock address and call site pair gets its own record.
+
+#define PH_QUEUED_LOCK_WAIT_HISTOGRAM_BUCKETS 16
+
+typedef struct _PH_QUEUED_LOCK_SITE_STATISTICS
+{
+    PVOID Lock;
+    /** The return address of the acquire call. */
+    PVOID CallSite;
+    ULONG ExclusiveAcquires;
+    ULONG SharedAcquires;
+    /** The number of acquires which could not take the lock immediately. */
+    ULONG ContendedAcquires;
+    /** The current adaptive spin count for the lock. */
+    ULONG SpinCount;
+    /** The total time spent waiting by contended acquires, in microseconds. */
+    ULONG64 TotalWaitTime;
+    /**
+     * Contended acquires by wait time. Bucket 0 counts waits shorter than
+     * 1 microsecond, bucket i counts waits of 2^(i-1) to 2^i microseconds and
+     * the last bucket counts all longer waits.
+     */
+    ULONG WaitHistogram[PH_QUEUED_LOCK_WAIT_HISTOGRAM_BUCKETS];
+} PH_QUEUED_LOCK_SITE_STATISTICS, *PPH_QUEUED_LOCK_SITE_STATISTICS;
+
+PHLIBAPI
+ULONG
+NTAPI
+PhQueryQueuedLockStatistics(
+    _Out_writes_opt_(Count) PPH_QUEUED_LOCK_SITE_STATISTICS Buffer,
+    _In_ ULONG Count,
+    _Out_opt_ PULONG NumberOfDroppedAcquires
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhResetQueuedLockStatistics(
+    VOID
+    );
+
 // Inline functions
 
 _Acquires_exclusive_lock_(*QueuedLock)
@@ -185,11 +244,15 @@ FORCEINLINE VOID PhAcquireQueuedLockExclusive(
     _Inout_ PPH_QUEUED_LOCK QueuedLock
     )
 {
+#ifdef PH_QUEUED_LOCK_INSTRUMENTATION
+    PhfAcquireQueuedLockExclusiveInstrumented(QueuedLock);
+#else
     if (_InterlockedBitTestAndSetPointer((PLONG_PTR)&QueuedLock->Value, PH_QUEUED_LOCK_OWNED_SHIFT))
     {
         // Owned bit was already set. Slow path.
         PhfAcquireQueuedLockExclusive(QueuedLock);
     }
+#endif
 }
 
 _Acquires_shared_lock_(*QueuedLock)
@@ -197,6 +260,9 @@ FORCEINLINE VOID PhAcquireQueuedLockShared(
     _Inout_ PPH_QUEUED_LOCK QueuedLock
     )
 {
+#ifdef PH_QUEUED_LOCK_INSTRUMENTATION
+    PhfAcquireQueuedLockSharedInstrumented(QueuedLock);
+#else
     if ((ULONG_PTR)_InterlockedCompareExchangePointer(
         (PVOID *)&QueuedLock->Value,
         (PVOID)(PH_QUEUED_LOCK_OWNED | PH_QUEUED_LOCK_SHARED_INC),
@@ -205,6 +271,7 @@ FORCEINLINE VOID PhAcquireQueuedLockShared(
     {
         PhfAcquireQueuedLockShared(QueuedLock);
     }
+#endif
 }
 
 _When_(return != 0, _Acquires_exclusive_lock_(*QueuedLock))
@@ -34,7 +34,8 @@ extern "C" {
 
 // Object type flags
 #define PH_OBJECT_TYPE_USE_FREE_LIST 0x00000001
-#define PH_OBJECT_TYPE_VALID_FLAGS 0x00000001
+#define PH_OBJECT_TYPE_BIASED_REF_COUNT 0x00000002
+#define PH_OBJECT_TYPE_VALID_FLAGS 0x00000003
 
 // Object type callbacks
 
@@ -29,6 +29,61 @@
 #define PH_OBJECT_FROM_SMALL_FREE_LIST 0x1
 /** The object was allocated from the type free list. */
 #define PH_OBJECT_FROM_TYPE_FREE_LIST 0x2
+/** The object has a biased reference count and is preceded by a
+ * PH_OBJECT_BIAS structure. */
+#define PH_OBJECT_BIASED_REF_COUNT 0x8
+
+// Biased reference counts
+//
+// For objects with a biased reference count, the owner thread (the thread
+// that created the object) counts its references in the PH_OBJECT_BIAS
+// structure without using interlocked operations. Other threads use
+// interlocked operations on RefCount, which is encoded as follows:
+//
+// Bit 0: The owner has merged its references into RefCount, so all threads
+//   now use interlocked operations.
+// Bit 1: The object is in the merge queue of the owner.
+// Bits 2-31: The shared reference count. This is negative when other threads
+//   have released references that were taken by the owner.
+//
+// When the shared count becomes negative, the object is queued to its owner,
+// which merges it when its auto-dereference pool is next drained. The object
+// is freed when the shared count of a merged object reaches 0.
+
+#define PH_OBJECT_BIAS_MERGED 0x1
+#define PH_OBJECT_BIAS_QUEUED 0x2
+#define PH_OBJECT_BIAS_SHIFT 2
+#define PH_OBJECT_BIAS_ONE (1 << PH_OBJECT_BIAS_SHIFT)
+
+/**
+ * Per-thread state for threads that own objects with a biased reference
+ * count.
+ */
+typedef struct _PH_OBJECT_BIAS_OWNER
+{
+    /** Objects which need to be merged by the owner. */
+    SLIST_HEADER MergeListHead;
+    HANDLE ThreadId;
+    /** One reference for the owner thread, plus one for each object. */
+    LONG RefCount;
+    /** Whether the owner thread has stopped draining its merge queue. */
+    LONG Retired;
+} PH_OBJECT_BIAS_OWNER, *PPH_OBJECT_BIAS_OWNER;
+
+typedef struct DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) _PH_OBJECT_BIAS
+{
+    SLIST_ENTRY MergeListEntry;
+    /** The owner of the object, or NULL if the object was created by a thread
+     * without an auto-dereference pool. */
+    PPH_OBJECT_BIAS_OWNER Owner;
+    /** The number of references held by the owner thread. */
+    LONG BiasedCount;
+} PH_OBJECT_BIAS, *PPH_OBJECT_BIAS;
+
+#define PhpObjectBiasFromObjectHeader(ObjectHeader) \
+    ((PPH_OBJECT_BIAS)((PCHAR)(ObjectHeader) - sizeof(PH_OBJECT_BIAS)))
+#define PhpObjectHeaderFromObjectBias(Bias) \
+    ((struct _PH_OBJECT_HEADER *)((PCHAR)(Bias) + sizeof(PH_OBJECT_BIAS)))
 
 /**
  * The object header contains object manager information
@@ -131,6 +186,35 @@ typedef struct _PH_OBJECT_TYPE
     PH_FREE_LIST FreeList;
 } PH_OBJECT_TYPE, *PPH_OBJECT_TYPE;
 
+/**
+ * Gets the reference count of an object.
+ *
+ * \param ObjectHeader A pointer to the object header of an object.
+ *
+ * \remarks For objects with a biased reference count, the result is
+ * only an estimate unless it is called by the owner thread.
+ */
+FORCEINLINE
+LONG
+PhpGetObjectRefCount(
+    _In_ PPH_OBJECT_HEADER ObjectHeader
+    )
+{
+    LONG refCount;
+
+    refCount = ObjectHeader->RefCount;
+
+    if (ObjectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        if (refCount & PH_OBJECT_BIAS_MERGED)
+            return refCount >> PH_OBJECT_BIAS_SHIFT;
+        else
+            return (refCount >> PH_OBJECT_BIAS_SHIFT) + PhpObjectBiasFromObjectHeader(ObjectHeader)->BiasedCount;
+    }
+
+    return refCount;
+}
+
 /**
  * Increments a reference count, but will never increment
  * from 0 to 1.
@@ -162,6 +246,28 @@ VOID PhpDeferDeleteObject(
     _In_ PPH_OBJECT_HEADER ObjectHeader
     );
 
+VOID PhpInitializeObjectBias(
+    _In_ PPH_OBJECT_HEADER ObjectHeader
+    );
+
+VOID PhpReferenceBiasedObject(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ LONG RefCount
+    );
+
+BOOLEAN PhpReferenceBiasedObjectSafe(
+    _In_ PPH_OBJECT_HEADER ObjectHeader
+    );
+
+BOOLEAN PhpDereferenceBiasedObject(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ LONG RefCount
+    );
+
+VOID PhpDrainObjectBiasOwner(
+    _In_ PPH_OBJECT_BIAS_OWNER Owner
+    );
+
 NTSTATUS PhpDeferDeleteObjectRoutine(
     _In_ PVOID Parameter
     );
@@ -0,0 +1,114 @@
+#ifndef _PH_RMLOCK_H
+#define _PH_RMLOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The maximum number of reader slots in a read-mostly lock. */
+#define PH_READ_MOSTLY_LOCK_MAXIMUM_SLOTS 64
+
+typedef struct _PH_READ_MOSTLY_LOCK_SLOT
+{
+    volatile LONG Readers;
+    UCHAR Reserved[64 - sizeof(LONG)];
+} PH_READ_MOSTLY_LOCK_SLOT, *PPH_READ_MOSTLY_LOCK_SLOT;
+
+/**
+ * A read-mostly lock is a reader-writer lock for data which is read
+ * much more often than it is written.
+ *
+ * Shared acquires only modify a reader count for the current processor,
+ * so readers on different processors do not contend on a single cache
+ * line. Exclusive acquires are more expensive because the writer must
+ * wait for the reader counts to drain.
+ */
+typedef struct _PH_READ_MOSTLY_LOCK
+{
+    /** Serializes writers, and readers which find a writer present. */
+    PH_QUEUED_LOCK Lock;
+    /** Non-zero while a writer owns or is draining the lock. */
+    volatile ULONG Writer;
+    /** The reader count used before the reader slots are allocated. */
+    volatile LONG Readers;
+    /** Per-processor reader slots, allocated on the first shared acquire. */
+    PPH_READ_MOSTLY_LOCK_SLOT Slots;
+} PH_READ_MOSTLY_LOCK, *PPH_READ_MOSTLY_LOCK;
+
+#define PH_READ_MOSTLY_LOCK_INIT { PH_QUEUED_LOCK_INIT, 0, 0, NULL }
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeReadMostlyLock(
+    _Out_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteReadMostlyLock(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhAcquireReadMostlyLockExclusive PhfAcquireReadMostlyLockExclusive
+_May_raise_
+_Acquires_exclusive_lock_(*ReadMostlyLock)
+PHLIBAPI
+VOID
+FASTCALL
+PhfAcquireReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhAcquireReadMostlyLockShared PhfAcquireReadMostlyLockShared
+_May_raise_
+_Acquires_shared_lock_(*ReadMostlyLock)
+PHLIBAPI
+VOID
+FASTCALL
+PhfAcquireReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhReleaseReadMostlyLockExclusive PhfReleaseReadMostlyLockExclusive
+_Releases_exclusive_lock_(*ReadMostlyLock)
+PHLIBAPI
+VOID
+FASTCALL
+PhfReleaseReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhReleaseReadMostlyLockShared PhfReleaseReadMostlyLockShared
+_Releases_shared_lock_(*ReadMostlyLock)
+PHLIBAPI
+VOID
+FASTCALL
+PhfReleaseReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhTryAcquireReadMostlyLockExclusive PhfTryAcquireReadMostlyLockExclusive
+_When_(return != 0, _Acquires_exclusive_lock_(*ReadMostlyLock))
+PHLIBAPI
+BOOLEAN
+FASTCALL
+PhfTryAcquireReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#define PhTryAcquireReadMostlyLockShared PhfTryAcquireReadMostlyLockShared
+_When_(return != 0, _Acquires_shared_lock_(*ReadMostlyLock))
+PHLIBAPI
+BOOLEAN
+FASTCALL
+PhfTryAcquireReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -15,7 +15,7 @@ typedef struct _PH_SYMBOL_PROVIDER
     BOOLEAN IsRegistered;
 
     PH_INITONCE InitOnce;
-    PH_AVL_TREE ModulesSet;
+    PH_BTREE ModulesSet;
     PH_CALLBACK EventCallback;
 } PH_SYMBOL_PROVIDER, *PPH_SYMBOL_PROVIDER;
 
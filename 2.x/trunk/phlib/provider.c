@@ -41,10 +41,29 @@
  * when boosted, always run on the same provider thread. The other option
  * would be to have the boosting thread run the provider function
  * directly, which would involve unnecessary blocking and synchronization.
+ *
+ * Each provider can also have its own interval, in which case it is
+ * only run by the periodic runs which occur at least that long after
+ * its previous run. A boosted run counts as a normal run, so a boost
+ * shortly before a periodic run replaces that run instead of causing
+ * the provider to be run twice. Providers which have an idle interval
+ * back off exponentially up to that interval while they have no
+ * consumers; windows which display the provider's data register
+ * themselves as consumers while they are visible.
+ *
+ * A provider thread cannot interrupt a provider function, so a
+ * provider which blocks (e.g. waiting for a hung service control
+ * manager) delays every other provider on the same thread. Providers
+ * which take longer than their budget are therefore run less often,
+ * in proportion to the time they took.
  */
 
 #include <ph.h>
 
+// Overrunning providers are delayed by this multiple of their run time.
+#define PH_PROVIDER_OVERRUN_PENALTY 4
+#define PH_PROVIDER_MAXIMUM_PENALTY (60 * 1000)
+
 #ifdef DEBUG
 PPH_LIST PhDbgProviderList;
 PH_QUEUED_LOCK PhDbgProviderListLock = PH_QUEUED_LOCK_INIT;
@@ -61,6 +80,8 @@ VOID PhInitializeProviderThread(
     _In_ ULONG Interval
     )
 {
+    LARGE_INTEGER counter;
+
     ProviderThread->ThreadHandle = NULL;
     ProviderThread->TimerHandle = NULL;
     ProviderThread->Interval = Interval;
@@ -69,6 +90,8 @@ VOID PhInitializeProviderThread(
     PhInitializeQueuedLock(&ProviderThread->Lock);
     InitializeListHead(&ProviderThread->ListHead);
     ProviderThread->BoostCount = 0;
+    ProviderThread->CurrentRegistration = NULL;
+    NtQueryPerformanceCounter(&counter, &ProviderThread->Frequency);
 
 #ifdef DEBUG
     PhAcquireQueuedLockExclusive(&PhDbgProviderListLock);
@@ -101,6 +124,56 @@ VOID PhDeleteProviderThread(
 #endif
 }
 
+static VOID PhpScheduleProvider(
+    _In_ PPH_PROVIDER_THREAD ProviderThread,
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG64 StartTime,
+    _In_ ULONG RunTime
+    )
+{
+    ULONG interval;
+    ULONG runTimeMs;
+    ULONG penalty;
+
+    Registration->RunTimes[Registration->RunTimesIndex] = RunTime;
+    Registration->RunTimesIndex = (Registration->RunTimesIndex + 1) % PH_PROVIDER_RUN_HISTORY_SIZE;
+
+    if (Registration->RunTimesCount < PH_PROVIDER_RUN_HISTORY_SIZE)
+        Registration->RunTimesCount++;
+
+    if (Registration->IdleInterval != 0 && Registration->Consumers == 0)
+    {
+        // Nobody is looking at the results. Back off exponentially.
+        interval = max(Registration->Interval, ProviderThread->Interval);
+        interval = max(Registration->CurrentInterval * 2, interval);
+
+        if (interval > Registration->IdleInterval)
+            interval = Registration->IdleInterval;
+    }
+    else
+    {
+        interval = Registration->Interval;
+    }
+
+    Registration->CurrentInterval = interval;
+    Registration->NextRunTime = StartTime + interval;
+
+    runTimeMs = RunTime / 1000;
+
+    if (Registration->Budget != 0 && runTimeMs > Registration->Budget)
+    {
+        Registration->Overruns++;
+
+        penalty = runTimeMs * PH_PROVIDER_OVERRUN_PENALTY;
+
+        if (penalty > PH_PROVIDER_MAXIMUM_PENALTY)
+            penalty = PH_PROVIDER_MAXIMUM_PENALTY;
+
+        if (penalty > interval)
+            Registration->NextRunTime = StartTime + runTimeMs + penalty;
+    }
+}
+
 NTSTATUS NTAPI PhpProviderThreadStart(
     _In_ PVOID Parameter
     )
@@ -112,6 +185,15 @@ NTSTATUS NTAPI PhpProviderThreadStart(
     PPH_PROVIDER_FUNCTION providerFunction;
     PVOID object;
     LIST_ENTRY tempListHead;
+    PH_AUTO_POOL autoPool;
+    ULONG64 tickTime;
+    ULONG64 startTime;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+
+    // The auto-dereference pool also makes this thread the owner of objects with a biased
+    // reference count that providers create, e.g. process items.
+    PhInitializeAutoPool(&autoPool);
 
     while (providerThread->State != ProviderThreadStopping)
     {
@@ -130,6 +212,8 @@ NTSTATUS NTAPI PhpProviderThreadStart(
 
         PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
+        tickTime = NtGetTickCount64();
+
         // Main loop.
 
         // We check the status variable for STATUS_ALERTED, which
@@ -166,6 +250,11 @@ NTSTATUS NTAPI PhpProviderThreadStart(
             {
                 if (!registration->Enabled || registration->Unregistering)
                     continue;
+
+                // Skip providers which aren't due yet. The timer and the provider runs drift
+                // apart slightly, so allow half a period of slack.
+                if (registration->NextRunTime > tickTime + providerThread->Interval / 2)
+                    continue;
             }
             else
             {
@@ -197,11 +286,28 @@ NTSTATUS NTAPI PhpProviderThreadStart(
                 PhReferenceObject(object);
 
             registration->RunId++;
+            providerThread->CurrentRegistration = registration;
 
             PhReleaseQueuedLockExclusive(&providerThread->Lock);
+            startTime = NtGetTickCount64();
+            NtQueryPerformanceCounter(&startCounter, NULL);
             providerFunction(object);
+            NtQueryPerformanceCounter(&endCounter, NULL);
             PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
+            // If the provider was unregistered while it was running, the registration may
+            // already have been freed.
+            if (providerThread->CurrentRegistration == registration)
+            {
+                PhpScheduleProvider(
+                    providerThread,
+                    registration,
+                    startTime,
+                    (ULONG)((endCounter.QuadPart - startCounter.QuadPart) * 1000000 / providerThread->Frequency.QuadPart)
+                    );
+                providerThread->CurrentRegistration = NULL;
+            }
+
             if (object)
                 PhDereferenceObject(object);
         }
@@ -224,6 +330,8 @@ NTSTATUS NTAPI PhpProviderThreadStart(
 
         PhReleaseQueuedLockExclusive(&providerThread->Lock);
 
+        PhDrainAutoPool(&autoPool);
+
         // Perform an alertable wait so we can be woken up by
         // someone telling us to boost providers, or to terminate.
         status = NtWaitForSingleObject(
@@ -233,6 +341,8 @@ NTSTATUS NTAPI PhpProviderThreadStart(
             );
     }
 
+    PhDeleteAutoPool(&autoPool);
+
     return STATUS_SUCCESS;
 }
 
@@ -339,6 +449,16 @@ VOID PhRegisterProvider(
     Registration->Enabled = FALSE;
     Registration->Unregistering = FALSE;
     Registration->Boosting = FALSE;
+    Registration->Spare = FALSE;
+    Registration->Interval = 0;
+    Registration->IdleInterval = 0;
+    Registration->Budget = 0;
+    Registration->CurrentInterval = 0;
+    Registration->NextRunTime = 0;
+    Registration->Consumers = 0;
+    Registration->Overruns = 0;
+    Registration->RunTimesIndex = 0;
+    Registration->RunTimesCount = 0;
 
     if (Object)
         PhReferenceObject(Object);
@@ -383,6 +503,11 @@ VOID PhUnregisterProvider(
     if (Registration->Boosting)
         providerThread->BoostCount--;
 
+    // Stop the provider thread from touching the registration if the
+    // provider is currently running.
+    if (providerThread->CurrentRegistration == Registration)
+        providerThread->CurrentRegistration = NULL;
+
     // The user-supplied object must be dereferenced
     // while the mutex is held.
     if (Registration->Object)
@@ -400,12 +525,14 @@ VOID PhUnregisterProvider(
  * future run.
  *
  * \return TRUE if the operation was successful; FALSE if
- * the provider is being unregistered, the provider is already
- * being boosted, or the provider thread is not running.
+ * the provider is being unregistered or the provider thread is
+ * not running.
  *
  * \remarks Boosted providers will be run immediately, ignoring
- * the run interval. Boosting will not however affect the normal
- * runs.
+ * the run interval. If the provider is already being boosted,
+ * the requests are combined and \a FutureRunId receives the run
+ * ID of the pending run. A boosted run counts as a normal run
+ * for providers which have their own interval.
  */
 BOOLEAN PhBoostProvider(
     _Inout_ PPH_PROVIDER_REGISTRATION Registration,
@@ -425,14 +552,25 @@ BOOLEAN PhBoostProvider(
 
     PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
-    // Abort if the provider is already being boosted or the
-    // provider thread is stopping/stopped.
-    if (Registration->Boosting || providerThread->State != ProviderThreadRunning)
+    // Abort if the provider thread is stopping/stopped.
+    if (providerThread->State != ProviderThreadRunning)
     {
         PhReleaseQueuedLockExclusive(&providerThread->Lock);
         return FALSE;
     }
 
+    // Coalesce with the pending boost. There is no need to wake the thread again.
+    if (Registration->Boosting)
+    {
+        futureRunId = Registration->RunId + 1;
+        PhReleaseQueuedLockExclusive(&providerThread->Lock);
+
+        if (FutureRunId)
+            *FutureRunId = futureRunId;
+
+        return TRUE;
+    }
+
     RemoveEntryList(&Registration->ListEntry);
     InsertHeadList(&providerThread->ListHead, &Registration->ListEntry);
 
@@ -493,3 +631,124 @@ VOID PhSetEnabledProvider(
 {
     Registration->Enabled = Enabled;
 }
+
+/**
+ * Sets the scheduling parameters of a provider.
+ *
+ * \param Registration A pointer to the registration object for
+ * a provider.
+ * \param Interval The minimum time between periodic runs, in
+ * milliseconds. Specify 0 to run the provider every time the
+ * provider thread runs.
+ * \param IdleInterval The maximum time between periodic runs while
+ * the provider has no consumers, in milliseconds. Specify 0 to
+ * disable back-off.
+ * \param Budget The maximum expected run time of the provider, in
+ * milliseconds. Providers which take longer are run less often.
+ * Specify 0 for no budget.
+ */
+VOID PhSetIntervalProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG IdleInterval,
+    _In_ ULONG Budget
+    )
+{
+    PPH_PROVIDER_THREAD providerThread;
+
+    providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockExclusive(&providerThread->Lock);
+    Registration->Interval = Interval;
+    Registration->IdleInterval = IdleInterval;
+    Registration->Budget = Budget;
+    Registration->CurrentInterval = Interval;
+    Registration->NextRunTime = 0;
+    PhReleaseQueuedLockExclusive(&providerThread->Lock);
+}
+
+/**
+ * Registers a consumer of a provider's results.
+ *
+ * \param Registration A pointer to the registration object for
+ * a provider.
+ *
+ * \remarks A provider with an idle interval backs off while it has
+ * no consumers. When the first consumer is added, the provider
+ * returns to its normal interval and is boosted if it had backed off.
+ */
+VOID PhAddConsumerProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    )
+{
+    PPH_PROVIDER_THREAD providerThread;
+    BOOLEAN boost;
+
+    if (_InterlockedIncrement(&Registration->Consumers) != 1 || Registration->IdleInterval == 0)
+        return;
+
+    providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockExclusive(&providerThread->Lock);
+    boost = Registration->Enabled && Registration->CurrentInterval > Registration->Interval;
+    Registration->CurrentInterval = Registration->Interval;
+    Registration->NextRunTime = 0;
+    PhReleaseQueuedLockExclusive(&providerThread->Lock);
+
+    if (boost)
+        PhBoostProvider(Registration, NULL);
+}
+
+/**
+ * Unregisters a consumer of a provider's results.
+ *
+ * \param Registration A pointer to the registration object for
+ * a provider.
+ */
+VOID PhRemoveConsumerProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    )
+{
+    _InterlockedDecrement(&Registration->Consumers);
+}
+
+/**
+ * Gets the durations of the most recent runs of a provider.
+ *
+ * \param Registration A pointer to the registration object for
+ * a provider.
+ * \param RunTimes A buffer which receives the run times, in
+ * microseconds. The most recent run is stored first.
+ * \param Count The number of elements in \a RunTimes.
+ *
+ * \return The number of run times copied.
+ */
+ULONG PhGetRunTimesProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_writes_to_(Count, return) PULONG RunTimes,
+    _In_ ULONG Count
+    )
+{
+    PPH_PROVIDER_THREAD providerThread;
+    ULONG index;
+    ULONG i;
+
+    providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockShared(&providerThread->Lock);
+
+    if (Count > Registration->RunTimesCount)
+        Count = Registration->RunTimesCount;
+
+    index = Registration->RunTimesIndex;
+
+    for (i = 0; i < Count; i++)
+    {
+        index = (index + PH_PROVIDER_RUN_HISTORY_SIZE - 1) % PH_PROVIDER_RUN_HISTORY_SIZE;
+        RunTimes[i] = Registration->RunTimes[index];
+    }
+
+    PhReleaseQueuedLockShared(&providerThread->Lock);
+
+    return Count;
+}
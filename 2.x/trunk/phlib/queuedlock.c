@@ -73,7 +73,12 @@
  *
  * Blocking is implemented through a process-wide keyed event.
  * A spin count is also used before blocking on the keyed
- * event.
+ * event. For lock acquires the spin count adapts to each lock:
+ * the number of spins a waiter needed before it was woken
+ * tells us how long the lock was still held, so locks with
+ * short hold times spin for about that long and locks which
+ * are held for longer than we are willing to spin block
+ * almost immediately.
  *
  * Queued locks can act as condition variables, with
  * wait, pulse and pulse all support. Waiters are released
@@ -104,13 +109,40 @@ VOID FASTCALL PhpfWakeQueuedLockEx(
     _In_ BOOLEAN WakeAll
     );
 
+// Adaptive spinning
+
+#define PH_QUEUED_LOCK_SPIN_SLOTS_SHIFT 6
+#define PH_QUEUED_LOCK_SPIN_SLOTS (1 << PH_QUEUED_LOCK_SPIN_SLOTS_SHIFT)
+#define PH_QUEUED_LOCK_MINIMUM_SPIN_COUNT 64
+/** The number of consecutive failed spins after which a spin slot is reset. */
+#define PH_QUEUED_LOCK_SPIN_PROBE_INTERVAL 32
+
+typedef struct _PH_QUEUED_LOCK_SPIN_SLOT
+{
+    ULONG SpinCount;
+    ULONG Failures;
+} PH_QUEUED_LOCK_SPIN_SLOT, *PPH_QUEUED_LOCK_SPIN_SLOT;
+
+// Instrumentation
+
+#define PH_QUEUED_LOCK_MAXIMUM_SITES 1024 // must be a power of two
+
 static HANDLE PhQueuedLockKeyedEventHandle;
 static ULONG PhQueuedLockSpinCount = 2000;
+static ULONG PhQueuedLockMaximumSpinCount = 8000;
+static PH_QUEUED_LOCK_SPIN_SLOT PhQueuedLockSpinSlots[PH_QUEUED_LOCK_SPIN_SLOTS];
+
+static PPH_QUEUED_LOCK_SITE_STATISTICS PhQueuedLockSites = NULL;
+static ULONG PhQueuedLockDroppedAcquires = 0;
+static ULONG64 PhQueuedLockCounterFrequency;
 
 BOOLEAN PhQueuedLockInitialization(
     VOID
     )
 {
+    LARGE_INTEGER frequency;
+    ULONG i;
+
     if (!NT_SUCCESS(NtCreateKeyedEvent(
         &PhQueuedLockKeyedEventHandle,
         KEYEDEVENT_ALL_ACCESS,
@@ -124,9 +156,29 @@ BOOLEAN PhQueuedLockInitialization(
     else
         PhQueuedLockSpinCount = 0;
 
+    PhQueuedLockMaximumSpinCount = PhQueuedLockSpinCount * 4;
+
+    for (i = 0; i < PH_QUEUED_LOCK_SPIN_SLOTS; i++)
+        PhQueuedLockSpinSlots[i].SpinCount = PhQueuedLockSpinCount;
+
+    NtQueryPerformanceCounter(&frequency, &frequency);
+    PhQueuedLockCounterFrequency = frequency.QuadPart;
+
     return TRUE;
 }
 
+FORCEINLINE PPH_QUEUED_LOCK_SPIN_SLOT PhpGetQueuedLockSpinSlot(
+    _In_ PVOID Lock
+    )
+{
+    ULONG hash;
+
+    // Locks are at least pointer-aligned, so discard the low bits.
+    hash = (ULONG)((ULONG_PTR)Lock >> 3) * 0x9e3779b1;
+
+    return &PhQueuedLockSpinSlots[hash >> (32 - PH_QUEUED_LOCK_SPIN_SLOTS_SHIFT)];
+}
+
 /**
  * Pushes a wait block onto a queued lock's waiters list.
  *
@@ -341,6 +393,80 @@ _May_raise_ FORCEINLINE NTSTATUS PhpBlockOnQueuedWaitBlock(
     return status;
 }
 
+/**
+ * Spins until a wait block for a lock acquire is unblocked.
+ *
+ * \param Lock The lock being acquired.
+ * \param WaitBlock A wait block.
+ *
+ * \return TRUE if the wait block was unblocked while spinning,
+ * otherwise FALSE. If the function returns FALSE, call
+ * PhpBlockOnQueuedWaitBlock() without spinning.
+ *
+ * \remarks The spin count is chosen per lock (or rather, per
+ * group of locks which hash to the same slot) based on how long
+ * previous waiters had to spin.
+ */
+FORCEINLINE BOOLEAN PhpSpinOnQueuedWaitBlock(
+    _In_ PVOID Lock,
+    _Inout_ PPH_QUEUED_WAIT_BLOCK WaitBlock
+    )
+{
+    PPH_QUEUED_LOCK_SPIN_SLOT slot;
+    ULONG spinCount;
+    ULONG target;
+    ULONG i;
+
+    if (PhQueuedLockSpinCount == 0)
+        return FALSE;
+
+    PHLIB_INC_STATISTIC(QlBlockSpins);
+
+    // The slot is updated without synchronization. Lost updates only affect
+    // the quality of the estimate.
+    slot = PhpGetQueuedLockSpinSlot(Lock);
+    spinCount = *(volatile ULONG *)&slot->SpinCount;
+
+    for (i = 0; i < spinCount; i++)
+    {
+        if (!(*(volatile ULONG *)&WaitBlock->Flags & PH_QUEUED_WAITER_SPINNING))
+        {
+            PHLIB_INC_STATISTIC(QlBlockSpinsSucceeded);
+
+            // The lock was handed to us after i spins, which approximates the
+            // remaining hold time. Move the spin count towards twice that.
+            target = i * 2;
+
+            if (target < PH_QUEUED_LOCK_MINIMUM_SPIN_COUNT)
+                target = PH_QUEUED_LOCK_MINIMUM_SPIN_COUNT;
+            if (target > PhQueuedLockMaximumSpinCount)
+                target = PhQueuedLockMaximumSpinCount;
+
+            slot->SpinCount = (ULONG)((LONG)spinCount + ((LONG)target - (LONG)spinCount) / 8);
+            slot->Failures = 0;
+
+            return TRUE;
+        }
+
+        YieldProcessor();
+    }
+
+    // The lock was held for longer than we were willing to spin. Spin less
+    // next time, but periodically go back to the default spin count in case
+    // the hold times have become shorter.
+    if (++slot->Failures >= PH_QUEUED_LOCK_SPIN_PROBE_INTERVAL)
+    {
+        slot->SpinCount = PhQueuedLockSpinCount;
+        slot->Failures = 0;
+    }
+    else if (spinCount > PH_QUEUED_LOCK_MINIMUM_SPIN_COUNT)
+    {
+        slot->SpinCount = spinCount - (spinCount - PH_QUEUED_LOCK_MINIMUM_SPIN_COUNT) / 4;
+    }
+
+    return FALSE;
+}
+
 /**
  * Unblocks a wait block.
  *
@@ -714,7 +840,9 @@ VOID FASTCALL PhfAcquireQueuedLockExclusive(
                     PhpfOptimizeQueuedLockList(QueuedLock, currentValue);
 
                 PHLIB_INC_STATISTIC(QlAcquireExclusiveBlocks);
-                PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+
+                if (!PhpSpinOnQueuedWaitBlock(QueuedLock, &waitBlock))
+                    PhpBlockOnQueuedWaitBlock(&waitBlock, FALSE, NULL);
             }
         }
 
@@ -776,7 +904,9 @@ VOID FASTCALL PhfAcquireQueuedLockShared(
                     PhpfOptimizeQueuedLockList(QueuedLock, currentValue);
 
                 PHLIB_INC_STATISTIC(QlAcquireSharedBlocks);
-                PhpBlockOnQueuedWaitBlock(&waitBlock, TRUE, NULL);
+
+                if (!PhpSpinOnQueuedWaitBlock(QueuedLock, &waitBlock))
+                    PhpBlockOnQueuedWaitBlock(&waitBlock, FALSE, NULL);
             }
         }
 
@@ -784,6 +914,278 @@ VOID FASTCALL PhfAcquireQueuedLockShared(
     }
 }
 
+/**
+ * Finds or creates the statistics record for a lock and call site.
+ *
+ * \param Lock The address of the lock.
+ * \param CallSite The return address of the acquire call.
+ *
+ * \return The statistics record, or NULL if the table is full or
+ * phlib has not been initialized.
+ */
+static PPH_QUEUED_LOCK_SITE_STATISTICS PhpLookupQueuedLockSite(
+    _In_ PVOID Lock,
+    _In_ PVOID CallSite
+    )
+{
+    PPH_QUEUED_LOCK_SITE_STATISTICS sites;
+    PPH_QUEUED_LOCK_SITE_STATISTICS site;
+    PVOID lock;
+    PVOID callSite;
+    ULONG hash;
+    ULONG i;
+
+    sites = PhQueuedLockSites;
+
+    if (!sites)
+    {
+        PPH_QUEUED_LOCK_SITE_STATISTICS newSites;
+
+        // We can't use any queued locks here.
+
+        if (!PhHeapHandle)
+            return NULL;
+
+        newSites = PhAllocate(sizeof(PH_QUEUED_LOCK_SITE_STATISTICS) * PH_QUEUED_LOCK_MAXIMUM_SITES);
+        memset(newSites, 0, sizeof(PH_QUEUED_LOCK_SITE_STATISTICS) * PH_QUEUED_LOCK_MAXIMUM_SITES);
+
+        if (sites = _InterlockedCompareExchangePointer((PVOID *)&PhQueuedLockSites, newSites, NULL))
+            PhFree(newSites);
+        else
+            sites = newSites;
+    }
+
+    hash = (ULONG)(((ULONG_PTR)Lock >> 3) ^ ((ULONG_PTR)CallSite * 0x9e3779b1));
+
+RestartLookup:
+    for (i = 0; i < PH_QUEUED_LOCK_MAXIMUM_SITES; i++)
+    {
+        site = &sites[(hash + i) & (PH_QUEUED_LOCK_MAXIMUM_SITES - 1)];
+        lock = *(PVOID volatile *)&site->Lock;
+
+        if (!lock)
+        {
+            // Claim the record. The call site is filled in afterwards, so other threads
+            // wait for it below.
+            if (!(lock = _InterlockedCompareExchangePointer(&site->Lock, Lock, NULL)))
+            {
+                site->CallSite = CallSite;
+                return site;
+            }
+        }
+
+        if (lock == Lock)
+        {
+            while (!(callSite = *(PVOID volatile *)&site->CallSite))
+            {
+                // The record may have been cleared by PhResetQueuedLockStatistics.
+                if (*(PVOID volatile *)&site->Lock != Lock)
+                    goto RestartLookup;
+
+                YieldProcessor();
+            }
+
+            if (callSite == CallSite)
+                return site;
+        }
+    }
+
+    _InterlockedIncrement((PLONG)&PhQueuedLockDroppedAcquires);
+
+    return NULL;
+}
+
+static VOID PhpRecordQueuedLockAcquire(
+    _In_ PVOID Lock,
+    _In_ PVOID CallSite,
+    _In_ BOOLEAN Exclusive,
+    _In_ BOOLEAN Contended,
+    _In_ ULONG64 WaitTicks
+    )
+{
+    PPH_QUEUED_LOCK_SITE_STATISTICS site;
+    ULONG64 waitTime;
+    ULONG bucket;
+
+    if (!(site = PhpLookupQueuedLockSite(Lock, CallSite)))
+        return;
+
+    if (Exclusive)
+        _InterlockedIncrement((PLONG)&site->ExclusiveAcquires);
+    else
+        _InterlockedIncrement((PLONG)&site->SharedAcquires);
+
+    if (Contended)
+    {
+        _InterlockedIncrement((PLONG)&site->ContendedAcquires);
+
+        waitTime = WaitTicks * 1000000 / PhQueuedLockCounterFrequency;
+        InterlockedExchangeAdd64((PLONG64)&site->TotalWaitTime, (LONG64)waitTime);
+
+        bucket = 0;
+
+        while (waitTime != 0 && bucket < PH_QUEUED_LOCK_WAIT_HISTOGRAM_BUCKETS - 1)
+        {
+            waitTime >>= 1;
+            bucket++;
+        }
+
+        _InterlockedIncrement((PLONG)&site->WaitHistogram[bucket]);
+    }
+}
+
+/**
+ * Acquires a queued lock in exclusive mode and records statistics
+ * for the lock and the call site.
+ *
+ * \param QueuedLock A queued lock.
+ *
+ * \remarks This function is used in place of the inline fast path
+ * when PH_QUEUED_LOCK_INSTRUMENTATION is defined.
+ */
+VOID FASTCALL PhfAcquireQueuedLockExclusiveInstrumented(
+    _Inout_ PPH_QUEUED_LOCK QueuedLock
+    )
+{
+    PVOID callSite = _ReturnAddress();
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+
+    if (_InterlockedBitTestAndSetPointer((PLONG_PTR)&QueuedLock->Value, PH_QUEUED_LOCK_OWNED_SHIFT))
+    {
+        NtQueryPerformanceCounter(&startCounter, NULL);
+        PhfAcquireQueuedLockExclusive(QueuedLock);
+        NtQueryPerformanceCounter(&endCounter, NULL);
+
+        PhpRecordQueuedLockAcquire(QueuedLock, callSite, TRUE, TRUE, endCounter.QuadPart - startCounter.QuadPart);
+    }
+    else
+    {
+        PhpRecordQueuedLockAcquire(QueuedLock, callSite, TRUE, FALSE, 0);
+    }
+}
+
+/**
+ * Acquires a queued lock in shared mode and records statistics
+ * for the lock and the call site.
+ *
+ * \param QueuedLock A queued lock.
+ *
+ * \remarks This function is used in place of the inline fast path
+ * when PH_QUEUED_LOCK_INSTRUMENTATION is defined.
+ */
+VOID FASTCALL PhfAcquireQueuedLockSharedInstrumented(
+    _Inout_ PPH_QUEUED_LOCK QueuedLock
+    )
+{
+    PVOID callSite = _ReturnAddress();
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+
+    if ((ULONG_PTR)_InterlockedCompareExchangePointer(
+        (PVOID *)&QueuedLock->Value,
+        (PVOID)(PH_QUEUED_LOCK_OWNED | PH_QUEUED_LOCK_SHARED_INC),
+        (PVOID)0
+        ) != 0)
+    {
+        NtQueryPerformanceCounter(&startCounter, NULL);
+        PhfAcquireQueuedLockShared(QueuedLock);
+        NtQueryPerformanceCounter(&endCounter, NULL);
+
+        PhpRecordQueuedLockAcquire(QueuedLock, callSite, FALSE, TRUE, endCounter.QuadPart - startCounter.QuadPart);
+    }
+    else
+    {
+        PhpRecordQueuedLockAcquire(QueuedLock, callSite, FALSE, FALSE, 0);
+    }
+}
+
+/**
+ * Gets statistics recorded for queued locks acquired by code compiled
+ * with PH_QUEUED_LOCK_INSTRUMENTATION.
+ *
+ * \param Buffer A buffer which receives one record per lock and
+ * call site. The records are not copied atomically.
+ * \param Count The number of records \a Buffer can hold.
+ * \param NumberOfDroppedAcquires A variable which receives the number of
+ * acquires which were not recorded because the table of records was full.
+ *
+ * \return The total number of records. This may be larger than
+ * \a Count.
+ */
+ULONG NTAPI PhQueryQueuedLockStatistics(
+    _Out_writes_opt_(Count) PPH_QUEUED_LOCK_SITE_STATISTICS Buffer,
+    _In_ ULONG Count,
+    _Out_opt_ PULONG NumberOfDroppedAcquires
+    )
+{
+    PPH_QUEUED_LOCK_SITE_STATISTICS sites;
+    ULONG numberOfSites;
+    ULONG i;
+
+    if (NumberOfDroppedAcquires)
+        *NumberOfDroppedAcquires = PhQueuedLockDroppedAcquires;
+
+    if (!(sites = PhQueuedLockSites))
+        return 0;
+
+    numberOfSites = 0;
+
+    for (i = 0; i < PH_QUEUED_LOCK_MAXIMUM_SITES; i++)
+    {
+        PPH_QUEUED_LOCK_SITE_STATISTICS site = &sites[i];
+
+        if (!*(PVOID volatile *)&site->Lock || !*(PVOID volatile *)&site->CallSite)
+            continue;
+
+        if (Buffer && numberOfSites < Count)
+        {
+            memcpy(&Buffer[numberOfSites], site, sizeof(PH_QUEUED_LOCK_SITE_STATISTICS));
+            Buffer[numberOfSites].SpinCount = PhpGetQueuedLockSpinSlot(site->Lock)->SpinCount;
+        }
+
+        numberOfSites++;
+    }
+
+    return numberOfSites;
+}
+
+/**
+ * Clears the statistics recorded for queued locks, and frees every
+ * record for use by other locks and call sites.
+ *
+ * \remarks Acquires recorded while this function is running may be
+ * lost or attributed to the wrong record.
+ */
+VOID NTAPI PhResetQueuedLockStatistics(
+    VOID
+    )
+{
+    PPH_QUEUED_LOCK_SITE_STATISTICS sites;
+    ULONG i;
+
+    if (!(sites = PhQueuedLockSites))
+        return;
+
+    for (i = 0; i < PH_QUEUED_LOCK_MAXIMUM_SITES; i++)
+    {
+        PPH_QUEUED_LOCK_SITE_STATISTICS site = &sites[i];
+
+        site->ExclusiveAcquires = 0;
+        site->SharedAcquires = 0;
+        site->ContendedAcquires = 0;
+        site->TotalWaitTime = 0;
+        memset(site->WaitHistogram, 0, sizeof(site->WaitHistogram));
+
+        // Clear the call site before the lock; lookups which see the lock but not the call
+        // site check the lock again and restart.
+        site->CallSite = NULL;
+        _InterlockedExchangePointer(&site->Lock, NULL);
+    }
+
+    PhQueuedLockDroppedAcquires = 0;
+}
+
 /**
  * Releases a queued lock in exclusive mode.
  *
@@ -33,7 +33,8 @@ PPH_OBJECT_TYPE PhAllocType = NULL;
 ULONG PhObjectTypeCount = 0;
 PPH_OBJECT_TYPE PhObjectTypeTable[PH_OBJECT_TYPE_TABLE_SIZE];
 
-static ULONG PhpAutoPoolTlsIndex;
+static ULONG PhpAutoPoolTlsIndex = TLS_OUT_OF_INDEXES;
+static ULONG PhpObjectBiasOwnerTlsIndex = TLS_OUT_OF_INDEXES;
 
 #ifdef DEBUG
 LIST_ENTRY PhDbgObjectListHead;
@@ -43,6 +44,10 @@ PPH_CREATE_OBJECT_HOOK PhDbgCreateObjectHook = NULL;
 
 #define REF_STAT_UP(Name) PHLIB_INC_STATISTIC(Name)
 
+FORCEINLINE PPH_AUTO_POOL PhpGetCurrentAutoPool(
+    VOID
+    );
+
 /**
  * Initializes the object manager module.
  */
@@ -56,11 +61,24 @@ NTSTATUS PhInitializeRef(
     InitializeListHead(&PhDbgObjectListHead);
 #endif
 
+    // Reserve the TLS slots. This must be done before any objects are created because
+    // objects with a biased reference count look up the current pool.
+    PhpAutoPoolTlsIndex = TlsAlloc();
+
+    if (PhpAutoPoolTlsIndex == TLS_OUT_OF_INDEXES)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    PhpObjectBiasOwnerTlsIndex = TlsAlloc();
+
+    if (PhpObjectBiasOwnerTlsIndex == TLS_OUT_OF_INDEXES)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
     RtlInitializeSListHead(&PhObjectDeferDeleteListHead);
-    PhInitializeFreeList(
+    PhInitializeFreeListEx(
         &PhObjectSmallFreeList,
         PhAddObjectHeaderSize(PH_OBJECT_SMALL_OBJECT_SIZE),
-        PH_OBJECT_SMALL_OBJECT_COUNT
+        PH_OBJECT_SMALL_OBJECT_COUNT,
+        PH_FREE_LIST_USE_MAGAZINES
         );
 
     // Create the fundamental object type.
@@ -77,12 +95,6 @@ NTSTATUS PhInitializeRef(
     // Create the allocated memory object type.
     PhAllocType = PhCreateObjectType(L"Alloc", 0, NULL);
 
-    // Reserve a slot for the auto pool.
-    PhpAutoPoolTlsIndex = TlsAlloc();
-
-    if (PhpAutoPoolTlsIndex == TLS_OUT_OF_INDEXES)
-        return STATUS_INSUFFICIENT_RESOURCES;
-
     return STATUS_SUCCESS;
 }
 
@@ -99,7 +111,6 @@ _May_raise_ PVOID PhCreateObject(
     _In_ PPH_OBJECT_TYPE ObjectType
     )
 {
-    NTSTATUS status = STATUS_SUCCESS;
     PPH_OBJECT_HEADER objectHeader;
 
     // Allocate storage for the object. Note that this includes the object header followed by the object body.
@@ -109,10 +120,14 @@ _May_raise_ PVOID PhCreateObject(
     _InterlockedIncrement((PLONG)&ObjectType->NumberOfObjects);
 
     // Initialize the object header.
-    objectHeader->RefCount = 1;
     objectHeader->TypeIndex = ObjectType->TypeIndex;
     // objectHeader->Flags is set by PhpAllocateObject.
 
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+        PhpInitializeObjectBias(objectHeader);
+    else
+        objectHeader->RefCount = 1;
+
     REF_STAT_UP(RefObjectsCreated);
 
 #ifdef DEBUG
@@ -165,6 +180,13 @@ PVOID PhReferenceObject(
     PPH_OBJECT_HEADER objectHeader;
 
     objectHeader = PhObjectToObjectHeader(Object);
+
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        PhpReferenceBiasedObject(objectHeader, 1);
+        return Object;
+    }
+
     // Increment the reference count.
     _InterlockedIncrement(&objectHeader->RefCount);
 
@@ -190,6 +212,13 @@ _May_raise_ LONG PhReferenceObjectEx(
     assert(!(RefCount < 0));
 
     objectHeader = PhObjectToObjectHeader(Object);
+
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        PhpReferenceBiasedObject(objectHeader, RefCount);
+        return PhpGetObjectRefCount(objectHeader);
+    }
+
     // Increase the reference count.
     oldRefCount = _InterlockedExchangeAdd(&objectHeader->RefCount, RefCount);
 
@@ -220,6 +249,10 @@ BOOLEAN PhReferenceObjectSafe(
     BOOLEAN result;
 
     objectHeader = PhObjectToObjectHeader(Object);
+
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+        return PhpReferenceBiasedObjectSafe(objectHeader);
+
     // Increase the reference count only if it isn't 0 (atomically).
     result = PhpInterlockedIncrementSafe(&objectHeader->RefCount);
 
@@ -242,6 +275,15 @@ VOID PhDereferenceObject(
     LONG newRefCount;
 
     objectHeader = PhObjectToObjectHeader(Object);
+
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        if (PhpDereferenceBiasedObject(objectHeader, 1))
+            PhpFreeObject(objectHeader);
+
+        return;
+    }
+
     // Decrement the reference count.
     newRefCount = _InterlockedDecrement(&objectHeader->RefCount);
     ASSUME_ASSERT(newRefCount >= 0);
@@ -293,6 +335,21 @@ _May_raise_ LONG PhDereferenceObjectEx(
 
     objectHeader = PhObjectToObjectHeader(Object);
 
+    if (objectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        if (PhpDereferenceBiasedObject(objectHeader, RefCount))
+        {
+            if (DeferDelete)
+                PhpDeferDeleteObject(objectHeader);
+            else
+                PhpFreeObject(objectHeader);
+
+            return 0;
+        }
+
+        return PhpGetObjectRefCount(objectHeader);
+    }
+
     // Decrease the reference count.
     oldRefCount = _InterlockedExchangeAdd(&objectHeader->RefCount, -RefCount);
     newRefCount = oldRefCount - RefCount;
@@ -367,6 +424,14 @@ PPH_OBJECT_TYPE PhCreateObjectType(
  * \param Name The name of the type.
  * \param Flags A combination of flags affecting the behaviour of the
  * object type.
+ * \li \c PH_OBJECT_TYPE_USE_FREE_LIST Objects are allocated from a free list
+ * whose parameters are given in \a Parameters.
+ * \li \c PH_OBJECT_TYPE_BIASED_REF_COUNT Objects have a biased reference count.
+ * The thread that creates an object references and dereferences it without
+ * interlocked operations, and other threads use interlocked operations. This
+ * only takes effect if the creating thread has an auto-dereference pool, and
+ * each object uses extra memory. Use this for widely shared objects which are
+ * mostly referenced by the thread that created them.
  * \param DeleteProcedure A callback function that is executed when
  * an object of this type is about to be freed (i.e. when its
  * reference count is 0).
@@ -385,7 +450,6 @@ PPH_OBJECT_TYPE PhCreateObjectTypeEx(
     _In_opt_ PPH_OBJECT_TYPE_PARAMETERS Parameters
     )
 {
-    NTSTATUS status = STATUS_SUCCESS;
     PPH_OBJECT_TYPE objectType;
 
     // Check the flags.
@@ -413,10 +477,12 @@ PPH_OBJECT_TYPE PhCreateObjectTypeEx(
     {
         if (Flags & PH_OBJECT_TYPE_USE_FREE_LIST)
         {
-            PhInitializeFreeList(
+            PhInitializeFreeListEx(
                 &objectType->FreeList,
-                PhAddObjectHeaderSize(Parameters->FreeListSize),
-                Parameters->FreeListCount
+                PhAddObjectHeaderSize(Parameters->FreeListSize) +
+                ((Flags & PH_OBJECT_TYPE_BIASED_REF_COUNT) ? sizeof(PH_OBJECT_BIAS) : 0),
+                Parameters->FreeListCount,
+                PH_FREE_LIST_USE_MAGAZINES
                 );
         }
     }
@@ -441,6 +507,313 @@ VOID PhGetObjectTypeInformation(
     Information->TypeIndex = ObjectType->TypeIndex;
 }
 
+/**
+ * Gets the object bias owner for the current thread, creating it if
+ * necessary.
+ *
+ * \return The owner, or NULL if the current thread does not have an
+ * auto-dereference pool.
+ */
+PPH_OBJECT_BIAS_OWNER PhpGetCurrentObjectBiasOwner(
+    VOID
+    )
+{
+    PPH_OBJECT_BIAS_OWNER owner;
+
+    owner = PhpGetTlsValue(PhpObjectBiasOwnerTlsIndex);
+
+    // Only threads with an auto-dereference pool drain their merge queue
+    // regularly.
+    if (!owner && PhpGetCurrentAutoPool())
+    {
+        owner = PhAllocate(sizeof(PH_OBJECT_BIAS_OWNER));
+        RtlInitializeSListHead(&owner->MergeListHead);
+        owner->ThreadId = NtCurrentTeb()->ClientId.UniqueThread;
+        owner->RefCount = 1;
+        owner->Retired = FALSE;
+
+        if (!TlsSetValue(PhpObjectBiasOwnerTlsIndex, owner))
+        {
+            PhFree(owner);
+            return NULL;
+        }
+    }
+
+    return owner;
+}
+
+VOID PhpDereferenceObjectBiasOwner(
+    _In_ PPH_OBJECT_BIAS_OWNER Owner
+    )
+{
+    if (_InterlockedDecrement(&Owner->RefCount) == 0)
+    {
+        assert(Owner->Retired);
+        PhFree(Owner);
+    }
+}
+
+/**
+ * Retires the object bias owner for the current thread. Objects owned by
+ * the thread are merged by the threads that queue them from now on.
+ *
+ * \remarks This function is called when the last auto-dereference pool
+ * of the thread is deleted, and when a thread created by PhCreateThread
+ * exits.
+ */
+VOID PhRetireCurrentObjectBiasOwner(
+    VOID
+    )
+{
+    PPH_OBJECT_BIAS_OWNER owner;
+
+    owner = PhpGetTlsValue(PhpObjectBiasOwnerTlsIndex);
+
+    if (!owner)
+        return;
+
+    TlsSetValue(PhpObjectBiasOwnerTlsIndex, NULL);
+
+    // From now on, the biased counts of the objects owned by this thread
+    // never change. Threads which queue an object after this point check
+    // the flag and merge the object themselves.
+    _InterlockedExchange(&owner->Retired, TRUE);
+    PhpDrainObjectBiasOwner(owner);
+    PhpDereferenceObjectBiasOwner(owner);
+}
+
+/**
+ * Determines whether the current thread can use the biased reference
+ * count of an object.
+ */
+FORCEINLINE BOOLEAN PhpIsCurrentThreadObjectBiasOwner(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ PPH_OBJECT_BIAS Bias
+    )
+{
+    PPH_OBJECT_BIAS_OWNER owner;
+
+    // Only the owner sets the merged bit while it is not retired, so this
+    // does not need to be an interlocked read.
+    if (ObjectHeader->RefCount & PH_OBJECT_BIAS_MERGED)
+        return FALSE;
+
+    owner = Bias->Owner;
+
+    return owner->ThreadId == NtCurrentTeb()->ClientId.UniqueThread && !owner->Retired;
+}
+
+/**
+ * Initializes the reference count of a new object with a biased reference
+ * count.
+ *
+ * \param ObjectHeader The object header of the new object.
+ */
+VOID PhpInitializeObjectBias(
+    _In_ PPH_OBJECT_HEADER ObjectHeader
+    )
+{
+    PPH_OBJECT_BIAS bias;
+    PPH_OBJECT_BIAS_OWNER owner;
+
+    bias = PhpObjectBiasFromObjectHeader(ObjectHeader);
+    owner = PhpGetCurrentObjectBiasOwner();
+
+    if (owner)
+    {
+        _InterlockedIncrement(&owner->RefCount);
+        bias->Owner = owner;
+        bias->BiasedCount = 1;
+        ObjectHeader->RefCount = 0;
+        REF_STAT_UP(RefBiasedObjectsCreated);
+    }
+    else
+    {
+        // Create the object already merged. All threads use interlocked operations.
+        bias->Owner = NULL;
+        bias->BiasedCount = 0;
+        ObjectHeader->RefCount = PH_OBJECT_BIAS_ONE | PH_OBJECT_BIAS_MERGED;
+    }
+}
+
+VOID PhpReferenceBiasedObject(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ LONG RefCount
+    )
+{
+    PPH_OBJECT_BIAS bias;
+
+    bias = PhpObjectBiasFromObjectHeader(ObjectHeader);
+
+    if (PhpIsCurrentThreadObjectBiasOwner(ObjectHeader, bias))
+        bias->BiasedCount += RefCount;
+    else
+        _InterlockedExchangeAdd(&ObjectHeader->RefCount, RefCount << PH_OBJECT_BIAS_SHIFT);
+}
+
+BOOLEAN PhpReferenceBiasedObjectSafe(
+    _In_ PPH_OBJECT_HEADER ObjectHeader
+    )
+{
+    PPH_OBJECT_BIAS bias;
+    LONG value;
+    LONG newValue;
+
+    bias = PhpObjectBiasFromObjectHeader(ObjectHeader);
+
+    if (PhpIsCurrentThreadObjectBiasOwner(ObjectHeader, bias))
+    {
+        // The owner still has references, so the object is not being deleted.
+        bias->BiasedCount++;
+        return TRUE;
+    }
+
+    value = ObjectHeader->RefCount;
+
+    while (TRUE)
+    {
+        // The object can only be deleted after it has been merged.
+        if ((value & PH_OBJECT_BIAS_MERGED) && (value >> PH_OBJECT_BIAS_SHIFT) == 0)
+            return FALSE;
+
+        newValue = _InterlockedCompareExchange(&ObjectHeader->RefCount, value + PH_OBJECT_BIAS_ONE, value);
+
+        if (newValue == value)
+            return TRUE;
+
+        value = newValue;
+    }
+}
+
+/**
+ * Queues an object to its owner so that the owner merges its references.
+ */
+VOID PhpQueueBiasedObject(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ PPH_OBJECT_BIAS Bias
+    )
+{
+    PPH_OBJECT_BIAS_OWNER owner;
+    LONG value;
+    LONG oldValue;
+
+    value = ObjectHeader->RefCount;
+
+    while (TRUE)
+    {
+        // Don't queue the object if it has already been queued or merged, or if
+        // other threads have taken new references.
+        if ((value & (PH_OBJECT_BIAS_MERGED | PH_OBJECT_BIAS_QUEUED)) || value >= 0)
+            return;
+
+        oldValue = _InterlockedCompareExchange(&ObjectHeader->RefCount, value | PH_OBJECT_BIAS_QUEUED, value);
+
+        if (oldValue == value)
+            break;
+
+        value = oldValue;
+    }
+
+    // The object cannot be freed until it is removed from the queue, so its
+    // owner is still valid. Reference the owner because the object may be
+    // merged and freed as soon as it is pushed.
+    owner = Bias->Owner;
+    _InterlockedIncrement(&owner->RefCount);
+    RtlInterlockedPushEntrySList(&owner->MergeListHead, &Bias->MergeListEntry);
+    REF_STAT_UP(RefBiasedObjectsQueued);
+
+    // A retired owner will never drain its queue again.
+    if (owner->Retired)
+        PhpDrainObjectBiasOwner(owner);
+
+    PhpDereferenceObjectBiasOwner(owner);
+}
+
+/**
+ * Dereferences an object with a biased reference count.
+ *
+ * \param ObjectHeader The object header of the object.
+ * \param RefCount The number of references to remove.
+ *
+ * \return TRUE if the object should be freed, otherwise FALSE.
+ */
+BOOLEAN PhpDereferenceBiasedObject(
+    _In_ PPH_OBJECT_HEADER ObjectHeader,
+    _In_ LONG RefCount
+    )
+{
+    PPH_OBJECT_BIAS bias;
+    LONG newValue;
+
+    bias = PhpObjectBiasFromObjectHeader(ObjectHeader);
+
+    if (PhpIsCurrentThreadObjectBiasOwner(ObjectHeader, bias))
+    {
+        bias->BiasedCount -= RefCount;
+        ASSUME_ASSERT(bias->BiasedCount >= 0);
+
+        if (bias->BiasedCount != 0)
+            return FALSE;
+
+        // The owner has no more references. Merge the object so that other
+        // threads can free it. If the object is queued, the owner frees it
+        // when it drains the queue.
+        newValue = _InterlockedExchangeAdd(&ObjectHeader->RefCount, PH_OBJECT_BIAS_MERGED) + PH_OBJECT_BIAS_MERGED;
+        REF_STAT_UP(RefBiasedObjectsMerged);
+
+        return newValue == PH_OBJECT_BIAS_MERGED;
+    }
+
+    newValue = _InterlockedExchangeAdd(&ObjectHeader->RefCount, -(RefCount << PH_OBJECT_BIAS_SHIFT)) -
+        (RefCount << PH_OBJECT_BIAS_SHIFT);
+
+    if (newValue == PH_OBJECT_BIAS_MERGED)
+        return TRUE;
+
+    // If the shared count is negative, the owner's references may be all that
+    // keep the object alive, and the owner may never release them itself.
+    if (newValue < 0 && !(newValue & (PH_OBJECT_BIAS_MERGED | PH_OBJECT_BIAS_QUEUED)))
+        PhpQueueBiasedObject(ObjectHeader, bias);
+
+    return FALSE;
+}
+
+/**
+ * Merges the objects in the merge queue of an owner.
+ *
+ * \param Owner The object bias owner. This function must be called
+ * by the owner thread, or by any thread if the owner has retired.
+ */
+VOID PhpDrainObjectBiasOwner(
+    _In_ PPH_OBJECT_BIAS_OWNER Owner
+    )
+{
+    PSLIST_ENTRY listEntry;
+    PPH_OBJECT_BIAS bias;
+    PPH_OBJECT_HEADER objectHeader;
+    LONG delta;
+
+    listEntry = RtlInterlockedFlushSList(&Owner->MergeListHead);
+
+    while (listEntry)
+    {
+        bias = CONTAINING_RECORD(listEntry, PH_OBJECT_BIAS, MergeListEntry);
+        objectHeader = PhpObjectHeaderFromObjectBias(bias);
+        listEntry = listEntry->Next;
+
+        delta = -PH_OBJECT_BIAS_QUEUED;
+
+        if (!(objectHeader->RefCount & PH_OBJECT_BIAS_MERGED))
+        {
+            delta += (bias->BiasedCount << PH_OBJECT_BIAS_SHIFT) + PH_OBJECT_BIAS_MERGED;
+            REF_STAT_UP(RefBiasedObjectsMerged);
+        }
+
+        if (_InterlockedExchangeAdd(&objectHeader->RefCount, delta) + delta == PH_OBJECT_BIAS_MERGED)
+            PhpFreeObject(objectHeader);
+    }
+}
+
 /**
  * Allocates storage for an object.
  *
@@ -454,6 +827,32 @@ PPH_OBJECT_HEADER PhpAllocateObject(
 {
     PPH_OBJECT_HEADER objectHeader;
 
+    // Objects with a biased reference count are preceded by their bias information, so they
+    // always use an allocation of their own.
+    if (ObjectType->Flags & PH_OBJECT_TYPE_BIASED_REF_COUNT)
+    {
+        PPH_OBJECT_BIAS bias;
+
+        if (ObjectType->Flags & PH_OBJECT_TYPE_USE_FREE_LIST)
+        {
+            assert(ObjectType->FreeList.Size == sizeof(PH_OBJECT_BIAS) + PhAddObjectHeaderSize(ObjectSize));
+
+            bias = PhAllocateFromFreeList(&ObjectType->FreeList);
+            objectHeader = PhpObjectHeaderFromObjectBias(bias);
+            objectHeader->Flags = PH_OBJECT_FROM_TYPE_FREE_LIST | PH_OBJECT_BIASED_REF_COUNT;
+            REF_STAT_UP(RefObjectsAllocatedFromTypeFreeList);
+        }
+        else
+        {
+            bias = PhAllocate(sizeof(PH_OBJECT_BIAS) + PhAddObjectHeaderSize(ObjectSize));
+            objectHeader = PhpObjectHeaderFromObjectBias(bias);
+            objectHeader->Flags = PH_OBJECT_BIASED_REF_COUNT;
+            REF_STAT_UP(RefObjectsAllocated);
+        }
+
+        return objectHeader;
+    }
+
     if (ObjectType->Flags & PH_OBJECT_TYPE_USE_FREE_LIST)
     {
         assert(ObjectType->FreeList.Size == PhAddObjectHeaderSize(ObjectSize));
@@ -489,6 +888,7 @@ VOID PhpFreeObject(
     )
 {
     PPH_OBJECT_TYPE objectType;
+    PVOID allocation;
 
     objectType = PhObjectTypeTable[ObjectHeader->TypeIndex];
 
@@ -509,9 +909,21 @@ VOID PhpFreeObject(
         objectType->DeleteProcedure(PhObjectHeaderToObject(ObjectHeader), 0);
     }
 
+    allocation = ObjectHeader;
+
+    if (ObjectHeader->Flags & PH_OBJECT_BIASED_REF_COUNT)
+    {
+        PPH_OBJECT_BIAS bias = PhpObjectBiasFromObjectHeader(ObjectHeader);
+
+        if (bias->Owner)
+            PhpDereferenceObjectBiasOwner(bias->Owner);
+
+        allocation = bias;
+    }
+
     if (ObjectHeader->Flags & PH_OBJECT_FROM_TYPE_FREE_LIST)
     {
-        PhFreeToFreeList(&objectType->FreeList, ObjectHeader);
+        PhFreeToFreeList(&objectType->FreeList, allocation);
         REF_STAT_UP(RefObjectsFreedToTypeFreeList);
     }
     else if (ObjectHeader->Flags & PH_OBJECT_FROM_SMALL_FREE_LIST)
@@ -521,7 +933,7 @@ VOID PhpFreeObject(
     }
     else
     {
-        PhFree(ObjectHeader);
+        PhFree(allocation);
         REF_STAT_UP(RefObjectsFreed);
     }
 }
@@ -594,7 +1006,7 @@ FORCEINLINE PPH_AUTO_POOL PhpGetCurrentAutoPool(
     VOID
     )
 {
-    return (PPH_AUTO_POOL)TlsGetValue(PhpAutoPoolTlsIndex);
+    return (PPH_AUTO_POOL)PhpGetTlsValue(PhpAutoPoolTlsIndex);
 }
 
 /**
@@ -665,6 +1077,10 @@ _May_raise_ VOID PhDeleteAutoPool(
     // Remove the pool from the stack.
     PhpSetCurrentAutoPool(AutoPool->NextPool);
 
+    // The thread may not drain any more pools, so it can no longer own objects.
+    if (!AutoPool->NextPool)
+        PhRetireCurrentObjectBiasOwner();
+
     // Free the dynamic array if it hasn't been freed yet.
     if (AutoPool->DynamicObjects)
         PhFree(AutoPool->DynamicObjects);
@@ -704,6 +1120,14 @@ VOID PhDrainAutoPool(
             AutoPool->DynamicObjects = NULL;
         }
     }
+
+    {
+        PPH_OBJECT_BIAS_OWNER owner;
+
+        // Merge objects which other threads have queued to this thread.
+        if (owner = PhpGetTlsValue(PhpObjectBiasOwnerTlsIndex))
+            PhpDrainObjectBiasOwner(owner);
+    }
 }
 
 /**
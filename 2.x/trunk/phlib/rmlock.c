@@ -0,0 +1,321 @@
+/*
+ * Process Hacker -
+ *   read-mostly lock
+ *
+ * Copyright (C) 2015 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The read-mostly lock is a reader-writer lock optimized for data
+ * structures which are looked up much more often than they are
+ * modified. Every shared acquire of a queued lock writes to the
+ * lock itself, so readers on different processors keep stealing
+ * the same cache line from each other even though they never
+ * block.
+ *
+ * Instead, a reader increments a count in a slot belonging to the
+ * current processor and then checks whether a writer is present.
+ * A writer acquires an ordinary queued lock exclusively, announces
+ * itself and waits until the sum of all reader counts drops to
+ * zero. Readers which see the writer undo their increment and
+ * block on the queued lock in shared mode; once they own it no
+ * writer can be present, so they increment their slot again and
+ * release the queued lock immediately.
+ *
+ * A thread may be moved to another processor while it holds the
+ * lock, so the release may decrement a different slot than the
+ * acquire incremented. Individual slots can therefore become
+ * negative; only the sum is meaningful.
+ *
+ * Writers do not get woken up by readers, they spin and then
+ * yield until the readers have drained. This is acceptable
+ * because the lock is meant for short read-side critical sections
+ * and infrequent writers.
+ */
+
+#include <phbase.h>
+#include <phintrnl.h>
+
+#define PH_READ_MOSTLY_LOCK_SPIN_COUNT 4000
+#define PH_READ_MOSTLY_LOCK_YIELD_COUNT 64
+
+static ULONG PhReadMostlyLockNumberOfSlots = 0;
+
+/**
+ * Initializes a read-mostly lock.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ */
+VOID PhInitializeReadMostlyLock(
+    _Out_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    PhInitializeQueuedLock(&ReadMostlyLock->Lock);
+    ReadMostlyLock->Writer = 0;
+    ReadMostlyLock->Readers = 0;
+    ReadMostlyLock->Slots = NULL;
+}
+
+/**
+ * Frees resources used by a read-mostly lock.
+ *
+ * \param ReadMostlyLock A read-mostly lock which is not owned.
+ */
+VOID PhDeleteReadMostlyLock(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    if (ReadMostlyLock->Slots)
+    {
+        PhFreePage(ReadMostlyLock->Slots);
+        ReadMostlyLock->Slots = NULL;
+    }
+}
+
+static VOID PhpCreateReadMostlyLockSlots(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    ULONG numberOfProcessors;
+    ULONG numberOfSlots;
+    PPH_READ_MOSTLY_LOCK_SLOT slots;
+
+    numberOfProcessors = (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+
+    // phlib hasn't been initialized yet. Use the reader count in the lock.
+    if (numberOfProcessors == 0)
+        return;
+
+    numberOfSlots = 1;
+
+    while (numberOfSlots < numberOfProcessors && numberOfSlots < PH_READ_MOSTLY_LOCK_MAXIMUM_SLOTS)
+        numberOfSlots *= 2;
+
+    PhReadMostlyLockNumberOfSlots = numberOfSlots;
+
+    // There is nothing to gain on a uniprocessor system.
+    if (numberOfSlots == 1)
+        return;
+
+    // Use page allocations so that the slots are aligned to cache lines.
+    slots = PhAllocatePage(numberOfSlots * sizeof(PH_READ_MOSTLY_LOCK_SLOT), NULL);
+
+    if (!slots)
+        return;
+
+    if (_InterlockedCompareExchangePointer((PVOID *)&ReadMostlyLock->Slots, slots, NULL) != NULL)
+        PhFreePage(slots);
+}
+
+FORCEINLINE volatile LONG *PhpGetReadMostlyLockReaders(
+    _In_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    PPH_READ_MOSTLY_LOCK_SLOT slots;
+
+    slots = *(PPH_READ_MOSTLY_LOCK_SLOT volatile *)&ReadMostlyLock->Slots;
+
+    if (slots)
+        return &slots[RtlGetCurrentProcessorNumber() & (PhReadMostlyLockNumberOfSlots - 1)].Readers;
+    else
+        return &ReadMostlyLock->Readers;
+}
+
+static LONG PhpCountReadMostlyLockReaders(
+    _In_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    PPH_READ_MOSTLY_LOCK_SLOT slots;
+    LONG readers;
+    ULONG i;
+
+    readers = ReadMostlyLock->Readers;
+    slots = *(PPH_READ_MOSTLY_LOCK_SLOT volatile *)&ReadMostlyLock->Slots;
+
+    if (slots)
+    {
+        for (i = 0; i < PhReadMostlyLockNumberOfSlots; i++)
+            readers += slots[i].Readers;
+    }
+
+    return readers;
+}
+
+static VOID PhpWaitForReadMostlyLockReaders(
+    _In_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    ULONG spinCount;
+    ULONG i;
+    LARGE_INTEGER interval;
+
+    if (PhpCountReadMostlyLockReaders(ReadMostlyLock) == 0)
+        return;
+
+    PHLIB_INC_STATISTIC(RmExclusiveDrainWaits);
+
+    if ((ULONG)PhSystemBasicInformation.NumberOfProcessors > 1)
+        spinCount = PH_READ_MOSTLY_LOCK_SPIN_COUNT;
+    else
+        spinCount = 0;
+
+    for (i = 0; PhpCountReadMostlyLockReaders(ReadMostlyLock) != 0; i++)
+    {
+        if (i < spinCount)
+        {
+            YieldProcessor();
+        }
+        else if (i < spinCount + PH_READ_MOSTLY_LOCK_YIELD_COUNT)
+        {
+            NtYieldExecution();
+        }
+        else
+        {
+            interval.QuadPart = -(LONG64)PH_TICKS_PER_MS;
+            NtDelayExecution(FALSE, &interval);
+        }
+    }
+}
+
+/**
+ * Acquires a read-mostly lock in exclusive mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ */
+_May_raise_ VOID FASTCALL PhfAcquireReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    PhAcquireQueuedLockExclusive(&ReadMostlyLock->Lock);
+
+    // Stop new readers from entering, then wait for the existing ones to leave.
+    _InterlockedExchange((PLONG)&ReadMostlyLock->Writer, 1);
+    PhpWaitForReadMostlyLockReaders(ReadMostlyLock);
+}
+
+/**
+ * Acquires a read-mostly lock in shared mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ */
+_May_raise_ VOID FASTCALL PhfAcquireReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    volatile LONG *readers;
+
+    if (!ReadMostlyLock->Slots && PhReadMostlyLockNumberOfSlots != 1)
+        PhpCreateReadMostlyLockSlots(ReadMostlyLock);
+
+    readers = PhpGetReadMostlyLockReaders(ReadMostlyLock);
+
+    // The interlocked increment is a full barrier, so either we see the writer or the
+    // writer sees our increment.
+    _InterlockedIncrement(readers);
+
+    if (!ReadMostlyLock->Writer)
+        return;
+
+    _InterlockedDecrement(readers);
+
+    PHLIB_INC_STATISTIC(RmAcquireSharedBlocks);
+
+    // Wait for the writer to finish. While we own the queued lock in shared mode no
+    // writer can be present, so the increment always succeeds.
+    PhAcquireQueuedLockShared(&ReadMostlyLock->Lock);
+    _InterlockedIncrement(PhpGetReadMostlyLockReaders(ReadMostlyLock));
+    PhReleaseQueuedLockShared(&ReadMostlyLock->Lock);
+}
+
+/**
+ * Releases a read-mostly lock in exclusive mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ */
+VOID FASTCALL PhfReleaseReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    _InterlockedExchange((PLONG)&ReadMostlyLock->Writer, 0);
+    PhReleaseQueuedLockExclusive(&ReadMostlyLock->Lock);
+}
+
+/**
+ * Releases a read-mostly lock in shared mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ */
+VOID FASTCALL PhfReleaseReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    _InterlockedDecrement(PhpGetReadMostlyLockReaders(ReadMostlyLock));
+}
+
+/**
+ * Attempts to acquire a read-mostly lock in exclusive mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ *
+ * \return Whether the lock was acquired.
+ */
+BOOLEAN FASTCALL PhfTryAcquireReadMostlyLockExclusive(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    if (!PhTryAcquireQueuedLockExclusive(&ReadMostlyLock->Lock))
+        return FALSE;
+
+    _InterlockedExchange((PLONG)&ReadMostlyLock->Writer, 1);
+
+    if (PhpCountReadMostlyLockReaders(ReadMostlyLock) == 0)
+        return TRUE;
+
+    // There are readers. Back out; this also wakes any readers which saw us.
+    _InterlockedExchange((PLONG)&ReadMostlyLock->Writer, 0);
+    PhReleaseQueuedLockExclusive(&ReadMostlyLock->Lock);
+
+    return FALSE;
+}
+
+/**
+ * Attempts to acquire a read-mostly lock in shared mode.
+ *
+ * \param ReadMostlyLock A read-mostly lock.
+ *
+ * \return Whether the lock was acquired.
+ */
+BOOLEAN FASTCALL PhfTryAcquireReadMostlyLockShared(
+    _Inout_ PPH_READ_MOSTLY_LOCK ReadMostlyLock
+    )
+{
+    volatile LONG *readers;
+
+    if (!ReadMostlyLock->Slots && PhReadMostlyLockNumberOfSlots != 1)
+        PhpCreateReadMostlyLockSlots(ReadMostlyLock);
+
+    readers = PhpGetReadMostlyLockReaders(ReadMostlyLock);
+    _InterlockedIncrement(readers);
+
+    if (!ReadMostlyLock->Writer)
+        return TRUE;
+
+    _InterlockedDecrement(readers);
+
+    return FALSE;
+}
@@ -0,0 +1,456 @@
+/*
+ * Process Hacker -
+ *   string pool
+ *
+ * Copyright (C) 2011-2015 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A string pool stores a single copy of each distinct string. Interned
+ * strings are ordinary string objects as far as callers are concerned, but
+ * they belong to a separate object type whose delete procedure removes them
+ * from the pool. The pool itself does not hold any references, so a string
+ * drops out of the pool as soon as the last external reference goes away.
+ *
+ * The pool is split into shards selected by the string hash, each with its
+ * own lock and hashtable. Lookups that find a live string only acquire the
+ * shard lock in shared mode.
+ */
+
+#include <phbase.h>
+#include <refp.h>
+
+typedef struct _PHP_STRING_POOL_ENTRY
+{
+    PPH_STRINGREF Key;
+    ULONG Hash;
+} PHP_STRING_POOL_ENTRY, *PPHP_STRING_POOL_ENTRY;
+
+/**
+ * Stored after the null terminator of each interned string.
+ */
+typedef struct _PHP_STRING_POOL_TRAILER
+{
+    PPH_STRING_POOL Pool;
+    ULONG Hash;
+} PHP_STRING_POOL_TRAILER, *PPHP_STRING_POOL_TRAILER;
+
+#define PhpStringPoolTrailerOffset(Length) \
+    ((FIELD_OFFSET(PH_STRING, Data) + (Length) + sizeof(WCHAR) + sizeof(PVOID) - 1) & ~(sizeof(PVOID) - 1))
+#define PhpGetStringPoolTrailer(String) \
+    ((PPHP_STRING_POOL_TRAILER)PTR_ADD_OFFSET((String), PhpStringPoolTrailerOffset((String)->Length)))
+#define PhpGetStringPoolShard(Pool, Hash) \
+    (&(Pool)->Shards[((Hash) * 0x9e3779b1) >> (32 - PH_STRING_POOL_SHARD_SHIFT)])
+
+BOOLEAN NTAPI PhpStringPoolHashtableEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    );
+
+ULONG NTAPI PhpStringPoolHashtableHashFunction(
+    _In_ PVOID Entry
+    );
+
+VOID NTAPI PhpInternedStringDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    );
+
+PPH_OBJECT_TYPE PhInternedStringType;
+static PH_INITONCE PhpStringPoolInitOnce = PH_INITONCE_INIT;
+static PH_STRING_POOL PhpGlobalStringPool;
+static PH_INITONCE PhpGlobalStringPoolInitOnce = PH_INITONCE_INIT;
+
+FORCEINLINE VOID PhpStringPoolInitialization(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhpStringPoolInitOnce))
+    {
+        PhInternedStringType = PhCreateObjectType(L"InternedString", PH_OBJECT_TYPE_BIASED_REF_COUNT, PhpInternedStringDeleteProcedure);
+        PhEndInitOnce(&PhpStringPoolInitOnce);
+    }
+}
+
+/**
+ * Initializes a string pool.
+ *
+ * \param Pool The string pool.
+ * \param InitialCapacity The number of strings to allocate storage for, initially.
+ */
+VOID PhInitializeStringPool(
+    _Out_ PPH_STRING_POOL Pool,
+    _In_ ULONG InitialCapacity
+    )
+{
+    ULONG i;
+
+    PhpStringPoolInitialization();
+
+    for (i = 0; i < PH_STRING_POOL_SHARD_COUNT; i++)
+    {
+        PPH_STRING_POOL_SHARD shard = &Pool->Shards[i];
+
+        PhInitializeQueuedLock(&shard->Lock);
+        shard->Hashtable = PhCreateHashtableEx(
+            sizeof(PHP_STRING_POOL_ENTRY),
+            PhpStringPoolHashtableEqualFunction,
+            PhpStringPoolHashtableHashFunction,
+            InitialCapacity / PH_STRING_POOL_SHARD_COUNT + 1,
+            PH_HASHTABLE_OPEN_ADDRESSING
+            );
+        shard->Lookups = 0;
+        shard->Hits = 0;
+        shard->BytesSaved = 0;
+    }
+}
+
+/**
+ * Frees resources used by a string pool.
+ *
+ * \param Pool The string pool.
+ *
+ * \remarks Strings that are still alive are detached from the pool and remain valid.
+ * They must not be freed while this function is running.
+ */
+VOID PhDeleteStringPool(
+    _Inout_ PPH_STRING_POOL Pool
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < PH_STRING_POOL_SHARD_COUNT; i++)
+    {
+        PPH_STRING_POOL_SHARD shard = &Pool->Shards[i];
+        PH_HASHTABLE_ENUM_CONTEXT enumContext;
+        PPHP_STRING_POOL_ENTRY entry;
+
+        PhAcquireQueuedLockExclusive(&shard->Lock);
+
+        PhBeginEnumHashtable(shard->Hashtable, &enumContext);
+
+        while (entry = PhNextEnumHashtable(&enumContext))
+        {
+            PPH_STRING string = CONTAINING_RECORD(entry->Key, PH_STRING, sr);
+
+            PhpGetStringPoolTrailer(string)->Pool = NULL;
+        }
+
+        PhReleaseQueuedLockExclusive(&shard->Lock);
+
+        PhDereferenceObject(shard->Hashtable);
+    }
+}
+
+BOOLEAN NTAPI PhpStringPoolHashtableEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPHP_STRING_POOL_ENTRY entry1 = Entry1;
+    PPHP_STRING_POOL_ENTRY entry2 = Entry2;
+
+    return entry1->Hash == entry2->Hash && PhEqualStringRef(entry1->Key, entry2->Key, FALSE);
+}
+
+ULONG NTAPI PhpStringPoolHashtableHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return ((PPHP_STRING_POOL_ENTRY)Entry)->Hash;
+}
+
+VOID NTAPI PhpInternedStringDeleteProcedure(
+    _In_ PVOID Object,
+    _In_ ULONG Flags
+    )
+{
+    PPH_STRING string = Object;
+    PPHP_STRING_POOL_TRAILER trailer;
+    PPH_STRING_POOL_SHARD shard;
+    PHP_STRING_POOL_ENTRY lookupEntry;
+    PPHP_STRING_POOL_ENTRY entry;
+
+    trailer = PhpGetStringPoolTrailer(string);
+
+    if (!trailer->Pool)
+        return;
+
+    shard = PhpGetStringPoolShard(trailer->Pool, trailer->Hash);
+    lookupEntry.Key = &string->sr;
+    lookupEntry.Hash = trailer->Hash;
+
+    PhAcquireQueuedLockExclusive(&shard->Lock);
+
+    // The entry may have already been replaced by a new copy of the string if someone tried to
+    // intern it after our reference count reached 0.
+    entry = PhFindEntryHashtable(shard->Hashtable, &lookupEntry);
+
+    if (entry && entry->Key == &string->sr)
+        PhRemoveEntryHashtable(shard->Hashtable, &lookupEntry);
+
+    PhReleaseQueuedLockExclusive(&shard->Lock);
+}
+
+/**
+ * Looks up a live string in a shard. The shard must be locked.
+ */
+FORCEINLINE PPH_STRING PhpLookupStringPoolShard(
+    _In_ PPH_STRING_POOL_SHARD Shard,
+    _In_ PPHP_STRING_POOL_ENTRY LookupEntry,
+    _Out_opt_ PPHP_STRING_POOL_ENTRY *Entry
+    )
+{
+    PPHP_STRING_POOL_ENTRY entry;
+    PPH_STRING string;
+
+    entry = PhFindEntryHashtable(Shard->Hashtable, LookupEntry);
+
+    if (Entry)
+        *Entry = entry;
+
+    if (!entry)
+        return NULL;
+
+    string = CONTAINING_RECORD(entry->Key, PH_STRING, sr);
+
+    // The string may be in the middle of being freed, in which case its delete procedure is
+    // waiting for the shard lock.
+    if (!PhReferenceObjectSafe(string))
+        return NULL;
+
+    return string;
+}
+
+FORCEINLINE VOID PhpRecordStringPoolHit(
+    _Inout_ PPH_STRING_POOL_SHARD Shard,
+    _In_ PPH_STRING String
+    )
+{
+    _InterlockedIncrement((PLONG)&Shard->Hits);
+    InterlockedExchangeAddSizeT(
+        &Shard->BytesSaved,
+        PhAddObjectHeaderSize(PhpStringPoolTrailerOffset(String->Length) + sizeof(PHP_STRING_POOL_TRAILER))
+        );
+}
+
+/**
+ * Obtains a reference to the pooled copy of a string.
+ *
+ * \param Pool The string pool.
+ * \param String The string to look up.
+ *
+ * \return A reference to an interned string with the same contents as \a String.
+ * You must dereference the string when you no longer need it.
+ */
+PPH_STRING PhInternStringRefPool(
+    _Inout_ PPH_STRING_POOL Pool,
+    _In_ PPH_STRINGREF String
+    )
+{
+    PHP_STRING_POOL_ENTRY lookupEntry;
+    PPHP_STRING_POOL_ENTRY entry;
+    PPH_STRING_POOL_SHARD shard;
+    PPH_STRING string;
+    SIZE_T trailerOffset;
+    PPHP_STRING_POOL_TRAILER trailer;
+
+    lookupEntry.Key = String;
+    lookupEntry.Hash = PhHashStringRefEx(String, FALSE, WordHashAlgorithm);
+    shard = PhpGetStringPoolShard(Pool, lookupEntry.Hash);
+
+    _InterlockedIncrement((PLONG)&shard->Lookups);
+
+    PhAcquireQueuedLockShared(&shard->Lock);
+    string = PhpLookupStringPoolShard(shard, &lookupEntry, NULL);
+    PhReleaseQueuedLockShared(&shard->Lock);
+
+    if (string)
+    {
+        PhpRecordStringPoolHit(shard, string);
+        return string;
+    }
+
+    PhAcquireQueuedLockExclusive(&shard->Lock);
+
+    // Someone may have added the string while we weren't holding the lock.
+    if (string = PhpLookupStringPoolShard(shard, &lookupEntry, &entry))
+    {
+        PhReleaseQueuedLockExclusive(&shard->Lock);
+        PhpRecordStringPoolHit(shard, string);
+
+        return string;
+    }
+
+    trailerOffset = PhpStringPoolTrailerOffset(String->Length);
+    string = PhCreateObject(trailerOffset + sizeof(PHP_STRING_POOL_TRAILER), PhInternedStringType);
+    string->Length = String->Length;
+    string->Buffer = string->Data;
+    memcpy(string->Buffer, String->Buffer, String->Length);
+    string->Buffer[String->Length / sizeof(WCHAR)] = 0;
+
+    trailer = PTR_ADD_OFFSET(string, trailerOffset);
+    trailer->Pool = Pool;
+    trailer->Hash = lookupEntry.Hash;
+
+    lookupEntry.Key = &string->sr;
+
+    if (entry)
+    {
+        // The existing string is being freed. Replace it; its delete procedure will notice that
+        // the entry no longer refers to it.
+        entry->Key = &string->sr;
+    }
+    else
+    {
+        PhAddEntryHashtable(shard->Hashtable, &lookupEntry);
+    }
+
+    PhReleaseQueuedLockExclusive(&shard->Lock);
+
+    return string;
+}
+
+/**
+ * Replaces a string with its pooled copy.
+ *
+ * \param Pool The string pool.
+ * \param String The string to intern. The function takes ownership of the caller's
+ * reference to the string. This parameter can be NULL.
+ *
+ * \return A reference to an interned string with the same contents as \a String,
+ * or NULL if \a String is NULL. You must dereference the string when you no
+ * longer need it.
+ *
+ * \remarks Interned strings are shared and must never be modified.
+ */
+PPH_STRING PhInternStringPool(
+    _Inout_ PPH_STRING_POOL Pool,
+    _In_opt_ _Assume_refs_(1) PPH_STRING String
+    )
+{
+    PPH_STRING string;
+
+    if (!String)
+        return NULL;
+
+    // Strings that are already interned in this pool are returned as-is.
+    if (PhGetObjectType(String) == PhInternedStringType &&
+        PhpGetStringPoolTrailer(String)->Pool == Pool)
+        return String;
+
+    string = PhInternStringRefPool(Pool, &String->sr);
+    PhDereferenceObject(String);
+
+    return string;
+}
+
+/**
+ * Gets statistics for a string pool.
+ *
+ * \param Pool The string pool.
+ * \param Statistics A variable which receives the statistics.
+ */
+VOID PhGetStringPoolStatistics(
+    _In_ PPH_STRING_POOL Pool,
+    _Out_ PPH_STRING_POOL_STATISTICS Statistics
+    )
+{
+    ULONG i;
+
+    memset(Statistics, 0, sizeof(PH_STRING_POOL_STATISTICS));
+
+    for (i = 0; i < PH_STRING_POOL_SHARD_COUNT; i++)
+    {
+        PPH_STRING_POOL_SHARD shard = &Pool->Shards[i];
+        PH_HASHTABLE_ENUM_CONTEXT enumContext;
+        PPHP_STRING_POOL_ENTRY entry;
+
+        PhAcquireQueuedLockShared(&shard->Lock);
+
+        PhBeginEnumHashtable(shard->Hashtable, &enumContext);
+
+        while (entry = PhNextEnumHashtable(&enumContext))
+        {
+            PPH_STRING string = CONTAINING_RECORD(entry->Key, PH_STRING, sr);
+            SIZE_T size;
+            LONG refCount;
+
+            size = PhAddObjectHeaderSize(PhpStringPoolTrailerOffset(string->Length) + sizeof(PHP_STRING_POOL_TRAILER));
+            refCount = PhpGetObjectRefCount(PhObjectToObjectHeader(string));
+
+            Statistics->NumberOfStrings++;
+            Statistics->BytesUsed += size;
+
+            // Assume that each reference would otherwise have been a separate copy.
+            if (refCount > 1)
+                Statistics->BytesSavedEstimate += size * (refCount - 1);
+        }
+
+        Statistics->Lookups += shard->Lookups;
+        Statistics->Hits += shard->Hits;
+        Statistics->BytesSaved += shard->BytesSaved;
+
+        PhReleaseQueuedLockShared(&shard->Lock);
+    }
+}
+
+/**
+ * Gets the global string pool.
+ */
+PPH_STRING_POOL PhGetGlobalStringPool(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhpGlobalStringPoolInitOnce))
+    {
+        PhInitializeStringPool(&PhpGlobalStringPool, 1024);
+        PhEndInitOnce(&PhpGlobalStringPoolInitOnce);
+    }
+
+    return &PhpGlobalStringPool;
+}
+
+/**
+ * Replaces a string with its copy in the global string pool.
+ *
+ * \param String The string to intern. The function takes ownership of the caller's
+ * reference to the string. This parameter can be NULL.
+ *
+ * \return A reference to an interned string, or NULL if \a String is NULL.
+ */
+PPH_STRING PhInternString(
+    _In_opt_ _Assume_refs_(1) PPH_STRING String
+    )
+{
+    return PhInternStringPool(PhGetGlobalStringPool(), String);
+}
+
+/**
+ * Obtains a reference to the copy of a string in the global string pool.
+ *
+ * \param String The string to look up.
+ *
+ * \return A reference to an interned string.
+ */
+PPH_STRING PhInternStringRef(
+    _In_ PPH_STRINGREF String
+    )
+{
+    return PhInternStringRefPool(PhGetGlobalStringPool(), String);
+}
@@ -1691,6 +1691,22 @@ VOID PhDeleteImageVersionInfo(
     if (ImageVersionInfo->ProductName) PhDereferenceObject(ImageVersionInfo->ProductName);
 }
 
+/**
+ * Replaces the strings in a version information structure with their
+ * copies in the global string pool.
+ *
+ * \param ImageVersionInfo The version information structure.
+ */
+VOID PhInternImageVersionInfo(
+    _Inout_ PPH_IMAGE_VERSION_INFO ImageVersionInfo
+    )
+{
+    ImageVersionInfo->CompanyName = PhInternString(ImageVersionInfo->CompanyName);
+    ImageVersionInfo->FileDescription = PhInternString(ImageVersionInfo->FileDescription);
+    ImageVersionInfo->FileVersion = PhInternString(ImageVersionInfo->FileVersion);
+    ImageVersionInfo->ProductName = PhInternString(ImageVersionInfo->ProductName);
+}
+
 PPH_STRING PhFormatImageVersionInfo(
     _In_opt_ PPH_STRING FileName,
     _In_ PPH_IMAGE_VERSION_INFO ImageVersionInfo,
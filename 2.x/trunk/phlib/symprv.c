@@ -29,7 +29,6 @@
 typedef struct _PH_SYMBOL_MODULE
 {
     LIST_ENTRY ListEntry;
-    PH_AVL_LINKS Links;
     ULONG64 BaseAddress;
     ULONG Size;
     PPH_STRING FileName;
@@ -49,11 +48,6 @@ VOID PhpFreeSymbolModule(
     _In_ PPH_SYMBOL_MODULE SymbolModule
     );
 
-LONG NTAPI PhpSymbolModuleCompareFunction(
-    _In_ PPH_AVL_LINKS Links1,
-    _In_ PPH_AVL_LINKS Links2
-    );
-
 PPH_OBJECT_TYPE PhSymbolProviderType;
 
 static PH_INITONCE PhSymInitOnce = PH_INITONCE_INIT;
@@ -160,7 +154,7 @@ PPH_SYMBOL_PROVIDER PhCreateSymbolProvider(
     memset(symbolProvider, 0, sizeof(PH_SYMBOL_PROVIDER));
     InitializeListHead(&symbolProvider->ModulesListHead);
     PhInitializeQueuedLock(&symbolProvider->ModulesListLock);
-    PhInitializeAvlTree(&symbolProvider->ModulesSet, PhpSymbolModuleCompareFunction);
+    PhInitializeBTree(&symbolProvider->ModulesSet);
     PhInitializeCallback(&symbolProvider->EventCallback);
     PhInitializeInitOnce(&symbolProvider->InitOnce);
 
@@ -233,6 +227,8 @@ VOID NTAPI PhpSymbolProviderDeleteProcedure(
         PhpFreeSymbolModule(module);
     }
 
+    PhDeleteBTree(&symbolProvider->ModulesSet);
+
     if (symbolProvider->IsRealHandle) NtClose(symbolProvider->ProcessHandle);
 }
 
@@ -335,17 +331,6 @@ VOID PhpFreeSymbolModule(
     PhFree(SymbolModule);
 }
 
-static LONG NTAPI PhpSymbolModuleCompareFunction(
-    _In_ PPH_AVL_LINKS Links1,
-    _In_ PPH_AVL_LINKS Links2
-    )
-{
-    PPH_SYMBOL_MODULE symbolModule1 = CONTAINING_RECORD(Links1, PH_SYMBOL_MODULE, Links);
-    PPH_SYMBOL_MODULE symbolModule2 = CONTAINING_RECORD(Links2, PH_SYMBOL_MODULE, Links);
-
-    return uint64cmp(symbolModule1->BaseAddress, symbolModule2->BaseAddress);
-}
-
 BOOLEAN PhGetLineFromAddress(
     _In_ PPH_SYMBOL_PROVIDER SymbolProvider,
     _In_ ULONG64 Address,
@@ -426,10 +411,7 @@ ULONG64 PhGetModuleFromAddress(
     _Out_opt_ PPH_STRING *FileName
     )
 {
-    PH_SYMBOL_MODULE lookupModule;
-    PPH_AVL_LINKS links;
     PPH_SYMBOL_MODULE module;
-    LONG result;
     PPH_STRING foundFileName;
     ULONG64 foundBaseAddress;
 
@@ -437,43 +419,11 @@ ULONG64 PhGetModuleFromAddress(
     foundFileName = NULL;
     foundBaseAddress = 0;
 
-    // Do an approximate search on the modules set to locate the module with the largest
-    // base address that is still smaller than the given address.
-    lookupModule.BaseAddress = Address;
-
     PhAcquireQueuedLockShared(&SymbolProvider->ModulesListLock);
 
-    links = PhFindElementAvlTree2(&SymbolProvider->ModulesSet, &lookupModule.Links, &result);
-
-    if (links)
-    {
-        if (result == 0)
-        {
-            // Exact match.
-        }
-        else if (result < 0)
-        {
-            // The base of the closest module is larger than our address. Assume the
-            // preceding element (which is going to be smaller than our address) is the
-            // one we're looking for.
-
-            links = PhPredecessorElementAvlTree(links);
-        }
-        else
-        {
-            // The base of the closest module is smaller than our address. Assume this
-            // is the element we're looking for.
-        }
-
-        if (links)
-        {
-            module = CONTAINING_RECORD(links, PH_SYMBOL_MODULE, Links);
-        }
-    }
-    else
-    {
-        // No modules loaded.
-    }
+    // Locate the module with the largest base address that is not larger than the given
+    // address.
+    PhFloorElementBTree(&SymbolProvider->ModulesSet, Address, NULL, (PVOID *)&module);
 
     if (module && Address < module->BaseAddress + module->Size)
     {
@@ -667,21 +617,12 @@ PPH_STRING PhGetSymbolFromAddress(
     }
     else
     {
-        PH_SYMBOL_MODULE lookupSymbolModule;
-        PPH_AVL_LINKS existingLinks;
         PPH_SYMBOL_MODULE symbolModule;
 
-        lookupSymbolModule.BaseAddress = symbolInfo->ModBase;
-
         PhAcquireQueuedLockShared(&SymbolProvider->ModulesListLock);
 
-        existingLinks = PhFindElementAvlTree(&SymbolProvider->ModulesSet, &lookupSymbolModule.Links);
-
-        if (existingLinks)
-        {
-            symbolModule = CONTAINING_RECORD(existingLinks, PH_SYMBOL_MODULE, Links);
+        if (PhFindElementBTree(&SymbolProvider->ModulesSet, symbolInfo->ModBase, (PVOID *)&symbolModule))
             PhSetReference(&modFileName, symbolModule->FileName);
-        }
 
         PhReleaseQueuedLockShared(&SymbolProvider->ModulesListLock);
     }
@@ -847,8 +788,7 @@ BOOLEAN PhLoadModuleSymbolProvider(
 {
     ULONG64 baseAddress;
     PPH_SYMBOL_MODULE symbolModule = NULL;
-    PPH_AVL_LINKS existingLinks;
-    PH_SYMBOL_MODULE lookupSymbolModule;
+    BOOLEAN existing;
 
     PhpRegisterSymbolProvider(SymbolProvider);
 
@@ -859,11 +799,10 @@ BOOLEAN PhLoadModuleSymbolProvider(
     // seems to force symbol loading when it is called twice on the same module even if deferred
     // loading is enabled.
     PhAcquireQueuedLockExclusive(&SymbolProvider->ModulesListLock);
-    lookupSymbolModule.BaseAddress = BaseAddress;
-    existingLinks = PhFindElementAvlTree(&SymbolProvider->ModulesSet, &lookupSymbolModule.Links);
+    existing = PhFindElementBTree(&SymbolProvider->ModulesSet, BaseAddress, NULL);
     PhReleaseQueuedLockExclusive(&SymbolProvider->ModulesListLock);
 
-    if (existingLinks)
+    if (existing)
         return TRUE;
 
     PH_LOCK_SYMBOLS();
@@ -904,18 +843,17 @@ BOOLEAN PhLoadModuleSymbolProvider(
     PhAcquireQueuedLockExclusive(&SymbolProvider->ModulesListLock);
 
     // Check for duplicates again.
-    lookupSymbolModule.BaseAddress = BaseAddress;
-    existingLinks = PhFindElementAvlTree(&SymbolProvider->ModulesSet, &lookupSymbolModule.Links);
+    existing = PhFindElementBTree(&SymbolProvider->ModulesSet, BaseAddress, NULL);
 
-    if (!existingLinks)
+    if (!existing)
     {
         symbolModule = PhAllocate(sizeof(PH_SYMBOL_MODULE));
         symbolModule->BaseAddress = BaseAddress;
         symbolModule->Size = Size;
         symbolModule->FileName = PhGetFullPath(FileName, &symbolModule->BaseNameIndex);
 
-        existingLinks = PhAddElementAvlTree(&SymbolProvider->ModulesSet, &symbolModule->Links);
-        assert(!existingLinks);
+        existing = !PhAddElementBTree(&SymbolProvider->ModulesSet, BaseAddress, symbolModule, NULL);
+        assert(!existing);
         InsertTailList(&SymbolProvider->ModulesListHead, &symbolModule->ListEntry);
     }
 
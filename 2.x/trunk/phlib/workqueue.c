@@ -24,6 +24,14 @@
 #include <phbase.h>
 #include <phintrnl.h>
 
+#define PH_WORK_QUEUE_SPIN_COUNT 4000
+
+typedef struct _PHP_WORK_QUEUE_WORKER
+{
+    PPH_WORK_QUEUE WorkQueue;
+    ULONG DequeIndex;
+} PHP_WORK_QUEUE_WORKER, *PPHP_WORK_QUEUE_WORKER;
+
 HANDLE PhpGetSemaphoreWorkQueue(
     _Inout_ PPH_WORK_QUEUE WorkQueue
     );
@@ -37,6 +45,7 @@ NTSTATUS PhpWorkQueueThreadStart(
     );
 
 static PH_FREE_LIST PhWorkQueueItemFreeList;
+static ULONG PhWorkQueueWorkerTlsIndex = TLS_OUT_OF_INDEXES;
 static PH_WORK_QUEUE PhGlobalWorkQueue;
 static PH_INITONCE PhGlobalWorkQueueInitOnce = PH_INITONCE_INIT;
 #ifdef DEBUG
@@ -48,7 +57,8 @@ VOID PhWorkQueueInitialization(
     VOID
     )
 {
-    PhInitializeFreeList(&PhWorkQueueItemFreeList, sizeof(PH_WORK_QUEUE_ITEM), 32);
+    PhInitializeFreeListEx(&PhWorkQueueItemFreeList, sizeof(PH_WORK_QUEUE_ITEM), 32, PH_FREE_LIST_USE_MAGAZINES);
+    PhWorkQueueWorkerTlsIndex = TlsAlloc();
 
 #ifdef DEBUG
     PhDbgWorkQueueList = PhCreateList(4);
@@ -88,6 +98,19 @@ FORCEINLINE VOID PhpExecuteWorkQueueItem(
     WorkQueueItem->Function(WorkQueueItem->Context);
 }
 
+VOID PhpInitializeWorkQueueDeque(
+    _Out_ PPH_WORK_QUEUE_DEQUE Deque
+    )
+{
+    ULONG i;
+
+    PhInitializeQueuedLock(&Deque->Lock);
+    Deque->Count = 0;
+
+    for (i = 0; i < PH_WORK_QUEUE_PRIORITY_COUNT; i++)
+        InitializeListHead(&Deque->ListHeads[i]);
+}
+
 /**
  * Initializes a work queue.
  *
@@ -104,12 +127,35 @@ VOID PhInitializeWorkQueue(
     _In_ ULONG MaximumThreads,
     _In_ ULONG NoWorkTimeout
     )
+{
+    PhInitializeWorkQueueEx(WorkQueue, MinimumThreads, MaximumThreads, NoWorkTimeout, 0);
+}
+
+/**
+ * Initializes a work queue.
+ *
+ * \param WorkQueue A work queue object.
+ * \param MinimumThreads The suggested minimum number of threads to keep alive, even
+ * when there is no work to be performed.
+ * \param MaximumThreads The suggested maximum number of threads to create.
+ * \param NoWorkTimeout The number of milliseconds after which threads without work
+ * will terminate.
+ * \param Flags A combination of flags.
+ * \li \c PH_WORK_QUEUE_WORK_STEALING Give each worker thread its own deque and let
+ * idle workers steal items from busy ones.
+ */
+VOID PhInitializeWorkQueueEx(
+    _Out_ PPH_WORK_QUEUE WorkQueue,
+    _In_ ULONG MinimumThreads,
+    _In_ ULONG MaximumThreads,
+    _In_ ULONG NoWorkTimeout,
+    _In_ ULONG Flags
+    )
 {
     PhInitializeRundownProtection(&WorkQueue->RundownProtect);
     WorkQueue->Terminating = FALSE;
 
-    InitializeListHead(&WorkQueue->QueueListHead);
-    PhInitializeQueuedLock(&WorkQueue->QueueLock);
+    PhpInitializeWorkQueueDeque(&WorkQueue->Queue);
     PhInitializeQueuedLock(&WorkQueue->QueueEmptyCondition);
 
     WorkQueue->MinimumThreads = MinimumThreads;
@@ -122,6 +168,29 @@ VOID PhInitializeWorkQueue(
     WorkQueue->CurrentThreads = 0;
     WorkQueue->BusyCount = 0;
 
+    WorkQueue->Flags = Flags;
+    WorkQueue->PendingCount = 0;
+    WorkQueue->HighPriorityCount = 0;
+    WorkQueue->IdleCount = 0;
+    WorkQueue->NextDeque = 0;
+    WorkQueue->NextWorker = 0;
+
+    if ((Flags & PH_WORK_QUEUE_WORK_STEALING) && MaximumThreads > 1)
+    {
+        ULONG i;
+
+        WorkQueue->NumberOfDeques = min(MaximumThreads, PH_WORK_QUEUE_MAXIMUM_DEQUES);
+        WorkQueue->Deques = PhAllocate(sizeof(PH_WORK_QUEUE_DEQUE) * WorkQueue->NumberOfDeques);
+
+        for (i = 0; i < WorkQueue->NumberOfDeques; i++)
+            PhpInitializeWorkQueueDeque(&WorkQueue->Deques[i]);
+    }
+    else
+    {
+        WorkQueue->NumberOfDeques = 1;
+        WorkQueue->Deques = &WorkQueue->Queue;
+    }
+
 #ifdef DEBUG
     PhAcquireQueuedLockExclusive(&PhDbgWorkQueueListLock);
     PhAddItemList(PhDbgWorkQueueList, WorkQueue);
@@ -140,6 +209,8 @@ VOID PhDeleteWorkQueue(
 {
     PLIST_ENTRY listEntry;
     PPH_WORK_QUEUE_ITEM workQueueItem;
+    ULONG i;
+    ULONG j;
 #ifdef DEBUG
     ULONG index;
 #endif
@@ -163,15 +234,26 @@ VOID PhDeleteWorkQueue(
 
     // Free all un-executed work items.
 
-    listEntry = WorkQueue->QueueListHead.Flink;
-
-    while (listEntry != &WorkQueue->QueueListHead)
+    for (i = 0; i < WorkQueue->NumberOfDeques; i++)
     {
-        workQueueItem = CONTAINING_RECORD(listEntry, PH_WORK_QUEUE_ITEM, ListEntry);
-        listEntry = listEntry->Flink;
-        PhpDestroyWorkQueueItem(workQueueItem);
+        for (j = 0; j < PH_WORK_QUEUE_PRIORITY_COUNT; j++)
+        {
+            PLIST_ENTRY listHead = &WorkQueue->Deques[i].ListHeads[j];
+
+            listEntry = listHead->Flink;
+
+            while (listEntry != listHead)
+            {
+                workQueueItem = CONTAINING_RECORD(listEntry, PH_WORK_QUEUE_ITEM, ListEntry);
+                listEntry = listEntry->Flink;
+                PhpDestroyWorkQueueItem(workQueueItem);
+            }
+        }
     }
 
+    if (WorkQueue->Deques != &WorkQueue->Queue)
+        PhFree(WorkQueue->Deques);
+
     if (WorkQueue->SemaphoreHandle)
         NtClose(WorkQueue->SemaphoreHandle);
 }
@@ -185,12 +267,12 @@ VOID PhWaitForWorkQueue(
     _Inout_ PPH_WORK_QUEUE WorkQueue
     )
 {
-    PhAcquireQueuedLockExclusive(&WorkQueue->QueueLock);
+    PhAcquireQueuedLockExclusive(&WorkQueue->Queue.Lock);
 
-    while (!IsListEmpty(&WorkQueue->QueueListHead))
-        PhWaitForCondition(&WorkQueue->QueueEmptyCondition, &WorkQueue->QueueLock, NULL);
+    while (WorkQueue->PendingCount != 0)
+        PhWaitForCondition(&WorkQueue->QueueEmptyCondition, &WorkQueue->Queue.Lock, NULL);
 
-    PhReleaseQueuedLockExclusive(&WorkQueue->QueueLock);
+    PhReleaseQueuedLockExclusive(&WorkQueue->Queue.Lock);
 }
 
 HANDLE PhpGetSemaphoreWorkQueue(
@@ -249,11 +331,136 @@ BOOLEAN PhpCreateWorkQueueThread(
     }
 }
 
+/**
+ * Removes the oldest item from a deque.
+ *
+ * \param WorkQueue A work queue object.
+ * \param Deque The deque to remove the item from.
+ * \param LowestPriority The lowest priority to consider.
+ */
+PPH_WORK_QUEUE_ITEM PhpPopWorkQueueDeque(
+    _Inout_ PPH_WORK_QUEUE WorkQueue,
+    _Inout_ PPH_WORK_QUEUE_DEQUE Deque,
+    _In_ ULONG LowestPriority
+    )
+{
+    PLIST_ENTRY listEntry = NULL;
+    ULONG pendingCount;
+    ULONG i;
+
+    // Don't bother locking deques which are empty.
+    if (Deque->Count == 0)
+        return NULL;
+
+    PhAcquireQueuedLockExclusive(&Deque->Lock);
+
+    for (i = 0; i <= LowestPriority; i++)
+    {
+        if (!IsListEmpty(&Deque->ListHeads[i]))
+        {
+            listEntry = RemoveHeadList(&Deque->ListHeads[i]);
+            Deque->Count--;
+
+            if (i == PH_WORK_QUEUE_PRIORITY_HIGH)
+                _InterlockedDecrement(&WorkQueue->HighPriorityCount);
+
+            break;
+        }
+    }
+
+    if (listEntry)
+        pendingCount = _InterlockedDecrement(&WorkQueue->PendingCount);
+
+    PhReleaseQueuedLockExclusive(&Deque->Lock);
+
+    if (!listEntry)
+        return NULL;
+
+    if (pendingCount == 0)
+    {
+        PhAcquireQueuedLockExclusive(&WorkQueue->Queue.Lock);
+        PhPulseAllCondition(&WorkQueue->QueueEmptyCondition);
+        PhReleaseQueuedLockExclusive(&WorkQueue->Queue.Lock);
+    }
+
+    return CONTAINING_RECORD(listEntry, PH_WORK_QUEUE_ITEM, ListEntry);
+}
+
+/**
+ * Removes the next item to execute from a work queue.
+ *
+ * \param WorkQueue A work queue object.
+ * \param DequeIndex The index of the deque owned by the calling worker.
+ *
+ * \remarks High priority items in any deque are taken first, then items in
+ * the worker's own deque, and then items stolen from other deques.
+ */
+PPH_WORK_QUEUE_ITEM PhpDequeueWorkQueueItem(
+    _Inout_ PPH_WORK_QUEUE WorkQueue,
+    _In_ ULONG DequeIndex
+    )
+{
+    PPH_WORK_QUEUE_ITEM workQueueItem;
+    ULONG numberOfDeques;
+    ULONG i;
+
+    if (WorkQueue->PendingCount == 0)
+        return NULL;
+
+    numberOfDeques = WorkQueue->NumberOfDeques;
+
+    if (numberOfDeques == 1)
+        return PhpPopWorkQueueDeque(WorkQueue, &WorkQueue->Deques[0], PH_WORK_QUEUE_PRIORITY_COUNT - 1);
+
+    if (WorkQueue->HighPriorityCount != 0)
+    {
+        for (i = 0; i < numberOfDeques; i++)
+        {
+            if (workQueueItem = PhpPopWorkQueueDeque(
+                WorkQueue,
+                &WorkQueue->Deques[(DequeIndex + i) % numberOfDeques],
+                PH_WORK_QUEUE_PRIORITY_HIGH
+                ))
+                return workQueueItem;
+        }
+    }
+
+    for (i = 0; i < numberOfDeques; i++)
+    {
+        if (workQueueItem = PhpPopWorkQueueDeque(
+            WorkQueue,
+            &WorkQueue->Deques[(DequeIndex + i) % numberOfDeques],
+            PH_WORK_QUEUE_PRIORITY_COUNT - 1
+            ))
+        {
+            if (i != 0)
+                PHLIB_INC_STATISTIC(WqWorkItemsStolen);
+
+            return workQueueItem;
+        }
+    }
+
+    return NULL;
+}
+
 NTSTATUS PhpWorkQueueThreadStart(
     _In_ PVOID Parameter
     )
 {
     PPH_WORK_QUEUE workQueue = (PPH_WORK_QUEUE)Parameter;
+    PHP_WORK_QUEUE_WORKER worker;
+    ULONG spinCount;
+
+    worker.WorkQueue = workQueue;
+    worker.DequeIndex = (_InterlockedIncrement(&workQueue->NextWorker) - 1) % workQueue->NumberOfDeques;
+
+    if (PhWorkQueueWorkerTlsIndex != TLS_OUT_OF_INDEXES)
+        TlsSetValue(PhWorkQueueWorkerTlsIndex, &worker);
+
+    if ((workQueue->Flags & PH_WORK_QUEUE_WORK_STEALING) && (ULONG)PhSystemBasicInformation.NumberOfProcessors > 1)
+        spinCount = PH_WORK_QUEUE_SPIN_COUNT;
+    else
+        spinCount = 0;
 
     while (TRUE)
     {
@@ -261,6 +468,7 @@ NTSTATUS PhpWorkQueueThreadStart(
         HANDLE semaphoreHandle;
         LARGE_INTEGER timeout;
         PPH_WORK_QUEUE_ITEM workQueueItem = NULL;
+        ULONG i;
 
         // Check if we have more threads than the limit.
         if (workQueue->CurrentThreads > workQueue->MaximumThreads)
@@ -284,49 +492,63 @@ NTSTATUS PhpWorkQueueThreadStart(
                 break;
         }
 
-        semaphoreHandle = PhpGetSemaphoreWorkQueue(workQueue);
-
         if (!workQueue->Terminating)
         {
-            // Wait for work.
-            status = NtWaitForSingleObject(
-                semaphoreHandle,
-                FALSE,
-                PhTimeoutFromMilliseconds(&timeout, workQueue->NoWorkTimeout)
-                );
-        }
-        else
-        {
-            status = STATUS_UNSUCCESSFUL;
-        }
-
-        if (status == STATUS_WAIT_0 && !workQueue->Terminating)
-        {
-            PLIST_ENTRY listEntry;
-
-            // Dequeue the work item.
+            workQueueItem = PhpDequeueWorkQueueItem(workQueue, worker.DequeIndex);
 
-            PhAcquireQueuedLockExclusive(&workQueue->QueueLock);
-
-            listEntry = RemoveHeadList(&workQueue->QueueListHead);
+            if (!workQueueItem && spinCount != 0)
+            {
+                // Spin for a while before blocking, in case more work arrives soon.
+                for (i = spinCount; i != 0; i--)
+                {
+                    if (workQueue->PendingCount != 0 || workQueue->Terminating)
+                        break;
 
-            if (IsListEmpty(&workQueue->QueueListHead))
-                PhPulseCondition(&workQueue->QueueEmptyCondition);
+                    YieldProcessor();
+                }
 
-            PhReleaseQueuedLockExclusive(&workQueue->QueueLock);
+                if (!workQueue->Terminating)
+                    workQueueItem = PhpDequeueWorkQueueItem(workQueue, worker.DequeIndex);
+            }
 
-            // Make sure we got work.
-            if (listEntry != &workQueue->QueueListHead)
+            if (workQueueItem)
             {
-                workQueueItem = CONTAINING_RECORD(listEntry, PH_WORK_QUEUE_ITEM, ListEntry);
-
                 PhpExecuteWorkQueueItem(workQueueItem);
                 _InterlockedDecrement(&workQueue->BusyCount);
 
                 PhpDestroyWorkQueueItem(workQueueItem);
+
+                continue;
+            }
+
+            semaphoreHandle = PhpGetSemaphoreWorkQueue(workQueue);
+
+            // Announce that we are about to block, then check for work one last time. Anyone
+            // queueing work after this point will see us and release the semaphore.
+            _InterlockedIncrement(&workQueue->IdleCount);
+
+            if (workQueue->PendingCount == 0 && !workQueue->Terminating)
+            {
+                // Wait for work.
+                status = NtWaitForSingleObject(
+                    semaphoreHandle,
+                    FALSE,
+                    PhTimeoutFromMilliseconds(&timeout, workQueue->NoWorkTimeout)
+                    );
             }
+            else
+            {
+                status = STATUS_WAIT_0;
+            }
+
+            _InterlockedDecrement(&workQueue->IdleCount);
         }
         else
+        {
+            status = STATUS_UNSUCCESSFUL;
+        }
+
+        if (status != STATUS_WAIT_0 || workQueue->Terminating)
         {
             BOOLEAN terminate = FALSE;
 
@@ -348,11 +570,74 @@ NTSTATUS PhpWorkQueueThreadStart(
         }
     }
 
+    if (PhWorkQueueWorkerTlsIndex != TLS_OUT_OF_INDEXES)
+        TlsSetValue(PhWorkQueueWorkerTlsIndex, NULL);
+
     PhReleaseRundownProtection(&workQueue->RundownProtect);
 
     return STATUS_SUCCESS;
 }
 
+/**
+ * Chooses the deque for new work items.
+ */
+FORCEINLINE ULONG PhpGetSubmitDequeIndex(
+    _Inout_ PPH_WORK_QUEUE WorkQueue
+    )
+{
+    PPHP_WORK_QUEUE_WORKER worker;
+
+    if (WorkQueue->NumberOfDeques == 1)
+        return 0;
+
+    // Worker threads keep the work they create.
+    if (PhWorkQueueWorkerTlsIndex != TLS_OUT_OF_INDEXES)
+    {
+        worker = PhpGetTlsValue(PhWorkQueueWorkerTlsIndex);
+
+        if (worker && worker->WorkQueue == WorkQueue)
+            return worker->DequeIndex;
+    }
+
+    return (_InterlockedIncrement(&WorkQueue->NextDeque) - 1) % WorkQueue->NumberOfDeques;
+}
+
+/**
+ * Wakes worker threads and creates new ones if necessary, after work items have
+ * been queued.
+ */
+VOID PhpSignalWorkQueue(
+    _Inout_ PPH_WORK_QUEUE WorkQueue,
+    _In_ ULONG Count
+    )
+{
+    ULONG idleCount;
+
+    // Only pay for the semaphore if someone is actually blocked on it.
+    idleCount = WorkQueue->IdleCount;
+
+    if (idleCount != 0)
+        NtReleaseSemaphore(PhpGetSemaphoreWorkQueue(WorkQueue), min(Count, idleCount), NULL);
+
+    // Check if all worker threads are currently busy, and if we can create more threads.
+    if (WorkQueue->BusyCount >= WorkQueue->CurrentThreads &&
+        WorkQueue->CurrentThreads < WorkQueue->MaximumThreads)
+    {
+        // Lock and re-check.
+        PhAcquireQueuedLockExclusive(&WorkQueue->StateLock);
+
+        // Create enough threads to cover a whole batch of new work items.
+        while (WorkQueue->CurrentThreads < WorkQueue->MaximumThreads &&
+            WorkQueue->BusyCount >= WorkQueue->CurrentThreads)
+        {
+            if (!PhpCreateWorkQueueThread(WorkQueue))
+                break;
+        }
+
+        PhReleaseQueuedLockExclusive(&WorkQueue->StateLock);
+    }
+}
+
 /**
  * Queues a work item to a work queue.
  *
@@ -366,7 +651,7 @@ VOID PhQueueItemWorkQueue(
     _In_opt_ PVOID Context
     )
 {
-    PhQueueItemWorkQueueEx(WorkQueue, Function, Context, NULL);
+    PhQueueItemWorkQueueEx(WorkQueue, Function, Context, NULL, PH_WORK_QUEUE_PRIORITY_NORMAL);
 }
 
 /**
@@ -376,39 +661,135 @@ VOID PhQueueItemWorkQueue(
  * \param Function A function to execute.
  * \param Context A user-defined value to pass to the function.
  * \param DeleteFunction A callback function that is executed when the work queue item is about to be freed.
+ * \param Priority The priority of the work item. Items with a higher priority are executed
+ * before items with a lower priority, and items with the same priority are executed in
+ * approximately the order in which they were queued.
  */
 VOID PhQueueItemWorkQueueEx(
     _Inout_ PPH_WORK_QUEUE WorkQueue,
     _In_ PUSER_THREAD_START_ROUTINE Function,
     _In_opt_ PVOID Context,
-    _In_opt_ PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction
+    _In_opt_ PPH_WORK_QUEUE_ITEM_DELETE_FUNCTION DeleteFunction,
+    _In_ ULONG Priority
     )
 {
     PPH_WORK_QUEUE_ITEM workQueueItem;
+    PPH_WORK_QUEUE_DEQUE deque;
+
+    assert(Priority < PH_WORK_QUEUE_PRIORITY_COUNT);
 
     workQueueItem = PhpCreateWorkQueueItem(Function, Context, DeleteFunction);
+    deque = &WorkQueue->Deques[PhpGetSubmitDequeIndex(WorkQueue)];
 
     // Enqueue the work item.
-    PhAcquireQueuedLockExclusive(&WorkQueue->QueueLock);
-    InsertTailList(&WorkQueue->QueueListHead, &workQueueItem->ListEntry);
     _InterlockedIncrement(&WorkQueue->BusyCount);
-    PhReleaseQueuedLockExclusive(&WorkQueue->QueueLock);
-    // Signal the semaphore once to let a worker thread continue.
-    NtReleaseSemaphore(PhpGetSemaphoreWorkQueue(WorkQueue), 1, NULL);
+    PhAcquireQueuedLockExclusive(&deque->Lock);
+    InsertTailList(&deque->ListHeads[Priority], &workQueueItem->ListEntry);
+    deque->Count++;
+    if (Priority == PH_WORK_QUEUE_PRIORITY_HIGH)
+        _InterlockedIncrement(&WorkQueue->HighPriorityCount);
+    _InterlockedIncrement(&WorkQueue->PendingCount);
+    PhReleaseQueuedLockExclusive(&deque->Lock);
 
     PHLIB_INC_STATISTIC(WqWorkItemsQueued);
 
-    // Check if all worker threads are currently busy, and if we can create more threads.
-    if (WorkQueue->BusyCount >= WorkQueue->CurrentThreads &&
-        WorkQueue->CurrentThreads < WorkQueue->MaximumThreads)
+    PhpSignalWorkQueue(WorkQueue, 1);
+}
+
+/**
+ * Queues multiple work items to a work queue.
+ *
+ * \param WorkQueue A work queue object.
+ * \param Items An array of work item descriptors.
+ * \param Count The number of elements in \a Items.
+ *
+ * \remarks This function is more efficient than calling PhQueueItemWorkQueueEx()
+ * for each item, because each deque is locked at most once and worker threads are
+ * woken with a single semaphore release.
+ */
+VOID PhQueueItemsWorkQueue(
+    _Inout_ PPH_WORK_QUEUE WorkQueue,
+    _In_reads_(Count) PPH_WORK_QUEUE_ITEM_DESCRIPTOR Items,
+    _In_ ULONG Count
+    )
+{
+    ULONG dequeIndex;
+    ULONG itemsPerDeque;
+    ULONG highPriorityCount;
+    ULONG i;
+    ULONG j;
+
+    if (Count == 0)
+        return;
+
+    dequeIndex = PhpGetSubmitDequeIndex(WorkQueue);
+
+    // Items queued from a worker thread stay in its deque, where they can be stolen
+    // by other workers. Otherwise spread the items across all deques.
+    if (WorkQueue->NumberOfDeques == 1 ||
+        (PhWorkQueueWorkerTlsIndex != TLS_OUT_OF_INDEXES && PhpGetTlsValue(PhWorkQueueWorkerTlsIndex)))
+        itemsPerDeque = Count;
+    else
+        itemsPerDeque = (Count + WorkQueue->NumberOfDeques - 1) / WorkQueue->NumberOfDeques;
+
+    _InterlockedExchangeAdd((PLONG)&WorkQueue->BusyCount, Count);
+
+    for (i = 0; i < Count; i += itemsPerDeque)
     {
-        // Lock and re-check.
-        PhAcquireQueuedLockExclusive(&WorkQueue->StateLock);
+        PPH_WORK_QUEUE_DEQUE deque;
+        ULONG end;
 
-        if (WorkQueue->CurrentThreads < WorkQueue->MaximumThreads)
-            PhpCreateWorkQueueThread(WorkQueue);
+        deque = &WorkQueue->Deques[dequeIndex];
+        end = min(i + itemsPerDeque, Count);
+        highPriorityCount = 0;
 
-        PhReleaseQueuedLockExclusive(&WorkQueue->StateLock);
+        PhAcquireQueuedLockExclusive(&deque->Lock);
+
+        for (j = i; j < end; j++)
+        {
+            PPH_WORK_QUEUE_ITEM workQueueItem;
+
+            assert(Items[j].Priority < PH_WORK_QUEUE_PRIORITY_COUNT);
+
+            workQueueItem = PhpCreateWorkQueueItem(Items[j].Function, Items[j].Context, Items[j].DeleteFunction);
+            InsertTailList(&deque->ListHeads[Items[j].Priority], &workQueueItem->ListEntry);
+
+            if (Items[j].Priority == PH_WORK_QUEUE_PRIORITY_HIGH)
+                highPriorityCount++;
+        }
+
+        deque->Count += end - i;
+        if (highPriorityCount != 0)
+            _InterlockedExchangeAdd((PLONG)&WorkQueue->HighPriorityCount, highPriorityCount);
+        _InterlockedExchangeAdd((PLONG)&WorkQueue->PendingCount, end - i);
+
+        PhReleaseQueuedLockExclusive(&deque->Lock);
+
+        dequeIndex = (dequeIndex + 1) % WorkQueue->NumberOfDeques;
+    }
+
+#ifdef DEBUG
+    for (i = 0; i < Count; i++)
+        PHLIB_INC_STATISTIC(WqWorkItemsQueued);
+#endif
+
+    PhpSignalWorkQueue(WorkQueue, Count);
+}
+
+FORCEINLINE VOID PhpInitializeGlobalWorkQueue(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhGlobalWorkQueueInitOnce))
+    {
+        PhInitializeWorkQueueEx(
+            &PhGlobalWorkQueue,
+            0,
+            3,
+            1000,
+            PH_WORK_QUEUE_WORK_STEALING
+            );
+        PhEndInitOnce(&PhGlobalWorkQueueInitOnce);
     }
 }
 
@@ -423,20 +804,45 @@ VOID PhQueueItemGlobalWorkQueue(
     _In_opt_ PVOID Context
     )
 {
-    if (PhBeginInitOnce(&PhGlobalWorkQueueInitOnce))
-    {
-        PhInitializeWorkQueue(
-            &PhGlobalWorkQueue,
-            0,
-            3,
-            1000
-            );
-        PhEndInitOnce(&PhGlobalWorkQueueInitOnce);
-    }
+    PhQueueItemGlobalWorkQueueEx(Function, Context, PH_WORK_QUEUE_PRIORITY_NORMAL);
+}
 
-    PhQueueItemWorkQueue(
+/**
+ * Queues a work item to the global work queue.
+ *
+ * \param Function A function to execute.
+ * \param Context A user-defined value to pass to the function.
+ * \param Priority The priority of the work item.
+ */
+VOID PhQueueItemGlobalWorkQueueEx(
+    _In_ PUSER_THREAD_START_ROUTINE Function,
+    _In_opt_ PVOID Context,
+    _In_ ULONG Priority
+    )
+{
+    PhpInitializeGlobalWorkQueue();
+
+    PhQueueItemWorkQueueEx(
         &PhGlobalWorkQueue,
         Function,
-        Context
+        Context,
+        NULL,
+        Priority
         );
 }
+
+/**
+ * Queues multiple work items to the global work queue.
+ *
+ * \param Items An array of work item descriptors.
+ * \param Count The number of elements in \a Items.
+ */
+VOID PhQueueItemsGlobalWorkQueue(
+    _In_reads_(Count) PPH_WORK_QUEUE_ITEM_DESCRIPTOR Items,
+    _In_ ULONG Count
+    )
+{
+    PhpInitializeGlobalWorkQueue();
+
+    PhQueueItemsWorkQueue(&PhGlobalWorkQueue, Items, Count);
+}
@@ -53,7 +53,7 @@ BOOLEAN EtDiskEnabled = FALSE;
 
 PPH_OBJECT_TYPE EtDiskItemType;
 PPH_HASHTABLE EtDiskHashtable;
-PH_QUEUED_LOCK EtDiskHashtableLock = PH_QUEUED_LOCK_INIT;
+PH_READ_MOSTLY_LOCK EtDiskHashtableLock = PH_READ_MOSTLY_LOCK_INIT;
 LIST_ENTRY EtDiskAgeListHead;
 PH_CALLBACK_DECLARE(EtDiskItemAddedEvent);
 PH_CALLBACK_DECLARE(EtDiskItemModifiedEvent);
@@ -75,15 +75,16 @@ VOID EtInitializeDiskInformation(
     LARGE_INTEGER performanceCounter;
 
     EtDiskItemType = PhCreateObjectType(L"DiskItem", 0, EtpDiskItemDeleteProcedure);
-    EtDiskHashtable = PhCreateHashtable(
+    EtDiskHashtable = PhCreateHashtableEx(
         sizeof(PET_DISK_ITEM),
         EtpDiskHashtableCompareFunction,
         EtpDiskHashtableHashFunction,
-        128
+        128,
+        PH_HASHTABLE_OPEN_ADDRESSING
         );
     InitializeListHead(&EtDiskAgeListHead);
 
-    PhInitializeFreeList(&EtDiskPacketFreeList, sizeof(ETP_DISK_PACKET), 64);
+    PhInitializeFreeListEx(&EtDiskPacketFreeList, sizeof(ETP_DISK_PACKET), 64, PH_FREE_LIST_USE_MAGAZINES);
     RtlInitializeSListHead(&EtDiskPacketListHead);
     EtFileNameHashtable = PhCreateSimpleHashtable(128);
 
@@ -111,6 +112,11 @@ PET_DISK_ITEM EtCreateDiskItem(
     diskItem = PhCreateObject(sizeof(ET_DISK_ITEM), EtDiskItemType);
     memset(diskItem, 0, sizeof(ET_DISK_ITEM));
 
+    PhInitializeCircularBuffer_ULONG64(&diskItem->ReadHistory, HISTORY_SIZE);
+    PhInitializeCircularBuffer_ULONG64(&diskItem->WriteHistory, HISTORY_SIZE);
+    PhInitializeCircularBufferStatistics_ULONG64(&diskItem->ReadStatistics, HISTORY_SIZE, PH_CIRCULAR_BUFFER_STATISTICS_SUM);
+    PhInitializeCircularBufferStatistics_ULONG64(&diskItem->WriteStatistics, HISTORY_SIZE, PH_CIRCULAR_BUFFER_STATISTICS_SUM);
+
     return diskItem;
 }
 
@@ -126,6 +132,11 @@ VOID NTAPI EtpDiskItemDeleteProcedure(
     if (diskItem->ProcessName) PhDereferenceObject(diskItem->ProcessName);
     if (diskItem->ProcessIcon) EtProcIconDereferenceProcessIcon(diskItem->ProcessIcon);
     if (diskItem->ProcessRecord) PhDereferenceProcessRecord(diskItem->ProcessRecord);
+
+    PhDeleteCircularBufferStatistics_ULONG64(&diskItem->ReadStatistics);
+    PhDeleteCircularBufferStatistics_ULONG64(&diskItem->WriteStatistics);
+    PhDeleteCircularBuffer_ULONG64(&diskItem->ReadHistory);
+    PhDeleteCircularBuffer_ULONG64(&diskItem->WriteHistory);
 }
 
 BOOLEAN NTAPI EtpDiskHashtableCompareFunction(
@@ -145,7 +156,7 @@ ULONG NTAPI EtpDiskHashtableHashFunction(
 {
     PET_DISK_ITEM diskItem = *(PET_DISK_ITEM *)Entry;
 
-    return (HandleToUlong(diskItem->ProcessId) / 4) ^ PhHashStringRef(&diskItem->FileName->sr, TRUE);
+    return (HandleToUlong(diskItem->ProcessId) / 4) ^ PhHashStringRefEx(&diskItem->FileName->sr, TRUE, WordHashAlgorithm);
 }
 
 PET_DISK_ITEM EtReferenceDiskItem(
@@ -161,7 +172,7 @@ PET_DISK_ITEM EtReferenceDiskItem(
     lookupDiskItem.ProcessId = ProcessId;
     lookupDiskItem.FileName = FileName;
 
-    PhAcquireQueuedLockShared(&EtDiskHashtableLock);
+    PhAcquireReadMostlyLockShared(&EtDiskHashtableLock);
 
     diskItemPtr = (PET_DISK_ITEM *)PhFindEntryHashtable(
         EtDiskHashtable,
@@ -173,7 +184,7 @@ PET_DISK_ITEM EtReferenceDiskItem(
     else
         diskItem = NULL;
 
-    PhReleaseQueuedLockShared(&EtDiskHashtableLock);
+    PhReleaseReadMostlyLockShared(&EtDiskHashtableLock);
 
     return diskItem;
 }
@@ -297,8 +308,8 @@ VOID EtpProcessDiskPacket(
         diskItem = EtCreateDiskItem();
 
         diskItem->ProcessId = diskEvent->ClientId.UniqueProcess;
-        PhSetReference(&diskItem->FileName, Packet->FileName);
-        diskItem->FileNameWin32 = PhGetFileName(diskItem->FileName);
+        diskItem->FileName = PhInternStringRef(&Packet->FileName->sr);
+        diskItem->FileNameWin32 = PhInternString(PhGetFileName(diskItem->FileName));
 
         if (processItem = PhReferenceProcessItem(diskItem->ProcessId))
         {
@@ -316,9 +327,9 @@ VOID EtpProcessDiskPacket(
         InsertHeadList(&EtDiskAgeListHead, &diskItem->AgeListEntry);
 
         // Add the disk item to the hashtable.
-        PhAcquireQueuedLockExclusive(&EtDiskHashtableLock);
+        PhAcquireReadMostlyLockExclusive(&EtDiskHashtableLock);
         PhAddEntryHashtable(EtDiskHashtable, &diskItem);
-        PhReleaseQueuedLockExclusive(&EtDiskHashtableLock);
+        PhReleaseReadMostlyLockExclusive(&EtDiskHashtableLock);
 
         // Raise the disk item added event.
         PhInvokeCallback(&EtDiskItemAddedEvent, diskItem);
@@ -361,41 +372,6 @@ VOID EtpProcessDiskPacket(
     }
 }
 
-ULONG64 EtpCalculateAverage(
-    _In_ PULONG64 Buffer,
-    _In_ ULONG BufferSize,
-    _In_ ULONG BufferPosition,
-    _In_ ULONG BufferCount,
-    _In_ ULONG NumberToConsider
-    )
-{
-    ULONG64 sum;
-    ULONG i;
-    ULONG count;
-
-    sum = 0;
-    i = BufferPosition;
-
-    if (NumberToConsider > BufferCount)
-        NumberToConsider = BufferCount;
-
-    if (NumberToConsider == 0)
-        return 0;
-
-    count = NumberToConsider;
-
-    do
-    {
-        sum += Buffer[i];
-        i++;
-
-        if (i == BufferSize)
-            i = 0;
-    } while (--count != 0);
-
-    return sum / NumberToConsider;
-}
-
 static VOID NTAPI ProcessesUpdatedCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -441,9 +417,9 @@ static VOID NTAPI ProcessesUpdatedCallback(
 
         PhInvokeCallback(&EtDiskItemRemovedEvent, diskItem);
 
-        PhAcquireQueuedLockExclusive(&EtDiskHashtableLock);
+        PhAcquireReadMostlyLockExclusive(&EtDiskHashtableLock);
         EtpRemoveDiskItem(diskItem);
-        PhReleaseQueuedLockExclusive(&EtDiskHashtableLock);
+        PhReleaseReadMostlyLockExclusive(&EtDiskHashtableLock);
     }
 
     // Update existing items.
@@ -458,16 +434,8 @@ static VOID NTAPI ProcessesUpdatedCallback(
 
         // Update statistics.
 
-        if (diskItem->HistoryPosition != 0)
-            diskItem->HistoryPosition--;
-        else
-            diskItem->HistoryPosition = HISTORY_SIZE - 1;
-
-        diskItem->ReadHistory[diskItem->HistoryPosition] = diskItem->ReadDelta;
-        diskItem->WriteHistory[diskItem->HistoryPosition] = diskItem->WriteDelta;
-
-        if (diskItem->HistoryCount < HISTORY_SIZE)
-            diskItem->HistoryCount++;
+        PhAddItemCircularBufferEx_ULONG64(&diskItem->ReadHistory, &diskItem->ReadStatistics, diskItem->ReadDelta);
+        PhAddItemCircularBufferEx_ULONG64(&diskItem->WriteHistory, &diskItem->WriteStatistics, diskItem->WriteDelta);
 
         if (diskItem->ResponseTimeCount != 0)
         {
@@ -485,8 +453,8 @@ static VOID NTAPI ProcessesUpdatedCallback(
         diskItem->WriteTotal += diskItem->WriteDelta;
         diskItem->ReadDelta = 0;
         diskItem->WriteDelta = 0;
-        diskItem->ReadAverage = EtpCalculateAverage(diskItem->ReadHistory, HISTORY_SIZE, diskItem->HistoryPosition, diskItem->HistoryCount, HISTORY_SIZE);
-        diskItem->WriteAverage = EtpCalculateAverage(diskItem->WriteHistory, HISTORY_SIZE, diskItem->HistoryPosition, diskItem->HistoryCount, HISTORY_SIZE);
+        diskItem->ReadAverage = PhGetMeanCircularBufferStatistics_ULONG64(&diskItem->ReadStatistics);
+        diskItem->WriteAverage = PhGetMeanCircularBufferStatistics_ULONG64(&diskItem->WriteStatistics);
 
         if (diskItem->AddTime != runCount)
         {
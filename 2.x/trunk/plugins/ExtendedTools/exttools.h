@@ -56,10 +56,10 @@ typedef struct _ET_DISK_ITEM
     ULONG64 ReadAverage;
     ULONG64 WriteAverage;
 
-    ULONG64 ReadHistory[HISTORY_SIZE];
-    ULONG64 WriteHistory[HISTORY_SIZE];
-    ULONG HistoryCount;
-    ULONG HistoryPosition;
+    PH_CIRCULAR_BUFFER_ULONG64 ReadHistory;
+    PH_CIRCULAR_BUFFER_ULONG64 WriteHistory;
+    PH_CIRCULAR_BUFFER_STATISTICS_ULONG64 ReadStatistics;
+    PH_CIRCULAR_BUFFER_STATISTICS_ULONG64 WriteStatistics;
 } ET_DISK_ITEM, *PET_DISK_ITEM;
 
 // Disk node
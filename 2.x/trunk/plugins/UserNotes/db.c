@@ -67,7 +67,7 @@ ULONG NTAPI ObjectDbHashFunction(
 {
     PDB_OBJECT object = *(PDB_OBJECT *)Entry;
 
-    return object->Tag + PhHashStringRef(&object->Key, TRUE);
+    return object->Tag + PhHashStringRefEx(&object->Key, TRUE, WordHashAlgorithm);
 }
 
 ULONG GetNumberOfDbObjects(
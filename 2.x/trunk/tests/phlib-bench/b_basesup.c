@@ -0,0 +1,294 @@
+#include "bench.h"
+
+#define BENCH_TEXT_LENGTH 256
+
+typedef struct _BENCH_TEXT_CONTEXT
+{
+    WCHAR Utf16Ascii[BENCH_TEXT_LENGTH];
+    WCHAR Utf16Mixed[BENCH_TEXT_LENGTH];
+    CHAR Utf8Ascii[BENCH_TEXT_LENGTH * 3];
+    SIZE_T Utf8AsciiLength;
+    CHAR Utf8Mixed[BENCH_TEXT_LENGTH * 3];
+    SIZE_T Utf8MixedLength;
+    WCHAR Utf16Buffer[BENCH_TEXT_LENGTH];
+    CHAR Utf8Buffer[BENCH_TEXT_LENGTH * 3];
+} BENCH_TEXT_CONTEXT, *PBENCH_TEXT_CONTEXT;
+
+static VOID NTAPI BenchStringBuilderAppend(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    static PH_STRINGREF text = PH_STRINGREF_INIT(L"C:\\Windows\\System32\\");
+    PH_STRING_BUILDER sb;
+    ULONG i;
+
+    PhInitializeStringBuilder(&sb, 16);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhAppendStringBuilder(&sb, &text);
+        PhAppendCharStringBuilder(&sb, ';');
+    }
+
+    PhDeleteStringBuilder(&sb);
+}
+
+static VOID NTAPI BenchStringBuilderFormat(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PH_STRING_BUILDER sb;
+    ULONG i;
+
+    PhInitializeStringBuilder(&sb, 16);
+
+    for (i = 0; i < Context->Size; i++)
+        PhAppendFormatStringBuilder(&sb, L"%u: 0x%Ix, ", i, (ULONG_PTR)i * 4096);
+
+    PhDeleteStringBuilder(&sb);
+}
+
+static VOID NTAPI BenchFormatIntegers(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PH_FORMAT format[5];
+    PPH_STRING string;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhInitFormatS(&format[0], L"PID ");
+        PhInitFormatU(&format[1], i);
+        PhInitFormatS(&format[2], L" at 0x");
+        PhInitFormatIX(&format[3], (ULONG_PTR)i * 4096);
+        PhInitFormatSize(&format[4], (ULONG64)i * 1024 * 1024);
+
+        string = PhFormat(format, 5, 64);
+        PhDereferenceObject(string);
+    }
+}
+
+static VOID NTAPI BenchFormatDoubles(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PH_FORMAT format[3];
+    PPH_STRING string;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhInitFormatF(&format[0], (DOUBLE)i / 7, 2);
+        PhInitFormatC(&format[1], '%');
+        PhInitFormatE(&format[2], (DOUBLE)i * 1234.5678, 3);
+
+        string = PhFormat(format, 3, 32);
+        PhDereferenceObject(string);
+    }
+}
+
+#define BENCH_CELL_COUNT 16
+
+static VOID NTAPI BenchFormatCellsString(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_STRING cells[BENCH_CELL_COUNT] = { 0 };
+    PH_FORMAT format;
+    ULONG i;
+    ULONG j;
+
+    // The way tree list callbacks used to update their cell text.
+    for (i = 0; i < Context->Size; i++)
+    {
+        for (j = 0; j < BENCH_CELL_COUNT; j++)
+        {
+            PhInitFormatSize(&format, (ULONG64)(i + j) * 4096);
+            PhMoveReference((PVOID *)&cells[j], PhFormat(&format, 1, 0));
+        }
+    }
+
+    for (j = 0; j < BENCH_CELL_COUNT; j++)
+        PhClearReference((PVOID *)&cells[j]);
+}
+
+static VOID NTAPI BenchFormatCellsSlot(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PH_FORMAT_SLOT cells[BENCH_CELL_COUNT];
+    PH_STRINGREF text;
+    PH_FORMAT format;
+    ULONG i;
+    ULONG j;
+
+    for (j = 0; j < BENCH_CELL_COUNT; j++)
+        PhInitializeFormatSlot(&cells[j]);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        for (j = 0; j < BENCH_CELL_COUNT; j++)
+        {
+            PhInitFormatSize(&format, (ULONG64)(i + j) * 4096);
+            PhFormatToSlot(&cells[j], &format, 1, &text);
+        }
+    }
+
+    for (j = 0; j < BENCH_CELL_COUNT; j++)
+        PhDeleteFormatSlot(&cells[j]);
+}
+
+static VOID NTAPI BenchTextSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context;
+    ULONG i;
+
+    context = PhAllocate(sizeof(BENCH_TEXT_CONTEXT));
+
+    for (i = 0; i < BENCH_TEXT_LENGTH; i++)
+    {
+        context->Utf16Ascii[i] = 'a' + i % 26;
+        // Mostly ASCII with occasional Latin-1, Greek and CJK characters.
+        context->Utf16Mixed[i] = i % 16 == 5 ? 0xe9 : (i % 16 == 9 ? 0x3b1 : (i % 32 == 13 ? 0x4e2d : 'a' + i % 26));
+    }
+
+    PhConvertUtf16ToUtf8Buffer(context->Utf8Ascii, sizeof(context->Utf8Ascii), &context->Utf8AsciiLength,
+        context->Utf16Ascii, sizeof(context->Utf16Ascii));
+    PhConvertUtf16ToUtf8Buffer(context->Utf8Mixed, sizeof(context->Utf8Mixed), &context->Utf8MixedLength,
+        context->Utf16Mixed, sizeof(context->Utf16Mixed));
+
+    Context->Parameter = context;
+}
+
+static VOID NTAPI BenchTextCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PhFree(Context->Parameter);
+}
+
+static VOID NTAPI BenchUtf8ToUtf16Ascii(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhConvertUtf8ToUtf16Buffer(context->Utf16Buffer, sizeof(context->Utf16Buffer), NULL,
+            context->Utf8Ascii, context->Utf8AsciiLength);
+    }
+}
+
+static VOID NTAPI BenchUtf8ToUtf16Mixed(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhConvertUtf8ToUtf16Buffer(context->Utf16Buffer, sizeof(context->Utf16Buffer), NULL,
+            context->Utf8Mixed, context->Utf8MixedLength);
+    }
+}
+
+static VOID NTAPI BenchUtf16ToUtf8Ascii(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhConvertUtf16ToUtf8Buffer(context->Utf8Buffer, sizeof(context->Utf8Buffer), NULL,
+            context->Utf16Ascii, sizeof(context->Utf16Ascii));
+    }
+}
+
+static VOID NTAPI BenchUtf16ToUtf8Mixed(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhConvertUtf16ToUtf8Buffer(context->Utf8Buffer, sizeof(context->Utf8Buffer), NULL,
+            context->Utf16Mixed, sizeof(context->Utf16Mixed));
+    }
+}
+
+static VOID NTAPI BenchFindString(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    PH_STRINGREF string;
+    PH_STRINGREF subString;
+    ULONG i;
+
+    string.Buffer = context->Utf16Ascii;
+    string.Length = sizeof(context->Utf16Ascii);
+    // The last occurrence of "uvwxyz" starts 16 characters from the end.
+    subString.Buffer = context->Utf16Ascii + BENCH_TEXT_LENGTH - 16;
+    subString.Length = 6 * sizeof(WCHAR);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        if (PhFindStringInStringRef(&string, &subString, FALSE) == -1)
+            assert(FALSE);
+    }
+}
+
+static VOID NTAPI BenchFindStringIgnoreCase(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_TEXT_CONTEXT context = Context->Parameter;
+    PH_STRINGREF string;
+    PH_STRINGREF subString;
+    ULONG i;
+
+    string.Buffer = context->Utf16Ascii;
+    string.Length = sizeof(context->Utf16Ascii);
+    PhInitializeStringRef(&subString, L"UVWXYZ");
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        if (PhFindStringInStringRef(&string, &subString, TRUE) == -1)
+            assert(FALSE);
+    }
+}
+
+VOID Bench_basesup(
+    VOID
+    )
+{
+    static BENCH_DESCRIPTOR descriptors[] =
+    {
+        { "stringbuilder.append", 0, NULL, BenchStringBuilderAppend, NULL },
+        { "stringbuilder.format", 0, NULL, BenchStringBuilderFormat, NULL },
+        { "format.integers", 0, NULL, BenchFormatIntegers, NULL },
+        { "format.doubles", 0, NULL, BenchFormatDoubles, NULL },
+        { "format.cells.string", 0, NULL, BenchFormatCellsString, NULL },
+        { "format.cells.slot", 0, NULL, BenchFormatCellsSlot, NULL },
+        { "utf8to16.ascii", 0, BenchTextSetup, BenchUtf8ToUtf16Ascii, BenchTextCleanup },
+        { "utf8to16.mixed", 0, BenchTextSetup, BenchUtf8ToUtf16Mixed, BenchTextCleanup },
+        { "utf16to8.ascii", 0, BenchTextSetup, BenchUtf16ToUtf8Ascii, BenchTextCleanup },
+        { "utf16to8.mixed", 0, BenchTextSetup, BenchUtf16ToUtf8Mixed, BenchTextCleanup },
+        { "findstring.case", 0, BenchTextSetup, BenchFindString, BenchTextCleanup },
+        { "findstring.ignorecase", 0, BenchTextSetup, BenchFindStringIgnoreCase, BenchTextCleanup }
+    };
+    ULONG i;
+
+    for (i = 0; i < RTL_NUMBER_OF(descriptors); i++)
+        BenchRegister(&descriptors[i]);
+}
@@ -0,0 +1,451 @@
+#include "bench.h"
+
+typedef struct _BENCH_AVL_ELEMENT
+{
+    PH_AVL_LINKS Links;
+    ULONG Key;
+} BENCH_AVL_ELEMENT, *PBENCH_AVL_ELEMENT;
+
+typedef struct _BENCH_AVL_CONTEXT
+{
+    PH_AVL_TREE Tree;
+    PBENCH_AVL_ELEMENT Elements;
+} BENCH_AVL_CONTEXT, *PBENCH_AVL_CONTEXT;
+
+/** Scatters sequential indices so that keys are inserted in a random-looking order. */
+FORCEINLINE ULONG BenchKey(
+    _In_ ULONG Index
+    )
+{
+    return Index * 2654435761UL;
+}
+
+static BOOLEAN NTAPI BenchHashtableEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return *(PULONG)Entry1 == *(PULONG)Entry2;
+}
+
+static ULONG NTAPI BenchHashtableHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashInt32(*(PULONG)Entry);
+}
+
+static LONG NTAPI BenchAvlCompareFunction(
+    _In_ PPH_AVL_LINKS Links1,
+    _In_ PPH_AVL_LINKS Links2
+    )
+{
+    PBENCH_AVL_ELEMENT element1 = CONTAINING_RECORD(Links1, BENCH_AVL_ELEMENT, Links);
+    PBENCH_AVL_ELEMENT element2 = CONTAINING_RECORD(Links2, BENCH_AVL_ELEMENT, Links);
+
+    return uintcmp(element1->Key, element2->Key);
+}
+
+static VOID NTAPI BenchHashtableAdd(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable;
+    ULONG key;
+    ULONG i;
+
+    hashtable = PhCreateHashtable(sizeof(ULONG), BenchHashtableEqualFunction, BenchHashtableHashFunction, 16);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        key = BenchKey(i);
+        PhAddEntryHashtable(hashtable, &key);
+    }
+
+    PhDereferenceObject(hashtable);
+}
+
+static VOID NTAPI BenchHashtableSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable;
+    ULONG key;
+    ULONG i;
+
+    hashtable = PhCreateHashtable(sizeof(ULONG), BenchHashtableEqualFunction, BenchHashtableHashFunction, 16);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        key = BenchKey(i);
+        PhAddEntryHashtable(hashtable, &key);
+    }
+
+    Context->Parameter = hashtable;
+}
+
+static VOID NTAPI BenchHashtableFind(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable = Context->Parameter;
+    ULONG key;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        key = BenchKey(i);
+
+        if (!PhFindEntryHashtable(hashtable, &key))
+            assert(FALSE);
+    }
+}
+
+static VOID NTAPI BenchHashtableRemoveAdd(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable = Context->Parameter;
+    ULONG key;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        key = BenchKey(i);
+        PhRemoveEntryHashtable(hashtable, &key);
+        PhAddEntryHashtable(hashtable, &key);
+    }
+}
+
+static VOID NTAPI BenchHashtableCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PhDereferenceObject(Context->Parameter);
+}
+
+static VOID NTAPI BenchSimpleHashtableAdd(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable;
+    ULONG i;
+
+    hashtable = PhCreateSimpleHashtable(16);
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddItemSimpleHashtable(hashtable, (PVOID)(ULONG_PTR)BenchKey(i), NULL);
+
+    PhDereferenceObject(hashtable);
+}
+
+static VOID NTAPI BenchSimpleHashtableSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable;
+    ULONG i;
+
+    hashtable = PhCreateSimpleHashtable(16);
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddItemSimpleHashtable(hashtable, (PVOID)(ULONG_PTR)BenchKey(i), NULL);
+
+    Context->Parameter = hashtable;
+}
+
+static VOID NTAPI BenchSimpleHashtableFind(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_HASHTABLE hashtable = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        if (!PhFindItemSimpleHashtable(hashtable, (PVOID)(ULONG_PTR)BenchKey(i)))
+            assert(FALSE);
+    }
+}
+
+static VOID NTAPI BenchAvlSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_AVL_CONTEXT context;
+    ULONG i;
+
+    context = PhAllocate(sizeof(BENCH_AVL_CONTEXT));
+    PhInitializeAvlTree(&context->Tree, BenchAvlCompareFunction);
+    context->Elements = PhAllocate(sizeof(BENCH_AVL_ELEMENT) * Context->Size);
+
+    for (i = 0; i < Context->Size; i++)
+        context->Elements[i].Key = BenchKey(i);
+
+    Context->Parameter = context;
+}
+
+static VOID NTAPI BenchAvlAddRemove(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_AVL_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddElementAvlTree(&context->Tree, &context->Elements[i].Links);
+
+    for (i = 0; i < Context->Size; i++)
+        PhRemoveElementAvlTree(&context->Tree, &context->Elements[i].Links);
+}
+
+static VOID NTAPI BenchAvlFindSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_AVL_CONTEXT context;
+    ULONG i;
+
+    BenchAvlSetup(Context);
+    context = Context->Parameter;
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddElementAvlTree(&context->Tree, &context->Elements[i].Links);
+}
+
+static VOID NTAPI BenchAvlFind(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_AVL_CONTEXT context = Context->Parameter;
+    BENCH_AVL_ELEMENT lookupElement;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        lookupElement.Key = BenchKey(i);
+
+        if (!PhFindElementAvlTree(&context->Tree, &lookupElement.Links))
+            assert(FALSE);
+    }
+}
+
+static VOID NTAPI BenchAvlCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_AVL_CONTEXT context = Context->Parameter;
+
+    PhFree(context->Elements);
+    PhFree(context);
+}
+
+static VOID NTAPI BenchBTreeSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_BTREE tree;
+
+    tree = PhAllocate(sizeof(PH_BTREE));
+    PhInitializeBTree(tree);
+    Context->Parameter = tree;
+}
+
+static VOID NTAPI BenchBTreeAddRemove(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_BTREE tree = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddElementBTree(tree, BenchKey(i), NULL, NULL);
+
+    for (i = 0; i < Context->Size; i++)
+        PhRemoveElementBTree(tree, BenchKey(i), NULL);
+}
+
+static VOID NTAPI BenchBTreeFindSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_BTREE tree;
+    ULONG i;
+
+    BenchBTreeSetup(Context);
+    tree = Context->Parameter;
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddElementBTree(tree, BenchKey(i), NULL, NULL);
+}
+
+static VOID NTAPI BenchBTreeFind(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_BTREE tree = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        if (!PhFindElementBTree(tree, BenchKey(i), NULL))
+            assert(FALSE);
+    }
+}
+
+static VOID NTAPI BenchBTreeBuild(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PPH_BTREE tree = Context->Parameter;
+    PULONG64 keys;
+    ULONG i;
+
+    // Ascending keys, as they come from a sequential scan of an address space.
+
+    keys = PhAllocate(Context->Size * sizeof(ULONG64));
+
+    for (i = 0; i < Context->Size; i++)
+        keys[i] = (ULONG64)i * 0x10000;
+
+    PhBuildBTree(tree, keys, NULL, Context->Size);
+    PhFree(keys);
+}
+
+static VOID NTAPI BenchBTreeCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PhDeleteBTree(Context->Parameter);
+    PhFree(Context->Parameter);
+}
+
+typedef struct _BENCH_SORT_NODE
+{
+    ULONG_PTR Handle;
+    PVOID Object;
+} BENCH_SORT_NODE, *PBENCH_SORT_NODE;
+
+typedef struct _BENCH_SORT_CONTEXT
+{
+    PBENCH_SORT_NODE *Original;
+    PBENCH_SORT_NODE *Nodes;
+} BENCH_SORT_CONTEXT, *PBENCH_SORT_CONTEXT;
+
+static int __cdecl BenchSortCompareFunction(
+    _In_ void *Context,
+    _In_ const void *Element1,
+    _In_ const void *Element2
+    )
+{
+    PBENCH_SORT_NODE node1 = *(PBENCH_SORT_NODE *)Element1;
+    PBENCH_SORT_NODE node2 = *(PBENCH_SORT_NODE *)Element2;
+    int result;
+
+    result = uintptrcmp((ULONG_PTR)node1->Object, (ULONG_PTR)node2->Object);
+
+    if (result == 0)
+        result = uintptrcmp(node1->Handle, node2->Handle);
+
+    return PhModifySort(result, AscendingSortOrder);
+}
+
+static VOID NTAPI BenchSortSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SORT_CONTEXT context;
+    PBENCH_SORT_NODE node;
+    ULONG i;
+
+    context = PhAllocate(sizeof(BENCH_SORT_CONTEXT));
+    context->Original = PhAllocate(sizeof(PBENCH_SORT_NODE) * Context->Size);
+    context->Nodes = PhAllocate(sizeof(PBENCH_SORT_NODE) * Context->Size);
+
+    // Allocate the nodes separately, like tree list nodes. The object addresses are in
+    // pseudo-random order.
+    for (i = 0; i < Context->Size; i++)
+    {
+        node = PhAllocate(sizeof(BENCH_SORT_NODE));
+        node->Handle = (ULONG_PTR)i * 4;
+        node->Object = (PVOID)(0xffff800000000000 | ((ULONG_PTR)BenchKey(i) << 4));
+        context->Original[i] = node;
+    }
+
+    Context->Parameter = context;
+}
+
+static VOID NTAPI BenchSortQsort(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SORT_CONTEXT context = Context->Parameter;
+
+    memcpy(context->Nodes, context->Original, sizeof(PBENCH_SORT_NODE) * Context->Size);
+    qsort_s(context->Nodes, Context->Size, sizeof(PVOID), BenchSortCompareFunction, NULL);
+}
+
+static VOID NTAPI BenchSortKeys(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SORT_CONTEXT context = Context->Parameter;
+    PPH_SORT_KEY keys;
+    ULONG i;
+
+    keys = PhAllocate(sizeof(PH_SORT_KEY) * Context->Size);
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        keys[i].Key = (ULONG_PTR)context->Original[i]->Object;
+        keys[i].TieKey = context->Original[i]->Handle;
+        keys[i].Item = context->Original[i];
+    }
+
+    PhSortKeys(keys, Context->Size, AscendingSortOrder, NULL, NULL);
+
+    for (i = 0; i < Context->Size; i++)
+        context->Nodes[i] = keys[i].Item;
+
+    PhFree(keys);
+}
+
+static VOID NTAPI BenchSortCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SORT_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+        PhFree(context->Original[i]);
+
+    PhFree(context->Nodes);
+    PhFree(context->Original);
+    PhFree(context);
+}
+
+VOID Bench_collect(
+    VOID
+    )
+{
+    static BENCH_DESCRIPTOR descriptors[] =
+    {
+        { "hashtable.add", 0, NULL, BenchHashtableAdd, NULL },
+        { "hashtable.find", 0, BenchHashtableSetup, BenchHashtableFind, BenchHashtableCleanup },
+        { "hashtable.remove_add", 0, BenchHashtableSetup, BenchHashtableRemoveAdd, BenchHashtableCleanup },
+        { "simplehashtable.add", 0, NULL, BenchSimpleHashtableAdd, NULL },
+        { "simplehashtable.find", 0, BenchSimpleHashtableSetup, BenchSimpleHashtableFind, BenchHashtableCleanup },
+        { "avl.add_remove", 0, BenchAvlSetup, BenchAvlAddRemove, BenchAvlCleanup },
+        { "avl.find", 0, BenchAvlFindSetup, BenchAvlFind, BenchAvlCleanup },
+        { "btree.add_remove", 0, BenchBTreeSetup, BenchBTreeAddRemove, BenchBTreeCleanup },
+        { "btree.find", 0, BenchBTreeFindSetup, BenchBTreeFind, BenchBTreeCleanup },
+        { "btree.build", 0, BenchBTreeSetup, BenchBTreeBuild, BenchBTreeCleanup },
+        { "sort.qsort", 0, BenchSortSetup, BenchSortQsort, BenchSortCleanup },
+        { "sort.keys", 0, BenchSortSetup, BenchSortKeys, BenchSortCleanup }
+    };
+    ULONG i;
+
+    for (i = 0; i < RTL_NUMBER_OF(descriptors); i++)
+        BenchRegister(&descriptors[i]);
+}
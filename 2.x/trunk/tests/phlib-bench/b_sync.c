@@ -0,0 +1,508 @@
+#include "bench.h"
+
+#define BENCH_CIRCULAR_BUFFER_SIZE 1024
+// One in this many iterations of the mixed lock benchmarks is an exclusive acquire.
+#define BENCH_LOCK_WRITE_INTERVAL 1000
+
+typedef struct _BENCH_SYNC_CONTEXT
+{
+    union
+    {
+        PH_FREE_LIST FreeList;
+        PH_QUEUED_LOCK QueuedLock;
+        PH_FAST_LOCK FastLock;
+        PH_READ_MOSTLY_LOCK ReadMostlyLock;
+        PH_CIRCULAR_BUFFER_ULONG CircularBuffer;
+    };
+    PH_CIRCULAR_BUFFER_STATISTICS_ULONG CircularBufferStatistics;
+    volatile ULONG Counter;
+    ULONG CopyBuffer[BENCH_CIRCULAR_BUFFER_SIZE];
+} BENCH_SYNC_CONTEXT, *PBENCH_SYNC_CONTEXT;
+
+static PBENCH_SYNC_CONTEXT BenchCreateSyncContext(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context;
+
+    context = PhAllocate(sizeof(BENCH_SYNC_CONTEXT));
+    memset(context, 0, sizeof(BENCH_SYNC_CONTEXT));
+    Context->Parameter = context;
+
+    return context;
+}
+
+static VOID NTAPI BenchCircularBufferSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+    ULONG i;
+
+    PhInitializeCircularBuffer_ULONG(&context->CircularBuffer, BENCH_CIRCULAR_BUFFER_SIZE);
+
+    for (i = 0; i < BENCH_CIRCULAR_BUFFER_SIZE; i++)
+        PhAddItemCircularBuffer_ULONG(&context->CircularBuffer, i);
+}
+
+static VOID NTAPI BenchCircularBufferAdd(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+        PhAddItemCircularBuffer_ULONG(&context->CircularBuffer, i);
+}
+
+static VOID NTAPI BenchCircularBufferCopy(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhCopyCircularBuffer_ULONG(&context->CircularBuffer, context->CopyBuffer, BENCH_CIRCULAR_BUFFER_SIZE);
+    }
+}
+
+static VOID NTAPI BenchCircularBufferStatisticsScan(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+    ULONG i;
+    ULONG j;
+    ULONG64 sum;
+    ULONG max;
+    ULONG value;
+
+    // Add an item and recalculate the mean and maximum by walking the buffer.
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhAddItemCircularBuffer_ULONG(&context->CircularBuffer, i * 2654435761);
+
+        sum = 0;
+        max = 0;
+
+        for (j = 0; j < context->CircularBuffer.Count; j++)
+        {
+            value = PhGetItemCircularBuffer_ULONG(&context->CircularBuffer, j);
+            sum += value;
+
+            if (max < value)
+                max = value;
+        }
+
+        context->Counter += (ULONG)(sum / context->CircularBuffer.Count) + max;
+    }
+}
+
+static VOID NTAPI BenchCircularBufferStatisticsSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+    ULONG i;
+
+    PhInitializeCircularBuffer_ULONG(&context->CircularBuffer, BENCH_CIRCULAR_BUFFER_SIZE);
+    PhInitializeCircularBufferStatistics_ULONG(&context->CircularBufferStatistics, BENCH_CIRCULAR_BUFFER_SIZE,
+        PH_CIRCULAR_BUFFER_STATISTICS_SUM | PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM);
+
+    for (i = 0; i < BENCH_CIRCULAR_BUFFER_SIZE; i++)
+        PhAddItemCircularBufferEx_ULONG(&context->CircularBuffer, &context->CircularBufferStatistics, i);
+}
+
+static VOID NTAPI BenchCircularBufferStatisticsRunning(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+    ULONG i;
+
+    for (i = 0; i < Context->Size; i++)
+    {
+        PhAddItemCircularBufferEx_ULONG(&context->CircularBuffer, &context->CircularBufferStatistics, i * 2654435761);
+
+        context->Counter += (ULONG)PhGetMeanCircularBufferStatistics_ULONG(&context->CircularBufferStatistics) +
+            PhGetMaximumCircularBufferStatistics_ULONG(&context->CircularBufferStatistics, BENCH_CIRCULAR_BUFFER_SIZE);
+    }
+}
+
+static VOID NTAPI BenchCircularBufferCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+
+    PhDeleteCircularBuffer_ULONG(&context->CircularBuffer);
+    PhFree(context);
+}
+
+static VOID NTAPI BenchCircularBufferStatisticsCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+
+    PhDeleteCircularBufferStatistics_ULONG(&context->CircularBufferStatistics);
+    BenchCircularBufferCleanup(Context);
+}
+
+static VOID NTAPI BenchFreeListSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+
+    PhInitializeFreeList(&context->FreeList, 64, 1024);
+}
+
+static NTSTATUS BenchFreeListThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    PVOID blocks[8];
+    ULONG i;
+    ULONG j;
+
+    for (i = 0; i < benchContext->Size; i += RTL_NUMBER_OF(blocks))
+    {
+        for (j = 0; j < RTL_NUMBER_OF(blocks); j++)
+            blocks[j] = PhAllocateFromFreeList(&context->FreeList);
+        for (j = 0; j < RTL_NUMBER_OF(blocks); j++)
+            PhFreeToFreeList(&context->FreeList, blocks[j]);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID NTAPI BenchFreeList(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchFreeListThreadStart);
+}
+
+static VOID NTAPI BenchFreeListCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+
+    PhDeleteFreeList(&context->FreeList);
+    PhFree(context);
+}
+
+static VOID NTAPI BenchQueuedLockSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+
+    PhInitializeQueuedLock(&context->QueuedLock);
+}
+
+static NTSTATUS BenchQueuedLockExclusiveThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        PhAcquireQueuedLockExclusive(&context->QueuedLock);
+        context->Counter++;
+        PhReleaseQueuedLockExclusive(&context->QueuedLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS BenchQueuedLockSharedThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        PhAcquireQueuedLockShared(&context->QueuedLock);
+        (VOID)context->Counter;
+        PhReleaseQueuedLockShared(&context->QueuedLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS BenchQueuedLockMixedThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        if (i % BENCH_LOCK_WRITE_INTERVAL == 0)
+        {
+            PhAcquireQueuedLockExclusive(&context->QueuedLock);
+            context->Counter++;
+            PhReleaseQueuedLockExclusive(&context->QueuedLock);
+        }
+        else
+        {
+            PhAcquireQueuedLockShared(&context->QueuedLock);
+            (VOID)context->Counter;
+            PhReleaseQueuedLockShared(&context->QueuedLock);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID NTAPI BenchQueuedLockExclusive(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchQueuedLockExclusiveThreadStart);
+}
+
+static VOID NTAPI BenchQueuedLockShared(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchQueuedLockSharedThreadStart);
+}
+
+static VOID NTAPI BenchQueuedLockMixed(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchQueuedLockMixedThreadStart);
+}
+
+static VOID NTAPI BenchFastLockSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+
+    PhInitializeFastLock(&context->FastLock);
+}
+
+static NTSTATUS BenchFastLockExclusiveThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        PhAcquireFastLockExclusive(&context->FastLock);
+        context->Counter++;
+        PhReleaseFastLockExclusive(&context->FastLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS BenchFastLockSharedThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        PhAcquireFastLockShared(&context->FastLock);
+        (VOID)context->Counter;
+        PhReleaseFastLockShared(&context->FastLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID NTAPI BenchFastLockExclusive(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchFastLockExclusiveThreadStart);
+}
+
+static VOID NTAPI BenchFastLockShared(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchFastLockSharedThreadStart);
+}
+
+static VOID NTAPI BenchFastLockCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+
+    PhDeleteFastLock(&context->FastLock);
+    PhFree(context);
+}
+
+static VOID NTAPI BenchReadMostlyLockSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = BenchCreateSyncContext(Context);
+
+    PhInitializeReadMostlyLock(&context->ReadMostlyLock);
+}
+
+static NTSTATUS BenchReadMostlyLockSharedThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        PhAcquireReadMostlyLockShared(&context->ReadMostlyLock);
+        (VOID)context->Counter;
+        PhReleaseReadMostlyLockShared(&context->ReadMostlyLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS BenchReadMostlyLockMixedThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_CONTEXT benchContext = Parameter;
+    PBENCH_SYNC_CONTEXT context = benchContext->Parameter;
+    ULONG i;
+
+    for (i = 0; i < benchContext->Size; i++)
+    {
+        if (i % BENCH_LOCK_WRITE_INTERVAL == 0)
+        {
+            PhAcquireReadMostlyLockExclusive(&context->ReadMostlyLock);
+            context->Counter++;
+            PhReleaseReadMostlyLockExclusive(&context->ReadMostlyLock);
+        }
+        else
+        {
+            PhAcquireReadMostlyLockShared(&context->ReadMostlyLock);
+            (VOID)context->Counter;
+            PhReleaseReadMostlyLockShared(&context->ReadMostlyLock);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID NTAPI BenchReadMostlyLockShared(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchReadMostlyLockSharedThreadStart);
+}
+
+static VOID NTAPI BenchReadMostlyLockMixed(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchRunThreads(Context, BenchReadMostlyLockMixedThreadStart);
+}
+
+static VOID NTAPI BenchReadMostlyLockCleanup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+
+    PhDeleteReadMostlyLock(&context->ReadMostlyLock);
+    PhFree(context);
+}
+
+static VOID NTAPI BenchFreeContext(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PhFree(Context->Parameter);
+}
+
+static NTSTATUS BenchWorkQueueItem(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Parameter;
+
+    _InterlockedIncrement((volatile LONG *)&context->Counter);
+
+    return STATUS_SUCCESS;
+}
+
+static VOID NTAPI BenchWorkQueue(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    PBENCH_SYNC_CONTEXT context = Context->Parameter;
+    PH_WORK_QUEUE workQueue;
+    ULONG i;
+
+    PhInitializeWorkQueue(&workQueue, 0, Context->Threads, 1000);
+
+    for (i = 0; i < Context->Size; i++)
+        PhQueueItemWorkQueue(&workQueue, BenchWorkQueueItem, context);
+
+    PhWaitForWorkQueue(&workQueue);
+    PhDeleteWorkQueue(&workQueue);
+}
+
+static VOID NTAPI BenchWorkQueueSetup(
+    _Inout_ PBENCH_CONTEXT Context
+    )
+{
+    BenchCreateSyncContext(Context);
+}
+
+VOID Bench_sync(
+    VOID
+    )
+{
+    static BENCH_DESCRIPTOR descriptors[] =
+    {
+        { "circbuf.add", 0, BenchCircularBufferSetup, BenchCircularBufferAdd, BenchCircularBufferCleanup },
+        { "circbuf.copy", 0, BenchCircularBufferSetup, BenchCircularBufferCopy, BenchCircularBufferCleanup },
+        { "circbuf.stats.scan", 0, BenchCircularBufferSetup, BenchCircularBufferStatisticsScan, BenchCircularBufferCleanup },
+        { "circbuf.stats.running", 0, BenchCircularBufferStatisticsSetup, BenchCircularBufferStatisticsRunning, BenchCircularBufferStatisticsCleanup },
+        { "freelist.alloc_free", BENCH_THREADED, BenchFreeListSetup, BenchFreeList, BenchFreeListCleanup },
+        { "queuedlock.exclusive", BENCH_THREADED, BenchQueuedLockSetup, BenchQueuedLockExclusive, BenchFreeContext },
+        { "queuedlock.shared", BENCH_THREADED, BenchQueuedLockSetup, BenchQueuedLockShared, BenchFreeContext },
+        { "queuedlock.mixed", BENCH_THREADED, BenchQueuedLockSetup, BenchQueuedLockMixed, BenchFreeContext },
+        { "fastlock.exclusive", BENCH_THREADED, BenchFastLockSetup, BenchFastLockExclusive, BenchFastLockCleanup },
+        { "fastlock.shared", BENCH_THREADED, BenchFastLockSetup, BenchFastLockShared, BenchFastLockCleanup },
+        { "rmlock.shared", BENCH_THREADED, BenchReadMostlyLockSetup, BenchReadMostlyLockShared, BenchReadMostlyLockCleanup },
+        { "rmlock.mixed", BENCH_THREADED, BenchReadMostlyLockSetup, BenchReadMostlyLockMixed, BenchReadMostlyLockCleanup },
+        { "workqueue.queue_wait", BENCH_THREADED, BenchWorkQueueSetup, BenchWorkQueue, BenchFreeContext }
+    };
+    ULONG i;
+
+    for (i = 0; i < RTL_NUMBER_OF(descriptors); i++)
+        BenchRegister(&descriptors[i]);
+}
@@ -0,0 +1,507 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+static BENCH_DESCRIPTOR BenchDescriptors[BENCH_MAXIMUM_BENCHMARKS];
+static ULONG BenchNumberOfDescriptors = 0;
+
+typedef struct _BENCH_THREAD_CONTEXT
+{
+    PBENCH_CONTEXT Context;
+    PUSER_THREAD_START_ROUTINE Function;
+    HANDLE StartEvent;
+} BENCH_THREAD_CONTEXT, *PBENCH_THREAD_CONTEXT;
+
+VOID BenchRegister(
+    _In_ PBENCH_DESCRIPTOR Descriptor
+    )
+{
+    assert(BenchNumberOfDescriptors < BENCH_MAXIMUM_BENCHMARKS);
+    BenchDescriptors[BenchNumberOfDescriptors++] = *Descriptor;
+}
+
+static NTSTATUS BenchThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PBENCH_THREAD_CONTEXT threadContext = Parameter;
+
+    NtWaitForSingleObject(threadContext->StartEvent, FALSE, NULL);
+
+    return threadContext->Function(threadContext->Context);
+}
+
+/**
+ * Runs a function on each of the benchmark's threads and waits for all of them
+ * to finish. The threads are released together once they have all been
+ * created.
+ *
+ * \param Context The benchmark context, which is passed to \a Function.
+ * \param Function The function to run.
+ */
+VOID BenchRunThreads(
+    _In_ PBENCH_CONTEXT Context,
+    _In_ PUSER_THREAD_START_ROUTINE Function
+    )
+{
+    BENCH_THREAD_CONTEXT threadContext;
+    HANDLE threadHandles[64];
+    ULONG numberOfThreads;
+    ULONG i;
+
+    numberOfThreads = min(Context->Threads, RTL_NUMBER_OF(threadHandles));
+
+    if (numberOfThreads <= 1)
+    {
+        Function(Context);
+        return;
+    }
+
+    threadContext.Context = Context;
+    threadContext.Function = Function;
+    NtCreateEvent(&threadContext.StartEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE);
+
+    for (i = 0; i < numberOfThreads; i++)
+        threadHandles[i] = PhCreateThread(0, BenchThreadStart, &threadContext);
+
+    NtSetEvent(threadContext.StartEvent, NULL);
+    NtWaitForMultipleObjects(numberOfThreads, threadHandles, WaitAll, FALSE, NULL);
+
+    for (i = 0; i < numberOfThreads; i++)
+        NtClose(threadHandles[i]);
+
+    NtClose(threadContext.StartEvent);
+}
+
+static int __cdecl BenchCompareDouble(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    DOUBLE value1 = *(const DOUBLE *)elem1;
+    DOUBLE value2 = *(const DOUBLE *)elem2;
+
+    return value1 < value2 ? -1 : (value1 > value2 ? 1 : 0);
+}
+
+static DOUBLE BenchPercentile(
+    _In_reads_(Count) PDOUBLE SortedValues,
+    _In_ ULONG Count,
+    _In_ ULONG Percentile
+    )
+{
+    ULONG rank;
+
+    // Nearest-rank method.
+    rank = (Percentile * Count + 99) / 100;
+
+    if (rank == 0)
+        rank = 1;
+
+    return SortedValues[rank - 1];
+}
+
+static VOID BenchRunOne(
+    _In_ PBENCH_DESCRIPTOR Descriptor,
+    _In_ ULONG Size,
+    _In_ ULONG Threads,
+    _In_ ULONG Iterations,
+    _Out_ PBENCH_RESULT Result
+    )
+{
+    BENCH_CONTEXT context;
+    PDOUBLE samples;
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+    DOUBLE total;
+    ULONG i;
+
+    context.Size = Size;
+    context.Threads = Threads;
+    context.Parameter = NULL;
+
+    if (Descriptor->Setup)
+        Descriptor->Setup(&context);
+
+    samples = PhAllocate(sizeof(DOUBLE) * Iterations);
+    total = 0;
+
+    // Warm up caches and lazily created state.
+    Descriptor->Run(&context);
+
+    for (i = 0; i < Iterations; i++)
+    {
+        NtQueryPerformanceCounter(&startCounter, &frequency);
+        Descriptor->Run(&context);
+        NtQueryPerformanceCounter(&endCounter, NULL);
+
+        samples[i] = (DOUBLE)(endCounter.QuadPart - startCounter.QuadPart) * 1e9 / frequency.QuadPart / Size;
+        total += samples[i];
+    }
+
+    if (Descriptor->Cleanup)
+        Descriptor->Cleanup(&context);
+
+    qsort(samples, Iterations, sizeof(DOUBLE), BenchCompareDouble);
+
+    Result->Name = Descriptor->Name;
+    Result->Size = Size;
+    Result->Threads = Threads;
+    Result->Samples = Iterations;
+    Result->Minimum = samples[0];
+    Result->Mean = total / Iterations;
+    Result->P50 = BenchPercentile(samples, Iterations, 50);
+    Result->P90 = BenchPercentile(samples, Iterations, 90);
+    Result->P99 = BenchPercentile(samples, Iterations, 99);
+    Result->Maximum = samples[Iterations - 1];
+
+    PhFree(samples);
+}
+
+/**
+ * Runs all registered benchmarks.
+ *
+ * \param Sizes The operation counts to run each benchmark with.
+ * \param NumberOfSizes The number of elements in \a Sizes.
+ * \param ThreadCounts The thread counts to run threaded benchmarks with.
+ * \param NumberOfThreadCounts The number of elements in \a ThreadCounts.
+ * \param Iterations The number of samples to take for each combination.
+ * \param Filter A prefix which benchmark names must match, or NULL to run all
+ * benchmarks.
+ * \param Results A variable which receives an array of results. The array must
+ * be freed with PhFree() when it is no longer needed.
+ *
+ * \return The number of results.
+ */
+ULONG BenchRunAll(
+    _In_reads_(NumberOfSizes) PULONG Sizes,
+    _In_ ULONG NumberOfSizes,
+    _In_reads_(NumberOfThreadCounts) PULONG ThreadCounts,
+    _In_ ULONG NumberOfThreadCounts,
+    _In_ ULONG Iterations,
+    _In_opt_ PSTR Filter,
+    _Out_ PBENCH_RESULT *Results
+    )
+{
+    PBENCH_RESULT results;
+    ULONG numberOfResults;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+
+    results = PhAllocate(sizeof(BENCH_RESULT) * BenchNumberOfDescriptors * NumberOfSizes * NumberOfThreadCounts);
+    numberOfResults = 0;
+
+    for (i = 0; i < BenchNumberOfDescriptors; i++)
+    {
+        PBENCH_DESCRIPTOR descriptor = &BenchDescriptors[i];
+
+        if (Filter && strncmp(descriptor->Name, Filter, strlen(Filter)) != 0)
+            continue;
+
+        for (j = 0; j < NumberOfSizes; j++)
+        {
+            for (k = 0; k < NumberOfThreadCounts; k++)
+            {
+                PBENCH_RESULT result = &results[numberOfResults];
+
+                BenchRunOne(
+                    descriptor,
+                    Sizes[j],
+                    (descriptor->Flags & BENCH_THREADED) ? ThreadCounts[k] : 1,
+                    Iterations,
+                    result
+                    );
+                numberOfResults++;
+
+                printf("%-32s size %-8lu threads %-3lu p50 %10.2f ns  p90 %10.2f ns  p99 %10.2f ns\n",
+                    result->Name, (unsigned long)result->Size, (unsigned long)result->Threads,
+                    result->P50, result->P90, result->P99);
+                fflush(stdout);
+
+                if (!(descriptor->Flags & BENCH_THREADED))
+                    break;
+            }
+        }
+    }
+
+    *Results = results;
+
+    return numberOfResults;
+}
+
+/**
+ * Writes benchmark results to a file in JSON format.
+ */
+BOOLEAN BenchWriteJson(
+    _In_ PSTR FileName,
+    _In_reads_(NumberOfResults) PBENCH_RESULT Results,
+    _In_ ULONG NumberOfResults,
+    _In_ ULONG Iterations
+    )
+{
+    FILE *file;
+    ULONG i;
+
+    if (strcmp(FileName, "-") == 0)
+        file = stdout;
+    else if (!(file = fopen(FileName, "w")))
+        return FALSE;
+
+    fprintf(file, "{\n  \"version\": 1,\n  \"unit\": \"ns/op\",\n  \"iterations\": %lu,\n  \"results\": [\n",
+        (unsigned long)Iterations);
+
+    for (i = 0; i < NumberOfResults; i++)
+    {
+        PBENCH_RESULT result = &Results[i];
+
+        fprintf(file,
+            "    { \"name\": \"%s\", \"size\": %lu, \"threads\": %lu, \"samples\": %lu, "
+            "\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+            result->Name, (unsigned long)result->Size, (unsigned long)result->Threads, (unsigned long)result->Samples,
+            result->Minimum, result->Mean, result->P50, result->P90, result->P99, result->Maximum,
+            i + 1 < NumberOfResults ? "," : "");
+    }
+
+    fprintf(file, "  ]\n}\n");
+
+    if (file != stdout)
+        fclose(file);
+
+    return TRUE;
+}
+
+static PSTR BenchSkipWhitespace(
+    _In_ PSTR String
+    )
+{
+    while (*String == ' ' || *String == '\t' || *String == '\r' || *String == '\n')
+        String++;
+
+    return String;
+}
+
+/**
+ * Reads benchmark results written by BenchWriteJson(). Only the subset of JSON
+ * produced by BenchWriteJson() is supported: the "results" array must contain
+ * flat objects whose values are strings or numbers.
+ */
+BOOLEAN BenchReadJson(
+    _In_ PSTR FileName,
+    _Out_ PBENCH_RESULT *Results,
+    _Out_ PULONG NumberOfResults
+    )
+{
+    FILE *file;
+    PSTR buffer;
+    long length;
+    PSTR p;
+    PBENCH_RESULT results;
+    ULONG numberOfResults;
+    ULONG allocatedResults;
+
+    if (!(file = fopen(FileName, "rb")))
+        return FALSE;
+
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    buffer = PhAllocate(length + 1);
+    length = (long)fread(buffer, 1, length, file);
+    buffer[length] = 0;
+    fclose(file);
+
+    numberOfResults = 0;
+    allocatedResults = 16;
+    results = PhAllocate(sizeof(BENCH_RESULT) * allocatedResults);
+
+    if (!(p = strstr(buffer, "\"results\"")) || !(p = strchr(p, '[')))
+        goto ParseError;
+
+    p++;
+
+    while (TRUE)
+    {
+        BENCH_RESULT result;
+
+        p = BenchSkipWhitespace(p);
+
+        if (*p == ',')
+            p = BenchSkipWhitespace(p + 1);
+        if (*p == ']')
+            break;
+        if (*p != '{')
+            goto ParseError;
+
+        p++;
+        memset(&result, 0, sizeof(BENCH_RESULT));
+
+        while (TRUE)
+        {
+            PSTR key;
+            PSTR keyEnd;
+
+            p = BenchSkipWhitespace(p);
+
+            if (*p == ',')
+                p = BenchSkipWhitespace(p + 1);
+            if (*p == '}')
+            {
+                p++;
+                break;
+            }
+            if (*p != '"')
+                goto ParseError;
+
+            key = p + 1;
+
+            if (!(keyEnd = strchr(key, '"')))
+                goto ParseError;
+
+            p = BenchSkipWhitespace(keyEnd + 1);
+
+            if (*p != ':')
+                goto ParseError;
+
+            p = BenchSkipWhitespace(p + 1);
+            *keyEnd = 0;
+
+            if (*p == '"')
+            {
+                PSTR value = p + 1;
+                PSTR valueEnd;
+
+                if (!(valueEnd = strchr(value, '"')))
+                    goto ParseError;
+
+                *valueEnd = 0;
+                p = valueEnd + 1;
+
+                if (strcmp(key, "name") == 0)
+                {
+                    result.Name = PhAllocate(valueEnd - value + 1);
+                    memcpy(result.Name, value, valueEnd - value + 1);
+                }
+            }
+            else
+            {
+                PSTR valueEnd;
+                DOUBLE value;
+
+                value = strtod(p, &valueEnd);
+
+                if (valueEnd == p)
+                    goto ParseError;
+
+                p = valueEnd;
+
+                if (strcmp(key, "size") == 0)
+                    result.Size = (ULONG)value;
+                else if (strcmp(key, "threads") == 0)
+                    result.Threads = (ULONG)value;
+                else if (strcmp(key, "samples") == 0)
+                    result.Samples = (ULONG)value;
+                else if (strcmp(key, "min") == 0)
+                    result.Minimum = value;
+                else if (strcmp(key, "mean") == 0)
+                    result.Mean = value;
+                else if (strcmp(key, "p50") == 0)
+                    result.P50 = value;
+                else if (strcmp(key, "p90") == 0)
+                    result.P90 = value;
+                else if (strcmp(key, "p99") == 0)
+                    result.P99 = value;
+                else if (strcmp(key, "max") == 0)
+                    result.Maximum = value;
+            }
+        }
+
+        if (!result.Name)
+            goto ParseError;
+
+        if (numberOfResults == allocatedResults)
+        {
+            allocatedResults *= 2;
+            results = PhReAllocate(results, sizeof(BENCH_RESULT) * allocatedResults);
+        }
+
+        results[numberOfResults++] = result;
+    }
+
+    PhFree(buffer);
+    *Results = results;
+    *NumberOfResults = numberOfResults;
+
+    return TRUE;
+
+ParseError:
+    PhFree(buffer);
+    PhFree(results);
+
+    return FALSE;
+}
+
+/**
+ * Compares benchmark results against a baseline.
+ *
+ * \param Results The current results.
+ * \param NumberOfResults The number of elements in \a Results.
+ * \param BaselineResults The baseline results.
+ * \param NumberOfBaselineResults The number of elements in \a BaselineResults.
+ * \param Threshold The percentage by which the median of a benchmark can exceed
+ * the baseline median before it is considered a regression.
+ *
+ * \return The number of regressions.
+ */
+ULONG BenchCompareResults(
+    _In_reads_(NumberOfResults) PBENCH_RESULT Results,
+    _In_ ULONG NumberOfResults,
+    _In_reads_(NumberOfBaselineResults) PBENCH_RESULT BaselineResults,
+    _In_ ULONG NumberOfBaselineResults,
+    _In_ DOUBLE Threshold
+    )
+{
+    ULONG numberOfRegressions = 0;
+    ULONG i;
+    ULONG j;
+
+    printf("\n%-32s %-8s %-7s %12s %12s %9s\n", "benchmark", "size", "threads", "baseline", "current", "change");
+
+    for (i = 0; i < NumberOfResults; i++)
+    {
+        PBENCH_RESULT result = &Results[i];
+        PBENCH_RESULT baseline = NULL;
+        DOUBLE change;
+        BOOLEAN regressed;
+
+        for (j = 0; j < NumberOfBaselineResults; j++)
+        {
+            if (strcmp(BaselineResults[j].Name, result->Name) == 0 &&
+                BaselineResults[j].Size == result->Size &&
+                BaselineResults[j].Threads == result->Threads)
+            {
+                baseline = &BaselineResults[j];
+                break;
+            }
+        }
+
+        if (!baseline || baseline->P50 <= 0)
+        {
+            printf("%-32s %-8lu %-7lu %12s %12.2f %9s\n", result->Name, (unsigned long)result->Size,
+                (unsigned long)result->Threads, "-", result->P50, "new");
+            continue;
+        }
+
+        change = (result->P50 - baseline->P50) * 100 / baseline->P50;
+        regressed = change > Threshold;
+
+        if (regressed)
+            numberOfRegressions++;
+
+        printf("%-32s %-8lu %-7lu %12.2f %12.2f %+8.1f%%%s\n", result->Name, (unsigned long)result->Size,
+            (unsigned long)result->Threads, baseline->P50, result->P50, change, regressed ? "  REGRESSION" : "");
+    }
+
+    return numberOfRegressions;
+}
@@ -0,0 +1,114 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <phbase.h>
+#include <circbuf.h>
+
+#define BENCH_MAXIMUM_BENCHMARKS 64
+#define BENCH_MAXIMUM_PARAMETERS 8
+
+/** The benchmark runs once for each thread count instead of on a single thread. */
+#define BENCH_THREADED 0x1
+
+typedef struct _BENCH_CONTEXT
+{
+    /** The number of operations each sample performs (per thread). */
+    ULONG Size;
+    /** The number of threads performing operations. */
+    ULONG Threads;
+    /** Data created by the setup function. */
+    PVOID Parameter;
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+typedef VOID (NTAPI *PBENCH_FUNCTION)(
+    _Inout_ PBENCH_CONTEXT Context
+    );
+
+typedef struct _BENCH_DESCRIPTOR
+{
+    PSTR Name;
+    ULONG Flags;
+    /** Called once before all samples. */
+    PBENCH_FUNCTION Setup;
+    /** Called once per sample and timed. It must perform Size operations on each thread. */
+    PBENCH_FUNCTION Run;
+    /** Called once after all samples. */
+    PBENCH_FUNCTION Cleanup;
+} BENCH_DESCRIPTOR, *PBENCH_DESCRIPTOR;
+
+typedef struct _BENCH_RESULT
+{
+    PSTR Name;
+    ULONG Size;
+    ULONG Threads;
+    ULONG Samples;
+    /** Nanoseconds per operation. */
+    DOUBLE Minimum;
+    DOUBLE Mean;
+    DOUBLE P50;
+    DOUBLE P90;
+    DOUBLE P99;
+    DOUBLE Maximum;
+} BENCH_RESULT, *PBENCH_RESULT;
+
+// bench
+
+VOID BenchRegister(
+    _In_ PBENCH_DESCRIPTOR Descriptor
+    );
+
+ULONG BenchRunAll(
+    _In_reads_(NumberOfSizes) PULONG Sizes,
+    _In_ ULONG NumberOfSizes,
+    _In_reads_(NumberOfThreadCounts) PULONG ThreadCounts,
+    _In_ ULONG NumberOfThreadCounts,
+    _In_ ULONG Iterations,
+    _In_opt_ PSTR Filter,
+    _Out_ PBENCH_RESULT *Results
+    );
+
+VOID BenchRunThreads(
+    _In_ PBENCH_CONTEXT Context,
+    _In_ PUSER_THREAD_START_ROUTINE Function
+    );
+
+BOOLEAN BenchWriteJson(
+    _In_ PSTR FileName,
+    _In_reads_(NumberOfResults) PBENCH_RESULT Results,
+    _In_ ULONG NumberOfResults,
+    _In_ ULONG Iterations
+    );
+
+BOOLEAN BenchReadJson(
+    _In_ PSTR FileName,
+    _Out_ PBENCH_RESULT *Results,
+    _Out_ PULONG NumberOfResults
+    );
+
+ULONG BenchCompareResults(
+    _In_reads_(NumberOfResults) PBENCH_RESULT Results,
+    _In_ ULONG NumberOfResults,
+    _In_reads_(NumberOfBaselineResults) PBENCH_RESULT BaselineResults,
+    _In_ ULONG NumberOfBaselineResults,
+    _In_ DOUBLE Threshold
+    );
+
+// b_basesup
+
+VOID Bench_basesup(
+    VOID
+    );
+
+// b_collect
+
+VOID Bench_collect(
+    VOID
+    );
+
+// b_sync
+
+VOID Bench_sync(
+    VOID
+    );
+
+#endif
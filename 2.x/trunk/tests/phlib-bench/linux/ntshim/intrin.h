@@ -0,0 +1,81 @@
+#ifndef _PH_NTSHIM_INTRIN_H
+#define _PH_NTSHIM_INTRIN_H
+
+// MSVC intrinsics used by phlib, implemented with GCC builtins.
+
+#include <x86intrin.h>
+#include <cpuid.h>
+
+#undef __cpuid
+
+FORCEINLINE void __cpuid(int CpuInfo[4], int FunctionId)
+{
+    __cpuid_count(FunctionId, 0, CpuInfo[0], CpuInfo[1], CpuInfo[2], CpuInfo[3]);
+}
+
+// __cpuidex is provided by cpuid.h.
+
+FORCEINLINE unsigned char _BitScanForward(unsigned int *Index, unsigned int Mask)
+{
+    if (!Mask)
+        return 0;
+
+    *Index = __builtin_ctz(Mask);
+
+    return 1;
+}
+
+FORCEINLINE unsigned char _BitScanReverse(unsigned int *Index, unsigned int Mask)
+{
+    if (!Mask)
+        return 0;
+
+    *Index = 31 - __builtin_clz(Mask);
+
+    return 1;
+}
+
+FORCEINLINE unsigned char _BitScanForward64(unsigned int *Index, unsigned long long Mask)
+{
+    if (!Mask)
+        return 0;
+
+    *Index = __builtin_ctzll(Mask);
+
+    return 1;
+}
+
+FORCEINLINE unsigned char _BitScanReverse64(unsigned int *Index, unsigned long long Mask)
+{
+    if (!Mask)
+        return 0;
+
+    *Index = 63 - __builtin_clzll(Mask);
+
+    return 1;
+}
+
+FORCEINLINE unsigned long long _umul128(unsigned long long Multiplier, unsigned long long Multiplicand,
+    unsigned long long *HighProduct)
+{
+    unsigned __int128 product = (unsigned __int128)Multiplier * Multiplicand;
+
+    *HighProduct = (unsigned long long)(product >> 64);
+
+    return (unsigned long long)product;
+}
+
+FORCEINLINE unsigned long long __emulu(unsigned int a, unsigned int b)
+{
+    return (unsigned long long)a * b;
+}
+
+#define _byteswap_ushort __builtin_bswap16
+#define _byteswap_ulong __builtin_bswap32
+#define _byteswap_uint64 __builtin_bswap64
+#define __popcnt __builtin_popcount
+#define __popcnt64 __builtin_popcountll
+
+#define _ReturnAddress() __builtin_return_address(0)
+
+#endif
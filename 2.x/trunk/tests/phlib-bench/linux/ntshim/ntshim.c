@@ -0,0 +1,1914 @@
+/*
+ * Process Hacker -
+ *   NT shim for Linux builds of phlib
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file implements the subset of the Win32 and NT APIs used by the
+ * phlib modules that are built for the benchmark suite on Linux: the
+ * object manager, base support, collections, formatting, circular buffers,
+ * free lists, fast locks, queued locks, the work queue and synchronization
+ * primitives.
+ *
+ * Dispatcher objects (events, semaphores, threads and keyed events) are
+ * handles to reference-counted objects protected by a mutex and a condition
+ * variable. Interlocked singly linked lists use a 16-byte compare-exchange
+ * on the list head, like the 64-bit Windows implementation. The heap is the
+ * C runtime heap.
+ *
+ * This file also replaces global.c, which depends on parts of phlib that
+ * are not built on Linux.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <time.h>
+#include <unistd.h>
+#include <locale.h>
+#include <ctype.h>
+#include <wctype.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <phbase.h>
+#include <phintrnl.h>
+
+#undef towupper
+#undef towlower
+
+// Globals normally defined by global.c
+
+PVOID PhLibImageBase;
+PWSTR PhApplicationName = L"Application";
+ULONG PhCurrentSessionId;
+HANDLE PhCurrentTokenQueryHandle = NULL;
+BOOLEAN PhElevated;
+TOKEN_ELEVATION_TYPE PhElevationType;
+PVOID PhHeapHandle;
+RTL_OSVERSIONINFOEXW PhOsVersion;
+SYSTEM_BASIC_INFORMATION PhSystemBasicInformation;
+ULONG WindowsVersion = WINDOWS_NEW;
+
+// Defined by support.c
+ULONG PhMaxSizeUnit = MAXULONG32;
+
+ACCESS_MASK ProcessQueryAccess;
+ACCESS_MASK ProcessAllAccess;
+ACCESS_MASK ThreadQueryAccess;
+ACCESS_MASK ThreadSetAccess;
+ACCESS_MASK ThreadAllAccess;
+
+#ifdef DEBUG
+PHLIB_STATISTICS_BLOCK PhLibStatisticsBlock;
+#endif
+
+KUSER_SHARED_DATA PhShimUserSharedData;
+
+static PEB PhShimPeb;
+static __thread TEB PhShimTeb;
+
+#define SHIM_HEAP_HANDLE ((PVOID)0x1000)
+
+// Time
+
+#define SHIM_UNIX_EPOCH_TICKS 116444736000000000LL // 1970-01-01 in 100ns units since 1601-01-01
+
+static LONG64 PhpShimQuerySystemTime(
+    VOID
+    )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return SHIM_UNIX_EPOCH_TICKS + (LONG64)ts.tv_sec * PH_TICKS_PER_SEC + ts.tv_nsec / 100;
+}
+
+static VOID PhpShimUpdateSharedData(
+    VOID
+    )
+{
+    LARGE_INTEGER systemTime;
+    LARGE_INTEGER timeZoneBias;
+    time_t now;
+    struct tm local;
+
+    systemTime.QuadPart = PhpShimQuerySystemTime();
+    PhShimUserSharedData.SystemTime.High2Time = systemTime.HighPart;
+    PhShimUserSharedData.SystemTime.LowPart = systemTime.LowPart;
+    PhShimUserSharedData.SystemTime.High1Time = systemTime.HighPart;
+
+    // The bias is UTC - local time.
+    now = time(NULL);
+    localtime_r(&now, &local);
+    timeZoneBias.QuadPart = -(LONG64)local.tm_gmtoff * PH_TICKS_PER_SEC;
+    PhShimUserSharedData.TimeZoneBias.High2Time = timeZoneBias.HighPart;
+    PhShimUserSharedData.TimeZoneBias.LowPart = timeZoneBias.LowPart;
+    PhShimUserSharedData.TimeZoneBias.High1Time = timeZoneBias.HighPart;
+}
+
+NTSTATUS NtQuerySystemTime(
+    _Out_ PLARGE_INTEGER SystemTime
+    )
+{
+    SystemTime->QuadPart = PhpShimQuerySystemTime();
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtQueryPerformanceCounter(
+    _Out_ PLARGE_INTEGER PerformanceCounter,
+    _Out_opt_ PLARGE_INTEGER PerformanceFrequency
+    )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    PerformanceCounter->QuadPart = (LONG64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+    if (PerformanceFrequency)
+        PerformanceFrequency->QuadPart = 1000000000;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlSystemTimeToLocalTime(
+    _In_ PLARGE_INTEGER SystemTime,
+    _Out_ PLARGE_INTEGER LocalTime
+    )
+{
+    PhpShimUpdateSharedData();
+    LocalTime->QuadPart = SystemTime->QuadPart -
+        ((LONG64)PhShimUserSharedData.TimeZoneBias.High1Time << 32 | PhShimUserSharedData.TimeZoneBias.LowPart);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlLocalTimeToSystemTime(
+    _In_ PLARGE_INTEGER LocalTime,
+    _Out_ PLARGE_INTEGER SystemTime
+    )
+{
+    PhpShimUpdateSharedData();
+    SystemTime->QuadPart = LocalTime->QuadPart +
+        ((LONG64)PhShimUserSharedData.TimeZoneBias.High1Time << 32 | PhShimUserSharedData.TimeZoneBias.LowPart);
+
+    return STATUS_SUCCESS;
+}
+
+static VOID PhpShimTimeoutToTimespec(
+    _In_ PLARGE_INTEGER Timeout,
+    _Out_ struct timespec *Deadline
+    )
+{
+    LONG64 ticks;
+
+    if (Timeout->QuadPart <= 0)
+    {
+        // Relative timeout
+        clock_gettime(CLOCK_REALTIME, Deadline);
+        ticks = -Timeout->QuadPart;
+    }
+    else
+    {
+        // Absolute timeout
+        Deadline->tv_sec = (Timeout->QuadPart - SHIM_UNIX_EPOCH_TICKS) / PH_TICKS_PER_SEC;
+        Deadline->tv_nsec = ((Timeout->QuadPart - SHIM_UNIX_EPOCH_TICKS) % PH_TICKS_PER_SEC) * 100;
+        ticks = 0;
+    }
+
+    Deadline->tv_sec += ticks / PH_TICKS_PER_SEC;
+    Deadline->tv_nsec += (ticks % PH_TICKS_PER_SEC) * 100;
+
+    if (Deadline->tv_nsec >= 1000000000)
+    {
+        Deadline->tv_sec++;
+        Deadline->tv_nsec -= 1000000000;
+    }
+}
+
+// Dispatcher objects
+
+typedef enum _SHIM_OBJECT_TYPE
+{
+    ShimEventObject,
+    ShimSemaphoreObject,
+    ShimThreadObject,
+    ShimKeyedEventObject
+} SHIM_OBJECT_TYPE;
+
+typedef struct _SHIM_KEYED_WAIT
+{
+    struct _SHIM_KEYED_WAIT *Next;
+    PVOID Key;
+    BOOLEAN Release;
+    BOOLEAN Satisfied;
+} SHIM_KEYED_WAIT, *PSHIM_KEYED_WAIT;
+
+typedef struct _SHIM_OBJECT
+{
+    SHIM_OBJECT_TYPE Type;
+    LONG RefCount;
+    pthread_mutex_t Mutex;
+    pthread_cond_t Condition;
+
+    union
+    {
+        struct
+        {
+            BOOLEAN ManualReset;
+            BOOLEAN Signaled;
+        } Event;
+        struct
+        {
+            LONG Count;
+            LONG Maximum;
+        } Semaphore;
+        struct
+        {
+            BOOLEAN Terminated;
+            PUSER_THREAD_START_ROUTINE StartAddress;
+            PVOID Parameter;
+        } Thread;
+        struct
+        {
+            PSHIM_KEYED_WAIT WaitList;
+        } KeyedEvent;
+    };
+} SHIM_OBJECT, *PSHIM_OBJECT;
+
+static PSHIM_OBJECT PhpShimCreateObject(
+    _In_ SHIM_OBJECT_TYPE Type
+    )
+{
+    PSHIM_OBJECT object;
+
+    object = calloc(1, sizeof(SHIM_OBJECT));
+    object->Type = Type;
+    object->RefCount = 1;
+    pthread_mutex_init(&object->Mutex, NULL);
+    pthread_cond_init(&object->Condition, NULL);
+
+    return object;
+}
+
+static VOID PhpShimDereferenceObject(
+    _In_ PSHIM_OBJECT Object
+    )
+{
+    if (_InterlockedDecrement(&Object->RefCount) == 0)
+    {
+        pthread_cond_destroy(&Object->Condition);
+        pthread_mutex_destroy(&Object->Mutex);
+        free(Object);
+    }
+}
+
+NTSTATUS NtClose(
+    _In_ HANDLE Handle
+    )
+{
+    if (!Handle)
+        return STATUS_INVALID_HANDLE;
+
+    PhpShimDereferenceObject((PSHIM_OBJECT)Handle);
+
+    return STATUS_SUCCESS;
+}
+
+static BOOLEAN PhpShimIsObjectSignaled(
+    _In_ PSHIM_OBJECT Object,
+    _In_ BOOLEAN Acquire
+    )
+{
+    switch (Object->Type)
+    {
+    case ShimEventObject:
+        if (!Object->Event.Signaled)
+            return FALSE;
+        if (Acquire && !Object->Event.ManualReset)
+            Object->Event.Signaled = FALSE;
+        return TRUE;
+    case ShimSemaphoreObject:
+        if (Object->Semaphore.Count == 0)
+            return FALSE;
+        if (Acquire)
+            Object->Semaphore.Count--;
+        return TRUE;
+    case ShimThreadObject:
+        return Object->Thread.Terminated;
+    default:
+        return FALSE;
+    }
+}
+
+NTSTATUS NtWaitForSingleObject(
+    _In_ HANDLE Handle,
+    _In_ BOOLEAN Alertable,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)Handle;
+    struct timespec deadline;
+    NTSTATUS status = STATUS_WAIT_0;
+
+    if (Handle == NtCurrentProcess())
+    {
+        // Waiting on the current process never returns.
+        while (TRUE)
+            pause();
+    }
+
+    if (Timeout)
+        PhpShimTimeoutToTimespec(Timeout, &deadline);
+
+    pthread_mutex_lock(&object->Mutex);
+
+    while (!PhpShimIsObjectSignaled(object, TRUE))
+    {
+        if (Timeout)
+        {
+            if (pthread_cond_timedwait(&object->Condition, &object->Mutex, &deadline) == ETIMEDOUT)
+            {
+                if (!PhpShimIsObjectSignaled(object, TRUE))
+                    status = STATUS_TIMEOUT;
+
+                break;
+            }
+        }
+        else
+        {
+            pthread_cond_wait(&object->Condition, &object->Mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&object->Mutex);
+
+    return status;
+}
+
+NTSTATUS NtWaitForMultipleObjects(
+    _In_ ULONG Count,
+    _In_reads_(Count) HANDLE Handles[],
+    _In_ WAIT_TYPE WaitType,
+    _In_ BOOLEAN Alertable,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    ULONG i;
+    NTSTATUS status;
+
+    if (WaitType == WaitAll)
+    {
+        // This is not atomic, but it is good enough for waiting on threads.
+        for (i = 0; i < Count; i++)
+        {
+            status = NtWaitForSingleObject(Handles[i], Alertable, Timeout);
+
+            if (status != STATUS_WAIT_0)
+                return status;
+        }
+
+        return STATUS_WAIT_0;
+    }
+    else
+    {
+        LARGE_INTEGER zero;
+        LARGE_INTEGER interval;
+        LONG64 remaining;
+
+        zero.QuadPart = 0;
+        interval.QuadPart = -PH_TICKS_PER_MS;
+        remaining = Timeout ? -Timeout->QuadPart : MAXLONGLONG;
+
+        while (TRUE)
+        {
+            for (i = 0; i < Count; i++)
+            {
+                if (NtWaitForSingleObject(Handles[i], Alertable, &zero) == STATUS_WAIT_0)
+                    return STATUS_WAIT_0 + i;
+            }
+
+            if (remaining <= 0)
+                return STATUS_TIMEOUT;
+
+            NtDelayExecution(Alertable, &interval);
+            remaining -= PH_TICKS_PER_MS;
+        }
+    }
+}
+
+NTSTATUS NtCreateEvent(
+    _Out_ PHANDLE EventHandle,
+    _In_ ACCESS_MASK DesiredAccess,
+    _In_opt_ POBJECT_ATTRIBUTES ObjectAttributes,
+    _In_ EVENT_TYPE EventType,
+    _In_ BOOLEAN InitialState
+    )
+{
+    PSHIM_OBJECT object;
+
+    object = PhpShimCreateObject(ShimEventObject);
+    object->Event.ManualReset = EventType == NotificationEvent;
+    object->Event.Signaled = InitialState;
+    *EventHandle = object;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtSetEvent(
+    _In_ HANDLE EventHandle,
+    _Out_opt_ PLONG PreviousState
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)EventHandle;
+
+    pthread_mutex_lock(&object->Mutex);
+
+    if (PreviousState)
+        *PreviousState = object->Event.Signaled;
+
+    object->Event.Signaled = TRUE;
+
+    if (object->Event.ManualReset)
+        pthread_cond_broadcast(&object->Condition);
+    else
+        pthread_cond_signal(&object->Condition);
+
+    pthread_mutex_unlock(&object->Mutex);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtResetEvent(
+    _In_ HANDLE EventHandle,
+    _Out_opt_ PLONG PreviousState
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)EventHandle;
+
+    pthread_mutex_lock(&object->Mutex);
+
+    if (PreviousState)
+        *PreviousState = object->Event.Signaled;
+
+    object->Event.Signaled = FALSE;
+    pthread_mutex_unlock(&object->Mutex);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtCreateSemaphore(
+    _Out_ PHANDLE SemaphoreHandle,
+    _In_ ACCESS_MASK DesiredAccess,
+    _In_opt_ POBJECT_ATTRIBUTES ObjectAttributes,
+    _In_ LONG InitialCount,
+    _In_ LONG MaximumCount
+    )
+{
+    PSHIM_OBJECT object;
+
+    if (InitialCount < 0 || MaximumCount <= 0 || InitialCount > MaximumCount)
+        return STATUS_INVALID_PARAMETER;
+
+    object = PhpShimCreateObject(ShimSemaphoreObject);
+    object->Semaphore.Count = InitialCount;
+    object->Semaphore.Maximum = MaximumCount;
+    *SemaphoreHandle = object;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtReleaseSemaphore(
+    _In_ HANDLE SemaphoreHandle,
+    _In_ LONG ReleaseCount,
+    _Out_opt_ PLONG PreviousCount
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)SemaphoreHandle;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    pthread_mutex_lock(&object->Mutex);
+
+    if (PreviousCount)
+        *PreviousCount = object->Semaphore.Count;
+
+    if (object->Semaphore.Maximum - object->Semaphore.Count < ReleaseCount)
+    {
+        status = STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    }
+    else
+    {
+        object->Semaphore.Count += ReleaseCount;
+
+        if (ReleaseCount == 1)
+            pthread_cond_signal(&object->Condition);
+        else
+            pthread_cond_broadcast(&object->Condition);
+    }
+
+    pthread_mutex_unlock(&object->Mutex);
+
+    return status;
+}
+
+NTSTATUS NtCreateKeyedEvent(
+    _Out_ PHANDLE KeyedEventHandle,
+    _In_ ACCESS_MASK DesiredAccess,
+    _In_opt_ POBJECT_ATTRIBUTES ObjectAttributes,
+    _In_ ULONG Flags
+    )
+{
+    *KeyedEventHandle = PhpShimCreateObject(ShimKeyedEventObject);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Waits on or releases a key. A waiter and a releaser with the same key
+ * rendezvous with each other; whichever arrives first blocks until the other
+ * arrives.
+ */
+static NTSTATUS PhpShimRendezvousKeyedEvent(
+    _In_ HANDLE KeyedEventHandle,
+    _In_ PVOID KeyValue,
+    _In_ BOOLEAN Release,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)KeyedEventHandle;
+    PSHIM_KEYED_WAIT *link;
+    PSHIM_KEYED_WAIT entry;
+    SHIM_KEYED_WAIT wait;
+    struct timespec deadline;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    if (Timeout)
+        PhpShimTimeoutToTimespec(Timeout, &deadline);
+
+    pthread_mutex_lock(&object->Mutex);
+
+    // Look for a partner.
+    for (link = &object->KeyedEvent.WaitList; (entry = *link) != NULL; link = &entry->Next)
+    {
+        if (entry->Key == KeyValue && entry->Release != Release)
+        {
+            *link = entry->Next;
+            entry->Satisfied = TRUE;
+            pthread_cond_broadcast(&object->Condition);
+            pthread_mutex_unlock(&object->Mutex);
+
+            return STATUS_SUCCESS;
+        }
+    }
+
+    // Queue ourselves at the end of the list and wait for a partner.
+    wait.Next = NULL;
+    wait.Key = KeyValue;
+    wait.Release = Release;
+    wait.Satisfied = FALSE;
+    *link = &wait;
+
+    while (!wait.Satisfied)
+    {
+        if (Timeout)
+        {
+            if (pthread_cond_timedwait(&object->Condition, &object->Mutex, &deadline) == ETIMEDOUT &&
+                !wait.Satisfied)
+            {
+                // Remove ourselves from the list.
+                for (link = &object->KeyedEvent.WaitList; *link != &wait; link = &(*link)->Next)
+                    NOTHING;
+
+                *link = wait.Next;
+                status = STATUS_TIMEOUT;
+                break;
+            }
+        }
+        else
+        {
+            pthread_cond_wait(&object->Condition, &object->Mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&object->Mutex);
+
+    return status;
+}
+
+NTSTATUS NtReleaseKeyedEvent(
+    _In_ HANDLE KeyedEventHandle,
+    _In_ PVOID KeyValue,
+    _In_ BOOLEAN Alertable,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    return PhpShimRendezvousKeyedEvent(KeyedEventHandle, KeyValue, TRUE, Timeout);
+}
+
+NTSTATUS NtWaitForKeyedEvent(
+    _In_ HANDLE KeyedEventHandle,
+    _In_ PVOID KeyValue,
+    _In_ BOOLEAN Alertable,
+    _In_opt_ PLARGE_INTEGER Timeout
+    )
+{
+    return PhpShimRendezvousKeyedEvent(KeyedEventHandle, KeyValue, FALSE, Timeout);
+}
+
+// Threads
+
+PTEB NtCurrentTeb(
+    VOID
+    )
+{
+    PTEB teb = &PhShimTeb;
+
+    if (!teb->ClientId.UniqueThread)
+    {
+        teb->ClientId.UniqueProcess = (HANDLE)(ULONG_PTR)getpid();
+        teb->ClientId.UniqueThread = (HANDLE)(ULONG_PTR)syscall(SYS_gettid);
+        teb->ProcessEnvironmentBlock = &PhShimPeb;
+    }
+
+    return teb;
+}
+
+static PVOID PhpShimThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PSHIM_OBJECT object = (PSHIM_OBJECT)Parameter;
+
+    object->Thread.StartAddress(object->Thread.Parameter);
+
+    pthread_mutex_lock(&object->Mutex);
+    object->Thread.Terminated = TRUE;
+    pthread_cond_broadcast(&object->Condition);
+    pthread_mutex_unlock(&object->Mutex);
+    PhpShimDereferenceObject(object);
+
+    return NULL;
+}
+
+HANDLE CreateThread(
+    _In_opt_ PVOID lpThreadAttributes,
+    _In_ SIZE_T dwStackSize,
+    _In_ LPTHREAD_START_ROUTINE lpStartAddress,
+    _In_opt_ PVOID lpParameter,
+    _In_ ULONG dwCreationFlags,
+    _Out_opt_ PULONG lpThreadId
+    )
+{
+    PSHIM_OBJECT object;
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    object = PhpShimCreateObject(ShimThreadObject);
+    object->RefCount = 2; // one for the handle, one for the thread
+    object->Thread.StartAddress = (PUSER_THREAD_START_ROUTINE)lpStartAddress;
+    object->Thread.Parameter = lpParameter;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    if (dwStackSize)
+        pthread_attr_setstacksize(&attributes, dwStackSize);
+
+    if (pthread_create(&thread, &attributes, PhpShimThreadStart, object) != 0)
+    {
+        pthread_attr_destroy(&attributes);
+        free(object);
+        return NULL;
+    }
+
+    pthread_attr_destroy(&attributes);
+
+    if (lpThreadId)
+        *lpThreadId = 0;
+
+    return object;
+}
+
+NTSTATUS NtDelayExecution(
+    _In_ BOOLEAN Alertable,
+    _In_ PLARGE_INTEGER DelayInterval
+    )
+{
+    struct timespec interval;
+    LONG64 ticks;
+
+    ticks = DelayInterval->QuadPart < 0 ? -DelayInterval->QuadPart : 0;
+    interval.tv_sec = ticks / PH_TICKS_PER_SEC;
+    interval.tv_nsec = (ticks % PH_TICKS_PER_SEC) * 100;
+    nanosleep(&interval, NULL);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtYieldExecution(
+    VOID
+    )
+{
+    sched_yield();
+
+    return STATUS_SUCCESS;
+}
+
+ULONG RtlGetCurrentProcessorNumber(
+    VOID
+    )
+{
+    int processor = sched_getcpu();
+
+    return processor >= 0 ? (ULONG)processor : 0;
+}
+
+VOID Sleep(
+    _In_ ULONG dwMilliseconds
+    )
+{
+    usleep((useconds_t)dwMilliseconds * 1000);
+}
+
+ULONG GetCurrentProcessorNumber(
+    VOID
+    )
+{
+    int cpu = sched_getcpu();
+
+    return cpu >= 0 ? cpu : 0;
+}
+
+ULONG GetLastError(
+    VOID
+    )
+{
+    return NtCurrentTeb()->LastErrorValue;
+}
+
+VOID SetLastError(
+    _In_ ULONG dwErrCode
+    )
+{
+    NtCurrentTeb()->LastErrorValue = dwErrCode;
+}
+
+// Thread local storage
+
+ULONG TlsAlloc(
+    VOID
+    )
+{
+    pthread_key_t key;
+
+    if (pthread_key_create(&key, NULL) != 0)
+        return TLS_OUT_OF_INDEXES;
+
+    return (ULONG)key;
+}
+
+BOOL TlsFree(
+    _In_ ULONG TlsIndex
+    )
+{
+    return pthread_key_delete((pthread_key_t)TlsIndex) == 0;
+}
+
+PVOID TlsGetValue(
+    _In_ ULONG TlsIndex
+    )
+{
+    // Like the real function, clear the last error.
+    NtCurrentTeb()->LastErrorValue = ERROR_SUCCESS;
+
+    return pthread_getspecific((pthread_key_t)TlsIndex);
+}
+
+BOOL TlsSetValue(
+    _In_ ULONG TlsIndex,
+    _In_opt_ PVOID TlsValue
+    )
+{
+    return pthread_setspecific((pthread_key_t)TlsIndex, TlsValue) == 0;
+}
+
+// Interlocked singly linked lists
+
+// The header contains the first entry and a sequence number, which are updated together. The low
+// 16 bits of the sequence number contain the depth of the list.
+
+#define SHIM_SLIST_DEPTH_MASK 0xffff
+#define SHIM_SLIST_SEQUENCE_INCREMENT 0x10000
+
+FORCEINLINE BOOLEAN PhpShimCompareExchangeSList(
+    _Inout_ PSLIST_HEADER ListHead,
+    _In_ SLIST_HEADER Exchange,
+    _In_ SLIST_HEADER Comparand
+    )
+{
+    return __sync_bool_compare_and_swap(&ListHead->Value, Comparand.Value, Exchange.Value);
+}
+
+FORCEINLINE SLIST_HEADER PhpShimReadSList(
+    _In_ PSLIST_HEADER ListHead
+    )
+{
+    SLIST_HEADER value;
+
+    // The two halves may be torn, but the compare-exchange that follows catches that.
+    value.s.Sequence = ((volatile SLIST_HEADER *)ListHead)->s.Sequence;
+    value.s.Next = ((volatile SLIST_HEADER *)ListHead)->s.Next;
+
+    return value;
+}
+
+VOID RtlInitializeSListHead(
+    _Out_ PSLIST_HEADER ListHead
+    )
+{
+    ListHead->Value = 0;
+}
+
+PSLIST_ENTRY RtlFirstEntrySList(
+    _In_ const SLIST_HEADER *ListHead
+    )
+{
+    return ((volatile SLIST_HEADER *)ListHead)->s.Next;
+}
+
+PSLIST_ENTRY RtlInterlockedPushEntrySList(
+    _Inout_ PSLIST_HEADER ListHead,
+    _Inout_ PSLIST_ENTRY ListEntry
+    )
+{
+    SLIST_HEADER value;
+    SLIST_HEADER newValue;
+
+    do
+    {
+        value = PhpShimReadSList(ListHead);
+        ListEntry->Next = value.s.Next;
+        newValue.s.Next = ListEntry;
+        newValue.s.Sequence = value.s.Sequence + SHIM_SLIST_SEQUENCE_INCREMENT + 1;
+    } while (!PhpShimCompareExchangeSList(ListHead, newValue, value));
+
+    return value.s.Next;
+}
+
+PSLIST_ENTRY RtlInterlockedPopEntrySList(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    SLIST_HEADER value;
+    SLIST_HEADER newValue;
+
+    do
+    {
+        value = PhpShimReadSList(ListHead);
+
+        if (!value.s.Next)
+            return NULL;
+
+        // Like the Windows implementation, this may read an entry that has already been popped
+        // and freed by another thread. The sequence number makes the compare-exchange fail in
+        // that case.
+        newValue.s.Next = ((volatile SLIST_ENTRY *)value.s.Next)->Next;
+        newValue.s.Sequence = value.s.Sequence + SHIM_SLIST_SEQUENCE_INCREMENT - 1;
+    } while (!PhpShimCompareExchangeSList(ListHead, newValue, value));
+
+    return value.s.Next;
+}
+
+PSLIST_ENTRY RtlInterlockedFlushSList(
+    _Inout_ PSLIST_HEADER ListHead
+    )
+{
+    SLIST_HEADER value;
+    SLIST_HEADER newValue;
+
+    do
+    {
+        value = PhpShimReadSList(ListHead);
+
+        if (!value.s.Next)
+            return NULL;
+
+        newValue.s.Next = NULL;
+        newValue.s.Sequence = (value.s.Sequence & ~SHIM_SLIST_DEPTH_MASK) + SHIM_SLIST_SEQUENCE_INCREMENT;
+    } while (!PhpShimCompareExchangeSList(ListHead, newValue, value));
+
+    return value.s.Next;
+}
+
+USHORT RtlQueryDepthSList(
+    _In_ PSLIST_HEADER ListHead
+    )
+{
+    return (USHORT)(ListHead->s.Sequence & SHIM_SLIST_DEPTH_MASK);
+}
+
+// Critical sections
+
+NTSTATUS RtlInitializeCriticalSection(
+    _Out_ PRTL_CRITICAL_SECTION CriticalSection
+    )
+{
+    pthread_mutex_t *mutex;
+    pthread_mutexattr_t attributes;
+
+    mutex = malloc(sizeof(pthread_mutex_t));
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    CriticalSection->Mutex = mutex;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlDeleteCriticalSection(
+    _Inout_ PRTL_CRITICAL_SECTION CriticalSection
+    )
+{
+    pthread_mutex_destroy(CriticalSection->Mutex);
+    free(CriticalSection->Mutex);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlEnterCriticalSection(
+    _Inout_ PRTL_CRITICAL_SECTION CriticalSection
+    )
+{
+    pthread_mutex_lock(CriticalSection->Mutex);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlLeaveCriticalSection(
+    _Inout_ PRTL_CRITICAL_SECTION CriticalSection
+    )
+{
+    pthread_mutex_unlock(CriticalSection->Mutex);
+
+    return STATUS_SUCCESS;
+}
+
+// Memory
+
+PVOID RtlCreateHeap(
+    _In_ ULONG Flags,
+    _In_opt_ PVOID HeapBase,
+    _In_opt_ SIZE_T ReserveSize,
+    _In_opt_ SIZE_T CommitSize,
+    _In_opt_ PVOID Lock,
+    _In_opt_ PVOID Parameters
+    )
+{
+    return SHIM_HEAP_HANDLE;
+}
+
+PVOID RtlAllocateHeap(
+    _In_ PVOID HeapHandle,
+    _In_opt_ ULONG Flags,
+    _In_ SIZE_T Size
+    )
+{
+    PVOID memory;
+
+    if (Flags & HEAP_ZERO_MEMORY)
+        memory = calloc(1, Size ? Size : 1);
+    else
+        memory = malloc(Size ? Size : 1);
+
+    if (!memory && (Flags & HEAP_GENERATE_EXCEPTIONS))
+        RtlRaiseStatus(STATUS_NO_MEMORY);
+
+    return memory;
+}
+
+BOOLEAN RtlFreeHeap(
+    _In_ PVOID HeapHandle,
+    _In_opt_ ULONG Flags,
+    _Frees_ptr_opt_ PVOID BaseAddress
+    )
+{
+    free(BaseAddress);
+
+    return TRUE;
+}
+
+PVOID RtlReAllocateHeap(
+    _In_ PVOID HeapHandle,
+    _In_ ULONG Flags,
+    _Frees_ptr_opt_ PVOID BaseAddress,
+    _In_ SIZE_T Size
+    )
+{
+    PVOID memory;
+
+    memory = realloc(BaseAddress, Size ? Size : 1);
+
+    if (!memory && (Flags & HEAP_GENERATE_EXCEPTIONS))
+        RtlRaiseStatus(STATUS_NO_MEMORY);
+
+    return memory;
+}
+
+SIZE_T RtlSizeHeap(
+    _In_ PVOID HeapHandle,
+    _In_ ULONG Flags,
+    _In_ PVOID BaseAddress
+    )
+{
+    return malloc_usable_size(BaseAddress);
+}
+
+// Virtual memory regions are preceded by a page which records the size of the mapping, so that
+// they can be released without a size.
+
+NTSTATUS NtAllocateVirtualMemory(
+    _In_ HANDLE ProcessHandle,
+    _Inout_ PVOID *BaseAddress,
+    _In_ ULONG_PTR ZeroBits,
+    _Inout_ PSIZE_T RegionSize,
+    _In_ ULONG AllocationType,
+    _In_ ULONG Protect
+    )
+{
+    SIZE_T size;
+    PVOID mapping;
+
+    if (*BaseAddress)
+    {
+        // Committing part of a region that was reserved by us, which is always accessible.
+        return STATUS_SUCCESS;
+    }
+
+    size = ALIGN_UP_BY(*RegionSize, PAGE_SIZE);
+    mapping = mmap(NULL, size + PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (mapping == MAP_FAILED)
+        return STATUS_NO_MEMORY;
+
+    *(PSIZE_T)mapping = size + PAGE_SIZE;
+    *BaseAddress = PTR_ADD_OFFSET(mapping, PAGE_SIZE);
+    *RegionSize = size;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NtFreeVirtualMemory(
+    _In_ HANDLE ProcessHandle,
+    _Inout_ PVOID *BaseAddress,
+    _Inout_ PSIZE_T RegionSize,
+    _In_ ULONG FreeType
+    )
+{
+    PVOID mapping;
+
+    if (FreeType & MEM_RELEASE)
+    {
+        mapping = PTR_SUB_OFFSET(*BaseAddress, PAGE_SIZE);
+        munmap(mapping, *(PSIZE_T)mapping);
+    }
+    else if (FreeType & MEM_DECOMMIT)
+    {
+        madvise(*BaseAddress, *RegionSize, MADV_DONTNEED);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+// Strings
+
+WCHAR RtlUpcaseUnicodeChar(
+    _In_ WCHAR SourceCharacter
+    )
+{
+    if (SourceCharacter < 0x80)
+        return SourceCharacter >= 'a' && SourceCharacter <= 'z' ? SourceCharacter - ('a' - 'A') : SourceCharacter;
+
+    return (WCHAR)towupper(SourceCharacter);
+}
+
+WCHAR RtlDowncaseUnicodeChar(
+    _In_ WCHAR SourceCharacter
+    )
+{
+    if (SourceCharacter < 0x80)
+        return SourceCharacter >= 'A' && SourceCharacter <= 'Z' ? SourceCharacter + ('a' - 'A') : SourceCharacter;
+
+    return (WCHAR)towlower(SourceCharacter);
+}
+
+// The ANSI code page is treated as ISO-8859-1.
+
+NTSTATUS RtlMultiByteToUnicodeN(
+    _Out_writes_bytes_to_(MaxBytesInUnicodeString, *BytesInUnicodeString) PWCH UnicodeString,
+    _In_ ULONG MaxBytesInUnicodeString,
+    _Out_opt_ PULONG BytesInUnicodeString,
+    _In_reads_bytes_(BytesInMultiByteString) PSTR MultiByteString,
+    _In_ ULONG BytesInMultiByteString
+    )
+{
+    ULONG count;
+    ULONG i;
+
+    count = min(MaxBytesInUnicodeString / sizeof(WCHAR), BytesInMultiByteString);
+
+    for (i = 0; i < count; i++)
+        UnicodeString[i] = (UCHAR)MultiByteString[i];
+
+    if (BytesInUnicodeString)
+        *BytesInUnicodeString = count * sizeof(WCHAR);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlMultiByteToUnicodeSize(
+    _Out_ PULONG BytesInUnicodeString,
+    _In_reads_bytes_(BytesInMultiByteString) PSTR MultiByteString,
+    _In_ ULONG BytesInMultiByteString
+    )
+{
+    *BytesInUnicodeString = BytesInMultiByteString * sizeof(WCHAR);
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlUnicodeToMultiByteN(
+    _Out_writes_bytes_to_(MaxBytesInMultiByteString, *BytesInMultiByteString) PCHAR MultiByteString,
+    _In_ ULONG MaxBytesInMultiByteString,
+    _Out_opt_ PULONG BytesInMultiByteString,
+    _In_reads_bytes_(BytesInUnicodeString) PWCH UnicodeString,
+    _In_ ULONG BytesInUnicodeString
+    )
+{
+    ULONG count;
+    ULONG i;
+
+    count = min(MaxBytesInMultiByteString, BytesInUnicodeString / sizeof(WCHAR));
+
+    for (i = 0; i < count; i++)
+        MultiByteString[i] = UnicodeString[i] < 0x100 ? (CHAR)UnicodeString[i] : '?';
+
+    if (BytesInMultiByteString)
+        *BytesInMultiByteString = count;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS RtlUnicodeToMultiByteSize(
+    _Out_ PULONG BytesInMultiByteString,
+    _In_reads_bytes_(BytesInUnicodeString) PWCH UnicodeString,
+    _In_ ULONG BytesInUnicodeString
+    )
+{
+    *BytesInMultiByteString = BytesInUnicodeString / sizeof(WCHAR);
+
+    return STATUS_SUCCESS;
+}
+
+VOID RtlInitUnicodeString(
+    _Out_ PUNICODE_STRING DestinationString,
+    _In_opt_ PWSTR SourceString
+    )
+{
+    SIZE_T length = SourceString ? PhShimWcslen(SourceString) * sizeof(WCHAR) : 0;
+
+    DestinationString->Length = (USHORT)length;
+    DestinationString->MaximumLength = SourceString ? (USHORT)(length + sizeof(WCHAR)) : 0;
+    DestinationString->Buffer = SourceString;
+}
+
+VOID RtlInitAnsiString(
+    _Out_ PANSI_STRING DestinationString,
+    _In_opt_ PSTR SourceString
+    )
+{
+    SIZE_T length = SourceString ? strlen(SourceString) : 0;
+
+    DestinationString->Length = (USHORT)length;
+    DestinationString->MaximumLength = SourceString ? (USHORT)(length + 1) : 0;
+    DestinationString->Buffer = SourceString;
+}
+
+// Errors and debugging
+
+DECLSPEC_NORETURN VOID RtlRaiseStatus(
+    _In_ NTSTATUS Status
+    )
+{
+    fprintf(stderr, "RtlRaiseStatus: 0x%08x\n", (ULONG)Status);
+    abort();
+}
+
+USHORT RtlCaptureStackBackTrace(
+    _In_ ULONG FramesToSkip,
+    _In_ ULONG FramesToCapture,
+    _Out_writes_(FramesToCapture) PVOID *BackTrace,
+    _Out_opt_ PULONG BackTraceHash
+    )
+{
+    if (BackTraceHash)
+        *BackTraceHash = 0;
+
+    return 0;
+}
+
+// Modules
+
+NTSTATUS LdrGetDllHandle(
+    _In_opt_ PWSTR DllPath,
+    _In_opt_ PULONG DllCharacteristics,
+    _In_ PUNICODE_STRING DllName,
+    _Out_ PVOID *DllHandle
+    )
+{
+    return STATUS_NOT_FOUND;
+}
+
+NTSTATUS LdrGetProcedureAddress(
+    _In_ PVOID DllHandle,
+    _In_opt_ PANSI_STRING ProcedureName,
+    _In_opt_ ULONG ProcedureNumber,
+    _Out_ PVOID *ProcedureAddress
+    )
+{
+    return STATUS_NOT_FOUND;
+}
+
+HMODULE GetModuleHandle(
+    _In_opt_ PCWSTR lpModuleName
+    )
+{
+    return NULL;
+}
+
+PVOID GetProcAddress(
+    _In_ HMODULE hModule,
+    _In_ PCSTR lpProcName
+    )
+{
+    return NULL;
+}
+
+HRESULT CoInitializeEx(
+    _In_opt_ PVOID pvReserved,
+    _In_ ULONG dwCoInit
+    )
+{
+    return E_NOTIMPL;
+}
+
+VOID CoUninitialize(
+    VOID
+    )
+{
+    NOTHING;
+}
+
+int GetLocaleInfo(
+    _In_ LCID Locale,
+    _In_ ULONG LCType,
+    _Out_writes_opt_(cchData) PWSTR lpLCData,
+    _In_ int cchData
+    )
+{
+    // Use the default separators.
+    return 0;
+}
+
+// C runtime
+
+typedef struct _PH_SHIM_QSORT_CONTEXT
+{
+    int (*Compare)(void *, const void *, const void *);
+    void *Context;
+} PH_SHIM_QSORT_CONTEXT;
+
+static int PhpShimQsortCompare(
+    const void *Element1,
+    const void *Element2,
+    void *Context
+    )
+{
+    PH_SHIM_QSORT_CONTEXT *context = Context;
+
+    return context->Compare(context->Context, Element1, Element2);
+}
+
+// qsort_s passes the context as the first argument of the compare function,
+// qsort_r passes it as the last.
+void PhShimQsortS(
+    void *Base,
+    size_t Count,
+    size_t Size,
+    int (*Compare)(void *, const void *, const void *),
+    void *Context
+    )
+{
+    PH_SHIM_QSORT_CONTEXT context;
+
+    context.Compare = Compare;
+    context.Context = Context;
+    qsort_r(Base, Count, Size, PhpShimQsortCompare, &context);
+}
+
+size_t PhShimWcslen(
+    const WCHAR *String
+    )
+{
+    const WCHAR *p = String;
+
+    while (*p)
+        p++;
+
+    return p - String;
+}
+
+int PhShimWcscmp(
+    const WCHAR *String1,
+    const WCHAR *String2
+    )
+{
+    while (*String1 && *String1 == *String2)
+    {
+        String1++;
+        String2++;
+    }
+
+    return (int)*String1 - (int)*String2;
+}
+
+int PhShimWcsicmp(
+    const WCHAR *String1,
+    const WCHAR *String2
+    )
+{
+    WCHAR c1;
+    WCHAR c2;
+
+    do
+    {
+        c1 = RtlDowncaseUnicodeChar(*String1++);
+        c2 = RtlDowncaseUnicodeChar(*String2++);
+    } while (c1 && c1 == c2);
+
+    return (int)c1 - (int)c2;
+}
+
+WCHAR *PhShimWmemset(
+    WCHAR *Destination,
+    WCHAR Value,
+    size_t Count
+    )
+{
+    size_t i;
+
+    for (i = 0; i < Count; i++)
+        Destination[i] = Value;
+
+    return Destination;
+}
+
+WCHAR *PhShimWcsupr(
+    WCHAR *String
+    )
+{
+    WCHAR *p;
+
+    for (p = String; *p; p++)
+        *p = RtlUpcaseUnicodeChar(*p);
+
+    return String;
+}
+
+WCHAR *PhShimWcslwr(
+    WCHAR *String
+    )
+{
+    WCHAR *p;
+
+    for (p = String; *p; p++)
+        *p = RtlDowncaseUnicodeChar(*p);
+
+    return String;
+}
+
+WCHAR PhShimTowupper(
+    WCHAR Character
+    )
+{
+    return RtlUpcaseUnicodeChar(Character);
+}
+
+WCHAR PhShimTowlower(
+    WCHAR Character
+    )
+{
+    return RtlDowncaseUnicodeChar(Character);
+}
+
+WCHAR *PhShimUi64tow(
+    ULONG64 Value,
+    WCHAR *Buffer,
+    int Radix
+    )
+{
+    WCHAR temp[65];
+    ULONG i = 0;
+    ULONG j = 0;
+    ULONG digit;
+
+    do
+    {
+        digit = (ULONG)(Value % Radix);
+        temp[i++] = (WCHAR)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        Value /= Radix;
+    } while (Value);
+
+    while (i)
+        Buffer[j++] = temp[--i];
+
+    Buffer[j] = 0;
+
+    return Buffer;
+}
+
+WCHAR *PhShimI64tow(
+    LONG64 Value,
+    WCHAR *Buffer,
+    int Radix
+    )
+{
+    if (Value < 0 && Radix == 10)
+    {
+        Buffer[0] = '-';
+        PhShimUi64tow(-(ULONG64)Value, Buffer + 1, Radix);
+    }
+    else
+    {
+        PhShimUi64tow((ULONG64)Value, Buffer, Radix);
+    }
+
+    return Buffer;
+}
+
+typedef struct _SHIM_FORMAT_OUTPUT
+{
+    WCHAR *Buffer;
+    size_t Count;
+    size_t Length;
+} SHIM_FORMAT_OUTPUT, *PSHIM_FORMAT_OUTPUT;
+
+FORCEINLINE VOID PhpShimOutputChar(
+    _Inout_ PSHIM_FORMAT_OUTPUT Output,
+    _In_ WCHAR Character
+    )
+{
+    if (Output->Length < Output->Count)
+        Output->Buffer[Output->Length] = Character;
+
+    Output->Length++;
+}
+
+/**
+ * Formats a string using the MSVC conventions for wide format strings, where
+ * %s and %c take wide arguments and %S and %C take narrow arguments.
+ */
+static size_t PhpShimFormat(
+    _Out_writes_opt_(Count) WCHAR *Buffer,
+    _In_ size_t Count,
+    _In_ const WCHAR *Format,
+    _In_ va_list ArgPtr
+    )
+{
+    SHIM_FORMAT_OUTPUT output;
+    const WCHAR *p;
+    char spec[64];
+    char temp[512];
+    ULONG specLength;
+    int sizeModifier; // 0 = int, 1 = long (ignored), 2 = 64-bit, 3 = pointer-sized, -1 = short
+    BOOLEAN narrow;
+    int width;
+    int precision;
+    int length;
+    int i;
+
+    output.Buffer = Buffer;
+    output.Count = Buffer ? Count : 0;
+    output.Length = 0;
+
+    for (p = Format; *p; p++)
+    {
+        if (*p != '%')
+        {
+            PhpShimOutputChar(&output, *p);
+            continue;
+        }
+
+        p++;
+
+        if (*p == '%')
+        {
+            PhpShimOutputChar(&output, '%');
+            continue;
+        }
+
+        specLength = 0;
+        spec[specLength++] = '%';
+        width = -1;
+        precision = -1;
+
+        // Flags
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+            spec[specLength++] = (char)*p++;
+
+        // Width
+        if (*p == '*')
+        {
+            width = va_arg(ArgPtr, int);
+            specLength += sprintf(spec + specLength, "%d", width);
+            p++;
+        }
+        else
+        {
+            while (*p >= '0' && *p <= '9')
+                spec[specLength++] = (char)*p++;
+        }
+
+        // Precision
+        if (*p == '.')
+        {
+            spec[specLength++] = (char)*p++;
+
+            if (*p == '*')
+            {
+                precision = va_arg(ArgPtr, int);
+                specLength += sprintf(spec + specLength, "%d", precision);
+                p++;
+            }
+            else
+            {
+                precision = 0;
+
+                while (*p >= '0' && *p <= '9')
+                {
+                    precision = precision * 10 + (*p - '0');
+                    spec[specLength++] = (char)*p++;
+                }
+            }
+        }
+
+        // Size
+        sizeModifier = 0;
+        narrow = FALSE;
+
+        if (*p == 'h')
+        {
+            sizeModifier = -1;
+            narrow = TRUE;
+            p++;
+        }
+        else if (*p == 'l')
+        {
+            p++;
+
+            if (*p == 'l')
+            {
+                sizeModifier = 2;
+                p++;
+            }
+            else
+            {
+                sizeModifier = 1;
+            }
+        }
+        else if (*p == 'w')
+        {
+            p++;
+        }
+        else if (*p == 'z')
+        {
+            sizeModifier = 3;
+            p++;
+        }
+        else if (*p == 'I')
+        {
+            if (p[1] == '6' && p[2] == '4')
+            {
+                sizeModifier = 2;
+                p += 3;
+            }
+            else if (p[1] == '3' && p[2] == '2')
+            {
+                sizeModifier = 0;
+                p += 3;
+            }
+            else
+            {
+                sizeModifier = 3;
+                p++;
+            }
+        }
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            if (sizeModifier == 2)
+            {
+                spec[specLength++] = 'l';
+                spec[specLength++] = 'l';
+                spec[specLength++] = (char)*p;
+                spec[specLength] = 0;
+                length = snprintf(temp, sizeof(temp), spec, va_arg(ArgPtr, long long));
+            }
+            else if (sizeModifier == 3)
+            {
+                spec[specLength++] = 'z';
+                spec[specLength++] = (char)*p;
+                spec[specLength] = 0;
+                length = snprintf(temp, sizeof(temp), spec, va_arg(ArgPtr, size_t));
+            }
+            else
+            {
+                spec[specLength++] = (char)*p;
+                spec[specLength] = 0;
+                length = snprintf(temp, sizeof(temp), spec,
+                    sizeModifier == -1 ? (int)(short)va_arg(ArgPtr, int) : va_arg(ArgPtr, int));
+            }
+
+            for (i = 0; i < length; i++)
+                PhpShimOutputChar(&output, (UCHAR)temp[i]);
+
+            break;
+        case 'p':
+            length = snprintf(temp, sizeof(temp), "%016llX", (unsigned long long)(ULONG_PTR)va_arg(ArgPtr, PVOID));
+
+            for (i = 0; i < length; i++)
+                PhpShimOutputChar(&output, (UCHAR)temp[i]);
+
+            break;
+        case 'f':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            spec[specLength++] = (char)*p;
+            spec[specLength] = 0;
+            length = snprintf(temp, sizeof(temp), spec, va_arg(ArgPtr, double));
+
+            for (i = 0; i < length; i++)
+                PhpShimOutputChar(&output, (UCHAR)temp[i]);
+
+            break;
+        case 'c':
+        case 'C':
+            PhpShimOutputChar(&output, (WCHAR)va_arg(ArgPtr, int));
+            break;
+        case 's':
+        case 'S':
+            {
+                BOOLEAN isNarrow = narrow || *p == 'S';
+                PVOID string = va_arg(ArgPtr, PVOID);
+                size_t stringLength;
+                size_t j;
+
+                if (!string)
+                {
+                    string = isNarrow ? (PVOID)"(null)" : (PVOID)L"(null)";
+                }
+
+                stringLength = isNarrow ? strlen(string) : PhShimWcslen(string);
+
+                if (precision >= 0 && (size_t)precision < stringLength)
+                    stringLength = precision;
+
+                if (!strchr(spec, '-'))
+                {
+                    for (j = stringLength; width > 0 && j < (size_t)width; j++)
+                        PhpShimOutputChar(&output, ' ');
+                }
+
+                for (j = 0; j < stringLength; j++)
+                {
+                    PhpShimOutputChar(&output, isNarrow ? (UCHAR)((PCHAR)string)[j] : ((PWCHAR)string)[j]);
+                }
+
+                if (strchr(spec, '-'))
+                {
+                    for (j = stringLength; width > 0 && j < (size_t)width; j++)
+                        PhpShimOutputChar(&output, ' ');
+                }
+            }
+            break;
+        default:
+            // Unknown conversion; stop formatting.
+            return output.Length;
+        }
+    }
+
+    return output.Length;
+}
+
+int PhShimVscwprintf(
+    const WCHAR *Format,
+    va_list ArgPtr
+    )
+{
+    va_list argptr;
+    size_t length;
+
+    va_copy(argptr, ArgPtr);
+    length = PhpShimFormat(NULL, 0, Format, argptr);
+    va_end(argptr);
+
+    return (int)length;
+}
+
+int PhShimVsnwprintf(
+    WCHAR *Buffer,
+    size_t Count,
+    const WCHAR *Format,
+    va_list ArgPtr
+    )
+{
+    va_list argptr;
+    size_t length;
+
+    va_copy(argptr, ArgPtr);
+    length = PhpShimFormat(Buffer, Count, Format, argptr);
+    va_end(argptr);
+
+    if (length > Count)
+        return -1;
+
+    if (length < Count)
+        Buffer[length] = 0;
+
+    return (int)length;
+}
+
+int PhShimSnwprintf(
+    WCHAR *Buffer,
+    size_t Count,
+    const WCHAR *Format,
+    ...
+    )
+{
+    va_list argptr;
+    int result;
+
+    va_start(argptr, Format);
+    result = PhShimVsnwprintf(Buffer, Count, Format, argptr);
+    va_end(argptr);
+
+    return result;
+}
+
+_locale_t _create_locale(
+    int Category,
+    const char *Locale
+    )
+{
+    static int dummyLocale;
+
+    return &dummyLocale;
+}
+
+errno_t _cfltcvt_l(
+    double *arg,
+    char *buffer,
+    size_t sizeInBytes,
+    int format,
+    int precision,
+    int caps,
+    _locale_t plocinfo
+    )
+{
+    char spec[16];
+
+    snprintf(spec, sizeof(spec), "%%.%d%c", precision, caps ? toupper(format) : format);
+    snprintf(buffer, sizeInBytes, spec, *arg);
+
+    return 0;
+}
+
+void _cropzeros_l(
+    char *_Buf,
+    _locale_t _Locale
+    )
+{
+    char *decimal;
+    char *exponent;
+    char *end;
+
+    decimal = strchr(_Buf, '.');
+
+    if (!decimal)
+        return;
+
+    exponent = strpbrk(decimal, "eE");
+    end = exponent ? exponent : decimal + strlen(decimal);
+
+    while (end > decimal + 1 && end[-1] == '0')
+        end--;
+
+    if (end == decimal + 1)
+        end = decimal;
+
+    if (exponent)
+        memmove(end, exponent, strlen(exponent) + 1);
+    else
+        *end = 0;
+}
+
+void _forcdecpt_l(
+    char *_Buf,
+    _locale_t _Locale
+    )
+{
+    if (!strchr(_Buf, '.'))
+        strcat(_Buf, ".");
+}
+
+// Initialization
+
+NTSTATUS PhInitializePhLibEx(
+    _In_ ULONG Flags,
+    _In_opt_ SIZE_T HeapReserveSize,
+    _In_opt_ SIZE_T HeapCommitSize
+    )
+{
+    long numberOfProcessors;
+
+    setlocale(LC_CTYPE, "C.UTF-8");
+
+    PhHeapHandle = RtlCreateHeap(HEAP_GROWABLE | HEAP_CLASS_1, NULL, 0, 0, NULL, NULL);
+    PhLibImageBase = &PhShimPeb;
+
+    numberOfProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    PhShimPeb.ImageBaseAddress = PhLibImageBase;
+    PhShimPeb.SessionId = 1;
+    PhShimPeb.NumberOfProcessors = (ULONG)numberOfProcessors;
+
+    PhShimUserSharedData.ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE] = TRUE;
+    PhpShimUpdateSharedData();
+
+    PhOsVersion.dwOSVersionInfoSize = sizeof(RTL_OSVERSIONINFOEXW);
+    PhOsVersion.dwMajorVersion = 10;
+    PhSystemBasicInformation.PageSize = PAGE_SIZE;
+    PhSystemBasicInformation.AllocationGranularity = 64 * 1024;
+    PhSystemBasicInformation.NumberOfProcessors = (CCHAR)min(numberOfProcessors, 127);
+    PhSystemBasicInformation.ActiveProcessorsAffinityMask =
+        numberOfProcessors >= 64 ? (ULONG_PTR)-1 : ((ULONG_PTR)1 << numberOfProcessors) - 1;
+
+    PhElevated = FALSE;
+    PhElevationType = TokenElevationTypeDefault;
+    PhCurrentSessionId = PhShimPeb.SessionId;
+
+    if (!PhQueuedLockInitialization())
+        return STATUS_UNSUCCESSFUL;
+
+    if (!NT_SUCCESS(PhInitializeRef()))
+        return STATUS_UNSUCCESSFUL;
+    if (!PhInitializeBase(Flags))
+        return STATUS_UNSUCCESSFUL;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS PhInitializePhLib(
+    VOID
+    )
+{
+    return PhInitializePhLibEx(0xffffffff, 0, 0);
+}
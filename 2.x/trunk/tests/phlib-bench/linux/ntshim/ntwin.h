@@ -0,0 +1,980 @@
+#ifndef _NTWIN_H
+#define _NTWIN_H
+
+// This header file replaces the Win32 headers when building phlib for the
+// benchmark suite on Linux. It provides only the types, macros and
+// functions needed by the phlib modules that are benchmarked.
+//
+// The code must be compiled with -fms-extensions (anonymous structures)
+// and -fshort-wchar (WCHAR and L"" literals are 16 bits wide).
+
+#ifndef __linux__
+#error This header is only for Linux builds.
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <strings.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Calling conventions and compiler support
+
+#define NTAPI
+#define WINAPI
+#define NTSYSAPI
+#define NTSYSCALLAPI
+#define CALLBACK
+#define __stdcall
+#define __cdecl
+#define __fastcall
+#define FASTCALL
+#define FORCEINLINE static inline __attribute__((always_inline))
+#define DECLSPEC_ALIGN(x) __attribute__((aligned(x)))
+#define DECLSPEC_NOINLINE __attribute__((noinline))
+#define DECLSPEC_NORETURN __attribute__((noreturn))
+#define DECLSPEC_SELECTANY __attribute__((weak))
+#define __declspec(x)
+#define __forceinline inline __attribute__((always_inline))
+#define __assume(x) do { if (!(x)) __builtin_unreachable(); } while (0)
+#define __int64 long long
+#define __int32 int
+#define __int16 short
+#define __int8 char
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+#define C_ASSERT(e) _Static_assert(e, #e)
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define RTL_NUMBER_OF(A) ARRAYSIZE(A)
+#define FIELD_OFFSET(type, field) ((LONG)offsetof(type, field))
+#define RTL_FIELD_SIZE(type, field) (sizeof(((type *)0)->field))
+#define CONTAINING_RECORD(address, type, field) \
+    ((type *)((char *)(address) - offsetof(type, field)))
+#define MEMORY_ALLOCATION_ALIGNMENT 16
+#define MAX_PATH 260
+#define CONST const
+#define VOID void
+#define TRUE 1
+#define FALSE 0
+#define MAXUSHORT 0xffff
+#define MAXULONG 0xffffffff
+#define MAXULONG32 ((ULONG32)~((ULONG32)0))
+#define MAXULONG64 ((ULONG64)~((ULONG64)0))
+#define MAXLONG64 ((LONG64)(MAXULONG64 >> 1))
+#define MINLONG64 ((LONG64)~MAXLONG64)
+#define MAXLONG 0x7fffffff
+#define MINLONG (-MAXLONG - 1)
+#define MAXLONGLONG (0x7fffffffffffffffLL)
+#define INFINITE 0xffffffff
+#define _WIN64 1
+#define _M_X64 1
+#define _AMD64_ 1
+#define __fallthrough
+
+// SAL annotations
+
+#define _In_
+#define _In_opt_
+#define _In_z_
+#define _In_opt_z_
+#define _Inout_
+#define _Inout_opt_
+#define _Inout_z_
+#define _Out_
+#define _Out_opt_
+#define _Outptr_
+#define _Outptr_opt_
+#define _Reserved_
+#define _In_reads_(x)
+#define _In_reads_opt_(x)
+#define _In_reads_bytes_(x)
+#define _In_reads_bytes_opt_(x)
+#define _Out_writes_(x)
+#define _Out_writes_z_(x)
+#define _Out_writes_opt_(x)
+#define _Out_writes_opt_z_(x)
+#define _Out_writes_bytes_(x)
+#define _Out_writes_bytes_opt_(x)
+#define _Out_writes_bytes_to_(x, y)
+#define _Out_writes_bytes_to_opt_(x, y)
+#define _Out_writes_to_(x, y)
+#define _Inout_updates_(x)
+#define _Inout_updates_bytes_(x)
+#define _Field_size_(x)
+#define _Field_size_bytes_(x)
+#define _Field_size_bytes_part_(x, y)
+#define _Field_size_bytes_part_opt_(x, y)
+#define _Printf_format_string_
+#define _Check_return_
+#define _Must_inspect_result_
+#define _Success_(x)
+#define _When_(x, y)
+#define _Frees_ptr_opt_
+#define _Post_writable_byte_size_(x)
+#define _Post_invalid_
+#define _Ret_notnull_
+#define _Ret_maybenull_
+#define _Ret_z_
+#define _Null_terminated_
+#define _Interlocked_operand_
+#define _Acquires_exclusive_lock_(x)
+#define _Acquires_shared_lock_(x)
+#define _Releases_exclusive_lock_(x)
+#define _Releases_shared_lock_(x)
+#define _Analysis_assume_(x)
+#define _Pre_
+#define _Post_
+#define _Notnull_
+#define _Maybenull_
+#define _Struct_size_bytes_(x)
+#define _Strict_type_match_
+#define _Function_class_(x)
+#define _IRQL_requires_max_(x)
+#define _Pre_notnull_
+#define _Post_maybenull_
+#define _Outptr_result_maybenull_
+#define _Outptr_result_buffer_(x)
+#define _Out_range_(x, y)
+#define _In_range_(x, y)
+#define _Kernel_entry_
+#define _Pre_satisfies_(x)
+#define _Post_satisfies_(x)
+#define _Always_(x)
+#define _Deref_out_range_(x, y)
+#define _Return_type_success_(x)
+#define _Writable_bytes_(x)
+
+// Basic types
+
+typedef void *PVOID;
+typedef void *LPVOID;
+typedef const void *PCVOID;
+typedef const void *LPCVOID;
+typedef char CHAR;
+typedef signed char SCHAR;
+typedef unsigned char UCHAR;
+typedef short SHORT;
+typedef unsigned short USHORT;
+typedef int LONG;
+typedef unsigned int ULONG;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef unsigned char BOOLEAN;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef unsigned int DWORD;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef long long LONG64;
+typedef unsigned long long ULONG64;
+typedef long long INT64;
+typedef unsigned long long UINT64;
+typedef unsigned long long DWORD64;
+typedef unsigned long long DWORDLONG;
+typedef int LONG32;
+typedef unsigned int ULONG32;
+typedef int INT32;
+typedef unsigned int UINT32;
+typedef unsigned int DWORD32;
+typedef intptr_t LONG_PTR;
+typedef uintptr_t ULONG_PTR;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef uintptr_t DWORD_PTR;
+typedef ULONG_PTR SIZE_T;
+typedef LONG_PTR SSIZE_T;
+typedef ULONG_PTR KAFFINITY;
+typedef float FLOAT;
+typedef double DOUBLE;
+typedef wchar_t WCHAR;
+typedef ULONG ACCESS_MASK;
+typedef LONG HRESULT;
+typedef USHORT LANGID;
+typedef ULONG LCID;
+typedef int errno_t;
+typedef void *_locale_t;
+
+typedef PVOID *PPVOID;
+typedef CHAR *PCHAR, *PCH, *PSTR, *LPSTR, *PSZ;
+typedef const CHAR *PCCH, *PCSTR, *LPCSTR;
+typedef UCHAR *PUCHAR;
+typedef SHORT *PSHORT;
+typedef USHORT *PUSHORT;
+typedef LONG *PLONG;
+typedef ULONG *PULONG;
+typedef INT *PINT;
+typedef UINT *PUINT;
+typedef BOOL *PBOOL, *LPBOOL;
+typedef BOOLEAN *PBOOLEAN;
+typedef BYTE *PBYTE, *LPBYTE;
+typedef WORD *PWORD;
+typedef DWORD *PDWORD, *LPDWORD;
+typedef LONGLONG *PLONGLONG;
+typedef ULONGLONG *PULONGLONG;
+typedef LONG64 *PLONG64;
+typedef ULONG64 *PULONG64;
+typedef DWORD64 *PDWORD64;
+typedef LONG_PTR *PLONG_PTR;
+typedef ULONG_PTR *PULONG_PTR;
+typedef SIZE_T *PSIZE_T;
+typedef FLOAT *PFLOAT;
+typedef DOUBLE *PDOUBLE;
+typedef WCHAR *PWCHAR, *PWCH, *PWSTR, *LPWSTR, *LPWCH, *PZZWSTR;
+typedef const WCHAR *PCWCH, *PCWSTR, *LPCWSTR, *LPCWCH, *PCZZWSTR;
+typedef ACCESS_MASK *PACCESS_MASK;
+
+typedef void *HANDLE;
+typedef HANDLE *PHANDLE;
+typedef HANDLE HWND, HICON, HMENU, HINSTANCE, HMODULE, HBITMAP, HFONT, HDC, HBRUSH,
+    HKEY, HCURSOR, HGDIOBJ, HIMAGELIST, HPEN, HRGN, HGLOBAL, HLOCAL, HDESK, HWINSTA,
+    HMONITOR, HTHEME, HACCEL, HRSRC, HTREEITEM, HDWP, SC_HANDLE, HCERTSTORE;
+typedef HKEY *PHKEY;
+typedef ULONG_PTR WPARAM;
+typedef LONG_PTR LPARAM;
+typedef LONG_PTR LRESULT;
+typedef ULONG COLORREF;
+typedef PVOID PSID;
+typedef PVOID PSECURITY_DESCRIPTOR;
+typedef ULONG SECURITY_INFORMATION, *PSECURITY_INFORMATION;
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        ULONG LowPart;
+        LONG HighPart;
+    };
+    struct
+    {
+        ULONG LowPart;
+        LONG HighPart;
+    } u;
+    LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef union _ULARGE_INTEGER
+{
+    struct
+    {
+        ULONG LowPart;
+        ULONG HighPart;
+    };
+    struct
+    {
+        ULONG LowPart;
+        ULONG HighPart;
+    } u;
+    ULONGLONG QuadPart;
+} ULARGE_INTEGER, *PULARGE_INTEGER;
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, *PFILETIME, *LPFILETIME;
+
+typedef struct _SYSTEMTIME
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME, *PSYSTEMTIME, *LPSYSTEMTIME;
+
+typedef struct _GUID
+{
+    ULONG Data1;
+    USHORT Data2;
+    USHORT Data3;
+    UCHAR Data4[8];
+} GUID, *LPGUID;
+typedef GUID *PGUID;
+typedef const GUID *LPCGUID;
+typedef GUID IID, CLSID;
+
+typedef struct _LUID
+{
+    ULONG LowPart;
+    LONG HighPart;
+} LUID, *PLUID;
+
+typedef struct _RECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+} RECT, *PRECT, *LPRECT;
+
+typedef struct _POINT
+{
+    LONG x;
+    LONG y;
+} POINT, *PPOINT;
+
+typedef struct _SID
+{
+    BYTE Revision;
+    BYTE SubAuthorityCount;
+    BYTE IdentifierAuthority[6];
+    ULONG SubAuthority[1];
+} SID;
+
+typedef struct _SID_IDENTIFIER_AUTHORITY
+{
+    BYTE Value[6];
+} SID_IDENTIFIER_AUTHORITY, *PSID_IDENTIFIER_AUTHORITY;
+
+#define SID_REVISION 1
+#define SECURITY_NULL_SID_AUTHORITY { 0, 0, 0, 0, 0, 0 }
+#define SECURITY_WORLD_SID_AUTHORITY { 0, 0, 0, 0, 0, 1 }
+#define SECURITY_LOCAL_SID_AUTHORITY { 0, 0, 0, 0, 0, 2 }
+#define SECURITY_CREATOR_SID_AUTHORITY { 0, 0, 0, 0, 0, 3 }
+#define SECURITY_NT_AUTHORITY { 0, 0, 0, 0, 0, 5 }
+#define SECURITY_NULL_RID 0x00000000
+#define SECURITY_WORLD_RID 0x00000000
+#define SECURITY_LOCAL_RID 0x00000000
+#define SECURITY_CREATOR_OWNER_RID 0x00000000
+#define SECURITY_CREATOR_GROUP_RID 0x00000001
+#define SECURITY_DIALUP_RID 0x00000001
+#define SECURITY_NETWORK_RID 0x00000002
+#define SECURITY_BATCH_RID 0x00000003
+#define SECURITY_INTERACTIVE_RID 0x00000004
+#define SECURITY_SERVICE_RID 0x00000006
+#define SECURITY_ANONYMOUS_LOGON_RID 0x00000007
+#define SECURITY_PROXY_RID 0x00000008
+#define SECURITY_AUTHENTICATED_USER_RID 0x0000000b
+#define SECURITY_RESTRICTED_CODE_RID 0x0000000c
+#define SECURITY_TERMINAL_SERVER_RID 0x0000000d
+#define SECURITY_REMOTE_LOGON_RID 0x0000000e
+#define SECURITY_LOCAL_SYSTEM_RID 0x00000012
+#define SECURITY_LOCAL_SERVICE_RID 0x00000013
+#define SECURITY_NETWORK_SERVICE_RID 0x00000014
+
+typedef struct _SID_AND_ATTRIBUTES
+{
+    PSID Sid;
+    ULONG Attributes;
+} SID_AND_ATTRIBUTES, *PSID_AND_ATTRIBUTES;
+
+typedef struct _LUID_AND_ATTRIBUTES
+{
+    LUID Luid;
+    ULONG Attributes;
+} LUID_AND_ATTRIBUTES, *PLUID_AND_ATTRIBUTES;
+
+typedef struct _GENERIC_MAPPING
+{
+    ACCESS_MASK GenericRead;
+    ACCESS_MASK GenericWrite;
+    ACCESS_MASK GenericExecute;
+    ACCESS_MASK GenericAll;
+} GENERIC_MAPPING, *PGENERIC_MAPPING;
+
+typedef enum _TOKEN_ELEVATION_TYPE
+{
+    TokenElevationTypeDefault = 1,
+    TokenElevationTypeFull,
+    TokenElevationTypeLimited
+} TOKEN_ELEVATION_TYPE, *PTOKEN_ELEVATION_TYPE;
+
+typedef struct _TOKEN_USER *PTOKEN_USER;
+typedef struct _TOKEN_OWNER *PTOKEN_OWNER;
+typedef struct _TOKEN_PRIMARY_GROUP *PTOKEN_PRIMARY_GROUP;
+typedef struct _TOKEN_GROUPS *PTOKEN_GROUPS;
+typedef struct _TOKEN_PRIVILEGES *PTOKEN_PRIVILEGES;
+typedef struct _TOKEN_STATISTICS *PTOKEN_STATISTICS;
+typedef struct _ACL *PACL;
+
+typedef struct _OSVERSIONINFOEXW
+{
+    ULONG dwOSVersionInfoSize;
+    ULONG dwMajorVersion;
+    ULONG dwMinorVersion;
+    ULONG dwBuildNumber;
+    ULONG dwPlatformId;
+    WCHAR szCSDVersion[128];
+    USHORT wServicePackMajor;
+    USHORT wServicePackMinor;
+    USHORT wSuiteMask;
+    UCHAR wProductType;
+    UCHAR wReserved;
+} OSVERSIONINFOEXW, *POSVERSIONINFOEXW, RTL_OSVERSIONINFOEXW, *PRTL_OSVERSIONINFOEXW;
+
+typedef struct _MEMORY_BASIC_INFORMATION
+{
+    PVOID BaseAddress;
+    PVOID AllocationBase;
+    ULONG AllocationProtect;
+    SIZE_T RegionSize;
+    ULONG State;
+    ULONG Protect;
+    ULONG Type;
+} MEMORY_BASIC_INFORMATION, *PMEMORY_BASIC_INFORMATION;
+
+typedef struct _IO_COUNTERS
+{
+    ULONGLONG ReadOperationCount;
+    ULONGLONG WriteOperationCount;
+    ULONGLONG OtherOperationCount;
+    ULONGLONG ReadTransferCount;
+    ULONGLONG WriteTransferCount;
+    ULONGLONG OtherTransferCount;
+} IO_COUNTERS, *PIO_COUNTERS;
+
+typedef struct _VM_COUNTERS *PVM_COUNTERS;
+
+// Lists
+
+typedef struct _LIST_ENTRY
+{
+    struct _LIST_ENTRY *Flink;
+    struct _LIST_ENTRY *Blink;
+} LIST_ENTRY, *PLIST_ENTRY, *PRLIST_ENTRY;
+
+typedef struct _SINGLE_LIST_ENTRY
+{
+    struct _SINGLE_LIST_ENTRY *Next;
+} SINGLE_LIST_ENTRY, *PSINGLE_LIST_ENTRY;
+
+typedef struct DECLSPEC_ALIGN(16) _SLIST_ENTRY
+{
+    struct _SLIST_ENTRY *Next;
+} SLIST_ENTRY, *PSLIST_ENTRY;
+
+typedef union DECLSPEC_ALIGN(16) _SLIST_HEADER
+{
+    struct
+    {
+        PSLIST_ENTRY Next;
+        ULONGLONG Sequence;
+    } s;
+    unsigned __int128 Value;
+} SLIST_HEADER, *PSLIST_HEADER;
+
+// Critical sections
+
+typedef struct _RTL_CRITICAL_SECTION
+{
+    PVOID Mutex;
+} RTL_CRITICAL_SECTION, *PRTL_CRITICAL_SECTION, CRITICAL_SECTION, *PCRITICAL_SECTION;
+
+// Status values
+
+#define STATUS_SUCCESS ((NTSTATUS)0x00000000)
+#define STATUS_WAIT_0 ((NTSTATUS)0x00000000)
+#define STATUS_ABANDONED ((NTSTATUS)0x00000080)
+#define STATUS_USER_APC ((NTSTATUS)0x000000c0)
+#define STATUS_ALERTED ((NTSTATUS)0x00000101)
+#define STATUS_TIMEOUT ((NTSTATUS)0x00000102)
+#define STATUS_PENDING ((NTSTATUS)0x00000103)
+#define STATUS_MORE_ENTRIES ((NTSTATUS)0x00000105)
+#define STATUS_BUFFER_OVERFLOW ((NTSTATUS)0x80000005)
+#define STATUS_NO_MORE_ENTRIES ((NTSTATUS)0x8000001a)
+#define STATUS_UNSUCCESSFUL ((NTSTATUS)0xc0000001)
+#define STATUS_NOT_IMPLEMENTED ((NTSTATUS)0xc0000002)
+#define STATUS_INVALID_INFO_CLASS ((NTSTATUS)0xc0000003)
+#define STATUS_INFO_LENGTH_MISMATCH ((NTSTATUS)0xc0000004)
+#define STATUS_ACCESS_VIOLATION ((NTSTATUS)0xc0000005)
+#define STATUS_INVALID_HANDLE ((NTSTATUS)0xc0000008)
+#define STATUS_INVALID_PARAMETER ((NTSTATUS)0xc000000d)
+#define STATUS_NO_SUCH_FILE ((NTSTATUS)0xc000000f)
+#define STATUS_NO_MEMORY ((NTSTATUS)0xc0000017)
+#define STATUS_ACCESS_DENIED ((NTSTATUS)0xc0000022)
+#define STATUS_BUFFER_TOO_SMALL ((NTSTATUS)0xc0000023)
+#define STATUS_OBJECT_TYPE_MISMATCH ((NTSTATUS)0xc0000024)
+#define STATUS_OBJECT_NAME_INVALID ((NTSTATUS)0xc0000033)
+#define STATUS_OBJECT_NAME_NOT_FOUND ((NTSTATUS)0xc0000034)
+#define STATUS_SEMAPHORE_LIMIT_EXCEEDED ((NTSTATUS)0xc0000047)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xc000009a)
+#define STATUS_NOT_SUPPORTED ((NTSTATUS)0xc00000bb)
+#define STATUS_INTERNAL_ERROR ((NTSTATUS)0xc00000e5)
+#define STATUS_INVALID_PARAMETER_MIX ((NTSTATUS)0xc0000030)
+#define STATUS_INVALID_PARAMETER_1 ((NTSTATUS)0xc00000ef)
+#define STATUS_INVALID_PARAMETER_2 ((NTSTATUS)0xc00000f0)
+#define STATUS_INVALID_PARAMETER_3 ((NTSTATUS)0xc00000f1)
+#define STATUS_CANCELLED ((NTSTATUS)0xc0000120)
+#define STATUS_NOT_FOUND ((NTSTATUS)0xc0000225)
+#define STATUS_INTEGER_OVERFLOW ((NTSTATUS)0xc0000095)
+#define STATUS_SOME_NOT_MAPPED ((NTSTATUS)0x00000107)
+#define STATUS_NONE_MAPPED ((NTSTATUS)0xc0000073)
+#define STATUS_INVALID_SID ((NTSTATUS)0xc0000078)
+#define STATUS_NO_TOKEN ((NTSTATUS)0xc000007c)
+#define STATUS_INVALID_ADDRESS ((NTSTATUS)0xc0000141)
+#define STATUS_PARTIAL_COPY ((NTSTATUS)0x8000000d)
+#define STATUS_NOT_ALL_ASSIGNED ((NTSTATUS)0x00000106)
+#define STATUS_UNEXPECTED_IO_ERROR ((NTSTATUS)0xc00000e9)
+#define STATUS_INVALID_IMAGE_FORMAT ((NTSTATUS)0xc000007b)
+#define STATUS_INVALID_DEVICE_REQUEST ((NTSTATUS)0xc0000010)
+#define STATUS_END_OF_FILE ((NTSTATUS)0xc0000011)
+#define STATUS_FILE_IS_A_DIRECTORY ((NTSTATUS)0xc00000ba)
+#define STATUS_NOT_A_DIRECTORY ((NTSTATUS)0xc0000103)
+#define STATUS_OBJECT_PATH_NOT_FOUND ((NTSTATUS)0xc000003a)
+#define STATUS_NO_SUCH_DEVICE ((NTSTATUS)0xc000000e)
+#define STATUS_OBJECT_NAME_COLLISION ((NTSTATUS)0xc0000035)
+#define STATUS_OBJECT_NAME_EXISTS ((NTSTATUS)0x40000000)
+#define STATUS_GUARD_PAGE_VIOLATION ((NTSTATUS)0x80000001)
+#define STATUS_DATATYPE_MISALIGNMENT ((NTSTATUS)0x80000002)
+
+#define FACILITY_NTWIN32 0x7
+
+// Access rights and flags
+
+#define DELETE 0x00010000
+#define READ_CONTROL 0x00020000
+#define WRITE_DAC 0x00040000
+#define WRITE_OWNER 0x00080000
+#define SYNCHRONIZE 0x00100000
+#define STANDARD_RIGHTS_REQUIRED 0x000f0000
+#define STANDARD_RIGHTS_READ READ_CONTROL
+#define STANDARD_RIGHTS_WRITE READ_CONTROL
+#define STANDARD_RIGHTS_EXECUTE READ_CONTROL
+#define STANDARD_RIGHTS_ALL 0x001f0000
+#define MAXIMUM_ALLOWED 0x02000000
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define GENERIC_EXECUTE 0x20000000
+#define GENERIC_ALL 0x10000000
+#define EVENT_QUERY_STATE 0x0001
+#define EVENT_MODIFY_STATE 0x0002
+#define EVENT_ALL_ACCESS (STANDARD_RIGHTS_REQUIRED | SYNCHRONIZE | 0x3)
+#define SEMAPHORE_QUERY_STATE 0x0001
+#define SEMAPHORE_MODIFY_STATE 0x0002
+#define SEMAPHORE_ALL_ACCESS (STANDARD_RIGHTS_REQUIRED | SYNCHRONIZE | 0x3)
+#define HEAP_NO_SERIALIZE 0x00000001
+#define HEAP_GROWABLE 0x00000002
+#define HEAP_GENERATE_EXCEPTIONS 0x00000004
+#define HEAP_ZERO_MEMORY 0x00000008
+#define HEAP_CLASS_1 0x00001000
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_DECOMMIT 0x00004000
+#define MEM_RELEASE 0x00008000
+#define PAGE_NOACCESS 0x01
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define TLS_OUT_OF_INDEXES ((ULONG)0xffffffff)
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define EXCEPTION_EXECUTE_HANDLER 1
+#define EXCEPTION_CONTINUE_SEARCH 0
+#define EXCEPTION_NONCONTINUABLE 0x1
+#define CP_ACP 0
+#define CP_UTF8 65001
+#define LOCALE_USER_DEFAULT 0x400
+#define LOCALE_SDECIMAL 0x0000000e
+#define LOCALE_STHOUSAND 0x0000000f
+#define ERROR_SUCCESS 0L
+#define NO_ERROR 0L
+#define SECURITY_MAX_SID_SIZE 68
+#define ANYSIZE_ARRAY 1
+
+// Memory
+
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define RtlMoveMemory(Destination, Source, Length) memmove((Destination), (Source), (Length))
+#define RtlFillMemory(Destination, Length, Fill) memset((Destination), (Fill), (Length))
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlEqualMemory(Destination, Source, Length) (!memcmp((Destination), (Source), (Length)))
+#define CopyMemory RtlCopyMemory
+#define MoveMemory RtlMoveMemory
+#define FillMemory RtlFillMemory
+#define ZeroMemory RtlZeroMemory
+#define memcpy_s(Destination, Size, Source, Count) memcpy((Destination), (Source), (Count))
+
+// Bit and integer helpers
+
+#define LOBYTE(w) ((BYTE)(((DWORD_PTR)(w)) & 0xff))
+#define HIBYTE(w) ((BYTE)((((DWORD_PTR)(w)) >> 8) & 0xff))
+#define LOWORD(l) ((WORD)(((DWORD_PTR)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xffff))
+#define MAKELONG(a, b) ((LONG)(((WORD)(((DWORD_PTR)(a)) & 0xffff)) | ((DWORD)((WORD)(((DWORD_PTR)(b)) & 0xffff))) << 16))
+#define UInt32x32To64(a, b) ((ULONGLONG)(ULONG)(a) * (ULONGLONG)(ULONG)(b))
+#define Int32x32To64(a, b) ((LONGLONG)(LONG)(a) * (LONGLONG)(LONG)(b))
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define COINIT_MULTITHREADED 0x0
+#define COINIT_APARTMENTTHREADED 0x2
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000ffff) | (7 << 16) | 0x80000000)))
+
+// Doubly linked lists
+
+FORCEINLINE VOID InitializeListHead(
+    _Out_ PLIST_ENTRY ListHead
+    )
+{
+    ListHead->Flink = ListHead->Blink = ListHead;
+}
+
+FORCEINLINE BOOLEAN IsListEmpty(
+    _In_ const LIST_ENTRY *ListHead
+    )
+{
+    return ListHead->Flink == ListHead;
+}
+
+FORCEINLINE BOOLEAN RemoveEntryList(
+    _In_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY blink;
+    PLIST_ENTRY flink;
+
+    flink = Entry->Flink;
+    blink = Entry->Blink;
+    blink->Flink = flink;
+    flink->Blink = blink;
+
+    return flink == blink;
+}
+
+FORCEINLINE PLIST_ENTRY RemoveHeadList(
+    _Inout_ PLIST_ENTRY ListHead
+    )
+{
+    PLIST_ENTRY flink;
+    PLIST_ENTRY entry;
+
+    entry = ListHead->Flink;
+    flink = entry->Flink;
+    ListHead->Flink = flink;
+    flink->Blink = ListHead;
+
+    return entry;
+}
+
+FORCEINLINE PLIST_ENTRY RemoveTailList(
+    _Inout_ PLIST_ENTRY ListHead
+    )
+{
+    PLIST_ENTRY blink;
+    PLIST_ENTRY entry;
+
+    entry = ListHead->Blink;
+    blink = entry->Blink;
+    ListHead->Blink = blink;
+    blink->Flink = ListHead;
+
+    return entry;
+}
+
+FORCEINLINE VOID InsertTailList(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Inout_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY blink;
+
+    blink = ListHead->Blink;
+    Entry->Flink = ListHead;
+    Entry->Blink = blink;
+    blink->Flink = Entry;
+    ListHead->Blink = Entry;
+}
+
+FORCEINLINE VOID InsertHeadList(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Inout_ PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY flink;
+
+    flink = ListHead->Flink;
+    Entry->Flink = flink;
+    Entry->Blink = ListHead;
+    flink->Blink = Entry;
+    ListHead->Flink = Entry;
+}
+
+FORCEINLINE VOID PushEntryList(
+    _Inout_ PSINGLE_LIST_ENTRY ListHead,
+    _Inout_ PSINGLE_LIST_ENTRY Entry
+    )
+{
+    Entry->Next = ListHead->Next;
+    ListHead->Next = Entry;
+}
+
+FORCEINLINE PSINGLE_LIST_ENTRY PopEntryList(
+    _Inout_ PSINGLE_LIST_ENTRY ListHead
+    )
+{
+    PSINGLE_LIST_ENTRY firstEntry;
+
+    firstEntry = ListHead->Next;
+
+    if (firstEntry)
+        ListHead->Next = firstEntry->Next;
+
+    return firstEntry;
+}
+
+// Interlocked operations
+
+#define MemoryBarrier() __sync_synchronize()
+#define YieldProcessor() __builtin_ia32_pause()
+#define _ReadWriteBarrier() __asm__ __volatile__("" ::: "memory")
+
+FORCEINLINE LONG _InterlockedIncrement(LONG volatile *Addend) { return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedDecrement(LONG volatile *Addend) { return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedExchangeAdd(LONG volatile *Addend, LONG Value) { return __atomic_fetch_add(Addend, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedExchange(LONG volatile *Target, LONG Value) { return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedCompareExchange(LONG volatile *Destination, LONG Exchange, LONG Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, Exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+FORCEINLINE LONG _InterlockedOr(LONG volatile *Destination, LONG Value) { return __atomic_fetch_or(Destination, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedAnd(LONG volatile *Destination, LONG Value) { return __atomic_fetch_and(Destination, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG _InterlockedXor(LONG volatile *Destination, LONG Value) { return __atomic_fetch_xor(Destination, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE BOOLEAN _interlockedbittestandset(LONG volatile *Base, LONG Bit)
+{
+    return (__atomic_fetch_or(Base, 1 << Bit, __ATOMIC_SEQ_CST) >> Bit) & 1;
+}
+FORCEINLINE BOOLEAN _interlockedbittestandreset(LONG volatile *Base, LONG Bit)
+{
+    return (__atomic_fetch_and(Base, ~(1 << Bit), __ATOMIC_SEQ_CST) >> Bit) & 1;
+}
+FORCEINLINE BOOLEAN _interlockedbittestandset64(LONG64 volatile *Base, LONG64 Bit)
+{
+    return (__atomic_fetch_or(Base, 1LL << Bit, __ATOMIC_SEQ_CST) >> Bit) & 1;
+}
+FORCEINLINE BOOLEAN _interlockedbittestandreset64(LONG64 volatile *Base, LONG64 Bit)
+{
+    return (__atomic_fetch_and(Base, ~(1LL << Bit), __ATOMIC_SEQ_CST) >> Bit) & 1;
+}
+FORCEINLINE LONG64 _InterlockedIncrement64(LONG64 volatile *Addend) { return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG64 _InterlockedDecrement64(LONG64 volatile *Addend) { return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG64 _InterlockedExchangeAdd64(LONG64 volatile *Addend, LONG64 Value) { return __atomic_fetch_add(Addend, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG64 _InterlockedExchange64(LONG64 volatile *Target, LONG64 Value) { return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG64 _InterlockedCompareExchange64(LONG64 volatile *Destination, LONG64 Exchange, LONG64 Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, Exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+FORCEINLINE LONG64 _InterlockedOr64(LONG64 volatile *Destination, LONG64 Value) { return __atomic_fetch_or(Destination, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE LONG64 _InterlockedAnd64(LONG64 volatile *Destination, LONG64 Value) { return __atomic_fetch_and(Destination, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE PVOID _InterlockedExchangePointer(PVOID volatile *Target, PVOID Value) { return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST); }
+FORCEINLINE PVOID _InterlockedCompareExchangePointer(PVOID volatile *Destination, PVOID Exchange, PVOID Comperand)
+{
+    __atomic_compare_exchange_n(Destination, &Comperand, Exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return Comperand;
+}
+
+#define InterlockedIncrement _InterlockedIncrement
+#define InterlockedDecrement _InterlockedDecrement
+#define InterlockedExchange _InterlockedExchange
+#define InterlockedExchangeAdd _InterlockedExchangeAdd
+#define InterlockedCompareExchange _InterlockedCompareExchange
+#define InterlockedOr _InterlockedOr
+#define InterlockedAnd _InterlockedAnd
+#define InterlockedIncrement64 _InterlockedIncrement64
+#define InterlockedDecrement64 _InterlockedDecrement64
+#define InterlockedExchangeAdd64 _InterlockedExchangeAdd64
+#define InterlockedExchange64 _InterlockedExchange64
+#define InterlockedCompareExchange64 _InterlockedCompareExchange64
+#define InterlockedExchangePointer _InterlockedExchangePointer
+#define InterlockedCompareExchangePointer _InterlockedCompareExchangePointer
+#define _InterlockedIncrementSizeT(a) ((SIZE_T)_InterlockedIncrement64((LONG64 volatile *)(a)))
+#define _InterlockedDecrementSizeT(a) ((SIZE_T)_InterlockedDecrement64((LONG64 volatile *)(a)))
+#define InterlockedExchangeAddSizeT(a, b) ((SIZE_T)_InterlockedExchangeAdd64((LONG64 volatile *)(a), (LONG64)(b)))
+#define InterlockedIncrementSizeT _InterlockedIncrementSizeT
+#define InterlockedDecrementSizeT _InterlockedDecrementSizeT
+
+// Interlocked singly linked lists
+
+VOID RtlInitializeSListHead(
+    _Out_ PSLIST_HEADER ListHead
+    );
+
+PSLIST_ENTRY RtlFirstEntrySList(
+    _In_ const SLIST_HEADER *ListHead
+    );
+
+PSLIST_ENTRY RtlInterlockedPopEntrySList(
+    _Inout_ PSLIST_HEADER ListHead
+    );
+
+PSLIST_ENTRY RtlInterlockedPushEntrySList(
+    _Inout_ PSLIST_HEADER ListHead,
+    _Inout_ PSLIST_ENTRY ListEntry
+    );
+
+PSLIST_ENTRY RtlInterlockedFlushSList(
+    _Inout_ PSLIST_HEADER ListHead
+    );
+
+USHORT RtlQueryDepthSList(
+    _In_ PSLIST_HEADER ListHead
+    );
+
+#define InitializeSListHead RtlInitializeSListHead
+#define InterlockedPushEntrySList RtlInterlockedPushEntrySList
+#define InterlockedPopEntrySList RtlInterlockedPopEntrySList
+#define InterlockedFlushSList RtlInterlockedFlushSList
+
+// Thread local storage
+
+ULONG TlsAlloc(
+    VOID
+    );
+
+BOOL TlsFree(
+    _In_ ULONG TlsIndex
+    );
+
+PVOID TlsGetValue(
+    _In_ ULONG TlsIndex
+    );
+
+BOOL TlsSetValue(
+    _In_ ULONG TlsIndex,
+    _In_opt_ PVOID TlsValue
+    );
+
+// Threads
+
+typedef ULONG (NTAPI *PTHREAD_START_ROUTINE)(
+    _In_ PVOID lpThreadParameter
+    );
+typedef PTHREAD_START_ROUTINE LPTHREAD_START_ROUTINE;
+
+HANDLE CreateThread(
+    _In_opt_ PVOID lpThreadAttributes,
+    _In_ SIZE_T dwStackSize,
+    _In_ LPTHREAD_START_ROUTINE lpStartAddress,
+    _In_opt_ PVOID lpParameter,
+    _In_ ULONG dwCreationFlags,
+    _Out_opt_ PULONG lpThreadId
+    );
+
+VOID Sleep(
+    _In_ ULONG dwMilliseconds
+    );
+
+ULONG GetCurrentProcessorNumber(
+    VOID
+    );
+
+ULONG GetLastError(
+    VOID
+    );
+
+VOID SetLastError(
+    _In_ ULONG dwErrCode
+    );
+
+// Modules
+
+HMODULE GetModuleHandle(
+    _In_opt_ PCWSTR lpModuleName
+    );
+
+PVOID GetProcAddress(
+    _In_ HMODULE hModule,
+    _In_ PCSTR lpProcName
+    );
+
+// COM
+
+HRESULT CoInitializeEx(
+    _In_opt_ PVOID pvReserved,
+    _In_ ULONG dwCoInit
+    );
+
+VOID CoUninitialize(
+    VOID
+    );
+
+// Locale
+
+int GetLocaleInfo(
+    _In_ LCID Locale,
+    _In_ ULONG LCType,
+    _Out_writes_opt_(cchData) PWSTR lpLCData,
+    _In_ int cchData
+    );
+
+// CRT
+
+#define _TRUNCATE ((size_t)-1)
+#define _CVTBUFSIZE (309 + 40)
+#define _countof ARRAYSIZE
+
+size_t PhShimWcslen(const WCHAR *String);
+int PhShimWcscmp(const WCHAR *String1, const WCHAR *String2);
+int PhShimWcsicmp(const WCHAR *String1, const WCHAR *String2);
+WCHAR *PhShimWmemset(WCHAR *Destination, WCHAR Value, size_t Count);
+WCHAR *PhShimWcsupr(WCHAR *String);
+WCHAR *PhShimWcslwr(WCHAR *String);
+WCHAR PhShimTowupper(WCHAR Character);
+WCHAR PhShimTowlower(WCHAR Character);
+WCHAR *PhShimUi64tow(ULONG64 Value, WCHAR *Buffer, int Radix);
+WCHAR *PhShimI64tow(LONG64 Value, WCHAR *Buffer, int Radix);
+int PhShimVscwprintf(const WCHAR *Format, va_list ArgPtr);
+int PhShimVsnwprintf(WCHAR *Buffer, size_t Count, const WCHAR *Format, va_list ArgPtr);
+int PhShimSnwprintf(WCHAR *Buffer, size_t Count, const WCHAR *Format, ...);
+void PhShimQsortS(void *Base, size_t Count, size_t Size,
+    int (*Compare)(void *, const void *, const void *), void *Context);
+_locale_t _create_locale(int Category, const char *Locale);
+errno_t _cfltcvt_l(double *arg, char *buffer, size_t sizeInBytes,
+    int format, int precision, int caps, _locale_t plocinfo);
+void _cropzeros_l(char *_Buf, _locale_t _Locale);
+void _forcdecpt_l(char *_Buf, _locale_t _Locale);
+
+#define stricmp strcasecmp
+#define _stricmp strcasecmp
+#define strnicmp strncasecmp
+#define _strnicmp strncasecmp
+#define wcslen PhShimWcslen
+#define wcscmp PhShimWcscmp
+#define wcsicmp PhShimWcsicmp
+#define _wcsicmp PhShimWcsicmp
+#define wmemset PhShimWmemset
+#define _wcsupr PhShimWcsupr
+#define _wcslwr PhShimWcslwr
+#define towupper PhShimTowupper
+#define towlower PhShimTowlower
+#define _ui64tow PhShimUi64tow
+#define _i64tow PhShimI64tow
+#define _ultow(Value, Buffer, Radix) PhShimUi64tow((ULONG)(Value), Buffer, Radix)
+#define _ltow(Value, Buffer, Radix) PhShimI64tow((LONG)(Value), Buffer, Radix)
+#define _vscwprintf PhShimVscwprintf
+#define _vsnwprintf PhShimVsnwprintf
+#define _snwprintf PhShimSnwprintf
+#define qsort_s PhShimQsortS
+
+// Structured exception handling is not available. Guarded blocks always run and handlers never
+// run; exceptions raised with RtlRaiseStatus terminate the process.
+
+#define __try if (1)
+#define __except(Filter) else if (0)
+#define __finally
+#define GetExceptionCode() STATUS_SUCCESS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _PH_PH_H
+#define _PH_PH_H
+
+#include <phbase.h>
+
+#endif
@@ -0,0 +1,165 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+static VOID PrintUsage(
+    VOID
+    )
+{
+    printf(
+        "Usage: phlib-bench [options]\n"
+        "  --size N[,N...]        operations per sample (default 10000)\n"
+        "  --threads N[,N...]     thread counts for threaded benchmarks (default 1,2,4)\n"
+        "  --iterations N         samples per benchmark (default 20)\n"
+        "  --filter PREFIX        only run benchmarks whose names start with PREFIX\n"
+        "  --json FILE            write results to FILE in JSON format (- for stdout)\n"
+        "  --baseline FILE        compare medians against results saved with --json\n"
+        "  --threshold PERCENT    slowdown considered a regression (default 10)\n"
+        "The exit code is 1 if any benchmark regressed against the baseline.\n"
+        );
+}
+
+static ULONG ParseList(
+    _In_ PSTR String,
+    _Out_writes_(MaximumCount) PULONG Values,
+    _In_ ULONG MaximumCount
+    )
+{
+    ULONG count = 0;
+    PSTR p = String;
+
+    while (*p && count < MaximumCount)
+    {
+        PSTR end;
+        unsigned long value;
+
+        value = strtoul(p, &end, 10);
+
+        if (end == p || value == 0)
+            return 0;
+
+        Values[count++] = (ULONG)value;
+        p = end;
+
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return 0;
+    }
+
+    return count;
+}
+
+int __cdecl main(int argc, char *argv[])
+{
+    NTSTATUS status;
+    ULONG sizes[BENCH_MAXIMUM_PARAMETERS] = { 10000 };
+    ULONG numberOfSizes = 1;
+    ULONG threadCounts[BENCH_MAXIMUM_PARAMETERS] = { 1, 2, 4 };
+    ULONG numberOfThreadCounts = 3;
+    ULONG iterations = 20;
+    PSTR filter = NULL;
+    PSTR jsonFileName = NULL;
+    PSTR baselineFileName = NULL;
+    DOUBLE threshold = 10;
+    PBENCH_RESULT results;
+    ULONG numberOfResults;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        PSTR value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            PrintUsage();
+            return 0;
+        }
+
+        if (!value)
+        {
+            PrintUsage();
+            return 2;
+        }
+
+        if (strcmp(argv[i], "--size") == 0)
+            numberOfSizes = ParseList(value, sizes, RTL_NUMBER_OF(sizes));
+        else if (strcmp(argv[i], "--threads") == 0)
+            numberOfThreadCounts = ParseList(value, threadCounts, RTL_NUMBER_OF(threadCounts));
+        else if (strcmp(argv[i], "--iterations") == 0)
+            iterations = strtoul(value, NULL, 10);
+        else if (strcmp(argv[i], "--filter") == 0)
+            filter = value;
+        else if (strcmp(argv[i], "--json") == 0)
+            jsonFileName = value;
+        else if (strcmp(argv[i], "--baseline") == 0)
+            baselineFileName = value;
+        else if (strcmp(argv[i], "--threshold") == 0)
+            threshold = strtod(value, NULL);
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+
+        i++;
+    }
+
+    if (numberOfSizes == 0 || numberOfThreadCounts == 0 || iterations == 0)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    status = PhInitializePhLib();
+
+    if (!NT_SUCCESS(status))
+    {
+        fprintf(stderr, "Unable to initialize phlib: 0x%08x\n", (ULONG)status);
+        return 1;
+    }
+
+    Bench_collect();
+    Bench_basesup();
+    Bench_sync();
+
+    numberOfResults = BenchRunAll(sizes, numberOfSizes, threadCounts, numberOfThreadCounts, iterations, filter, &results);
+
+    if (jsonFileName)
+    {
+        if (!BenchWriteJson(jsonFileName, results, numberOfResults, iterations))
+        {
+            fprintf(stderr, "Unable to write %s\n", jsonFileName);
+            return 2;
+        }
+    }
+
+    if (baselineFileName)
+    {
+        PBENCH_RESULT baselineResults;
+        ULONG numberOfBaselineResults;
+        ULONG numberOfRegressions;
+
+        if (!BenchReadJson(baselineFileName, &baselineResults, &numberOfBaselineResults))
+        {
+            fprintf(stderr, "Unable to read %s\n", baselineFileName);
+            return 2;
+        }
+
+        numberOfRegressions = BenchCompareResults(results, numberOfResults, baselineResults,
+            numberOfBaselineResults, threshold);
+
+        PhFree(baselineResults);
+
+        if (numberOfRegressions != 0)
+        {
+            printf("\n%lu benchmark(s) regressed by more than %.1f%%\n", (unsigned long)numberOfRegressions, threshold);
+            PhFree(results);
+            return 1;
+        }
+    }
+
+    PhFree(results);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "tests.h"
+#include <phintrnl.h>
 
 static VOID Test_time(
     VOID
@@ -216,6 +217,245 @@ VOID Test_stringref(
     DO_STRSTR_TEST(PhFindStringInStringRef, L"0sdfasdf1sdfasdf2sdfasdf3sdfasdg4sdfg", L"asdg4Gdfg", -1, FALSE);
 }
 
+static LONG Test_stringref_simd_CompareReference(
+    _In_ PPH_STRINGREF String1,
+    _In_ PPH_STRINGREF String2,
+    _In_ BOOLEAN IgnoreCase
+    )
+{
+    SIZE_T i;
+    SIZE_T length;
+    WCHAR c1;
+    WCHAR c2;
+
+    length = min(String1->Length, String2->Length) / sizeof(WCHAR);
+
+    for (i = 0; i < length; i++)
+    {
+        c1 = String1->Buffer[i];
+        c2 = String2->Buffer[i];
+
+        if (IgnoreCase)
+        {
+            c1 = RtlUpcaseUnicodeChar(c1);
+            c2 = RtlUpcaseUnicodeChar(c2);
+        }
+
+        if (c1 != c2)
+            return (LONG)c1 - (LONG)c2;
+    }
+
+    return (LONG)(String1->Length - String2->Length);
+}
+
+static ULONG_PTR Test_stringref_simd_FindCharReference(
+    _In_ PPH_STRINGREF String,
+    _In_ WCHAR Character,
+    _In_ BOOLEAN IgnoreCase,
+    _In_ BOOLEAN Last
+    )
+{
+    SIZE_T i;
+    SIZE_T length;
+    ULONG_PTR result;
+
+    length = String->Length / sizeof(WCHAR);
+    result = -1;
+
+    if (IgnoreCase)
+        Character = RtlUpcaseUnicodeChar(Character);
+
+    for (i = 0; i < length; i++)
+    {
+        if ((IgnoreCase ? RtlUpcaseUnicodeChar(String->Buffer[i]) : String->Buffer[i]) == Character)
+        {
+            result = i;
+
+            if (!Last)
+                break;
+        }
+    }
+
+    return result;
+}
+
+static ULONG_PTR Test_stringref_simd_FindStringReference(
+    _In_ PPH_STRINGREF String,
+    _In_ PPH_STRINGREF SubString,
+    _In_ BOOLEAN IgnoreCase
+    )
+{
+    SIZE_T i;
+    SIZE_T length1;
+    SIZE_T length2;
+    PH_STRINGREF sr;
+
+    length1 = String->Length / sizeof(WCHAR);
+    length2 = SubString->Length / sizeof(WCHAR);
+    sr.Length = SubString->Length;
+
+    for (i = 0; i + length2 <= length1; i++)
+    {
+        sr.Buffer = String->Buffer + i;
+
+        if (Test_stringref_simd_CompareReference(&sr, SubString, IgnoreCase) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+static WCHAR Test_stringref_simd_RandomChar(
+    _Inout_ PULONG Seed
+    )
+{
+    static WCHAR alphabet[] =
+    {
+        'a', 'b', 'z', 'A', 'B', 'Z', '0', '@', '[', '`', '{', '_',
+        0xe9, 0xc9, 0xff, 0x131, 0x17f, 0x212a, 0x3c3, 0x3c2, 0x3a3,
+        0x436, 0x416, 0x8000, 0xffff
+    };
+
+    return alphabet[RtlRandomEx(Seed) % (sizeof(alphabet) / sizeof(WCHAR))];
+}
+
+VOID Test_stringref_simd(
+    VOID
+    )
+{
+    ULONG seed;
+    ULONG maximumVectorLevel;
+    ULONG vectorLevel;
+    ULONG i;
+    ULONG j;
+    ULONG ignoreCase;
+    WCHAR buffer1[80];
+    WCHAR buffer2[80];
+    PH_STRINGREF s1;
+    PH_STRINGREF s2;
+    WCHAR c;
+
+    // Compares the vectorized functions against scalar implementations, at every
+    // vector level supported by the processor.
+
+    seed = 1;
+    maximumVectorLevel = PhGetBaseVectorLevel();
+
+    for (i = 0; i < 20000; i++)
+    {
+        s1.Buffer = buffer1 + RtlRandomEx(&seed) % 8;
+        s1.Length = (RtlRandomEx(&seed) % 64) * sizeof(WCHAR);
+
+        for (j = 0; j < s1.Length / sizeof(WCHAR); j++)
+            s1.Buffer[j] = Test_stringref_simd_RandomChar(&seed);
+
+        s2.Buffer = buffer2 + RtlRandomEx(&seed) % 8;
+
+        if (RtlRandomEx(&seed) % 2 == 0 && s1.Length != 0)
+        {
+            ULONG_PTR start;
+
+            // Take a substring of the first string, and flip the case of some of the
+            // characters.
+            start = RtlRandomEx(&seed) % (s1.Length / sizeof(WCHAR));
+            s2.Length = (RtlRandomEx(&seed) % (s1.Length / sizeof(WCHAR) - start + 1)) * sizeof(WCHAR);
+
+            for (j = 0; j < s2.Length / sizeof(WCHAR); j++)
+            {
+                c = s1.Buffer[start + j];
+
+                if (RtlRandomEx(&seed) % 4 == 0)
+                {
+                    WCHAR upper = RtlUpcaseUnicodeChar(c);
+
+                    c = upper != c ? upper : RtlDowncaseUnicodeChar(c);
+                }
+
+                s2.Buffer[j] = c;
+            }
+        }
+        else
+        {
+            s2.Length = (RtlRandomEx(&seed) % 12) * sizeof(WCHAR);
+
+            for (j = 0; j < s2.Length / sizeof(WCHAR); j++)
+                s2.Buffer[j] = Test_stringref_simd_RandomChar(&seed);
+        }
+
+        c = Test_stringref_simd_RandomChar(&seed);
+
+        for (vectorLevel = PH_VECTOR_LEVEL_NONE; vectorLevel <= maximumVectorLevel; vectorLevel++)
+        {
+            PhSetBaseVectorLevel(vectorLevel);
+
+            for (ignoreCase = 0; ignoreCase < 2; ignoreCase++)
+            {
+                PH_STRINGREF prefix;
+
+                assert(PhCompareStringRef(&s1, &s2, (BOOLEAN)ignoreCase) ==
+                    Test_stringref_simd_CompareReference(&s1, &s2, (BOOLEAN)ignoreCase));
+                assert(PhCompareStringRef(&s2, &s1, (BOOLEAN)ignoreCase) ==
+                    Test_stringref_simd_CompareReference(&s2, &s1, (BOOLEAN)ignoreCase));
+
+                prefix.Buffer = s1.Buffer;
+                prefix.Length = min(s1.Length, s2.Length);
+                assert(PhEqualStringRef(&prefix, &s2, (BOOLEAN)ignoreCase) ==
+                    (prefix.Length == s2.Length && Test_stringref_simd_CompareReference(&prefix, &s2, (BOOLEAN)ignoreCase) == 0));
+
+                assert(PhFindCharInStringRef(&s1, c, (BOOLEAN)ignoreCase) ==
+                    Test_stringref_simd_FindCharReference(&s1, c, (BOOLEAN)ignoreCase, FALSE));
+                assert(PhFindLastCharInStringRef(&s1, c, (BOOLEAN)ignoreCase) ==
+                    Test_stringref_simd_FindCharReference(&s1, c, (BOOLEAN)ignoreCase, TRUE));
+                assert(PhFindStringInStringRef(&s1, &s2, (BOOLEAN)ignoreCase) ==
+                    Test_stringref_simd_FindStringReference(&s1, &s2, (BOOLEAN)ignoreCase));
+            }
+        }
+
+        PhSetBaseVectorLevel(maximumVectorLevel);
+    }
+}
+
+VOID Test_hash(
+    VOID
+    )
+{
+    ULONG seed;
+    ULONG i;
+    ULONG j;
+    WCHAR buffer[64];
+    WCHAR upperBuffer[64];
+    PH_STRINGREF string;
+    PH_STRINGREF upperString;
+
+    // Fnv1aHashAlgorithm must be compatible with PhHashBytes and PhHashStringRef.
+    // A case-insensitive hash using WordHashAlgorithm is defined as the hash of
+    // the uppercase string.
+
+    seed = 1;
+
+    for (i = 0; i < 10000; i++)
+    {
+        string.Buffer = buffer;
+        string.Length = (RtlRandomEx(&seed) % 64) * sizeof(WCHAR);
+        upperString.Buffer = upperBuffer;
+        upperString.Length = string.Length;
+
+        for (j = 0; j < string.Length / sizeof(WCHAR); j++)
+        {
+            buffer[j] = Test_stringref_simd_RandomChar(&seed);
+            upperBuffer[j] = RtlUpcaseUnicodeChar(buffer[j]);
+        }
+
+        assert(PhHashBytesEx((PUCHAR)string.Buffer, string.Length, Fnv1aHashAlgorithm) ==
+            PhHashBytes((PUCHAR)string.Buffer, string.Length));
+        assert(PhHashStringRefEx(&string, TRUE, Fnv1aHashAlgorithm) == PhHashStringRef(&string, TRUE));
+        assert(PhHashStringRefEx(&string, FALSE, WordHashAlgorithm) ==
+            PhHashBytesEx((PUCHAR)string.Buffer, string.Length, WordHashAlgorithm));
+        assert(PhHashStringRefEx(&string, TRUE, WordHashAlgorithm) ==
+            PhHashStringRefEx(&upperString, FALSE, WordHashAlgorithm));
+    }
+}
+
 VOID Test_hexstring(
     VOID
     )
@@ -339,6 +579,253 @@ VOID Test_unicode(
     assert(memcmp(utf8_2->Buffer, utf8_3->Buffer, utf8_2->Length) == 0);
 }
 
+static VOID Test_unicode_ascii_Check(
+    _In_ PCH Utf8,
+    _In_ SIZE_T Utf8Length,
+    _In_ PWCH Utf16,
+    _In_ SIZE_T Utf16Length
+    )
+{
+    ULONG maximumVectorLevel;
+    ULONG vectorLevel;
+    BOOLEAN result;
+    SIZE_T bytes;
+    PPH_STRING utf16;
+    PPH_BYTES utf8;
+    WCHAR utf16Truncated[PH_VECTOR_LEVEL_AVX2 + 1][160];
+    CHAR utf8Truncated[PH_VECTOR_LEVEL_AVX2 + 1][320];
+    BOOLEAN utf16TruncatedResult[PH_VECTOR_LEVEL_AVX2 + 1];
+    BOOLEAN utf8TruncatedResult[PH_VECTOR_LEVEL_AVX2 + 1];
+
+    // Converts in both directions at every vector level supported by the processor.
+    // Complete conversions must match the reference encoding, and conversions into
+    // buffers that are too small must match the scalar path.
+
+    maximumVectorLevel = PhGetBaseVectorLevel();
+
+    for (vectorLevel = PH_VECTOR_LEVEL_NONE; vectorLevel <= maximumVectorLevel; vectorLevel++)
+    {
+        PhSetBaseVectorLevel(vectorLevel);
+
+        result = PhConvertUtf8ToUtf16Size(&bytes, Utf8, Utf8Length);
+        assert(result);
+        assert(bytes == Utf16Length * sizeof(WCHAR));
+        utf16 = PhConvertUtf8ToUtf16Ex(Utf8, Utf8Length);
+        assert(utf16->Length == Utf16Length * sizeof(WCHAR));
+        assert(memcmp(utf16->Buffer, Utf16, utf16->Length) == 0);
+        assert(utf16->Buffer[Utf16Length] == 0);
+        PhDereferenceObject(utf16);
+
+        result = PhConvertUtf16ToUtf8Size(&bytes, Utf16, Utf16Length * sizeof(WCHAR));
+        assert(result);
+        assert(bytes == Utf8Length);
+        utf8 = PhConvertUtf16ToUtf8Ex(Utf16, Utf16Length * sizeof(WCHAR));
+        assert(utf8->Length == Utf8Length);
+        assert(memcmp(utf8->Buffer, Utf8, utf8->Length) == 0);
+        assert(utf8->Buffer[Utf8Length] == 0);
+        PhDereferenceObject(utf8);
+
+        memset(utf16Truncated[vectorLevel], 0xcc, sizeof(utf16Truncated[vectorLevel]));
+        utf16TruncatedResult[vectorLevel] = PhConvertUtf8ToUtf16Buffer(utf16Truncated[vectorLevel],
+            Utf16Length / 2 * sizeof(WCHAR), &bytes, Utf8, Utf8Length);
+        assert(bytes == Utf16Length * sizeof(WCHAR));
+        assert(memcmp(utf16Truncated[vectorLevel], utf16Truncated[PH_VECTOR_LEVEL_NONE], sizeof(utf16Truncated[vectorLevel])) == 0);
+        assert(utf16TruncatedResult[vectorLevel] == utf16TruncatedResult[PH_VECTOR_LEVEL_NONE]);
+
+        memset(utf8Truncated[vectorLevel], 0xcc, sizeof(utf8Truncated[vectorLevel]));
+        utf8TruncatedResult[vectorLevel] = PhConvertUtf16ToUtf8Buffer(utf8Truncated[vectorLevel],
+            Utf8Length / 2, &bytes, Utf16, Utf16Length * sizeof(WCHAR));
+        assert(bytes == Utf8Length);
+        assert(memcmp(utf8Truncated[vectorLevel], utf8Truncated[PH_VECTOR_LEVEL_NONE], sizeof(utf8Truncated[vectorLevel])) == 0);
+        assert(utf8TruncatedResult[vectorLevel] == utf8TruncatedResult[PH_VECTOR_LEVEL_NONE]);
+    }
+
+    // Nothing may be written past the end of the output buffer.
+    assert(utf16Truncated[PH_VECTOR_LEVEL_NONE][Utf16Length / 2] == 0xcccc);
+    assert((UCHAR)utf8Truncated[PH_VECTOR_LEVEL_NONE][Utf8Length / 2] == 0xcc);
+
+    PhSetBaseVectorLevel(maximumVectorLevel);
+}
+
+VOID Test_unicode_ascii(
+    VOID
+    )
+{
+    static ULONG nonAsciiCodePoints[] = { 0x80, 0xe9, 0x20ac, 0xffff, 0x1f600 };
+    static ULONG positions[] = { 0, 1, 14, 15, 16, 17, 30, 31, 32, 33, 47, 48, 49, 63, 64, 65, 95, 96, 97 };
+    BOOLEAN result;
+    ULONG length;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+    ULONG offset;
+    ULONG numberOfCodeUnits;
+    CHAR utf8Buffer[4 + 128 * 4];
+    WCHAR utf16Buffer[4 + 128 * 2];
+    PCH utf8;
+    PWCH utf16;
+    SIZE_T utf8Length;
+    SIZE_T utf16Length;
+
+    // Pure ASCII input of every length (including odd lengths and lengths that are
+    // not multiples of the block size), at several alignments.
+    for (length = 0; length <= 128; length++)
+    {
+        for (offset = 0; offset < 4; offset++)
+        {
+            utf8 = utf8Buffer + offset;
+            utf16 = utf16Buffer + offset;
+
+            for (i = 0; i < length; i++)
+            {
+                utf8[i] = (CHAR)(i == 0 ? 0 : 0x20 + (i * 7 + offset) % 0x60);
+                utf16[i] = (UCHAR)utf8[i];
+            }
+
+            Test_unicode_ascii_Check(utf8, length, utf16, length);
+        }
+    }
+
+    // ASCII input with a single non-ASCII character at and around the block
+    // boundaries, and with a non-ASCII character followed by a run of ASCII.
+    for (length = 1; length <= 100; length++)
+    {
+        for (i = 0; i < sizeof(positions) / sizeof(ULONG); i++)
+        {
+            if (positions[i] >= length)
+                break;
+
+            for (j = 0; j < sizeof(nonAsciiCodePoints) / sizeof(ULONG); j++)
+            {
+                utf8 = utf8Buffer + (length & 3);
+                utf16 = utf16Buffer + (length & 3);
+                utf8Length = 0;
+                utf16Length = 0;
+
+                for (k = 0; k < length; k++)
+                {
+                    ULONG codePoint;
+
+                    if (k == positions[i])
+                        codePoint = nonAsciiCodePoints[j];
+                    else
+                        codePoint = 0x20 + (k * 7) % 0x5f;
+
+                    result = PhEncodeUnicode(PH_UNICODE_UTF8, codePoint, utf8 + utf8Length, &numberOfCodeUnits);
+                    assert(result);
+                    utf8Length += numberOfCodeUnits;
+                    result = PhEncodeUnicode(PH_UNICODE_UTF16, codePoint, utf16 + utf16Length, &numberOfCodeUnits);
+                    assert(result);
+                    utf16Length += numberOfCodeUnits;
+                }
+
+                Test_unicode_ascii_Check(utf8, utf8Length, utf16, utf16Length);
+            }
+        }
+    }
+}
+
+static BOOLEAN NTAPI Test_hashtable_CompareFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return *(PULONG)Entry1 == *(PULONG)Entry2;
+}
+
+static ULONG NTAPI Test_hashtable_HashFunction(
+    _In_ PVOID Entry
+    )
+{
+    // Deliberately weak so that probe sequences collide.
+    return *(PULONG)Entry & 0xff;
+}
+
+VOID Test_hashtable(
+    VOID
+    )
+{
+    static UCHAR present[4096];
+    ULONG flags;
+    PPH_HASHTABLE hashtable;
+    ULONG count;
+    ULONG seed;
+    ULONG i;
+    ULONG entry[2];
+    PULONG result;
+    BOOLEAN added;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+
+    for (flags = 0; flags <= PH_HASHTABLE_OPEN_ADDRESSING; flags += PH_HASHTABLE_OPEN_ADDRESSING)
+    {
+        hashtable = PhCreateHashtableEx(sizeof(entry), Test_hashtable_CompareFunction, Test_hashtable_HashFunction, 1, flags);
+        memset(present, 0, sizeof(present));
+        count = 0;
+        seed = 1;
+
+        for (i = 0; i < 100000; i++)
+        {
+            entry[0] = RtlRandomEx(&seed) % 4096;
+            entry[1] = entry[0] * 3;
+
+            switch (RtlRandomEx(&seed) % 3)
+            {
+            case 0:
+                result = PhAddEntryHashtableEx(hashtable, entry, &added);
+                assert(added == !present[entry[0]]);
+                assert(result[0] == entry[0] && result[1] == entry[1]);
+
+                if (added)
+                {
+                    present[entry[0]] = TRUE;
+                    count++;
+                }
+
+                break;
+            case 1:
+                result = PhFindEntryHashtable(hashtable, entry);
+                assert(!!result == present[entry[0]]);
+                assert(!result || result[1] == entry[1]);
+                break;
+            case 2:
+                added = PhRemoveEntryHashtable(hashtable, entry);
+                assert(added == present[entry[0]]);
+
+                if (added)
+                {
+                    present[entry[0]] = FALSE;
+                    count--;
+                }
+
+                break;
+            }
+
+            assert(hashtable->Count == count);
+        }
+
+        PhBeginEnumHashtable(hashtable, &enumContext);
+
+        while (result = PhNextEnumHashtable(&enumContext))
+        {
+            assert(present[result[0]]);
+            count--;
+        }
+
+        assert(count == 0);
+
+        PhClearHashtable(hashtable);
+        assert(hashtable->Count == 0);
+
+        for (i = 0; i < 4096; i++)
+        {
+            entry[0] = i;
+            assert(!PhFindEntryHashtable(hashtable, entry));
+        }
+
+        PhDereferenceObject(hashtable);
+    }
+}
+
 VOID Test_basesup(
     VOID
     )
@@ -346,7 +833,11 @@ VOID Test_basesup(
     Test_time();
     Test_stringz();
     Test_stringref();
+    Test_stringref_simd();
+    Test_hash();
     Test_hexstring();
     Test_strint();
     Test_unicode();
+    Test_unicode_ascii();
+    Test_hashtable();
 }
@@ -0,0 +1,485 @@
+#include "tests.h"
+#include <circbuf.h>
+
+static VOID Test_btree_Verify(
+    _In_ PPH_BTREE Tree,
+    _In_ PUCHAR Present,
+    _In_ ULONG NumberOfKeys
+    )
+{
+    PH_BTREE_ENUM_CONTEXT enumContext;
+    ULONG64 key;
+    ULONG64 previousKey;
+    PVOID value;
+    ULONG count;
+    ULONG expected;
+    BOOLEAN found;
+    ULONG i;
+
+    // Full enumeration.
+
+    PhBeginEnumBTree(Tree, 0, MAXULONG64, &enumContext);
+    count = 0;
+
+    while (PhNextEnumBTree(&enumContext, &key, &value))
+    {
+        assert(key < NumberOfKeys * 2 && Present[key / 2] && key % 2 == 0);
+        assert(value == (PVOID)(ULONG_PTR)(key * 3));
+        assert(count == 0 || key > previousKey);
+        previousKey = key;
+        count++;
+    }
+
+    assert(count == Tree->Count);
+
+    // Floor and ceiling for present keys and for the odd keys between them. The expected
+    // results are tracked while sweeping upwards and downwards respectively.
+
+    expected = 0;
+
+    for (i = 0; i < NumberOfKeys * 2; i++)
+    {
+        if (i % 2 == 0 && Present[i / 2])
+            expected = i / 2 + 1;
+
+        found = PhFloorElementBTree(Tree, i, &key, &value);
+        assert(found == (expected != 0));
+        assert(!found || (key == (expected - 1) * 2 && value == (PVOID)(ULONG_PTR)(key * 3)));
+    }
+
+    expected = NumberOfKeys;
+
+    for (i = NumberOfKeys * 2; i != 0; i--)
+    {
+        if ((i - 1) % 2 == 0 && Present[(i - 1) / 2])
+            expected = (i - 1) / 2;
+
+        found = PhCeilingElementBTree(Tree, i - 1, &key, NULL);
+        assert(found == (expected < NumberOfKeys));
+        assert(!found || key == expected * 2);
+    }
+}
+
+static VOID Test_btree(
+    VOID
+    )
+{
+    static UCHAR present[4096];
+    static ULONG64 keys[4096];
+    static PVOID values[4096];
+    PH_BTREE tree;
+    PH_BTREE_ENUM_CONTEXT enumContext;
+    ULONG64 key;
+    PVOID value;
+    ULONG count;
+    ULONG seed;
+    ULONG round;
+    ULONG operation;
+    ULONG i;
+    BOOLEAN result;
+
+    // Keys are even numbers so that floor and ceiling can be checked between them.
+
+    PhInitializeBTree(&tree);
+    memset(present, 0, sizeof(present));
+    count = 0;
+    seed = 1;
+
+    for (round = 0; round < 8; round++)
+    {
+        for (i = 0; i < 20000; i++)
+        {
+            key = (RtlRandomEx(&seed) % 4096) * 2;
+
+            // Bias towards adding in even rounds and removing in odd rounds so that the tree
+            // grows and shrinks by several levels.
+            operation = RtlRandomEx(&seed) % 5;
+
+            if (operation < 2)
+                operation = (round & 1) ? 4 : 2;
+
+            switch (operation)
+            {
+            case 2:
+                result = PhAddElementBTree(&tree, key, (PVOID)(ULONG_PTR)(key * 3), &value);
+                assert(result == !present[key / 2]);
+                assert(result || value == (PVOID)(ULONG_PTR)(key * 3));
+
+                if (result)
+                {
+                    present[key / 2] = TRUE;
+                    count++;
+                }
+
+                break;
+            case 3:
+                result = PhFindElementBTree(&tree, key, &value);
+                assert(result == present[key / 2]);
+                assert(!result || value == (PVOID)(ULONG_PTR)(key * 3));
+                break;
+            case 4:
+                result = PhRemoveElementBTree(&tree, key, &value);
+                assert(result == present[key / 2]);
+                assert(!result || value == (PVOID)(ULONG_PTR)(key * 3));
+
+                if (result)
+                {
+                    present[key / 2] = FALSE;
+                    count--;
+                }
+
+                break;
+            }
+
+            assert(tree.Count == count);
+        }
+
+        Test_btree_Verify(&tree, present, 4096);
+    }
+
+    // Range enumeration.
+
+    PhBeginEnumBTree(&tree, 1001, 3001, &enumContext);
+    count = 0;
+
+    while (PhNextEnumBTree(&enumContext, &key, NULL))
+    {
+        assert(key >= 1001 && key <= 3001);
+        count++;
+    }
+
+    for (i = 1002 / 2; i <= 3000 / 2; i++)
+        count -= present[i];
+
+    assert(count == 0);
+
+    PhBeginEnumBTree(&tree, 10, 9, &enumContext);
+    assert(!PhNextEnumBTree(&enumContext, NULL, NULL));
+
+    PhDeleteBTree(&tree);
+    assert(tree.Count == 0);
+    assert(!PhFindElementBTree(&tree, 0, NULL));
+    assert(!PhFloorElementBTree(&tree, MAXULONG64, NULL, NULL));
+
+    // Bulk loading, for every size up to a few levels.
+
+    for (i = 0; i < 4096; i++)
+    {
+        keys[i] = i * 2;
+        values[i] = (PVOID)(ULONG_PTR)(i * 6);
+    }
+
+    for (count = 0; count <= 4096; count += count < 64 ? 1 : 61)
+    {
+        memset(present, 0, sizeof(present));
+        memset(present, 1, count);
+
+        result = PhBuildBTree(&tree, keys, values, count);
+        assert(result);
+        assert(tree.Count == count);
+        Test_btree_Verify(&tree, present, 4096);
+
+        // The tree must remain valid when it is modified after being built.
+
+        for (i = 0; i < count; i += 3)
+        {
+            result = PhRemoveElementBTree(&tree, i * 2, NULL);
+            assert(result);
+            present[i] = FALSE;
+        }
+
+        result = PhAddElementBTree(&tree, 0, NULL, NULL);
+        assert(result);
+        present[0] = TRUE;
+        Test_btree_Verify(&tree, present, 4096);
+        PhDeleteBTree(&tree);
+    }
+
+    keys[10] = keys[9];
+    assert(!PhBuildBTree(&tree, keys, NULL, 100));
+    assert(tree.Count == 0);
+}
+
+typedef struct _TEST_SORT_KEYS_CONTEXT
+{
+    PPH_STRINGREF Strings;
+    PH_SORT_ORDER SortOrder;
+} TEST_SORT_KEYS_CONTEXT, *PTEST_SORT_KEYS_CONTEXT;
+
+static int __cdecl Test_sortkeys_Compare(
+    _In_ void *context,
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PTEST_SORT_KEYS_CONTEXT sortContext = context;
+    ULONG_PTR index1 = *(PULONG_PTR)elem1;
+    ULONG_PTR index2 = *(PULONG_PTR)elem2;
+    int result;
+
+    result = PhCompareStringRef(&sortContext->Strings[index1], &sortContext->Strings[index2], TRUE);
+
+    if (result == 0)
+        result = uintptrcmp(index1, index2);
+
+    return PhModifySort(result, sortContext->SortOrder);
+}
+
+static VOID Test_sortkeys(
+    VOID
+    )
+{
+    static ULONG counts[] = { 0, 1, 2, 17, 63, 64, 65, 1000, 5000 };
+    static WCHAR characters[] = L"aAbB_";
+    static LONG64 integers[] = { MINLONG64, -1000, -1, 0, 1, 1000, MAXLONG64 };
+    static DOUBLE doubles[] = { -1e300, -2.5, -1e-300, 0, 1e-300, 2.5, 1e300 };
+    ULONG seed = 1;
+    PPH_SORT_KEY keys;
+    PPH_STRINGREF strings;
+    PWCHAR buffer;
+    TEST_SORT_KEYS_CONTEXT context;
+    PH_SORT_ORDER sortOrder;
+    ULONG64 total;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+
+    for (i = 1; i < sizeof(integers) / sizeof(LONG64); i++)
+        assert(PhSortKeyFromInt64(integers[i - 1]) < PhSortKeyFromInt64(integers[i]));
+
+    for (i = 1; i < sizeof(doubles) / sizeof(DOUBLE); i++)
+        assert(PhSortKeyFromDouble(doubles[i - 1]) < PhSortKeyFromDouble(doubles[i]));
+
+    assert(PhSortKeyFromDouble(-0.0) == PhSortKeyFromDouble(0.0));
+
+    keys = PhAllocate(5000 * sizeof(PH_SORT_KEY));
+    strings = PhAllocate(5000 * sizeof(PH_STRINGREF));
+    buffer = PhAllocate(5000 * 6 * sizeof(WCHAR));
+
+    for (i = 0; i < 5000; i++)
+    {
+        strings[i].Buffer = buffer + i * 6;
+        strings[i].Length = (RtlRandomEx(&seed) % 7) * sizeof(WCHAR);
+
+        for (j = 0; j < strings[i].Length / sizeof(WCHAR); j++)
+            strings[i].Buffer[j] = characters[RtlRandomEx(&seed) % 5];
+    }
+
+    context.Strings = strings;
+
+    for (i = 0; i < sizeof(counts) / sizeof(ULONG); i++)
+    {
+        for (sortOrder = AscendingSortOrder; sortOrder <= DescendingSortOrder; sortOrder++)
+        {
+            // Integer keys with many duplicates, ordered by the tie key.
+
+            for (j = 0; j < counts[i]; j++)
+            {
+                keys[j].Key = (ULONG64)(RtlRandomEx(&seed) % 20) << (RtlRandomEx(&seed) % 2 * 40);
+                keys[j].TieKey = RtlRandomEx(&seed) % 3 == 0 ? MAXULONG64 - j : j;
+                keys[j].Item = (PVOID)keys[j].TieKey;
+            }
+
+            PhSortKeys(keys, counts[i], sortOrder, NULL, NULL);
+            total = 0;
+
+            for (j = 0; j < counts[i]; j++)
+            {
+                assert(keys[j].Item == (PVOID)keys[j].TieKey);
+                total += keys[j].TieKey < counts[i] ? keys[j].TieKey : MAXULONG64 - keys[j].TieKey;
+
+                if (j != 0)
+                {
+                    if (sortOrder == AscendingSortOrder)
+                    {
+                        assert(keys[j - 1].Key < keys[j].Key ||
+                            (keys[j - 1].Key == keys[j].Key && keys[j - 1].TieKey < keys[j].TieKey));
+                    }
+                    else
+                    {
+                        assert(keys[j - 1].Key > keys[j].Key ||
+                            (keys[j - 1].Key == keys[j].Key && keys[j - 1].TieKey > keys[j].TieKey));
+                    }
+                }
+            }
+
+            assert(counts[i] == 0 || total == (ULONG64)counts[i] * (counts[i] - 1) / 2);
+
+            // String prefix keys, with equal keys ordered by the compare function.
+
+            context.SortOrder = sortOrder;
+
+            for (j = 0; j < counts[i]; j++)
+            {
+                keys[j].Key = PhGetStringRefSortKey(&strings[j], TRUE);
+                keys[j].TieKey = 0;
+                keys[j].Item = (PVOID)(ULONG_PTR)j;
+            }
+
+            PhSortKeys(keys, counts[i], sortOrder, Test_sortkeys_Compare, &context);
+            total = 0;
+
+            for (j = 0; j < counts[i]; j++)
+            {
+                k = (ULONG)(ULONG_PTR)keys[j].Item;
+                assert(keys[j].Key == PhGetStringRefSortKey(&strings[k], TRUE));
+                total += k;
+
+                if (j != 0)
+                    assert(Test_sortkeys_Compare(&context, &keys[j - 1].Item, &keys[j].Item) < 0);
+            }
+
+            assert(counts[i] == 0 || total == (ULONG64)counts[i] * (counts[i] - 1) / 2);
+        }
+    }
+
+    PhFree(buffer);
+    PhFree(strings);
+    PhFree(keys);
+}
+
+static VOID Test_circbuf_Verify(
+    _In_ PPH_CIRCULAR_BUFFER_ULONG Buffer,
+    _In_ PPH_CIRCULAR_BUFFER_STATISTICS_ULONG Statistics
+    )
+{
+    static ULONG counts[] = { 1, 2, 3, 7, 8, 9, 50, 99, 100, 101, 1000 };
+    ULONG64 sum;
+    ULONG minimum;
+    ULONG maximum;
+    ULONG value;
+    ULONG count;
+    ULONG i;
+    ULONG j;
+
+    count = min(Buffer->Count, Statistics->WindowSize);
+    assert(Statistics->Count == count);
+
+    sum = 0;
+
+    for (i = 0; i < count; i++)
+        sum += PhGetItemCircularBuffer_ULONG(Buffer, i);
+
+    assert(PhGetSumCircularBufferStatistics_ULONG(Statistics) == sum);
+
+    // Compare the minimum and maximum with a scan of the most recent items.
+    for (i = 0; i < sizeof(counts) / sizeof(ULONG); i++)
+    {
+        minimum = MAXULONG;
+        maximum = 0;
+
+        for (j = 0; j < counts[i] && j < count; j++)
+        {
+            value = PhGetItemCircularBuffer_ULONG(Buffer, j);
+
+            if (minimum > value)
+                minimum = value;
+            if (maximum < value)
+                maximum = value;
+        }
+
+        if (count == 0)
+            minimum = 0;
+
+        assert(PhGetMinimumCircularBufferStatistics_ULONG(Statistics, counts[i]) == minimum);
+        assert(PhGetMaximumCircularBufferStatistics_ULONG(Statistics, counts[i]) == maximum);
+    }
+}
+
+static VOID Test_circbuf(
+    VOID
+    )
+{
+    PH_CIRCULAR_BUFFER_ULONG buffer;
+    PH_CIRCULAR_BUFFER_STATISTICS_ULONG statistics;
+    ULONG seed = 1;
+    ULONG value;
+    ULONG pass;
+    ULONG i;
+
+    PhInitializeCircularBuffer_ULONG(&buffer, 100);
+    PhInitializeCircularBufferStatistics_ULONG(&statistics, buffer.Size,
+        PH_CIRCULAR_BUFFER_STATISTICS_SUM | PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM | PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM);
+
+    Test_circbuf_Verify(&buffer, &statistics);
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        // Add enough items for the buffer and the monotonic queues to wrap around several
+        // times. Runs of increasing and decreasing values fill and empty the queues.
+        for (i = 0; i < buffer.Size * 7 + 3; i++)
+        {
+            switch (i / 37 % 4)
+            {
+            case 0:
+                value = RtlRandomEx(&seed) % 1000;
+                break;
+            case 1:
+                value = i;
+                break;
+            case 2:
+                value = MAXULONG - i;
+                break;
+            default:
+                value = RtlRandomEx(&seed) % 3;
+                break;
+            }
+
+            PhAddItemCircularBufferEx_ULONG(&buffer, &statistics, value);
+            Test_circbuf_Verify(&buffer, &statistics);
+        }
+
+        PhClearCircularBuffer_ULONG(&buffer);
+        PhClearCircularBufferStatistics_ULONG(&statistics);
+        Test_circbuf_Verify(&buffer, &statistics);
+    }
+
+    PhDeleteCircularBufferStatistics_ULONG(&statistics);
+
+    // A window smaller than the buffer, with a size that is not a power of two.
+
+    PhInitializeCircularBufferStatistics_ULONG(&statistics, 7,
+        PH_CIRCULAR_BUFFER_STATISTICS_SUM | PH_CIRCULAR_BUFFER_STATISTICS_MINIMUM | PH_CIRCULAR_BUFFER_STATISTICS_MAXIMUM);
+
+    for (i = 0; i < 1000; i++)
+    {
+        value = RtlRandomEx(&seed) % (i % 2 == 0 ? 10 : 100000);
+        PhAddItemCircularBufferEx_ULONG(&buffer, &statistics, value);
+
+        assert(statistics.Count == min(i + 1, 7));
+        assert(PhGetMinimumCircularBufferStatistics_ULONG(&statistics, 1) == value);
+        assert(PhGetMaximumCircularBufferStatistics_ULONG(&statistics, 1) == value);
+
+        // Only the statistics are limited to the window.
+        if (i >= 7)
+        {
+            ULONG64 sum = 0;
+            ULONG minimum = MAXULONG;
+            ULONG maximum = 0;
+            ULONG j;
+
+            for (j = 0; j < 7; j++)
+            {
+                sum += PhGetItemCircularBuffer_ULONG(&buffer, j);
+                minimum = min(minimum, PhGetItemCircularBuffer_ULONG(&buffer, j));
+                maximum = max(maximum, PhGetItemCircularBuffer_ULONG(&buffer, j));
+            }
+
+            assert(PhGetSumCircularBufferStatistics_ULONG(&statistics) == sum);
+            assert(PhGetMinimumCircularBufferStatistics_ULONG(&statistics, 100) == minimum);
+            assert(PhGetMaximumCircularBufferStatistics_ULONG(&statistics, 100) == maximum);
+        }
+    }
+
+    PhDeleteCircularBufferStatistics_ULONG(&statistics);
+    PhDeleteCircularBuffer_ULONG(&buffer);
+}
+
+VOID Test_collect(
+    VOID
+    )
+{
+    Test_btree();
+    Test_sortkeys();
+    Test_circbuf();
+}
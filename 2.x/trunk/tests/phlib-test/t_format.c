@@ -1,4 +1,14 @@
 #include "tests.h"
+#ifdef __linux__
+#include <math.h>
+#endif
+
+// Internal CRT routines used by PhFormat before it had its own floating-point conversion
+
+errno_t __cdecl _cfltcvt_l(double *arg, char *buffer, size_t sizeInBytes,
+    int format, int precision, int caps, _locale_t plocinfo);
+
+void __cdecl _cropzeros_l(char *_Buf, _locale_t _Locale);
 
 static VOID Test_buffer(
     VOID
@@ -26,6 +36,46 @@ static VOID Test_buffer(
     assert(!result && returnLength == (OUTPUT_COUNT + 1) * sizeof(WCHAR));
 }
 
+static VOID Test_slot(
+    VOID
+    )
+{
+    PH_FORMAT_SLOT slot;
+    PH_FORMAT format[2];
+    PH_STRINGREF string;
+    PWSTR buffer;
+
+    PhInitializeFormatSlot(&slot);
+
+    // Short text is written to the inline buffer.
+    format[0].Type = UInt64FormatType | FormatGroupDigits;
+    format[0].u.UInt64 = 1234567;
+    PhFormatToSlot(&slot, format, 1, &string);
+    assert(PhEqualStringRef2(&string, L"1,234,567", FALSE) && string.Buffer == slot.InlineBuffer && !slot.Buffer);
+    assert(string.Buffer[string.Length / sizeof(WCHAR)] == 0);
+
+    // Text which fills the inline buffer exactly.
+    PhInitFormatS(&format[0], L"0123456789012345678901234567890");
+    PhFormatToSlot(&slot, format, 1, &string);
+    assert(string.Length == 31 * sizeof(WCHAR) && string.Buffer == slot.InlineBuffer && !slot.Buffer);
+
+    // Longer text needs a separate buffer...
+    PhInitFormatS(&format[1], L"x");
+    PhFormatToSlot(&slot, format, 2, &string);
+    assert(PhEqualStringRef2(&string, L"0123456789012345678901234567890x", FALSE));
+    assert(slot.Buffer && string.Buffer == slot.Buffer && slot.AllocatedLength >= 33 * sizeof(WCHAR));
+    buffer = slot.Buffer;
+
+    // ...which is kept once the text becomes short again.
+    format[0].Type = UInt64FormatType;
+    format[0].u.UInt64 = 42;
+    PhFormatToSlot(&slot, format, 1, &string);
+    assert(PhEqualStringRef2(&string, L"42", FALSE) && string.Buffer == buffer);
+
+    PhDeleteFormatSlot(&slot);
+    assert(!slot.Buffer);
+}
+
 static VOID Test_char(
     VOID
     )
@@ -76,6 +126,34 @@ static BOOLEAN IsThousandSepComma(
     return TRUE;
 }
 
+static BOOLEAN IsDecimalSepPoint(
+    VOID
+    )
+{
+    WCHAR decimalSep[4];
+
+    if (!GetLocaleInfo(LOCALE_USER_DEFAULT, LOCALE_SDECIMAL, decimalSep, 4))
+        return TRUE;
+    if (decimalSep[0] != '.' || decimalSep[1] != 0)
+        return FALSE;
+
+    return TRUE;
+}
+
+static ULONG64 NextRandom(
+    _Inout_ PULONG64 State
+    )
+{
+    ULONG64 x = *State;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *State = x;
+
+    return x;
+}
+
 static VOID Test_integer(
     VOID
     )
@@ -218,6 +296,14 @@ static VOID Test_integer(
     format[0].u.Int32 = -12345;
     result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
     assert(result && wcscmp(buffer, L"-12,345") == 0);
+    format[0].u.Int32 = 1000000;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"1,000,000") == 0);
+
+    format[0].Type = UInt64FormatType | FormatGroupDigits;
+    format[0].u.UInt64 = 18446744073709551615;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"18,446,744,073,709,551,615") == 0);
 }
 
 static VOID Test_float(
@@ -278,6 +364,26 @@ static VOID Test_float(
     result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
     assert(result && wcscmp(buffer, L"3.1416") == 0);
 
+    // Rounding (half up, after rounding to 17 significant digits)
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.125;
+    format[0].Precision = 2;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.13") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.995; // 0.99499999999999999556...
+    format[0].Precision = 2;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"1.00") == 0);
+
+    format[0].Type = DoubleFormatType | FormatUsePrecision;
+    format[0].u.Double = 0.1;
+    format[0].Precision = 20;
+    result = PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL);
+    assert(result && wcscmp(buffer, L"0.10000000000000001000") == 0);
+
     // Crop zeros
 
     format[0].Type = DoubleFormatType | FormatUsePrecision | FormatCropZeros;
@@ -416,6 +522,170 @@ static VOID Test_float(
     assert(result && wcscmp(buffer, L"-9,876,543.21000") == 0);
 }
 
+#ifdef __linux__
+
+static VOID Test_floatrandom_RoundUp(
+    _Inout_ PSTR Digits,
+    _In_ LONG Index
+    )
+{
+    while (Digits[Index] == '9')
+        Digits[Index--] = '0';
+
+    Digits[Index]++;
+}
+
+// The Linux shim's _cfltcvt_l is glibc's printf, which rounds the exact value to even. The
+// MS CRT rounds half up to 17 significant digits and then rounds those digits half up to the
+// precision, which is what PhFormat does for values below 1e17. Derive the expected output
+// for those values from the exact decimal expansion printed by glibc.
+static VOID Test_floatrandom_Expected(
+    _In_ DOUBLE Value,
+    _In_ ULONG Precision,
+    _Out_writes_(1024) PSTR Buffer
+    )
+{
+    CHAR exact[800];
+    CHAR digits[40]; // digits[0] receives carries, the significant digits start at 1
+    LONG decimalPoint;
+    LONG count;
+    LONG start;
+    LONG position;
+    ULONG i;
+
+    // %.767e is enough for the exact decimal expansion of any double.
+    snprintf(exact, sizeof(exact), "%.767e", fabs(Value));
+    decimalPoint = atoi(strchr(exact, 'e') + 1) + 1;
+
+    if (Value == 0 || decimalPoint > 17)
+    {
+        snprintf(Buffer, 1024, "%.*f", (int)Precision, Value);
+        return;
+    }
+
+    memset(digits, '0', sizeof(digits));
+    digits[1] = exact[0];
+    memcpy(&digits[2], &exact[2], 16);
+
+    if (exact[18] >= '5')
+        Test_floatrandom_RoundUp(digits, 17);
+
+    count = (LONG)Precision + decimalPoint;
+
+    if (count < 0)
+    {
+        memset(digits, '0', sizeof(digits));
+    }
+    else if (count < 17)
+    {
+        if (digits[count + 1] >= '5')
+            Test_floatrandom_RoundUp(digits, count);
+
+        memset(&digits[count + 1], '0', sizeof(digits) - count - 1);
+    }
+
+    start = digits[0] != '0' ? 0 : 1;
+    decimalPoint += 1 - start;
+
+    if (signbit(Value))
+        *Buffer++ = '-';
+
+    if (decimalPoint <= 0)
+        *Buffer++ = '0';
+
+    for (position = 0; position < decimalPoint; position++)
+        *Buffer++ = digits[start + position];
+
+    if (Precision != 0)
+        *Buffer++ = '.';
+
+    for (i = 0, position = decimalPoint; i < Precision; i++, position++)
+        *Buffer++ = position < 0 ? '0' : digits[start + position];
+
+    *Buffer = 0;
+}
+
+#endif
+
+static VOID Test_floatrandom(
+    VOID
+    )
+{
+    ULONG64 state = 0x2545f4914f6cdd1d;
+    ULONG i;
+    PH_FORMAT format[1];
+    WCHAR buffer[1024];
+    CHAR expectedBuffer[1024];
+    WCHAR expected[1024];
+    ULONG64 bits;
+    DOUBLE value;
+    ULONG j;
+
+    // Compare the output of PhFormat against the CRT for random values.
+
+    if (!IsDecimalSepPoint())
+        return;
+
+    for (i = 0; i < 1000000; i++)
+    {
+        bits = NextRandom(&state);
+
+        switch (i % 4)
+        {
+        case 0:
+            // Any magnitude which could appear in a column (around 1e-14 to 1e19).
+            bits = (bits & 0x800fffffffffffff) | ((ULONG64)(1023 - 45 + (bits >> 52) % 110) << 52);
+            value = *(PDOUBLE)&bits;
+            break;
+        case 1:
+            // Values which are exactly halfway between two decimals.
+            value = (DOUBLE)(bits % 10000000) / (DOUBLE)(1 << ((bits >> 32) % 16));
+            break;
+        case 2:
+            // Percentages.
+            value = (DOUBLE)(bits % 100000) * 100 / (DOUBLE)((bits >> 20) % 100000 + 1);
+            break;
+        case 3:
+            // Sizes.
+            value = (DOUBLE)(bits >> (bits >> 58)) / 1024;
+            break;
+        }
+
+        format[0].Type = DoubleFormatType | FormatUsePrecision;
+        format[0].Precision = (USHORT)(NextRandom(&state) % 21);
+
+        if (i & 1)
+        {
+            format[0].Type |= FormatCropZeros;
+            value = -value;
+        }
+
+        format[0].u.Double = value;
+        assert(PhFormatToBuffer(format, 1, buffer, sizeof(buffer), NULL));
+
+#ifdef __linux__
+        Test_floatrandom_Expected(value, format[0].Precision, expectedBuffer);
+#else
+        _cfltcvt_l(&value, expectedBuffer, sizeof(expectedBuffer), 'f', format[0].Precision, 0, NULL);
+#endif
+
+        if (format[0].Type & FormatCropZeros)
+            _cropzeros_l(expectedBuffer, NULL);
+
+        for (j = 0; expectedBuffer[j]; j++)
+            expected[j] = expectedBuffer[j];
+
+        expected[j] = 0;
+
+        if (wcscmp(buffer, expected) != 0)
+        {
+            wprintf(L"%.17e with precision %u: '%s' ('%s' expected)\n",
+                value, format[0].Precision, buffer, expected);
+            assert(FALSE);
+        }
+    }
+}
+
 static VOID Test_width(
     VOID
     )
@@ -557,10 +827,12 @@ VOID Test_format(
     )
 {
     Test_buffer();
+    Test_slot();
     Test_char();
     Test_string();
     Test_integer();
     Test_float();
+    Test_floatrandom();
     Test_width();
     Test_wildcards();
 }
@@ -7,6 +7,10 @@ VOID Test_basesup(
     VOID
     );
 
+VOID Test_collect(
+    VOID
+    );
+
 VOID Test_format(
     VOID
     );